@@ -126,6 +126,16 @@ public:
    */
    static Ticket GetTicket(void);
 
+   /** Cancel the operation with the given ticket.
+
+       If the operation hadn't started yet, it is not executed at all,
+       otherwise its result is not sent when it finishes.
+
+       @return true if cancelled, false if the operation had already finished
+               (or if the operations are not executed asynchronously at all)
+   */
+   static bool CancelTicket(Ticket ticket);
+
    /**@name Asynchronous Access Functions, returning results in events.*/
    //@{
    /** Check whether mailbox has changed.
@@ -16,13 +16,28 @@
 class WXDLLIMPEXP_FWD_BASE wxTempFile;
 class WXDLLIMPEXP_FWD_BASE wxTextFile;
 
+class MappedCacheFile;
+
 // ----------------------------------------------------------------------------
 // CacheFile
 // ----------------------------------------------------------------------------
 
 class CacheFile
 {
-   // no public methods nor data
+public:
+   /**
+     Static helper functions which may be also used by the code storing its
+     files in the cache directory without using this class.
+    */
+   //@{
+
+   /// return the name of the direcotry to use for the cache files
+   static String GetCacheDirName();
+
+   /// create the directory for the given cache file if it doesn't exist yet
+   static bool CreateDirFor(const String& filename);
+
+   //@}
 
 protected:
    /// protected ctor
@@ -50,6 +65,27 @@ protected:
 
    //@}
 
+   /**
+     Helpers for the derived classes using binary file format.
+
+     Such files still start with the usual text header line but it is padded
+     with NUL bytes to a multiple of 8 so that the binary data following it is
+     aligned.
+    */
+   //@{
+
+   /// write the padded header line, return its length or 0 on error
+   size_t WriteBinaryHeader(wxTempFile& file) const;
+
+   /**
+     Check the header line of the file, return the offset of the binary part
+     or 0 if the header is invalid or if the file was created by a newer
+     version of the program.
+    */
+   size_t CheckBinaryHeader(const MappedCacheFile& file, int *version) const;
+
+   //@}
+
    /**
      Callback methods used to query information about the file format.
     */
@@ -84,9 +120,6 @@ protected:
     */
    //@{
 
-   /// return the name of the direcotry to use for the cache files
-   static String GetCacheDirName();
-
    /// split an int version into major and minor parts
    static void SplitVersion(int version, int& verMaj, int& verMin);
 
@@ -104,5 +137,50 @@ private:
    CacheFile& operator=(const CacheFile&);
 };
 
+// ----------------------------------------------------------------------------
+// MappedCacheFile
+// ----------------------------------------------------------------------------
+
+/**
+  MappedCacheFile gives read-only access to the entire contents of a binary
+  cache file.
+
+  The file is mapped into memory under Unix and simply read into it elsewhere
+  (or if mapping it failed).
+ */
+class MappedCacheFile
+{
+public:
+   /// default ctor, call Open() later
+   MappedCacheFile() { m_data = NULL; m_size = 0; m_isMapped = false; }
+
+   /// dtor closes the file
+   ~MappedCacheFile() { Close(); }
+
+   /// map the file, return false if it doesn't exist, is empty or unreadable
+   bool Open(const String& filename);
+
+   /// free the file data
+   void Close();
+
+   /// return true if the file is opened
+   bool IsOpened() const { return m_data != NULL; }
+
+   /// get the file data, NULL if not opened
+   const char *GetData() const { return m_data; }
+
+   /// get the size of the file data, 0 if not opened
+   size_t GetSize() const { return m_size; }
+
+private:
+   char *m_data;
+   size_t m_size;
+   bool m_isMapped;
+
+   /// copying the objects of this class is forbidden
+   MappedCacheFile(const MappedCacheFile&);
+   MappedCacheFile& operator=(const MappedCacheFile&);
+};
+
 #endif // _M_CACHEFILE_H_
 
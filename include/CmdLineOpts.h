@@ -47,6 +47,14 @@ public:
    /// the folder to open in the main frame, only use if useFolder is true
    String folder;
 
+   /// the local folder trees to migrate on startup, see
+   /// MModule_Migrate::MigrateLocalTree(), empty if none
+   struct Migrate
+   {
+      String from,
+             to;
+   } migrate;
+
    /// use the folder field above?
    bool useFolder;
 
@@ -227,6 +227,10 @@ public:
       This wxConfig object should be used for storing setting which only make
       sense for the local machine (typical example: windows positions).
 
+      Notice that the changes done using it bypass the profiles values cache,
+      so it shouldn't be used for the options read using Profile or
+      Profile::InvalidateCache() must be called after changing them.
+
       @param config pointer (not to be deleted by caller) or NULL
     */
    wxConfigBase *GetLocalConfig() const;
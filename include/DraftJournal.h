@@ -0,0 +1,332 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   DraftJournal.h: declaration of DraftJournal class
+// Purpose:     DraftJournal stores the composer contents incrementally
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DRAFTJOURNAL_H_
+#define _DRAFTJOURNAL_H_
+
+#include <wx/atomic.h>
+#include <wx/buffer.h>
+#include <wx/filefn.h>
+#include <wx/thread.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+// the trace mask used by DraftJournal
+#define M_TRACE_DRAFTS _T("drafts")
+
+// ----------------------------------------------------------------------------
+// DraftContents: everything the composer saves in the journal
+// ----------------------------------------------------------------------------
+
+/**
+  The contents of a composer window saved in the draft journal.
+
+  This is a plain description of the message being composed and not the
+  message itself: the text parts are kept as they are in the editor and the
+  attachments are represented by the hashes of their contents only, the
+  contents itself is stored separately by DraftJournal::AddData() or
+  DraftJournal::AddFile().
+ */
+struct DraftContents
+{
+   /// a single part of the message
+   struct Part
+   {
+      /// the kinds of the parts, same as EditorContentPart types
+      enum Type
+      {
+         Text,    ///< text from the editor
+         File,    ///< attached file
+         Data     ///< attached data
+      };
+
+      Part() { type = Text; encoding = 0; }
+
+      /// return true if the part is the same as the other one
+      bool operator==(const Part& part) const
+      {
+         return type == part.type &&
+                encoding == part.encoding &&
+                text == part.text &&
+                hash == part.hash &&
+                mimeType == part.mimeType &&
+                name == part.name &&
+                filename == part.filename &&
+                disposition == part.disposition;
+      }
+
+      bool operator!=(const Part& part) const { return !(*this == part); }
+
+      /// the kind of this part
+      Type type;
+
+      /// the text of the text part (with CRLF line endings)
+      String text;
+
+      /// the encoding of the text part, as a wxFontEncoding value
+      int encoding;
+
+      /// the hash of the attachment contents, as returned by AddData/File()
+      String hash;
+
+      /// the full MIME type of the attachment
+      String mimeType;
+
+      /// the name, file name and disposition of the attachment
+      String name,
+             filename,
+             disposition;
+   };
+
+   DraftContents() { encoding = 0; }
+
+   /// the headers of the message in order
+   wxArrayString headerNames,
+                 headerValues;
+
+   /// the encoding used for the headers, as a wxFontEncoding value
+   int encoding;
+
+   /// all the parts of the message in order
+   std::vector<Part> parts;
+};
+
+// ----------------------------------------------------------------------------
+// DraftJournal: incrementally saves DraftContents
+// ----------------------------------------------------------------------------
+
+/**
+  DraftJournal is used by the composer to save its contents periodically in
+  order to be able to restore it if the program crashes.
+
+  Instead of writing the entire message each time it is saved, the journal
+  only appends the changes to it since the last time to the journal file:
+  usually this is just a small modification of the text, which is stored as
+  the replacement of a range of characters. The attachments, which can be
+  big, are stored in separate files named after the hash of their contents
+  only once and are not written (nor even read or hashed, for the attached
+  files which didn't change) again afterwards, so the cost of saving the
+  contents depends on the size of the modifications only.
+
+  Each record in the journal is protected by a checksum, so that an
+  incomplete record written just before a crash is simply ignored by Load().
+
+  As the journal grows with each save, it is periodically compacted, i.e.
+  rewritten to contain just the current contents, in a background thread. The
+  changes saved while this is happening are appended to the compacted journal
+  before it replaces the old one, so Update() never needs to wait for the
+  compaction to finish. The stored attachments which are not used any more
+  are removed at the same time.
+ */
+class DraftJournal
+{
+public:
+   /**
+     Create the journal using the given file.
+
+     The attachments contents is stored in the directory with the same name
+     as the journal file with ".blobs" suffix.
+
+     @param filename the name of the journal file, it will be overwritten
+    */
+   explicit DraftJournal(const String& filename);
+
+   /// dtor waits for the compaction but doesn't remove the files
+   ~DraftJournal();
+
+   /**
+     @name Attachments contents
+    */
+   //@{
+
+   /**
+     Store the attachment data.
+
+     The data is identified by the hash of its contents and is written only
+     if it wasn't stored yet. But the hash itself is computed each time this
+     function is called, so the caller should remember the hash returned by
+     it for the data which doesn't change and use ReuseData() instead of
+     calling this function again.
+
+     @param data the attachment data
+     @param len its length
+     @return the hash of the data or empty string on error
+    */
+   String AddData(const void *data, size_t len);
+
+   /**
+     Reuse the attachment data stored by a previous AddData() call.
+
+     This is much cheaper than AddData() as it doesn't need to hash the data.
+
+     @param hash the hash returned by AddData() for this data before
+     @return true if the data is still stored, false if AddData() must be
+             called again because it was removed as unused
+    */
+   bool ReuseData(const String& hash);
+
+   /**
+     Store the contents of the attached file.
+
+     This is similar to AddData() but the file is only read again if its
+     size or modification time changed since the last call.
+
+     @param filename the file to store
+     @return the hash of the file contents or empty string on error
+    */
+   String AddFile(const String& filename);
+
+   //@}
+
+   /**
+     Save the new composer contents.
+
+     The attachments referenced by the contents must have been stored by
+     AddData() or AddFile() before calling this function.
+
+     @param contents the current contents of the composer
+     @return true if it was saved, false on error
+    */
+   bool Update(const DraftContents& contents);
+
+   /**
+     Remove the journal and all its files.
+
+     This is called when the composer is closed normally and the journal is
+     not needed any longer.
+    */
+   void Remove();
+
+   /// return the name of the journal file
+   const String& GetFileName() const { return m_filename; }
+
+   /**
+     @name Crash recovery
+    */
+   //@{
+
+   /// the extension of the journal files, including the leading dot
+   static const wxChar *GetExtension();
+
+   /**
+     Load the contents saved in a journal left after a crash.
+
+     @param filename the name of the journal file
+     @param contents filled with the last saved contents on success
+     @return true if the journal was loaded, false if it is invalid
+    */
+   static bool Load(const String& filename, DraftContents& contents);
+
+   /**
+     Read the attachment contents stored in the journal.
+
+     @param filename the name of the journal file
+     @param hash the hash of the attachment contents from DraftContents
+     @param data filled with the attachment contents on success
+     @return true if the data was read, false if it is missing
+    */
+   static bool ReadData(const String& filename,
+                        const String& hash,
+                        wxMemoryBuffer& data);
+
+   /// remove the given journal and all its files
+   static void Remove(const String& filename);
+
+   //@}
+
+private:
+   /// the compacting thread
+   class Compactor;
+
+   /// information about a stored attached file
+   struct FileInfo
+   {
+      /// the last modification time and size of the file when we stored it
+      time_t mtime;
+      wxFileOffset size;
+
+      /// the hash of its contents
+      String hash;
+   };
+
+   /// create the directory for the blobs if necessary
+   bool CreateBlobsDir();
+
+   /**
+     Remember that the blob with this hash is used.
+
+     This must be called before storing the blob or checking that it already
+     exists as it also prevents it from being removed until the next Update().
+    */
+   void AddBlob(const String& hash);
+
+   /// append the records to the journal file, must be locked
+   bool Append(const std::vector<char>& records);
+
+   /// write the entire journal, must be locked
+   bool Rewrite();
+
+   /// start compacting the journal in the background if necessary
+   void CompactIfNeeded();
+
+   /// called by Compactor to do the work in the background thread
+   void DoCompact();
+
+   /// remove the stored blobs which are not used any more, must be locked
+   void RemoveUnusedBlobs();
+
+   /// wait until the compaction (if any) finishes
+   void WaitForCompactor();
+
+
+   /// the name of the journal file
+   const String m_filename;
+
+   /// the directory containing the attachments contents
+   const String m_dirBlobs;
+
+   /// the contents corresponding to the journal file
+   DraftContents m_saved;
+
+   /// the current size of the journal file, 0 if not created yet
+   wxFileOffset m_sizeFile;
+
+   /// the size of the journal file after the last compaction
+   wxFileOffset m_sizeCompacted;
+
+   /// incremented whenever the journal file is rewritten
+   unsigned long m_generation;
+
+   /// the information about the files we already stored
+   std::map<String, FileInfo> m_hashesFiles;
+
+   /// all the blobs we had stored
+   std::set<String> m_blobs;
+
+   /// the blobs stored since the last Update(), they may not be removed
+   std::set<String> m_blobsPending;
+
+   /// the compacting thread or NULL
+   Compactor *m_compactor;
+
+   /// non 0 while the compacting thread is running
+   wxAtomicInt m_compacting;
+
+   /// protects all the data above which is also used by the compactor
+   wxMutex m_mutex;
+
+   DECLARE_NO_COPY_CLASS(DraftJournal)
+};
+
+#endif // _DRAFTJOURNAL_H_
@@ -0,0 +1,148 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   GnuPGSession.h: running GnuPG with data passed through pipes
+// Purpose:     GnuPGSession verifies many detached signatures at once
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _GNUPGSESSION_H_
+#define _GNUPGSESSION_H_
+
+#include <string>
+#include <vector>
+
+/**
+  GnuPGSession runs gpg with the data passed to it through pipes.
+
+  Unlike wxExecute() which only allows redirecting the standard streams of the
+  child process, this class gives gpg an extra input channel (a Unix socket
+  pair, to avoid SIGPIPE if gpg exits early) for each of the inputs and refers
+  to them using "-&fd" special file names, so no temporary files are needed.
+
+  Its main purpose is to verify many detached signatures using a single gpg
+  process: each signature and the data signed by it are combined into an old
+  style OpenPGP signed message (the signature packet followed by the literal
+  data packet) and all of these messages are checked by "gpg --verify
+  --multifile", so that the keyrings and the trust database are loaded only
+  once for the entire batch instead of once per message.
+
+  This class is only available under Unix, IsSupported() returns false
+  elsewhere and VerifyDetached() always fails.
+ */
+class GnuPGSession
+{
+public:
+   /// a detached signature to verify
+   struct DetachedSignature
+   {
+      DetachedSignature() { processed = false; }
+
+      /// the signed data as raw bytes (input)
+      std::string data;
+
+      /// the signature, either ASCII-armored or binary (input)
+      std::string signature;
+
+      /// the "[GNUPG:]" status lines for this signature, without the prefix
+      std::vector<std::string> status;
+
+      /// the other (free form) lines output by gpg for this signature
+      std::vector<std::string> messages;
+
+      /// true if gpg did check this signature, even if unsuccessfully
+      bool processed;
+   };
+
+   typedef std::vector<DetachedSignature> DetachedSignatures;
+
+   /**
+     Create the session using the given gpg command.
+
+     @param command the gpg program, possibly with extra options, split into
+                    words in the same way as wxExecute() does it
+    */
+   explicit GnuPGSession(const String& command);
+
+   /// return true if this class can be used on the current platform
+   static bool IsSupported();
+
+   /// change the gpg command used
+   void SetCommand(const String& command) { m_command = command; }
+
+   /// return the gpg command used
+   const String& GetCommand() const { return m_command; }
+
+   /**
+     Change the maximal time to wait for gpg output.
+
+     If gpg doesn't produce any output during this time, it is killed and the
+     signatures which haven't been checked yet are left unprocessed.
+
+     @param msTimeout the timeout in milliseconds, 30 seconds by default
+    */
+   void SetTimeout(long msTimeout) { m_msTimeout = msTimeout; }
+
+   /**
+     Verify all the given signatures.
+
+     This method runs as few gpg processes as possible: gpg stops checking
+     the signatures after the first bad one, so a new process is started for
+     the remaining ones in this case. Each process checks at most
+     GetMaxBatchSize() signatures to avoid running out of file descriptors.
+
+     @param sigs the signatures to check, their status, messages and
+                 processed fields are filled on return
+     @return false if gpg couldn't be executed at all
+    */
+   bool VerifyDetached(DetachedSignatures& sigs);
+
+   /// return the number of signatures verified by a single gpg process
+   static size_t GetMaxBatchSize() { return 64; }
+
+   /// return the number of gpg processes launched by this session so far
+   size_t GetProcessCount() const { return m_processCount; }
+
+   /**
+     Combine the detached signature with the data it signs.
+
+     Returns the OpenPGP message which can be checked by "gpg --verify", or
+     an empty string if the signature couldn't be decoded. The signed data
+     is converted to canonical CRLF form if the signature is a text one.
+
+     This function is only public for testing.
+    */
+   static std::string MakeSignedMessage(const DetachedSignature& sig);
+
+private:
+   /**
+     Run a single gpg process checking the given signatures.
+
+     @param sigs the signatures to check
+     @param messages the OpenPGP messages created by MakeSignedMessage() for
+                     them
+     @param count the number of signatures, at most GetMaxBatchSize()
+     @param timedOut set to true if gpg had to be killed
+     @return the number of signatures processed or -1 if gpg couldn't be
+             executed
+    */
+   int RunBatch(DetachedSignature **sigs,
+                const std::string *messages,
+                size_t count,
+                bool *timedOut);
+
+
+   String m_command;
+
+   long m_msTimeout;
+
+   size_t m_processCount;
+
+   DECLARE_NO_COPY_CLASS(GnuPGSession)
+};
+
+#endif // _GNUPGSESSION_H_
@@ -21,6 +21,8 @@
 
 class WXDLLIMPEXP_FWD_BASE wxArrayString;
 class Sequence;
+class MsgSortKeys;
+class MsgThreader;
 
 struct SortParams;
 struct ThreadParams;
@@ -161,6 +163,7 @@ private:
    // these classes can create/manipulate the HeaderInfo objects directly
    friend class MailFolderCC;
    friend class MailFolderVirt;
+   friend class HeaderCacheFile;
 };
 
 /**
@@ -178,8 +181,9 @@ private:
    Finally, a message also has an UID i.e. a unique identifier which doesn't
    change even as messages are added/deleted to/from the folder. We provide a
    function to find a message by UID (the reverse is simple as HeaderInfo has
-   GetUId() method) but it for now it is implemented as linear search in all
-   messages, i.e. it is very slow and should never be called.
+   GetUId() method) which uses MailFolder::GetMsgnoFromUID(). The folders
+   implement it using binary search in their UID tables, so it is reasonably
+   fast, but it still shouldn't be called without need.
 */
 class HeaderInfoList : public MObjectRC
 {
@@ -338,6 +342,26 @@ public:
     */
    virtual bool SetThreadParameters(const ThreadParams& thrParams) = 0;
 
+#ifndef SWIG
+   /**
+      Get the object caching the sort keys for the messages of this listing.
+
+      This is used by MailFolder::SortMessages() for local sorting.
+
+      @return pointer to the object owned by the listing, never NULL
+    */
+   virtual MsgSortKeys *GetSortKeys() = 0;
+
+   /**
+      Get the object used for threading the messages of this listing.
+
+      This is used by MailFolder::ThreadMessages() for local threading.
+
+      @return pointer to the object owned by the listing, never NULL
+    */
+   virtual MsgThreader *GetThreader() = 0;
+#endif // SWIG
+
    //@}
 
    /** @name Cache control
@@ -21,6 +21,8 @@
 #endif // USE_PCH
 
 #include "HeaderInfo.h"
+#include "mail/SortKeys.h"
+#include "mail/Threader.h"
 
 WX_DEFINE_ARRAY(HeaderInfo *, ArrayHeaderInfo);
 
@@ -74,6 +76,8 @@ public:
 
    virtual bool SetSortOrder(const SortParams& sortParams);
    virtual bool SetThreadParameters(const ThreadParams& thrParams);
+   virtual MsgSortKeys *GetSortKeys();
+   virtual MsgThreader *GetThreader();
 
    virtual LastMod GetLastMod() const;
    virtual bool HasChanged(const LastMod since) const;
@@ -229,6 +233,12 @@ private:
    /// threading parameters
    ThreadParams m_thrParams;
 
+   /// the cached sort keys used by MailFolder::SortMessages()
+   MsgSortKeys m_sortKeys;
+
+   /// the threading engine used by MailFolder::ThreadMessages()
+   MsgThreader m_threader;
+
    /// should we reverse the order of messages in the folder?
    bool m_reverseOrder;
 
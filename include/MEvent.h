@@ -116,22 +116,32 @@ private:
    MailFolder *m_Folder;
 };
 
-/// MEventNewADBData - the event telling ADB editor to refresh
+/**
+   MEventNewADBData - the event sent when a new address book is created, to
+   tell ADB editor to show it, or when the contents of an existing one change.
+
+   The book name is empty if all of them could have changed.
+ */
 class MEventNewADBData : public MEventData
 {
 public:
    MEventNewADBData(const String& adbname,
-                    const String& provname)
+                    const String& provname,
+                    bool isNew = true)
       : MEventData(MEventId_NewADB),
-        m_adbname(adbname), m_provname(provname)
+        m_adbname(adbname), m_provname(provname), m_isNew(isNew)
    {
    }
 
    const String& GetAdbName() const { return m_adbname; }
    const String& GetProviderName() const { return m_provname; }
 
+   /// true if the book was just created, false if it was only modified
+   bool IsNewBook() const { return m_isNew; }
+
 private:
    String m_adbname, m_provname;
+   bool m_isNew;
 };
 
 /** MEventFolderUpdate Data - Does not carry any data apart from pointer to
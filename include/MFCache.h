@@ -13,16 +13,26 @@
 #ifndef  _MFCACHE_H_
 #define  _MFCACHE_H_
 
-#ifndef   USE_PCH
-#  include <wx/dynarray.h>        // for WX_DEFINE_ARRAY
-#endif // USE_PCH
+#include <wx/hashmap.h>           // for WX_DECLARE_STRING_HASH_MAP
 
 #include "CacheFile.h"           // base class
 
 #include "MEvent.h"
 #include "MFStatus.h"
 
-WX_DEFINE_ARRAY(MailFolderStatus *, MfStatusArray);
+// the status of a single folder stored in MfStatusCache
+struct MfStatusCacheEntry
+{
+   MfStatusCacheEntry() { isDirty = false; }
+
+   // the status itself, invalid if the status was invalidated
+   MailFolderStatus status;
+
+   // true if the entry changed since it had been written to disk
+   bool isDirty;
+};
+
+WX_DECLARE_STRING_HASH_MAP(MfStatusCacheEntry, MfStatusMap);
 
 // trace mask for logging MfStatusCache methods and other mailfolder
 // status-related activity
@@ -34,6 +44,14 @@ WX_DEFINE_ARRAY(MailFolderStatus *, MfStatusArray);
 // rebuilding of the entire folder listing if we're only interested in its
 // status (which we often are, for example when updating the status in the
 // tree)
+//
+// The cache file is binary: after the usual header line it contains a
+// sequence of records each of which either sets or invalidates the status of
+// a single folder. When the cache is saved, only the records for the folders
+// whose status changed are appended to it and the file is compacted, i.e.
+// rewritten with a single record per folder, only when it contains too many
+// obsolete records. Older versions used a text file which is still read (and
+// converted to the binary format) if no binary file exists yet.
 // ----------------------------------------------------------------------------
 
 class MfStatusCache : public CacheFile,
@@ -81,6 +99,7 @@ protected:
 
    // override some CacheFile methods
 
+   virtual bool Load();
    virtual bool Save();
 
    // implement CacheFile pure virtuals
@@ -93,11 +112,33 @@ protected:
    virtual bool DoSave(wxTempFile& file);
 
 private:
-   // the names of the folders we have cached status for
-   wxSortedArrayString m_folderNames;
+   // read the records from the binary file
+   bool LoadBinary(const MappedCacheFile& file, size_t offset);
+
+   // append the records for the changed entries to the file, return false if
+   // it couldn't be done and the file must be rewritten entirely instead
+   bool AppendChanges();
+
+   // rewrite the entire file with only the current entries
+   bool Compact();
+
+   // called when a folder is deleted or renamed, newName is empty in the
+   // former case
+   void OnFolderRemoved(const String& folderName, const String& newName);
+
+
+   // the status of all the folders we have, indexed by folder name
+   MfStatusMap m_status;
+
+   // the size of the file we had loaded or written the last time
+   size_t m_sizeFile;
+
+   // the number of records in the file, including the obsolete ones
+   size_t m_countFileRecords;
 
-   // the data for the folders above
-   MfStatusArray m_folderData;
+   // true if the file must be rewritten when we are saved the next time, this
+   // is the case if it is in the old text format or corrupted
+   bool m_needsCompaction;
 
    // the MEventManager cookie
    void *m_evtmanHandle;
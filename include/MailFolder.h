@@ -33,6 +33,7 @@ class MessageView;
 class MFolder;
 class MFolderList;
 class MLogCircle;
+class MProgressDialog;
 class Profile;
 class Sequence;
 class ServerInfoEntry;
@@ -267,6 +268,63 @@ public:
     */
    static bool CheckFolder(const MFolder *mfolder, wxFrame *frame = NULL);
 
+   /**
+     Check the status of several folders at once.
+
+     This is equivalent to calling CheckFolder() for all of them but is much
+     faster for many IMAP folders: the STATUS commands for all the folders on
+     the same server are sent at once over a single connection and the
+     replies from different servers are waited for simultaneously, so a slow
+     server doesn't delay checking the folders on the other ones.
+
+     @param folders the array of folders to check
+     @param count the number of elements in folders array
+     @param results filled with the result of the check of each folder
+     @param frame if not NULL, some feedback is given
+     @return true if all folders were checked successfully
+    */
+   static bool CheckFolders(const MFolder **folders,
+                            size_t count,
+                            bool *results,
+                            wxFrame *frame = NULL);
+
+   /**
+     @name Watching folders for new mail
+
+     An IMAP folder can be watched for changes using IDLE command (RFC 2177)
+     if the server supports it: then the server notifies us about new mail
+     immediately and the folder doesn't need to be checked periodically. Each
+     watched folder uses a separate connection to the server.
+
+     The status of a watched folder is updated in MfStatusCache and the new
+     mail is processed just as if CheckFolder() had been called for it.
+    */
+   //@{
+
+   /**
+     Start watching the given folder.
+
+     @return true if the folder is being watched now, false if it's not an
+             IMAP folder or the server doesn't support IDLE
+    */
+   static bool WatchFolder(const MFolder *folder);
+
+   /// stop watching the folder, does nothing if it wasn't watched
+   static void UnwatchFolder(const MFolder *folder);
+
+   /// return true if the folder is currently watched
+   static bool IsFolderWatched(const MFolder *folder);
+
+   /**
+     Process the notifications received for all watched folders.
+
+     This function never blocks waiting for the server and should be called
+     periodically. The folders whose connection was lost stop being watched.
+    */
+   static void PollWatchedFolders();
+
+   //@}
+
    /**
        Suspend the folder by temporarily closing it.
 
@@ -317,6 +375,18 @@ public:
     */
    static bool PingAllOpened(wxFrame *frame = NULL);
 
+   /**
+     Add some of the new messages in the opened folders to the full text
+     index.
+
+     The messages are not indexed immediately when they arrive as this would
+     require retrieving their headers, which can take a long time, so this
+     function should be called when the program is idle instead.
+
+     @return true if there are more messages left to index
+    */
+   static bool IndexNewMailInOpened();
+
    //@}
 
    /**
@@ -597,6 +667,13 @@ public:
    /// return true if the mailbox is empty
    bool IsEmpty() const { return GetMessageCount() == 0; }
 
+   /**
+      Return the UID validity of this folder or UID_ILLEGAL if its UIDs are
+      not persistent, i.e. can't be used to identify the messages between
+      the program sessions.
+    */
+   virtual UIdType GetUIdValidity() const = 0;
+
    /// Count number of new messages (== RECENT && !SEEN)
    virtual unsigned long CountNewMessages(void) const = 0;
 
@@ -624,6 +701,25 @@ public:
        @return msgno for the given UID or MSGNO_ILLEGAL if not found
    */
    virtual MsgnoType GetMsgnoFromUID(UIdType uid) const = 0;
+
+   /**
+      Retrieve the given headers of all the specified messages at once.
+
+      This is an optimization for the code which is going to look at the same
+      headers of many messages, such as the filters: it allows the folders
+      which need a trip to server to get the headers to retrieve them for all
+      messages in a single request. They are cached and later calls to
+      Message::GetHeaderLines() or Message::GetHeader() use the cached data.
+
+      The default implementation does nothing which is fine for the folders
+      where accessing the headers is cheap anyhow.
+
+      @param uids the messages to retrieve the headers of
+      @param headers the names of the headers to retrieve or an empty array
+                     to retrieve the entire message header
+    */
+   virtual void PrefetchHeaders(const UIdArray& /* uids */,
+                                const wxArrayString& /* headers */) { }
    //@}
 
    /** @name Operations on the folder */
@@ -713,6 +809,32 @@ public:
    */
    virtual bool AppendMessage(const String& msg) = 0;
 
+   /**
+     Appends several messages from another folder to this one.
+
+     This is equivalent to calling AppendMessage() for all of them but may be
+     much faster, e.g. the IMAP implementation transfers the messages in
+     batches using a single MULTIAPPEND command for each of them instead of
+     waiting for the server reply to each message if the server supports it.
+
+     Failing to append some messages doesn't prevent the others from being
+     appended and the messages which had been already appended are never
+     appended again.
+
+     @param folderSrc the folder containing the messages to append
+     @param uids the UIDs of the messages in folderSrc
+     @param pd the progress dialog to update or NULL, its range must be twice
+               the number of messages
+     @param uidsFailed if not NULL, filled with the UIDs of the messages which
+                       couldn't be appended
+     @return true if all messages were appended, false if some of them
+             couldn't be or if the operation was cancelled by user
+   */
+   virtual bool AppendMessages(MailFolder *folderSrc,
+                               const UIdArray& uids,
+                               MProgressDialog *pd = NULL,
+                               UIdArray *uidsFailed = NULL) = 0;
+
    /** Expunge messages.
     */
    virtual void ExpungeMessages(void) = 0;
@@ -20,11 +20,13 @@
 #include "MThread.h"
 
 #include "MailFolderCmn.h"
+#include "mail/UIdIndex.h"
 
 #include <wx/fontenc.h>    // for wxFontEncoding
 
 // fwd decls
 class ASMailFolder;
+class HeaderCacheFile;
 class MailFolderCC;
 
 // ----------------------------------------------------------------------------
@@ -64,6 +66,26 @@ public:
 
    static bool CheckStatus(const MFolder *folder);
 
+   /// check the status of several folders at once, see CheckFolders()
+   static bool CheckStatusAll(const MFolder **folders,
+                              size_t count,
+                              bool *results,
+                              wxFrame *frame);
+
+   /**
+     @name Watching IMAP folders for new mail using IDLE
+
+     These functions implement the MailFolder functions with the same names.
+    */
+   //@{
+
+   static bool WatchFolder(const MFolder *folder);
+   static void UnwatchFolder(const MFolder *folder);
+   static bool IsFolderWatched(const MFolder *folder);
+   static void PollWatchedFolders();
+
+   //@}
+
    /// return the directory of the newsspool:
    static String GetNewsSpool(void);
 
@@ -125,6 +147,10 @@ public:
    // uid -> msgno
    virtual MsgnoType GetMsgnoFromUID(UIdType uid) const;
 
+   // get the headers of many messages in one go
+   virtual void PrefetchHeaders(const UIdArray& uids,
+                                const wxArrayString& headers);
+
    /** get message header
        @param uid mesage uid
        @return message header information class
@@ -152,6 +178,13 @@ public:
    virtual bool AppendMessage(const Message & msg);
 
    virtual bool AppendMessage(const String& msg);
+
+   /// override base class version to append the messages in batches
+   virtual bool AppendMessages(MailFolder *folderSrc,
+                               const UIdArray& uids,
+                               MProgressDialog *pd = NULL,
+                               UIdArray *uidsFailed = NULL);
+
    virtual void ExpungeMessages(void);
 
 
@@ -205,7 +238,7 @@ public:
    virtual bool Lock(void) const;
    /** Releases the lock on the mailfolder. */
    virtual void UnLock(void) const;
-   /// Is folder locked?
+   /// Is folder locked (or used by a background operation)?
    virtual bool IsLocked(void) const;
    //@}
 
@@ -215,6 +248,8 @@ public:
 
    virtual MsgnoType GetHeaderInfo(ArrayHeaderInfo& headers,
                                    const Sequence& seq);
+
+   virtual UIdType GetUIdValidity() const;
    //@}
 
    virtual char GetFolderDelimiter() const;
@@ -249,7 +284,7 @@ public:
 
       @return MAILSTREAM of the folder
    */
-   MAILSTREAM *Stream(void) const { return m_MailStream; }
+   MAILSTREAM *Stream(void) const { WaitForBgOps(); return m_MailStream; }
 
    /**
      Methods for use by CCEventReflector only: see the comment in
@@ -281,6 +316,16 @@ private:
    ~MailFolderCC();
    //@}
 
+   /**
+     Wait until the operations on this folder executed by MailThreadPool in
+     the background complete.
+
+     This must be called before using the stream from the main thread as the
+     worker threads may be using it otherwise, it does nothing when called
+     from the worker threads themselves.
+    */
+   void WaitForBgOps() const;
+
    /** @name Opening/closing the folders */
    //@{
    /** Try to open the mailstream for this folder.
@@ -340,12 +385,19 @@ private:
    /**
      Called from GetHeaderInfo() to process one header
 
+     @param env the envelope of the message or NULL to take the header from
+                the persistent header cache
      @return false to abort overview generation, true to continue.
    */
    bool OverviewHeaderEntry(class OverviewData *overviewData,
                             struct message_cache *elt,
                             struct mail_envelope *env);
 
+   /// fill in the header info from the message envelope
+   void FillHeaderInfo(HeaderInfo& entry,
+                       struct message_cache *elt,
+                       struct mail_envelope *env);
+
    /** We remember the last folder to enter a critical section, helps
        to find crashes.*/
    static String ms_LastCriticalFolder;
@@ -395,6 +447,10 @@ private:
    static bool DoCheckStatus(const MFolder *folder,
                              struct mbx_status *mailstatus);
 
+   /// update the cached folder status and process new mail after checking it
+   static void ProcessStatus(const MFolder *folder,
+                             const struct mbx_status& mailstatus);
+
    /**
       @name Notification handlers
 
@@ -416,6 +472,9 @@ private:
 
    //@}
 
+   /// fill in the unknown UIDs in m_uidIndex, used by GetMsgnoFromUID()
+   void UpdateUIdIndex() const;
+
    // members (mostly) from here on
    // -----------------------------
 
@@ -485,6 +544,12 @@ private:
    /// UID validity (in IMAP/c-client sense) for this folder
    UIdType m_uidValidity;
 
+   /// the msgno -> UID table used for fast UID lookups
+   mutable UIdIndex m_uidIndex;
+
+   /// the persistent header cache, NULL if not used for this folder
+   HeaderCacheFile *m_headerCache;
+
    //@}
 
    /** @name Temporary operation parameters */
@@ -78,6 +78,12 @@ public:
                                    const String& fileName,
                                    wxWindow *parent = NULL);
 
+   /// append the messages one by one using AppendMessage()
+   virtual bool AppendMessages(MailFolder *folderSrc,
+                               const UIdArray& uids,
+                               MProgressDialog *pd = NULL,
+                               UIdArray *uidsFailed = NULL);
+
    /** Mark messages as deleted or move them to trash.
        @param messages pointer to an array holding the message numbers
        @return true on success
@@ -138,6 +144,12 @@ public:
 
    virtual HeaderInfoList *GetHeaders(void) const;
 
+   /**
+     The default implementation returns UID_ILLEGAL, i.e. the UIDs are not
+     persistent and the full text index can't be used for this folder.
+    */
+   virtual UIdType GetUIdValidity() const { return UID_ILLEGAL; }
+
    virtual bool ProcessNewMail(UIdArray& uidsNew,
                                const MFolder *folderDst = NULL);
 
@@ -154,6 +166,17 @@ public:
       return DoProcessNewMail(folder, NULL, NULL, countNew, NULL);
    }
 
+   /**
+     Add the headers of some of the new messages to the full text index.
+
+     This is called from MailFolder::IndexNewMailInOpened() when the program
+     is idle.
+
+     @param count the maximal number of messages to index
+     @return true if there are more messages left to index
+    */
+   bool IndexSomeNewMail(size_t count);
+
    virtual int ApplyFilterRules(const UIdArray& msgs);
 
    /** Update the folder to correspond to the new parameters: called from
@@ -299,6 +322,9 @@ protected:
 
    //@}
 
+   /// the new messages whose headers haven't been indexed yet
+   UIdArray m_uidsToIndex;
+
 private:
    /**
      public ProcessNewMail()s helper
@@ -322,6 +348,9 @@ private:
    /// copy/move new mail to the NewMail folder, return false on error
    bool CollectNewMail(UIdArray& uidsNew, const String& newMailFolder);
 
+   /// remember to add the headers of the new messages to the full text index
+   void IndexNewMail(const UIdArray& uidsNew);
+
    /// report new mail in the given folder to the user
    static void ReportNewMail(const MFolder *folder,
                              const UIdArray *uidsNew,
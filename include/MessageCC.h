@@ -80,6 +80,18 @@ public:
     */
    const char *GetRawPartData(const MimePart& mimepart, unsigned long *len = NULL);
 
+   /**
+      Write the raw part text to the given sink.
+
+      Unlike GetRawPartData(), this function retrieves the part text in
+      chunks of limited size (using partial fetches for IMAP) and passes them
+      to the sink as soon as they arrive, without keeping the entire part in
+      memory.
+
+      @return false on error or if the sink aborted writing
+     */
+   bool WriteRawPartData(const MimePart& mimepart, MimePartSink& sink);
+
    /**
       Get all headers of this message part.
 
@@ -75,6 +75,38 @@ enum MimeXferEncoding
    MIME_ENC_INVALID = 10
 };
 
+// ----------------------------------------------------------------------------
+// MimePartSink: destination for the data written by MimePart::WriteContent()
+// ----------------------------------------------------------------------------
+
+class MimePartSink
+{
+public:
+   /**
+       Write the next chunk of data.
+
+       @param data the data to write
+       @param len the length of the data
+       @return false to abort writing the part
+    */
+   virtual bool Write(const void *data, size_t len) = 0;
+
+   /**
+       Called periodically to indicate the progress.
+
+       The default implementation does nothing.
+
+       @param done the number of (raw, i.e. not decoded) bytes already read
+       @param total the total part size, i.e. MimePart::GetSize()
+       @return false to abort writing the part
+    */
+   virtual bool OnProgress(size_t WXUNUSED(done), size_t WXUNUSED(total))
+      { return true; }
+
+   /// Virtual dtor for the base class
+   virtual ~MimePartSink() { }
+};
+
 // ----------------------------------------------------------------------------
 // MimePart: represents a MIME message part of the main message
 // ----------------------------------------------------------------------------
@@ -214,6 +246,20 @@ public:
     */
    virtual String GetTextContent() const = 0;
 
+   /**
+       write the decoded contents of this part to the given sink.
+
+       Unlike GetContent(), this function doesn't retrieve the entire part at
+       once but reads and decodes it in chunks, so it should be used for
+       saving potentially big parts, such as attachments, to avoid keeping
+       them in memory.
+
+       @param sink receives the decoded data
+       @return true if the entire part was written, false on error or if
+               the sink aborted writing it
+    */
+   virtual bool WriteContent(MimePartSink& sink) const = 0;
+
    /// get all headers as one string
    virtual String GetHeaders() const = 0;
 
@@ -33,6 +33,9 @@ protected:
    /// get the message we belong to
    MessageCC *GetMessage() const { return m_message; }
 
+   /// retrieve the data in chunks instead of getting it all at once
+   virtual bool WriteRawContent(MimePartSink& sink) const;
+
 private:
    /** @name Ctors/dtor
 
@@ -56,6 +56,7 @@ public:
    // data access
    virtual const void *GetContent(unsigned long *len = NULL) const;
    virtual String GetTextContent() const;
+   virtual bool WriteContent(MimePartSink& sink) const;
 
 
    // return the total number (recursively) of all our subparts
@@ -99,6 +100,14 @@ protected:
    /// the meat of GetContent()
    const void *DecodeRawContent(const void *raw, unsigned long *lenptr);
 
+   /**
+      Write the raw (un-decoded) contents of this part to the sink.
+
+      This is used by WriteContent(), the default implementation simply
+      writes the data returned by GetRawContent() at once.
+    */
+   virtual bool WriteRawContent(MimePartSink& sink) const;
+
 
    /// the parent part (NULL for top level one)
    MimePartCCBase *m_parent;
@@ -99,6 +99,8 @@ extern const MOption MP_SPLASHDELAY;
 extern const MOption MP_AUTOSAVEDELAY;
 extern const MOption MP_POLLINCOMINGDELAY;
 extern const MOption MP_POLL_OPENED_ONLY;
+extern const MOption MP_POLL_CONCURRENTLY;
+extern const MOption MP_POLL_IDLE_MAX;
 extern const MOption MP_COLLECTATSTARTUP;
 extern const MOption MP_CONFIRMEXIT;
 extern const MOption MP_OPEN_ON_CLICK;
@@ -613,6 +615,10 @@ extern const MOption MP_OPTION_ORIGIN_INHERITED;
 #define   MP_POLLINCOMINGDELAY_NAME       "PollIncomingDelay"
 /// poll folder only if it is opened
 #define   MP_POLL_OPENED_ONLY_NAME "PollOpenedOnly"
+/// check all monitored folders at once, with one connection per server?
+#define   MP_POLL_CONCURRENTLY_NAME "PollConcurrently"
+/// the max number of the busiest folders to watch using IMAP IDLE
+#define   MP_POLL_IDLE_MAX_NAME "PollIdleMax"
 /// collect all new mail at startup?
 #define   MP_COLLECTATSTARTUP_NAME "CollectAtStartup"
 /// ask user if he really wants to exit?
@@ -1473,6 +1479,10 @@ extern const MOption MP_OPTION_ORIGIN_INHERITED;
 #define   MP_POLLINCOMINGDELAY_DEFVAL       300
 /// poll folder only if it is opened
 #define   MP_POLL_OPENED_ONLY_DEFVAL 0L
+/// check all monitored folders at once, with one connection per server?
+#define   MP_POLL_CONCURRENTLY_DEFVAL 1L
+/// the max number of the busiest folders to watch using IMAP IDLE
+#define   MP_POLL_IDLE_MAX_DEFVAL 3L
 /// collect all new mail at startup?
 #define   MP_COLLECTATSTARTUP_DEFVAL 0L
 /// ask user if he really wants to exit?
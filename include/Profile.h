@@ -145,6 +145,17 @@ public:
    /// Flush all (disk-based) profiles now, return true if ok, false on error
    static bool FlushAll();
 
+   /**
+      Forget all the option values cached by all profiles.
+
+      The profiles cache the values read by readEntry() and the cache is
+      invalidated automatically when any option is modified using either the
+      Profile methods or the global wxConfig object returned by GetConfig(),
+      but this must be called after changing the config sources directly,
+      e.g. via AllConfigSources::GetLocalConfig().
+    */
+   static void InvalidateCache();
+
    /// some characters are invalid in the profile name, replace them
    static String FilterProfileName(const String& profileName);
 
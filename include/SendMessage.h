@@ -23,6 +23,7 @@
 
 class Message;
 class Profile;
+class SendSession;
 
 // ----------------------------------------------------------------------------
 // SendMessage: ABC for a class allowing to send a message
@@ -304,6 +305,19 @@ public:
     */
    virtual bool SendNow(String *errGeneral, String *errDetailed) = 0;
 
+   /**
+       Use the given session for sending the message.
+
+       By default a new connection to the server is opened for sending each
+       message and closed immediately afterwards, which is wasteful when many
+       messages are sent at once. In this case a SendSession object should be
+       created and used for all of them.
+
+       @param session the session which must be alive until SendNow() returns
+         or NULL to stop using it.
+    */
+   virtual void SetSession(SendSession *session) = 0;
+
    /**
        Post-processing after sending the message to be done in the main thread.
 
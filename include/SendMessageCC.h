@@ -102,6 +102,7 @@ public:
 
    virtual Result PrepareForSending(int flags = 0, String *outbox = NULL);
    virtual bool SendNow(String *errGeneral, String *errDetailed);
+   virtual void SetSession(SendSession *session) { m_session = session; }
    virtual void AfterSending();
 
    virtual void Preview(String *text = NULL);
@@ -317,6 +318,9 @@ private:
    /// the parent frame (only used for the dialogs)
    wxFrame *m_frame;
 
+   /// the session used for sending or NULL to use a new connection
+   SendSession *m_session;
+
 
    /// @name Cryptographic stuff.
    //@{
@@ -17,12 +17,20 @@
 #ifndef _SEQUENCE_H_
 #define _SEQUENCE_H_
 
+#include <vector>
+
 class UIdArray;
 
 // ----------------------------------------------------------------------------
 // Sequence: an "optimized" sequence of numbers
 // ----------------------------------------------------------------------------
 
+/**
+  Sequence stores the numbers as a vector of ranges in the order in which they
+  were added, so that iterating over it, getting the number of its elements
+  or its bounds is cheap. The IMAP sequence string is only built when it is
+  needed for a c-client call and is cached until the sequence changes.
+ */
 class Sequence
 {
 public:
@@ -44,6 +52,25 @@ public:
    /// apply the given function to all elements of the sequence, return result
    Sequence Apply(UIdType (*map)(UIdType uid)) const;
 
+   /**
+     @name Set operations
+
+     The sequences returned by these functions are always sorted and don't
+     contain any duplicates, even if the arguments do.
+    */
+   //@{
+
+   /// get the sequence containing the elements of either sequence
+   Sequence Union(const Sequence& other) const;
+
+   /// get the sequence containing the elements of both sequences
+   Sequence Intersection(const Sequence& other) const;
+
+   /// get the sequence containing the elements not in the other one
+   Sequence Difference(const Sequence& other) const;
+
+   //@}
+
    /// get the string representing the sequence in IMAP format
    String GetString() const;
 
@@ -56,40 +83,48 @@ public:
    /// get the next element in sequence, UID_ILLEGAL if no more
    UIdType GetNext(UIdType n, size_t& cookie) const;
 
-   /// get the min and max elements in the sequence
+   /// get the min and max elements in the sequence (0 if it is empty)
    void GetBounds(UIdType *nMin, UIdType *nMax) const;
 
 private:
-   /// do we have an unfinished range currently?
-   bool HasCurrentRange() const { return m_first != UID_ILLEGAL; }
+   /// a range of consecutive numbers
+   struct Range
+   {
+      Range(UIdType first_, UIdType last_) : first(first_), last(last_) { }
 
-   /// call DoFlush() if needed
-   void Flush() const;
+      /// ranges are ordered by their start only
+      bool operator<(const Range& other) const { return first < other.first; }
 
-   /// finish the current range, return true if we had any
-   bool DoFlush();
+      UIdType first,
+              last;
+   };
 
-   /// get char at the given position in m_seq returning '\0' for out of range
-   /// indices
-   char GetCharAt(size_t pos) const
-   {
-      return pos == m_seq.length() ? '\0' : static_cast<char>(m_seq[pos]);
-   }
+   typedef std::vector<Range> Ranges;
+
+   /// add a new range at the end of the sequence, merging it if possible
+   void DoAddRange(UIdType from, UIdType to);
+
+   /// get our ranges sorted and without overlaps
+   Ranges GetNormalizedRanges() const;
+
+   /// create a sequence from the sorted ranges without overlaps
+   static Sequence FromNormalizedRanges(const Ranges& ranges);
 
-   /// get the number at given position and increment it to the pos after it
-   UIdType GetNumberAt(size_t& pos) const;
+   /// the ranges in the order in which they were added
+   Ranges m_ranges;
 
    /// the number of elements in the sequence so far
    size_t m_count;
 
-   /// the first number in the current range or UID_ILLEGAL
-   UIdType m_first;
+   /// the smallest and biggest elements (only valid if m_count != 0)
+   UIdType m_min,
+           m_max;
 
-   /// the last number in the range so far (only if m_first != UID_ILLEGAL)
-   UIdType m_last;
+   /// true if m_ranges are sorted, don't overlap and are not adjacent
+   bool m_isNormalized;
 
-   /// the string for the sequence we have so far (maybe unterminated!)
-   String m_seq;
+   /// the cached string for GetString() or empty if not computed yet
+   mutable String m_seq;
 };
 
 /**
@@ -25,11 +25,42 @@
 
 #include "gui/MBookCtrl.h"
 
+#ifndef USE_PCH
+#  include <wx/dynarray.h>        // for WX_DEFINE_ARRAY
+#endif // USE_PCH
+
 class Message;
 class SpamOptionsPage;
 
 class WXDLLIMPEXP_FWD_CORE wxFrame;
 
+/// array of messages processed by the spam filters at once (not owned by it)
+WX_DEFINE_ARRAY(Message *, ArrayMessages);
+
+/**
+   Statistics of a batch spam filter operation.
+
+   This is filled by the overloads of SpamFilter::CheckIfSpam() and Train()
+   processing several messages at once.
+ */
+struct SpamBatchStats
+{
+   SpamBatchStats() { count = countSpam = 0; msElapsed = 0; }
+
+   /// return the number of messages processed per second
+   double GetRate() const
+      { return msElapsed ? (1000.*count)/msElapsed : 0.; }
+
+   /// the number of messages processed
+   size_t count;
+
+   /// the number of them which were recognized as spam (by CheckIfSpam())
+   size_t countSpam;
+
+   /// the time taken by the operation in milliseconds
+   long msElapsed;
+};
+
 
 /*
    Abstract base class for all concrete spam filters.
@@ -93,6 +124,22 @@ public:
     */
    static void Train(const Message& msg, bool isSpam);
 
+   /**
+      Train the spam filter using several messages at once.
+
+      This is equivalent to calling Train() for all of the messages but can
+      be much faster as the filters can process them all together, e.g.
+      without reopening their database for each message.
+
+      @param msgs the messages to train the filter with, they should all come
+                  from the same folder as the options of the first one are used
+      @param isSpam if true, these are spams, otherwise -- hams
+      @param stats if not NULL, filled with the operation statistics
+    */
+   static void Train(const ArrayMessages& msgs,
+                     bool isSpam,
+                     SpamBatchStats *stats = NULL);
+
    /**
       Check if the message is a spam.
 
@@ -115,6 +162,27 @@ public:
                            const String& param = wxEmptyString,
                            String *result = NULL);
 
+   /**
+      Check several messages at once.
+
+      This is equivalent to calling the function above for all messages but
+      can be much faster for the filters processing several messages together.
+
+      @param msgs the messages to check, they should all come from the same
+                  folder as the options of the first one are used
+      @param param the same as for CheckIfSpam() above
+      @param isSpam filled with the results for all messages
+      @param results if not NULL, filled with the explanations for all
+                     messages recognized as spam or definitively not spam
+                     (and empty strings for the others)
+      @param stats if not NULL, filled with the operation statistics
+    */
+   static void CheckIfSpam(const ArrayMessages& msgs,
+                           const String& param,
+                           wxArrayInt& isSpam,
+                           wxArrayString *results = NULL,
+                           SpamBatchStats *stats = NULL);
+
    /**
       Show a GUI dialog allowing the user to configure all spam filters.
 
@@ -237,6 +305,33 @@ protected:
                              const String& param,
                              String *result) = 0;
 
+   /**
+      Train filter using all these messages.
+
+      This is used by the public Train() overload taking an array of
+      messages. The default implementation simply calls DoTrain() for all of
+      them but it can be overridden to process them more efficiently.
+    */
+   virtual void DoTrainBatch(const Profile *profile,
+                             const ArrayMessages& msgs,
+                             bool isSpam);
+
+   /**
+      Process all messages and return whether each of them is a spam.
+
+      This is used by the public CheckIfSpam() overload taking an array of
+      messages. The default implementation calls DoCheckIfSpam() for all of
+      them but it can be overridden to process them more efficiently.
+
+      @param isSpam filled with DoCheckIfSpam() return values for all messages
+      @param results filled with the explanations for all messages
+    */
+   virtual void DoCheckIfSpamBatch(const Profile *profile,
+                                   const ArrayMessages& msgs,
+                                   const String& param,
+                                   wxArrayInt& isSpam,
+                                   wxArrayString& results);
+
    /**
       Return the name of the icon used by the option page.
 
@@ -96,13 +96,15 @@ struct ThreadData
 /**
    The function which threads messages according to the JWZ algorithm
 
+   It uses the MsgThreader associated with the listing, so only the messages
+   added to it since the last call are really examined.
+
    @param thrParams specifies how to thread messages
-   @param hil the headers to thread
-   @param indices will contain the indices in the "thread" order on return
-   @param indents will contain the indents of the messages on return
+   @param hil the headers to thread, all of them must have been cached
+   @param thrData m_root is set to the root of the thread tree on return
  */
 extern void JWZThreadMessages(const ThreadParams& thrParams,
-                              const HeaderInfoList *hil,
+                              HeaderInfoList *hil,
                               ThreadData *thrData);
 
 /**
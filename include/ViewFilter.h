@@ -16,6 +16,7 @@
 
 #include "MModule.h"
 #include "MessageViewer.h"
+#include "ViewText.h"
 
 class MessageView;
 class MessageViewer;
@@ -103,11 +104,15 @@ public:
      all the text (as opposed to anything special) generated by this filter
      must be passed to Process() method of the next filter.
 
-     @param text which may be modified in place by the filter
+     The text is not copied when it is passed along the chain, the filters
+     pass the parts of the text they got to the next filter and only the
+     filters changing the text need to make a copy of it, see ViewText.
+
+     @param text the run of text to process, possibly a whole String
      @param viewer the viewer to use for the real output
      @param style the current style used for the output
     */
-   void Process(String& text,
+   void Process(const ViewText& text,
                 MessageViewer *viewer,
                 MTextStyle& style)
    {
@@ -171,7 +176,7 @@ public:
 
 protected:
    /// the function to implement in the derived classes, called by Process()
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style) = 0;
 
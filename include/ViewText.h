@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   ViewText.h
+// Purpose:     ViewText is a run of text passed through the viewer filters
+// Author:      Mahogany team
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+   @file ViewText.h
+   @brief Declaration of ViewText class.
+
+   This header is kept separate from ViewFilter.h so that it can be used
+   without pulling in all the MessageView-related stuff.
+ */
+
+#ifndef _M_VIEWTEXT_H_
+#define _M_VIEWTEXT_H_
+
+/**
+   A run of text passed through the viewer filters chain.
+
+   ViewText doesn't own the text, it is just a pointer to its start and its
+   length. The text is owned by whoever called ViewFilter::Process() and
+   remains valid during the entire call, so the filters which only split the
+   text in several parts (e.g. to highlight the signature or the URLs) can
+   pass the runs corresponding to these parts to the next filter without
+   making any copies. Only the filters really modifying the text need to put
+   the result into a String and pass it to the next filter instead.
+
+   Notice that the text following the run is always readable until the NUL
+   terminating the string it is part of, so functions working with
+   NUL-terminated strings, such as FindURL(), still can be used with it.
+   However the characters after end() don't belong to this run and the
+   filters shouldn't take them into account (except for look-ahead).
+ */
+class ViewText
+{
+public:
+   /**
+      @name Construction
+    */
+   //@{
+
+   /// construct the run for the given range of characters
+   ViewText(const wxChar *start, const wxChar *end)
+      : m_start(start), m_len(end - start) { }
+
+   /// construct the run for the given number of characters
+   ViewText(const wxChar *start, size_t len)
+      : m_start(start), m_len(len) { }
+
+   /**
+      Construct the run corresponding to the entire string.
+
+      This ctor is not explicit to allow passing strings to
+      ViewFilter::Process() directly, but the string must outlive the run.
+    */
+   ViewText(const String& s)
+      : m_start(s.c_str()), m_len(s.length()) { }
+
+   //@}
+
+   /**
+      @name Accessors
+    */
+   //@{
+
+   /// return the pointer to the first character of the run
+   const wxChar *begin() const { return m_start; }
+
+   /// return the pointer one past the last character of the run
+   const wxChar *end() const { return m_start + m_len; }
+
+   /// return the number of characters in the run
+   size_t length() const { return m_len; }
+
+   /// return true if the run is empty
+   bool empty() const { return m_len == 0; }
+
+   /**
+      Find the first occurrence of the given character in the run.
+
+      @param ch the character to look for
+      @param from the position to start looking at, must be inside the run
+      @return pointer to the character or NULL if not found before end()
+    */
+   const wxChar *Find(wxChar ch, const wxChar *from) const
+   {
+      for ( const wxChar * const last = end(); from < last; from++ )
+      {
+         if ( *from == ch )
+            return from;
+      }
+
+      return NULL;
+   }
+
+   /// return the run as a string: this does copy the text
+   String ToString() const { return String(m_start, m_len); }
+
+   //@}
+
+private:
+   const wxChar *m_start;
+   size_t m_len;
+};
+
+#endif // _M_VIEWTEXT_H_
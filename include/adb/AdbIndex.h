@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   adb/AdbIndex.h - AdbLookupIndex class declaration
+// Purpose:     AdbLookupIndex allows to quickly find matching ADB entries
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ADB_ADBINDEX_H_
+#define _ADB_ADBINDEX_H_
+
+#include <string>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// AdbLookupIndex: in-memory index of the ADB entries fields
+// ----------------------------------------------------------------------------
+
+/**
+  AdbLookupIndex allows to find the entries whose nick name, full name or
+  e-mail address starts with or contains the given string without examining
+  all of them.
+
+  The index doesn't know anything about the entries themselves, it only
+  associates the values of their fields with the numeric ids given to Add().
+  The prefix lookups use the sorted array of all values and the substring
+  ones use the index of all trigrams (sequences of 3 characters) occurring in
+  them, so both are done in logarithmic time. Only the substring searches for
+  the strings of less than 3 characters need to examine all values.
+
+  All lookups are case-insensitive and the strings are matched literally,
+  i.e. '*' and '?' in them don't have any special meaning, unlike with
+  AdbEntry::Matches(). Use CanFind() to check if the index can be used for
+  the given lookup.
+
+  The index is built on demand when Find() is called for the first time after
+  adding more values to it.
+ */
+class AdbLookupIndex
+{
+public:
+   /// a single element found by Find()
+   struct Match
+   {
+      /// the id of the element as passed to Add()
+      size_t id;
+
+      /// the field in which it matched, one of AdbLookup_XXX constants
+      int field;
+
+      /// true if the field starts with the string being searched
+      bool isPrefix;
+   };
+
+   /// create an empty index
+   AdbLookupIndex();
+
+   /**
+     Return true if Find() can be used for the lookup with the given
+     parameters (which have the same meaning as for AdbEntry::Matches()).
+    */
+   static bool CanFind(const String& what, int where, int how);
+
+   /**
+     Add the value of a field of the element with the given id.
+
+     This may be called several times for the same field of the same element,
+     e.g. for all its e-mail addresses.
+
+     @param id the id of the element, returned by Find()
+     @param field one of AdbLookup_NickName, FullName or EMail
+     @param value the field value, empty values are ignored
+    */
+   void Add(size_t id, int field, const String& value);
+
+   /// remove all values from the index
+   void Clear();
+
+   /// return the number of values in the index
+   size_t GetCount() const { return m_values.size(); }
+
+   /**
+     Find the elements matching the given string.
+
+     Each element is returned at most once, with the most relevant of its
+     fields in which it matched. The matches are sorted by relevance: the
+     matches in the nick name come first, then the full name and then the
+     e-mail ones and, for each field, the values starting with the string
+     come before the other ones. Otherwise the elements are returned in the
+     order of their ids.
+
+     @param what the string to search for, CanFind() must return true
+     @param where the combination of AdbLookup_XXX fields to search in
+     @param how AdbLookup_Match, AdbLookup_StartsWith or AdbLookup_Substring
+     @param matches filled with the elements found (not cleared by this
+                    function)
+     @return the number of elements found
+    */
+   size_t Find(const String& what,
+               int where,
+               int how,
+               std::vector<Match>& matches) const;
+
+private:
+   // a single indexed value
+   struct Value
+   {
+      std::wstring text;   // lower case
+      size_t id;
+      int field;
+   };
+
+   // a trigram together with the index of the value in which it occurs
+   typedef unsigned long long Trigram;
+   typedef std::pair<Trigram, size_t> TrigramOccurrence;
+
+   // return the trigram starting at the given position of the string
+   static Trigram GetTrigram(const std::wstring& s, size_t pos);
+
+   // build m_sorted and m_trigrams if necessary
+   void Build() const;
+
+   // add the match for the given value to the array if it's in the right field
+   void AddMatch(size_t n,
+                 int where,
+                 const std::wstring& what,
+                 std::vector<Match>& matches) const;
+
+
+   // all values in the order of their addition
+   std::vector<Value> m_values;
+
+   // the indices of m_values sorted by the text, used for prefix lookups
+   mutable std::vector<size_t> m_sorted;
+
+   // all trigrams of all values, sorted, used for substring lookups
+   mutable std::vector<TrigramOccurrence> m_trigrams;
+
+   // true if m_sorted and m_trigrams are up to date
+   mutable bool m_isBuilt;
+};
+
+#endif // _ADB_ADBINDEX_H_
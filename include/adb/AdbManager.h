@@ -177,6 +177,19 @@ extern bool AdbLookup(ArrayAdbEntries& aEntries,
                       int how = AdbLookup_Substring,
                       AdbEntryGroup *group = NULL);
 
+/**
+  Must be called after modifying the entries or groups of an address book.
+
+  This sends MEventNewADBData for the book containing the given element to
+  let everybody interested know about the change. In particular, AdbLookup()
+  and AdbExpand() use an index of all entries of the books which is built
+  once and is discarded when this event is received.
+
+  @param element the changed entry or group (or the book itself), may be
+         NULL to invalidate the indices of all books
+*/
+extern void AdbNotifyChanged(AdbElement *element);
+
 /**
   Expand the abbreviated address: i.e. looks for an address entry which starts
   with the specified text and returns it if found. If more than one address
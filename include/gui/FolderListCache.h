@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   gui/FolderListCache.h
+// Purpose:     FolderListCache stores the formatted folder view rows
+// Author:      Mahogany team
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+   @file gui/FolderListCache.h
+   @brief Declaration of FolderListCache class.
+
+   FolderListCache is used by the folder view list control to avoid formatting
+   the text of the same cells again and again whenever it is repainted.
+ */
+
+#ifndef _M_GUI_FOLDERLISTCACHE_H_
+#define _M_GUI_FOLDERLISTCACHE_H_
+
+#include <wx/arrstr.h>
+#include <wx/colour.h>
+#include <wx/hashmap.h>
+
+/**
+   The cached data for a single row of the folder view.
+ */
+struct FolderListRow
+{
+   /// the text of the cells indexed by wxFolderListColumn (not by position)
+   wxArrayString cells;
+
+   /// the colour to use for the row text, may be invalid
+   wxColour colour;
+};
+
+WX_DECLARE_HASH_MAP(UIdType, FolderListRow,
+                    wxIntegerHash, wxIntegerEqual,
+                    FolderListRowsMap);
+
+/**
+   FolderListCache stores the formatted rows of a single folder listing.
+
+   The rows are indexed by the UIDs of the messages shown in them and not by
+   their positions, so the cache itself doesn't know when the listing changes
+   and Clear() must be called by its owner whenever this happens, as well as
+   when the options affecting the display change. Invalidate() should be
+   called when the status of a message changes.
+
+   The cache also keeps track of the scrolling of the control to
+   allow it to prepare the rows which will be shown next during idle time,
+   see GetPrefillRange().
+ */
+class FolderListCache
+{
+public:
+   /**
+      Create an empty cache.
+
+      @param maxRows the maximal number of rows to keep, the cache is
+                     cleared when it grows beyond this number
+    */
+   explicit FolderListCache(size_t maxRows = 8192);
+
+   /**
+      @name Accessing the rows
+    */
+   //@{
+
+   /// return the cached row for this UID or NULL
+   const FolderListRow *Get(UIdType uid) const;
+
+   /**
+      Add a new row to the cache.
+
+      The returned row has empty cells and must be filled by the caller.
+    */
+   FolderListRow& Add(UIdType uid);
+
+   /// forget the row for this UID if we have it
+   void Invalidate(UIdType uid);
+
+   /// forget all the cached rows
+   void Clear();
+
+   /// return the number of the rows currently cached
+   size_t GetCount() const { return m_rows.size(); }
+
+   //@}
+
+   /**
+      Return the range of the items which should be formatted in advance.
+
+      This function is supposed to be called during idle time and returns the
+      items which will become visible if the control is scrolled by the same
+      amount as the last time. It returns false if there is nothing to do,
+      i.e. if the control wasn't scrolled since the last call.
+
+      @param top the first visible item
+      @param countPerPage the number of the visible items
+      @param count the total number of items in the control
+      @param from the first item to prefill (inclusive)
+      @param to the last item to prefill (exclusive)
+      @return true if there are items to prefill
+    */
+   bool GetPrefillRange(long top, long countPerPage, long count,
+                        long *from, long *to);
+
+private:
+   // the cached rows
+   FolderListRowsMap m_rows;
+
+   // the maximal number of rows in m_rows
+   const size_t m_maxRows;
+
+   // the top item during the last call to GetPrefillRange() or -1
+   long m_topLast;
+
+   // the amount by which the control was scrolled the last time or 0
+   long m_scrollDelta;
+
+   DECLARE_NO_COPY_CLASS(FolderListCache)
+};
+
+#endif // _M_GUI_FOLDERLISTCACHE_H_
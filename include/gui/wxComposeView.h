@@ -27,6 +27,8 @@
 
 #include "strlist.h"
 
+#include <map>
+
 // ----------------------------------------------------------------------------
 // forward declarations
 // ----------------------------------------------------------------------------
@@ -38,6 +40,8 @@ class wxEnhancedPanel;
 class SendMessage;
 class SendThreadResult;
 class MessageEditor;
+class DraftJournal;
+struct DraftContents;
 
 class IsReplyButton;
 class PGPSignButton;
@@ -227,6 +231,9 @@ public:
    /**
      Save a snapshot of the composer contents into a file to be able to restore
      it later if the app crashes.
+
+     Only the changes since the last call are written to the draft journal,
+     so this is cheap even if the message has big attachments.
    */
    bool AutoSave();
 
@@ -447,6 +454,18 @@ protected:
    */
    SendMessage *BuildDraftMessage(int flags = Interactive) const;
 
+   /// return the value of the header used to save the composer geometry
+   String GetGeometryHeader() const;
+
+   /**
+     Fill the contents to be saved in the draft journal.
+
+     This stores the attachments in the journal as a side effect.
+
+     @param contents to fill with the composer headers and parts
+   */
+   void GetDraftContents(DraftContents& contents);
+
    // determines the encoding to use for representing the given Unicode text as
    // char string and returns it appropriately encoded; also updating the
    // encoding if we couldn't have used it
@@ -632,8 +651,19 @@ private:
    /// the text to be quoted in a reply/followup (may be empty)
    String m_textToQuote;
 
-   /// the name of the file we autosaved ourselves to (may be empty)
-   String m_filenameAutoSave;
+   /// the journal we autosave ourselves to (may be NULL)
+   DraftJournal *m_journal;
+
+   /// the data parts saved in m_journal and their hashes
+   typedef std::map<EditorContentPart *, String> DraftDataHashes;
+
+   /**
+     The hashes of the data parts saved in m_journal.
+
+     The parts are IncRef()'d to ensure that the data doesn't change as long
+     as they're in this map, so that it doesn't need to be hashed again.
+    */
+   DraftDataHashes m_draftDataHashes;
 
    /// the (main) encoding (== charset) to use for the message
    wxFontEncoding m_encoding;
@@ -93,6 +93,11 @@ public:
    // stop event processing while c-client is locked to prevent reentrancies
    virtual int FilterEvent(wxEvent& event);
 
+   // hold MailLock while handling the events
+   virtual void HandleEvent(wxEvtHandler *handler,
+                            wxEventFunction func,
+                            wxEvent& event) const;
+
    // override top level window detection: never return splash frame from here
    // as it is transient and so is not suitable for use as a parent for the
    // dialogs (it can disappear before the dialog is closed)
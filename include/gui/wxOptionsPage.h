@@ -618,7 +618,8 @@ private:
    // remember the old values for the settings in these variables
    long m_nIncomingDelayOld;
 
-   bool m_collectOld,
+   bool m_pollIdleOld,
+        m_collectOld,
         m_monitorOld;
 
    // the folder we're editing properties of or NULL if this is a global dialog
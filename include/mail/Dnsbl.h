@@ -0,0 +1,231 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/Dnsbl.h: DNS blacklists lookups
+// Purpose:     DnsblChecker checks IP addresses against DNSBLs
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_DNSBL_H_
+#define _MAIL_DNSBL_H_
+
+#include <time.h>
+
+#include <map>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// DnsblResolver: performs the DNS queries for DnsblChecker
+// ----------------------------------------------------------------------------
+
+/**
+  DnsblResolver is the interface used by DnsblChecker to look up the names.
+
+  It allows to replace the default resolver sending the queries to the system
+  DNS servers with another one, e.g. for testing.
+ */
+class DnsblResolver
+{
+public:
+   /// a single DNS query
+   struct Query
+   {
+      Query() { done = listed = false; ttl = 0; }
+
+      /// the name to look up, e.g. "4.3.2.1.dnsbl.example.com"
+      String name;
+
+      /// set by the resolver to true if the answer was received
+      bool done;
+
+      /// set by the resolver to true if the name exists, i.e. is listed
+      bool listed;
+
+      /// set by the resolver to the time to live of the answer in seconds
+      unsigned long ttl;
+   };
+
+   /**
+     Resolve all queries concurrently.
+
+     This function must return as soon as all queries are answered or the
+     given time elapses, whichever happens first, leaving the queries which
+     didn't get the answer in time with done field set to false.
+
+     @param queries the queries to resolve
+     @param msTimeout the maximal time to wait for the answers
+    */
+   virtual void Resolve(std::vector<Query>& queries, long msTimeout) = 0;
+
+   /// virtual dtor for the base class
+   virtual ~DnsblResolver() { }
+};
+
+// ----------------------------------------------------------------------------
+// DnsblUdpResolver: DnsblResolver sending the queries over UDP
+// ----------------------------------------------------------------------------
+
+/**
+  The default resolver sending all the queries at once to the DNS server and
+  waiting for the answers using a single socket.
+
+  Unlike the standard res_query(), it doesn't block for the resolver timeout
+  for each of the queries in turn.
+ */
+class DnsblUdpResolver : public DnsblResolver
+{
+public:
+   /**
+     Create the resolver using the given DNS servers.
+
+     @param servers the addresses of the DNS servers in "a.b.c.d[:port]"
+                    form, if empty the servers from the system resolver
+                    configuration are used
+    */
+   DnsblUdpResolver(const wxArrayString& servers = wxArrayString());
+
+   virtual void Resolve(std::vector<Query>& queries, long msTimeout);
+
+private:
+   /// a DNS server address
+   struct Server
+   {
+      /// IPv4 address and port in host byte order
+      unsigned long ip;
+      unsigned short port;
+   };
+
+   /// return true if this is the address of one of our servers
+   bool IsServer(unsigned long ip, unsigned short port) const;
+
+   std::vector<Server> m_servers;
+
+   DECLARE_NO_COPY_CLASS(DnsblUdpResolver)
+};
+
+// ----------------------------------------------------------------------------
+// DnsblChecker: checks the addresses against DNSBLs and caches the results
+// ----------------------------------------------------------------------------
+
+/**
+  DnsblChecker checks whether the IP addresses are listed in the DNS
+  blacklists.
+
+  It caches both positive and negative answers for the time to live given by
+  the DNS servers, so that the same addresses, which are typical for the
+  Received headers of the messages from the same sender, are looked up only
+  once. The global checker returned by Get() saves its cache between the
+  program sessions.
+ */
+class DnsblChecker
+{
+public:
+   /**
+     Create a new checker with an empty cache.
+
+     @param resolver the resolver to use, the checker takes ownership of it,
+                     if NULL DnsblUdpResolver using system servers is used
+    */
+   DnsblChecker(DnsblResolver *resolver = NULL);
+
+   ~DnsblChecker();
+
+   /**
+     @name The global checker
+
+     The checker used by the spam filters, its cache is loaded from the cache
+     directory when it's created and saved there by Flush() and CleanUp().
+    */
+   //@{
+
+   /// get the global checker, creating it if necessary
+   static DnsblChecker *Get();
+
+   /// save the cache of the global checker if it had been modified
+   static void Flush();
+
+   /// save the cache and delete the global checker
+   static void CleanUp();
+
+   //@}
+
+   /// change the resolver used, the checker takes ownership of it
+   void SetResolver(DnsblResolver *resolver);
+
+   /**
+     Check whether any of the given addresses is listed in any of the
+     blacklists.
+
+     All the lookups not in the cache are done at once.
+
+     @param addresses the IPv4 addresses in dotted quad notation, the
+                      invalid ones are ignored
+     @param zones the DNS zones of the blacklists, e.g. "dnsbl.example.com"
+     @param msTimeout the maximal time to wait for the DNS answers, the
+                      addresses for which no answer was received in time
+                      are considered to be not listed
+     @param match if not NULL, filled with the DNS name of the first found
+                  listed address
+     @return true if an address was found in a blacklist
+    */
+   bool IsListed(const wxArrayString& addresses,
+                 const wxArrayString& zones,
+                 long msTimeout,
+                 String *match = NULL);
+
+   /**
+     @name Cache persistence
+    */
+   //@{
+
+   /// load the cache from the given file, return false if it's corrupted
+   bool Load(const String& filename);
+
+   /// save the (not yet expired) cache entries to the given file
+   bool Save(const String& filename);
+
+   /// return true if the cache changed since it was loaded or saved
+   bool IsDirty() const { return m_isDirty; }
+
+   /// return the number of entries in the cache
+   size_t GetCacheSize() const { return m_cache.size(); }
+
+   //@}
+
+private:
+   /// a cached answer
+   struct Entry
+   {
+      /// true if the name was listed
+      bool listed;
+
+      /// the time when this entry expires
+      time_t expires;
+   };
+
+   typedef std::map<String, Entry> Cache;
+
+   /// the name of the file used by the global checker
+   static String GetFileName();
+
+   /// get the cached answer for the name, return false if we don't have it
+   bool GetCached(const String& name, bool *listed) const;
+
+   /// add the answer to the cache
+   void AddToCache(const DnsblResolver::Query& query);
+
+
+   Cache m_cache;
+
+   DnsblResolver *m_resolver;
+
+   bool m_isDirty;
+
+   DECLARE_NO_COPY_CLASS(DnsblChecker)
+};
+
+#endif // _MAIL_DNSBL_H_
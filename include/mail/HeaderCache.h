@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/HeaderCache.h: declaration of HeaderCacheFile class
+// Purpose:     HeaderCacheFile stores the message headers between sessions
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_HEADERCACHE_H_
+#define _MAIL_HEADERCACHE_H_
+
+#include "CacheFile.h"
+
+#include <map>
+#include <vector>
+
+class HeaderInfo;
+class UIdIndex;
+
+// ----------------------------------------------------------------------------
+// HeaderCacheFile: persistent UID -> HeaderInfo map for a single folder
+// ----------------------------------------------------------------------------
+
+/**
+  HeaderCacheFile allows to avoid retrieving the envelopes of all messages
+  every time a remote folder is opened.
+
+  The cache file is binary, unlike the other cache files, and consists of the
+  usual text header line followed by (aligned) sorted table of UIDs, the table
+  of offsets of the records for these UIDs and the records themselves. This
+  means that the file can be simply mapped into memory when it is loaded and
+  the headers can be retrieved from it directly without parsing the entire
+  file first.
+
+  The file is tied to the UIDVALIDITY value of the folder and is discarded
+  if it changes. The message flags are stored in the cache too but as they
+  may have changed since the last session, the caller should resync them from
+  the server.
+
+  The headers retrieved during this session are kept in memory and written to
+  the file, together with the still existing old ones, by Flush().
+ */
+class HeaderCacheFile : public CacheFile
+{
+public:
+   /// create the cache for the given folder, call Open() to load it
+   HeaderCacheFile(const String& folderName);
+
+   virtual ~HeaderCacheFile();
+
+   /**
+     Load the cache file for the folder with the given UID validity.
+
+     If the file exists but has a different UID validity, its contents is
+     ignored and the file will be overwritten by Flush().
+
+     @return false only if an unexpected error occurred
+    */
+   bool Open(UIdType uidValidity);
+
+   /**
+     Save the cache contents to disk.
+
+     @param uids if non NULL, only the messages present in this (complete)
+                 index are saved, i.e. expunged messages are removed from
+                 the cache
+     @return true if ok, false on error
+    */
+   bool Flush(const UIdIndex *uids);
+
+   /**
+     @name Accessing the headers
+    */
+   //@{
+
+   /// return true if we have the header for the given UID
+   bool Has(UIdType uid) const { return FindRecord(uid) != NULL; }
+
+   /// fill in the header info with the cached data, return false if none
+   bool Get(UIdType uid, HeaderInfo& hi) const;
+
+   /// add the (valid) header info to the cache
+   void Add(const HeaderInfo& hi);
+
+   //@}
+
+protected:
+   // CacheFile methods we override to use binary format
+   virtual bool Load();
+   virtual bool Save();
+
+   // implement CacheFile pure virtuals
+   virtual String GetFileName() const;
+   virtual String GetFileHeader() const;
+   virtual int GetFormatVersion() const;
+
+   virtual bool DoLoad(const wxTextFile& file, int version);
+   virtual bool DoSave(wxTempFile& file);
+
+private:
+   /// free the file data
+   void Unmap();
+
+   /// get the number of records in the file
+   size_t GetFileCount() const;
+
+   /// get the table of UIDs in the file
+   const wxUint32 *GetFileUIds() const;
+
+   /// get the record for the given UID or NULL
+   const char *FindRecord(UIdType uid) const;
+
+   /// get the record with the given index in the file or NULL if invalid
+   const char *GetFileRecord(size_t n) const;
+
+
+   /// the name of the folder we're used for
+   String m_folderName;
+
+   /// the UID validity of the folder
+   wxUint32 m_uidValidity;
+
+   /**
+     @name The file data
+
+     The binary part of the file starts at m_offsetBin which is always a
+     multiple of 8.
+    */
+   //@{
+
+   MappedCacheFile m_file;
+   size_t m_offsetBin;
+
+   //@}
+
+   /// the records added during this session, already serialized
+   std::vector<char> m_added;
+
+   /// the offsets of the new records in m_added indexed by UID
+   typedef std::map<UIdType, size_t> AddedMap;
+   AddedMap m_offsetsAdded;
+
+   /// the record to be written by Save()
+   struct RecordToSave
+   {
+      wxUint32 uid;
+      const char *data;
+   };
+
+   /// the records to be written by Save(), filled by Flush()
+   std::vector<RecordToSave> m_toSave;
+
+   DECLARE_NO_COPY_CLASS(HeaderCacheFile)
+};
+
+#endif // _MAIL_HEADERCACHE_H_
@@ -0,0 +1,313 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/MailThreadPool.h: declaration of MailThreadPool class
+// Purpose:     MailThreadPool executes folder operations in worker threads
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_MAILTHREADPOOL_H_
+#define _MAIL_MAILTHREADPOOL_H_
+
+#include <wx/thread.h>
+#include <wx/atomic.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// MailLock: the lock serializing all accesses to the mail objects
+// ----------------------------------------------------------------------------
+
+/**
+  MailLock is the global lock which must be held by any thread using c-client
+  or any of our own mail classes, which are not MT-safe (and neither is their
+  reference counting).
+
+  The main thread holds it while handling any events and MailThreadPool
+  workers hold it while executing their tasks, so the operations done in the
+  background are serialized with everything else. To let the main thread run
+  while a worker is waiting for the server, the workers (but not the main
+  thread) release it while c-client is blocked on I/O, see SuspendForIO().
+
+  Notice that this means that the main thread may get the lock while a worker
+  is in the middle of an operation on some folder, so it still must not use
+  this folder before calling MailThreadPool::WaitForFolder() for it.
+
+  The lock is recursive, i.e. it may be entered by the thread already holding
+  it, and should normally be used via MailLocker and MailUnlocker classes.
+ */
+class MailLock
+{
+public:
+   /// acquire the lock, blocking until it becomes available
+   static void Enter();
+
+   /// release the lock acquired by Enter()
+   static void Leave();
+
+   /**
+     Release the lock completely, whatever the number of times it was entered.
+
+     @return the number of times the lock was entered by this thread, to be
+             passed to Reenter() later (0 if it wasn't held at all)
+    */
+   static size_t LeaveAll();
+
+   /// acquire the lock released by LeaveAll() again
+   static void Reenter(size_t count);
+
+   /**
+     @name c-client I/O notifications
+
+     These functions are called from c-client block notification callback
+     when it starts and stops waiting for the network (or a file lock).
+    */
+   //@{
+
+   /// release the lock before blocking if we're in a worker thread
+   static void SuspendForIO();
+
+   /// reacquire the lock released by SuspendForIO(), if any
+   static void ResumeAfterIO();
+
+   //@}
+};
+
+/// acquires MailLock in ctor and releases it in dtor
+class MailLocker
+{
+public:
+   MailLocker() { MailLock::Enter(); }
+   ~MailLocker() { MailLock::Leave(); }
+
+private:
+   DECLARE_NO_COPY_CLASS(MailLocker)
+};
+
+/// releases MailLock if it's held in ctor and reacquires it in dtor
+class MailUnlocker
+{
+public:
+   MailUnlocker() { m_count = MailLock::LeaveAll(); }
+   ~MailUnlocker() { if ( m_count ) MailLock::Reenter(m_count); }
+
+private:
+   size_t m_count;
+
+   DECLARE_NO_COPY_CLASS(MailUnlocker)
+};
+
+// ----------------------------------------------------------------------------
+// MailThreadPool: a bounded pool of threads executing the folder operations
+// ----------------------------------------------------------------------------
+
+/**
+  MailThreadPool executes the tasks, i.e. operations on the mail folders, in
+  the background threads.
+
+  The tasks for the same folder are always executed one at a time and in the
+  order in which they were queued, as the folder operations can't be done in
+  parallel and the later ones usually depend on the results of the earlier
+  ones. The tasks for different folders can run in parallel, but there can be
+  at most the given number of them running simultaneously for the folders on
+  the same server (all local folders are considered to be on the same "empty"
+  server) to avoid opening too many connections to it, and the total number of
+  threads is limited too.
+
+  The queued tasks can be cancelled: if the task hadn't started yet, it is
+  simply discarded, otherwise it is marked as cancelled and it is up to it to
+  check for this (and not deliver its result).
+
+  The pool doesn't deal with the task results at all, the tasks must deliver
+  them themselves, e.g. by sending an MEvent which is always dispatched in
+  the main thread.
+
+  The tasks are executed, and deleted, with MailLock held and the functions
+  waiting for the tasks to finish release it while waiting.
+ */
+class MailThreadPool
+{
+public:
+   /// the type of the task identifiers (ASMailFolder uses its tickets for them)
+   typedef int TaskId;
+
+   /**
+     The base class for the tasks executed by the pool.
+
+     The tasks are always allocated on the heap and the pool takes ownership
+     of them when they're queued, deleting them when they're done.
+    */
+   class Task
+   {
+   public:
+      Task() : m_cancelled(0) { }
+
+      virtual ~Task() { }
+
+      /// do the work, called from a worker thread
+      virtual void Execute() = 0;
+
+      /// return true if Cancel() had been called for this task
+      bool IsCancelled() const { return m_cancelled != 0; }
+
+   private:
+      /// non 0 if the task was cancelled, may be modified from other threads
+      wxAtomicInt m_cancelled;
+
+      friend class MailThreadPool;
+
+      DECLARE_NO_COPY_CLASS(Task)
+   };
+
+   /**
+     Create a new pool.
+
+     The threads are only created when the tasks are queued, so creating the
+     pool is cheap.
+
+     @param maxThreads the maximal total number of the worker threads
+     @param maxThreadsPerServer the maximal number of tasks running for the
+                                folders on the same server at once
+    */
+   MailThreadPool(size_t maxThreads, size_t maxThreadsPerServer);
+
+   /// dtor cancels all queued tasks and waits for the running ones
+   ~MailThreadPool();
+
+   /**
+     @name The global pool
+
+     The pool used for ASMailFolder operations.
+    */
+   //@{
+
+   /// get the global pool, creating it if necessary
+   static MailThreadPool *Get();
+
+   /// return true if the global pool had been already created
+   static bool IsCreated() { return ms_pool != NULL; }
+
+   /// delete the global pool, must be called before the program termination
+   static void CleanUp();
+
+   //@}
+
+   /**
+     Queue the task for execution.
+
+     @param task the task to execute, the pool takes ownership of it
+     @param id the identifier of the task, used by Cancel()
+     @param folder the key identifying the folder the task operates on
+     @param server the server of the folder or empty for the local ones
+    */
+   void Queue(Task *task,
+              TaskId id,
+              const void *folder,
+              const String& server);
+
+   /**
+     Cancel the task with the given identifier.
+
+     @return true if the task was found, false if it had already finished
+    */
+   bool Cancel(TaskId id);
+
+   /**
+     Wait until all the tasks queued for the given folder finish.
+
+     This is used before executing the operations which must be done in the
+     main thread to preserve the order of operations on the folder.
+    */
+   void WaitForFolder(const void *folder);
+
+   /// wait until all the queued tasks finish
+   void WaitForAll();
+
+   /// return true if there are any tasks queued for the given folder
+   bool HasTasksFor(const void *folder);
+
+private:
+   /// a task together with the information about it
+   struct TaskInfo
+   {
+      Task *task;
+      TaskId id;
+
+      /// serial number of the task used to execute them in FIFO order
+      unsigned long serial;
+   };
+
+   /// the queue of tasks for a single folder
+   struct FolderQueue
+   {
+      FolderQueue() { running = NULL; }
+
+      /// the tasks which hadn't been started yet
+      std::deque<TaskInfo> tasks;
+
+      /// the task currently being executed or NULL
+      TaskInfo *running;
+
+      /// the server of this folder
+      String server;
+   };
+
+   typedef std::map<const void *, FolderQueue> FolderQueues;
+
+   /// the worker thread class
+   class Worker;
+
+   /// the function executed by the worker threads
+   void WorkerLoop();
+
+   /// find the next task which can be started now, the mutex must be locked
+   FolderQueues::iterator FindRunnable();
+
+   /// count the tasks which could be started now, the mutex must be locked
+   size_t CountRunnable() const;
+
+
+   /// the tasks for all folders
+   FolderQueues m_queues;
+
+   /// the number of tasks running for each server
+   std::map<String, size_t> m_runningPerServer;
+
+   /// all the worker threads we created
+   std::vector<wxThread *> m_threads;
+
+   /// the number of worker threads waiting for a task
+   size_t m_countIdle;
+
+   /// the limits we were created with
+   const size_t m_maxThreads,
+                m_maxThreadsPerServer;
+
+   /// the serial number of the next task
+   unsigned long m_serial;
+
+   /// true if the pool is being destroyed
+   bool m_stopping;
+
+   /// protects all the data above
+   wxMutex m_mutex;
+
+   /// signalled when a task may have become runnable
+   wxCondition m_condTask;
+
+   /// signalled when a task finishes
+   wxCondition m_condDone;
+
+   /// the global pool or NULL
+   static MailThreadPool *ms_pool;
+
+   DECLARE_NO_COPY_CLASS(MailThreadPool)
+};
+
+#endif // _MAIL_MAILTHREADPOOL_H_
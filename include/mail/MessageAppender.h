@@ -0,0 +1,171 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/MessageAppender.h: declaration of MessageAppender class
+// Purpose:     MessageAppender appends many messages to a mailbox at once
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_MESSAGEAPPENDER_H_
+#define _MAIL_MESSAGEAPPENDER_H_
+
+#ifndef USE_PCH
+#  include "Mcclient.h"
+#endif // USE_PCH
+
+#include <string>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// MessageAppender: appends messages to a mailbox in batches
+// ----------------------------------------------------------------------------
+
+/**
+  MessageAppender is used for appending many messages to the same mailbox,
+  e.g. when copying them between folders on different servers.
+
+  The messages are retrieved from the source in batches and each batch is
+  given to a single mail_append_multiple() call. The IMAP servers supporting
+  MULTIAPPEND (RFC 3502) receive the whole batch in one APPEND command and the
+  local drivers write it while keeping the mailbox open and locked. For the
+  other IMAP servers c-client still sends one APPEND per message and waits for
+  the reply to each of them before sending the next one.
+
+  If appending a batch fails, the messages of the batch which may not have
+  been appended are appended again one by one, so that a single bad message
+  doesn't prevent the others from being saved. Which messages these are
+  depends on whether the target is atomic: if it is, nothing was appended and
+  the whole batch is retried, otherwise all messages before the failed one had
+  been appended and only the remaining ones are.
+
+  This class is not thread-safe but it can be used from any thread.
+ */
+class MessageAppender
+{
+public:
+   /// the message to append
+   struct Data
+   {
+      /// the full message text
+      std::string text;
+
+      /// the message flags in IMAP format, may be empty
+      std::string flags;
+
+      /// the internal date in IMAP format or empty to use the current one
+      std::string date;
+   };
+
+   /// the messages to append are retrieved from Source
+   class Source
+   {
+   public:
+      /**
+        Retrieve the given message.
+
+        @param n the index of the message, from 0 to the count passed to
+                 Append()
+        @param data filled with the message data
+        @return false if the message couldn't be retrieved, it is then
+                counted as failed
+       */
+      virtual bool GetMessage(size_t n, Data& data) = 0;
+
+      /**
+        Called before retrieving the message with the given index.
+
+        @return false to cancel appending
+       */
+      virtual bool OnRetrieve(size_t WXUNUSED(n)) { return true; }
+
+      /**
+        Called after appending all messages before the given index.
+
+        @return false to cancel appending
+       */
+      virtual bool OnAppended(size_t WXUNUSED(n)) { return true; }
+
+      virtual ~Source() { }
+   };
+
+   /**
+     Create the appender for the given mailbox.
+
+     @param stream the stream to use, may be NULL for the local mailboxes
+     @param mailbox the full c-client mailbox specification
+     @param atomic true if failing to append a batch means that none of its
+                   messages were appended
+    */
+   MessageAppender(MAILSTREAM *stream, const char *mailbox, bool atomic);
+
+   /**
+     Change the maximal number of messages and their total size in a batch.
+
+     The messages of a batch are kept in memory until it is appended, the
+     default limits are 100 messages and 8MB.
+    */
+   void SetBatchLimits(size_t count, size_t size);
+
+   /**
+     Append the messages from the given source.
+
+     Errors for the individual messages are not logged by this function
+     (although c-client still logs its own errors), the caller should report
+     them, if needed, using the indices returned in failed.
+
+     @param source the source of the messages
+     @param count the number of messages to append
+     @param failed filled with the indices of the messages which couldn't be
+                   appended
+     @return true if all messages were appended, false if some of them
+             couldn't be or if the operation was cancelled
+    */
+   bool Append(Source& source, size_t count, std::vector<size_t>& failed);
+
+   /// return true if the last call to Append() was cancelled
+   bool WasCancelled() const { return m_cancelled; }
+
+   /**
+     @name Statistics
+    */
+   //@{
+
+   /// get the number of batches given to c-client
+   size_t GetBatchCount() const { return m_countBatches; }
+
+   /// get the number of messages appended one by one after a batch failed
+   size_t GetRetryCount() const { return m_countRetries; }
+
+   //@}
+
+private:
+   /// append the given message on its own
+   bool AppendOne(const Data& data);
+
+
+   /// the stream and the mailbox to append to
+   MAILSTREAM * const m_stream;
+   const std::string m_mailbox;
+
+   /// true if a failed batch didn't append anything
+   const bool m_atomic;
+
+   /// the batch limits
+   size_t m_maxCount,
+          m_maxSize;
+
+   /// true if the last Append() was cancelled
+   bool m_cancelled;
+
+   /// the statistics
+   size_t m_countBatches,
+          m_countRetries;
+
+   DECLARE_NO_COPY_CLASS(MessageAppender)
+};
+
+#endif // _MAIL_MESSAGEAPPENDER_H_
@@ -0,0 +1,269 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/MimeCodec.h: Base64 and quoted-printable codecs
+// Author:      Mahogany team
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef M_MAIL_MIMECODEC_H
+#define M_MAIL_MIMECODEC_H
+
+#include <stddef.h>
+
+#include <vector>
+
+/**
+   Base64 and quoted-printable content transfer encodings.
+
+   These functions replace c-client rfc822_base64(), rfc822_qprint(),
+   rfc822_binary() and rfc822_8bit() everywhere in Mahogany as they are much
+   faster: they process the data in blocks using SIMD instructions if the CPU
+   supports them. The decoding functions and rfc822_8bit() replacement give
+   the same results as c-client, but EncodeBase64() output differs from
+   rfc822_binary() one in some cases, see its documentation.
+
+   Unlike the c-client functions, they don't allocate memory themselves but
+   write the output to the buffer provided by the caller, which must be big
+   enough, as returned by the corresponding GetXXXMaxLen() function. This
+   allows the caller to reserve extra space in the buffer if needed.
+ */
+namespace MIME
+{
+
+/**
+   The available codec implementations.
+
+   The best implementation supported by the CPU is used by default, the other
+   ones are only useful for testing.
+ */
+enum Codec
+{
+   Codec_Scalar,
+   Codec_SSE2,
+   Codec_AVX2,
+   Codec_Max
+};
+
+/// Return the codec implementation currently used.
+Codec GetCodec();
+
+/**
+   Change the codec implementation used.
+
+   @param codec the implementation to use
+   @return false if this implementation is not supported on this machine
+ */
+bool SetCodec(Codec codec);
+
+/// Return the human-readable name of the given codec, e.g. "SSE2".
+const char *GetCodecName(Codec codec);
+
+/**
+   @name Base64
+ */
+//@{
+
+/// Return the maximal size of the data decoded from Base64 text of given size.
+inline size_t GetBase64DecodedMaxLen(size_t len) { return (len / 4)*3 + 4; }
+
+/**
+   Decode Base64 data.
+
+   Whitespace in the input is ignored, any other invalid characters result in
+   an error. Anything following the padding at the end of data is ignored.
+
+   @param src the data to decode
+   @param len the length of the data
+   @param dst the output buffer of at least GetBase64DecodedMaxLen(len) bytes
+   @param lenDst receives the length of the decoded data
+   @return true if ok, false if the data wasn't valid Base64
+ */
+bool DecodeBase64(const void *src, size_t len, void *dst, size_t *lenDst);
+
+/**
+   Return the maximal size of Base64 encoding of the data of the given size.
+
+   @param len the length of the data to encode
+   @param lineLen the same parameter as passed to EncodeBase64()
+ */
+inline size_t GetBase64EncodedMaxLen(size_t len, size_t lineLen = 0)
+{
+   const size_t lenEnc = ((len + 2) / 3)*4;
+   return lineLen ? lenEnc + 2*((lenEnc + lineLen - 1) / lineLen) : lenEnc;
+}
+
+/**
+   Encode data in Base64.
+
+   Notice that the output differs from that of rfc822_binary(), which always
+   uses lines of 60 characters, even for this line length: rfc822_binary()
+   adds an extra empty line when the last line is full, i.e. when the length
+   of the encoded data (including the padding) is a multiple of 60, and
+   returns a single CRLF for empty input, while this function does neither.
+
+   @param src the data to encode
+   @param len the length of the data
+   @param dst the output buffer of at least GetBase64EncodedMaxLen() bytes
+   @param lineLen if non-zero, the output is split into lines of this length
+                  (which must be a multiple of 4) terminated by CRLF,
+                  otherwise no line breaks are inserted
+   @return the length of the encoded data
+ */
+size_t EncodeBase64(const void *src, size_t len, void *dst, size_t lineLen = 0);
+
+//@}
+
+/**
+   @name Quoted-printable
+ */
+//@{
+
+/// Return the maximal size of the data decoded from QP text of given size.
+inline size_t GetQPDecodedMaxLen(size_t len) { return len; }
+
+/**
+   Decode quoted-printable data.
+
+   Invalid escape sequences are left as is and the trailing whitespace at the
+   end of lines is removed, as required by RFC 2045. This function never fails.
+
+   @param src the data to decode
+   @param len the length of the data
+   @param dst the output buffer of at least GetQPDecodedMaxLen(len) bytes
+   @return the length of the decoded data
+ */
+size_t DecodeQP(const void *src, size_t len, void *dst);
+
+/// Return the maximal size of QP encoding of the data of the given size.
+inline size_t GetQPEncodedMaxLen(size_t len)
+{
+   // 3 bytes per character and a soft line break for every 75 bytes of output
+   return 3*len + 3*((3*len) / 75 + 1);
+}
+
+/**
+   Encode data in quoted-printable.
+
+   The CRLF pairs in the input are preserved as line breaks, all other
+   control characters and 8 bit characters are encoded and soft line breaks
+   are inserted to keep the lines shorter than 76 characters.
+
+   @param src the data to encode
+   @param len the length of the data
+   @param dst the output buffer of at least GetQPEncodedMaxLen(len) bytes
+   @return the length of the encoded data
+ */
+size_t EncodeQP(const void *src, size_t len, void *dst);
+
+//@}
+
+/**
+   Incremental decoder for the data arriving in chunks.
+
+   This class allows to decode Base64 or quoted-printable data without having
+   all of it in memory at once: the incomplete Base64 quantum or QP line at
+   the end of each chunk is kept until the next one arrives, so that the
+   result is the same as if all the data were decoded at once by
+   DecodeBase64() or DecodeQP().
+
+   The only exception is invalid Base64 data, which can't be rejected as a
+   whole once a part of it has been already decoded: instead, everything
+   starting from the first invalid character is returned verbatim in this
+   case and HasErrors() returns true.
+ */
+class StreamDecoder
+{
+public:
+   /// The encodings supported by the decoder.
+   enum Encoding
+   {
+      Encoding_Base64,
+      Encoding_QP
+   };
+
+   /**
+      Create the decoder for the given encoding.
+
+      @param encoding the encoding of the data
+      @param keepTrailing if true, the text following the padding at the end
+                          of Base64 data (and the line break right after it)
+                          is returned verbatim instead of being ignored, this
+                          is useful for the mailing list footers appended to
+                          the Base64-encoded messages
+    */
+   StreamDecoder(Encoding encoding, bool keepTrailing = false);
+
+   /**
+      Decode the next chunk of data.
+
+      @param src the data to decode
+      @param len the length of the data
+      @param lenDst receives the length of the decoded data, may be 0
+      @return the decoded data, only valid until the next call
+    */
+   const void *Decode(const void *src, size_t len, size_t *lenDst);
+
+   /**
+      Decode the data remaining at the end of input.
+
+      This must be called once after the last call to Decode().
+
+      @param lenDst receives the length of the decoded data, may be 0
+      @return the decoded data, only valid until the next call
+    */
+   const void *Flush(size_t *lenDst);
+
+   /// Return true if the data was invalid and wasn't decoded entirely.
+   bool HasErrors() const { return m_hasErrors; }
+
+private:
+   // the state of Base64 decoder
+   enum State
+   {
+      State_Data,       // decoding the data
+      State_Padding,    // got '=', waiting for the rest of the padding
+      State_Verbatim,   // copying the rest of the input as is
+      State_Done        // ignoring the rest of the input
+   };
+
+   // decode the chunk of Base64 or QP data
+   void DecodeBase64Chunk(const unsigned char *s, size_t len);
+   void DecodeQPChunk(const unsigned char *s, size_t len);
+
+   // decode the first len characters of m_pending and remove them from it
+   void DecodePending(size_t len);
+
+   // handle the end of Base64 data in State_Padding
+   void DecodePadding(bool flush);
+
+   // append the data to m_out
+   void Output(const unsigned char *s, size_t len);
+
+   // return the decoded data
+   const void *GetOutput(size_t *lenDst) const;
+
+
+   const Encoding m_encoding;
+   const bool m_keepTrailing;
+
+   State m_state;
+
+   // the number of Base64 characters preceding the padding in m_pending
+   size_t m_lenQuantum;
+
+   bool m_hasErrors;
+
+   // the data not decoded yet: the significant characters of the incomplete
+   // Base64 quantum, followed by the padding, or the incomplete QP line
+   std::vector<unsigned char> m_pending;
+
+   // the buffer for the decoded data
+   std::vector<unsigned char> m_out;
+};
+
+} // namespace MIME
+
+#endif // M_MAIL_MIMECODEC_H
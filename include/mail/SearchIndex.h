@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/SearchIndex.h: declaration of MsgSearchIndex class
+// Purpose:     MsgSearchIndex allows to search messages without the server
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_SEARCHINDEX_H_
+#define _MAIL_SEARCHINDEX_H_
+
+#include "MSearch.h"
+#include "MThread.h"
+
+#include <map>
+#include <vector>
+
+class FolderSearchIndex;
+
+// ----------------------------------------------------------------------------
+// MsgSearchIndex: inverted index of the message text for all folders
+// ----------------------------------------------------------------------------
+
+/**
+  MsgSearchIndex is a full text index allowing to find the messages
+  containing the given words without retrieving them from the server.
+
+  The index is kept separately for each folder and maps the words (which are
+  sequences of alphanumeric characters converted to lower case) occurring in
+  the message text or headers to the sorted lists of UIDs of the messages
+  containing them. The index for each folder is stored in its own file in the
+  "index" subdirectory of the local directory and is tied to the UID validity
+  of the folder, so it can only be used for the folders with persistent UIDs.
+
+  The index is incremental: the messages are added to it when their text or
+  headers are retrieved for any reason, so only the messages which had never
+  been seen before need to be retrieved when searching.
+
+  Note that the index is only used to find the messages which may contain
+  the search string: it is case-insensitive and doesn't take the order of
+  words in the search string into account, i.e. it finds all messages
+  containing all of them (the first word may be just the end of the word in
+  the message and the last one its beginning, as with substring search), so
+  the messages it finds still need to be checked by the caller. But the
+  messages which it doesn't find are guaranteed not to contain the string.
+
+  This is a singleton class which can be used from multiple threads.
+ */
+class MsgSearchIndex
+{
+public:
+   /// the parts of the message which can be indexed
+   enum Part
+   {
+      Part_Text,
+      Part_Header,
+      Part_Max
+   };
+
+   /**
+     Create the single object of this class.
+
+     This must be called during the program startup, before any worker
+     threads which could use the index are started.
+    */
+   static void Init();
+
+   /**
+     This is a singleton class and this function is the only way to access it.
+
+     Returns NULL if called before Init() or after CleanUp().
+    */
+   static MsgSearchIndex *Get();
+
+   /**
+     Delete the single object of this class, saving the index to disk.
+
+     This must be called exactly once before the program termination (it's ok
+     to call it even if Init() had been never called).
+    */
+   static void CleanUp();
+
+   /**
+     Save all modified indices to disk (always safe to call).
+
+     Only the messages indexed since the last call are usually appended to
+     the index files, they are rewritten entirely only from time to time.
+    */
+   static void Flush();
+
+   /**
+     Return the part of the message to use for the given search criterium or
+     Part_Max if the index can't be used for it at all.
+    */
+   static Part GetPartFor(SearchCriterium::Type what);
+
+   /**
+     Return true if the given string can be searched for using the index.
+
+     This is false for the strings not containing any words at all or
+     containing too long ones, as they're not indexed.
+    */
+   static bool CanSearchFor(const String& key);
+
+   /**
+     @name Indexing messages
+
+     All these methods take the folder name and its UID validity: if the
+     latter is different from the value stored in the index, it is cleared.
+    */
+   //@{
+
+   /// return true if the given part of the message had been already indexed
+   bool IsIndexed(const String& folderName,
+                  UIdType uidValidity,
+                  Part part,
+                  UIdType uid);
+
+   /// add the given part of the message to the index (if it's not there yet)
+   void Add(const String& folderName,
+            UIdType uidValidity,
+            Part part,
+            UIdType uid,
+            const String& text);
+
+   /**
+     Forget all the messages not in the given array.
+
+     @param uids the sorted array of all the UIDs in the folder
+    */
+   void Retain(const String& folderName,
+               UIdType uidValidity,
+               const std::vector<UIdType>& uids);
+
+   //@}
+
+   /**
+     Find the indexed messages which may contain the given string.
+
+     All the other indexed messages don't contain it, but the messages found
+     must still be checked as they may contain the words of the string in a
+     different order or case or separated by different characters. The
+     messages which are not indexed yet must be checked as well.
+
+     @param folderName the folder to search in
+     @param uidValidity its UID validity
+     @param part the part of messages to search in
+     @param key the string to search for, CanSearchFor() must return true
+     @param uids filled with the sorted UIDs of the messages found
+     @param uidsIndexed filled with the sorted UIDs of all indexed messages
+     @return true if ok, false if the index can't be used
+    */
+   bool Search(const String& folderName,
+               UIdType uidValidity,
+               Part part,
+               const String& key,
+               std::vector<UIdType>& uids,
+               std::vector<UIdType>& uidsIndexed);
+
+private:
+   /// private ctor, use Get()
+   MsgSearchIndex() { }
+
+   /// private dtor, use CleanUp()
+   ~MsgSearchIndex();
+
+   /// save all modified indices, must be called with the mutex locked
+   void DoFlush();
+
+   /// get the index for the given folder, loading it if necessary
+   FolderSearchIndex *GetFolderIndex(const String& folderName,
+                                     UIdType uidValidity);
+
+   /// the indices of all folders we used, loaded on demand
+   typedef std::map<String, FolderSearchIndex *> FolderIndices;
+   FolderIndices m_folders;
+
+   /// protects all our data as we can be used from the worker threads
+   MTMutex m_mutex;
+
+   DECLARE_NO_COPY_CLASS(MsgSearchIndex)
+};
+
+#endif // _MAIL_SEARCHINDEX_H_
@@ -0,0 +1,152 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/SendSession.h: declaration of SendSession class
+// Purpose:     SendSession keeps SMTP/NNTP connections open between messages
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_SENDSESSION_H_
+#define _MAIL_SENDSESSION_H_
+
+#ifndef USE_PCH
+#  include "Mcclient.h"
+#  include "FolderType.h"
+#endif // USE_PCH
+
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// SendSession: delivers messages reusing the connections to the servers
+// ----------------------------------------------------------------------------
+
+/**
+  SendSession is used for sending many messages at once, e.g. when the outbox
+  is flushed.
+
+  Without it, a new connection to the server is established for each message
+  sent, which means redoing TLS negotiation and authentication every time.
+  SendSession keeps the connections open until it is destroyed instead, so
+  that all messages sent using the same server are sent over one connection.
+
+  If sending a message over a previously used connection fails because the
+  server closed it in the meanwhile (e.g. due to inactivity timeout), the
+  message is sent again using a new connection, so the caller doesn't need
+  to handle this.
+
+  The SMTP commands are pipelined (RFC 2920) if the server supports it, but
+  this is done by c-client smtp_mail() itself and so happens even when the
+  session is used for sending just a single message.
+
+  This class is not thread-safe but it can be used from any thread.
+ */
+class SendSession
+{
+public:
+   /// the time it took to send the last message
+   struct Timing
+   {
+      /// time spent connecting to the server in ms, 0 if none was needed
+      long msConnect;
+
+      /// time spent sending the message itself in ms
+      long msSend;
+
+      /// true if the message had to be sent again using a new connection
+      bool retried;
+   };
+
+   SendSession();
+
+   /// the dtor closes all connections
+   ~SendSession();
+
+   /**
+     Send a message using SMTP or NNTP.
+
+     @param protocol either Prot_SMTP or Prot_NNTP
+     @param server the server specification in c-client format, as accepted
+                   by smtp_open_full() and nntp_open_full()
+     @param options the options for opening the server (SOP_XXX)
+     @param env the envelope of the message
+     @param body the body of the message
+     @param reply filled with the last server reply if not NULL
+     @return true if the message was sent successfully
+    */
+   bool Send(Protocol protocol,
+             const String& server,
+             long options,
+             ENVELOPE *env,
+             BODY *body,
+             String *reply = NULL);
+
+   /// close all the connections, they are reopened when needed
+   void Close();
+
+   /**
+     @name Statistics
+    */
+   //@{
+
+   /// get the timing information for the last call to Send()
+   const Timing& GetLastTiming() const { return m_timing; }
+
+   /// get the number of messages sent successfully
+   size_t GetMessageCount() const { return m_countMessages; }
+
+   /// get the number of connections opened
+   size_t GetConnectionCount() const { return m_countConnections; }
+
+   //@}
+
+private:
+   /// an open connection to a server
+   struct Connection
+   {
+      Protocol protocol;
+      String server;
+      long options;
+      SENDSTREAM *stream;
+   };
+
+   /// find an existing connection or return NULL
+   Connection *FindConnection(Protocol protocol,
+                              const String& server,
+                              long options);
+
+   /// open a new connection, returns NULL on failure
+   static SENDSTREAM *Open(Protocol protocol,
+                           const String& server,
+                           long options);
+
+   /// send the message over the given stream
+   static bool DoSend(Protocol protocol,
+                      SENDSTREAM *stream,
+                      ENVELOPE *env,
+                      BODY *body);
+
+   /// return true if the connection was closed by the server
+   static bool IsConnectionLost(Protocol protocol, SENDSTREAM *stream);
+
+   /// close the given stream
+   static void CloseStream(Protocol protocol, SENDSTREAM *stream);
+
+
+   /// all open connections
+   std::vector<Connection> m_connections;
+
+   /// the timing of the last message
+   Timing m_timing;
+
+   /// the statistics
+   size_t m_countMessages,
+          m_countConnections;
+
+   DECLARE_NO_COPY_CLASS(SendSession)
+};
+
+#endif // _MAIL_SENDSESSION_H_
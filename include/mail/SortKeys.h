@@ -0,0 +1,167 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/SortKeys.h: declaration of MsgSortKeys class
+// Purpose:     MsgSortKeys caches the keys used for sorting the messages
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_SORTKEYS_H_
+#define _MAIL_SORTKEYS_H_
+
+#ifndef USE_PCH
+#  include "Sorting.h"
+#endif // USE_PCH
+
+#include <vector>
+
+class HeaderInfoList;
+
+// ----------------------------------------------------------------------------
+// MsgSortKeys: local sorting engine used by MailFolderCmn::SortMessages()
+// ----------------------------------------------------------------------------
+
+/**
+  MsgSortKeys stores the sort keys for all messages of a HeaderInfoList in
+  columns indexed by the message index.
+
+  The keys are computed only once per message: the subject is normalized and
+  the sender is found using HeaderInfo::GetFromOrTo() (and both of them are
+  converted to lower case) when the message is sorted for the first time, and
+  all the subsequent comparisons just compare the precomputed values. The
+  columns are kept in sync with the listing by OnAdd() and OnRemove() which
+  must be called by its owner.
+
+  Additionally, we remember the result of the last sort and if only new
+  messages were added to the folder since then, Sort() only sorts the new
+  messages and merges them with the existing (sorted) ones instead of
+  resorting everything.
+
+  As this object belongs to a single listing, it doesn't need any locking
+  unlike the old global data used with qsort().
+ */
+class MsgSortKeys
+{
+public:
+   MsgSortKeys();
+
+   /**
+     @name Synchronization with the listing
+    */
+   //@{
+
+   /// called when the message with the given index is expunged
+   void OnRemove(MsgnoType idx);
+
+   /// called when the number of messages in the folder increases
+   void OnAdd(MsgnoType countNew);
+
+   /// forget all cached keys, called when the folder is closed
+   void Clear();
+
+   //@}
+
+   /**
+     Sort the messages of the given listing.
+
+     This function uses the headers of the listing to compute the keys for
+     the messages which don't have them yet, so it is supposed that all of
+     them had been already cached by the caller.
+
+     @param hil the listing we're associated with
+     @param msgnos the array of hil->Count() elements filled with the msgnos
+                   in the sorted order on return
+     @param sortParams the sort parameters
+     @return true if ok, false on error
+    */
+   bool Sort(const HeaderInfoList *hil,
+             MsgnoType *msgnos,
+             const SortParams& sortParams);
+
+private:
+   /// a single sorting criterium
+   struct Criterium
+   {
+      MessageSortOrder crit;
+      bool reverse;
+   };
+
+   /// the criteria used for sorting, as extracted from SortParams::sortOrder
+   typedef std::vector<Criterium> Criteria;
+
+   /// the bits in m_state
+   enum
+   {
+      /// date, size and status have been computed
+      Key_Basic = 1,
+
+      /// subject has been computed
+      Key_Subject = 2,
+
+      /// sender has been computed
+      Key_Sender = 4,
+
+      /// the header was invalid when we tried to compute the keys
+      Key_Invalid = 8
+   };
+
+   /// comparison function object used with std::stable_sort()
+   class Comparator;
+
+   /// compute the keys needed for the given message
+   void ComputeKeys(const HeaderInfoList *hil,
+                    MsgnoType idx,
+                    const SortParams& sortParams,
+                    int keysNeeded);
+
+   /// update the status column and return true if anything changed in it
+   bool RefreshStatus(const HeaderInfoList *hil);
+
+   /// forget the result of the last sort
+   void ForgetOrder();
+
+   /**
+     @name The key columns
+
+     All of them have the same number of elements, equal to the number of
+     messages in the listing, but only the keys for which the corresponding
+     bit in m_state is set are valid.
+    */
+   //@{
+
+   std::vector<String> m_subjects,
+                       m_senders;
+   std::vector<time_t> m_dates;
+   std::vector<unsigned long> m_sizes;
+   std::vector<int> m_statuses;
+   std::vector<unsigned char> m_state;
+
+   //@}
+
+   /// the own addresses parameters used for computing m_senders
+   bool m_senderDetectOwn;
+   wxArrayString m_senderOwnAddresses;
+
+   /**
+     @name The result of the last sort
+
+     m_order contains the msgnos in the sorted order, it is updated when the
+     messages are removed from the listing but new messages are not added to
+     it until the next call to Sort().
+    */
+   //@{
+
+   std::vector<MsgnoType> m_order;
+   SortParams m_orderParams;
+
+   /// true if m_order contained some invalid headers when it was built
+   bool m_orderHasInvalid;
+
+   //@}
+};
+
+#endif // _MAIL_SORTKEYS_H_
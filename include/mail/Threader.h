@@ -0,0 +1,366 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/Threader.h: declaration of MsgThreader class
+// Purpose:     MsgThreader incrementally threads the messages of a listing
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_THREADER_H_
+#define _MAIL_THREADER_H_
+
+#include <vector>
+
+struct ThreadParams;
+
+// ----------------------------------------------------------------------------
+// MsgThreader: local threading engine used by MailFolderCmn::ThreadMessages()
+// ----------------------------------------------------------------------------
+
+/**
+  MsgThreader implements the JWZ threading algorithm (see
+  http://www.jwz.org/doc/threading.html) in a way which allows to rethread
+  the messages cheaply when the listing changes.
+
+  The containers for all Message-IDs seen in the headers of the messages and
+  the links between them built from the References headers are kept between
+  the calls to Thread(), so only the messages added to the listing since the
+  last call need to be examined. Adding a message takes time proportional to
+  the number of its references (and the depth of the thread it belongs to),
+  and all the other steps of the algorithm (pruning the empty containers,
+  breaking the threads on subject change and gathering the messages with the
+  same subject) are done in linear time without any recursion by Thread()
+  itself.
+
+  The Message-IDs and the subjects are interned: they are stored in a single
+  buffer and are only referred to by their numeric ids, so comparing them is
+  cheap. The containers live in an array and also refer to each other by
+  their indices in it.
+
+  When a message is removed from the listing, its container just becomes
+  empty but the links between the containers created from its references are
+  kept, so the messages it linked together remain in the same thread. After
+  many messages have been removed, everything is rebuilt from scratch during
+  the next call to Thread() to free the space taken by the unused containers.
+ */
+class MsgThreader
+{
+public:
+   /// the headers of a message used for threading it
+   struct Headers
+   {
+      /// the Message-ID header
+      String id;
+
+      /// the contents of References and In-Reply-To headers, in this order
+      String references;
+
+      /// the subject with the reply and the mailing list prefixes removed
+      String subject;
+
+      /// true if the subject had any reply prefixes
+      bool isReply;
+   };
+
+   /// the interface used by Thread() to get the headers of the new messages
+   class Source
+   {
+   public:
+      /// get the headers of the message with the given index
+      virtual void GetHeaders(MsgnoType idx, Headers& headers) const = 0;
+
+      virtual ~Source() { }
+   };
+
+   /// identifies a node of the thread tree built by Thread()
+   typedef size_t NodeId;
+
+   /// the invalid value for NodeId
+   static const NodeId NO_NODE = (size_t)-1;
+
+   MsgThreader();
+
+   /**
+     @name Synchronization with the listing
+    */
+   //@{
+
+   /// called when the message with the given index is expunged
+   void OnRemove(MsgnoType idx);
+
+   /// called when the number of messages in the folder increases
+   void OnAdd(MsgnoType countNew);
+
+   /// forget all messages, called when the folder is closed
+   void Clear();
+
+   //@}
+
+   /**
+     Thread the messages.
+
+     The messages added since the last call are inserted into the existing
+     threads and then the thread tree is built. The tree is kept until the
+     next call to this function and can be examined using the functions
+     below.
+
+     @param source used to get the headers of the new messages, which must
+                   have been already cached
+     @param thrParams the threading parameters
+    */
+   void Thread(const Source& source, const ThreadParams& thrParams);
+
+   /**
+     @name Accessing the thread tree
+
+     The tree consists of the nodes corresponding to the messages and the
+     dummy nodes which are created when several threads with the same subject
+     are gathered together or for the roots of the threads whose first message
+     is not in the folder.
+
+     The tree is only valid until the listing changes. The node ids are less
+     than GetNodeCount() but not all of them are used by the tree, use
+     IsUsed() to check for this.
+    */
+   //@{
+
+   /// return the total number of node ids
+   size_t GetNodeCount() const { return m_nodes.size(); }
+
+   /// return the first top level node or NO_NODE if there are no messages
+   NodeId GetFirstRoot() const
+      { return m_nodes.empty() ? NO_NODE : m_nodes[ROOT_NODE].child; }
+
+   /// return true if this node is used, i.e. part of the tree
+   bool IsUsed(NodeId node) const { return m_nodes[node].parent != NO_NODE; }
+
+   /// return the first child of the node or NO_NODE
+   NodeId GetFirstChild(NodeId node) const { return m_nodes[node].child; }
+
+   /// return the next sibling of the node or NO_NODE
+   NodeId GetNext(NodeId node) const { return m_nodes[node].next; }
+
+   /// return the index of the message of this node or NO_MESSAGE for dummies
+   MsgnoType GetIndex(NodeId node) const { return m_nodes[node].idx; }
+
+   //@}
+
+   /// the value returned by GetIndex() for the dummy nodes
+   static const MsgnoType NO_MESSAGE = (MsgnoType)-1;
+
+private:
+   /// the index of an interned string or a container
+   typedef size_t Id;
+
+   /// the invalid value for Id
+   static const Id NO_ID = (size_t)-1;
+
+   /// the (fake) root of the thread tree
+   static const NodeId ROOT_NODE = 0;
+
+   /**
+     Interned strings table.
+
+     This is a simple hash table using open addressing and storing the
+     strings themselves in a single buffer. It associates an Id with each
+     string added to it.
+    */
+   class InternTable
+   {
+   public:
+      InternTable() { m_countUsed = 0; }
+
+      /// remove all strings from the table
+      void Clear();
+
+      /// return the Id of the string or NO_ID if not found
+      Id Find(const char *s, size_t len) const;
+
+      /// add a string which must not be in the table yet
+      void Add(const char *s, size_t len, Id value);
+
+   private:
+      struct Slot
+      {
+         size_t offset;
+         size_t len;
+         Id value;
+      };
+
+      static size_t Hash(const char *s, size_t len);
+
+      size_t FindSlot(const char *s, size_t len) const;
+
+      void Grow();
+
+      std::vector<char> m_chars;
+      std::vector<Slot> m_slots;
+      size_t m_countUsed;
+   };
+
+   /**
+     A container corresponds to a Message-ID: either of a message in the
+     listing or one of the references of these messages.
+    */
+   struct Container
+   {
+      /// the message index or NO_MESSAGE if the container is empty, the index
+      /// is only updated by Thread() after the messages are removed
+      MsgnoType idx;
+
+      /// the links to the other containers, NO_ID if none
+      Id parent,
+         child,
+         prev,
+         next;
+   };
+
+   /// the information about a message which was inserted into the tree
+   struct MessageInfo
+   {
+      /// the container of this message
+      Id container;
+
+      /// the interned simplified subject or NO_ID if it is empty
+      Id subject;
+
+      /// true if the subject had reply prefixes
+      bool isReply;
+   };
+
+   /// a node of the thread tree built by Thread()
+   struct Node
+   {
+      /// the message index or NO_MESSAGE for dummies
+      MsgnoType idx;
+
+      /// the message whose subject is used for this node
+      MsgnoType idxSubject;
+
+      /// the links to the other nodes, the unused nodes have NO_NODE parent
+      NodeId parent,
+             child,
+             last,
+             prev,
+             next;
+
+      /// the number of children of this node
+      size_t countChildren;
+   };
+
+   /**
+     @name Persistent data
+    */
+   //@{
+
+   /// insert the message with the given index into the containers
+   void Insert(MsgnoType idx, const Headers& headers);
+
+   /// create a new empty container
+   Id NewContainer();
+
+   /// get the container for the given Message-ID, creating it if necessary
+   Id GetContainer(const char *id, size_t len);
+
+   /// make the container a child of another one
+   void LinkContainer(Id parent, Id child);
+
+   /// remove the container from the children of its parent
+   void UnlinkContainer(Id container);
+
+   /// return true if the first container is an ancestor of the second one
+   bool IsAncestorContainer(Id ancestor, Id container) const;
+
+   /// forget everything, called when too many messages were removed
+   void ClearContainers();
+
+   /// the containers for all Message-IDs
+   std::vector<Container> m_containers;
+
+   /// the inserted messages indexed by their indices in the listing
+   std::vector<MessageInfo> m_messages;
+
+   /// Message-ID -> container index
+   InternTable m_ids;
+
+   /// subject -> subject index
+   InternTable m_subjects;
+   size_t m_countSubjects;
+
+   /// the number of messages in the listing, some may be not inserted yet
+   MsgnoType m_count;
+
+   /// the number of messages removed since the containers were built
+   size_t m_countRemoved;
+
+   /// true if the indices in the containers must be updated after a removal
+   bool m_mustRenumber;
+
+   //@}
+
+   /**
+     @name Thread tree
+    */
+   //@{
+
+   /// build the tree from the containers, pruning the empty ones
+   void BuildTree();
+
+   /// put the message containers under the given one into m_kids
+   void CollectChildren(Id container);
+
+   /// break the threads when the subject changes
+   void BreakThreads();
+
+   /// gather the threads with the same subject together
+   void GatherSubjects();
+
+   /// create a new node for the given message or a dummy one
+   NodeId NewNode(MsgnoType idx, MsgnoType idxSubject);
+
+   /// add the node as the last child of the parent one
+   void AppendNode(NodeId parent, NodeId node);
+
+   /// remove the node from the children of its parent
+   void UnlinkNode(NodeId node);
+
+   /// put the node in place of another one in the list of its siblings
+   void ReplaceNode(NodeId nodeOld, NodeId nodeNew);
+
+   /// return true if the first node is an ancestor of the second one
+   bool IsAncestorNode(NodeId ancestor, NodeId node) const;
+
+   /// sort the children of the node in the order of their messages indices
+   void SortChildren(NodeId node);
+
+   /// helper of SortChildren() for the long lists, return false if failed
+   bool SortByIndex();
+
+   /// return the subject id of the node
+   Id GetSubject(NodeId node) const
+      { return m_messages[m_nodes[node].idxSubject].subject; }
+
+   /// return true if the subject of the node is a reply
+   bool IsReply(NodeId node) const
+      { return m_messages[m_nodes[node].idxSubject].isReply; }
+
+   /// all nodes, the first one is the root of the tree
+   std::vector<Node> m_nodes;
+
+   /// temporary arrays used while building the tree, kept to reuse memory
+   std::vector<Id> m_refs,
+                   m_kids,
+                   m_stack;
+   std::vector<std::pair<Id, NodeId> > m_work;
+   std::vector<NodeId> m_subjectNodes;
+   std::vector<std::pair<MsgnoType, NodeId> > m_sorted;
+   std::vector<NodeId> m_byIndex;
+
+   //@}
+};
+
+#endif // _MAIL_THREADER_H_
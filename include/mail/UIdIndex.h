@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/UIdIndex.h: declaration of UIdIndex class
+// Purpose:     UIdIndex allows to quickly find the msgno from UID
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MAIL_UIDINDEX_H_
+#define _MAIL_UIDINDEX_H_
+
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// UIdIndex: msgno -> UID table allowing fast UID -> msgno lookups
+// ----------------------------------------------------------------------------
+
+/**
+  UIdIndex stores the UIDs of all messages in the folder in a dense array
+  indexed by msgno.
+
+  As the UIDs are strictly ascending in the msgno order (this is guaranteed
+  by IMAP and c-client relies on it for the other drivers as well), finding
+  the msgno corresponding to the given UID can be done using binary search.
+  Just in case some driver doesn't respect this, we fall back to linear search
+  if binary search fails and remember to always use it if this finds the UID.
+
+  The UIDs of the new messages are not necessarily known when they appear in
+  the folder, so the table may have "holes" in it. The owner of the index is
+  responsible for filling them (see GetFirstUnknown()) before calling Find()
+  as it doesn't work if the table is incomplete.
+
+  The index must be kept in sync with the folder by calling OnAdd() and
+  OnExpunge() from the new mail and expunge notification handlers.
+ */
+class UIdIndex
+{
+public:
+   UIdIndex();
+
+   /**
+     @name Synchronization with the folder
+    */
+   //@{
+
+   /// called when the number of messages in the folder increases
+   void OnAdd(MsgnoType countNew);
+
+   /// called when the message with the given msgno is expunged
+   void OnExpunge(MsgnoType msgno);
+
+   /// forget everything, called when the folder is closed
+   void Clear();
+
+   /// remember the UID of the given message
+   void Set(MsgnoType msgno, UIdType uid);
+
+   //@}
+
+   /**
+     @name Accessors
+    */
+   //@{
+
+   /// get the number of messages in the index
+   MsgnoType GetCount() const { return m_uids.size(); }
+
+   /// get the UID of the given message or UID_ILLEGAL if it's unknown
+   UIdType Get(MsgnoType msgno) const
+   {
+      return msgno != MSGNO_ILLEGAL && msgno <= m_uids.size() &&
+               m_uids[msgno - 1] != UID_UNKNOWN ? m_uids[msgno - 1]
+                                                : UID_ILLEGAL;
+   }
+
+   /// return true if the UIDs of all messages are known
+   bool IsComplete() const { return m_countUnknown == 0; }
+
+   /**
+     Get the first msgno whose UID is unknown.
+
+     @param msgnoStart the msgno to start looking from
+     @return the msgno or MSGNO_ILLEGAL if there are no more unknown UIDs
+    */
+   MsgnoType GetFirstUnknown(MsgnoType msgnoStart = 1) const;
+
+   /**
+     Find the msgno of the message with the given UID.
+
+     This can only be called if IsComplete() returns true.
+
+     @param uid the UID to look for
+     @return the msgno or MSGNO_ILLEGAL if not found
+    */
+   MsgnoType Find(UIdType uid) const;
+
+   //@}
+
+private:
+   /// the value used in m_uids for unknown UIDs
+   enum { UID_UNKNOWN = 0 };
+
+   /// the UIDs indexed by msgno - 1, UID_UNKNOWN if not known yet
+   std::vector<UIdType> m_uids;
+
+   /// the number of UID_UNKNOWN elements in m_uids
+   MsgnoType m_countUnknown;
+
+   /// all elements of m_uids before this index are known
+   size_t m_idxFirstUnknown;
+
+   /// false if we detected UIDs not in ascending order
+   mutable bool m_isSorted;
+};
+
+#endif // _MAIL_UIDINDEX_H_
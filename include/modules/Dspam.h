@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   modules/Dspam.h: helpers for using the DSPAM library
+// Purpose:     include DSPAM headers and reuse its contexts
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MODULES_DSPAM_H_
+#define _MODULES_DSPAM_H_
+
+#include <stdlib.h>
+
+extern "C"
+{
+   #define class klass
+   #include <libdspam.h>
+   #undef class
+}
+
+/**
+  Prepare a DSPAM context for processing another message.
+
+  dspam_process() only parses the message if the context doesn't contain a
+  parsed message yet and leaves the results of processing it in the context,
+  so all of them must be reset before the context can be reused, otherwise
+  the next message would be classified (or, worse, trained on) using the
+  contents of the previous one.
+
+  The signature is freed unless it was provided by the caller, which we never
+  do.
+ */
+inline void DspamResetCtx(DSPAM_CTX *ctx)
+{
+   if ( ctx->message )
+   {
+      _ds_destroy_message(ctx->message);
+      ctx->message = NULL;
+   }
+
+   if ( !ctx->_sig_provided && ctx->signature )
+   {
+      free(ctx->signature->data);
+      free(ctx->signature);
+   }
+
+   ctx->signature = NULL;
+   ctx->_sig_provided = 0;
+
+   ctx->classification = DSR_NONE;
+   ctx->source = DSS_NONE;
+   ctx->result = DSR_NONE;
+   ctx->klass[0] = '\0';
+   ctx->probability = 0;
+   ctx->confidence = 0;
+   ctx->learned = 0;
+}
+
+#endif // _MODULES_DSPAM_H_
@@ -16,6 +16,8 @@
 
 #include "MModule.h"
 
+#include <vector>
+
 class MCryptoEngineOutputLog;
 
 class WXDLLIMPEXP_FWD_CORE wxWindow;
@@ -150,6 +152,55 @@ public:
                               const String& signature,
                               MCryptoEngineOutputLog *log = NULL) = 0;
 
+   /// a detached signature to check with VerifyDetachedSignatures()
+   struct DetachedSignature
+   {
+      DetachedSignature() { log = NULL; status = MAX_ERROR; }
+
+      /**
+         The Message-ID of the message containing the signature.
+
+         It is used to cache the result of the verification, so that checking
+         the same signature again is instantaneous. May be empty to disable
+         caching.
+       */
+      String messageId;
+
+      /// the signed text, as for VerifyDetachedSignature()
+      String message;
+
+      /// the signature, as for VerifyDetachedSignature()
+      String signature;
+
+      /// the object to place output log into, may be NULL
+      MCryptoEngineOutputLog *log;
+
+      /// the result of the verification, filled by VerifyDetachedSignatures()
+      Status status;
+   };
+
+   typedef std::vector<DetachedSignature> DetachedSignatures;
+
+   /**
+      Verifies many detached signatures at once.
+
+      This is equivalent to calling VerifyDetachedSignature() for all of them
+      but can be much faster, e.g. because the engine doesn't need to be
+      launched for each of the signatures separately.
+
+      @param sigs the signatures to check, their status field is filled with
+                  the result on return
+    */
+   virtual void VerifyDetachedSignatures(DetachedSignatures& sigs)
+   {
+      for ( DetachedSignatures::iterator i = sigs.begin();
+            i != sigs.end();
+            ++i )
+      {
+         i->status = VerifyDetachedSignature(i->message, i->signature, i->log);
+      }
+   }
+
    //@}
 
    /// @name Key management.
@@ -0,0 +1,284 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   modules/Migrate.h: interface of the "Migrate" module
+// Purpose:     allows to use the migration engine without the wizard
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _MODULES_MIGRATE_H_
+#define _MODULES_MIGRATE_H_
+
+#include "MModule.h"
+#include "FolderType.h"
+
+// ----------------------------------------------------------------------------
+// MigrateImapServer: IMAP server parameters
+// ----------------------------------------------------------------------------
+
+struct MigrateImapServer
+{
+   // the server name
+   String server;
+
+   // the port or -1 for default
+   int port;
+
+   // the starting folder or empty if root
+   String root;
+
+   // the username and password (anonymous access if empty)
+   String username,
+          password;
+
+   // the delimiter of the folder names (NUL initially meaning "unknown")
+   char delimiter;
+
+#ifdef USE_SSL
+   // use SSL to access this server?
+   bool useSSL;
+#endif // USE_SSL
+
+   MigrateImapServer()
+   {
+      port = -1;
+
+      delimiter = '\0';
+
+#ifdef USE_SSL
+      useSSL = false;
+#endif // USE_SSL
+   }
+};
+
+// ----------------------------------------------------------------------------
+// MigrateLocal: local storage parameters
+// ----------------------------------------------------------------------------
+
+struct MigrateLocal
+{
+   // the directory containing the files
+   String root;
+
+   // the format of the folders (FileMbox_Max means MH)
+   FileMailboxFormat format;
+
+   MigrateLocal()
+   {
+      // use MBOX by default
+      format = FileMbox_MBOX;
+   }
+};
+
+// ----------------------------------------------------------------------------
+// MigrateData: the parameters of migration procedure
+// ----------------------------------------------------------------------------
+
+struct MigrateData
+{
+   // if true, copy from the IMAP server, otherwise from the local tree
+   bool fromIMAP;
+
+   // the server we're copying the mail from
+   MigrateImapServer source;
+
+   // or the local tree (only used for benchmarking currently)
+   MigrateLocal srcLocal;
+
+   // if true, use dstIMAP below, otherwise use dstLocal
+   bool toIMAP;
+
+   // the delimiter of the folder names (NUL initially meaning "unknown")
+   char delimiterDst;
+
+   // the destination server
+   MigrateImapServer dstIMAP;
+
+   // or the local file(s)
+   MigrateLocal dstLocal;
+
+   // the number of folders on the source server (-1 if unknown)
+   int countFolders;
+
+   // the (full) names of the folders to migrate (empty if countFolders == -1)
+   wxArrayString folderNames;
+
+   // the flags (ASMailFolder::ATT_XXX bit masks combination)
+   wxArrayInt folderFlags;
+
+   // the maximal number of folders copied simultaneously (and hence of the
+   // connections opened to each server), only used when threads are enabled
+   int maxConnections;
+
+   // the number of messages copied at once
+   size_t batchSize;
+
+   // if true, the UIDs of the copied messages are remembered on disk and the
+   // interrupted migration is resumed from where it stopped
+   bool useJournal;
+
+   // if true, the messages already present in the destination folder (as
+   // identified by their Message-ID) are not copied again
+   bool skipDuplicates;
+
+   MigrateData()
+   {
+      fromIMAP = true;
+
+      toIMAP = true;
+
+      delimiterDst = '\0';
+
+      countFolders = -1;
+
+      maxConnections = 2;
+      batchSize = 500;
+      useJournal = true;
+      skipDuplicates = true;
+   }
+
+   // add a new folder to folderNames/folderFlags arrays
+   void AddFolder(const String& path, char delim, long flags);
+
+   // must be called at the end of folder enumeration to set the
+   // ATT_NOINFERIORS flags for the folders correctly
+   void FixFolderFlags();
+
+   // return the delimiter used by the source folder names
+   char GetSourceDelimiter() const
+      { return fromIMAP ? source.delimiter : '/'; }
+
+   // return the root of the source folders hierarchy: this is the server
+   // root for IMAP and nothing for the local files as their root directory
+   // is replaced with the destination one
+   String GetSourceRoot() const
+      { return fromIMAP ? source.root : String(); }
+};
+
+// ----------------------------------------------------------------------------
+// MigrateStats: the migration progress information
+// ----------------------------------------------------------------------------
+
+struct MigrateStats
+{
+   // the total number of folders to process
+   int countFolders;
+
+   // the number of folders already processed and those of them which had
+   // errors
+   int foldersDone,
+       foldersFailed;
+
+   // the total number of messages in the folders opened so far
+   unsigned long countMessages;
+
+   // the number of messages copied, not copied because they had been
+   // already copied before, according to the journal or their Message-ID,
+   // and not copied because of an error
+   unsigned long messagesCopied,
+                 messagesSkipped,
+                 messagesDuplicate,
+                 messagesFailed;
+
+   // the name of the folder which was started last
+   String folderCurrent;
+
+   MigrateStats()
+   {
+      countFolders =
+      foldersDone =
+      foldersFailed = 0;
+
+      countMessages =
+      messagesCopied =
+      messagesSkipped =
+      messagesDuplicate =
+      messagesFailed = 0;
+   }
+
+   // return the number of messages already processed in any way
+   unsigned long GetMessagesDone() const
+   {
+      return messagesCopied + messagesSkipped +
+               messagesDuplicate + messagesFailed;
+   }
+};
+
+// ----------------------------------------------------------------------------
+// MigrateProgress: receives the migration progress notifications
+// ----------------------------------------------------------------------------
+
+class MigrateProgress
+{
+public:
+   /**
+      Called periodically from the main thread while migration is running.
+
+      @param stats the current progress
+      @return false to cancel the migration
+    */
+   virtual bool OnProgress(const MigrateStats& stats) = 0;
+
+   virtual ~MigrateProgress() { }
+};
+
+// ----------------------------------------------------------------------------
+// MModule_Migrate: the interface of the migration module
+// ----------------------------------------------------------------------------
+
+/**
+   The migration module copies the entire folder hierarchy from an IMAP
+   server or a local directory to another IMAP server or local directory.
+
+   Normally it is used interactively from the menu command it adds but this
+   interface allows to use it without any GUI, e.g. for benchmarking.
+*/
+class MModule_Migrate : public MModule
+{
+public:
+   /**
+      Copy all the folders described by data.
+
+      The folders are copied in parallel (if threads are enabled), the
+      messages are copied in batches of data.batchSize ones and, unless
+      data.useJournal is false, the UIDs of the messages already copied are
+      remembered so that the next call with the same data resumes the
+      migration if it was interrupted. Errors while copying a message or a
+      folder don't prevent the other ones from being copied.
+
+      @param data the migration parameters, if data.countFolders is -1 the
+                  source folders are enumerated first
+      @param progress the object to notify about the progress, may be NULL
+      @param stats if not NULL, filled with the final statistics
+      @return true if all folders were copied successfully, false if the
+              migration couldn't be done, was cancelled or had errors
+    */
+   virtual bool Migrate(MigrateData& data,
+                        MigrateProgress *progress = NULL,
+                        MigrateStats *stats = NULL) = 0;
+
+   /**
+      Copy all folders from one local directory to another one.
+
+      This is a non-interactive wrapper around Migrate() used by the
+      --migrate command line option to benchmark the migration engine
+      between the local trees. The statistics and the time taken are logged
+      when it is done.
+
+      @param from the source directory, optionally prefixed with "mbx:",
+                  "mbox:" or "mh:" to specify the format of its folders
+                  (MBOX is used by default)
+      @param to the destination directory in the same form
+      @return true if all folders were copied successfully
+    */
+   virtual bool MigrateLocalTree(const String& from, const String& to) = 0;
+};
+
+// the name of the module to load with MModule::LoadModule()
+#define MMODULE_NAME_MIGRATE   _T("Migrate")
+
+#endif // _MODULES_MIGRATE_H_
@@ -85,6 +85,7 @@ typedef struct imap_local {
   unsigned int filter : 1;	/* filter SEARCH/SORT/THREAD results */
   unsigned int loser : 1;	/* server is a loser */
   unsigned int saslcancel : 1;	/* SASL cancelled by protocol */
+  unsigned int idling : 1;	/* IDLE in progress */
   long authflags;		/* required flags for authenticators */
   unsigned long sortsize;	/* sort return data size */
   unsigned long *sortdata;	/* sort return data */
@@ -100,6 +101,9 @@ typedef struct imap_local {
   char *reform;			/* reformed sequence */
   char tmp[IMAPTMPLEN];		/* temporary buffer */
   SEARCHSET *lookahead;		/* fetch lookahead */
+  char idletag[10];		/* tag of IDLE in progress */
+  unsigned long pipelined;	/* number of STATUS replies still expected */
+  unsigned long pipelinetag;	/* tag of first pipelined STATUS */
 } IMAPLOCAL;
 
 
@@ -2913,6 +2917,11 @@ IMAPPARSEDREPLY *imap_send (MAILSTREAM *stream,char *cmd,IMAPARG *args[])
   				/* gensym a new tag */
   sprintf (tag,"%08lx",0xffffffff & (stream->gensym++));
   if (!LOCAL->netstream)	/* make sure have a session */
+    return imap_fake (stream,tag,"[CLOSED] IMAP connection lost");
+				/* finish any commands still in progress */
+  if (LOCAL->pipelined) imap_status_receive (stream,NIL);
+  if (LOCAL->idling) imap_idle_done (stream);
+  if (!LOCAL->netstream)	/* may have lost the session doing this */
     return imap_fake (stream,tag,"[CLOSED] IMAP connection lost");
   mail_lock (stream);		/* lock up the stream */
   if (sc)			/* tell client sending a command */
@@ -5588,6 +5597,238 @@ IMAPPARSEDREPLY *imap_fetch (MAILSTREAM *stream,char *sequence,long flags)
   return imap_send (stream,cmd,args);
 }
 
+/* IMAP load header cache for several messages at once
+ * Accepts: MAIL stream
+ *	    sequence
+ *	    list of header lines to fetch or NIL for the entire header
+ *	    flags
+ * Returns: T if successful, NIL otherwise
+ */
+
+long imap_fetchheader_sequence (MAILSTREAM *stream,char *sequence,
+				STRINGLIST *lines,long flags)
+{
+  char *cmd = (LEVELIMAP4 (stream) && (flags & FT_UID)) ?
+    "UID FETCH" : "FETCH";
+  IMAPPARSEDREPLY *reply;
+  IMAPARG *args[5],aseq,aatt,alns,acls;
+				/* HEADER.FIELDS is new in IMAP4rev1 */
+  if (!LEVELIMAP4rev1 (stream)) return NIL;
+  if (LOCAL->loser) sequence = imap_reform_sequence (stream,sequence,
+						     flags & FT_UID);
+  aseq.type = SEQUENCE; aseq.text = (void *) sequence;
+  aatt.type = BODYPEEK;
+  aatt.text = (void *) (lines ? "HEADER.FIELDS" : "HEADER");
+  alns.type = LIST; alns.text = (void *) lines;
+  acls.type = BODYCLOSE; acls.text = (void *) "";
+  args[0] = &aseq; args[1] = &aatt;
+  if (lines) {			/* want specific header lines? */
+    args[2] = &alns; args[3] = &acls; args[4] = NIL;
+  }
+  else {
+    args[2] = &acls; args[3] = NIL;
+  }
+				/* the data is cached by imap_cache() */
+  if (imap_OK (stream,reply = imap_send (stream,cmd,args))) return LONGT;
+  mm_log (reply->text,ERROR);
+  return NIL;
+}
+
+/* IMAP send several STATUS commands without waiting for their replies
+ * Accepts: MAIL stream
+ *	    array of mailbox names
+ *	    number of mailbox names
+ *	    status flags
+ * Returns: number of commands sent, the replies must be read by
+ *	    imap_status_receive() which is done automatically before the
+ *	    next command is sent otherwise
+ *
+ * Stops at the first mailbox which is on another server or whose name can't
+ * be sent as a quoted string, the caller should use mail_status() for it.
+ */
+
+unsigned long imap_status_send (MAILSTREAM *stream,char **mbx,unsigned long n,
+				long flags)
+{
+  NETMBX mb;
+  unsigned long i;
+  size_t len;
+  char *s,*t,*buf,tag[10],flg[MAILTMPLEN];
+  if (!(LOCAL && LOCAL->netstream && LEVELIMAP4rev1 (stream)) ||
+      LOCAL->pipelined || LOCAL->idling || !n) return 0;
+  flg[0] = flg[1] = '\0';	/* build flag list */
+  if (flags & SA_MESSAGES) strcat (flg," MESSAGES");
+  if (flags & SA_RECENT) strcat (flg," RECENT");
+  if (flags & SA_UNSEEN) strcat (flg," UNSEEN");
+  if (flags & SA_UIDNEXT) strcat (flg," UIDNEXT");
+  if (flags & SA_UIDVALIDITY) strcat (flg," UIDVALIDITY");
+  flg[0] = '(';
+  strcat (flg,")");
+				/* space for all the commands */
+  for (i = 0, len = 1; i < n; i++) len += strlen (mbx[i]) + strlen (flg) + 32;
+  s = buf = (char *) fs_get (len);
+  for (i = 0; (i < n) && mail_usable_network_stream (stream,mbx[i]) &&
+	 mail_valid_net_parse (mbx[i],&mb); i++) {
+    for (t = mb.mailbox; *t; t++)
+      if ((*t & 0x80) || (*t < ' ') || (*t == '"') || (*t == '\\')) break;
+    if (*t) break;		/* would need a literal, let caller do it */
+    sprintf (tag,"%08lx",0xffffffff & (stream->gensym++));
+    if (!i) LOCAL->pipelinetag = strtoul (tag,NIL,16);
+    sprintf (s,"%s STATUS \"%s\" %s",tag,mb.mailbox,flg);
+    if (stream->debug) mail_dlog (s,NIL);
+    s += strlen (s);
+    *s++ = '\015';		/* append CRLF */
+    *s++ = '\012';
+  }
+  if (i) {			/* send all commands at once */
+    mail_lock (stream);
+    if (net_sout (LOCAL->netstream,buf,s - buf)) LOCAL->pipelined = i;
+    else {
+      imap_fake (stream,NIL,"[CLOSED] IMAP connection broken (command)");
+      i = 0;
+    }
+    mail_unlock (stream);
+  }
+  fs_give ((void **) &buf);
+  return i;
+}
+
+/* IMAP read replies to commands sent by imap_status_send()
+ * Accepts: MAIL stream
+ *	    array to return T or NIL for each command in or NIL
+ * Returns: T if all replies were read, NIL if the connection was lost
+ *
+ * The status itself is passed to mm_status() as usual.
+ */
+
+long imap_status_receive (MAILSTREAM *stream,long *results)
+{
+  IMAPPARSEDREPLY *reply;
+  unsigned long i;
+  unsigned long n = LOCAL->pipelined;
+  char *s;
+  if (results) for (i = 0; i < n; i++) results[i] = NIL;
+  if (!n) return LOCAL->netstream ? T : NIL;
+  mail_lock (stream);
+  while (LOCAL->pipelined && LOCAL->netstream)
+    if (reply = imap_parse_reply (stream,net_getline (LOCAL->netstream))) {
+      if (!strcmp (reply->tag,"*")) imap_parse_unsolicited (stream,reply);
+				/* one of ours? */
+      else if (strcmp (reply->tag,"+") &&
+	       ((i = 0xffffffff & (strtoul (reply->tag,&s,16) -
+				   LOCAL->pipelinetag)) < n) && !*s) {
+	if (imap_OK (stream,reply) && results) results[i] = T;
+	LOCAL->pipelined--;
+      }
+      else {			/* report bogon */
+	sprintf (LOCAL->tmp,"Unexpected tagged response: %.80s %.80s %.80s",
+		 (char *) reply->tag,(char *) reply->key,(char *) reply->text);
+	mm_notify (stream,LOCAL->tmp,WARN);
+	stream->unhealthy = T;
+      }
+    }
+  mail_unlock (stream);
+  if (LOCAL->netstream) return T;
+  LOCAL->pipelined = 0;		/* forget about the rest */
+  imap_fake (stream,NIL,"[CLOSED] IMAP connection broken (server response)");
+  return NIL;
+}
+
+/* IMAP start idling
+ * Accepts: MAIL stream
+ * Returns: T if the server is idling now, NIL otherwise
+ *
+ * The stream must have a selected mailbox and the server must support IDLE
+ * (RFC 2177). Use imap_idle_poll() to process the data sent by server while
+ * idling, IDLE is terminated automatically when another command is sent.
+ */
+
+long imap_idle_start (MAILSTREAM *stream)
+{
+  IMAPPARSEDREPLY *reply;
+  char tag[10];
+  if (!(LOCAL && LOCAL->netstream && LOCAL->cap.idle) || stream->halfopen)
+    return NIL;
+  if (LOCAL->idling) return T;	/* already idling */
+				/* can't poll without the driver support */
+  if (!LOCAL->netstream->dtb->pending) return NIL;
+  if (LOCAL->pipelined) imap_status_receive (stream,NIL);
+  if (!LOCAL->netstream) return NIL;
+  sprintf (tag,"%08lx",0xffffffff & (stream->gensym++));
+  sprintf (LOCAL->tmp,"%s IDLE",tag);
+  mail_lock (stream);
+  if (imap_soutr (stream,LOCAL->tmp)) {
+				/* server must accept it with continuation */
+    if (!strcmp ((reply = imap_reply (stream,tag))->tag,"+")) {
+      strcpy (LOCAL->idletag,tag);
+      LOCAL->idling = T;
+    }
+    else imap_OK (stream,reply);
+  }
+  else imap_fake (stream,tag,"[CLOSED] IMAP connection broken (command)");
+  mail_unlock (stream);
+  return LOCAL->idling ? T : NIL;
+}
+
+
+/* IMAP process data sent by server while idling, never blocks
+ * Accepts: MAIL stream
+ * Returns: T if anything was received or the stream is not idling any more,
+ *	    NIL if nothing happened
+ */
+
+long imap_idle_poll (MAILSTREAM *stream)
+{
+  IMAPPARSEDREPLY *reply;
+  long ret = NIL;
+  if (!(LOCAL && LOCAL->idling && LOCAL->netstream)) return T;
+  mail_lock (stream);
+  while (LOCAL->idling && LOCAL->netstream && net_pending (LOCAL->netstream))
+    if (ret = T, reply = imap_parse_reply (stream,
+					    net_getline (LOCAL->netstream))) {
+      if (!strcmp (reply->tag,"*")) imap_parse_unsolicited (stream,reply);
+				/* server terminated IDLE itself? */
+      else if (!compare_cstring (reply->tag,LOCAL->idletag)) {
+	LOCAL->idling = NIL;
+	imap_OK (stream,reply);
+      }
+      else {			/* report bogon */
+	sprintf (LOCAL->tmp,"Unexpected response while idling: %.80s %.80s",
+		 (char *) reply->tag,(char *) reply->key);
+	mm_notify (stream,LOCAL->tmp,WARN);
+	stream->unhealthy = T;
+      }
+    }
+  if (!LOCAL->netstream) {	/* connection lost */
+    LOCAL->idling = NIL;
+    ret = T;
+  }
+  mail_unlock (stream);
+  return ret;
+}
+
+
+/* IMAP stop idling
+ * Accepts: MAIL stream
+ * Returns: T if IDLE was terminated successfully or wasn't in progress,
+ *	    NIL if the connection was lost
+ */
+
+long imap_idle_done (MAILSTREAM *stream)
+{
+  long ret = NIL;
+  if (!LOCAL->idling) return LOCAL->netstream ? T : NIL;
+  LOCAL->idling = NIL;		/* no longer idling whatever happens */
+  if (!LOCAL->netstream) return NIL;
+  mail_lock (stream);
+  if (imap_soutr (stream,"DONE"))
+    ret = imap_OK (stream,imap_reply (stream,LOCAL->idletag));
+  else imap_fake (stream,LOCAL->idletag,
+		  "[CLOSED] IMAP connection broken (command)");
+  mail_unlock (stream);
+  return (ret && LOCAL->netstream) ? T : NIL;
+}
+
 /* Reform sequence for losing server that doesn't handle ranges right
  * Accepts: MAIL stream
  *	    sequence
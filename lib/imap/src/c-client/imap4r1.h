@@ -267,6 +267,14 @@ IMAPCAP *imap_cap (MAILSTREAM *stream);
 char *imap_host (MAILSTREAM *stream);
 long imap_cache (MAILSTREAM *stream,unsigned long msgno,char *seg,
 		 STRINGLIST *stl,SIZEDTEXT *text);
+long imap_fetchheader_sequence (MAILSTREAM *stream,char *sequence,
+				STRINGLIST *lines,long flags);
+unsigned long imap_status_send (MAILSTREAM *stream,char **mbx,unsigned long n,
+				long flags);
+long imap_status_receive (MAILSTREAM *stream,long *results);
+long imap_idle_start (MAILSTREAM *stream);
+long imap_idle_poll (MAILSTREAM *stream);
+long imap_idle_done (MAILSTREAM *stream);
 
 
 /* Temporary */
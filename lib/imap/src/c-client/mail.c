@@ -6129,7 +6129,8 @@ static NETDRIVER tcpdriver = {
   tcp_host,			/* return host name */
   tcp_remotehost,		/* return remote host name */
   tcp_port,			/* return port number */
-  tcp_localhost			/* return local host name */
+  tcp_localhost,		/* return local host name */
+  tcp_pending			/* test for pending input */
 };
 
 
@@ -6329,3 +6330,15 @@ char *net_localhost (NETSTREAM *stream)
 {
   return (*stream->dtb->localhost) (stream->stream);
 }
+
+
+/* Network test for pending input
+ * Accepts: Network stream
+ * Returns: T if input can be read without blocking, NIL if not or if the
+ *	    driver can't tell
+ */
+
+long net_pending (NETSTREAM *stream)
+{
+  return stream->dtb->pending ? (*stream->dtb->pending) (stream->stream) : NIL;
+}
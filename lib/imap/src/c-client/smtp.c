@@ -63,9 +63,14 @@
 void *smtp_challenge (void *s,unsigned long *len);
 long smtp_response (void *s,char *response,unsigned long size);
 long smtp_auth (SENDSTREAM *stream,NETMBX *mb,char *tmp);
+void smtp_from (SENDSTREAM *stream,ENVELOPE *env,char *tmp);
+long smtp_pipeline (SENDSTREAM *stream,char *type,char *from,ENVELOPE *env,
+		    long *error);
 long smtp_rcpt (SENDSTREAM *stream,ADDRESS *adr,long *error);
+long smtp_rcpt_args (SENDSTREAM *stream,ADDRESS *adr,char *tmp);
 long smtp_send (SENDSTREAM *stream,char *command,char *args);
 long smtp_reply (SENDSTREAM *stream);
+long smtp_reply_full (SENDSTREAM *stream);
 long smtp_ehlo (SENDSTREAM *stream,char *host,NETMBX *mb);
 long smtp_fake (SENDSTREAM *stream,char *text);
 static long smtp_seterror (SENDSTREAM *stream,long code,char *text);
@@ -423,6 +428,7 @@ long smtp_mail (SENDSTREAM *stream,char *type,ENVELOPE *env,BODY *body)
   char tmp[SENDBUFLEN+1];
   long error = NIL;
   long retry = NIL;
+  long piped = NIL;
   buf.f = smtp_soutr;		/* initialize buffer */
   buf.s = stream->netstream;
   buf.end = (buf.beg = buf.cur = tmp) + SENDBUFLEN;
@@ -432,7 +438,27 @@ long smtp_mail (SENDSTREAM *stream,char *type,ENVELOPE *env,BODY *body)
     smtp_seterror (stream,SMTPHARDERROR,"No recipients specified");
     return NIL;
   }
-  do {				/* make sure stream is in good shape */
+				/* send the whole envelope at once if can */
+  if (ESMTP.ok && ESMTP.service.pipe) {
+    smtp_from (stream,env,tmp);
+    switch (smtp_pipeline (stream,type,tmp,env,&error)) {
+    case SMTPOK:		/* MAIL FROM accepted */
+      if (error) {		/* any recipients failed? */
+	smtp_send (stream,"RSET",NIL);
+	smtp_seterror (stream,SMTPHARDERROR,"One or more recipients failed");
+	return NIL;
+      }
+      piped = T;
+      break;
+    case SMTPWANTAUTH:		/* wants authentication, do it below */
+      retry = T;
+      error = NIL;
+      break;
+    default:			/* other failure */
+      return NIL;
+    }
+  }
+  if (!piped) do {		/* make sure stream is in good shape */
     smtp_send (stream,"RSET",NIL);
     if (retry) {		/* need to retry with authentication? */
       NETMBX mb;
@@ -451,32 +477,7 @@ long smtp_mail (SENDSTREAM *stream,char *type,ENVELOPE *env,BODY *body)
       retry = NIL;		/* no retry at this point */
     }
 
-    strcpy (tmp,"FROM:<");	/* compose "MAIL FROM:<return-path>" */
-#ifdef RFC2821
-    if (env->return_path && env->return_path->host &&
-	!((strlen (env->return_path->mailbox) > SMTPMAXLOCALPART) ||
-	  (strlen (env->return_path->host) > SMTPMAXDOMAIN))) {
-      rfc822_cat (tmp,env->return_path->mailbox,NIL);
-      sprintf (tmp + strlen (tmp),"@%s",env->return_path->host);
-    }
-#else				/* old code with A-D-L support */
-    if (env->return_path && env->return_path->host &&
-	!((env->return_path->adl &&
-	   (strlen (env->return_path->adl) > SMTPMAXPATH)) ||
-	  (strlen (env->return_path->mailbox) > SMTPMAXLOCALPART) ||
-	  (strlen (env->return_path->host) > SMTPMAXDOMAIN)))
-      rfc822_address (tmp,env->return_path);
-#endif
-    strcat (tmp,">");
-    if (ESMTP.ok) {
-      if (ESMTP.eightbit.ok && ESMTP.eightbit.want)
-	strcat (tmp," BODY=8BITMIME");
-      if (ESMTP.dsn.ok && ESMTP.dsn.want) {
-	strcat (tmp,ESMTP.dsn.full ? " RET=FULL" : " RET=HDRS");
-	if (ESMTP.dsn.envid)
-	  sprintf (tmp + strlen (tmp)," ENVID=%.100s",ESMTP.dsn.envid);
-      }
-    }
+    smtp_from (stream,env,tmp);	/* compose "MAIL FROM:<return-path>" */
 				/* send "MAIL FROM" command */
     switch (smtp_send (stream,type,tmp)) {
     case SMTPUNAVAIL:		/* mailbox unavailable? */
@@ -530,6 +531,125 @@ long smtp_verbose (SENDSTREAM *stream)
 /* Internal routines */
 
 
+/* Simple Mail Transfer Protocol build MAIL FROM arguments
+ * Accepts: SMTP stream
+ *	    message envelope
+ *	    buffer of at least MAILTMPLEN characters
+ */
+
+void smtp_from (SENDSTREAM *stream,ENVELOPE *env,char *tmp)
+{
+  strcpy (tmp,"FROM:<");	/* compose "MAIL FROM:<return-path>" */
+#ifdef RFC2821
+  if (env->return_path && env->return_path->host &&
+      !((strlen (env->return_path->mailbox) > SMTPMAXLOCALPART) ||
+        (strlen (env->return_path->host) > SMTPMAXDOMAIN))) {
+    rfc822_cat (tmp,env->return_path->mailbox,NIL);
+    sprintf (tmp + strlen (tmp),"@%s",env->return_path->host);
+  }
+#else				/* old code with A-D-L support */
+  if (env->return_path && env->return_path->host &&
+      !((env->return_path->adl &&
+         (strlen (env->return_path->adl) > SMTPMAXPATH)) ||
+        (strlen (env->return_path->mailbox) > SMTPMAXLOCALPART) ||
+        (strlen (env->return_path->host) > SMTPMAXDOMAIN)))
+    rfc822_address (tmp,env->return_path);
+#endif
+  strcat (tmp,">");
+  if (ESMTP.ok) {
+    if (ESMTP.eightbit.ok && ESMTP.eightbit.want)
+      strcat (tmp," BODY=8BITMIME");
+    if (ESMTP.dsn.ok && ESMTP.dsn.want) {
+      strcat (tmp,ESMTP.dsn.full ? " RET=FULL" : " RET=HDRS");
+      if (ESMTP.dsn.envid)
+        sprintf (tmp + strlen (tmp)," ENVID=%.100s",ESMTP.dsn.envid);
+    }
+  }
+}
+
+/* Simple Mail Transfer Protocol send envelope using pipelining
+ * Accepts: SMTP stream
+ *	    delivery option (MAIL, SEND, SAML, SOML)
+ *	    MAIL FROM arguments
+ *	    message envelope
+ *	    pointer to error flag
+ * Returns: SMTPOK if MAIL FROM was accepted, SMTPWANTAUTH if should retry
+ *	    with authentication, else failure reply code
+ *
+ * Sends RSET, MAIL FROM and all RCPT TO commands at once (RFC 2920) and only
+ * then reads their replies.  DATA is not pipelined but sent by the caller
+ * after checking that all recipients were accepted, as the message must not
+ * be delivered to only some of them.
+ */
+
+long smtp_pipeline (SENDSTREAM *stream,char *type,char *from,ENVELOPE *env,
+		    long *error)
+{
+  ADDRESS *adr,*lst[3];
+  size_t len;
+  long i,reply;
+  long retry = NIL;
+  char *s,*buf,*mailreply,tmp[2*MAILTMPLEN];
+  lst[0] = env->to; lst[1] = env->cc; lst[2] = env->bcc;
+				/* space for all the commands */
+  for (i = 0, len = strlen (type) + strlen (from) + 16; i < 3; i++)
+    for (adr = lst[i]; adr; adr = adr->next) len += 2*MAILTMPLEN + 8;
+  s = buf = (char *) fs_get (len);
+  sprintf (s,"RSET\015\012%s %s\015\012",type,from);
+  s += strlen (s);
+  for (i = 0; i < 3; i++) for (adr = lst[i]; adr; adr = adr->next) {
+				/* clear any former error */
+    if (adr->error) fs_give ((void **) &adr->error);
+    if (adr->host) {		/* ignore group syntax */
+      if (smtp_rcpt_args (stream,adr,tmp)) {
+	sprintf (s,"RCPT %s\015\012",tmp);
+	s += strlen (s);
+      }
+      else *error = T;
+    }
+  }
+  if (stream->debug) mail_dlog (buf,stream->sensitive);
+				/* send all commands at once */
+  if (!(stream->netstream && net_sout (stream->netstream,buf,s - buf))) {
+    fs_give ((void **) &buf);
+    return smtp_fake (stream,"SMTP connection broken (command)");
+  }
+  fs_give ((void **) &buf);
+  smtp_reply_full (stream);	/* don't care about RSET */
+  switch (reply = smtp_reply_full (stream)) {
+  case SMTPUNAVAIL:		/* mailbox unavailable? */
+  case SMTPWANTAUTH:		/* wants authentication? */
+  case SMTPWANTAUTH2:
+    if (ESMTP.auth) retry = T;	/* yes, retry with authentication */
+    reply = SMTPOK;		/* same as smtp_mail() would do */
+  }
+				/* remember MAIL FROM reply */
+  mailreply = cpystr (stream->reply);
+				/* now get the replies for the recipients */
+  for (i = 0; i < 3; i++) for (adr = lst[i]; adr; adr = adr->next)
+    if (adr->host && !adr->error) switch (smtp_reply_full (stream)) {
+    case SMTPOK:		/* looks good */
+      break;
+    case SMTPUNAVAIL:		/* mailbox unavailable? */
+    case SMTPWANTAUTH:		/* wants authentication? */
+    case SMTPWANTAUTH2:
+      if (ESMTP.auth) {
+	retry = T;
+	break;
+      }
+    default:			/* other failure */
+      *error = T;		/* note that an error occurred */
+      adr->error = cpystr (stream->reply);
+    }
+  if (reply != SMTPOK) {	/* report MAIL FROM failure */
+    fs_give ((void **) &stream->reply);
+    stream->reply = mailreply;
+  }
+  else fs_give ((void **) &mailreply);
+  return retry ? SMTPWANTAUTH : reply;
+}
+
+
 /* Simple Mail Transfer Protocol send recipient
  * Accepts: SMTP stream
  *	    address list
@@ -539,72 +659,83 @@ long smtp_verbose (SENDSTREAM *stream)
 
 long smtp_rcpt (SENDSTREAM *stream,ADDRESS *adr,long *error)
 {
- char *s,tmp[2*MAILTMPLEN],orcpt[MAILTMPLEN];
+  char tmp[2*MAILTMPLEN];
   while (adr) {			/* for each address on the list */
 				/* clear any former error */
     if (adr->error) fs_give ((void **) &adr->error);
     if (adr->host) {		/* ignore group syntax */
-				/* enforce SMTP limits to protect the buffer */
-      if (strlen (adr->mailbox) > MAXLOCALPART) {
-	adr->error = cpystr ("501 Recipient name too long");
-	*error = T;
-      }
-      else if ((strlen (adr->host) > SMTPMAXDOMAIN)) {
-	adr->error = cpystr ("501 Recipient domain too long");
-	*error = T;
+      if (!smtp_rcpt_args (stream,adr,tmp)) *error = T;
+      else switch (smtp_send (stream,"RCPT",tmp)) {
+      case SMTPOK:		/* looks good */
+	break;
+      case SMTPUNAVAIL:		/* mailbox unavailable? */
+      case SMTPWANTAUTH:	/* wants authentication? */
+      case SMTPWANTAUTH2:
+	if (ESMTP.auth) return T;
+      default:			/* other failure */
+	*error = T;		/* note that an error occurred */
+	adr->error = cpystr (stream->reply);
       }
+    }
+    adr = adr->next;		/* do any subsequent recipients */
+  }
+  return NIL;			/* no retry called for */
+}
+
+/* Simple Mail Transfer Protocol build RCPT TO arguments
+ * Accepts: SMTP stream
+ *	    address
+ *	    buffer of at least 2*MAILTMPLEN characters
+ * Returns: T if built, NIL if the address can't be sent (its error is set)
+ */
+
+long smtp_rcpt_args (SENDSTREAM *stream,ADDRESS *adr,char *tmp)
+{
+  char *s,orcpt[MAILTMPLEN];
+				/* enforce SMTP limits to protect the buffer */
+  if (strlen (adr->mailbox) > MAXLOCALPART) {
+    adr->error = cpystr ("501 Recipient name too long");
+    return NIL;
+  }
+  if ((strlen (adr->host) > SMTPMAXDOMAIN)) {
+    adr->error = cpystr ("501 Recipient domain too long");
+    return NIL;
+  }
 #ifndef RFC2821			/* old code with A-D-L support */
-      else if (adr->adl && (strlen (adr->adl) > SMTPMAXPATH)) {
-	adr->error = cpystr ("501 Path too long");
-	*error = T;
-      }
+  if (adr->adl && (strlen (adr->adl) > SMTPMAXPATH)) {
+    adr->error = cpystr ("501 Path too long");
+    return NIL;
+  }
 #endif
-
-      else {
-	strcpy (tmp,"TO:<");	/* compose "RCPT TO:<return-path>" */
+  strcpy (tmp,"TO:<");		/* compose "RCPT TO:<return-path>" */
 #ifdef RFC2821
-	rfc822_cat (tmp,adr->mailbox,NIL);
-	sprintf (tmp + strlen (tmp),"@%s>",adr->host);
+  rfc822_cat (tmp,adr->mailbox,NIL);
+  sprintf (tmp + strlen (tmp),"@%s>",adr->host);
 #else				/* old code with A-D-L support */
-	rfc822_address (tmp,adr);
-	strcat (tmp,">");
+  rfc822_address (tmp,adr);
+  strcat (tmp,">");
 #endif
 				/* want notifications */
-	if (ESMTP.ok && ESMTP.dsn.ok && ESMTP.dsn.want) {
+  if (ESMTP.ok && ESMTP.dsn.ok && ESMTP.dsn.want) {
 				/* yes, start with prefix */
-	  strcat (tmp," NOTIFY=");
-	  s = tmp + strlen (tmp);
-	  if (ESMTP.dsn.notify.failure) strcat (s,"FAILURE,");
-	  if (ESMTP.dsn.notify.delay) strcat (s,"DELAY,");
-	  if (ESMTP.dsn.notify.success) strcat (s,"SUCCESS,");
+    strcat (tmp," NOTIFY=");
+    s = tmp + strlen (tmp);
+    if (ESMTP.dsn.notify.failure) strcat (s,"FAILURE,");
+    if (ESMTP.dsn.notify.delay) strcat (s,"DELAY,");
+    if (ESMTP.dsn.notify.success) strcat (s,"SUCCESS,");
 				/* tie off last comma */
-	  if (*s) s[strlen (s) - 1] = '\0';
-	  else strcat (tmp,"NEVER");
-	  if (adr->orcpt.addr) {
-	    sprintf (orcpt,"%.498s;%.498s",
-		     adr->orcpt.type ? adr->orcpt.type : "rfc822",
-		     adr->orcpt.addr);
-	    sprintf (tmp + strlen (tmp)," ORCPT=%.500s",orcpt);
-	  }
-	}
-	switch (smtp_send (stream,"RCPT",tmp)) {
-	case SMTPOK:		/* looks good */
-	  break;
-	case SMTPUNAVAIL:	/* mailbox unavailable? */
-	case SMTPWANTAUTH:	/* wants authentication? */
-	case SMTPWANTAUTH2:
-	  if (ESMTP.auth) return T;
-	default:		/* other failure */
-	  *error = T;		/* note that an error occurred */
-	  adr->error = cpystr (stream->reply);
-	}
-      }
+    if (*s) s[strlen (s) - 1] = '\0';
+    else strcat (tmp,"NEVER");
+    if (adr->orcpt.addr) {
+      sprintf (orcpt,"%.498s;%.498s",
+	       adr->orcpt.type ? adr->orcpt.type : "rfc822",
+	       adr->orcpt.addr);
+      sprintf (tmp + strlen (tmp)," ORCPT=%.500s",orcpt);
     }
-    adr = adr->next;		/* do any subsequent recipients */
   }
-  return NIL;			/* no retry called for */
+  return T;
 }
-
+
 /* Simple Mail Transfer Protocol send command
  * Accepts: SEND stream
  *	    text
@@ -622,11 +753,8 @@ long smtp_send (SENDSTREAM *stream,char *command,char *args)
   if (stream->debug) mail_dlog (s,stream->sensitive);
   strcat (s,"\015\012");
 				/* send the command */
-  if (stream->netstream && net_soutr (stream->netstream,s)) {
-    do stream->replycode = smtp_reply (stream);
-    while ((stream->replycode < 100) || (stream->reply[3] == '-'));
-    ret = stream->replycode;
-  }
+  if (stream->netstream && net_soutr (stream->netstream,s))
+    ret = smtp_reply_full (stream);
   else ret = smtp_fake (stream,"SMTP connection broken (command)");
   fs_give ((void **) &s);
   return ret;
@@ -655,6 +783,18 @@ long smtp_reply (SENDSTREAM *stream)
   return reply;
 }
 
+/* Simple Mail Transfer Protocol get complete, possibly multiline, reply
+ * Accepts: SMTP stream
+ * Returns: reply code
+ */
+
+long smtp_reply_full (SENDSTREAM *stream)
+{
+  do stream->replycode = smtp_reply (stream);
+  while ((stream->replycode < 100) || (stream->reply[3] == '-'));
+  return stream->replycode;
+}
+
 /* Simple Mail Transfer Protocol send EHLO
  * Accepts: SMTP stream
  *	    host name to use in EHLO
@@ -40,6 +40,7 @@ struct ssl_driver {		/* must parallel NETDRIVER in mail.h */
   char *(*remotehost) (SSLSTREAM *stream);
   unsigned long (*port) (SSLSTREAM *stream);
   char *(*localhost) (SSLSTREAM *stream);
+  long (*pending) (SSLSTREAM *stream);
 };
 
 
@@ -60,6 +61,7 @@ SSLSTREAM *ssl_aopen (NETMBX *mb,char *service,char *usrbuf);
 char *ssl_getline (SSLSTREAM *stream);
 long ssl_getbuffer (SSLSTREAM *stream,unsigned long size,char *buffer);
 long ssl_getdata (SSLSTREAM *stream);
+long ssl_pending (SSLSTREAM *stream);
 long ssl_soutr (SSLSTREAM *stream,char *string);
 long ssl_sout (SSLSTREAM *stream,char *string,unsigned long size);
 void ssl_close (SSLSTREAM *stream);
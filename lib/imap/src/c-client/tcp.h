@@ -42,6 +42,7 @@ TCPSTREAM *tcp_aopen (NETMBX *mb,char *service,char *usrbuf);
 char *tcp_getline (TCPSTREAM *stream);
 long tcp_getbuffer (TCPSTREAM *stream,unsigned long size,char *buffer);
 long tcp_getdata (TCPSTREAM *stream);
+long tcp_pending (TCPSTREAM *stream);
 long tcp_soutr (TCPSTREAM *stream,char *string);
 long tcp_sout (TCPSTREAM *stream,char *string,unsigned long size);
 void tcp_close (TCPSTREAM *stream);
@@ -75,7 +75,8 @@ static struct ssl_driver ssldriver = {
   ssl_host,			/* return host name */
   ssl_remotehost,		/* return remote host name */
   ssl_port,			/* return port number */
-  ssl_localhost			/* return local host name */
+  ssl_localhost,		/* return local host name */
+  ssl_pending			/* test for pending input */
 };
 
 				/* security function table */
@@ -588,6 +589,19 @@ long ssl_getdata (SSLSTREAM *stream)
   }
   return LONGT;
 }
+
+/* SSL test for pending input without blocking
+ * Accepts: SSL stream
+ * Returns: T if data can be read without blocking, NIL otherwise
+ */
+
+long ssl_pending (SSLSTREAM *stream)
+{
+				/* decrypted or not yet decrypted data */
+  if ((stream->ictr > 0) || (stream->iextractr > 0)) return T;
+  return tcp_pending (stream->tcpstream);
+}
+
 
 /* SSL send string as record
  * Accepts: SSL stream
@@ -520,6 +520,32 @@ long tcp_getdata (TCPSTREAM *stream)
   (*bn) (BLOCK_NONE,NIL);
   return T;
 }
+
+/* TCP/IP test for pending input without blocking
+ * Accepts: TCP/IP stream
+ * Returns: T if data can be read without blocking, NIL otherwise
+ */
+
+long tcp_pending (TCPSTREAM *stream)
+{
+  int i;
+  fd_set fds,efds;
+  struct timeval tmo;
+  if (stream->ictr > 0) return T;
+				/* can't poll if not a socket */
+  if ((stream->tcpsi == INVALID_SOCKET) || (stream->tcpsi != stream->tcpso))
+    return NIL;
+  tmo.tv_sec = tmo.tv_usec = 0;	/* just poll, never block */
+  FD_ZERO (&fds);		/* initialize selection vector */
+  FD_ZERO (&efds);		/* handle errors too */
+  FD_SET (stream->tcpsi,&fds);	/* set bit in selection vectors */
+  FD_SET (stream->tcpsi,&efds);
+  while (((i = select (stream->tcpsi+1,&fds,NIL,&efds,&tmo)) < 0) &&
+	 (WSAGetLastError () == WSAEINTR));
+				/* errors and EOF count as input too */
+  return i ? T : NIL;
+}
+
 
 /* TCP/IP send string as record
  * Accepts: TCP/IP stream
@@ -80,7 +80,8 @@ static struct ssl_driver ssldriver = {
   ssl_host,			/* return host name */
   ssl_remotehost,		/* return remote host name */
   ssl_port,			/* return port number */
-  ssl_localhost			/* return local host name */
+  ssl_localhost,		/* return local host name */
+  ssl_pending			/* test for pending input */
 };
 				/* non-NIL if doing SSL primary I/O */
 static SSLSTDIOSTREAM *sslstdio = NIL;
@@ -543,6 +544,19 @@ long ssl_getdata (SSLSTREAM *stream)
   (*bn) (BLOCK_NONE,NIL);
   return T;
 }
+
+/* SSL test for pending input without blocking
+ * Accepts: SSL stream
+ * Returns: T if data can be read without blocking, NIL otherwise
+ */
+
+long ssl_pending (SSLSTREAM *stream)
+{
+  if (stream->ictr > 0) return T;
+  if (!stream->con) return NIL;	/* decrypted data or new data from network */
+  return (SSL_pending (stream->con) > 0) || tcp_pending (stream->tcpstream);
+}
+
 
 /* SSL send string as record
  * Accepts: SSL stream
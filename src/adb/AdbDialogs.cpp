@@ -541,6 +541,7 @@ void wxAdbExpandDialog::OnBtnDelete(wxCommandEvent& WXUNUSED(event))
 
    // remember to not use it for the expansion again
    entry->SetField(AdbField_ExpandPriority, _T("-1"));
+   AdbNotifyChanged(entry);
 
    entry->DecRef();
 }
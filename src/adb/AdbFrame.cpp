@@ -1954,7 +1954,10 @@ void wxAdbEditFrame::DoUndoChanges()
 
 bool wxAdbEditFrame::OnMEvent(MEventData& d)
 {
-   if ( d.GetId() == MEventId_NewADB )
+   // we only handle the new books here, the editor doesn't update the books
+   // already shown in it when they're modified elsewhere
+   if ( d.GetId() == MEventId_NewADB &&
+            ((MEventNewADBData &)d).IsNewBook() )
    {
       MEventNewADBData& data = (MEventNewADBData &)d;
 
@@ -3316,6 +3319,8 @@ void wxAdbNotebook::SaveChanges()
     wxString str;
     m_pAdbEntry->GetField(AdbField_NickName, &str);
     if ( m_bDirty ) {
+      AdbNotifyChanged(m_pAdbEntry);
+
       wxLogStatus((wxFrame *)this->GetGrandParent(),
                   _("Entry '%s' saved."), str);
     }
@@ -3943,6 +3948,7 @@ void AdbTreeEntry::CopyData(const AdbTreeEntry& other)
     wxCHECK_RET( other.IsOnClipboard() && entry, _T("error copying data") );
 
     other.m_data->Copy(entry);
+    AdbNotifyChanged(entry);
     entry->DecRef();
   }
 
@@ -4106,8 +4112,10 @@ AdbTreeElement *AdbTreeNode::CreateChild(const wxString& name, bool bGroup)
   }
 
   // we don't need it for now
-  if ( pAdbEntry )
+  if ( pAdbEntry ) {
+    AdbNotifyChanged(pAdbEntry);
     pAdbEntry->DecRef();
+  }
 
   return pTreeEntry;
 }
@@ -4118,6 +4126,9 @@ void AdbTreeNode::DeleteChild(AdbTreeElement *child)
 
   m_children.Remove(child);
 
+  // the entries of the child are going to disappear from this book
+  AdbNotifyChanged(m_pGroup);
+
   switch ( child->GetKind() ) {
     case TreeElement_Entry:
       m_pGroup->DeleteEntry(child->GetName());
@@ -217,6 +217,9 @@ bool DoAdbImport(const String& filename,
       // start importing: recursively copy all entries from the foreign ADB into
       // the native one
       ok = AdbImportGroup(importer, group, wxEmptyString);
+
+      // even if it failed, some entries could have been already imported
+      AdbNotifyChanged(group);
    }
 
    return ok;
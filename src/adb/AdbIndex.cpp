@@ -0,0 +1,328 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   adb/AdbIndex.cpp - AdbLookupIndex class implementation
+// Purpose:     AdbLookupIndex allows to quickly find matching ADB entries
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+#  include "Mcommon.h"
+#endif // USE_PCH
+
+#include "adb/AdbEntry.h"
+#include "adb/AdbIndex.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the fields we index
+static const int ADB_INDEX_FIELDS = AdbLookup_NickName |
+                                    AdbLookup_FullName |
+                                    AdbLookup_EMail;
+
+// the length of the strings we index all substrings of
+static const size_t TRIGRAM_LEN = 3;
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// return the lower case version of the string in the form we store it in
+static inline std::wstring NormalizeString(const String& s)
+{
+   return s.Lower().ToStdWstring();
+}
+
+// return true if the string s starts with the prefix
+static inline bool StartsWith(const std::wstring& s, const std::wstring& prefix)
+{
+   return s.compare(0, prefix.length(), prefix) == 0;
+}
+
+// compare the matches by relevance
+static bool CompareMatches(const AdbLookupIndex::Match& m1,
+                           const AdbLookupIndex::Match& m2)
+{
+   // AdbLookup_NickName < FullName < EMail, which is exactly the order of
+   // the relevance of the fields
+   if ( m1.field != m2.field )
+      return m1.field < m2.field;
+
+   if ( m1.isPrefix != m2.isPrefix )
+      return m1.isPrefix;
+
+   return m1.id < m2.id;
+}
+
+// ============================================================================
+// AdbLookupIndex implementation
+// ============================================================================
+
+AdbLookupIndex::AdbLookupIndex()
+{
+   m_isBuilt = true;
+}
+
+/* static */
+bool AdbLookupIndex::CanFind(const String& what, int where, int how)
+{
+   // we don't index the other fields
+   if ( where & ~ADB_INDEX_FIELDS )
+      return false;
+
+   if ( how & AdbLookup_CaseSensitive )
+      return false;
+
+   // AdbEntry::Matches() interprets the wildcards in the string, we don't
+   return !what.empty() && what.find_first_of(_T("*?")) == String::npos;
+}
+
+/* static */
+AdbLookupIndex::Trigram
+AdbLookupIndex::GetTrigram(const std::wstring& s, size_t pos)
+{
+   // 21 bits are enough for any Unicode character
+   Trigram t = 0;
+   for ( size_t n = 0; n < TRIGRAM_LEN; n++ )
+   {
+      t <<= 21;
+      t |= (Trigram)s[pos + n] & 0x1fffff;
+   }
+
+   return t;
+}
+
+void AdbLookupIndex::Add(size_t id, int field, const String& value)
+{
+   ASSERT_MSG( field & ADB_INDEX_FIELDS, _T("this field is not indexed") );
+
+   if ( value.empty() )
+      return;
+
+   Value v;
+   v.text = NormalizeString(value);
+   v.id = id;
+   v.field = field;
+
+   m_values.push_back(v);
+
+   m_isBuilt = false;
+}
+
+void AdbLookupIndex::Clear()
+{
+   m_values.clear();
+   m_sorted.clear();
+   m_trigrams.clear();
+
+   m_isBuilt = true;
+}
+
+void AdbLookupIndex::Build() const
+{
+   if ( m_isBuilt )
+      return;
+
+   const size_t count = m_values.size();
+
+   m_sorted.resize(count);
+   for ( size_t n = 0; n < count; n++ )
+      m_sorted[n] = n;
+
+   std::sort(m_sorted.begin(), m_sorted.end(),
+             [this](size_t n1, size_t n2)
+             {
+               return m_values[n1].text < m_values[n2].text;
+             });
+
+   // reserve enough space for all trigrams, even if some of them are repeated
+   size_t countTrigrams = 0;
+   for ( size_t n = 0; n < count; n++ )
+   {
+      const size_t len = m_values[n].text.length();
+      if ( len >= TRIGRAM_LEN )
+         countTrigrams += len - TRIGRAM_LEN + 1;
+   }
+
+   m_trigrams.clear();
+   m_trigrams.reserve(countTrigrams);
+
+   std::vector<Trigram> trigrams;
+   for ( size_t n = 0; n < count; n++ )
+   {
+      const std::wstring& text = m_values[n].text;
+      if ( text.length() < TRIGRAM_LEN )
+         continue;
+
+      // only store each trigram once for each value
+      trigrams.clear();
+      for ( size_t pos = 0; pos <= text.length() - TRIGRAM_LEN; pos++ )
+         trigrams.push_back(GetTrigram(text, pos));
+
+      std::sort(trigrams.begin(), trigrams.end());
+      trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                     trigrams.end());
+
+      for ( size_t t = 0; t < trigrams.size(); t++ )
+         m_trigrams.push_back(TrigramOccurrence(trigrams[t], n));
+   }
+
+   // as we add the values in order, the occurrences of the same trigram are
+   // sorted by the value index too
+   std::sort(m_trigrams.begin(), m_trigrams.end());
+
+   m_isBuilt = true;
+}
+
+void
+AdbLookupIndex::AddMatch(size_t n,
+                         int where,
+                         const std::wstring& what,
+                         std::vector<Match>& matches) const
+{
+   const Value& v = m_values[n];
+   if ( !(v.field & where) )
+      return;
+
+   Match m;
+   m.id = v.id;
+   m.field = v.field;
+   m.isPrefix = StartsWith(v.text, what);
+
+   matches.push_back(m);
+}
+
+size_t
+AdbLookupIndex::Find(const String& whatOrig,
+                     int where,
+                     int how,
+                     std::vector<Match>& matchesOut) const
+{
+   CHECK( CanFind(whatOrig, where, how), 0,
+          _T("AdbLookupIndex can't be used for this lookup") );
+
+   Build();
+
+   const std::wstring what = NormalizeString(whatOrig);
+
+   std::vector<Match> matches;
+   if ( how & AdbLookup_Substring )
+   {
+      if ( what.length() < TRIGRAM_LEN )
+      {
+         // we have no choice but to look at everything
+         const size_t count = m_values.size();
+         for ( size_t n = 0; n < count; n++ )
+         {
+            if ( m_values[n].text.find(what) != std::wstring::npos )
+               AddMatch(n, where, what, matches);
+         }
+      }
+      else
+      {
+         // find the rarest trigram of the string: all values containing the
+         // string must contain it
+         typedef std::vector<TrigramOccurrence>::const_iterator Iter;
+
+         Iter first = m_trigrams.end(),
+              last = m_trigrams.end();
+         for ( size_t pos = 0; pos <= what.length() - TRIGRAM_LEN; pos++ )
+         {
+            const Trigram t = GetTrigram(what, pos);
+            const Iter i = std::lower_bound(m_trigrams.begin(),
+                                            m_trigrams.end(),
+                                            TrigramOccurrence(t, 0));
+            Iter j = i;
+            while ( j != m_trigrams.end() && j->first == t )
+               ++j;
+
+            if ( pos == 0 || j - i < last - first )
+            {
+               first = i;
+               last = j;
+            }
+
+            if ( first == last )
+            {
+               // no values with this trigram at all
+               break;
+            }
+         }
+
+         // and check which of them really contain it
+         for ( Iter i = first; i != last; ++i )
+         {
+            if ( m_values[i->second].text.find(what) != std::wstring::npos )
+               AddMatch(i->second, where, what, matches);
+         }
+      }
+   }
+   else // exact or prefix match
+   {
+      const bool exact = !(how & AdbLookup_StartsWith);
+
+      std::vector<size_t>::const_iterator i = std::lower_bound
+                                              (
+                                                m_sorted.begin(),
+                                                m_sorted.end(),
+                                                what,
+                                                [this](size_t n,
+                                                       const std::wstring& s)
+                                                {
+                                                  return m_values[n].text < s;
+                                                }
+                                              );
+
+      for ( ; i != m_sorted.end(); ++i )
+      {
+         const std::wstring& text = m_values[*i].text;
+         if ( !StartsWith(text, what) )
+            break;
+
+         if ( !exact || text.length() == what.length() )
+            AddMatch(*i, where, what, matches);
+      }
+   }
+
+   // leave only the best match for each element
+   std::sort(matches.begin(), matches.end(),
+             [](const Match& m1, const Match& m2)
+             {
+               if ( m1.id != m2.id )
+                  return m1.id < m2.id;
+
+               return CompareMatches(m1, m2);
+             });
+
+   matches.erase(std::unique(matches.begin(), matches.end(),
+                             [](const Match& m1, const Match& m2)
+                             {
+                               return m1.id == m2.id;
+                             }),
+                 matches.end());
+
+   // and finally sort them by relevance
+   std::sort(matches.begin(), matches.end(), CompareMatches);
+
+   matchesOut.insert(matchesOut.end(), matches.begin(), matches.end());
+
+   return matches.size();
+}
@@ -39,6 +39,14 @@
 #include "adb/AdbManager.h"
 #include "adb/AdbDataProvider.h"
 #include "adb/AdbDialogs.h"
+#include "adb/AdbIndex.h"
+
+#include "MEvent.h"
+
+#include <wx/stopwatch.h>
+
+#include <algorithm>
+#include <vector>
 
 // ----------------------------------------------------------------------------
 // options we use here
@@ -96,6 +104,82 @@ static bool AdbLookupForEntriesOrGroups(
     }                                       \
   }
 
+// ----------------------------------------------------------------------------
+// lookup index
+// ----------------------------------------------------------------------------
+
+// the lookup index of all entries of a book
+struct AdbBookIndex
+{
+  AdbBookIndex() { isValid = false; }
+  ~AdbBookIndex() { Clear(); }
+
+  void Clear()
+  {
+    CLEAR_ADB_ARRAY(entries);
+    entries.Clear();
+    entriesToIgnore.Clear();
+    index.Clear();
+
+    isValid = false;
+  }
+
+  // the index of the fields of the entries below, the ids used in it are the
+  // indices in this array
+  AdbLookupIndex index;
+
+  // all the entries of the book which may be used for expansion, IncRef()'d
+  ArrayAdbEntries entries;
+
+  // descriptions of the entries which must never be used for expansion
+  wxSortedArrayString entriesToIgnore;
+
+  // false if the index must be (re)built before being used
+  bool isValid;
+};
+
+// the index for each book in gs_booksCache, built on demand when the book is
+// searched for the first time and invalidated by AdbIndexInvalidator
+static std::vector<AdbBookIndex *> gs_indexCache;
+
+// invalidates the index of the books when MEventNewADBData is received
+class AdbIndexInvalidator : public MEventReceiver
+{
+public:
+  AdbIndexInvalidator()
+  {
+    m_regCookie = MEventManager::Register(*this, MEventId_NewADB);
+  }
+
+  virtual ~AdbIndexInvalidator()
+  {
+    if ( m_regCookie )
+      MEventManager::Deregister(m_regCookie);
+  }
+
+  virtual bool OnMEvent(MEventData& event);
+
+private:
+  void *m_regCookie;
+
+  DECLARE_NO_COPY_CLASS(AdbIndexInvalidator)
+};
+
+// created together with the first book index and deleted with the last one
+static AdbIndexInvalidator *gs_indexInvalidator = NULL;
+
+// add all entries of this group and its subgroups to the index
+static void IndexGroup(AdbBookIndex& bookIndex, AdbEntryGroup *pGroup);
+
+// return the up to date index for the given book or NULL if it's not cached
+static AdbBookIndex *GetBookIndex(AdbBook *book);
+
+// look for the groups whose name starts with the given string recursively,
+// this is the part of GroupLookup() which doesn't depend on the entries
+static void GroupNameLookup(ArrayAdbGroups& aGroups,
+                            AdbEntryGroup *pGroup,
+                            const String& nameMatch);
+
 // ============================================================================
 // implementation
 // ============================================================================
@@ -217,6 +301,207 @@ static void GroupLookup(ArrayAdbEntries& aEntries,
   }
 }
 
+static void IndexGroup(AdbBookIndex& bookIndex, AdbEntryGroup *pGroup)
+{
+  wxArrayString aNames;
+  size_t nGroupCount = pGroup->GetGroupNames(aNames);
+  for ( size_t nGroup = 0; nGroup < nGroupCount; nGroup++ ) {
+    AdbEntryGroup *pSubGroup = pGroup->GetGroup(aNames[nGroup]);
+    if ( pSubGroup ) {
+      IndexGroup(bookIndex, pSubGroup);
+
+      pSubGroup->DecRef();
+    }
+  }
+
+  AdbLookupIndex& index = bookIndex.index;
+
+  String value;
+  aNames.Empty();
+  size_t nEntryCount = pGroup->GetEntryNames(aNames);
+  for ( size_t nEntry = 0; nEntry < nEntryCount; nEntry++ ) {
+    AdbEntry *pEntry = pGroup->GetEntry(aNames[nEntry]);
+    if ( !pEntry )
+      continue;
+
+    // see the comment in GroupLookup()
+    if ( pEntry->GetField(AdbField_ExpandPriority) == _T("-1") ) {
+      bookIndex.entriesToIgnore.Add(pEntry->GetDescription());
+
+      pEntry->DecRef();
+      continue;
+    }
+
+    const size_t id = bookIndex.entries.GetCount();
+    bookIndex.entries.Add(pEntry);
+
+    index.Add(id, AdbLookup_NickName, pEntry->GetField(AdbField_NickName));
+    index.Add(id, AdbLookup_FullName, pEntry->GetField(AdbField_FullName));
+    index.Add(id, AdbLookup_EMail, pEntry->GetField(AdbField_EMail));
+
+    size_t nEMailCount = pEntry->GetEMailCount();
+    for ( size_t nEMail = 0; nEMail < nEMailCount; nEMail++ ) {
+      pEntry->GetEMail(nEMail, &value);
+      index.Add(id, AdbLookup_EMail, value);
+    }
+  }
+}
+
+static AdbBookIndex *GetBookIndex(AdbBook *book)
+{
+  int nBook = gs_booksCache.Index(book);
+  if ( nBook == wxNOT_FOUND )
+    return NULL;
+
+  AdbBookIndex *bookIndex = gs_indexCache[nBook];
+  if ( !bookIndex->isValid ) {
+    wxStopWatch sw;
+
+    bookIndex->Clear();
+    IndexGroup(*bookIndex, book);
+    bookIndex->isValid = true;
+
+    wxLogTrace(_T("adb"), _T("Indexed %lu entries of the book '%s' in %ldms."),
+               (unsigned long)bookIndex->entries.GetCount(),
+               book->GetName(), sw.Time());
+  }
+
+  return bookIndex;
+}
+
+static void GroupNameLookup(ArrayAdbGroups& aGroups,
+                            AdbEntryGroup *pGroup,
+                            const String& nameMatch)
+{
+  wxArrayString aNames;
+  size_t nGroupCount = pGroup->GetGroupNames(aNames);
+  for ( size_t nGroup = 0; nGroup < nGroupCount; nGroup++ ) {
+    AdbEntryGroup *pSubGroup = pGroup->GetGroup(aNames[nGroup]);
+    if ( !pSubGroup )
+      continue;
+
+    GroupNameLookup(aGroups, pSubGroup, nameMatch);
+
+    if ( aNames[nGroup].Lower().Matches(nameMatch) ) {
+      aGroups.Add(pSubGroup);
+    }
+    else {
+      pSubGroup->DecRef();
+    }
+  }
+}
+
+// a match found in the index of the given book
+struct AdbIndexMatch
+{
+  AdbBookIndex *bookIndex;
+  AdbLookupIndex::Match match;
+};
+
+// sort the matches from different books by relevance only, keeping the order
+// of the books for the matches of the same relevance
+static bool CompareIndexMatches(const AdbIndexMatch& m1,
+                                const AdbIndexMatch& m2)
+{
+  if ( m1.match.field != m2.match.field )
+    return m1.match.field < m2.match.field;
+
+  return m1.match.isPrefix && !m2.match.isPrefix;
+}
+
+// the same as AdbLookupForEntriesOrGroups() but using the index, can only be
+// used if AdbLookupIndex::CanFind() returns true
+static void IndexLookup(ArrayAdbEntries& aEntries,
+                        ArrayAdbEntries *aMoreEntries,
+                        const String& what,
+                        int where,
+                        int how,
+                        const ArrayAdbBooks& aBooks,
+                        ArrayAdbGroups *aGroups)
+{
+  const String nameMatch = what.Lower() + _T('*');
+
+  std::vector<AdbIndexMatch> matches;
+  std::vector<AdbLookupIndex::Match> bookMatches;
+  wxSortedArrayString entriesToIgnore;
+  std::vector<AdbBookIndex *> bookIndices;
+
+  size_t nBookCount = aBooks.GetCount();
+  for ( size_t nBook = 0; nBook < nBookCount; nBook++ ) {
+    AdbBook *book = aBooks[nBook];
+
+    AdbBookIndex *bookIndex = GetBookIndex(book);
+    if ( !bookIndex ) {
+      // not one of our books, can't use the index for it
+      GroupLookup(aEntries, aMoreEntries, book, what, where, how,
+                  aGroups, &entriesToIgnore);
+      continue;
+    }
+
+    if ( aGroups ) {
+      if ( book->GetName().Lower().Matches(nameMatch) ) {
+        book->IncRef();
+
+        aGroups->Add(book);
+      }
+
+      GroupNameLookup(*aGroups, book, nameMatch);
+    }
+
+    bookIndices.push_back(bookIndex);
+
+    bookMatches.clear();
+    bookIndex->index.Find(what, where, how, bookMatches);
+
+    AdbIndexMatch m;
+    m.bookIndex = bookIndex;
+    for ( size_t n = 0; n < bookMatches.size(); n++ ) {
+      m.match = bookMatches[n];
+      matches.push_back(m);
+    }
+  }
+
+  // an entry excluded from expansion in any book excludes all entries with
+  // the same address in all the other ones
+  for ( size_t n = 0; n < bookIndices.size(); n++ ) {
+    const wxSortedArrayString& ignore = bookIndices[n]->entriesToIgnore;
+    for ( size_t i = 0; i < ignore.GetCount(); i++ ) {
+      entriesToIgnore.Add(ignore[i]);
+    }
+  }
+
+  std::stable_sort(matches.begin(), matches.end(), CompareIndexMatches);
+
+  for ( size_t n = 0; n < matches.size(); n++ ) {
+    AdbEntry *pEntry = matches[n].bookIndex->entries[matches[n].match.id];
+
+    if ( !entriesToIgnore.IsEmpty() &&
+          entriesToIgnore.Index(pEntry->GetDescription()) != wxNOT_FOUND )
+      continue;
+
+    // the index only finds the candidates, the entry itself still decides
+    // whether it matches and where exactly as the providers can match
+    // differently (e.g. only in e-mail)
+    switch ( pEntry->Matches(what, where, how) ) {
+      default:                  // matches elsewhere
+        if ( aMoreEntries ) {
+          pEntry->IncRef();
+          aMoreEntries->Add(pEntry);
+          break;
+        }
+        // else: fall through
+
+      case AdbLookup_NickName:  // match in the entry name
+        pEntry->IncRef();
+        aEntries.Add(pEntry);
+        break;
+
+      case 0:                   // not found at all
+        break;
+    }
+  }
+}
+
 static bool
 AdbLookupForEntriesOrGroups(ArrayAdbEntries& aEntries,
                             ArrayAdbEntries *aMoreEntries,
@@ -231,11 +516,18 @@ AdbLookupForEntriesOrGroups(ArrayAdbEntries& aEntries,
   if ( paBooks == NULL || paBooks->IsEmpty() )
     paBooks = &gs_booksCache;
 
-  wxSortedArrayString entriesToIgnore;
-  size_t nBookCount = paBooks->Count();
-  for ( size_t nBook = 0; nBook < nBookCount; nBook++ ) {
-    GroupLookup(aEntries, aMoreEntries,
-                (*paBooks)[nBook], what, where, how, aGroups, &entriesToIgnore);
+  if ( AdbLookupIndex::CanFind(what, where, how) ) {
+    IndexLookup(aEntries, aMoreEntries, what, where, how, *paBooks, aGroups);
+  }
+  else {
+    // fall back to examining all entries
+    wxSortedArrayString entriesToIgnore;
+    size_t nBookCount = paBooks->Count();
+    for ( size_t nBook = 0; nBook < nBookCount; nBook++ ) {
+      GroupLookup(aEntries, aMoreEntries,
+                  (*paBooks)[nBook], what, where, how, aGroups,
+                  &entriesToIgnore);
+    }
   }
 
   // return true if something found
@@ -259,6 +551,57 @@ bool AdbLookup(ArrayAdbEntries& aEntries,
    return !aEntries.IsEmpty();
 }
 
+void AdbNotifyChanged(AdbElement *element)
+{
+  // empty name means that all books changed
+  String adbname,
+         provname;
+  if ( element ) {
+    // the book is the only element without parent group
+    AdbElement *root = element;
+    for ( AdbEntryGroup *group = element->GetGroup();
+          group;
+          group = group->GetGroup() ) {
+      root = group;
+    }
+
+    AdbBook * const book = (AdbBook *)root;
+    adbname = book->GetFileName();
+
+    int nBook = gs_booksCache.Index(book);
+    if ( nBook != wxNOT_FOUND )
+      provname = gs_provCache[nBook];
+  }
+
+  MEventManager::Send(new MEventNewADBData(adbname, provname,
+                                           false /* existing book */));
+}
+
+bool AdbIndexInvalidator::OnMEvent(MEventData& event)
+{
+  const MEventNewADBData& data = (MEventNewADBData &)event;
+  const String& adbname = data.GetAdbName(),
+              & provname = data.GetProviderName();
+
+  // a new book could also have been created by overwriting an existing one,
+  // so don't ignore the events for them
+  for ( size_t n = 0; n < gs_booksCache.Count(); n++ ) {
+    if ( !adbname.empty() ) {
+      // use the same test as FindInCache()
+      if ( !provname.empty() && provname != gs_provCache[n] )
+        continue;
+
+      if ( !gs_booksCache[n]->IsSameAs(adbname) )
+        continue;
+    }
+
+    // don't rebuild it now, the book is probably going to be changed again
+    gs_indexCache[n]->Clear();
+  }
+
+  return true;
+}
+
 bool
 AdbExpand(wxArrayString& results, const String& what, int how, wxFrame *frame)
 {
@@ -759,6 +1102,10 @@ AdbBook *AdbManager::CreateBook(const String& name,
       book->IncRef();
       gs_booksCache.Add(book);
       gs_provCache.Add(prov->GetProviderName());
+      gs_indexCache.push_back(new AdbBookIndex);
+
+      if ( !gs_indexInvalidator )
+        gs_indexInvalidator = new AdbIndexInvalidator;
    }
 
    if ( prov )
@@ -868,6 +1215,16 @@ void AdbManager::LoadAll()
 
 void AdbManager::ClearCache()
 {
+  // the entries in the index must be released before the books themselves
+  for ( size_t n = 0; n < gs_indexCache.size(); n++ ) {
+    delete gs_indexCache[n];
+  }
+
+  gs_indexCache.clear();
+
+  delete gs_indexInvalidator;
+  gs_indexInvalidator = NULL;
+
   size_t nCount = gs_booksCache.Count();
   for ( size_t n = 0; n < nCount; n++ ) {
     gs_booksCache[n]->DecRef();
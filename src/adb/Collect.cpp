@@ -206,6 +206,7 @@ void AutoCollectAddress(const String& email,
             AdbEntry *entry = matches[0];
             entry->IncRef();
             entry->AddEMail(email);
+            AdbNotifyChanged(entry);
 
             wxString nickname;
             entry->GetField(AdbField_NickName, &nickname);
@@ -267,6 +268,7 @@ void AutoCollectAddress(const String& email,
                   }
 
                   entry->SetField(AdbField_Comments, comment);
+                  AdbNotifyChanged(entry);
                   entry->DecRef();
 
                   if ( frame )
@@ -300,6 +302,7 @@ void AutoCollectAddress(const String& email,
             if ( !nameOld || nameOld == nameFromEmail )
             {
                entry->SetField(AdbField_FullName, name);
+               AdbNotifyChanged(entry);
             }
          }
          //else: we don't have the real fullname anyhow
@@ -436,6 +439,8 @@ int InteractivelyCollectAddresses(const wxArrayString& addresses,
             }
          }
 
+         AdbNotifyChanged(autocollectbook);
+
          wxLogStatus(parent, _("Saved %zu addresses."), saved);
        }
        //else: cancelled
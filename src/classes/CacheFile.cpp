@@ -29,12 +29,27 @@
    #include <wx/wxchar.h>        // for wxPrintf/Scanf
 #endif // USE_PCH
 
+#include <wx/file.h>
 #include <wx/filename.h>
 #include <wx/filefn.h>        // for wxMkdir
 #include <wx/textfile.h>
 
 #include "CacheFile.h"
 
+#ifdef OS_UNIX
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+#endif // OS_UNIX
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the maximal length of the header line of a binary file
+static const size_t BINARY_HEADER_LINE_MAX = 256;
+
 // ============================================================================
 // implementation
 // ============================================================================
@@ -52,6 +67,35 @@ String CacheFile::GetCacheDirName()
    return dirname;
 }
 
+/* static */
+bool CacheFile::CreateDirFor(const String& filename)
+{
+   String dirname = wxFileName(filename).GetPath();
+
+   if ( !wxDirExists(dirname) )
+   {
+      if ( !wxMkdir(dirname) )
+      {
+         static String s_dirFailedCreate;
+
+         // remember if we had already given the message about this directory
+         // and don't do any more - as we're called perdiodically, this would
+         // result in a flood of messages if the user went away from the
+         // terminal
+         if ( dirname != s_dirFailedCreate )
+         {
+            s_dirFailedCreate = dirname;
+
+            wxLogError(_("Failed to create directory for cache files."));
+         }
+
+         return false;
+      }
+   }
+
+   return true;
+}
+
 // ----------------------------------------------------------------------------
 // version checking
 // ----------------------------------------------------------------------------
@@ -107,36 +151,67 @@ int CacheFile::CheckFormatVersion(const String& header, int *version) const
 }
 
 // ----------------------------------------------------------------------------
-// saving/loading
+// binary files support
 // ----------------------------------------------------------------------------
 
-bool CacheFile::Save()
+size_t CacheFile::WriteBinaryHeader(wxTempFile& file) const
 {
-   String filename = GetFileName();
+   int verMaj, verMin;
+   SplitVersion(GetFormatVersion(), verMaj, verMin);
 
-   String dirname = wxFileName(filename).GetPath();
+   String header;
+   header.Printf(GetFileHeader(), verMaj, verMin);
 
-   if ( !wxDirExists(dirname) )
-   {
-      if ( !wxMkdir(dirname) )
-      {
-         static String s_dirFailedCreate;
+   header += '\n';
 
-         // remember if we had already given the message about this directory
-         // and don't do any more - as we're called perdiodically, this would
-         // result in a flood of messages if the user went away from the
-         // terminal
-         if ( dirname != s_dirFailedCreate )
-         {
-            s_dirFailedCreate = dirname;
+   const wxCharBuffer buf(header.ToAscii());
+   const size_t len = strlen(buf);
 
-            wxLogError(_("Failed to create directory for cache files."));
-         }
+   static const char padding[8] = { 0 };
+   const size_t offsetBin = (len + 7) & ~7;
 
-         return false;
-      }
+   if ( !file.Write(buf, len) || !file.Write(padding, offsetBin - len) )
+      return 0;
+
+   return offsetBin;
+}
+
+size_t
+CacheFile::CheckBinaryHeader(const MappedCacheFile& file, int *version) const
+{
+   const char * const data = file.GetData();
+   const size_t size = file.GetSize();
+
+   const char *eol = (const char *)memchr(data, '\n',
+                                          wxMin(size, BINARY_HEADER_LINE_MAX));
+   if ( !eol )
+   {
+      wxLogDebug(_T("Corrupted cache file \"%s\""), GetFileName());
+
+      return 0;
+   }
+
+   if ( CheckFormatVersion(String(data, eol - data), version) <= 0 )
+   {
+      // either a newer version or an invalid file, ignore it in any case
+      return 0;
    }
 
+   // the binary part starts at the next multiple of 8 after the header line
+   return ((eol - data) + 1 + 7) & ~7;
+}
+
+// ----------------------------------------------------------------------------
+// saving/loading
+// ----------------------------------------------------------------------------
+
+bool CacheFile::Save()
+{
+   String filename = GetFileName();
+
+   if ( !CreateDirFor(filename) )
+      return false;
+
    wxTempFile file;
    bool ok = file.Open(filename);
 
@@ -226,3 +301,83 @@ bool CacheFile::Load()
    return ok;
 }
 
+
+// ============================================================================
+// MappedCacheFile implementation
+// ============================================================================
+
+bool MappedCacheFile::Open(const String& filename)
+{
+   Close();
+
+   if ( !wxFileExists(filename) )
+      return false;
+
+#ifdef OS_UNIX
+   int fd = open(filename.fn_str(), O_RDONLY);
+   if ( fd != -1 )
+   {
+      struct stat st;
+      if ( fstat(fd, &st) == 0 && st.st_size > 0 )
+      {
+         void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if ( p != MAP_FAILED )
+         {
+            m_data = (char *)p;
+            m_size = st.st_size;
+            m_isMapped = true;
+         }
+      }
+
+      close(fd);
+   }
+#endif // OS_UNIX
+
+   if ( !m_data )
+   {
+      // no mmap() or it failed, read the entire file in memory then
+      wxLogNull noLog;
+
+      wxFile file(filename);
+      wxFileOffset len = file.IsOpened() ? file.Length() : 0;
+      if ( len > 0 )
+      {
+         m_data = (char *)malloc(len);
+         if ( m_data && file.Read(m_data, len) == len )
+         {
+            m_size = len;
+         }
+         else
+         {
+            Close();
+         }
+      }
+
+      if ( !m_data )
+      {
+         wxLogDebug(_T("Failed to read cache file \"%s\""), filename);
+
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void MappedCacheFile::Close()
+{
+   if ( m_data )
+   {
+#ifdef OS_UNIX
+      if ( m_isMapped )
+         munmap(m_data, m_size);
+      else
+#endif // OS_UNIX
+         free(m_data);
+
+      m_data = NULL;
+   }
+
+   m_size = 0;
+   m_isMapped = false;
+}
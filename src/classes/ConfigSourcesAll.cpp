@@ -21,6 +21,7 @@
 
 #ifndef USE_PCH
    #include "Mcommon.h"
+   #include "Profile.h"
    #include "Mdefaults.h"
    #include "MApplication.h"
 
@@ -164,6 +165,8 @@ public:
          foundAny = true;
          if ( !i->DeleteEntry(path) )
             return false;
+
+         Profile::InvalidateCache();
       }
 
       return true;
@@ -186,6 +189,8 @@ public:
          foundAny = true;
          if ( !i->DeleteGroup(path) )
             return false;
+
+         Profile::InvalidateCache();
       }
 
       return true;
@@ -477,9 +482,17 @@ AllConfigSources::Write(const String& path,
 
 
    // finally do write it
-   return data.GetType() == LookupData::LD_LONG
-            ? config->Write(fullpath, data.GetLong())
-            : config->Write(fullpath, data.GetString());
+   const bool rc = data.GetType() == LookupData::LD_LONG
+                     ? config->Write(fullpath, data.GetLong())
+                     : config->Write(fullpath, data.GetString());
+
+   // all changes to the options, whether done via Profile or the global
+   // wxConfig, end up here or in the other functions modifying the config
+   // below: invalidate the profiles values cache after (and not before) the
+   // change, so that a value read meanwhile by another thread isn't cached
+   Profile::InvalidateCache();
+
+   return rc;
 }
 
 bool
@@ -527,6 +540,8 @@ AllConfigSources::CopyGroup(const String& pathSrc, const String& pathDst)
       rc &= CopyGroup(i.operator->(), pathSrc, pathDst);
    }
 
+   Profile::InvalidateCache();
+
    return rc;
 }
 
@@ -627,6 +642,8 @@ bool AllConfigSources::Rename(const String& pathOld, const String& nameNew)
       }
    }
 
+   Profile::InvalidateCache();
+
    return rc && numRenamed > 0;
 }
 
@@ -656,6 +673,8 @@ bool AllConfigSources::DeleteEntry(const String& path)
       }
    }
 
+   Profile::InvalidateCache();
+
    return rc;
 }
 
@@ -685,6 +704,8 @@ bool AllConfigSources::DeleteGroup(const String& path)
       }
    }
 
+   Profile::InvalidateCache();
+
    return rc;
 }
 
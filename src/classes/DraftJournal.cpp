@@ -0,0 +1,1160 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   classes/DraftJournal.cpp
+// Purpose:     implementation of DraftJournal class
+// Author:      Mahogany team
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+
+   #include <wx/log.h>
+#endif // USE_PCH
+
+#include <wx/dir.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+
+#include "DraftJournal.h"
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the value written at the start of the journal, allows to detect the files
+// created on the machines with different endianness
+static const wxUint32 DRAFT_JOURNAL_MAGIC = 0x4d444a4e;   // "MDJN"
+
+// the version of the journal format
+static const wxUint32 DRAFT_JOURNAL_VERSION = 1;
+
+// the journal file header
+struct DraftJournalHeader
+{
+   wxUint32 magic;
+   wxUint32 version;
+};
+
+// the kinds of records in the journal
+enum DraftRecordKind
+{
+   DraftRecord_Headers,       // all headers and the headers encoding
+   DraftRecord_Parts,         // change the number of parts to index
+   DraftRecord_Text,          // set the text part at index
+   DraftRecord_Splice,        // replace a range of text in the part at index
+   DraftRecord_Attachment     // set the attachment part at index
+};
+
+// the fixed part of a record: it is followed by the record data consisting of
+// 32 bit integers and strings, see RecordWriter
+//
+// NB: the records are not aligned, always use memcpy() to access them
+struct DraftRecord
+{
+   wxUint32 len;           // total length of the record
+   wxUint32 kind;          // one of DraftRecordKind values
+   wxUint32 index;         // the index of the part the record applies to
+   wxUint32 checksum;      // checksum of the record with this field set to 0
+};
+
+// the extension of the journal files
+#define DRAFT_JOURNAL_EXT _T(".journal")
+
+// the suffix of the temporary files, including the journal being rewritten
+#define DRAFT_JOURNAL_NEW _T(".new")
+
+// the suffix of the journal being compacted: this must be different from
+// DRAFT_JOURNAL_NEW as Rewrite() can be called while the compactor thread is
+// still writing to its file
+#define DRAFT_JOURNAL_COMPACT _T(".compact")
+
+// the suffix of the directory containing the attachments contents
+#define DRAFT_JOURNAL_BLOBS _T(".blobs")
+
+// don't compact the journal until it grew by at least that much
+static const wxFileOffset DRAFT_COMPACT_MIN = 256*1024;
+
+// the size of the buffer used for copying the attached files
+static const size_t DRAFT_COPY_BUFSIZE = 256*1024;
+
+// ----------------------------------------------------------------------------
+// private classes
+// ----------------------------------------------------------------------------
+
+// FNV-1a hash used both for the records checksums and the attachments hashes
+class DraftHash
+{
+public:
+   DraftHash() { m_hash = wxULL(14695981039346656037); }
+
+   void Update(const void *data, size_t len)
+   {
+      const unsigned char *p = (const unsigned char *)data;
+      for ( const unsigned char * const end = p + len; p != end; p++ )
+      {
+         m_hash ^= *p;
+         m_hash *= wxULL(1099511628211);
+      }
+   }
+
+   wxUint32 GetChecksum() const { return (wxUint32)(m_hash ^ (m_hash >> 32)); }
+
+   // the hash used for the attachments includes their size, to make
+   // collisions even less likely
+   String GetHash(wxFileOffset size) const
+   {
+      return String::Format(_T("%08lx%08lx-%lu"),
+                            (unsigned long)(m_hash >> 32),
+                            (unsigned long)(m_hash & 0xffffffff),
+                            (unsigned long)size);
+   }
+
+private:
+   wxUint64 m_hash;
+};
+
+// helper used to create the records
+class RecordWriter
+{
+public:
+   RecordWriter(std::vector<char>& buf, DraftRecordKind kind, size_t index)
+      : m_buf(buf)
+   {
+      m_start = buf.size();
+
+      DraftRecord rec;
+      rec.len = 0;
+      rec.kind = kind;
+      rec.index = index;
+      rec.checksum = 0;
+
+      Put(&rec, sizeof(rec));
+   }
+
+   // finishes the record by filling in its length and checksum
+   ~RecordWriter()
+   {
+      char * const start = &m_buf[m_start];
+
+      DraftRecord rec;
+      memcpy(&rec, start, sizeof(rec));
+      rec.len = m_buf.size() - m_start;
+      memcpy(start, &rec, sizeof(rec));
+
+      DraftHash hash;
+      hash.Update(start, rec.len);
+      rec.checksum = hash.GetChecksum();
+      memcpy(start, &rec, sizeof(rec));
+   }
+
+   void PutInt(wxUint32 n) { Put(&n, sizeof(n)); }
+
+   void PutString(const String& s)
+   {
+      const wxCharBuffer utf8(s.ToUTF8());
+      const size_t len = utf8.length();
+
+      PutInt(len);
+      Put(utf8.data(), len);
+   }
+
+private:
+   void Put(const void *data, size_t len)
+   {
+      const char *p = (const char *)data;
+      m_buf.insert(m_buf.end(), p, p + len);
+   }
+
+   std::vector<char>& m_buf;
+   size_t m_start;
+};
+
+// helper used to parse the records
+class RecordReader
+{
+public:
+   RecordReader(const char *data, size_t len) : m_p(data), m_end(data + len) { }
+
+   bool GetInt(wxUint32 *n)
+   {
+      if ( (size_t)(m_end - m_p) < sizeof(*n) )
+         return false;
+
+      memcpy(n, m_p, sizeof(*n));
+      m_p += sizeof(*n);
+
+      return true;
+   }
+
+   bool GetInt(int *n)
+   {
+      wxUint32 u;
+      if ( !GetInt(&u) )
+         return false;
+
+      *n = (int)u;
+
+      return true;
+   }
+
+   bool GetString(String *s)
+   {
+      wxUint32 len;
+      if ( !GetInt(&len) || (size_t)(m_end - m_p) < len )
+         return false;
+
+      *s = String::FromUTF8(m_p, len);
+      m_p += len;
+
+      return true;
+   }
+
+   bool IsAtEnd() const { return m_p == m_end; }
+
+private:
+   const char *m_p;
+   const char * const m_end;
+};
+
+// the thread compacting the journal
+class DraftJournal::Compactor : public wxThread
+{
+public:
+   Compactor(DraftJournal *journal)
+      : wxThread(wxTHREAD_JOINABLE),
+        m_journal(journal)
+   {
+   }
+
+protected:
+   virtual void *Entry()
+   {
+      m_journal->DoCompact();
+
+      return NULL;
+   }
+
+private:
+   DraftJournal * const m_journal;
+};
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// return the directory used for the blobs of the given journal
+static String GetBlobsDir(const String& filename)
+{
+   return filename + DRAFT_JOURNAL_BLOBS;
+}
+
+// return the file name used for the blob with the given hash
+static String GetBlobFileName(const String& dirBlobs, const String& hash)
+{
+   return dirBlobs + DIR_SEPARATOR + hash;
+}
+
+// read the entire file contents
+static bool ReadFile(const String& filename, wxMemoryBuffer& data)
+{
+   wxFile file;
+   if ( !wxFileExists(filename) || !file.Open(filename) )
+      return false;
+
+   const wxFileOffset len = file.Length();
+   if ( len == wxInvalidOffset )
+      return false;
+
+   if ( file.Read(data.GetWriteBuf(len), len) != len )
+      return false;
+
+   data.UngetWriteBuf(len);
+
+   return true;
+}
+
+// write the record setting the given part
+static void WritePart(std::vector<char>& buf,
+                      const DraftContents::Part& part,
+                      size_t index)
+{
+   if ( part.type == DraftContents::Part::Text )
+   {
+      RecordWriter rec(buf, DraftRecord_Text, index);
+      rec.PutInt(part.encoding);
+      rec.PutString(part.text);
+   }
+   else // attachment
+   {
+      RecordWriter rec(buf, DraftRecord_Attachment, index);
+      rec.PutInt(part.type);
+      rec.PutString(part.hash);
+      rec.PutString(part.mimeType);
+      rec.PutString(part.name);
+      rec.PutString(part.filename);
+      rec.PutString(part.disposition);
+   }
+}
+
+// write the records for the headers
+static void WriteHeaders(std::vector<char>& buf, const DraftContents& contents)
+{
+   RecordWriter rec(buf, DraftRecord_Headers, 0);
+
+   const size_t count = contents.headerNames.size();
+
+   rec.PutInt(contents.encoding);
+   rec.PutInt(count);
+   for ( size_t n = 0; n < count; n++ )
+   {
+      rec.PutString(contents.headerNames[n]);
+      rec.PutString(contents.headerValues[n]);
+   }
+}
+
+// write the records describing the entire contents
+static void WriteContents(std::vector<char>& buf, const DraftContents& contents)
+{
+   WriteHeaders(buf, contents);
+
+   const size_t count = contents.parts.size();
+   for ( size_t n = 0; n < count; n++ )
+      WritePart(buf, contents.parts[n], n);
+}
+
+// write the records describing the changes between the old and new contents
+static size_t WriteChanges(std::vector<char>& buf,
+                           const DraftContents& contentsOld,
+                           const DraftContents& contentsNew)
+{
+   size_t count = 0;
+
+   if ( contentsNew.encoding != contentsOld.encoding ||
+         contentsNew.headerNames != contentsOld.headerNames ||
+          contentsNew.headerValues != contentsOld.headerValues )
+   {
+      WriteHeaders(buf, contentsNew);
+      count++;
+   }
+
+   const size_t countOld = contentsOld.parts.size(),
+                countNew = contentsNew.parts.size();
+
+   if ( countNew < countOld )
+   {
+      RecordWriter rec(buf, DraftRecord_Parts, countNew);
+      count++;
+   }
+
+   for ( size_t n = 0; n < countNew; n++ )
+   {
+      const DraftContents::Part& part = contentsNew.parts[n];
+      if ( n >= countOld )
+      {
+         WritePart(buf, part, n);
+         count++;
+         continue;
+      }
+
+      const DraftContents::Part& partOld = contentsOld.parts[n];
+      if ( part == partOld )
+         continue;
+
+      if ( part.type != DraftContents::Part::Text ||
+            partOld.type != DraftContents::Part::Text ||
+             part.encoding != partOld.encoding )
+      {
+         WritePart(buf, part, n);
+         count++;
+         continue;
+      }
+
+      // only the text changed, find the range which was modified
+      const String& textOld = partOld.text;
+      const String& textNew = part.text;
+
+      String::const_iterator i = textOld.begin(),
+                             j = textNew.begin();
+      size_t prefix = 0;
+      while ( i != textOld.end() && j != textNew.end() && *i == *j )
+      {
+         ++i;
+         ++j;
+         prefix++;
+      }
+
+      String::const_iterator ri = textOld.end(),
+                             rj = textNew.end();
+      size_t suffix = 0;
+      while ( ri != i && rj != j && *(ri - 1) == *(rj - 1) )
+      {
+         --ri;
+         --rj;
+         suffix++;
+      }
+
+      RecordWriter rec(buf, DraftRecord_Splice, n);
+      rec.PutInt(prefix);
+      rec.PutInt(textOld.length() - prefix - suffix);
+      rec.PutString(String(j, rj));
+      count++;
+   }
+
+   return count;
+}
+
+// write the header of the journal file
+static void WriteJournalHeader(std::vector<char>& buf)
+{
+   DraftJournalHeader hdr;
+   hdr.magic = DRAFT_JOURNAL_MAGIC;
+   hdr.version = DRAFT_JOURNAL_VERSION;
+
+   const char *p = (const char *)&hdr;
+   buf.insert(buf.end(), p, p + sizeof(hdr));
+}
+
+// apply a single record to the contents, return false if it's invalid
+static bool ApplyRecord(const DraftRecord& rec,
+                        RecordReader& reader,
+                        DraftContents& contents)
+{
+   std::vector<DraftContents::Part>& parts = contents.parts;
+
+   switch ( rec.kind )
+   {
+      case DraftRecord_Headers:
+         {
+            wxUint32 count;
+            if ( !reader.GetInt(&contents.encoding) || !reader.GetInt(&count) )
+               return false;
+
+            contents.headerNames.clear();
+            contents.headerValues.clear();
+            for ( wxUint32 n = 0; n < count; n++ )
+            {
+               String name, value;
+               if ( !reader.GetString(&name) || !reader.GetString(&value) )
+                  return false;
+
+               contents.headerNames.push_back(name);
+               contents.headerValues.push_back(value);
+            }
+         }
+         break;
+
+      case DraftRecord_Parts:
+         if ( rec.index > parts.size() )
+            return false;
+
+         parts.resize(rec.index);
+         break;
+
+      case DraftRecord_Text:
+      case DraftRecord_Attachment:
+         {
+            if ( rec.index > parts.size() )
+               return false;
+
+            DraftContents::Part part;
+            if ( rec.kind == DraftRecord_Text )
+            {
+               if ( !reader.GetInt(&part.encoding) ||
+                     !reader.GetString(&part.text) )
+                  return false;
+            }
+            else // attachment
+            {
+               wxUint32 type;
+               if ( !reader.GetInt(&type) ||
+                     !reader.GetString(&part.hash) ||
+                      !reader.GetString(&part.mimeType) ||
+                       !reader.GetString(&part.name) ||
+                        !reader.GetString(&part.filename) ||
+                         !reader.GetString(&part.disposition) )
+                  return false;
+
+               if ( type != DraftContents::Part::File &&
+                     type != DraftContents::Part::Data )
+                  return false;
+
+               part.type = (DraftContents::Part::Type)type;
+            }
+
+            if ( rec.index == parts.size() )
+               parts.push_back(part);
+            else
+               parts[rec.index] = part;
+         }
+         break;
+
+      case DraftRecord_Splice:
+         {
+            if ( rec.index >= parts.size() ||
+                  parts[rec.index].type != DraftContents::Part::Text )
+               return false;
+
+            String& text = parts[rec.index].text;
+
+            wxUint32 offset, removed;
+            String inserted;
+            if ( !reader.GetInt(&offset) ||
+                  !reader.GetInt(&removed) ||
+                   !reader.GetString(&inserted) )
+               return false;
+
+            if ( offset > text.length() || removed > text.length() - offset )
+               return false;
+
+            text.replace(offset, removed, inserted);
+         }
+         break;
+
+      default:
+         return false;
+   }
+
+   return reader.IsAtEnd();
+}
+
+// ============================================================================
+// DraftJournal implementation
+// ============================================================================
+
+DraftJournal::DraftJournal(const String& filename)
+            : m_filename(filename),
+              m_dirBlobs(GetBlobsDir(filename))
+{
+   m_sizeFile =
+   m_sizeCompacted = 0;
+   m_generation = 0;
+
+   m_compactor = NULL;
+   m_compacting = 0;
+}
+
+DraftJournal::~DraftJournal()
+{
+   WaitForCompactor();
+}
+
+// ----------------------------------------------------------------------------
+// storing the attachments
+// ----------------------------------------------------------------------------
+
+bool DraftJournal::CreateBlobsDir()
+{
+   if ( wxDirExists(m_dirBlobs) )
+      return true;
+
+   if ( !wxMkdir(m_dirBlobs, 0700) )
+   {
+      wxLogTrace(M_TRACE_DRAFTS, _T("Failed to create directory \"%s\""),
+                 m_dirBlobs);
+
+      return false;
+   }
+
+   return true;
+}
+
+void DraftJournal::AddBlob(const String& hash)
+{
+   wxMutexLocker lock(m_mutex);
+
+   m_blobs.insert(hash);
+   m_blobsPending.insert(hash);
+}
+
+String DraftJournal::AddData(const void *data, size_t len)
+{
+   CHECK( data || !len, String(), _T("NULL attachment data") );
+
+   DraftHash hash;
+   hash.Update(data, len);
+
+   const String hashData = hash.GetHash(len);
+
+   // register the blob before checking if it exists to prevent the compactor
+   // from removing it in the meanwhile
+   AddBlob(hashData);
+
+   const String filename = GetBlobFileName(m_dirBlobs, hashData);
+   if ( wxFileName::GetSize(filename) != wxULongLong(len) )
+   {
+      if ( !CreateBlobsDir() )
+         return String();
+
+      // write the data to a temporary file first to avoid leaving a partially
+      // written blob with the right name
+      const String filenameTmp = filename + DRAFT_JOURNAL_NEW;
+
+      wxLogNull noLog;
+
+      wxFile file;
+      if ( !file.Create(filenameTmp, true, wxS_IRUSR | wxS_IWUSR) ||
+            file.Write(data, len) != len ||
+             !file.Close() ||
+              !wxRenameFile(filenameTmp, filename) )
+      {
+         wxRemoveFile(filenameTmp);
+
+         return String();
+      }
+
+      wxLogTrace(M_TRACE_DRAFTS, _T("Stored %lu bytes of data as %s"),
+                 (unsigned long)len, hashData);
+   }
+
+   return hashData;
+}
+
+bool DraftJournal::ReuseData(const String& hash)
+{
+   wxMutexLocker lock(m_mutex);
+
+   if ( !m_blobs.count(hash) )
+      return false;
+
+   // prevent it from being removed until the next Update()
+   m_blobsPending.insert(hash);
+
+   return true;
+}
+
+String DraftJournal::AddFile(const String& filenameOrig)
+{
+   const wxFileName fn(filenameOrig);
+
+   wxDateTime dtMod;
+   if ( !fn.GetTimes(NULL, &dtMod, NULL) )
+      return String();
+
+   FileInfo info;
+   info.mtime = dtMod.GetTicks();
+   info.size = fn.GetSize().GetValue();
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      std::map<String, FileInfo>::const_iterator
+         i = m_hashesFiles.find(filenameOrig);
+      if ( i != m_hashesFiles.end() &&
+            i->second.mtime == info.mtime &&
+             i->second.size == info.size )
+      {
+         m_blobsPending.insert(i->second.hash);
+
+         return i->second.hash;
+      }
+   }
+
+   if ( !CreateBlobsDir() )
+      return String();
+
+   // copy the file contents to a temporary file computing its hash at the
+   // same time: we can't know the final name of the file before reading it
+   // entirely and we don't want to read the entire file in memory
+   wxLogNull noLog;
+
+   wxFile fileIn(filenameOrig);
+   if ( !fileIn.IsOpened() )
+      return String();
+
+   const String filenameTmp = m_dirBlobs + DIR_SEPARATOR + _T("file")
+                                 + DRAFT_JOURNAL_NEW;
+   wxFile fileOut;
+   if ( !fileOut.Create(filenameTmp, true, wxS_IRUSR | wxS_IWUSR) )
+      return String();
+
+   DraftHash hash;
+   wxFileOffset size = 0;
+
+   wxMemoryBuffer buf(DRAFT_COPY_BUFSIZE);
+   for ( ;; )
+   {
+      const ssize_t len = fileIn.Read(buf.GetData(), DRAFT_COPY_BUFSIZE);
+      if ( len == wxInvalidOffset )
+      {
+         fileOut.Close();
+         wxRemoveFile(filenameTmp);
+
+         return String();
+      }
+
+      if ( !len )
+         break;
+
+      hash.Update(buf.GetData(), len);
+      size += len;
+
+      if ( fileOut.Write(buf.GetData(), len) != (size_t)len )
+      {
+         fileOut.Close();
+         wxRemoveFile(filenameTmp);
+
+         return String();
+      }
+   }
+
+   info.hash = hash.GetHash(size);
+
+   // as in AddData(), this must be done before the blob file is created
+   AddBlob(info.hash);
+
+   const String filename = GetBlobFileName(m_dirBlobs, info.hash);
+   if ( !fileOut.Close() || !wxRenameFile(filenameTmp, filename) )
+   {
+      wxRemoveFile(filenameTmp);
+
+      return String();
+   }
+
+   wxLogTrace(M_TRACE_DRAFTS, _T("Stored file \"%s\" as %s"),
+              filenameOrig, info.hash);
+
+   wxMutexLocker lock(m_mutex);
+   m_hashesFiles[filenameOrig] = info;
+
+   return info.hash;
+}
+
+// ----------------------------------------------------------------------------
+// saving the contents
+// ----------------------------------------------------------------------------
+
+bool DraftJournal::Update(const DraftContents& contents)
+{
+   {
+      wxMutexLocker lock(m_mutex);
+
+      bool ok;
+      if ( !m_sizeFile )
+      {
+         // this is the first time we're called, create the file
+         m_saved = contents;
+         ok = Rewrite();
+      }
+      else
+      {
+         std::vector<char> buf;
+         const size_t count = WriteChanges(buf, m_saved, contents);
+         if ( !count )
+         {
+            m_blobsPending.clear();
+
+            return true;
+         }
+
+         m_saved = contents;
+         if ( Append(buf) )
+         {
+            wxLogTrace(M_TRACE_DRAFTS, _T("Appended %lu records (%lu bytes) ")
+                       _T("to \"%s\""),
+                       (unsigned long)count, (unsigned long)buf.size(),
+                       m_filename);
+
+            ok = true;
+         }
+         else
+         {
+            // if appending failed for whatever reason, try to write the file
+            // anew as its contents doesn't correspond to m_saved any more
+            ok = Rewrite();
+         }
+      }
+
+      if ( !ok )
+      {
+         // we don't know what is in the file now, so rewrite it the next time
+         m_sizeFile = 0;
+
+         return false;
+      }
+
+      m_blobsPending.clear();
+   }
+
+   CompactIfNeeded();
+
+   return true;
+}
+
+bool DraftJournal::Append(const std::vector<char>& records)
+{
+   wxLogNull noLog;
+
+   // check that the file is still the same one we had written
+   wxFile file;
+   if ( !file.Open(m_filename, wxFile::write_append) ||
+         file.Length() != m_sizeFile ||
+          file.Write(&records[0], records.size()) != records.size() ||
+           !file.Close() )
+   {
+      return false;
+   }
+
+   m_sizeFile += records.size();
+
+   return true;
+}
+
+bool DraftJournal::Rewrite()
+{
+   std::vector<char> buf;
+   WriteJournalHeader(buf);
+   WriteContents(buf, m_saved);
+
+   const String filenameTmp = m_filename + DRAFT_JOURNAL_NEW;
+
+   wxLogNull noLog;
+
+   // the file contains the text of the message which can be private, so don't
+   // let the others read it
+   wxFile file;
+   if ( !file.Create(filenameTmp, true, wxS_IRUSR | wxS_IWUSR) ||
+         file.Write(&buf[0], buf.size()) != buf.size() ||
+          !file.Close() ||
+           !wxRenameFile(filenameTmp, m_filename) )
+   {
+      wxRemoveFile(filenameTmp);
+
+      return false;
+   }
+
+   wxLogTrace(M_TRACE_DRAFTS, _T("Wrote %lu bytes to \"%s\""),
+              (unsigned long)buf.size(), m_filename);
+
+   m_sizeFile =
+   m_sizeCompacted = buf.size();
+
+   // any compaction in progress is now useless
+   m_generation++;
+
+   return true;
+}
+
+// ----------------------------------------------------------------------------
+// compacting the journal
+// ----------------------------------------------------------------------------
+
+void DraftJournal::CompactIfNeeded()
+{
+   if ( m_compacting )
+      return;
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      if ( m_sizeFile <= 2*m_sizeCompacted + DRAFT_COMPACT_MIN )
+         return;
+   }
+
+   // the previous thread must have already finished if m_compacting is 0
+   WaitForCompactor();
+
+   m_compacting = 1;
+   m_compactor = new Compactor(this);
+   if ( m_compactor->Run() != wxTHREAD_NO_ERROR )
+   {
+      delete m_compactor;
+      m_compactor = NULL;
+      m_compacting = 0;
+
+      // do it synchronously then
+      wxMutexLocker lock(m_mutex);
+      Rewrite();
+      RemoveUnusedBlobs();
+   }
+}
+
+void DraftJournal::WaitForCompactor()
+{
+   if ( m_compactor )
+   {
+      m_compactor->Wait();
+
+      delete m_compactor;
+      m_compactor = NULL;
+   }
+}
+
+void DraftJournal::DoCompact()
+{
+   // take a snapshot of the current contents
+   DraftContents contents;
+   wxFileOffset sizeOld;
+   unsigned long generation;
+   {
+      wxMutexLocker lock(m_mutex);
+
+      contents = m_saved;
+      sizeOld = m_sizeFile;
+      generation = m_generation;
+   }
+
+   // and write it to a new file without blocking Update()
+   std::vector<char> buf;
+   WriteJournalHeader(buf);
+   WriteContents(buf, contents);
+
+   const String filenameNew = m_filename + DRAFT_JOURNAL_COMPACT;
+
+   wxLogNull noLog;
+
+   wxFile file;
+   bool ok = file.Create(filenameNew, true, wxS_IRUSR | wxS_IWUSR) &&
+               file.Write(&buf[0], buf.size()) == buf.size();
+
+   wxFileOffset sizeNew = buf.size();
+
+   if ( ok )
+   {
+      wxMutexLocker lock(m_mutex);
+
+      if ( m_generation != generation || !m_sizeFile )
+      {
+         // the journal was rewritten in the meanwhile
+         ok = false;
+      }
+      else if ( m_sizeFile > sizeOld )
+      {
+         // copy the changes appended to the old file since we took the
+         // snapshot: they apply to the compacted contents in the same way
+         const size_t sizeTail = m_sizeFile - sizeOld;
+         wxMemoryBuffer tail(sizeTail);
+
+         wxFile fileOld(m_filename);
+         ok = fileOld.IsOpened() &&
+               fileOld.Seek(sizeOld) == sizeOld &&
+                fileOld.Read(tail.GetData(), sizeTail) == (ssize_t)sizeTail &&
+                 file.Write(tail.GetData(), sizeTail) == sizeTail;
+
+         sizeNew += sizeTail;
+      }
+
+      if ( ok )
+      {
+         ok = file.Close() && wxRenameFile(filenameNew, m_filename);
+      }
+
+      if ( ok )
+      {
+         wxLogTrace(M_TRACE_DRAFTS, _T("Compacted \"%s\" from %lu to %lu bytes"),
+                    m_filename,
+                    (unsigned long)m_sizeFile, (unsigned long)sizeNew);
+
+         m_sizeFile = sizeNew;
+         m_sizeCompacted = buf.size();
+
+         RemoveUnusedBlobs();
+      }
+   }
+
+   if ( !ok )
+   {
+      if ( file.IsOpened() )
+         file.Close();
+
+      wxRemoveFile(filenameNew);
+   }
+
+   m_compacting = 0;
+}
+
+void DraftJournal::RemoveUnusedBlobs()
+{
+   std::set<String> used(m_blobsPending);
+   for ( std::vector<DraftContents::Part>::const_iterator i = m_saved.parts.begin();
+         i != m_saved.parts.end();
+         ++i )
+   {
+      if ( i->type != DraftContents::Part::Text )
+         used.insert(i->hash);
+   }
+
+   for ( std::set<String>::iterator i = m_blobs.begin(); i != m_blobs.end(); )
+   {
+      if ( used.count(*i) )
+      {
+         ++i;
+         continue;
+      }
+
+      const String hash = *i;
+      m_blobs.erase(i++);
+
+      wxRemoveFile(GetBlobFileName(m_dirBlobs, hash));
+
+      wxLogTrace(M_TRACE_DRAFTS, _T("Removed unused %s"), hash);
+
+      // forget about it, so that it is stored again if it's reattached
+      for ( std::map<String, FileInfo>::iterator j = m_hashesFiles.begin();
+            j != m_hashesFiles.end(); )
+      {
+         if ( j->second.hash == hash )
+            m_hashesFiles.erase(j++);
+         else
+            ++j;
+      }
+   }
+}
+
+// ----------------------------------------------------------------------------
+// removing the journal
+// ----------------------------------------------------------------------------
+
+void DraftJournal::Remove()
+{
+   WaitForCompactor();
+
+   Remove(m_filename);
+
+   m_sizeFile =
+   m_sizeCompacted = 0;
+
+   m_saved = DraftContents();
+   m_hashesFiles.clear();
+   m_blobs.clear();
+   m_blobsPending.clear();
+}
+
+/* static */
+void DraftJournal::Remove(const String& filename)
+{
+   wxLogNull noLog;
+
+   if ( wxFileExists(filename) && !wxRemoveFile(filename) )
+   {
+      wxLogTrace(M_TRACE_DRAFTS, _T("Failed to remove \"%s\""), filename);
+   }
+
+   const String filenameNew = filename + DRAFT_JOURNAL_NEW;
+   if ( wxFileExists(filenameNew) )
+      wxRemoveFile(filenameNew);
+
+   const String filenameCompact = filename + DRAFT_JOURNAL_COMPACT;
+   if ( wxFileExists(filenameCompact) )
+      wxRemoveFile(filenameCompact);
+
+   const String dirBlobs = GetBlobsDir(filename);
+   if ( wxDirExists(dirBlobs) )
+   {
+      wxArrayString files;
+      wxDir::GetAllFiles(dirBlobs, &files, wxEmptyString, wxDIR_FILES);
+
+      const size_t count = files.size();
+      for ( size_t n = 0; n < count; n++ )
+         wxRemoveFile(files[n]);
+
+      wxRmdir(dirBlobs);
+   }
+}
+
+// ----------------------------------------------------------------------------
+// crash recovery
+// ----------------------------------------------------------------------------
+
+/* static */
+const wxChar *DraftJournal::GetExtension()
+{
+   return DRAFT_JOURNAL_EXT;
+}
+
+/* static */
+bool DraftJournal::Load(const String& filename, DraftContents& contents)
+{
+   // the journal is compacted when it becomes too big, so just read it into
+   // memory entirely
+   wxMemoryBuffer buf;
+   if ( !ReadFile(filename, buf) )
+      return false;
+
+   const char *p = (const char *)buf.GetData();
+   const char * const end = p + buf.GetDataLen();
+
+   DraftJournalHeader hdr;
+   if ( end - p < (ptrdiff_t)sizeof(hdr) )
+      return false;
+
+   memcpy(&hdr, p, sizeof(hdr));
+   if ( hdr.magic != DRAFT_JOURNAL_MAGIC || hdr.version > DRAFT_JOURNAL_VERSION )
+   {
+      wxLogDebug(_T("Unsupported draft journal \"%s\""), filename);
+
+      return false;
+   }
+
+   p += sizeof(hdr);
+
+   contents = DraftContents();
+
+   size_t count = 0;
+   while ( p != end )
+   {
+      DraftRecord rec;
+      if ( end - p < (ptrdiff_t)sizeof(rec) )
+         break;
+
+      memcpy(&rec, p, sizeof(rec));
+      if ( rec.len < sizeof(rec) || (size_t)(end - p) < rec.len )
+         break;
+
+      // verify the checksum to detect the records which were only partially
+      // written
+      std::vector<char> data(p, p + rec.len);
+      const wxUint32 checksum = rec.checksum;
+      rec.checksum = 0;
+      memcpy(&data[0], &rec, sizeof(rec));
+
+      DraftHash hash;
+      hash.Update(&data[0], rec.len);
+      if ( hash.GetChecksum() != checksum )
+         break;
+
+      RecordReader reader(p + sizeof(rec), rec.len - sizeof(rec));
+      if ( !ApplyRecord(rec, reader, contents) )
+         break;
+
+      p += rec.len;
+      count++;
+   }
+
+   if ( p != end )
+   {
+      // this can happen if we crashed while appending to the file, just
+      // ignore the incomplete record
+      wxLogDebug(_T("Ignoring corrupted record in draft journal \"%s\"."),
+                 filename);
+   }
+
+   wxLogTrace(M_TRACE_DRAFTS, _T("Loaded %lu records from \"%s\""),
+              (unsigned long)count, filename);
+
+   return true;
+}
+
+/* static */
+bool DraftJournal::ReadData(const String& filename,
+                            const String& hash,
+                            wxMemoryBuffer& data)
+{
+   if ( hash.empty() )
+      return false;
+
+   return ReadFile(GetBlobFileName(GetBlobsDir(filename), hash), data);
+}
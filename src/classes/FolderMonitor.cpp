@@ -42,6 +42,9 @@
 
 #include "gui/wxMDialogs.h"      // MDialog_YesNoDialog
 
+#include <algorithm>
+#include <vector>
+
 class MOption;
 
 // ----------------------------------------------------------------------------
@@ -49,6 +52,8 @@ class MOption;
 // ----------------------------------------------------------------------------
 
 extern const MOption MP_COLLECTATSTARTUP;
+extern const MOption MP_POLL_CONCURRENTLY;
+extern const MOption MP_POLL_IDLE_MAX;
 extern const MOption MP_POLL_OPENED_ONLY;
 extern const MOption MP_POLLINCOMINGDELAY;
 
@@ -65,6 +70,16 @@ extern const MPersMsgBox *M_MSGBOX_SUSPENDAUTOCOLLECT;
 // the number of times we try to open an unaccessible folder before giving up
 static const int MC_MAX_FAIL = 5;
 
+// how often do we look at the notifications for the watched folders (in
+// seconds): this is cheap as it doesn't involve any network round trips
+static const long POLL_IDLE_INTERVAL = 10;
+
+// how long do we wait before trying to watch a folder again after failing to
+// do it for the first time and the maximal delay between the attempts (in
+// seconds), the delay is doubled after each failure
+static const long WATCH_RETRY_DELAY_MIN = 60;
+static const long WATCH_RETRY_DELAY_MAX = 3600;
+
 // trace mask
 #define TRACE_MONITOR _T("monitor")
 
@@ -124,6 +139,9 @@ public:
       m_failcount = 0;
       m_state = Folder_Ok;
       m_timeNext = time(NULL);
+      m_countChanges = 0;
+      m_timeWatchRetry = 0;
+      m_delayWatchRetry = 0;
    }
 
    ~FolderMonitorFolderEntry()
@@ -163,6 +181,34 @@ public:
 
    time_t GetCheckTime() const { return m_timeNext; }
 
+   // activity: the number of times the folder status changed
+   void OnStatusChange() { m_countChanges++; }
+   unsigned long GetActivity() const { return m_countChanges; }
+   void SetActivity(unsigned long count) { m_countChanges = count; }
+
+   // can we try watching this folder using IMAP IDLE now?
+   bool CanWatch() const { return time(NULL) >= m_timeWatchRetry; }
+
+   // watching the folder failed, possibly because of a transient network
+   // problem, so try again later, but less and less often
+   void OnWatchFailed()
+   {
+      m_delayWatchRetry = m_delayWatchRetry
+                           ? wxMin(2*m_delayWatchRetry, WATCH_RETRY_DELAY_MAX)
+                           : WATCH_RETRY_DELAY_MIN;
+      m_timeWatchRetry = time(NULL) + (time_t)m_delayWatchRetry;
+   }
+
+   // return the current delay before the next attempt to watch the folder
+   long GetWatchRetryDelay() const { return m_delayWatchRetry; }
+
+   // watching the folder succeeded, forget about the previous failures
+   void OnWatchStarted()
+   {
+      m_timeWatchRetry = 0;
+      m_delayWatchRetry = 0;
+   }
+
 private:
    // the folder we monitor
    MFolder *m_folder;
@@ -179,6 +225,16 @@ private:
      and no more warnings are printed.
     */
    int m_failcount;
+
+   // the number of status changes since we started monitoring the folder
+   unsigned long m_countChanges;
+
+   // the time before which we shouldn't try to watch this folder, 0 if we
+   // can do it at any moment
+   time_t m_timeWatchRetry;
+
+   // the current delay between the attempts to watch it, 0 if we didn't fail
+   long m_delayWatchRetry;
 };
 
 // declare a list (owning the objects in it) of FolderMonitorFolderEntries
@@ -249,6 +305,18 @@ protected:
    bool CheckOneFolder(FolderMonitorFolderEntry *i,
                        MProgressInfo *progInfo);
 
+   /// check for new mail in all folders which need it at once
+   bool CheckFoldersConcurrently(int flags, MProgressInfo *progInfo);
+
+   /// return false if the folder shouldn't be checked now
+   bool ShouldCheckFolder(FolderMonitorFolderEntry *i);
+
+   /// called when checking the folder failed
+   void OnCheckFailed(FolderMonitorFolderEntry *i);
+
+   /// choose the most active folders and watch them using IMAP IDLE
+   void UpdateWatchedFolders();
+
    /// return true if we already have this folder in the incoming list
    bool IsBeingMonitored(const MFolder *folder) const;
 
@@ -264,7 +332,8 @@ private:
 
    /// the event manager cookies
    void *m_regFolderDelete,
-        *m_regOptionsChange;
+        *m_regOptionsChange,
+        *m_regFolderStatus;
 
    /// the mutex locked while we're checking for new mail
    MMutex m_inNewMailCheck;
@@ -304,6 +373,7 @@ FolderMonitorImpl::FolderMonitorImpl()
 {
    m_regFolderDelete = MEventManager::Register(*this, MEventId_FolderTreeChange);
    m_regOptionsChange = MEventManager::Register(*this, MEventId_OptionsChange);
+   m_regFolderStatus = MEventManager::Register(*this, MEventId_FolderStatus);
 
    BuildList();
 
@@ -328,7 +398,17 @@ FolderMonitorImpl::FolderMonitorImpl()
 
 FolderMonitorImpl::~FolderMonitorImpl(void)
 {
-   MEventManager::DeregisterAll(&m_regFolderDelete, &m_regOptionsChange, NULL);
+   MEventManager::DeregisterAll(&m_regFolderDelete,
+                                &m_regOptionsChange,
+                                &m_regFolderStatus,
+                                NULL);
+
+   for ( FolderMonitorFolderList::iterator i = m_list.begin();
+         i != m_list.end();
+         ++i )
+   {
+      MailFolder::UnwatchFolder(i->GetFolder());
+   }
 }
 
 // ----------------------------------------------------------------------------
@@ -338,6 +418,16 @@ FolderMonitorImpl::~FolderMonitorImpl(void)
 void
 FolderMonitorImpl::BuildList(void)
 {
+   // remember the activity of the folders we already monitor as it is used
+   // to choose the folders to watch
+   std::vector< std::pair<String, unsigned long> > activity;
+   FolderMonitorFolderList::iterator i;
+   for ( i = m_list.begin(); i != m_list.end(); ++i )
+   {
+      if ( i->GetActivity() )
+         activity.push_back(std::make_pair(i->GetName(), i->GetActivity()));
+   }
+
    m_list.clear();
 
    FolderMonitorTraversal t(m_list);
@@ -345,6 +435,18 @@ FolderMonitorImpl::BuildList(void)
    {
       wxLogWarning(_("Cannot build list of incoming mail folders."));
    }
+
+   for ( size_t n = 0; n < activity.size(); n++ )
+   {
+      for ( i = m_list.begin(); i != m_list.end(); ++i )
+      {
+         if ( i->GetName() == activity[n].first )
+         {
+            i->SetActivity(activity[n].second);
+            break;
+         }
+      }
+   }
 }
 
 bool
@@ -375,6 +477,15 @@ FolderMonitorImpl::GetMinCheckTimeout(void) const
          min_delay = delay;
    }
 
+   // the watched folders must be polled more often but this is only
+   // relevant if we poll at all
+   if ( min_delay > POLL_IDLE_INTERVAL &&
+         READ_APPCONFIG_BOOL(MP_POLL_CONCURRENTLY) &&
+         READ_APPCONFIG(MP_POLL_IDLE_MAX) > 0 )
+   {
+      min_delay = POLL_IDLE_INTERVAL;
+   }
+
    return min_delay;
 }
 
@@ -427,6 +538,8 @@ FolderMonitorImpl::RemoveFolder(const String& name)
    {
       if ( i->GetFolder()->GetFullName() == name )
       {
+         MailFolder::UnwatchFolder(i->GetFolder());
+
          m_list.erase(i);
 
          return true;
@@ -476,6 +589,19 @@ FolderMonitorImpl::CheckNewMail(int flags)
    }
 
    // check all incoming folders
+   if ( READ_APPCONFIG_BOOL(MP_POLL_CONCURRENTLY) )
+   {
+      if ( !CheckFoldersConcurrently(flags, progInfo) )
+         rc = false;
+
+      delete progInfo;
+
+      return rc;
+   }
+
+   // stop watching the folders if we did it before the option was changed
+   UpdateWatchedFolders();
+
    time_t timeCur = time(NULL);
    FolderMonitorFolderList::iterator i;
    for ( i = m_list.begin(); i != m_list.end(); ++i )
@@ -500,8 +626,154 @@ FolderMonitorImpl::CheckNewMail(int flags)
 }
 
 bool
-FolderMonitorImpl::CheckOneFolder(FolderMonitorFolderEntry *i,
-                                  MProgressInfo *progInfo)
+FolderMonitorImpl::CheckFoldersConcurrently(int flags, MProgressInfo *progInfo)
+{
+   // first process the notifications for the folders we watch: this doesn't
+   // take any time unless something really changed
+   MailFolder::PollWatchedFolders();
+
+   UpdateWatchedFolders();
+
+   // find all the folders which should be checked now
+   std::vector<FolderMonitorFolderEntry *> entries;
+   std::vector<const MFolder *> folders;
+
+   const time_t timeCur = time(NULL);
+   FolderMonitorFolderList::iterator i;
+   for ( i = m_list.begin(); i != m_list.end(); ++i )
+   {
+      // the watched folders don't need to be checked unless the user really
+      // wants it
+      if ( !(flags & Interactive) )
+      {
+         if ( i->GetCheckTime() > timeCur ||
+               MailFolder::IsFolderWatched(i->GetFolder()) )
+            continue;
+      }
+
+      if ( !ShouldCheckFolder(*i) )
+         continue;
+
+      entries.push_back(*i);
+      folders.push_back(i->GetFolder());
+   }
+
+   const size_t count = folders.size();
+   if ( !count )
+      return true;
+
+   wxLogTrace(TRACE_MONITOR, _T("Checking for new mail in %lu folders."),
+              (unsigned long)count);
+
+   if ( progInfo )
+   {
+      progInfo->SetLabel(String::Format(_("Checking %lu folders..."),
+                                        (unsigned long)count));
+   }
+
+   bool *results = new bool[count];
+   MailFolder::CheckFolders(&folders[0], count, results,
+                            progInfo ? progInfo->GetFrame() : NULL);
+
+   bool rc = true;
+   for ( size_t n = 0; n < count; n++ )
+   {
+      if ( !results[n] )
+      {
+         OnCheckFailed(entries[n]);
+
+         rc = false;
+      }
+
+      // as in CheckNewMail(), only do it after checking the folder
+      entries[n]->UpdateCheckTime();
+   }
+
+   delete [] results;
+
+   MEventManager::ForceDispatchPending();
+
+   return rc;
+}
+
+void
+FolderMonitorImpl::UpdateWatchedFolders()
+{
+   size_t countMax = READ_APPCONFIG_BOOL(MP_POLL_CONCURRENTLY)
+                        ? (size_t)READ_APPCONFIG(MP_POLL_IDLE_MAX)
+                        : 0;
+
+   // the candidates are the folders in which something has already happened
+   std::vector<FolderMonitorFolderEntry *> candidates;
+   FolderMonitorFolderList::iterator i;
+   for ( i = m_list.begin(); i != m_list.end(); ++i )
+   {
+      if ( i->GetState() != Folder_Ok || !i->CanWatch() || !i->GetActivity() )
+         continue;
+
+      const MFolder *folder = i->GetFolder();
+      if ( folder->GetType() != MF_IMAP )
+         continue;
+
+      // there is no need to watch the opened folders, they're already
+      // updated by the server
+      MailFolder *mf = MailFolder::GetOpenedFolderFor(folder);
+      if ( mf )
+      {
+         mf->DecRef();
+         continue;
+      }
+
+      Profile_obj profile(folder->GetProfile());
+      if ( READ_CONFIG_BOOL(profile, MP_POLL_OPENED_ONLY) )
+         continue;
+
+      candidates.push_back(*i);
+   }
+
+   // the most active ones come first
+   std::stable_sort(candidates.begin(), candidates.end(),
+                    [](const FolderMonitorFolderEntry *e1,
+                       const FolderMonitorFolderEntry *e2)
+                    {
+                      return e1->GetActivity() > e2->GetActivity();
+                    });
+
+   if ( candidates.size() > countMax )
+      candidates.resize(countMax);
+
+   for ( i = m_list.begin(); i != m_list.end(); ++i )
+   {
+      const MFolder *folder = i->GetFolder();
+      if ( std::find(candidates.begin(), candidates.end(), *i)
+               == candidates.end() )
+      {
+         MailFolder::UnwatchFolder(folder);
+      }
+      else if ( !MailFolder::IsFolderWatched(folder) )
+      {
+         if ( MailFolder::WatchFolder(folder) )
+         {
+            wxLogTrace(TRACE_MONITOR, _T("Watching folder %s using IDLE."),
+                       folder->GetFullName());
+
+            i->OnWatchStarted();
+         }
+         else
+         {
+            // the folder is still polled as usual meanwhile
+            i->OnWatchFailed();
+
+            wxLogTrace(TRACE_MONITOR, _T("Failed to watch folder %s, will "
+                                         "retry in %lds."),
+                       folder->GetFullName(), i->GetWatchRetryDelay());
+         }
+      }
+   }
+}
+
+bool
+FolderMonitorImpl::ShouldCheckFolder(FolderMonitorFolderEntry *i)
 {
    const MFolder *folder = i->GetFolder();
 
@@ -522,7 +794,7 @@ FolderMonitorImpl::CheckOneFolder(FolderMonitorFolderEntry *i,
 
       case Folder_Unaccessible:
          // don't even try any more
-         return true;
+         return false;
 
       default:
          FAIL_MSG( _T("unknown folder state") );
@@ -543,7 +815,7 @@ FolderMonitorImpl::CheckOneFolder(FolderMonitorFolderEntry *i,
       {
          wxLogTrace(TRACE_MONITOR, _T("Skipping not opened folder %s"),
                     folder->GetFullName());
-         return true;
+         return false;
       }
 
       mf->DecRef();
@@ -563,6 +835,47 @@ FolderMonitorImpl::CheckOneFolder(FolderMonitorFolderEntry *i,
    }
 #endif // USE_DIALUP
 
+   return true;
+}
+
+void
+FolderMonitorImpl::OnCheckFailed(FolderMonitorFolderEntry *i)
+{
+   if ( !i->IncreaseFailCount() )
+   {
+      wxString msg;
+      msg.Printf(_("Checking for new mail in the folder '%s' failed.\n"
+                   "Do you want to stop checking it during this session?"),
+                 i->GetName());
+
+      if ( MDialog_YesNoDialog
+           (
+            msg,
+            NULL,
+            _("Check for new mail failed"),
+            M_DLG_YES_DEFAULT,
+            M_MSGBOX_SUSPENDAUTOCOLLECT
+           ) )
+      {
+         i->SetState(Folder_Unaccessible);
+      }
+      else
+      {
+         // reset failure count for new tries
+         i->ResetFailCount();
+      }
+   }
+}
+
+bool
+FolderMonitorImpl::CheckOneFolder(FolderMonitorFolderEntry *i,
+                                  MProgressInfo *progInfo)
+{
+   if ( !ShouldCheckFolder(i) )
+      return true;
+
+   const MFolder *folder = i->GetFolder();
+
    wxLogTrace(TRACE_MONITOR, _T("Checking for new mail in '%s'."),
               i->GetName());
 
@@ -577,30 +890,7 @@ FolderMonitorImpl::CheckOneFolder(FolderMonitorFolderEntry *i,
    if ( !MailFolder::CheckFolder(folder,
                                  progInfo ? progInfo->GetFrame() : NULL) )
    {
-      if ( !i->IncreaseFailCount() )
-      {
-         wxString msg;
-         msg.Printf(_("Checking for new mail in the folder '%s' failed.\n"
-                      "Do you want to stop checking it during this session?"),
-                    i->GetName());
-
-         if ( MDialog_YesNoDialog
-              (
-               msg,
-               NULL,
-               _("Check for new mail failed"),
-               M_DLG_YES_DEFAULT,
-               M_MSGBOX_SUSPENDAUTOCOLLECT
-              ) )
-         {
-            i->SetState(Folder_Unaccessible);
-         }
-         else
-         {
-            // reset failure count for new tries
-            i->ResetFailCount();
-         }
-      }
+      OnCheckFailed(i);
 
       return false;
    }
@@ -633,6 +923,20 @@ FolderMonitorImpl::OnMEvent(MEventData& event)
       // rebuild it, in fact
       BuildList();
    }
+   else if ( event.GetId() == MEventId_FolderStatus )
+   {
+      const String& name = ((MEventFolderStatusData &)event).GetFolderName();
+      for ( FolderMonitorFolderList::iterator i = m_list.begin();
+            i != m_list.end();
+            ++i )
+      {
+         if ( i->GetName() == name )
+         {
+            i->OnStatusChange();
+            break;
+         }
+      }
+   }
 
    // continue propagating the event
    return true;
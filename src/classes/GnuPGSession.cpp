@@ -0,0 +1,822 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   classes/GnuPGSession.cpp - GnuPGSession implementation
+// Purpose:     batch verification of detached signatures by gpg
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+#  include "Mcommon.h"
+#endif // USE_PCH
+
+#include "GnuPGSession.h"
+
+#include "mail/MimeCodec.h"
+
+#include <wx/cmdline.h>             // for ConvertStringToArgs()
+
+#include <stdio.h>                  // for snprintf()
+
+#ifdef OS_UNIX
+   #include <sys/types.h>
+   #include <sys/select.h>          // for FD_SETSIZE
+   #include <sys/socket.h>
+   #include <sys/wait.h>
+   #include <errno.h>
+   #include <fcntl.h>
+   #include <poll.h>
+   #include <signal.h>
+   #include <unistd.h>
+#endif // OS_UNIX
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// trace mask for the gpg sessions
+#define TRACE_GPG "gpg"
+
+// the prefix of the gpg status lines
+static const char GPG_STATUS_PREFIX[] = "[GNUPG:] ";
+
+// OpenPGP packet tags we use
+static const unsigned PGP_TAG_SIGNATURE = 2;
+static const unsigned PGP_TAG_LITERAL = 11;
+
+// the signature type of the signatures of the canonical text documents
+static const unsigned PGP_SIG_CLASS_TEXT = 0x01;
+
+// the size of the chunks in which we write the data to gpg
+static const size_t GPG_WRITE_CHUNK = 65536;
+
+// ----------------------------------------------------------------------------
+// OpenPGP helpers
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// decode ASCII-armored data, return an empty string if it's invalid
+std::string Dearmor(const std::string& armor)
+{
+   // skip the "-----BEGIN PGP SIGNATURE-----" line and the armor headers
+   // following it until the first empty line
+   size_t pos = armor.find("-----BEGIN PGP ");
+   if ( pos == std::string::npos )
+      return std::string();
+
+   bool empty = false;
+   while ( !empty )
+   {
+      pos = armor.find('\n', pos);
+      if ( pos == std::string::npos )
+         return std::string();
+
+      pos++;
+      empty = armor[pos] == '\n' ||
+               (armor[pos] == '\r' && pos + 1 < armor.length() &&
+                  armor[pos + 1] == '\n');
+   }
+
+   // the Base64 data continues until the checksum line starting with "=" or
+   // the end line
+   std::string base64;
+   while ( pos < armor.length() && armor[pos] != '=' && armor[pos] != '-' )
+   {
+      size_t eol = armor.find('\n', pos);
+      if ( eol == std::string::npos )
+         eol = armor.length();
+
+      base64.append(armor, pos, eol - pos);
+      pos = eol + 1;
+   }
+
+   std::string data(MIME::GetBase64DecodedMaxLen(base64.length()), '\0');
+   size_t len;
+   if ( !MIME::DecodeBase64(base64.data(), base64.length(), &data[0], &len) )
+      return std::string();
+
+   data.resize(len);
+
+   return data;
+}
+
+// return the class of the signature packet in the given data or -1 if the
+// data doesn't consist of exactly one signature packet
+//
+// notice that we must reject anything following the signature as we append
+// our own literal data packet to it and any other packets would be verified
+// by gpg together with it
+int GetSignatureClass(const std::string& packets)
+{
+   const unsigned char *p = (const unsigned char *)packets.data();
+   const size_t len = packets.length();
+   if ( len < 2 || !(p[0] & 0x80) )
+      return -1;
+
+   unsigned tag;
+   size_t lenHeader,
+          lenBody;
+   if ( p[0] & 0x40 )
+   {
+      // new format packet
+      tag = p[0] & 0x3f;
+      if ( p[1] < 192 )
+      {
+         lenHeader = 2;
+         lenBody = p[1];
+      }
+      else if ( p[1] < 224 )
+      {
+         lenHeader = 3;
+         if ( len < lenHeader )
+            return -1;
+
+         lenBody = ((p[1] - 192) << 8) + p[2] + 192;
+      }
+      else if ( p[1] == 255 )
+      {
+         lenHeader = 6;
+         if ( len < lenHeader )
+            return -1;
+
+         lenBody = ((size_t)p[2] << 24) | (p[3] << 16) | (p[4] << 8) | p[5];
+      }
+      else // partial body length, not used for signatures
+      {
+         return -1;
+      }
+   }
+   else // old format packet
+   {
+      tag = (p[0] >> 2) & 0x0f;
+
+      switch ( p[0] & 3 )
+      {
+         case 0:
+            lenHeader = 2;
+            lenBody = p[1];
+            break;
+
+         case 1:
+            lenHeader = 3;
+            if ( len < lenHeader )
+               return -1;
+
+            lenBody = (p[1] << 8) | p[2];
+            break;
+
+         case 2:
+            lenHeader = 5;
+            if ( len < lenHeader )
+               return -1;
+
+            lenBody = ((size_t)p[1] << 24) | (p[2] << 16) | (p[3] << 8) | p[4];
+            break;
+
+         default:
+            // indeterminate length: the packet extends until the end of data
+            lenHeader = 1;
+            lenBody = len - lenHeader;
+      }
+   }
+
+   if ( tag != PGP_TAG_SIGNATURE || lenBody < 3 || lenBody != len - lenHeader )
+      return -1;
+
+   // the signature type comes right after the version in the current
+   // signature packets but v3 ones have the length of the hashed material
+   // (always 5) before it
+   const unsigned char * const body = p + lenHeader;
+
+   return body[0] == 3 ? body[2] : body[1];
+}
+
+// convert all line endings to CRLF
+std::string Canonicalize(const std::string& text)
+{
+   std::string canonical;
+   canonical.reserve(text.length() + text.length() / 32);
+
+   const size_t len = text.length();
+   for ( size_t n = 0; n < len; n++ )
+   {
+      const char ch = text[n];
+      if ( ch == '\r' )
+      {
+         canonical += "\r\n";
+         if ( n + 1 < len && text[n + 1] == '\n' )
+            n++;
+      }
+      else if ( ch == '\n' )
+      {
+         canonical += "\r\n";
+      }
+      else
+      {
+         canonical += ch;
+      }
+   }
+
+   return canonical;
+}
+
+// append the header of the new format packet with the given tag and length
+void AppendPacketHeader(std::string& packet, unsigned tag, size_t len)
+{
+   packet += (char)(0xc0 | tag);
+
+   // always use the five octet length, the 2 bytes overhead don't matter
+   packet += (char)0xff;
+   packet += (char)((len >> 24) & 0xff);
+   packet += (char)((len >> 16) & 0xff);
+   packet += (char)((len >> 8) & 0xff);
+   packet += (char)(len & 0xff);
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// GnuPGSession implementation
+// ============================================================================
+
+GnuPGSession::GnuPGSession(const String& command)
+            : m_command(command)
+{
+   m_msTimeout = 30000;
+   m_processCount = 0;
+}
+
+/* static */
+bool GnuPGSession::IsSupported()
+{
+#ifdef OS_UNIX
+   return true;
+#else // !OS_UNIX
+   return false;
+#endif // OS_UNIX/!OS_UNIX
+}
+
+/* static */
+std::string
+GnuPGSession::MakeSignedMessage(const DetachedSignature& sig)
+{
+   std::string message;
+   if ( sig.signature.find("-----BEGIN PGP ") != std::string::npos )
+   {
+      message = Dearmor(sig.signature);
+   }
+   else // binary signature
+   {
+      message = sig.signature;
+   }
+
+   const int sigClass = GetSignatureClass(message);
+   if ( sigClass == -1 )
+      return std::string();
+
+   // gpg canonicalizes the text itself when checking the detached text
+   // signatures but doesn't do it for the literal data packets, so we need
+   // to do it ourselves
+   std::string canonical;
+   if ( sigClass == PGP_SIG_CLASS_TEXT )
+      canonical = Canonicalize(sig.data);
+
+   const std::string& data = sigClass == PGP_SIG_CLASS_TEXT ? canonical
+                                                            : sig.data;
+
+   // the literal data packet body consists of the format ('b'inary), the
+   // empty file name, the zero date and the data itself
+   static const char literalHeader[] = { 'b', 0, 0, 0, 0, 0 };
+
+   AppendPacketHeader(message, PGP_TAG_LITERAL,
+                      sizeof(literalHeader) + data.length());
+   message.append(literalHeader, sizeof(literalHeader));
+   message += data;
+
+   return message;
+}
+
+bool GnuPGSession::VerifyDetached(DetachedSignatures& sigs)
+{
+   std::vector<DetachedSignature *> todo;
+   std::vector<std::string> messages;
+   todo.reserve(sigs.size());
+   messages.reserve(sigs.size());
+
+   for ( DetachedSignatures::iterator i = sigs.begin(); i != sigs.end(); ++i )
+   {
+      i->status.clear();
+      i->messages.clear();
+      i->processed = false;
+
+      std::string message = MakeSignedMessage(*i);
+      if ( message.empty() )
+      {
+         // this is what gpg would have told us for a corrupted signature
+         i->status.push_back("NODATA 3");
+         i->processed = true;
+         continue;
+      }
+
+      todo.push_back(&*i);
+      messages.push_back(message);
+   }
+
+   size_t n = 0;
+   while ( n < todo.size() )
+   {
+      size_t count = todo.size() - n;
+      if ( count > GetMaxBatchSize() )
+         count = GetMaxBatchSize();
+
+      bool timedOut = false;
+      const int done = RunBatch(&todo[n], &messages[n], count, &timedOut);
+      if ( done == -1 )
+         return false;
+
+      if ( timedOut )
+         break;
+
+      if ( done == 0 )
+      {
+         // gpg exited without even starting to check the first signature,
+         // don't try it again as it would probably fail in the same way
+         todo[n]->processed = true;
+         n++;
+      }
+      else
+      {
+         n += done;
+      }
+   }
+
+   return true;
+}
+
+#ifdef OS_UNIX
+
+namespace
+{
+
+// an input channel of the gpg process
+struct GPGInput
+{
+   // the file descriptor of our end of the socket or -1 if closed
+   int fd;
+
+   // the descriptor of the other end inherited by the child process
+   int fdChild;
+
+   // the data to write and the amount already written
+   const std::string *data;
+   size_t pos;
+};
+
+// create a socket pair to be used for the child process input
+bool CreateChannel(int *fdParent, int *fdChild)
+{
+   int fds[2];
+   if ( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 )
+      return false;
+
+   // we use sockets and not pipes to be able to avoid SIGPIPE when writing to
+   // gpg after it exits
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+   int on = 1;
+   setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+   fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+   fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+   *fdParent = fds[0];
+   *fdChild = fds[1];
+
+   return true;
+}
+
+void CloseFd(int& fd)
+{
+   if ( fd != -1 )
+   {
+      close(fd);
+      fd = -1;
+   }
+}
+
+} // anonymous namespace
+
+int
+GnuPGSession::RunBatch(DetachedSignature **sigs,
+                       const std::string *messages,
+                       size_t count,
+                       bool *timedOut)
+{
+   *timedOut = false;
+
+   // prepare everything we need in the child process before forking
+   wxArrayString args = wxCmdLineParser::ConvertStringToArgs
+                        (
+                           m_command,
+                           wxCMD_LINE_SPLIT_UNIX
+                        );
+   if ( args.empty() )
+      return -1;
+
+   args.push_back("--batch");
+   args.push_back("--no-tty");
+   args.push_back("--status-fd=2");
+   args.push_back("--enable-special-filenames");
+   args.push_back("--verify");
+   args.push_back("--multifile");
+
+   std::vector<wxCharBuffer> argsBufs;
+   for ( size_t n = 0; n < args.size(); n++ )
+      argsBufs.push_back(args[n].fn_str());
+
+   std::vector<char *> argv;
+   for ( size_t n = 0; n < argsBufs.size(); n++ )
+      argv.push_back(argsBufs[n].data());
+   argv.push_back(NULL);
+
+   // the first input is the standard input to which we write the list of the
+   // file names and the other ones are used for the signed messages
+   std::vector<GPGInput> inputs(count + 1);
+   std::string names;
+   bool ok = true;
+   for ( size_t n = 0; n <= count; n++ )
+   {
+      GPGInput& input = inputs[n];
+      if ( !CreateChannel(&input.fd, &input.fdChild) )
+      {
+         while ( n-- )
+         {
+            CloseFd(inputs[n].fd);
+            CloseFd(inputs[n].fdChild);
+         }
+
+         ok = false;
+         break;
+      }
+
+      input.pos = 0;
+      if ( n )
+      {
+         input.data = &messages[n - 1];
+
+         char name[32];
+         snprintf(name, sizeof(name), "-&%d\n", input.fdChild);
+         names += name;
+      }
+   }
+
+   inputs[0].data = &names;
+
+   int fdStatus[2] = { -1, -1 },
+       fdExec[2] = { -1, -1 };
+   if ( !ok || pipe(fdStatus) != 0 || pipe(fdExec) != 0 )
+   {
+      wxLogSysError(_("Failed to create pipes for communicating with GnuPG"));
+
+      CloseFd(fdStatus[0]);
+      CloseFd(fdStatus[1]);
+      for ( size_t n = 0; ok && n <= count; n++ )
+      {
+         CloseFd(inputs[n].fd);
+         CloseFd(inputs[n].fdChild);
+      }
+
+      return -1;
+   }
+
+   fcntl(fdStatus[0], F_SETFD, FD_CLOEXEC);
+   fcntl(fdExec[0], F_SETFD, FD_CLOEXEC);
+   fcntl(fdExec[1], F_SETFD, FD_CLOEXEC);
+
+   const pid_t pid = fork();
+   if ( pid == 0 )
+   {
+      // child: only async-signal-safe functions may be used here
+      dup2(inputs[0].fdChild, STDIN_FILENO);
+      dup2(fdStatus[1], STDERR_FILENO);
+
+      const int fdNull = open("/dev/null", O_WRONLY);
+      if ( fdNull != -1 )
+         dup2(fdNull, STDOUT_FILENO);
+
+      // don't let gpg inherit any descriptors except for its inputs, just as
+      // wxExecute() does
+      for ( int fd = STDERR_FILENO + 1; fd < (int)FD_SETSIZE; fd++ )
+      {
+         if ( fd == fdExec[1] )
+            continue;
+
+         bool keep = false;
+         for ( size_t n = 1; n <= count && !keep; n++ )
+         {
+            if ( inputs[n].fdChild == fd )
+               keep = true;
+         }
+
+         if ( !keep )
+            close(fd);
+      }
+
+      execvp(argv[0], &argv[0]);
+
+      // let the parent know why exec failed
+      const int err = errno;
+      if ( write(fdExec[1], &err, sizeof(err)) != sizeof(err) )
+         _exit(126);
+
+      _exit(127);
+   }
+
+   // parent: close the child ends of all the channels
+   for ( size_t n = 0; n <= count; n++ )
+      CloseFd(inputs[n].fdChild);
+   CloseFd(fdStatus[1]);
+   CloseFd(fdExec[1]);
+
+   if ( pid == -1 )
+   {
+      wxLogSysError(_("Failed to execute \"%s\""), m_command);
+
+      CloseFd(fdStatus[0]);
+      CloseFd(fdExec[0]);
+      for ( size_t n = 0; n <= count; n++ )
+         CloseFd(inputs[n].fd);
+
+      return -1;
+   }
+
+   // check if exec() succeeded: the pipe is closed without writing anything
+   // into it in this case
+   int errExec;
+   ssize_t lenExec;
+   do
+   {
+      lenExec = read(fdExec[0], &errExec, sizeof(errExec));
+   }
+   while ( lenExec == -1 && errno == EINTR );
+
+   CloseFd(fdExec[0]);
+
+   if ( lenExec == sizeof(errExec) )
+   {
+      wxLogSysError(errExec, _("Failed to execute \"%s\""), m_command);
+
+      CloseFd(fdStatus[0]);
+      for ( size_t n = 0; n <= count; n++ )
+         CloseFd(inputs[n].fd);
+
+      waitpid(pid, NULL, 0);
+
+      return -1;
+   }
+
+   m_processCount++;
+
+   wxLogTrace(TRACE_GPG, "Started gpg process %ld to verify %lu signatures",
+              (long)pid, (unsigned long)count);
+
+   fcntl(fdStatus[0], F_SETFL, fcntl(fdStatus[0], F_GETFL) | O_NONBLOCK);
+
+   // the index of the signature being currently checked or -1
+   int current = -1;
+
+   // the number of the signatures gpg started checking
+   int started = 0;
+
+   // the lines output before the first signature, they're general messages
+   // which concern all signatures
+   std::vector<std::string> common;
+
+   std::string lineBuf;
+   std::vector<pollfd> pfds;
+   std::vector<size_t> pfdsInputs;
+   while ( fdStatus[0] != -1 )
+   {
+      pfds.clear();
+      pfdsInputs.clear();
+
+      pollfd pfd;
+      pfd.fd = fdStatus[0];
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      pfds.push_back(pfd);
+
+      for ( size_t n = 0; n <= count; n++ )
+      {
+         if ( inputs[n].fd == -1 )
+            continue;
+
+         pfd.fd = inputs[n].fd;
+         pfd.events = POLLOUT;
+         pfds.push_back(pfd);
+         pfdsInputs.push_back(n);
+      }
+
+      const int rc = poll(&pfds[0], pfds.size(), m_msTimeout);
+      if ( rc == -1 )
+      {
+         if ( errno == EINTR )
+            continue;
+
+         wxLogSysError(_("Failed to communicate with GnuPG"));
+         break;
+      }
+
+      if ( rc == 0 )
+      {
+         wxLogTrace(TRACE_GPG, "gpg process %ld timed out", (long)pid);
+
+         *timedOut = true;
+         break;
+      }
+
+      // feed the data to gpg
+      for ( size_t i = 1; i < pfds.size(); i++ )
+      {
+         if ( !pfds[i].revents )
+            continue;
+
+         GPGInput& input = inputs[pfdsInputs[i - 1]];
+         const size_t left = input.data->length() - input.pos;
+         if ( left )
+         {
+            int flags = 0;
+#ifdef MSG_NOSIGNAL
+            flags |= MSG_NOSIGNAL;
+#endif
+            const ssize_t written = send
+                                    (
+                                       input.fd,
+                                       input.data->data() + input.pos,
+                                       left < GPG_WRITE_CHUNK ? left
+                                                              : GPG_WRITE_CHUNK,
+                                       flags
+                                    );
+            if ( written == -1 )
+            {
+               if ( errno == EAGAIN || errno == EINTR )
+                  continue;
+
+               // gpg closed this input, probably because it stopped after
+               // an error
+               CloseFd(input.fd);
+               continue;
+            }
+
+            input.pos += written;
+         }
+
+         // close the input as soon as we wrote everything to let gpg know
+         // that there is no more data
+         if ( input.pos == input.data->length() )
+            CloseFd(input.fd);
+      }
+
+      // and read its output
+      if ( !pfds[0].revents )
+         continue;
+
+      char buf[4096];
+      const ssize_t len = read(fdStatus[0], buf, sizeof(buf));
+      if ( len == -1 )
+      {
+         if ( errno == EAGAIN || errno == EINTR )
+            continue;
+      }
+
+      if ( len <= 0 )
+      {
+         // the output is closed, gpg has exited; also process the last line
+         // if it wasn't terminated
+         CloseFd(fdStatus[0]);
+         if ( lineBuf.empty() )
+            break;
+
+         lineBuf += '\n';
+      }
+      else
+      {
+         lineBuf.append(buf, len);
+      }
+
+      size_t start = 0;
+      for ( ;; )
+      {
+         const size_t eol = lineBuf.find('\n', start);
+         if ( eol == std::string::npos )
+            break;
+
+         size_t end = eol;
+         if ( end > start && lineBuf[end - 1] == '\r' )
+            end--;
+
+         const std::string line(lineBuf, start, end - start);
+         start = eol + 1;
+
+         if ( line.compare(0, sizeof(GPG_STATUS_PREFIX) - 1,
+                           GPG_STATUS_PREFIX) == 0 )
+         {
+            const std::string status(line, sizeof(GPG_STATUS_PREFIX) - 1);
+            if ( status.compare(0, 11, "FILE_START ") == 0 )
+            {
+               // gpg checks the files in the order in which we gave them
+               if ( (size_t)started < count )
+               {
+                  current = started++;
+                  sigs[current]->processed = true;
+               }
+               else
+               {
+                  FAIL_MSG( "unexpected FILE_START from gpg" );
+
+                  current = -1;
+               }
+            }
+            else if ( status.compare(0, 9, "FILE_DONE") == 0 )
+            {
+               current = -1;
+            }
+            else if ( current != -1 )
+            {
+               sigs[current]->status.push_back(status);
+            }
+         }
+         else if ( current != -1 )
+         {
+            sigs[current]->messages.push_back(line);
+         }
+         else if ( !started )
+         {
+            common.push_back(line);
+         }
+      }
+
+      lineBuf.erase(0, start);
+   }
+
+   for ( size_t n = 0; n <= count; n++ )
+      CloseFd(inputs[n].fd);
+
+   if ( fdStatus[0] != -1 )
+   {
+      // we gave up on this process, make sure it doesn't hang around
+      kill(pid, SIGKILL);
+      CloseFd(fdStatus[0]);
+   }
+
+   while ( waitpid(pid, NULL, 0) == -1 && errno == EINTR )
+      ;
+
+   wxLogTrace(TRACE_GPG, "gpg process %ld checked %d signatures",
+              (long)pid, started);
+
+   if ( !common.empty() )
+   {
+      // if gpg didn't check anything at all, these messages probably explain
+      // why, so keep them for the first signature
+      const int last = started ? started : 1;
+      for ( int n = 0; n < last; n++ )
+      {
+         sigs[n]->messages.insert(sigs[n]->messages.begin(),
+                                  common.begin(), common.end());
+      }
+   }
+
+   return started;
+}
+
+#else // !OS_UNIX
+
+int
+GnuPGSession::RunBatch(DetachedSignature ** /* sigs */,
+                       const std::string * /* messages */,
+                       size_t /* count */,
+                       bool *timedOut)
+{
+   *timedOut = false;
+
+   return -1;
+}
+
+#endif // OS_UNIX/!OS_UNIX
@@ -38,6 +38,7 @@
 #include "PathFinder.h"       // for PathFinder
 #include "Composer.h"         // for RestoreAll()
 #include "SendMessage.h"
+#include "mail/SendSession.h"
 #include "ConfigSourceLocal.h"
 #include "MAtExit.h"
 
@@ -52,6 +53,10 @@
 #include "Mupgrade.h"
 
 #include "MFCache.h"          // for MfStatusCache::CleanUp
+#include "mail/SearchIndex.h" // for MsgSearchIndex::Init/CleanUp
+#include "mail/Dnsbl.h"       // for DnsblChecker::CleanUp
+#include "mail/MailThreadPool.h" // for MailThreadPool::CleanUp
+#include "modules/Migrate.h"  // for MModule_Migrate
 
 #include "CmdLineOpts.h"
 
@@ -133,6 +138,9 @@ WX_DEFINE_ARRAY(const wxMFrame *, ArrayFrames);
    static const wxChar *MAHOGANY_DATADIR = _T("share/mahogany");
 #endif
 
+// trace mask for sending messages from the outbox
+#define TRACE_OUTBOX _T("outbox")
+
 // ============================================================================
 // implementation
 // ============================================================================
@@ -361,6 +369,27 @@ MAppBase::ContinueStartup()
    // ----------------------------------------------
 
    ProcessSendCmdLineOptions(*m_cmdLineOptions);
+
+   // run the migration requested on command line and exit
+   // ----------------------------------------------------
+
+   const CmdLineOptions::Migrate& migrate = m_cmdLineOptions->migrate;
+   if ( !migrate.from.empty() )
+   {
+      MModule_Migrate *module =
+         (MModule_Migrate *)MModule::LoadModule(MMODULE_NAME_MIGRATE);
+      if ( module )
+      {
+         module->MigrateLocalTree(migrate.from, migrate.to);
+         module->DecRef();
+      }
+      else
+      {
+         wxLogError(_("Failed to load the migration module."));
+      }
+
+      Exit(false /* don't ask */);
+   }
 }
 
 bool
@@ -495,6 +524,9 @@ MAppBase::OnStartup()
    // find our directories
    InitDirectories();
 
+   // create the full text index before any folders are opened
+   MsgSearchIndex::Init();
+
    // safe mode implies interactive
    if ( !m_cmdLineOptions->safe )
    {
@@ -698,6 +730,10 @@ MAppBase::OnShutDown()
          m_FolderMonitor = NULL;
       }
 
+      // wait for the folder operations running in the background threads,
+      // if any, to finish and dispatch their results
+      MailThreadPool::CleanUp();
+
       // clean up
       MEventManager::DispatchPending();
       AdbManager::Delete();
@@ -740,6 +776,10 @@ MAppBase::OnShutDown()
 
       MailFolder::CleanUp();
       MfStatusCache::CleanUp();
+      MsgSearchIndex::CleanUp();
+#ifdef USE_RBL
+      DnsblChecker::CleanUp();
+#endif // USE_RBL
 
       // there might have been events queued, get rid of them
       //
@@ -1247,6 +1287,10 @@ MAppBase::SendOutbox(const String & outbox, bool
    size_t nbOfMsgTried = 0;
    UIdType i = 0;
 
+   // reuse the connections to the server(s) for all messages
+   SendSession session;
+   long msTotal = 0;
+
    // FIXME: rewrite this loop as a for loop and do not try
    // to delete messages inside the body of the loop ?
    while ( i < hil->Count() )
@@ -1282,10 +1326,25 @@ MAppBase::SendOutbox(const String & outbox, bool
       SendMessage_obj
          sendMsg(SendMessage::CreateFromMsg(mf->GetProfile(), msg.Get()));
 
+      if ( sendMsg )
+         sendMsg->SetSession(&session);
+
+      const size_t countSentBefore = session.GetMessageCount();
       if ( sendMsg && sendMsg->SendOrQueue(SendMessage::NeverQueue) )
       {
          count++;
          mf->DeleteMessage(hi->GetUId());
+
+         // the session is not used when sending via local MTA
+         if ( session.GetMessageCount() != countSentBefore )
+         {
+            const SendSession::Timing& timing = session.GetLastTiming();
+            msTotal += timing.msConnect + timing.msSend;
+
+            wxLogTrace(TRACE_OUTBOX, _T("Message %zu/%zu sent in %ld ms"),
+                       nbOfMsgTried, totalNb,
+                       timing.msConnect + timing.msSend);
+         }
       }
       else
       {
@@ -1301,6 +1360,17 @@ MAppBase::SendOutbox(const String & outbox, bool
       String msg;
       msg.Printf(_("Sent %zu messages from outbox \"%s\"."),
                  count, mf->GetName());
+
+      const size_t countSession = session.GetMessageCount();
+      if ( countSession )
+      {
+         msg += ' ';
+         msg += String::Format(_("Average time per message: %ld ms, "
+                                 "connections used: %zu."),
+                               msTotal / (long)countSession,
+                               session.GetConnectionCount());
+      }
+
       STATUSMESSAGE((msg));
    }
 }
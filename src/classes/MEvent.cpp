@@ -320,6 +320,10 @@ MEventOptionsChangeData::MEventOptionsChangeData(Profile *profile,
 
                        : MEventData(MEventId_OptionsChange)
 {
+   // the options could have been changed without using Profile, make sure
+   // that the receivers of this event see the new values
+   Profile::InvalidateCache();
+
    SafeIncRef(profile);
 
    m_profile = profile;
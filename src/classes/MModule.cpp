@@ -36,9 +36,14 @@
 #undef SendMessage
 #endif // __WINE__
 #include <wx/textfile.h>        // for wxTextFile
+#include <wx/file.h>            // for wxTempFile
 #include <wx/filename.h>
+#include <wx/stopwatch.h>
+
+#include "CacheFile.h"
 
 #include <list>
+#include <map>
 
 // ----------------------------------------------------------------------------
 // Implementation of the MInterface
@@ -114,6 +119,114 @@ typedef std::list<MModuleListEntry> MModuleList;
 /// The actual list of all loaded modules.
 static MModuleList *gs_MModuleList = NULL;
 
+#ifndef USE_MODULES_STATIC
+
+/**
+  The manifest of all the shared libraries found in the modules directories.
+
+  It caches the properties of each library so that ListAvailableModules()
+  doesn't have to load all of them just to find out which interfaces they
+  implement: the libraries are only loaded for this if they are new or if
+  their modification time or size changed since the last time.
+
+  The manifest is kept in memory for the program lifetime and is saved in
+  the cache directory whenever it changes, so that it can be reused during
+  the next program run.
+ */
+class ModuleManifest : public CacheFile
+{
+public:
+   /// the kinds of the libraries in the manifest
+   enum Kind
+   {
+      Kind_Module,      // a Mahogany module
+      Kind_NotModule,   // a library without MMODULE_GETPROPERTY_FUNCTION
+      Kind_Corrupted,   // a module without properties
+      Kind_NotLoaded    // the library couldn't be loaded, not saved
+   };
+
+   /// the information about one library
+   struct Entry
+   {
+      Entry() { mtime = 0; size = -1; kind = Kind_NotLoaded; }
+
+      /// return the value of the property or empty string if none
+      String GetProperty(const char *name) const;
+
+      /// the modification time and the size of the library when we loaded it
+      time_t mtime;
+      wxFileOffset size;
+
+      /// the kind of the library
+      Kind kind;
+
+      /// the module properties
+      wxArrayString names,
+                    values;
+   };
+
+   /**
+     Get the global manifest, loading it if necessary.
+
+     Returns NULL if the manifest can't be used yet because the directory
+     containing it is not known, use Probe() directly in this case.
+    */
+   static ModuleManifest *Get();
+
+   /// load the library and fill in the entry with its properties
+   static void Probe(const String& filename, Entry& entry);
+
+   /// save the global manifest if necessary and delete it
+   static void CleanUp();
+
+   /**
+     Return the entry for the given library.
+
+     The library is loaded to get its properties only if it isn't in the
+     manifest yet or if it changed.
+    */
+   const Entry& GetEntry(const String& filename);
+
+   /// remove the entries for all libraries not in the given array
+   void Prune(const wxArrayString& filenames);
+
+   /// save the manifest if it changed
+   void Flush();
+
+   /// return the number of libraries loaded by GetEntry() so far
+   size_t GetProbedCount() const { return m_countProbed; }
+
+protected:
+   // implement CacheFile pure virtuals
+   virtual String GetFileName() const;
+   virtual String GetFileHeader() const;
+   virtual int GetFormatVersion() const;
+
+   virtual bool DoLoad(const wxTextFile& file, int version);
+   virtual bool DoSave(wxTempFile& file);
+
+private:
+   ModuleManifest() { m_isDirty = false; m_countProbed = 0; }
+
+   typedef std::map<String, Entry> Entries;
+
+   /// the entries indexed by the library path
+   Entries m_entries;
+
+   /// true if the manifest needs to be saved
+   bool m_isDirty;
+
+   /// the number of libraries we loaded
+   size_t m_countProbed;
+
+   DECLARE_NO_COPY_CLASS(ModuleManifest)
+};
+
+/// The global module manifest, created on demand.
+static ModuleManifest *gs_moduleManifest = NULL;
+
+#endif // !USE_MODULES_STATIC
+
 // ============================================================================
 // implementation
 // ============================================================================
@@ -211,6 +324,10 @@ void MModule_Cleanup(void)
       delete gs_MModuleList;
       gs_MModuleList = NULL;
    }
+
+#ifndef USE_MODULES_STATIC
+   ModuleManifest::CleanUp();
+#endif // !USE_MODULES_STATIC
 }
 
 
@@ -626,6 +743,8 @@ MModule::ListAvailableModules(const String& interfaceName)
               interfaceName, path);
 #endif // DEBUG
 
+   wxStopWatch sw;
+
    // First, build list of all .dll/.so files in module directories
    wxString extDll = DLL_EXTENSION;
 
@@ -658,9 +777,19 @@ MModule::ListAvailableModules(const String& interfaceName)
       }
    }
 
-   // Second: load list info:
+   // Second: get the modules properties from the manifest, this only loads
+   // the libraries which are new or changed since it was last updated
    const wxArrayString modulesBlacklist(GetBlacklistedModules());
 
+   // if the manifest can't be used yet, just load all the libraries
+   ModuleManifest * const manifest = ModuleManifest::Get();
+   if ( manifest )
+      manifest->Prune(modules);
+
+   const size_t countProbedBefore = manifest ? manifest->GetProbedCount() : 0;
+
+   ModuleManifest::Entry entryProbed;
+
    MModuleListingImpl *listing = MModuleListingImpl::Create(modules.size());
    size_t count = 0;
    for( wxArrayString::const_iterator it = modules.begin();
@@ -669,71 +798,79 @@ MModule::ListAvailableModules(const String& interfaceName)
    {
       filename = *it;
 
-      wxDynamicLibrary dll(filename);
-      MModule_GetModulePropFuncType
-         getProps = dll.IsLoaded() ?
-            (MModule_GetModulePropFuncType)
-            dll.GetSymbol(MMODULE_GETPROPERTY_FUNCTION) : NULL;
+      if ( !manifest )
+         ModuleManifest::Probe(filename, entryProbed);
 
-      if ( !getProps )
+      const ModuleManifest::Entry&
+         props = manifest ? manifest->GetEntry(filename) : entryProbed;
+      switch ( props.kind )
       {
-         // this is not our module
-         wxLogWarning(_("Shared library '%s' is not a Mahogany module."),
-                      filename);
+         case ModuleManifest::Kind_Module:
+            break;
 
-         continue;
+         case ModuleManifest::Kind_Corrupted:
+            // no properties in this module??
+            wxLogWarning(_("Mahogany module '%s' is probably corrupted"),
+                         filename);
+            continue;
+
+         default:
+            // this is not our module
+            wxLogWarning(_("Shared library '%s' is not a Mahogany module."),
+                         filename);
+            continue;
       }
 
-      const ModuleProperty *props = (*getProps)();
-
       // does it have the right interface?
-      String interfaceModule;
+      const String
+         interfaceModule = props.GetProperty(MMODULE_INTERFACE_PROP);
 
-      if ( props )
+      if ( !interfaceName.empty() )
       {
-         interfaceModule = GetMModuleProperty(props,
-                                              MMODULE_INTERFACE_PROP);
-
-         if ( !interfaceName.empty() )
+         if ( interfaceName != interfaceModule )
          {
-            if ( interfaceName != interfaceModule )
-            {
-               // wrong interface, we're not interested in this one
-               continue;
-            }
-
-            // note that this check is only done for a specific interface, if
-            // all modules are requested, then return really all of them
-            const String name = GetMModuleProperty(props, MMODULE_NAME_PROP);
-            if ( modulesBlacklist.Index(name) != wxNOT_FOUND )
-            {
-               // this module was excluded by user
-               continue;
-            }
+            // wrong interface, we're not interested in this one
+            continue;
          }
 
-         // use the file name, not MMODULE_NAME_PROP, so that we can
-         // LoadModule() it later
-         const String name = wxFileName(filename).GetName();
-         MModuleListingEntryImpl entry(
-            name,
-            interfaceModule,
-            GetMModuleProperty(props, MMODULE_DESC_PROP),
-            GetMModuleProperty(props, MMODULE_DESCRIPTION_PROP),
-            GetMModuleProperty(props, MMODULE_VERSION_PROP),
-            GetMModuleProperty(props, MMODULE_AUTHOR_PROP)
-         );
-
-         (*listing)[count++] = entry;
-      }
-      else // no properties in this module??
-      {
-         wxLogWarning(_("Mahogany module '%s' is probably corrupted"),
-                      filename);
+         // note that this check is only done for a specific interface, if
+         // all modules are requested, then return really all of them
+         const String name = props.GetProperty(MMODULE_NAME_PROP);
+         if ( modulesBlacklist.Index(name) != wxNOT_FOUND )
+         {
+            // this module was excluded by user
+            continue;
+         }
       }
+
+      // use the file name, not MMODULE_NAME_PROP, so that we can
+      // LoadModule() it later
+      const String name = wxFileName(filename).GetName();
+      MModuleListingEntryImpl entry(
+         name,
+         interfaceModule,
+         props.GetProperty(MMODULE_DESC_PROP),
+         props.GetProperty(MMODULE_DESCRIPTION_PROP),
+         props.GetProperty(MMODULE_VERSION_PROP),
+         props.GetProperty(MMODULE_AUTHOR_PROP)
+      );
+
+      (*listing)[count++] = entry;
    }
 
-   wxLogTrace(M_TRACE_MODULES, _T("\t%zu modules found."), count);
+   if ( manifest )
+      manifest->Flush();
+
+   // this allows to compare the time needed with a cold manifest, when all
+   // the libraries must be loaded, with the time needed with a warm one
+   const size_t countProbed = manifest ? manifest->GetProbedCount()
+                                            - countProbedBefore
+                                       : modules.size();
+   wxLogTrace(M_TRACE_MODULES,
+              _T("\t%zu modules found, %zu of %zu libraries loaded "
+                 "(%s manifest) in %ldms."),
+              count, countProbed, modules.size(),
+              countProbed ? _T("cold") : _T("warm"), sw.Time());
 
    listing->SetCount(count);
 
@@ -830,6 +967,302 @@ static wxArrayString BuildListOfModulesDirs()
    return dirs;
 }
 
+// ----------------------------------------------------------------------------
+// ModuleManifest
+// ----------------------------------------------------------------------------
+
+// the name of the manifest file in the cache directory
+#define MODULE_MANIFEST_FILENAME _T("modules")
+
+// escape the characters which can't appear in a manifest field
+static String EscapeManifestField(const String& s)
+{
+   String escaped;
+   escaped.reserve(s.length());
+
+   for ( String::const_iterator p = s.begin(); p != s.end(); ++p )
+   {
+      switch ( (wxChar)*p )
+      {
+         case '\\': escaped += _T("\\\\"); break;
+         case '\t': escaped += _T("\\t"); break;
+         case '\n': escaped += _T("\\n"); break;
+         case '\r': escaped += _T("\\r"); break;
+         default:   escaped += *p;
+      }
+   }
+
+   return escaped;
+}
+
+// split a manifest line into tab-separated fields undoing the escaping
+static wxArrayString SplitManifestLine(const String& line)
+{
+   wxArrayString fields;
+
+   String field;
+   for ( String::const_iterator p = line.begin(); ; ++p )
+   {
+      if ( p == line.end() || *p == _T('\t') )
+      {
+         fields.Add(field);
+
+         if ( p == line.end() )
+            break;
+
+         field.clear();
+      }
+      else if ( *p == _T('\\') )
+      {
+         if ( ++p == line.end() )
+            break;
+
+         switch ( (wxChar)*p )
+         {
+            case 't': field += _T('\t'); break;
+            case 'n': field += _T('\n'); break;
+            case 'r': field += _T('\r'); break;
+            default:  field += *p;
+         }
+      }
+      else
+      {
+         field += *p;
+      }
+   }
+
+   return fields;
+}
+
+String ModuleManifest::Entry::GetProperty(const char *name) const
+{
+   const int n = names.Index(name);
+
+   return n == wxNOT_FOUND ? String() : values[n];
+}
+
+/* static */
+ModuleManifest *ModuleManifest::Get()
+{
+   // the manifest is stored in the cache directory which is unknown until
+   // MAppBase::InitDirectories() is called, but the modules can be listed
+   // before it, e.g. for the extra config sources from
+   // Profile::CreateGlobalConfig(): don't load nor save it then, otherwise
+   // we'd use (and overwrite) the file in the wrong place
+   if ( !mApplication || mApplication->GetLocalDir().empty() )
+      return NULL;
+
+   if ( !gs_moduleManifest )
+   {
+      gs_moduleManifest = new ModuleManifest;
+      gs_moduleManifest->Load();
+   }
+
+   return gs_moduleManifest;
+}
+
+/* static */
+void ModuleManifest::CleanUp()
+{
+   if ( gs_moduleManifest )
+   {
+      gs_moduleManifest->Flush();
+
+      delete gs_moduleManifest;
+      gs_moduleManifest = NULL;
+   }
+}
+
+/* static */
+void ModuleManifest::Probe(const String& filename, Entry& entry)
+{
+   entry.names.clear();
+   entry.values.clear();
+
+   wxDynamicLibrary dll(filename);
+   if ( !dll.IsLoaded() )
+   {
+      // don't remember this one: it may become loadable later, e.g. if the
+      // libraries it depends on are installed, even if it doesn't change
+      entry.kind = Kind_NotLoaded;
+      return;
+   }
+
+   MModule_GetModulePropFuncType getProps =
+      (MModule_GetModulePropFuncType)
+      dll.GetSymbol(MMODULE_GETPROPERTY_FUNCTION);
+   if ( !getProps )
+   {
+      entry.kind = Kind_NotModule;
+      return;
+   }
+
+   const ModuleProperty *props = (*getProps)();
+   if ( !props )
+   {
+      entry.kind = Kind_Corrupted;
+      return;
+   }
+
+   for ( ; props->name; props++ )
+   {
+      entry.names.Add(props->name);
+      entry.values.Add(props->value);
+   }
+
+   entry.kind = Kind_Module;
+}
+
+const ModuleManifest::Entry& ModuleManifest::GetEntry(const String& filename)
+{
+   wxStructStat st;
+   const bool hasStat = wxStat(filename, &st) == 0;
+
+   Entry& entry = m_entries[filename];
+   if ( hasStat &&
+         entry.kind != Kind_NotLoaded &&
+            entry.mtime == st.st_mtime &&
+               entry.size == (wxFileOffset)st.st_size )
+   {
+      // the library didn't change since we loaded it
+      return entry;
+   }
+
+   wxLogTrace(M_TRACE_MODULES, _T("Loading '%s' to get its properties."),
+              filename);
+
+   Probe(filename, entry);
+
+   entry.mtime = hasStat ? st.st_mtime : 0;
+   entry.size = hasStat ? (wxFileOffset)st.st_size : -1;
+
+   m_countProbed++;
+   m_isDirty = true;
+
+   return entry;
+}
+
+void ModuleManifest::Prune(const wxArrayString& filenames)
+{
+   for ( Entries::iterator i = m_entries.begin(); i != m_entries.end(); )
+   {
+      if ( filenames.Index(i->first) == wxNOT_FOUND )
+      {
+         m_entries.erase(i++);
+
+         m_isDirty = true;
+      }
+      else
+      {
+         ++i;
+      }
+   }
+}
+
+void ModuleManifest::Flush()
+{
+   if ( !m_isDirty )
+      return;
+
+   // don't try to save it again even if we failed, Save() already gave the
+   // error message and the manifest is just a cache anyhow
+   m_isDirty = false;
+
+   Save();
+}
+
+String ModuleManifest::GetFileName() const
+{
+   String filename;
+   filename << GetCacheDirName() << DIR_SEPARATOR << MODULE_MANIFEST_FILENAME;
+
+   return filename;
+}
+
+String ModuleManifest::GetFileHeader() const
+{
+   return _T("Mahogany Module Manifest File (version %d.%d)");
+}
+
+int ModuleManifest::GetFormatVersion() const
+{
+   return BuildVersion(1, 0);
+}
+
+bool ModuleManifest::DoLoad(const wxTextFile& file, int /* version */)
+{
+   // each line contains the library path, its modification time, size and
+   // kind followed by the property names and values, all separated by TABs
+   const size_t count = file.GetLineCount();
+   for ( size_t n = 1; n < count; n++ )
+   {
+      const wxArrayString fields = SplitManifestLine(file[n]);
+
+      long mtime,
+           kind;
+      wxLongLong_t size;
+      if ( fields.size() < 4 || fields.size() % 2 ||
+            !fields[1].ToLong(&mtime) ||
+            !fields[2].ToLongLong(&size) ||
+            !fields[3].ToLong(&kind) || kind < 0 || kind >= Kind_NotLoaded )
+      {
+         // just ignore it, the library will be loaded again
+         wxLogDebug(_T("Corrupted line %lu in the module manifest."),
+                    (unsigned long)n + 1);
+         continue;
+      }
+
+      Entry& entry = m_entries[fields[0]];
+      entry.mtime = mtime;
+      entry.size = size;
+      entry.kind = (Kind)kind;
+
+      for ( size_t i = 4; i < fields.size(); i += 2 )
+      {
+         entry.names.Add(fields[i]);
+         entry.values.Add(fields[i + 1]);
+      }
+   }
+
+   wxLogTrace(M_TRACE_MODULES, _T("Loaded %lu entries from module manifest."),
+              (unsigned long)m_entries.size());
+
+   return true;
+}
+
+bool ModuleManifest::DoSave(wxTempFile& file)
+{
+   String line;
+   for ( Entries::const_iterator i = m_entries.begin();
+         i != m_entries.end();
+         ++i )
+   {
+      const Entry& entry = i->second;
+      if ( entry.kind == Kind_NotLoaded )
+         continue;
+
+      line.Printf(_T("%s\t%ld\t%") wxLongLongFmtSpec _T("d\t%d"),
+                  EscapeManifestField(i->first),
+                  (long)entry.mtime,
+                  (wxLongLong_t)entry.size,
+                  (int)entry.kind);
+
+      const size_t countProps = entry.names.size();
+      for ( size_t n = 0; n < countProps; n++ )
+      {
+         line << _T('\t') << EscapeManifestField(entry.names[n])
+              << _T('\t') << EscapeManifestField(entry.values[n]);
+      }
+
+      line += _T('\n');
+
+      if ( !file.Write(line) )
+         return false;
+   }
+
+   return true;
+}
+
 #endif // !USE_MODULES_STATIC
 
 // ----------------------------------------------------------------------------
@@ -115,6 +115,7 @@ extern const MOption MP_INLINE_GFX;
 extern const MOption MP_INLINE_GFX_EXTERNAL;
 extern const MOption MP_INLINE_GFX_SIZE;
 extern const MOption MP_MAX_MESSAGE_SIZE;
+extern const MOption MP_MESSAGEPROGRESS_THRESHOLD_SIZE;
 extern const MOption MP_MSGVIEW_ALLOW_HTML;
 extern const MOption MP_MSGVIEW_ALLOW_IMAGES;
 extern const MOption MP_MSGVIEW_AUTO_VIEWER;
@@ -352,14 +353,18 @@ public:
    }
 
 protected:
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style)
    {
+      // this is the only place where the text is copied unless some filter
+      // modifies it
+      const String str = text.ToString();
+
       if ( m_isInBody )
-         m_msgView->OnBodyText(text);
+         m_msgView->OnBodyText(str);
 
-      viewer->InsertText(text, style);
+      viewer->InsertText(str, style);
    }
 
    bool m_isInBody;
@@ -411,6 +416,90 @@ private:
    ViewFilterNode *m_next;
 };
 
+// ----------------------------------------------------------------------------
+// MimeFileSink: writes MIME part data to a file showing progress if it's big
+// ----------------------------------------------------------------------------
+
+class MimeFileSink : public MimePartSink
+{
+public:
+   /**
+      Create the sink writing to the given file.
+
+      @param file the file to write to, must be opened
+      @param filename the name of the file, only used for the progress dialog
+      @param parent the parent window for the progress dialog
+      @param sizeMin the progress dialog is only shown for the parts of at
+                     least this size
+    */
+   MimeFileSink(wxFile& file,
+                const String& filename,
+                wxWindow *parent,
+                size_t sizeMin)
+      : m_file(file),
+        m_filename(filename)
+   {
+      m_parent = parent;
+      m_sizeMin = sizeMin;
+      m_written = 0;
+      m_dlgProgress = NULL;
+   }
+
+   virtual ~MimeFileSink()
+   {
+      delete m_dlgProgress;
+   }
+
+   virtual bool Write(const void *data, size_t len)
+   {
+      if ( m_file.Write(data, len) != len )
+         return false;
+
+      m_written += len;
+
+      return true;
+   }
+
+   virtual bool OnProgress(size_t done, size_t total)
+   {
+      if ( !m_dlgProgress )
+      {
+         // don't bother showing the dialog for small parts or if we're
+         // already done
+         if ( total < m_sizeMin || done >= total )
+            return true;
+
+         m_dlgProgress = new MProgressDialog
+                             (
+                              _("Saving attachment"),
+                              String::Format(_("Saving attachment to '%s'..."),
+                                             m_filename),
+                              100,
+                              m_parent
+                             );
+      }
+
+      // the total size is only approximative, so don't overflow
+      return m_dlgProgress->Update(done < total ? (int)((100.*done) / total)
+                                                : 100);
+   }
+
+   /// get the number of bytes written so far
+   size_t GetWritten() const { return m_written; }
+
+private:
+   wxFile& m_file;
+   const String m_filename;
+   wxWindow *m_parent;
+   size_t m_sizeMin;
+
+   size_t m_written;
+
+   MProgressDialog *m_dlgProgress;
+
+   DECLARE_NO_COPY_CLASS(MimeFileSink)
+};
+
 // ============================================================================
 // implementation
 // ============================================================================
@@ -2539,19 +2628,23 @@ MessageView::ProcessSignedMultiPart(const MimePart *mimepart)
    // the signature is applied to both the headers and the body of the
    // message and it is done after encoding the latter so we need to get
    // it in the raw form
-   String signedText = signedPart->GetHeaders() +
-                           signedPart->GetRawContentAsString();
-
-   MCryptoEngine::Status status = pgpEngine->VerifyDetachedSignature
-                                             (
-                                                signedText,
-                                                signaturePart->GetTextContent(),
-                                                log
-                                             );
+   //
+   // also pass the message id to the engine to allow it to reuse the result
+   // of the previous check of the same message
+   MCryptoEngine::DetachedSignatures sigs(1);
+   MCryptoEngine::DetachedSignature& sig = sigs[0];
+   sig.messageId = m_mailMessage->GetId();
+   sig.message = signedPart->GetHeaders() +
+                     signedPart->GetRawContentAsString();
+   sig.signature = signaturePart->GetTextContent();
+   sig.log = log;
+
+   pgpEngine->VerifyDetachedSignatures(sigs);
+
    ClickablePGPInfo *pgpInfo = ClickablePGPInfo::CreateFromSigStatusCode
                                (
                                  pgpEngine,
-                                 status,
+                                 sig.status,
                                  this,
                                  log
                                );
@@ -3621,34 +3714,33 @@ MessageView::MimeSave(const MimePart *mimepart,const wxChar *ifilename)
       return MimeSaveAsMessage(mimepart, filename);
    }
 
-   unsigned long len;
-   const void *content = mimepart->GetContent(&len);
-   if ( !content )
-   {
-      wxLogError(_("Cannot get attachment content."));
-   }
-   else
+   wxFile out(filename, wxFile::write);
+   if ( out.IsOpened() )
    {
-      wxFile out(filename, wxFile::write);
-      bool ok = out.IsOpened();
-
-      if ( ok )
-      {
-         // write the body
-         ok = out.Write(content, len) == len;
-      }
+      // use the same threshold as for showing the progress when retrieving
+      // the messages for the progress of saving the attachments
+      const long sizeMin = READ_CONFIG(GetProfile(),
+                                       MP_MESSAGEPROGRESS_THRESHOLD_SIZE);
 
-      if ( ok )
+      // write the part data as we retrieve it instead of getting all of it
+      // first, attachments can be (very) big
+      MimeFileSink sink(out, filename, GetParentFrame(),
+                        sizeMin > 0 ? (size_t)sizeMin*1024 : (size_t)-1);
+      if ( mimepart->WriteContent(sink) && out.Close() )
       {
          // only display in interactive mode
          if ( strutil_isempty(ifilename) )
          {
             wxLogStatus(GetParentFrame(), _("Wrote %lu bytes to file '%s'"),
-                        len, filename);
+                        (unsigned long)sink.GetWritten(), filename);
          }
 
          return true;
       }
+
+      // don't leave partially written file behind
+      out.Close();
+      wxRemoveFile(filename);
    }
 
    wxLogError(_("Could not save the attachment."));
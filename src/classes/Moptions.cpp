@@ -162,6 +162,8 @@ const MOption MP_SPLASHDELAY;
 const MOption MP_AUTOSAVEDELAY;
 const MOption MP_POLLINCOMINGDELAY;
 const MOption MP_POLL_OPENED_ONLY;
+const MOption MP_POLL_CONCURRENTLY;
+const MOption MP_POLL_IDLE_MAX;
 const MOption MP_COLLECTATSTARTUP;
 const MOption MP_CONFIRMEXIT;
 const MOption MP_OPEN_ON_CLICK;
@@ -585,6 +587,8 @@ static const MOptionData MOptions[] =
     DEFINE_OPTION(MP_AUTOSAVEDELAY),
     DEFINE_OPTION(MP_POLLINCOMINGDELAY),
     DEFINE_OPTION(MP_POLL_OPENED_ONLY),
+    DEFINE_OPTION(MP_POLL_CONCURRENTLY),
+    DEFINE_OPTION(MP_POLL_IDLE_MAX),
     DEFINE_OPTION(MP_COLLECTATSTARTUP),
     DEFINE_OPTION(MP_CONFIRMEXIT),
     DEFINE_OPTION(MP_OPEN_ON_CLICK),
@@ -34,6 +34,9 @@
 #endif // USE_PCH
 
 #include <wx/config.h>
+#include <wx/hashmap.h>
+#include <wx/thread.h>                    // for wxIsMainThread()
+#include <wx/atomic.h>
 
 #include "lists.h"
 #include "pointers.h"
@@ -80,6 +83,32 @@ enum
    Lookup_All = 7
 };
 
+// ----------------------------------------------------------------------------
+// options values cache
+// ----------------------------------------------------------------------------
+
+// the generation of the values cached by ProfileImpl: it is incremented
+// whenever any option changes and the cached values of the previous
+// generations are discarded, notice that the options can be changed from the
+// worker threads too, so it must be only modified atomically
+static wxAtomicInt gs_cacheGeneration = 0;
+
+// the value of an option found by ProfileImpl::readEntry()
+struct ProfileCachedValue
+{
+   // where it was found, Read_Default if it wasn't
+   Profile::ReadResult found;
+
+   // the value itself, only used if found
+   String str;
+   long num;
+
+   // true if the env vars in str have been expanded
+   bool expanded;
+};
+
+WX_DECLARE_STRING_HASH_MAP(ProfileCachedValue, ProfileValuesCache);
+
 // ============================================================================
 // private classes
 // ============================================================================
@@ -145,7 +174,12 @@ public:
 
    virtual const String& GetName(void) const { return m_ProfileName; }
 
-   virtual wxConfigBase *GetConfig() const { return wxConfig::Get(); }
+   virtual wxConfigBase *GetConfig() const
+   {
+      // all changes done using it go through AllConfigSources and so
+      // invalidate the values cache just as our own methods do
+      return wxConfig::Get();
+   }
 
    virtual void Suspend(void)
       {
@@ -156,6 +190,8 @@ public:
          ms_suspendCount++;
 
          m_wroteSuspended = false;
+
+         InvalidateCache();
       }
 
    /// Commit changes from suspended mode.
@@ -185,6 +221,7 @@ protected:
       {
          m_Suspended = 0;
          m_Identity = NULL;
+         m_cacheGeneration = gs_cacheGeneration;
       }
 
    /// Destructor, writes back those entries that got changed.
@@ -216,6 +253,17 @@ private:
    /// common part of all writeEntry() overloads
    bool DoWriteEntry(const LookupData& data);
 
+   /**
+      Return true if the values cache can be used.
+
+      The cache is only used by the main thread and is cleared by this
+      function if it's out of date.
+    */
+   bool CanUseCache() const;
+
+   /// forget all values cached by this profile
+   void ClearCache() const;
+
 
    /// suspend count: if positive, we're in suspend mode
    int m_Suspended;
@@ -226,6 +274,26 @@ private:
    /// Is this profile using a different Identity at present?
    ProfileImpl *m_Identity;
 
+   /**
+      @name The values cache
+
+      The string and numeric values found by readEntry() in this profile or
+      its parents (including those which were not found at all) are cached
+      here to avoid looking them up in all config sources each time.
+    */
+   //@{
+
+   /// the string values
+   mutable ProfileValuesCache m_cacheStrings;
+
+   /// the numeric values
+   mutable ProfileValuesCache m_cacheLongs;
+
+   /// the generation of the cached values, see gs_cacheGeneration
+   mutable wxAtomicInt m_cacheGeneration;
+
+   //@}
+
    /// the count of all suspended profiles: if 0, nothing is suspended
    static size_t ms_suspendCount;
 
@@ -607,6 +675,11 @@ bool Profile::FlushAll()
    return gs_allConfigSources ? gs_allConfigSources->FlushAll() : true;
 }
 
+void Profile::InvalidateCache()
+{
+   wxAtomicInc(gs_cacheGeneration);
+}
+
 String Profile::ExpandEnvVarsIfNeeded(const String& val) const
 {
    String valExp = val;
@@ -654,6 +727,7 @@ ProfileImpl::ProfileImpl(const String & iName, Profile const *Parent)
       m_ProfileName << _T('/') << iName;
    m_Suspended = 0;
    m_Identity = NULL;
+   m_cacheGeneration = gs_cacheGeneration;
 
    String id = readEntry(GetOptionName(MP_PROFILE_IDENTITY),
                          GetStringDefault(MP_PROFILE_IDENTITY));
@@ -763,7 +837,12 @@ ProfileImpl::SetIdentity(const String & idName)
       ClearIdentity();
 
    if ( !idName.empty() )
+   {
       m_Identity = Identity::Create(idName);
+
+      // the identity settings override ours
+      ClearCache();
+   }
 }
 
 void
@@ -775,6 +854,8 @@ ProfileImpl::ClearIdentity(void)
    {
       m_Identity->DecRef();
       m_Identity = NULL;
+
+      ClearCache();
    }
 }
 
@@ -823,6 +904,33 @@ ProfileImpl::DeleteGroup(const String & path)
    return gs_allConfigSources->DeleteGroup(GetFullPath(path));
 }
 
+// ----------------------------------------------------------------------------
+// ProfileImpl values cache
+// ----------------------------------------------------------------------------
+
+bool ProfileImpl::CanUseCache() const
+{
+   // the profiles can be read from the worker threads too, but we don't
+   // want to lock the cache just for this, so simply don't use it there
+   if ( !wxIsMainThread() )
+      return false;
+
+   if ( m_cacheGeneration != gs_cacheGeneration )
+   {
+      ClearCache();
+
+      m_cacheGeneration = gs_cacheGeneration;
+   }
+
+   return true;
+}
+
+void ProfileImpl::ClearCache() const
+{
+   m_cacheStrings.clear();
+   m_cacheLongs.clear();
+}
+
 // ----------------------------------------------------------------------------
 // ProfileImpl reading data from config sources
 // ----------------------------------------------------------------------------
@@ -832,22 +940,71 @@ ProfileImpl::readEntry(const String & key,
                        const String & def,
                        ReadResult * found) const
 {
+   const bool useCache = CanUseCache();
+   if ( useCache )
+   {
+      ProfileValuesCache::const_iterator i = m_cacheStrings.find(key);
+      if ( i != m_cacheStrings.end() &&
+            i->second.expanded == IsExpandingEnvVars() )
+      {
+         const ProfileCachedValue& value = i->second;
+         if ( found )
+            *found = value.found;
+
+         // the default value may be different each time, so it's not cached
+         return value.found == Read_Default ? ExpandEnvVarsIfNeeded(def)
+                                            : value.str;
+      }
+   }
+
    LookupData ld(key, def);
    readEntry(ld);
    if(found)
       *found = ld.GetFound();
 
-   return ExpandEnvVarsIfNeeded(ld.GetString());
+   const String str = ExpandEnvVarsIfNeeded(ld.GetString());
+
+   if ( useCache )
+   {
+      ProfileCachedValue& value = m_cacheStrings[key];
+      value.found = ld.GetFound();
+      value.str = str;
+      value.expanded = IsExpandingEnvVars();
+   }
+
+   return str;
 }
 
 long
 ProfileImpl::readEntry(const String & key, long def, ReadResult * found) const
 {
+   const bool useCache = CanUseCache();
+   if ( useCache )
+   {
+      ProfileValuesCache::const_iterator i = m_cacheLongs.find(key);
+      if ( i != m_cacheLongs.end() )
+      {
+         const ProfileCachedValue& value = i->second;
+         if ( found )
+            *found = value.found;
+
+         return value.found == Read_Default ? def : value.num;
+      }
+   }
+
    LookupData ld(key, def);
    readEntry(ld);
    if(found)
       *found = ld.GetFound();
 
+   if ( useCache )
+   {
+      ProfileCachedValue& value = m_cacheLongs[key];
+      value.found = ld.GetFound();
+      value.num = ld.GetLong();
+      value.expanded = false;
+   }
+
    return ld.GetLong();
 }
 
@@ -1013,6 +1170,8 @@ ProfileImpl::Commit(void)
 
    ASSERT_MSG( m_Suspended, _T("calling Commit() without matching Suspend()") );
 
+   InvalidateCache();
+
    if ( m_Suspended > 1 )
    {
       // don't commit yet, we remain suspended
@@ -1046,6 +1205,8 @@ ProfileImpl::Discard(void)
 
    CHECK_RET( m_Suspended, _T("calling Discard() without matching Suspend()") );
 
+   InvalidateCache();
+
    if ( !--m_Suspended )
    {
       if ( m_wroteSuspended )
@@ -31,6 +31,8 @@
 #include "UIdArray.h"
 #include "Sequence.h"
 
+#include <algorithm>
+
 // ============================================================================
 // Sequence implementation
 // ============================================================================
@@ -46,10 +48,14 @@ Sequence::Sequence()
 
 void Sequence::Clear()
 {
+   m_ranges.clear();
+
    m_count = 0;
 
-   m_first =
-   m_last = UID_ILLEGAL;
+   m_min =
+   m_max = 0;
+
+   m_isNormalized = true;
 
    m_seq.clear();
 }
@@ -58,93 +64,58 @@ void Sequence::Clear()
 // building/retrieving the sequence
 // ----------------------------------------------------------------------------
 
-void Sequence::Flush() const
+void Sequence::DoAddRange(UIdType from, UIdType to)
 {
-   if ( HasCurrentRange() )
-   {
-      Sequence *self = (Sequence *)this;
-
-      self->DoFlush();
+   m_count += to - from + 1;
 
-      self->m_first =
-      self->m_last = UID_ILLEGAL;
+   if ( m_ranges.empty() )
+   {
+      m_min = from;
+      m_max = to;
    }
-}
-
-bool Sequence::DoFlush()
-{
-   if ( m_seq.empty() )
-      return false;
-
-   // flush the old one
-   switch ( m_last - m_first )
+   else
    {
-      case 0:
-         // single msg, already in m_seq
-         break;
-
-      case 1:
-         // 2 messages, still don't generate a range for this
-         ((Sequence *)this)->m_seq << ',' << m_last;
-         break;
-
-      default:
-         // real range
-         ((Sequence *)this)->m_seq << ':' << m_last;
+      if ( from < m_min )
+         m_min = from;
+      if ( to > m_max )
+         m_max = to;
    }
 
-   return true;
-}
-
-void Sequence::Add(UIdType n)
-{
-   m_count++;
+   m_seq.clear();
 
    // can we continue the current range?
-   if ( HasCurrentRange() && n == m_last + 1 )
+   if ( !m_ranges.empty() )
    {
-      // continue it
-      m_last++;
-   }
-   else // start a new one
-   {
-      if ( DoFlush() )
+      Range& last = m_ranges.back();
+      if ( from == last.last + 1 )
       {
-         m_seq << ',';
+         // continue it
+         last.last = to;
+         return;
       }
 
-      m_seq << n;
-
-      m_first =
-      m_last = n;
+      if ( from <= last.last + 1 )
+         m_isNormalized = false;
    }
+
+   // start a new one
+   m_ranges.push_back(Range(from, to));
+}
+
+void Sequence::Add(UIdType n)
+{
+   DoAddRange(n, n);
 }
 
 void Sequence::AddRange(UIdType from, UIdType to)
 {
    CHECK_RET( from <= to, _T("invalid range in Sequence::AddRange") );
 
-   Add(from);
-   switch ( to - from )
-   {
-      case 0:
-         break;
-
-      case 1:
-         Add(to);
-         break;
-
-      default:
-         // don't do this - Flush() will do it later
-         //m_seq << ':' << to;
-         m_count += to - from;
-         m_last = to;
-   }
+   DoAddRange(from, to);
 }
 
 void Sequence::AddArray(const UIdArray& array)
 {
-   // TODO: this surely can be optimized
    size_t count = array.GetCount();
    for ( size_t n = 0; n < count; n++ )
    {
@@ -154,7 +125,34 @@ void Sequence::AddArray(const UIdArray& array)
 
 String Sequence::GetString() const
 {
-   Flush();
+   if ( m_seq.empty() && !m_ranges.empty() )
+   {
+      for ( Ranges::const_iterator i = m_ranges.begin();
+            i != m_ranges.end();
+            ++i )
+      {
+         if ( i != m_ranges.begin() )
+            m_seq << ',';
+
+         m_seq << i->first;
+
+         switch ( i->last - i->first )
+         {
+            case 0:
+               // single msg, already in m_seq
+               break;
+
+            case 1:
+               // 2 messages, still don't generate a range for this
+               m_seq << ',' << i->last;
+               break;
+
+            default:
+               // real range
+               m_seq << ':' << i->last;
+         }
+      }
+   }
 
    return m_seq;
 }
@@ -165,9 +163,6 @@ String Sequence::GetString() const
 
 Sequence Sequence::Apply(UIdType (*map)(UIdType uid)) const
 {
-   Flush();
-
-   // TODO: this is awfully inefficient, we should modify the string directly
    Sequence seqCopy;
 
    size_t n;
@@ -176,92 +171,171 @@ Sequence Sequence::Apply(UIdType (*map)(UIdType uid)) const
       seqCopy.Add(map(i));
    }
 
-   seqCopy.Flush();
-
    return seqCopy;
 }
 
 void Sequence::GetBounds(UIdType *nMin, UIdType *nMax) const
 {
    if ( nMin )
-      *nMin = 0;
+      *nMin = m_min;
 
    if ( nMax )
-      *nMax = 0;
-
-   size_t n;
-   for ( UIdType i = GetFirst(n); i != UID_ILLEGAL; i = GetNext(i, n) )
-   {
-      if ( nMin && i < *nMin )
-         *nMin = i;
-
-      if ( nMax && i > *nMax )
-         *nMax = i;
-   }
+      *nMax = m_max;
 }
 
 // ----------------------------------------------------------------------------
-// Sequence enumeration
+// set operations
 // ----------------------------------------------------------------------------
 
-UIdType Sequence::GetNumberAt(size_t& pos) const
+Sequence::Ranges Sequence::GetNormalizedRanges() const
+{
+   if ( m_isNormalized || m_ranges.empty() )
+      return m_ranges;
+
+   Ranges ranges(m_ranges);
+   std::sort(ranges.begin(), ranges.end());
+
+   // merge the overlapping and adjacent ranges
+   Ranges::iterator dst = ranges.begin();
+   for ( Ranges::const_iterator src = ranges.begin() + 1;
+         src != ranges.end();
+         ++src )
+   {
+      if ( src->first <= dst->last + 1 )
+      {
+         if ( src->last > dst->last )
+            dst->last = src->last;
+      }
+      else
+      {
+         *++dst = *src;
+      }
+   }
+
+   ranges.erase(dst + 1, ranges.end());
+
+   return ranges;
+}
+
+/* static */
+Sequence Sequence::FromNormalizedRanges(const Ranges& ranges)
 {
-   UIdType n = 0;
-   while ( isdigit(GetCharAt(pos)) )
+   Sequence seq;
+   for ( Ranges::const_iterator i = ranges.begin(); i != ranges.end(); ++i )
    {
-      n *= 10;
-      n += m_seq[pos++] - '0';
+      seq.DoAddRange(i->first, i->last);
    }
 
-   return n;
+   return seq;
 }
 
-UIdType Sequence::GetFirst(size_t& cookie) const
+Sequence Sequence::Union(const Sequence& other) const
 {
-   Flush();
+   const Ranges r1 = GetNormalizedRanges(),
+                r2 = other.GetNormalizedRanges();
 
-   cookie = 0;
+   // merge the two sorted vectors of ranges and normalize the result
+   Sequence seq;
+   seq.m_ranges.resize(r1.size() + r2.size(), Range(0, 0));
+   std::merge(r1.begin(), r1.end(), r2.begin(), r2.end(),
+              seq.m_ranges.begin());
+   seq.m_isNormalized = false;
 
-   return GetNext(UID_ILLEGAL /* doesn't matter what we pass */, cookie);
+   return FromNormalizedRanges(seq.GetNormalizedRanges());
 }
 
-UIdType Sequence::GetNext(UIdType n, size_t& cookie) const
+Sequence Sequence::Intersection(const Sequence& other) const
 {
-   switch ( GetCharAt(cookie) )
+   const Ranges r1 = GetNormalizedRanges(),
+                r2 = other.GetNormalizedRanges();
+
+   Ranges ranges;
+
+   Ranges::const_iterator i1 = r1.begin(),
+                          i2 = r2.begin();
+   while ( i1 != r1.end() && i2 != r2.end() )
    {
-      case ':':
-         // we're inside a range, check if we didn't exhaust it
-         {
-            size_t pos = cookie + 1;
-            UIdType last = GetNumberAt(pos);
-            if ( n < last )
-               return n + 1;
+      const UIdType first = wxMax(i1->first, i2->first),
+                    last = wxMin(i1->last, i2->last);
+      if ( first <= last )
+         ranges.push_back(Range(first, last));
+
+      // advance the range which ends first, it can't intersect anything else
+      if ( i1->last < i2->last )
+         ++i1;
+      else
+         ++i2;
+   }
 
-            // done with this range, continue with the rest
-            cookie = pos;
-         }
+   return FromNormalizedRanges(ranges);
+}
 
-         if ( GetCharAt(cookie) != '\0' )
-         {
-            // nothing else can follow the end of the range
-            ASSERT_MSG( GetCharAt(cookie) == ',', "bad sequence string format" );
+Sequence Sequence::Difference(const Sequence& other) const
+{
+   const Ranges r1 = GetNormalizedRanges(),
+                r2 = other.GetNormalizedRanges();
+
+   Ranges ranges;
 
-            cookie++;
+   Ranges::const_iterator i2 = r2.begin();
+   for ( Ranges::const_iterator i1 = r1.begin(); i1 != r1.end(); ++i1 )
+   {
+      UIdType first = i1->first;
+
+      // skip the ranges entirely before this one
+      while ( i2 != r2.end() && i2->last < first )
+         ++i2;
+
+      // and cut out all ranges overlapping it
+      for ( Ranges::const_iterator i = i2;
+            i != r2.end() && i->first <= i1->last;
+            ++i )
+      {
+         if ( i->first > first )
+            ranges.push_back(Range(first, i->first - 1));
 
+         if ( i->last >= i1->last )
+         {
+            // nothing left of this range
+            first = UID_ILLEGAL;
             break;
          }
-         //else: fall through
 
-      case '\0':
-         return UID_ILLEGAL;
+         first = i->last + 1;
+      }
 
-      case ',':
-         // skip comma and go to the next number
-         cookie++;
-         break;
+      if ( first != UID_ILLEGAL )
+         ranges.push_back(Range(first, i1->last));
    }
 
-   return GetNumberAt(cookie);
+   return FromNormalizedRanges(ranges);
+}
+
+// ----------------------------------------------------------------------------
+// Sequence enumeration
+// ----------------------------------------------------------------------------
+
+UIdType Sequence::GetFirst(size_t& cookie) const
+{
+   cookie = 0;
+
+   return m_ranges.empty() ? UID_ILLEGAL : m_ranges[0].first;
+}
+
+UIdType Sequence::GetNext(UIdType n, size_t& cookie) const
+{
+   if ( cookie >= m_ranges.size() )
+      return UID_ILLEGAL;
+
+   // we're inside a range, check if we didn't exhaust it
+   if ( n < m_ranges[cookie].last )
+      return n + 1;
+
+   // done with this range, continue with the next one
+   if ( ++cookie == m_ranges.size() )
+      return UID_ILLEGAL;
+
+   return m_ranges[cookie].first;
 }
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   gui/FolderListCache.cpp
+// Purpose:     implementation of FolderListCache class
+// Author:      Mahogany team
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+#endif // USE_PCH
+
+#include "gui/FolderListCache.h"
+
+// ============================================================================
+// FolderListCache implementation
+// ============================================================================
+
+FolderListCache::FolderListCache(size_t maxRows)
+               : m_maxRows(maxRows)
+{
+   m_topLast = -1;
+   m_scrollDelta = 0;
+}
+
+// ----------------------------------------------------------------------------
+// accessing the rows
+// ----------------------------------------------------------------------------
+
+const FolderListRow *FolderListCache::Get(UIdType uid) const
+{
+   FolderListRowsMap::const_iterator i = m_rows.find(uid);
+
+   return i == m_rows.end() ? NULL : &i->second;
+}
+
+FolderListRow& FolderListCache::Add(UIdType uid)
+{
+   // we could use some LRU scheme here but the rows are cheap to recreate
+   // and the cache normally only needs to hold a few pages of them anyhow,
+   // so just start anew if it grew too big (which happens if the user
+   // scrolled through a huge folder)
+   if ( m_rows.size() >= m_maxRows )
+      Clear();
+
+   FolderListRow& row = m_rows[uid];
+   row.cells.Empty();
+   row.colour = wxColour();
+
+   return row;
+}
+
+void FolderListCache::Invalidate(UIdType uid)
+{
+   m_rows.erase(uid);
+}
+
+void FolderListCache::Clear()
+{
+   m_rows.clear();
+
+   // prefill the rows around the current position again during the next
+   // idle time
+   m_topLast = -1;
+}
+
+// ----------------------------------------------------------------------------
+// prefilling
+// ----------------------------------------------------------------------------
+
+bool FolderListCache::GetPrefillRange(long top, long countPerPage, long count,
+                                      long *from, long *to)
+{
+   CHECK( from && to, false, _T("NULL pointer in GetPrefillRange") );
+
+   if ( top == m_topLast || countPerPage <= 0 )
+      return false;
+
+   // assume that we're going to be scrolled by the same amount as the last
+   // time (or by a page down if we don't know it) and prepare the rows which
+   // will become visible then
+   if ( m_topLast != -1 )
+      m_scrollDelta = top - m_topLast;
+   else if ( !m_scrollDelta )
+      m_scrollDelta = countPerPage;
+
+   m_topLast = top;
+
+   const long topNext = top + m_scrollDelta;
+   if ( m_scrollDelta < 0 )
+   {
+      *from = wxMax(topNext, 0L);
+      *to = wxMin(top, topNext + countPerPage);
+   }
+   else
+   {
+      *from = wxMax(top + countPerPage, topNext);
+      *to = wxMin(topNext + countPerPage, count);
+   }
+
+   return *from < *to;
+}
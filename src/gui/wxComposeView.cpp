@@ -87,6 +87,7 @@
 #include "adb/AdbManager.h"
 
 #include "mail/Header.h"
+#include "mail/MailThreadPool.h"
 #include "mail/MimeDecode.h"
 
 #include "ConfigSourcesAll.h"
@@ -100,6 +101,7 @@
 #include "Collect.h"
 #include "ColourNames.h"
 #include "QuotedText.h"
+#include "DraftJournal.h"
 
 #include "modules/Calendar.h"
 
@@ -413,8 +415,15 @@ protected:
    virtual void *Entry()
    {
       SendThreadResult res;
-      if ( !m_msg.SendNow(&res.errGeneral, &res.errDetailed) )
-         res.success = false;
+
+      {
+         // sending uses c-client which can't be used concurrently with the
+         // other threads, see MailLock
+         MailLocker lock;
+
+         if ( !m_msg.SendNow(&res.errGeneral, &res.errDetailed) )
+            res.success = false;
+      }
 
       wxThreadEvent evt;
       evt.SetId(SendThread_Done);
@@ -2046,6 +2055,7 @@ wxComposeView::wxComposeView(const String &name,
    m_customTemplate = false;
    m_OriginalMessage = NULL;
    m_DraftMessage = NULL;
+   m_journal = NULL;
 
    m_msgBeingSent = NULL;
 
@@ -2152,15 +2162,19 @@ wxComposeView::~wxComposeView()
       }
    }
 
-   // clean up the autosave file: if m_filenameAutoSave is set we must have it,
-   // otherwise AutoSave() wouldn't have initialized it
-   if ( !m_filenameAutoSave.empty() )
+   // clean up the autosave journal: it is only needed if we crash
+   if ( m_journal )
    {
-      if ( !wxRemoveFile(m_filenameAutoSave) )
-      {
-         wxLogSysError(_("Failed to remove stale composer autosave file '%s'"),
-                       m_filenameAutoSave);
-      }
+      m_journal->Remove();
+
+      delete m_journal;
+   }
+
+   for ( DraftDataHashes::iterator i = m_draftDataHashes.begin();
+         i != m_draftDataHashes.end();
+         ++i )
+   {
+      i->first->DecRef();
    }
 }
 
@@ -5739,6 +5753,18 @@ SendMessage *wxComposeView::BuildDraftMessage(int flags) const
    msg->AddHeaderEntry(HEADER_IS_DRAFT, _T("Yes"));
 
    // save the composer geometry info
+   msg->AddHeaderEntry(HEADER_GEOMETRY, GetGeometryHeader());
+
+   // also save the Fcc header contents because it's not a "real" header
+   const String& fcc = GetRecipients(Recipient_Fcc);
+   if ( !fcc.empty() )
+      msg->AddHeaderEntry(_T("FCC"), fcc);
+
+   return msg.release();
+}
+
+String wxComposeView::GetGeometryHeader() const
+{
    String value;
    wxFrame *frame = ((wxComposeView *)this)->GetFrame();
    if ( frame->IsIconized() )
@@ -5758,14 +5784,7 @@ SendMessage *wxComposeView::BuildDraftMessage(int flags) const
       value.Printf(GEOMETRY_FORMAT, x, y, w, h);
    }
 
-   msg->AddHeaderEntry(HEADER_GEOMETRY, value);
-
-   // also save the Fcc header contents because it's not a "real" header
-   const String& fcc = GetRecipients(Recipient_Fcc);
-   if ( !fcc.empty() )
-      msg->AddHeaderEntry(_T("FCC"), fcc);
-
-   return msg.release();
+   return value;
 }
 
 // from upgrade.cpp, this forward decl will disappear once we move it somewhere
@@ -5895,12 +5914,7 @@ wxComposeView::AutoSave()
       return true;
    }
 
-   SendMessage_obj msg(BuildDraftMessage(NonInteractive));
-   if ( !msg )
-      return false;
-
-   String fname = m_filenameAutoSave;  // reuse the last file name
-   if ( fname.empty() )                // but initialize if it's the first time
+   if ( !m_journal )
    {
       // make sure the directory we use for these scratch files exists
       String name = GetComposerAutosaveDir();
@@ -5925,38 +5939,29 @@ wxComposeView::AutoSave()
       // we need a unique file name during the life time of this object as this
       // file is always going to be deleted if we're destroyed correctly, it
       // can only be left if the program crashes
-      fname = name + String::Format(_T("%05d%p"), (int)getpid(), this);
+      m_journal = new DraftJournal(name +
+                                   String::Format(_T("%05d%p"),
+                                                  (int)getpid(), this) +
+                                   DraftJournal::GetExtension());
    }
 
-   String contents;
-   if ( !msg->WriteToString(contents) )
-   {
-      // this is completely unexpected
-      FAIL_MSG( _T("Failed to get the message text?") );
-
-      return false;
-   }
+   // only the changes since the last time are really written to the journal
+   // so, unlike with writing the entire message as we used to do, the cost
+   // of this doesn't depend on the size of the attachments
+   DraftContents contents;
+   GetDraftContents(contents);
 
-   if ( !MailFolder::SaveMessageAsMBOX(fname, contents) )
+   if ( !m_journal->Update(contents) )
    {
       // don't make this a wxLogError() as it would result in a message box
       // which is a wrong thing to do for a background operation
       wxLogStatus(_("Failed to automatically save the message."));
 
-      // if we did manage to create the file, leave it even if saving failed,
-      // it might still contain something useful for recovery
-      if ( wxFileName::FileExists(fname) )
-         m_filenameAutoSave = fname;
-
+      // the journal is left even if saving failed, it might still contain
+      // something useful for recovery
       return false;
    }
 
-   if ( m_filenameAutoSave.empty() )
-   {
-      // remember the file name for the subsequent calls of this function
-      m_filenameAutoSave = fname;
-   }
-
    // mark the editor as not modified to avoid resaving it the next time
    // unnecessary but remember internally that it was modified (we didn't
    // really save it)
@@ -5966,6 +5971,166 @@ wxComposeView::AutoSave()
    return true;
 }
 
+void wxComposeView::GetDraftContents(DraftContents& contents)
+{
+   // the hashes of the data parts still present
+   DraftDataHashes dataHashes;
+
+   // the parts: notice that we can't stop iterating over them before the end
+   for ( EditorContentPart *part = m_editor->GetFirstPart();
+         part;
+         part = m_editor->GetNextPart() )
+   {
+      DraftContents::Part partDraft;
+
+      switch ( part->GetType() )
+      {
+         case EditorContentPart::Type_Text:
+            partDraft.type = DraftContents::Part::Text;
+            partDraft.text = part->GetText();
+            partDraft.encoding = part->GetEncoding();
+            break;
+
+         case EditorContentPart::Type_File:
+            partDraft.type = DraftContents::Part::File;
+            partDraft.filename = part->GetFileName();
+            partDraft.name = part->GetName();
+            if ( partDraft.name.empty() )
+               partDraft.name = wxFileNameFromPath(partDraft.filename);
+
+            // the file may have been removed since it was attached, we still
+            // save the part without contents then and BuildMessage() will
+            // complain about it when the message is sent
+            partDraft.hash = m_journal->AddFile(partDraft.filename);
+            break;
+
+         case EditorContentPart::Type_Data:
+            partDraft.type = DraftContents::Part::Data;
+            partDraft.filename = part->GetFileName();
+            partDraft.name = part->GetName();
+            {
+               // the data of the part never changes, so we only need to hash
+               // it when the part is saved for the first time
+               DraftDataHashes::iterator i = m_draftDataHashes.find(part);
+               if ( i != m_draftDataHashes.end() &&
+                     m_journal->ReuseData(i->second) )
+               {
+                  partDraft.hash = i->second;
+               }
+               else
+               {
+                  partDraft.hash = m_journal->AddData(part->GetData(),
+                                                      part->GetSize());
+               }
+
+               if ( i != m_draftDataHashes.end() )
+               {
+                  // transfer the reference we hold to the new map
+                  m_draftDataHashes.erase(i);
+               }
+               else
+               {
+                  part->IncRef();
+               }
+
+               dataHashes[part] = partDraft.hash;
+            }
+            break;
+
+         default:
+            FAIL_MSG( _T("Unknown editor content part type!") );
+
+            part->DecRef();
+            continue;
+      }
+
+      if ( partDraft.type != DraftContents::Part::Text )
+      {
+         partDraft.mimeType = part->GetMimeType().GetFull();
+         partDraft.disposition = part->GetDisposition();
+      }
+
+      contents.parts.push_back(partDraft);
+
+      part->DecRef();
+   }
+
+   // forget the data parts which were removed since the last time
+   for ( DraftDataHashes::iterator i = m_draftDataHashes.begin();
+         i != m_draftDataHashes.end();
+         ++i )
+   {
+      i->first->DecRef();
+   }
+
+   m_draftDataHashes.swap(dataHashes);
+
+   // the headers: the same ones BuildDraftMessage() would add
+   contents.encoding = m_encoding;
+
+   wxArrayString& names = contents.headerNames;
+   wxArrayString& values = contents.headerValues;
+
+   names.push_back(_T("Subject"));
+   values.push_back(GetSubject());
+
+   const String from = GetFrom();
+   if ( !from.empty() )
+   {
+      names.push_back(_T("From"));
+      values.push_back(from);
+   }
+
+   static const struct
+   {
+      RecipientType type;
+      const wxChar *name;
+   } rcptHeaders[] =
+   {
+      { Recipient_To,         _T("To")         },
+      { Recipient_Cc,         _T("CC")         },
+      { Recipient_Bcc,        _T("BCC")        },
+      { Recipient_Newsgroup,  _T("Newsgroups") },
+      { Recipient_Fcc,        _T("FCC")        },
+   };
+
+   for ( size_t n = 0; n < WXSIZEOF(rcptHeaders); n++ )
+   {
+      const String rcpts = GetRecipients(rcptHeaders[n].type);
+      if ( !rcpts.empty() )
+      {
+         names.push_back(rcptHeaders[n].name);
+         values.push_back(rcpts);
+      }
+   }
+
+   StringList::const_iterator i = m_extraHeadersNames.begin();
+   StringList::const_iterator j = m_extraHeadersValues.begin();
+   for ( ; i != m_extraHeadersNames.end(); ++i, ++j )
+   {
+      names.push_back(*i);
+      values.push_back(*j);
+   }
+
+   wxArrayString headerNames, headerValues;
+   size_t nHeaders = GetCustomHeaders(m_Profile,
+                                      m_mode == Mode_Mail ? CustomHeader_Mail
+                                                          : CustomHeader_News,
+                                      &headerNames,
+                                      &headerValues);
+   for ( size_t nHeader = 0; nHeader < nHeaders; nHeader++ )
+   {
+      names.push_back(headerNames[nHeader]);
+      values.push_back(headerValues[nHeader]);
+   }
+
+   names.push_back(HEADER_IS_DRAFT);
+   values.push_back(_T("Yes"));
+
+   names.push_back(HEADER_GEOMETRY);
+   values.push_back(GetGeometryHeader());
+}
+
 int Composer::SaveAll()
 {
    int rc = 0;
@@ -5982,6 +6147,128 @@ int Composer::SaveAll()
    return rc;
 }
 
+/**
+  Converts the draft journal left by a crashed composer to the MBOX file which
+  can be restored as any other message.
+
+  @param filename the journal file name
+  @param filenameMBOX the file to save the message to
+  @return true if the message was saved, false on error
+ */
+static bool ConvertDraftJournal(const String& filename,
+                                const String& filenameMBOX)
+{
+   DraftContents contents;
+   if ( !DraftJournal::Load(filename, contents) )
+      return false;
+
+   const wxArrayString& names = contents.headerNames;
+   const wxArrayString& values = contents.headerValues;
+
+   const bool isNews = names.Index(_T("Newsgroups"), false) != wxNOT_FOUND;
+   SendMessage_obj msg(SendMessage::Create(mApplication->GetProfile(),
+                                           isNews ? Prot_NNTP : Prot_Default));
+   if ( !msg )
+      return false;
+
+   // the parts
+   const size_t countParts = contents.parts.size();
+   for ( size_t n = 0; n < countParts; n++ )
+   {
+      const DraftContents::Part& part = contents.parts[n];
+      if ( part.type == DraftContents::Part::Text )
+      {
+         wxFontEncoding enc = (wxFontEncoding)part.encoding;
+         wxCharBuffer textBuf = part.text.mb_str(wxCSConv(enc));
+         if ( !textBuf.length() && !part.text.empty() )
+         {
+            enc = wxFONTENCODING_UTF8;
+            textBuf = part.text.utf8_str();
+         }
+
+         msg->AddPart(MimeType::TEXT, textBuf, textBuf.length(),
+                      _T("PLAIN"), _T("INLINE"), NULL, NULL, enc);
+         continue;
+      }
+
+      wxMemoryBuffer data;
+      if ( !DraftJournal::ReadData(filename, part.hash, data) )
+      {
+         wxLogWarning(_("The contents of the attachment \"%s\" of the "
+                        "interrupted message was lost."), part.name);
+         continue;
+      }
+
+      // use the same parameters as BuildMessage() does
+      MessageParameterList plist, dlist;
+      if ( part.type == DraftContents::Part::File )
+      {
+         dlist.push_back(new MessageParameter(_T("FILENAME"), part.name));
+         plist.push_back(new MessageParameter(_T("NAME"), part.name));
+      }
+      else // Data
+      {
+         if ( !part.name.empty() )
+         {
+            dlist.push_back(new MessageParameter(_T("FILENAME"),
+                                                 wxFileNameFromPath(part.name)));
+         }
+
+         if ( !part.filename.empty() )
+            plist.push_back(new MessageParameter(_T("NAME"), part.filename));
+      }
+
+      const MimeType mt(part.mimeType);
+      msg->AddPart
+           (
+            mt.GetPrimary(),
+            data.GetData(), data.GetDataLen(),
+            mt.GetSubType(),
+            part.disposition,
+            &dlist,
+            &plist
+           );
+   }
+
+   // and the headers
+   if ( contents.encoding != wxFONTENCODING_DEFAULT )
+      msg->SetHeaderEncoding((wxFontEncoding)contents.encoding);
+
+   String rcptTo, rcptCC, rcptBCC;
+   const size_t countHeaders = names.size();
+   for ( size_t n = 0; n < countHeaders; n++ )
+   {
+      const String& name = names[n];
+      if ( name == _T("Subject") )
+         msg->SetSubject(values[n]);
+      else if ( name == _T("From") )
+         msg->SetFrom(values[n]);
+      else if ( name == _T("To") )
+         rcptTo = values[n];
+      else if ( name == _T("CC") )
+         rcptCC = values[n];
+      else if ( name == _T("BCC") )
+         rcptBCC = values[n];
+      else if ( name == _T("Newsgroups") )
+         msg->SetNewsgroups(values[n]);
+      else
+         msg->AddHeaderEntry(name, values[n]);
+   }
+
+   msg->SetAddresses(rcptTo, rcptCC, rcptBCC);
+
+   String text;
+   if ( !msg->WriteToString(text) )
+      return false;
+
+   if ( !MailFolder::SaveMessageAsMBOX(filenameMBOX, text) )
+      return false;
+
+   DraftJournal::Remove(filename);
+
+   return true;
+}
+
 bool Composer::RestoreAll()
 {
    String name = GetComposerAutosaveDir();
@@ -5999,12 +6286,46 @@ bool Composer::RestoreAll()
       return false;
    }
 
-   int nResumed = 0;
+   // first convert the draft journals to the messages: notice that we can't
+   // do it while enumerating the directory as this creates new files in it
+   const String extJournal = DraftJournal::GetExtension();
 
+   wxArrayString journals;
    wxString filename;
-   bool cont = dir.GetFirst(&filename, wxEmptyString, wxDIR_FILES);
+   bool cont = dir.GetFirst(&filename, _T("*") + extJournal, wxDIR_FILES);
+   while ( cont )
+   {
+      journals.push_back(name + filename);
+
+      cont = dir.GetNext(&filename);
+   }
+
+   const size_t countJournals = journals.size();
+   for ( size_t n = 0; n < countJournals; n++ )
+   {
+      const String& journal = journals[n];
+      if ( !ConvertDraftJournal(journal,
+                                journal.substr(0, journal.length() -
+                                                     extJournal.length())) )
+      {
+         wxLogError(_("Failed to resume composing the message from file '%s'"),
+                    journal);
+      }
+   }
+
+   int nResumed = 0;
+
+   cont = dir.GetFirst(&filename, wxEmptyString, wxDIR_FILES);
    while ( cont )
    {
+      // skip the journals which we failed to convert above and the temporary
+      // files used by them
+      if ( filename.find(extJournal) != String::npos )
+      {
+         cont = dir.GetNext(&filename);
+         continue;
+      }
+
       filename = name + filename;
 
       MFolder_obj folder(MFolder::CreateTempFile
@@ -86,6 +86,7 @@
 #include "gui/wxMenuDefs.h"
 #include "gui/wxFolderView.h"
 #include "gui/wxFolderMenu.h"
+#include "gui/FolderListCache.h"
 #include "gui/wxFiltersDialog.h" // for ConfigureFiltersForFolder()
 #include "MFolderDialogs.h"      // for ShowFolderPropertiesDialog
 
@@ -465,6 +466,9 @@ public:
    /// invalidate the cached header(s)
    void InvalidateCache();
 
+   /// forget the cached text of this item, e.g. because its status changed
+   void InvalidateRow(long item);
+
    //@}
 
    /**
@@ -655,6 +659,17 @@ protected:
    /// get the colour to use for this entry (depends on status)
    wxColour GetEntryColour(const HeaderInfo *hi) const;
 
+   /// get the text to show in the given column for this (valid) header
+   wxString FormatCell(long item,
+                       const HeaderInfo *hi,
+                       wxFolderListColumn field) const;
+
+   /// get the cached row for this header, formatting it if necessary
+   const FolderListRow *GetRow(long item, const HeaderInfo *hi) const;
+
+   /// format the rows which will be shown if we continue scrolling
+   void PrefillRows();
+
    /// return information about the list ctrl items on demand
    virtual wxString OnGetItemText(long item, long column) const;
    virtual int OnGetItemImage(long item) const;
@@ -713,6 +728,9 @@ protected:
    /// the positions of the headers we need to get
    wxArrayInt m_headersToGet;
 
+   /// the already formatted rows, cleared together with the cached header
+   mutable FolderListCache m_rowCache;
+
    //@}
 
    // TODO: we should have the standard attributes for each of the possible
@@ -1634,6 +1652,9 @@ void wxFolderListCtrl::ApplyOptions(const wxColour &fg, const wxColour &bg,
 
    UpdateSortIndicator();
    UpdateThreadIndicator();
+
+   // the colours or the text formatting options could have changed
+   m_rowCache.Clear();
 }
 
 // ----------------------------------------------------------------------------
@@ -2378,6 +2399,34 @@ void wxFolderListCtrl::InvalidateCache()
    m_hiCached = NULL;
 
    m_headersToGet.Empty();
+
+   // the positions of the messages could have changed, so the rows cached by
+   // UID may be wrong now (even if only the message number column really is)
+   m_rowCache.Clear();
+}
+
+void wxFolderListCtrl::InvalidateRow(long item)
+{
+   if ( !m_headers || (size_t)item >= GetHeadersCount() )
+      return;
+
+   if ( m_mutexHeaders.IsLocked() )
+   {
+      // we can't find the UID of this item while the headers are being
+      // retrieved, but we can't leave its row in the cache neither as it
+      // would be never updated then, so just forget all of them: this is
+      // rare enough to not matter and the rows are cheap to format again
+      m_rowCache.Clear();
+      return;
+   }
+
+   // if the header is not in cache, we can't have formatted its row neither
+   if ( !m_headers->IsInCache(item) )
+      return;
+
+   const UIdType uid = GetUIdFromIndex(item);
+   if ( uid != UID_ILLEGAL )
+      m_rowCache.Invalidate(uid);
 }
 
 void wxFolderListCtrl::SetListing(HeaderInfoList *listing)
@@ -2594,6 +2643,9 @@ void wxFolderListCtrl::OnIdle(wxIdleEvent& event)
             RefreshItems(posMin, posMax);
          });
       }
+
+      // prepare the rows which are going to be shown next if we're scrolled
+      PrefillRows();
    }
 
    // update the message in the status bar
@@ -2606,6 +2658,35 @@ void wxFolderListCtrl::OnIdle(wxIdleEvent& event)
    UpdateFocus();
 }
 
+void wxFolderListCtrl::PrefillRows()
+{
+   if ( !m_headers || m_mutexHeaders.IsLocked() )
+      return;
+
+   long from, to;
+   if ( !m_rowCache.GetPrefillRange(GetTopItem(), GetCountPerPage(),
+                                    (long)GetHeadersCount(), &from, &to) )
+      return;
+
+   for ( long item = from; item < to; item++ )
+   {
+      // don't retrieve the headers from here, this is done on demand only,
+      // just format the rows for those we already have
+      if ( !m_headers->IsInCache(item) )
+         continue;
+
+      const HeaderInfo *hi = GetHeaderInfo(item);
+      if ( !hi )
+      {
+         // the listing must have changed
+         break;
+      }
+
+      if ( hi->IsValid() )
+         GetRow(item, hi);
+   }
+}
+
 // ----------------------------------------------------------------------------
 // wxFolderListCtrl column width stuff
 // ----------------------------------------------------------------------------
@@ -3024,6 +3105,48 @@ wxString wxFolderListCtrl::OnGetItemText(long item, long column) const
       return text;
    }
 
+   if ( field == WXFLC_NONE )
+   {
+      wxFAIL_MSG( _T("unknown column") );
+
+      return text;
+   }
+
+   return GetRow(item, hi)->cells[field];
+}
+
+const FolderListRow *
+wxFolderListCtrl::GetRow(long item, const HeaderInfo *hi) const
+{
+   const FolderListRow *row = m_rowCache.Get(hi->GetUId());
+   if ( !row )
+   {
+      FolderListRow& rowNew = m_rowCache.Add(hi->GetUId());
+
+      // format all the shown columns at once as we're going to be asked for
+      // all of them anyhow when this row is painted
+      rowNew.cells.Alloc(WXFLC_NUMENTRIES);
+      for ( size_t n = 0; n < WXFLC_NUMENTRIES; n++ )
+      {
+         const wxFolderListColumn field = (wxFolderListColumn)n;
+         rowNew.cells.Add(m_columns[field] < 0 ? wxString()
+                                               : FormatCell(item, hi, field));
+      }
+
+      rowNew.colour = GetEntryColour(hi);
+
+      row = &rowNew;
+   }
+
+   return row;
+}
+
+wxString wxFolderListCtrl::FormatCell(long item,
+                                      const HeaderInfo *hi,
+                                      wxFolderListColumn field) const
+{
+   wxString text;
+
    switch ( field )
    {
       case WXFLC_STATUS:
@@ -3207,9 +3330,9 @@ wxListItemAttr *wxFolderListCtrl::OnGetItemAttr(long item) const
       wxConstCast(this, wxFolderListCtrl)->m_attr = new wxListItemAttr;
    }
 
-   // GetEntryColour() may return invalid colour, but that's ok, it will just
-   // reset the colour to default
-   m_attr->SetTextColour(GetEntryColour(hi));
+   // the colour may be invalid, but that's ok, it will just reset the colour
+   // to default
+   m_attr->SetTextColour(GetRow(item, hi)->colour);
 
 #if !wxUSE_UNICODE
    // cache the last used encoding as creating new font is an expensive
@@ -5205,6 +5328,9 @@ wxFolderView::OnMsgStatusEvent(MEventMsgStatusData& event)
             //else: will need to recalculate the number of deleted msgs later
          }
 
+         // the status and colour of this item must be formatted again
+         m_FolderCtrl->InvalidateRow(pos);
+
          // remember the items to update
          if ( pos < posMin )
             posMin = pos;
@@ -5306,6 +5432,12 @@ wxFolderView::OnASFolderResultEvent(MEventASFolderResultData &event)
                      FAIL_MSG( _T("search succeeded but no search results?") );
                   }
                }
+               else if ( !result->GetSequence() ) // cancelled or failed
+               {
+                  wxLogStatus(m_Frame,
+                              _("Search for \"%s\" was not completed."),
+                              m_searchData.str);
+               }
                else // nothing found
                {
                   wxLogStatus(m_Frame,
@@ -90,6 +90,9 @@
 #include "Composer.h"       // for SaveAll()
 
 #include "MFCache.h"
+#include "mail/SearchIndex.h"
+#include "mail/Dnsbl.h"
+#include "mail/MailThreadPool.h"
 
 #include "CmdLineOpts.h"
 
@@ -179,6 +182,10 @@ static int SaveAll()
    rc &= Profile::FlushAll();
 
    MfStatusCache::Flush();
+   MsgSearchIndex::Flush();
+#ifdef USE_RBL
+   DnsblChecker::Flush();
+#endif // USE_RBL
 
    return rc;
 }
@@ -231,6 +238,9 @@ public:
 
    virtual void Notify()
    {
+      // timer notifications don't go through HandleEvent()
+      MailLocker lock;
+
       if ( !mApplication->AllowBgProcessing() )
          return;
 
@@ -282,6 +292,8 @@ public:
 
    virtual void Notify()
    {
+      MailLocker lock;
+
       wxLogTrace(TRACE_TIMER, _T("Going away on timer"));
 
       mApplication->SetAwayMode(TRUE);
@@ -356,6 +368,8 @@ IMPLEMENT_APP(wxMApp);
 
 void MailCollectionTimer::Notify()
 {
+   MailLocker lock;
+
    if ( !mApplication->AllowBgProcessing() )
       return;
 
@@ -616,6 +630,10 @@ wxMApp::OnIdle(wxIdleEvent &event)
    if ( AllowBgProcessing() )
    {
       MEventManager::DispatchPending();
+
+      // this is done in small steps, so ask for more idle events if needed
+      if ( MailFolder::IndexNewMailInOpened() )
+         event.RequestMore();
    }
 
    event.Skip();
@@ -665,6 +683,19 @@ int wxMApp::FilterEvent(wxEvent& event)
    return -1;
 }
 
+void
+wxMApp::HandleEvent(wxEvtHandler *handler,
+                    wxEventFunction func,
+                    wxEvent& event) const
+{
+   // the event handlers may use the mail objects at any moment, so prevent
+   // the background threads from using them while we're handling an event,
+   // but let them run while we're idle, waiting for the next one
+   MailLocker lock;
+
+   wxApp::HandleEvent(handler, func, event);
+}
+
 bool
 wxMApp::AllowBgProcessing() const
 {
@@ -950,6 +981,9 @@ wxMApp::OnClose()
 bool
 wxMApp::OnInit()
 {
+   // the folders are opened during the initialization, see HandleEvent()
+   MailLocker lockMail;
+
    // we want our OnAbnormalTermination() be called if we crash but don't use
    // it in debug builds as it interferes with the debugger
 #if wxUSE_ON_FATAL_EXCEPTION && !defined(__WXDEBUG__)
@@ -1358,6 +1392,8 @@ void wxMApp::DoCleanup()
 
 int wxMApp::OnExit()
 {
+   MailLocker lockMail;
+
    DoCleanup();
 
    // this does cleanup which must be done whether OnInit() succeeded or failed
@@ -2322,6 +2358,8 @@ void wxMApp::ShowLog(bool doShow)
 #define OPTION_DEBUGMAIL   "debug"
 #define OPTION_FOLDER      "folder"
 #define OPTION_LANG        "lang"
+#define OPTION_MIGRATE_FROM "migrate-from"
+#define OPTION_MIGRATE_TO  "migrate-to"
 #define OPTION_NEWSGROUP   "newsgroup"
 #define OPTION_NOPYTHON    "nopython"
 #define OPTION_NOREMOTE    "noremote"
@@ -2407,6 +2445,22 @@ void wxMApp::OnInitCmdLine(wxCmdLineParser& parser)
          gettext_noop("the language to use for the program messages"),
       },
 
+      // --migrate-from and --migrate-to to copy all folders between the
+      // local directories on startup and exit
+      {
+         wxCMD_LINE_OPTION,
+         "",
+         OPTION_MIGRATE_FROM,
+         gettext_noop("[mbx:|mbox:|mh:]directory to migrate the folders from"),
+      },
+
+      {
+         wxCMD_LINE_OPTION,
+         "",
+         OPTION_MIGRATE_TO,
+         gettext_noop("[mbx:|mbox:|mh:]directory to migrate the folders to"),
+      },
+
       // --nopython to disable loading Python interpreter
       // (note that this option exists even if Python is not compiled in, in
       // this case it simply does nothing)
@@ -2559,6 +2613,17 @@ bool wxMApp::OnCmdLineParsed(wxCmdLineParser& parser)
 
    (void)parser.Found(OPTION_IMPORT, &m_cmdLineOptions->configImport);
 
+   const bool migrateFrom = parser.Found(OPTION_MIGRATE_FROM,
+                                         &m_cmdLineOptions->migrate.from);
+   const bool migrateTo = parser.Found(OPTION_MIGRATE_TO,
+                                       &m_cmdLineOptions->migrate.to);
+   if ( migrateFrom != migrateTo )
+   {
+      wxLogError(_("Both --%s and --%s options must be specified."),
+                 OPTION_MIGRATE_FROM, OPTION_MIGRATE_TO);
+      return false;
+   }
+
    return true;
 }
 
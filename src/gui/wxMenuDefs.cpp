@@ -443,6 +443,7 @@ static const MenuItemInfo g_aMenuItems[] =
       { WXMENU_MSG_SPAM_CHECK, gettext_noop("Chec&k message...\tShift-Ctrl-K"), gettext_noop("Check if this message is spam"), wxITEM_NORMAL },
    { WXMENU_SUBMENU,       "", "", wxITEM_NORMAL },
    { WXMENU_MSG_REMOVE_ATTACHMENTS, gettext_noop("Remove attac&hments..."), gettext_noop("Remove the attachments from the selected message"), wxITEM_NORMAL },
+   { WXMENU_MSG_VERIFY_SIGNATURES, gettext_noop("&Verify signatures"), gettext_noop("Check the PGP signatures of all the selected messages at once"), wxITEM_NORMAL },
    { WXMENU_SEPARATOR,     "",                  ""                         , wxITEM_NORMAL },
    { WXMENU_MSG_SAVEADDRESSES, gettext_noop("Extract &addresses..."), gettext_noop("Save all or some addresses of the message in an address book"), wxITEM_NORMAL },
 
@@ -59,6 +59,7 @@
 #endif // wxUSE_DRAG_AND_DROP
 
 #include "modules/Filters.h"    // for FilterRule::Error
+#include "modules/MCrypt.h"
 
 class AsyncStatusHandler;
 
@@ -206,6 +207,9 @@ protected:
    /// Remove attachments from the message
    void RemoveAttachments(UIdType uid);
 
+   /// Verify PGP signatures of all the messages
+   void VerifySignatures(const UIdArray& uids);
+
    //@}
 
    /// access the m_TicketsToDeleteList creating it if necessary
@@ -742,6 +746,10 @@ bool MsgCmdProcImpl::ProcessCommand(int cmd,
          RemoveAttachments(messages[0]);
          break;
 
+      case WXMENU_MSG_VERIFY_SIGNATURES:
+         VerifySignatures(messages);
+         break;
+
       default:
          // try passing it to message view
          if ( !m_msgView->DoMenuCommand(cmd) )
@@ -1034,6 +1042,103 @@ void MsgCmdProcImpl::CheckIfSpam(const UIdArray& uids)
    wxLogStatus(GetFrame(), status + _("done"));
 }
 
+void MsgCmdProcImpl::VerifySignatures(const UIdArray& uids)
+{
+   MCryptoEngineFactory * const factory
+      = (MCryptoEngineFactory *)MModule::LoadModule("PGPEngine");
+   CHECK_RET( factory, "failed to create PGPEngineFactory" );
+
+   wxString status(_("Verifying message signatures..."));
+   wxLogStatus(GetFrame(), status);
+
+   // collect all PGP signatures in all messages first to check them at once
+   MCryptoEngine::DetachedSignatures sigs;
+   wxArrayString subjects;
+
+   const size_t n = uids.Count();
+   for ( size_t i = 0; i < n; i++ )
+   {
+      Message_obj msg(GetMessage(uids[i]));
+      if ( !msg )
+      {
+         wxLogError(_("Failed to retrieve the message to verify."));
+         continue;
+      }
+
+      const int count = msg->CountParts();
+      for ( int part = 0; part < count; part++ )
+      {
+         const MimePart * const mimepart = msg->GetMimePart(part);
+         if ( mimepart->GetType().GetFull() != "MULTIPART/SIGNED" ||
+               mimepart->GetParam("protocol") != "application/pgp-signature" )
+            continue;
+
+         // see MessageView::ProcessSignedMultiPart()
+         const MimePart * const signedPart = mimepart->GetNested();
+         const MimePart * const signaturePart = signedPart
+                                                   ? signedPart->GetNext()
+                                                   : NULL;
+         if ( !signaturePart )
+            continue;
+
+         MCryptoEngine::DetachedSignature sig;
+         sig.messageId = msg->GetId();
+         sig.message = signedPart->GetHeaders() +
+                           signedPart->GetRawContentAsString();
+         sig.signature = signaturePart->GetTextContent();
+
+         sigs.push_back(sig);
+         subjects.push_back(msg->Subject());
+      }
+   }
+
+   if ( sigs.empty() )
+   {
+      wxLogMessage(_("None of the selected messages is signed."));
+   }
+   else
+   {
+      // the results are also cached, so showing these messages later will
+      // be fast too
+      factory->Get()->VerifyDetachedSignatures(sigs);
+
+      size_t good = 0;
+      for ( size_t i = 0; i < sigs.size(); i++ )
+      {
+         switch ( sigs[i].status )
+         {
+            case MCryptoEngine::OK:
+            case MCryptoEngine::SIGNATURE_UNTRUSTED_WARNING:
+               good++;
+               break;
+
+            case MCryptoEngine::SIGNATURE_EXPIRED_ERROR:
+               wxLogWarning(_("The message \"%s\" has an expired signature."),
+                            subjects[i]);
+               break;
+
+            case MCryptoEngine::NONEXISTING_KEY_ERROR:
+               wxLogWarning(_("The public key for the signature of the "
+                              "message \"%s\" is not available."),
+                            subjects[i]);
+               break;
+
+            default:
+               wxLogWarning(_("The message \"%s\" is cryptographically "
+                              "signed but its signature is invalid!"),
+                            subjects[i]);
+         }
+      }
+
+      wxLogMessage(_("%lu of %lu signatures are valid."),
+                   (unsigned long)good, (unsigned long)sigs.size());
+   }
+
+   wxLogStatus(GetFrame(), status + _("done"));
+
+   factory->DecRef();
+}
+
 void
 MsgCmdProcImpl::OpenMessages(const UIdArray& selections)
 {
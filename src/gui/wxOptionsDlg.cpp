@@ -251,6 +251,9 @@ enum ConfigFields
    ConfigField_NewMailNewOnlyIfUnseen,
    ConfigField_NewMailMonitorIntervalDefaultHelp,
    ConfigField_NewMailMonitorIntervalDefault,
+   ConfigField_NewMailConcurrentHelp,
+   ConfigField_NewMailConcurrent,
+   ConfigField_NewMailIdleMax,
    ConfigField_NewMailMonitorHelp,
    ConfigField_NewMailMonitor,
    ConfigField_NewMailMonitorInterval,
@@ -1296,6 +1299,21 @@ const wxOptionsPage::FieldInfo wxOptionsPageStandard::ms_aFields[] =
                                                    Field_AppWide, -1 },
    { gettext_noop("Default pol&ling interval in seconds"), Field_Number |
                                                    Field_AppWide, -1 },
+   { gettext_noop("Mahogany can check all the folders which need to be polled\n"
+                  "at once, using a single connection to each server, which is\n"
+                  "much faster when many folders are monitored. In this mode the\n"
+                  "busiest IMAP folders can also be watched using IMAP IDLE, so\n"
+                  "that new mail in them is detected immediately: each of them\n"
+                  "uses a separate connection to the server, set their number\n"
+                  "to 0 to disable this."),
+                                                   Field_Message |
+                                                   Field_AppWide, -1 },
+   { gettext_noop("Check all folders &concurrently"), Field_Bool |
+                                                   Field_AppWide, -1 },
+   { gettext_noop("Max number of folders to &watch using IDLE"),
+                                                   Field_Number |
+                                                   Field_AppWide,
+                                                   ConfigField_NewMailConcurrent },
 
    { gettext_noop("If you check the checkbox below, Mahogany will always monitor\n"
                   "this folder in the background even when it is not opened.\n"
@@ -2056,6 +2074,9 @@ const ConfigValueDefault wxOptionsPageStandard::ms_aConfigDefaults[] =
 
    CONFIG_NONE(), // update help
    CONFIG_ENTRY(MP_POLLINCOMINGDELAY),
+   CONFIG_NONE(), // concurrent check help
+   CONFIG_ENTRY(MP_POLL_CONCURRENTLY),
+   CONFIG_ENTRY(MP_POLL_IDLE_MAX),
    CONFIG_NONE(), // monitor help
    CONFIG_NONE(), // monitor folder (MF_FLAGS_MONITOR)
    CONFIG_ENTRY(MP_POLLINCOMINGDELAY),
@@ -4039,6 +4060,13 @@ bool wxOptionsPageNetwork::DoTransferOptionsFromWindow()
 // wxOptionsPageNewMail
 // ----------------------------------------------------------------------------
 
+// return true if FolderMonitor may watch some folders using IMAP IDLE
+static bool IsPollIdleEnabled(Profile *profile)
+{
+   return READ_CONFIG_BOOL(profile, MP_POLL_CONCURRENTLY) &&
+            READ_CONFIG(profile, MP_POLL_IDLE_MAX) > 0;
+}
+
 wxOptionsPageNewMail::wxOptionsPageNewMail(MBookCtrl *parent,
                                            Profile *profile)
                     : wxOptionsPageStandard(parent,
@@ -4049,6 +4077,7 @@ wxOptionsPageNewMail::wxOptionsPageNewMail(MBookCtrl *parent,
                                     MH_OPAGE_NEWMAIL)
 {
    m_nIncomingDelayOld = -1;
+   m_pollIdleOld = false;
 
    m_folder = NULL;
 }
@@ -4105,6 +4134,7 @@ bool wxOptionsPageNewMail::DoTransferOptionsToWindow()
    //else: happens when editing the global settings
 
    m_nIncomingDelayOld = READ_CONFIG(m_Profile, MP_POLLINCOMINGDELAY);
+   m_pollIdleOld = IsPollIdleEnabled(m_Profile);
 
    return wxOptionsPage::DoTransferOptionsToWindow();
 }
@@ -4166,7 +4196,9 @@ bool wxOptionsPageNewMail::DoTransferOptionsFromWindow()
    {
       long nIncomingDelay = READ_CONFIG(m_Profile, MP_POLLINCOMINGDELAY);
 
-      if ( nIncomingDelay != m_nIncomingDelayOld )
+      // the timer fires more often when some folders are watched using IDLE
+      if ( nIncomingDelay != m_nIncomingDelayOld ||
+            IsPollIdleEnabled(m_Profile) != m_pollIdleOld )
       {
          wxLogTrace(_T("timer"), _T("Restarting timer for polling incoming folders"));
 
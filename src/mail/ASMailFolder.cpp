@@ -17,9 +17,11 @@
 #include "UIdArray.h"
 
 #include "MSearch.h"
+#include "MFolder.h"
 
 #include "ASMailFolder.h"
 #include "MailFolderCC.h"
+#include "mail/MailThreadPool.h"
 
 /// Call this always before using it.
 #ifdef DEBUG
@@ -43,9 +45,16 @@ ASMailFolderResultImpl::~ASMailFolderResultImpl()
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 
  ASMailFolderImpl creates a MailThread object for each operation
- that it wants to perform. These MailThread objects run either
- synchronously or asynchronously (derived from wxThread), depending
- on whether Mahogany was configured --with-threads or without.
+ that it wants to perform. These MailThread objects are executed
+ asynchronously, by MailThreadPool worker threads, unless wxWidgets was
+ built without thread support, in which case they're executed synchronously.
+ The workers hold MailLock while executing them, so they are serialized with
+ the rest of the mail code (which is not MT-safe), except when they wait for
+ the server.
+
+ Even when using threads, the operations which may need to interact with
+ the user are still executed synchronously in the main thread (but only
+ after all the previously started operations on the same folder complete).
 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -58,18 +67,27 @@ ASMailFolder::GetTicket(void)
    return gs_Ticket++;
 }
 
+/* static */
+bool
+ASMailFolder::CancelTicket(Ticket ticket)
+{
+#if wxUSE_THREADS
+   return MailThreadPool::Get()->Cancel(ticket);
+#else // !wxUSE_THREADS
+   // all operations complete before returning their ticket
+   (void)ticket;
+
+   return false;
+#endif // wxUSE_THREADS/!wxUSE_THREADS
+}
+
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 
-   MailThread - one thread for each operation to be done
+   MailThread - one task for each operation to be done
 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#ifdef USE_THREADS
-#   include <wx/thread.h>       // for wxThread
-#endif
-
-
 static
 UIdArray *Copy(const UIdArray *old)
 {
@@ -79,12 +97,7 @@ UIdArray *Copy(const UIdArray *old)
    return newarray;
 }
 
-class MailThread
-
-#ifdef USE_THREADS
-   : public wxThread
-#endif
-
+class MailThread : public MailThreadPool::Task
 {
 public:
    MailThread(ASMailFolder *mf, UserData ud)
@@ -98,30 +111,41 @@ public:
    Ticket Start(void)
       {
          m_Ticket = ASMailFolder::GetTicket();
-#ifdef USE_THREADS
-         if ( Create() != wxTHREAD_NO_ERROR )
+
+         Ticket ticketSave = m_Ticket;  // can't use m_XXX after delete this
+
+#if wxUSE_THREADS
+         MailThreadPool * const pool = MailThreadPool::Get();
+         if ( !IsInteractive() )
          {
-            wxLogError(_("Cannot create thread!"));
+            // the pool takes ownership of this object
+            pool->Queue(this, m_Ticket, m_MailFolder, GetServer());
+
+            return ticketSave;
+         }
+
+         // still preserve the order of the operations on this folder
+         pool->WaitForFolder(m_MailFolder);
+#endif // wxUSE_THREADS
+
+         {
+            MBusyCursor bc;
+
+            WorkFunction();
          }
-#endif
-         Run();
 
-         Ticket ticketSave = m_Ticket;  // can't use m_XXX after delete this
-#ifndef USE_THREADS
-         // We are not using wxThread, so we must delete this when we
-         // are done.
          delete this;
-#endif
+
          return ticketSave;
       }
 
-//#ifndef USE_THREADS
+   // notice that MailThreadPool deletes the tasks with MailLock held, so
+   // it's safe to release our references from a worker thread
    virtual ~MailThread()
       {
          SafeDecRef(m_MailFolder);
          SafeDecRef(m_ASMailFolder);
       }
-//#endif
 
 protected:
    void SendEvent(ASMailFolder::Result *result);
@@ -130,13 +154,21 @@ protected:
    inline void UnLockFolder(void)
       { if ( m_ASMailFolder ) m_ASMailFolder->UnLockFolder(); };
 
-   virtual void *Entry();
-#ifndef USE_THREADS
-   virtual void Run(void) { Entry(); }
-#endif
+   /**
+      Return true if this operation may need to interact with the user and so
+      must be executed in the main thread.
+    */
+   virtual bool IsInteractive() const { return false; }
+
+   // implement MailThreadPool::Task method
+   virtual void Execute() { WorkFunction(); }
 
    virtual void  WorkFunction(void) = 0;
 
+private:
+   /// get the server of our folder, empty for local folders
+   String GetServer() const;
+
 protected:
    class ASMailFolder *m_ASMailFolder;
    MailFolder            *m_MailFolder;
@@ -146,16 +178,15 @@ protected:
 };
 
 
-void *
-MailThread::Entry()
+String
+MailThread::GetServer() const
 {
-   MBusyCursor bc;
+   if ( !m_MailFolder )
+      return String();
 
-   //FIXME-MT: IS THIS TRUE? MailFolderCC does sufficient locking
-   //LockFolder();
-   WorkFunction();
-   //UnLockFolder();
-   return NULL; // no return value
+   MFolder_obj folder(m_MailFolder->GetName());
+
+   return folder ? folder->GetServer() : String();
 }
 
 
@@ -163,9 +194,23 @@ void
 MailThread::SendEvent(ASMailFolder::Result *result)
 {
    ASSERT(result);
+
+   if ( IsCancelled() )
+   {
+      // nobody is interested in the result any more
+      result->DecRef();
+      return;
+   }
+
    // now we sent an  event to update folderviews etc
    MEventManager::Send(new MEventASFolderResultData (result) );
    result->DecRef(); // we no longer need it
+
+#if wxUSE_THREADS
+   // the events are only dispatched in idle time, make sure it happens soon
+   if ( !wxThread::IsMain() )
+      wxWakeUpIdle();
+#endif // wxUSE_THREADS
 }
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
@@ -472,7 +517,8 @@ public:
                                                    m_Ticket,
                                                    ASMailFolder::Op_SearchMessages,
                                                    msgs,
-                                                   msgs->Count(), m_UserData));
+                                                   msgs ? msgs->Count() : 0,
+                                                   m_UserData));
       }
 private:
    SearchCriterium m_Criterium;
@@ -549,6 +595,9 @@ public:
          ASSERT(m_Op == ASMailFolder::Op_SaveMessagesToFile ||
                 m_Op == ASMailFolder::Op_SaveMessagesToFolder);
       }
+   // we may need to ask the user for the file or folder name
+   virtual bool IsInteractive() const { return true; }
+
    virtual void WorkFunction(void)
       {
          int rc = m_Op == ASMailFolder::Op_SaveMessagesToFile
@@ -583,6 +632,9 @@ public:
          ASSERT(m_Op == ASMailFolder::Op_ReplyMessages ||
                 m_Op == ASMailFolder::Op_ForwardMessages);
       }
+   // this opens the composer windows
+   virtual bool IsInteractive() const { return true; }
+
    virtual void WorkFunction(void)
       {
          if(m_Op == ASMailFolder::Op_ReplyMessages)
@@ -607,6 +659,9 @@ public:
                        const UIdArray *selections)
       : MailThreadSeq(mf, ud, selections)
       { }
+   // the filter actions can interact with the user
+   virtual bool IsInteractive() const { return true; }
+
    virtual void WorkFunction(void)
       {
          int result = m_MailFolder->ApplyFilterRules(*m_Seq);
@@ -672,6 +727,10 @@ public:
          m_SubOnly = sub_only;
       }
 
+   // the callers rely on all results being sent by the time ListFolders()
+   // returns
+   virtual bool IsInteractive() const { return true; }
+
    virtual void WorkFunction(void)
       {
          m_MailFolder->ListFolders(m_ASMailFolder,
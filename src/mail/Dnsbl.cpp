@@ -0,0 +1,853 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/Dnsbl.cpp - DnsblChecker and DnsblUdpResolver classes
+// Purpose:     concurrent and cached DNSBL lookups
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+#  include "Mcommon.h"
+#endif // USE_PCH
+
+#ifdef USE_RBL
+
+#include "mail/Dnsbl.h"
+
+#include "CacheFile.h"              // for GetCacheDirName()
+
+#include <wx/file.h>                // for wxTempFile
+#include <wx/textfile.h>
+#include <wx/stopwatch.h>
+
+#include <set>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// FreeBSD uses a variable name "class"
+#define class xxclass
+#undef MIN  // defined by glib.h
+#undef MAX  // defined by glib.h
+#include <arpa/nameser.h>
+#undef class
+
+#include <resolv.h>
+
+#ifdef OS_SOLARIS
+   extern "C" {
+   // Solaris 2.5.1 has no prototypes for it:
+   extern int res_init(void);
+   };
+#endif
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// trace mask for the DNSBL lookups
+#define TRACE_DNSBL "dnsbl"
+
+// the name of the file used for the global checker cache
+#define DNSBL_CACHE_FILENAME _T("dnsbl")
+
+// the header of the cache file
+#define DNSBL_CACHE_HEADER _T("Mahogany DNSBL Cache File (version %d.%d)")
+
+// the version of the cache file format
+static const int DNSBL_CACHE_VERSION_MAJOR = 1;
+static const int DNSBL_CACHE_VERSION_MINOR = 0;
+
+// the DNS protocol constants we use
+static const unsigned short DNS_PORT = 53;
+static const size_t DNS_HEADER_LEN = 12;
+static const size_t DNS_MAX_PACKET = 512;
+static const unsigned DNS_FLAG_QR = 0x8000;
+static const unsigned DNS_FLAG_RD = 0x0100;
+static const unsigned DNS_RCODE_MASK = 0x000f;
+static const unsigned DNS_RCODE_NOERROR = 0;
+static const unsigned DNS_RCODE_NXDOMAIN = 3;
+static const unsigned DNS_TYPE_A = 1;
+static const unsigned DNS_TYPE_SOA = 6;
+static const unsigned DNS_CLASS_IN = 1;
+
+// the interval after which the unanswered queries are resent (to the next
+// server if there are several of them)
+static const long DNSBL_RESEND_INTERVAL = 1000;
+
+// the TTL used for negative answers without SOA record
+static const unsigned long DNSBL_DEFAULT_NEGATIVE_TTL = 15*60;
+
+// we don't cache the answers for longer than this, whatever their TTL
+static const unsigned long DNSBL_MAX_TTL = 24*60*60;
+
+// ----------------------------------------------------------------------------
+// globals
+// ----------------------------------------------------------------------------
+
+static DnsblChecker *gs_dnsblChecker = NULL;
+
+// ----------------------------------------------------------------------------
+// DNS packets helpers
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+inline unsigned GetUint16(const unsigned char *p)
+{
+   return (p[0] << 8) | p[1];
+}
+
+inline unsigned long GetUint32(const unsigned char *p)
+{
+   return ((unsigned long)GetUint16(p) << 16) | GetUint16(p + 2);
+}
+
+inline void PutUint16(std::vector<unsigned char>& packet, unsigned n)
+{
+   packet.push_back((unsigned char)(n >> 8));
+   packet.push_back((unsigned char)n);
+}
+
+// build the query packet for the A record of the given name, return false if
+// the name is invalid
+bool BuildQuery(std::vector<unsigned char>& packet,
+                unsigned id,
+                const String& name)
+{
+   packet.clear();
+   packet.reserve(DNS_HEADER_LEN + name.length() + 6);
+
+   PutUint16(packet, id);
+   PutUint16(packet, DNS_FLAG_RD);
+   PutUint16(packet, 1);            // one question
+   PutUint16(packet, 0);            // no answers
+   PutUint16(packet, 0);            // no authority records
+   PutUint16(packet, 0);            // no additional records
+
+   const wxArrayString labels = wxSplit(name, _T('.'), _T('\0'));
+   for ( size_t n = 0; n < labels.size(); n++ )
+   {
+      const wxCharBuffer label(labels[n].ToAscii());
+      const size_t len = strlen(label);
+      if ( !len )
+      {
+         // only the trailing dot is allowed
+         if ( n == labels.size() - 1 )
+            break;
+
+         return false;
+      }
+
+      if ( len > 63 )
+         return false;
+
+      packet.push_back((unsigned char)len);
+      packet.insert(packet.end(), label.data(), label.data() + len);
+   }
+
+   packet.push_back(0);
+
+   if ( packet.size() - DNS_HEADER_LEN > 255 )
+      return false;
+
+   PutUint16(packet, DNS_TYPE_A);
+   PutUint16(packet, DNS_CLASS_IN);
+
+   return true;
+}
+
+// skip the (possibly compressed) name starting at p, return NULL if it is
+// invalid
+const unsigned char *SkipName(const unsigned char *p, const unsigned char *end)
+{
+   while ( p < end )
+   {
+      const unsigned len = *p;
+      if ( !len )
+         return p + 1;
+
+      if ( (len & 0xc0) == 0xc0 )
+      {
+         // compression pointer ends the name
+         return p + 2 <= end ? p + 2 : NULL;
+      }
+
+      if ( len & 0xc0 )
+         return NULL;
+
+      p += len + 1;
+   }
+
+   return NULL;
+}
+
+// generate the given number of distinct random query IDs
+//
+// the IDs must be unpredictable as otherwise it would be easy to send us
+// spoofed answers which would be then cached for a long time, so use the
+// system random number generator and not rand()
+bool GenerateQueryIds(std::vector<unsigned>& ids, size_t count)
+{
+   // there are only that many different IDs
+   if ( count > 0x10000 )
+      return false;
+
+   const int fd = open("/dev/urandom", O_RDONLY);
+   if ( fd == -1 )
+      return false;
+
+   std::set<unsigned> used;
+   ids.clear();
+   ids.reserve(count);
+   while ( ids.size() < count )
+   {
+      unsigned char buf[256];
+      const size_t len = wxMin(2*(count - ids.size()), sizeof(buf));
+      if ( read(fd, buf, len) != (ssize_t)len )
+         break;
+
+      for ( size_t n = 0; n < len; n += 2 )
+      {
+         const unsigned id = GetUint16(buf + n);
+         if ( used.insert(id).second )
+            ids.push_back(id);
+      }
+   }
+
+   close(fd);
+
+   return ids.size() == count;
+}
+
+// the result of parsing a DNS answer
+enum AnswerResult
+{
+   Answer_Invalid,      // not an answer to our query at all
+   Answer_Failed,       // an answer but not a usable one (e.g. SERVFAIL)
+   Answer_Ok            // the query is done
+};
+
+// parse the answer to the given query
+AnswerResult ParseAnswer(const unsigned char *answer,
+                         size_t len,
+                         const std::vector<unsigned char>& query,
+                         DnsblResolver::Query& result)
+{
+   if ( len < query.size() )
+      return Answer_Invalid;
+
+   const unsigned flags = GetUint16(answer + 2);
+   if ( GetUint16(answer) != GetUint16(&query[0]) ||
+         !(flags & DNS_FLAG_QR) ||
+            GetUint16(answer + 4) != 1 )
+      return Answer_Invalid;
+
+   // check that the question (name, type and class) is ours too, not just
+   // the ID
+   for ( size_t n = DNS_HEADER_LEN; n < query.size(); n++ )
+   {
+      if ( tolower(answer[n]) != tolower(query[n]) )
+         return Answer_Invalid;
+   }
+
+   const unsigned rcode = flags & DNS_RCODE_MASK;
+   if ( rcode != DNS_RCODE_NOERROR && rcode != DNS_RCODE_NXDOMAIN )
+      return Answer_Failed;
+
+   const unsigned long countAnswers = GetUint16(answer + 6),
+                       countAuthority = GetUint16(answer + 8);
+
+   // look for the A records in the answer section and for SOA in the
+   // authority one: its minimum TTL is the TTL of a negative answer
+   bool hasA = false;
+   unsigned long ttlA = DNSBL_MAX_TTL,
+                 ttlNegative = DNSBL_DEFAULT_NEGATIVE_TTL;
+
+   const unsigned char *p = answer + query.size(),
+                       * const end = answer + len;
+   for ( unsigned long n = 0; n < countAnswers + countAuthority; n++ )
+   {
+      p = SkipName(p, end);
+      if ( !p || p + 10 > end )
+         return Answer_Failed;
+
+      const unsigned type = GetUint16(p),
+                     rrclass = GetUint16(p + 2);
+      const unsigned long ttl = GetUint32(p + 4);
+      const size_t lenData = GetUint16(p + 8);
+
+      p += 10;
+      if ( p + lenData > end )
+         return Answer_Failed;
+
+      if ( rrclass == DNS_CLASS_IN )
+      {
+         if ( n < countAnswers )
+         {
+            if ( type == DNS_TYPE_A )
+            {
+               hasA = true;
+               if ( ttl < ttlA )
+                  ttlA = ttl;
+            }
+         }
+         else if ( type == DNS_TYPE_SOA && lenData >= 22 )
+         {
+            const unsigned long minimum = GetUint32(p + lenData - 4);
+            ttlNegative = ttl < minimum ? ttl : minimum;
+         }
+      }
+
+      p += lenData;
+   }
+
+   if ( rcode == DNS_RCODE_NOERROR && hasA )
+   {
+      result.listed = true;
+      result.ttl = ttlA;
+   }
+   else // NXDOMAIN or no A records
+   {
+      result.listed = false;
+      result.ttl = ttlNegative;
+   }
+
+   result.done = true;
+
+   return Answer_Ok;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// DnsblUdpResolver implementation
+// ============================================================================
+
+DnsblUdpResolver::DnsblUdpResolver(const wxArrayString& servers)
+{
+   Server server;
+   for ( size_t n = 0; n < servers.size(); n++ )
+   {
+      const String& s = servers[n];
+
+      struct in_addr addr;
+      if ( !inet_aton(s.BeforeFirst(_T(':')).ToAscii(), &addr) )
+      {
+         wxLogDebug(_T("Invalid DNS server address \"%s\" ignored."), s);
+         continue;
+      }
+
+      unsigned long port = DNS_PORT;
+      const String portStr = s.AfterFirst(_T(':'));
+      if ( !portStr.empty() && (!portStr.ToULong(&port) || port > 0xffff) )
+      {
+         wxLogDebug(_T("Invalid DNS server port \"%s\" ignored."), s);
+         continue;
+      }
+
+      server.ip = ntohl(addr.s_addr);
+      server.port = (unsigned short)port;
+      m_servers.push_back(server);
+   }
+
+   if ( m_servers.empty() )
+   {
+      // use the servers from the system configuration
+      if ( res_init() == 0 )
+      {
+         for ( int n = 0; n < _res.nscount; n++ )
+         {
+            const struct sockaddr_in& addr = _res.nsaddr_list[n];
+            if ( addr.sin_family != AF_INET )
+               continue;
+
+            server.ip = ntohl(addr.sin_addr.s_addr);
+            server.port = ntohs(addr.sin_port);
+            m_servers.push_back(server);
+         }
+      }
+
+      if ( m_servers.empty() )
+      {
+         // this is what the standard resolver does too
+         server.ip = INADDR_LOOPBACK;
+         server.port = DNS_PORT;
+         m_servers.push_back(server);
+      }
+   }
+}
+
+bool DnsblUdpResolver::IsServer(unsigned long ip, unsigned short port) const
+{
+   for ( size_t n = 0; n < m_servers.size(); n++ )
+   {
+      if ( m_servers[n].ip == ip && m_servers[n].port == port )
+         return true;
+   }
+
+   return false;
+}
+
+void DnsblUdpResolver::Resolve(std::vector<Query>& queries, long msTimeout)
+{
+   const size_t count = queries.size();
+   if ( !count )
+      return;
+
+   const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+   if ( fd == -1 )
+   {
+      wxLogDebug(_T("Failed to create socket for DNSBL queries."));
+      return;
+   }
+
+   fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+   std::vector<unsigned> ids;
+   if ( !GenerateQueryIds(ids, count) )
+   {
+      wxLogDebug(_T("Failed to generate IDs for DNSBL queries."));
+      close(fd);
+      return;
+   }
+
+   // the index of the query with the given ID
+   std::map<unsigned, size_t> queryById;
+
+   std::vector< std::vector<unsigned char> > packets(count);
+
+   // the number of queries still waiting for the answer
+   size_t countPending = 0;
+
+   // the queries which are still pending
+   std::vector<bool> pending(count, false);
+   for ( size_t n = 0; n < count; n++ )
+   {
+      queries[n].done = false;
+
+      if ( BuildQuery(packets[n], ids[n], queries[n].name) )
+      {
+         queryById[ids[n]] = n;
+         pending[n] = true;
+         countPending++;
+      }
+      else
+      {
+         wxLogDebug(_T("Invalid DNSBL query \"%s\" ignored."), queries[n].name);
+      }
+   }
+
+   wxStopWatch sw;
+   size_t nServer = 0;
+   long msNextSend = 0;
+   while ( countPending )
+   {
+      const long msNow = sw.Time();
+      if ( msNow >= msTimeout )
+         break;
+
+      if ( msNow >= msNextSend )
+      {
+         // (re)send all the queries still without answer
+         const Server& server = m_servers[nServer++ % m_servers.size()];
+
+         struct sockaddr_in addr;
+         memset(&addr, 0, sizeof(addr));
+         addr.sin_family = AF_INET;
+         addr.sin_addr.s_addr = htonl(server.ip);
+         addr.sin_port = htons(server.port);
+
+         for ( size_t n = 0; n < count; n++ )
+         {
+            if ( !pending[n] )
+               continue;
+
+            if ( sendto(fd, &packets[n][0], packets[n].size(), 0,
+                        (struct sockaddr *)&addr, sizeof(addr)) == -1 )
+            {
+               wxLogTrace(TRACE_DNSBL, "Failed to send query for \"%s\"",
+                          queries[n].name);
+            }
+         }
+
+         msNextSend = msNow + DNSBL_RESEND_INTERVAL;
+      }
+
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      const long msWait = wxMin(msTimeout, msNextSend) - msNow;
+      if ( poll(&pfd, 1, msWait) <= 0 )
+         continue;
+
+      // read all the answers available now
+      unsigned char answer[DNS_MAX_PACKET];
+      struct sockaddr_in from;
+      socklen_t lenFrom = sizeof(from);
+      ssize_t len;
+      while ( (len = recvfrom(fd, answer, sizeof(answer), 0,
+                              (struct sockaddr *)&from, &lenFrom)) > 0 )
+      {
+         const bool fromServer = lenFrom == sizeof(from) &&
+                                    from.sin_family == AF_INET &&
+                                       IsServer(ntohl(from.sin_addr.s_addr),
+                                                ntohs(from.sin_port));
+         lenFrom = sizeof(from);
+
+         // ignore anything not coming from one of the servers we use: it can
+         // only be a spoofed answer
+         if ( !fromServer )
+         {
+            wxLogTrace(TRACE_DNSBL, "Ignoring DNS answer from %s:%u",
+                       inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+            continue;
+         }
+
+         if ( (size_t)len < DNS_HEADER_LEN )
+            continue;
+
+         const std::map<unsigned, size_t>::const_iterator
+            i = queryById.find(GetUint16(answer));
+         if ( i == queryById.end() )
+            continue;
+
+         const size_t n = i->second;
+         if ( !pending[n] )
+            continue;
+
+         switch ( ParseAnswer(answer, len, packets[n], queries[n]) )
+         {
+            case Answer_Invalid:
+               continue;
+
+            case Answer_Failed:
+               wxLogTrace(TRACE_DNSBL, "DNS query for \"%s\" failed",
+                          queries[n].name);
+               break;
+
+            case Answer_Ok:
+               wxLogTrace(TRACE_DNSBL, "\"%s\" is %slisted (TTL %lu)",
+                          queries[n].name,
+                          queries[n].listed ? "" : "not ",
+                          queries[n].ttl);
+               break;
+         }
+
+         pending[n] = false;
+         countPending--;
+      }
+   }
+
+   close(fd);
+
+   if ( countPending )
+   {
+      wxLogTrace(TRACE_DNSBL, "%lu DNSBL queries timed out after %ld ms",
+                 (unsigned long)countPending, sw.Time());
+   }
+}
+
+// ============================================================================
+// DnsblChecker implementation
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// the global checker
+// ----------------------------------------------------------------------------
+
+/* static */
+String DnsblChecker::GetFileName()
+{
+   String filename;
+   filename << CacheFile::GetCacheDirName()
+            << DIR_SEPARATOR << DNSBL_CACHE_FILENAME;
+
+   return filename;
+}
+
+/* static */
+DnsblChecker *DnsblChecker::Get()
+{
+   if ( !gs_dnsblChecker )
+   {
+      gs_dnsblChecker = new DnsblChecker;
+      gs_dnsblChecker->Load(GetFileName());
+   }
+
+   return gs_dnsblChecker;
+}
+
+/* static */
+void DnsblChecker::Flush()
+{
+   if ( gs_dnsblChecker && gs_dnsblChecker->IsDirty() )
+   {
+      const String filename = GetFileName();
+      if ( CacheFile::CreateDirFor(filename) )
+         gs_dnsblChecker->Save(filename);
+   }
+}
+
+/* static */
+void DnsblChecker::CleanUp()
+{
+   Flush();
+
+   delete gs_dnsblChecker;
+   gs_dnsblChecker = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// construction
+// ----------------------------------------------------------------------------
+
+DnsblChecker::DnsblChecker(DnsblResolver *resolver)
+{
+   m_resolver = resolver;
+   m_isDirty = false;
+}
+
+DnsblChecker::~DnsblChecker()
+{
+   delete m_resolver;
+}
+
+void DnsblChecker::SetResolver(DnsblResolver *resolver)
+{
+   delete m_resolver;
+   m_resolver = resolver;
+}
+
+// ----------------------------------------------------------------------------
+// cache
+// ----------------------------------------------------------------------------
+
+bool DnsblChecker::GetCached(const String& name, bool *listed) const
+{
+   Cache::const_iterator i = m_cache.find(name);
+   if ( i == m_cache.end() || i->second.expires <= time(NULL) )
+      return false;
+
+   *listed = i->second.listed;
+
+   return true;
+}
+
+void DnsblChecker::AddToCache(const DnsblResolver::Query& query)
+{
+   Entry& entry = m_cache[query.name];
+   entry.listed = query.listed;
+   entry.expires = time(NULL) + wxMin(query.ttl, DNSBL_MAX_TTL);
+
+   m_isDirty = true;
+}
+
+bool DnsblChecker::Load(const String& filename)
+{
+   wxTextFile file;
+
+   {
+      wxLogNull noLog;
+      if ( !file.Open(filename) )
+      {
+         // the cache file doesn't have to exist
+         return true;
+      }
+   }
+
+   int verMaj, verMin;
+   if ( !file.GetLineCount() ||
+         wxSscanf(file[0u], DNSBL_CACHE_HEADER, &verMaj, &verMin) != 2 )
+   {
+      wxLogDebug(_T("Missing header in DNSBL cache file \"%s\"."), filename);
+      return false;
+   }
+
+   if ( verMaj != DNSBL_CACHE_VERSION_MAJOR )
+   {
+      // just ignore the incompatible cache, it will be overwritten
+      return true;
+   }
+
+   const time_t now = time(NULL);
+
+   const size_t count = file.GetLineCount();
+   for ( size_t n = 1; n < count; n++ )
+   {
+      const String& line = file[n];
+
+      int listed;
+      unsigned long expires;
+      if ( wxSscanf(line.AfterFirst(_T(' ')), _T("%d %lu"),
+                    &listed, &expires) != 2 )
+      {
+         wxLogDebug(_T("Invalid line %lu in DNSBL cache file \"%s\"."),
+                    (unsigned long)n + 1, filename);
+         return false;
+      }
+
+      if ( (time_t)expires <= now )
+         continue;
+
+      Entry& entry = m_cache[line.BeforeFirst(_T(' '))];
+      entry.listed = listed != 0;
+      entry.expires = expires;
+   }
+
+   m_isDirty = false;
+
+   return true;
+}
+
+bool DnsblChecker::Save(const String& filename)
+{
+   wxTempFile file;
+   bool ok = file.Open(filename);
+
+   if ( ok )
+   {
+      String header;
+      header.Printf(DNSBL_CACHE_HEADER,
+                    DNSBL_CACHE_VERSION_MAJOR, DNSBL_CACHE_VERSION_MINOR);
+      header += _T('\n');
+
+      ok = file.Write(header);
+   }
+
+   const time_t now = time(NULL);
+
+   String line;
+   for ( Cache::iterator i = m_cache.begin(); ok && i != m_cache.end(); )
+   {
+      // don't keep the expired entries neither in memory nor on disk
+      if ( i->second.expires <= now )
+      {
+         m_cache.erase(i++);
+         continue;
+      }
+
+      line.Printf(_T("%s %d %lu\n"),
+                  i->first,
+                  i->second.listed,
+                  (unsigned long)i->second.expires);
+
+      ok = file.Write(line);
+
+      ++i;
+   }
+
+   if ( ok )
+      ok = file.Commit();
+
+   if ( !ok )
+   {
+      wxLogDebug(_T("Failed to save DNSBL cache to \"%s\"."), filename);
+      return false;
+   }
+
+   m_isDirty = false;
+
+   return true;
+}
+
+// ----------------------------------------------------------------------------
+// checking
+// ----------------------------------------------------------------------------
+
+bool DnsblChecker::IsListed(const wxArrayString& addresses,
+                            const wxArrayString& zones,
+                            long msTimeout,
+                            String *match)
+{
+   // first build the list of the names to look up and check the cache
+   std::vector<DnsblResolver::Query> queries;
+   for ( size_t n = 0; n < addresses.size(); n++ )
+   {
+      unsigned a, b, c, d;
+      char extra;
+      if ( wxSscanf(addresses[n], _T("%u.%u.%u.%u%c"),
+                    &a, &b, &c, &d, &extra) != 4 ||
+            a > 255 || b > 255 || c > 255 || d > 255 )
+      {
+         wxLogDebug(_T("Invalid IP address \"%s\" not checked."),
+                    addresses[n]);
+         continue;
+      }
+
+      for ( size_t m = 0; m < zones.size(); m++ )
+      {
+         DnsblResolver::Query query;
+         query.name.Printf(_T("%u.%u.%u.%u.%s"), d, c, b, a, zones[m]);
+
+         bool listed;
+         if ( GetCached(query.name, &listed) )
+         {
+            if ( listed )
+            {
+               if ( match )
+                  *match = query.name;
+
+               return true;
+            }
+
+            continue;
+         }
+
+         queries.push_back(query);
+      }
+   }
+
+   if ( queries.empty() )
+      return false;
+
+   if ( !m_resolver )
+      m_resolver = new DnsblUdpResolver;
+
+   m_resolver->Resolve(queries, msTimeout);
+
+   // cache all the answers we got, even if we don't need them right now
+   bool found = false;
+   for ( size_t n = 0; n < queries.size(); n++ )
+   {
+      const DnsblResolver::Query& query = queries[n];
+      if ( !query.done )
+         continue;
+
+      AddToCache(query);
+
+      if ( query.listed && !found )
+      {
+         if ( match )
+            *match = query.name;
+
+         found = true;
+      }
+   }
+
+   return found;
+}
+
+#endif // USE_RBL
@@ -0,0 +1,510 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/HeaderCache.cpp: implementation of HeaderCacheFile class
+// Purpose:     HeaderCacheFile stores the message headers between sessions
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include  "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+
+   #include <wx/log.h>           // for wxLogNull
+#endif // USE_PCH
+
+#include <wx/file.h>             // for wxTempFile
+
+#include "HeaderInfo.h"
+#include "mail/UIdIndex.h"
+#include "mail/HeaderCache.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the value written at the start of the binary part, allows to detect the
+// files created on the machines with different endianness
+static const wxUint32 HEADER_CACHE_MAGIC = 0x4d484346;   // "MHCF"
+
+// the binary file header
+struct HeaderCacheBinHeader
+{
+   wxUint32 magic;
+   wxUint32 uidValidity;
+   wxUint32 count;
+   wxUint32 reserved;
+};
+
+// the fixed part of a record: it is followed by the string fields
+//
+// NB: the records are not aligned, always use memcpy() to access them
+struct HeaderCacheRecord
+{
+   wxUint32 len;           // total length of the record
+   wxInt32 status;
+   wxUint32 size;
+   wxUint32 lines;
+   wxInt32 encoding;
+   wxInt64 date;
+};
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// write the string field to the buffer
+static void WriteString(std::vector<char>& buf, const String& s)
+{
+   const wxCharBuffer utf8(s.ToUTF8());
+   const char *p = utf8.data();
+   const wxUint32 len = p ? strlen(p) : 0;
+
+   const char *plen = (const char *)&len;
+   buf.insert(buf.end(), plen, plen + sizeof(len));
+   buf.insert(buf.end(), p, p + len);
+}
+
+// read the string field from the record, return false if it's corrupted
+static bool ReadString(const char *& p, const char *end, String& s)
+{
+   wxUint32 len;
+   if ( end - p < (ptrdiff_t)sizeof(len) )
+      return false;
+
+   memcpy(&len, p, sizeof(len));
+   p += sizeof(len);
+
+   if ( (size_t)(end - p) < len )
+      return false;
+
+   s = wxString::FromUTF8(p, len);
+   p += len;
+
+   return true;
+}
+
+// ============================================================================
+// HeaderCacheFile implementation
+// ============================================================================
+
+HeaderCacheFile::HeaderCacheFile(const String& folderName)
+               : m_folderName(folderName)
+{
+   m_uidValidity = 0;
+
+   m_offsetBin = 0;
+}
+
+HeaderCacheFile::~HeaderCacheFile()
+{
+   Unmap();
+}
+
+// ----------------------------------------------------------------------------
+// CacheFile methods
+// ----------------------------------------------------------------------------
+
+String HeaderCacheFile::GetFileName() const
+{
+   String folderNameFixed = m_folderName;
+   folderNameFixed.Replace(_T("/"), _T("_"));
+
+   String filename;
+   filename << GetCacheDirName() << DIR_SEPARATOR << folderNameFixed
+            << _T(".hdr");
+
+   return filename;
+}
+
+String HeaderCacheFile::GetFileHeader() const
+{
+   return _T("Mahogany Header Cache File (version %d.%d)");
+}
+
+int HeaderCacheFile::GetFormatVersion() const
+{
+   return BuildVersion(1, 0);
+}
+
+bool HeaderCacheFile::DoLoad(const wxTextFile& /* file */, int /* version */)
+{
+   FAIL_MSG( _T("HeaderCacheFile doesn't use text format") );
+
+   return false;
+}
+
+bool HeaderCacheFile::DoSave(wxTempFile& /* file */)
+{
+   FAIL_MSG( _T("HeaderCacheFile doesn't use text format") );
+
+   return false;
+}
+
+// ----------------------------------------------------------------------------
+// loading
+// ----------------------------------------------------------------------------
+
+void HeaderCacheFile::Unmap()
+{
+   m_file.Close();
+
+   m_offsetBin = 0;
+}
+
+bool HeaderCacheFile::Open(UIdType uidValidity)
+{
+   m_uidValidity = uidValidity;
+
+   return Load();
+}
+
+bool HeaderCacheFile::Load()
+{
+   Unmap();
+
+   // if the file doesn't exist, it's not an error, and if it can't be read,
+   // it will be just overwritten when we save it
+   if ( !m_file.Open(GetFileName()) )
+      return true;
+
+   int version;
+   m_offsetBin = CheckBinaryHeader(m_file, &version);
+   if ( !m_offsetBin )
+   {
+      Unmap();
+
+      return true;
+   }
+
+   HeaderCacheBinHeader hdr;
+   if ( m_offsetBin + sizeof(hdr) > m_file.GetSize() )
+   {
+      Unmap();
+
+      return true;
+   }
+
+   memcpy(&hdr, m_file.GetData() + m_offsetBin, sizeof(hdr));
+
+   // the file must be big enough for the UIDs and offsets arrays: check the
+   // count against the size instead of computing the size of the arrays from
+   // it as this could overflow for a corrupted count
+   const size_t countMax = (m_file.GetSize() - m_offsetBin - sizeof(hdr)) /
+                              (2*sizeof(wxUint32));
+   if ( hdr.magic != HEADER_CACHE_MAGIC || hdr.count > countMax )
+   {
+      wxLogDebug(_T("Corrupted header cache file \"%s\""), GetFileName());
+
+      Unmap();
+   }
+   else if ( hdr.uidValidity != m_uidValidity )
+   {
+      // all the cached UIDs are invalid now
+      Unmap();
+   }
+   else
+   {
+      // FindRecord() and Flush() rely on the UIDs being sorted, so check that
+      // they really are: we always write them in order but the file could
+      // have been damaged or modified by something else
+      //
+      // notice that the file data can't change after this check even if the
+      // file is replaced while we have it mapped as the cache files are
+      // always replaced by renaming a new file over them and the old contents
+      // remains mapped then
+      const wxUint32 *uids = GetFileUIds();
+      for ( wxUint32 n = 1; n < hdr.count; n++ )
+      {
+         if ( uids[n] <= uids[n - 1] )
+         {
+            wxLogDebug(_T("Unsorted UIDs in header cache file \"%s\""),
+                       GetFileName());
+
+            Unmap();
+            break;
+         }
+      }
+   }
+
+   return true;
+}
+
+// ----------------------------------------------------------------------------
+// accessing the file data
+// ----------------------------------------------------------------------------
+
+size_t HeaderCacheFile::GetFileCount() const
+{
+   if ( !m_file.IsOpened() )
+      return 0;
+
+   return ((const HeaderCacheBinHeader *)(m_file.GetData() + m_offsetBin))
+            ->count;
+}
+
+const wxUint32 *HeaderCacheFile::GetFileUIds() const
+{
+   return (const wxUint32 *)(m_file.GetData() + m_offsetBin +
+                             sizeof(HeaderCacheBinHeader));
+}
+
+const char *HeaderCacheFile::GetFileRecord(size_t n) const
+{
+   const size_t count = GetFileCount();
+   CHECK( n < count, NULL, _T("invalid header cache record index") );
+
+   const wxUint32 *offsets = GetFileUIds() + count;
+   const char *records = (const char *)(offsets + count);
+   const size_t sizeRecords = m_file.GetData() + m_file.GetSize() - records;
+
+   const wxUint32 offset = offsets[n];
+
+   // as in Load(), compare with the remaining size to avoid overflows
+   HeaderCacheRecord rec;
+   if ( offset > sizeRecords || sizeRecords - offset < sizeof(rec) )
+      return NULL;
+
+   memcpy(&rec, records + offset, sizeof(rec));
+   if ( rec.len < sizeof(rec) || rec.len > sizeRecords - offset )
+      return NULL;
+
+   return records + offset;
+}
+
+const char *HeaderCacheFile::FindRecord(UIdType uid) const
+{
+   AddedMap::const_iterator i = m_offsetsAdded.find(uid);
+   if ( i != m_offsetsAdded.end() )
+      return &m_added[i->second];
+
+   const size_t count = GetFileCount();
+   if ( !count )
+      return NULL;
+
+   const wxUint32 *uids = GetFileUIds();
+   const wxUint32 *p = std::lower_bound(uids, uids + count, uid);
+   if ( p == uids + count || *p != uid )
+      return NULL;
+
+   return GetFileRecord(p - uids);
+}
+
+bool HeaderCacheFile::Get(UIdType uid, HeaderInfo& hi) const
+{
+   const char *p = FindRecord(uid);
+   if ( !p )
+      return false;
+
+   HeaderCacheRecord rec;
+   memcpy(&rec, p, sizeof(rec));
+
+   const char * const end = p + rec.len;
+   p += sizeof(rec);
+
+   if ( !ReadString(p, end, hi.m_Subject) ||
+        !ReadString(p, end, hi.m_From) ||
+        !ReadString(p, end, hi.m_To) ||
+        !ReadString(p, end, hi.m_NewsGroups) ||
+        !ReadString(p, end, hi.m_References) ||
+        !ReadString(p, end, hi.m_InReplyTo) ||
+        !ReadString(p, end, hi.m_Id) )
+   {
+      wxLogDebug(_T("Corrupted header cache record for UID %lu"), uid);
+
+      return false;
+   }
+
+   hi.m_Status = rec.status;
+   hi.m_Size = rec.size;
+   hi.m_Lines = rec.lines;
+   hi.m_Date = (time_t)rec.date;
+   hi.m_Encoding = (wxFontEncoding)rec.encoding;
+   hi.m_UId = uid;
+
+   return true;
+}
+
+void HeaderCacheFile::Add(const HeaderInfo& hi)
+{
+   CHECK_RET( hi.IsValid(), _T("can't cache invalid header") );
+
+   const size_t offset = m_added.size();
+
+   HeaderCacheRecord rec;
+   rec.len = 0;
+   rec.status = hi.m_Status;
+   rec.size = hi.m_Size;
+   rec.lines = hi.m_Lines;
+   rec.encoding = hi.m_Encoding;
+   rec.date = hi.m_Date;
+
+   const char *prec = (const char *)&rec;
+   m_added.insert(m_added.end(), prec, prec + sizeof(rec));
+
+   WriteString(m_added, hi.m_Subject);
+   WriteString(m_added, hi.m_From);
+   WriteString(m_added, hi.m_To);
+   WriteString(m_added, hi.m_NewsGroups);
+   WriteString(m_added, hi.m_References);
+   WriteString(m_added, hi.m_InReplyTo);
+   WriteString(m_added, hi.m_Id);
+
+   // now that we know it, fill in the record length
+   const wxUint32 len = m_added.size() - offset;
+   memcpy(&m_added[offset], &len, sizeof(len));
+
+   // if we already had a record for this UID, it's simply wasted
+   m_offsetsAdded[hi.m_UId] = offset;
+}
+
+// ----------------------------------------------------------------------------
+// saving
+// ----------------------------------------------------------------------------
+
+bool HeaderCacheFile::Flush(const UIdIndex *uids)
+{
+   // merge the records from the file with the new ones, both are sorted
+   const size_t countFile = GetFileCount();
+   const wxUint32 *uidsFile = countFile ? GetFileUIds() : NULL;
+
+   m_toSave.clear();
+   m_toSave.reserve(countFile + m_offsetsAdded.size());
+
+   bool removedAny = false;
+
+   size_t n = 0;
+   AddedMap::const_iterator i = m_offsetsAdded.begin();
+   while ( n < countFile || i != m_offsetsAdded.end() )
+   {
+      RecordToSave rec;
+      if ( i == m_offsetsAdded.end() || (n < countFile && uidsFile[n] < i->first) )
+      {
+         rec.uid = uidsFile[n];
+         rec.data = GetFileRecord(n++);
+         if ( !rec.data )
+         {
+            removedAny = true;
+            continue;
+         }
+      }
+      else
+      {
+         // the new record replaces the old one, if any
+         if ( n < countFile && uidsFile[n] == i->first )
+            n++;
+
+         rec.uid = i->first;
+         rec.data = &m_added[i->second];
+         ++i;
+      }
+
+      if ( uids && uids->Find(rec.uid) == MSGNO_ILLEGAL )
+      {
+         // this message was expunged, no need to keep it
+         removedAny = true;
+         continue;
+      }
+
+      m_toSave.push_back(rec);
+   }
+
+   // don't rewrite the file if nothing changed
+   bool ok = true;
+   if ( removedAny || !m_offsetsAdded.empty() )
+      ok = Save();
+
+   m_toSave.clear();
+
+   return ok;
+}
+
+bool HeaderCacheFile::Save()
+{
+   String filename = GetFileName();
+
+   if ( !CreateDirFor(filename) )
+      return false;
+
+   wxTempFile file;
+   bool ok = file.Open(filename);
+
+   // write header, padding it to the multiple of 8 bytes
+   if ( ok )
+      ok = WriteBinaryHeader(file) != 0;
+
+   const wxUint32 count = m_toSave.size();
+   if ( ok )
+   {
+      HeaderCacheBinHeader hdr;
+      hdr.magic = HEADER_CACHE_MAGIC;
+      hdr.uidValidity = m_uidValidity;
+      hdr.count = count;
+      hdr.reserved = 0;
+
+      ok = file.Write(&hdr, sizeof(hdr));
+   }
+
+   // write the tables of UIDs and offsets
+   if ( ok )
+   {
+      std::vector<wxUint32> table(2*count);
+
+      wxUint32 offsetRec = 0;
+      for ( wxUint32 n = 0; n < count; n++ )
+      {
+         const RecordToSave& rec = m_toSave[n];
+
+         HeaderCacheRecord hdr;
+         memcpy(&hdr, rec.data, sizeof(hdr));
+
+         table[n] = rec.uid;
+         table[count + n] = offsetRec;
+
+         offsetRec += hdr.len;
+      }
+
+      ok = !count || file.Write(&table[0], table.size()*sizeof(wxUint32));
+   }
+
+   // and the records themselves
+   for ( wxUint32 n = 0; ok && n < count; n++ )
+   {
+      const RecordToSave& rec = m_toSave[n];
+
+      HeaderCacheRecord hdr;
+      memcpy(&hdr, rec.data, sizeof(hdr));
+
+      ok = file.Write(rec.data, hdr.len);
+   }
+
+   if ( ok )
+   {
+      ok = file.Commit();
+   }
+
+   if ( !ok )
+   {
+      wxLogError(_("Failed to write header cache file for folder '%s'."),
+                 m_folderName);
+
+      return false;
+   }
+
+   return true;
+}
@@ -531,6 +531,11 @@ HeaderInfoListImpl::HeaderInfoListImpl(MailFolder *mf)
    m_count = mf->GetMessageCount();
    m_headers.Alloc(m_count);
 
+   // the sort keys will be computed when we need them and the messages will
+   // be inserted into the threads when they're threaded for the first time
+   m_sortKeys.OnAdd(m_count);
+   m_threader.OnAdd(m_count);
+
    // no sorting/threading yet
    m_sizeTables = 0;
    m_tableSort =
@@ -555,6 +560,9 @@ void HeaderInfoListImpl::CleanUp()
 
    m_lastMod++;
 
+   m_sortKeys.Clear();
+   m_threader.Clear();
+
    FreeSortAndThreadData();
 }
 
@@ -755,6 +763,10 @@ void HeaderInfoListImpl::OnRemove(MsgnoType n)
    }
    //else: we have never looked that far
 
+   // the sort keys are always updated, this is cheap
+   m_sortKeys.OnRemove(n);
+   m_threader.OnRemove(n);
+
    /*
       In a normal situation (m_sizeTables == m_count) we update the existing
       sort/thread data, if any as it is less expensive to do it here than to
@@ -1101,6 +1113,12 @@ void HeaderInfoListImpl::OnAdd(MsgnoType countNew)
 
    m_count = countNew;
 
+   // the existing sort keys remain valid, only make place for the new ones:
+   // this allows MailFolder::SortMessages() to only sort the new messages
+   // and, similarly, MailFolder::ThreadMessages() to only thread them
+   m_sortKeys.OnAdd(countNew);
+   m_threader.OnAdd(countNew);
+
    // we probably don't need to do m_headers.Alloc() as countNew shouldn't be
    // much bigger than old count
 }
@@ -1703,6 +1721,16 @@ bool HeaderInfoListImpl::Sort()
    return true;
 }
 
+MsgSortKeys *HeaderInfoListImpl::GetSortKeys()
+{
+   return &m_sortKeys;
+}
+
+MsgThreader *HeaderInfoListImpl::GetThreader()
+{
+   return &m_threader;
+}
+
 // check if a sort order includes MSO_SENDER
 static bool UsesSenderForSorting(long sortOrder)
 {
@@ -24,8 +24,10 @@
    #include "Mcommon.h"
 
    #include <wx/wxchar.h>
+   #include <wx/log.h>           // for wxLogNull
 #endif // USE_PCH
 
+#include <wx/file.h>
 #include <wx/textfile.h>
 
 #include "MEvent.h"
@@ -33,6 +35,8 @@
 #include "MFCache.h"
 #include "MFStatus.h"
 
+#include <vector>
+
 // ----------------------------------------------------------------------------
 // constants
 // ----------------------------------------------------------------------------
@@ -49,10 +53,85 @@ enum CacheFileFormat
 {
    CacheFile_1_0,    // name:total:unread:flagged
    CacheFile_1_1,    // name:total:new:unread:flagged
-   CacheFile_Current = CacheFile_1_1,
+   CacheFile_2_0,    // binary, see MfStatusRecord
+   CacheFile_Current = CacheFile_2_0,
    CacheFile_Max
 };
 
+// the value written at the start of the binary part, allows to detect the
+// files created on the machines with different endianness
+static const wxUint32 MFSTATUS_CACHE_MAGIC = 0x4d465343;   // "MFSC"
+
+// the binary file header
+struct MfStatusBinHeader
+{
+   wxUint32 magic;
+   wxUint32 reserved;
+};
+
+// the kinds of records in the binary file
+enum MfStatusRecordKind
+{
+   MfStatusRecord_Set,        // set the status of the folder
+   MfStatusRecord_Invalidate  // forget the status of the folder
+};
+
+// the fixed part of a record: it is followed by the UTF-8 folder name
+//
+// NB: the records are not aligned, always use memcpy() to access them
+struct MfStatusRecord
+{
+   wxUint32 len;           // total length of the record
+   wxUint32 kind;          // one of MfStatusRecordKind values
+   wxUint32 total;
+   wxUint32 newmsgs;
+   wxUint32 unread;
+   wxUint32 flagged;
+};
+
+// don't compact the file until it has at least that many obsolete records
+static const size_t MFSTATUS_COMPACT_MIN = 256;
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// append the record for the given folder to the buffer
+static void WriteRecord(std::vector<char>& buf,
+                        const String& name,
+                        const MailFolderStatus& status)
+{
+   const wxCharBuffer utf8(name.ToUTF8());
+   const char *p = utf8.data();
+   const size_t len = p ? strlen(p) : 0;
+
+   // note that we don't remember the number of recent messages because they
+   // won't be recent the next time we run anyhow nor the number of messages
+   // matching the search criteria as this is hardly ever useful
+   MfStatusRecord rec;
+   rec.len = sizeof(rec) + len;
+   if ( status.IsValid() )
+   {
+      rec.kind = MfStatusRecord_Set;
+      rec.total = status.total;
+      rec.newmsgs = status.newmsgs;
+      rec.unread = status.unread;
+      rec.flagged = status.flagged;
+   }
+   else
+   {
+      rec.kind = MfStatusRecord_Invalidate;
+      rec.total =
+      rec.newmsgs =
+      rec.unread =
+      rec.flagged = 0;
+   }
+
+   const char *prec = (const char *)&rec;
+   buf.insert(buf.end(), prec, prec + sizeof(rec));
+   buf.insert(buf.end(), p, p + len);
+}
+
 // ----------------------------------------------------------------------------
 // globals
 // ----------------------------------------------------------------------------
@@ -90,9 +169,13 @@ void MfStatusCache::CleanUp()
 
 MfStatusCache::MfStatusCache()
 {
+   m_sizeFile =
+   m_countFileRecords = 0;
+   m_needsCompaction = false;
+
    Load();
 
-   // register for folder rename events
+   // register for folder rename and delete events
    m_evtmanHandle = MEventManager::Register(*this, MEventId_FolderTreeChange);
 
    // no changes yet
@@ -107,10 +190,10 @@ MfStatusCache::~MfStatusCache()
       MEventManager::Deregister(m_evtmanHandle);
    }
 
-   Save();
-
-   // delete the elements too
-   WX_CLEAR_ARRAY(m_folderData);
+   // save the changes, if any, and also convert the file to the binary
+   // format if it was in the old one
+   if ( m_isDirty || m_needsCompaction )
+      Save();
 }
 
 // ----------------------------------------------------------------------------
@@ -120,20 +203,67 @@ MfStatusCache::~MfStatusCache()
 bool MfStatusCache::OnMEvent(MEventData& ev)
 {
    MEventFolderTreeChangeData& event = (MEventFolderTreeChangeData&)ev;
-   if ( event.GetChangeKind() == MEventFolderTreeChangeData::Rename )
+   switch ( event.GetChangeKind() )
    {
-      // keep the status cache entry for the old folder
-      int index = m_folderNames.Index(event.GetFolderFullName());
-      if ( index != wxNOT_FOUND )
-      {
-         m_folderNames[index] = event.GetNewFolderName();
-      }
+      case MEventFolderTreeChangeData::Rename:
+         // keep the status cache entries for the old folder
+         OnFolderRemoved(event.GetFolderFullName(), event.GetNewFolderName());
+         break;
+
+      case MEventFolderTreeChangeData::Delete:
+         OnFolderRemoved(event.GetFolderFullName(), wxEmptyString);
+         break;
+
+      default:
+         // nothing to do
+         ;
    }
 
    // continue with the event processing
    return true;
 }
 
+void MfStatusCache::OnFolderRemoved(const String& folderName,
+                                    const String& newName)
+{
+   // the subfolders of this folder are affected as well, but we can't
+   // modify the hash map while iterating over it, so find them first
+   const String prefix = folderName + _T('/');
+
+   wxArrayString names;
+   for ( MfStatusMap::const_iterator i = m_status.begin();
+         i != m_status.end();
+         ++i )
+   {
+      if ( i->second.status.IsValid() &&
+            (i->first == folderName || i->first.StartsWith(prefix)) )
+      {
+         names.Add(i->first);
+      }
+   }
+
+   const size_t count = names.GetCount();
+   for ( size_t n = 0; n < count; n++ )
+   {
+      MfStatusCacheEntry& entry = m_status[names[n]];
+      const MailFolderStatus status = entry.status;
+
+      entry.status.total = UID_ILLEGAL;
+      entry.isDirty = true;
+
+      if ( !newName.empty() )
+      {
+         MfStatusCacheEntry&
+            entryNew = m_status[newName + names[n].substr(folderName.length())];
+         entryNew.status = status;
+         entryNew.isDirty = true;
+      }
+   }
+
+   if ( count )
+      m_isDirty = true;
+}
+
 // ----------------------------------------------------------------------------
 // MfStatusCache data access
 // ----------------------------------------------------------------------------
@@ -141,8 +271,8 @@ bool MfStatusCache::OnMEvent(MEventData& ev)
 bool MfStatusCache::GetStatus(const String& folderName,
                               MailFolderStatus *status)
 {
-   int n = m_folderNames.Index(folderName);
-   if ( n == wxNOT_FOUND || !m_folderData[(size_t)n]->IsValid() )
+   MfStatusMap::const_iterator i = m_status.find(folderName);
+   if ( i == m_status.end() || !i->second.status.IsValid() )
    {
       // no status or at least no valid status
       return false;
@@ -150,7 +280,7 @@ bool MfStatusCache::GetStatus(const String& folderName,
 
    if ( status )
    {
-      *status = *m_folderData[(size_t)n];
+      *status = i->second.status;
    }
 
    return true;
@@ -161,21 +291,21 @@ void MfStatusCache::UpdateStatus(const String& folderName,
 {
    CHECK_RET( status.IsValid(), _T("invalid status in MfStatusCache") );
 
-   int n = m_folderNames.Index(folderName);
-   if ( n == wxNOT_FOUND )
+   MfStatusMap::iterator i = m_status.find(folderName);
+   if ( i == m_status.end() )
    {
       wxLogTrace(M_TRACE_MFSTATUS,
                  _T("Added status for '%s' (%lu total, %lu unread)"),
                  folderName, status.total, status.unread);
 
       // add it
-      n = m_folderNames.Add(folderName);
-      m_folderData.Insert(new MailFolderStatus, (size_t)n);
+      i = m_status.insert(MfStatusMap::value_type(folderName,
+                                                  MfStatusCacheEntry())).first;
    }
    else // already have it
    {
       // did it really change?
-      if ( *m_folderData[(size_t)n] == status )
+      if ( i->second.status == status )
       {
          // no, avoid sending the event below
          return;
@@ -187,7 +317,8 @@ void MfStatusCache::UpdateStatus(const String& folderName,
    }
 
    // update
-   *m_folderData[(size_t)n] = status;
+   i->second.status = status;
+   i->second.isDirty = true;
    m_isDirty = true;
 
    // and tell everyone about it
@@ -199,14 +330,15 @@ void MfStatusCache::InvalidateStatus(const String& folderName)
    wxLogTrace(M_TRACE_MFSTATUS, _T("Invalidated status for '%s'"),
               folderName);
 
-   int n = m_folderNames.Index(folderName);
-   if ( n != wxNOT_FOUND )
+   MfStatusMap::iterator i = m_status.find(folderName);
+   if ( i != m_status.end() && i->second.status.IsValid() )
    {
       // don't remove it because chances are that an UpdateStatus() for the
       // same folder will follow soon (as we typically invalidate the status
       // when noticing new mail in the folder and then update it as soon as we
       // know how many new messages we have got) but just invalidate for now
-      m_folderData[(size_t)n]->total = UID_ILLEGAL;
+      i->second.status.total = UID_ILLEGAL;
+      i->second.isDirty = true;
 
       m_isDirty = true;
    }
@@ -220,9 +352,10 @@ void MfStatusCache::InvalidateStatus(const String& folderName)
 // ----------------------------------------------------------------------------
 
 /*
-   We use a simple text file for cache right now - if this proves to be too
-   slow or disk space consuming, we can always switch to something more
-   efficient here, the only methods to change are those below.
+   We used a simple text file for the cache initially but rewriting it
+   entirely whenever any folder status changed was too slow with many folders,
+   so now a binary file to which the changes are appended is used. The text
+   file is still read by DoLoad() if we find it.
  */
 
 String MfStatusCache::GetFileName() const
@@ -240,7 +373,108 @@ String MfStatusCache::GetFileHeader() const
 
 int MfStatusCache::GetFormatVersion() const
 {
-   return BuildVersion(1, 1);
+   return BuildVersion(2, 0);
+}
+
+bool MfStatusCache::Load()
+{
+   // we'll need to rewrite the file unless we can read it in binary format
+   m_needsCompaction = true;
+
+   MappedCacheFile file;
+   if ( !file.Open(GetFileName()) )
+   {
+      // cache file can perfectly well not exist, it's not an error
+      return true;
+   }
+
+   int version;
+   const size_t offset = CheckBinaryHeader(file, &version);
+   if ( !offset )
+   {
+      // invalid or more recent file, it will be overwritten
+      return true;
+   }
+
+   if ( version < BuildVersion(2, 0) )
+   {
+      // this is the file in the old text format, read it in the old way, it
+      // will be converted to the new format when we're saved the next time
+      file.Close();
+
+      return CacheFile::Load();
+   }
+
+   return LoadBinary(file, offset);
+}
+
+bool MfStatusCache::LoadBinary(const MappedCacheFile& file, size_t offset)
+{
+   const char *p = file.GetData() + offset;
+   const char * const end = file.GetData() + file.GetSize();
+
+   MfStatusBinHeader hdr;
+   if ( end - p < (ptrdiff_t)sizeof(hdr) )
+      return true;
+
+   memcpy(&hdr, p, sizeof(hdr));
+   if ( hdr.magic != MFSTATUS_CACHE_MAGIC )
+   {
+      wxLogDebug(_T("Corrupted folder status cache file \"%s\""),
+                 GetFileName());
+
+      return true;
+   }
+
+   p += sizeof(hdr);
+
+   // replay all the records in order, the later ones override the earlier
+   // ones for the same folder
+   size_t count = 0;
+   while ( p != end )
+   {
+      MfStatusRecord rec;
+      if ( end - p < (ptrdiff_t)sizeof(rec) )
+         break;
+
+      memcpy(&rec, p, sizeof(rec));
+      if ( rec.len < sizeof(rec) || (size_t)(end - p) < rec.len )
+         break;
+
+      MfStatusCacheEntry&
+         entry = m_status[String::FromUTF8(p + sizeof(rec),
+                                           rec.len - sizeof(rec))];
+      if ( rec.kind == MfStatusRecord_Set )
+      {
+         entry.status.total = rec.total;
+         entry.status.newmsgs = rec.newmsgs;
+         entry.status.unread = rec.unread;
+         entry.status.flagged = rec.flagged;
+      }
+      else // MfStatusRecord_Invalidate
+      {
+         entry.status = MailFolderStatus();
+      }
+
+      p += rec.len;
+      count++;
+   }
+
+   m_sizeFile = file.GetSize();
+   m_countFileRecords = count;
+
+   if ( p != end )
+   {
+      // this can happen if we crashed while appending to the file, just
+      // ignore the incomplete record and rewrite the file without it
+      wxLogDebug(_T("Ignoring truncated record in the folder status cache."));
+
+      return true;
+   }
+
+   m_needsCompaction = false;
+
+   return true;
 }
 
 bool MfStatusCache::DoLoad(const wxTextFile& file, int version)
@@ -339,8 +573,7 @@ bool MfStatusCache::DoLoad(const wxTextFile& file, int version)
          folder->DecRef();
 
          // do add the entry to the cache
-         size_t entry = m_folderNames.Add(name);
-         m_folderData.Insert(new MailFolderStatus(status), entry);
+         m_status[name].status = status;
       }
       else
       {
@@ -363,16 +596,36 @@ bool MfStatusCache::DoLoad(const wxTextFile& file, int version)
 bool MfStatusCache::Save()
 {
    // avoid doing anything if we don't have anything to cache
-   if ( !m_folderNames.IsEmpty() )
+   if ( !m_status.empty() )
    {
-      if ( !CacheFile::Save() )
+      // count the entries in the file after appending the changes to it
+      size_t countValid = 0,
+             countDirty = 0;
+      for ( MfStatusMap::const_iterator i = m_status.begin();
+            i != m_status.end();
+            ++i )
       {
-         // set a flag to indicate that we shouldn't be called any more by
-         // Flush() -- but we'll still be called from our dtor for one last
-         // attempt to save our contents
-         m_hasFailedToSave = true;
+         if ( i->second.status.IsValid() )
+            countValid++;
+         if ( i->second.isDirty )
+            countDirty++;
+      }
+
+      // if there are too many obsolete records in the file, rewrite it
+      if ( m_countFileRecords + countDirty > 2*countValid + MFSTATUS_COMPACT_MIN )
+         m_needsCompaction = true;
 
-         return false;
+      if ( m_needsCompaction || !AppendChanges() )
+      {
+         if ( !Compact() )
+         {
+            // set a flag to indicate that we shouldn't be called any more by
+            // Flush() -- but we'll still be called from our dtor for one last
+            // attempt to save our contents
+            m_hasFailedToSave = true;
+
+            return false;
+         }
       }
    }
 
@@ -382,46 +635,135 @@ bool MfStatusCache::Save()
    return true;
 }
 
-bool MfStatusCache::DoSave(wxTempFile& file)
+bool MfStatusCache::AppendChanges()
 {
-   wxString str, name;
-   str.reserve(1024);
-   name.reserve(512);
+   std::vector<char> buf;
+   size_t count = 0;
+   for ( MfStatusMap::const_iterator i = m_status.begin();
+         i != m_status.end();
+         ++i )
+   {
+      if ( i->second.isDirty )
+      {
+         WriteRecord(buf, i->first, i->second.status);
+         count++;
+      }
+   }
 
-   // write data
-   size_t count = m_folderNames.GetCount();
-   for ( size_t n = 0; n < count; n++ )
+   if ( buf.empty() )
+      return true;
+
+   wxLogNull noLog;
+
+   // check that the file is still the same one we had written, if it isn't
+   // (or anything else goes wrong) we'll just rewrite it entirely
+   wxFile file;
+   if ( !file.Open(GetFileName(), wxFile::write_append) ||
+         file.Length() != (wxFileOffset)m_sizeFile ||
+          file.Write(&buf[0], buf.size()) != buf.size() ||
+           !file.Close() )
    {
-      const MailFolderStatus *status = m_folderData[n];
-
-      // double all delimiters in the folder name
-      name = m_folderNames[n];
-      name.Replace(CACHE_DELIMITER, CACHE_DELIMITER CACHE_DELIMITER);
-
-      // and write info to file: note that we don't remember the number of
-      // recent messages because they won't be recent the next time we run
-      // anyhow nor the number of messages matching the search criteria as
-      // this is hardly ever useful
-      str.Printf(_T("%s") CACHE_DELIMITER
-                 _T("%lu") CACHE_DELIMITER
-                 _T("%lu") CACHE_DELIMITER
-                 _T("%lu") CACHE_DELIMITER
-                 _T("%lu\n"),
-                 name,
-                 status->total,
-                 status->newmsgs,
-                 status->unread,
-                 status->flagged);
-
-      if ( !file.Write(str) )
+      return false;
+   }
+
+   wxLogTrace(M_TRACE_MFSTATUS, _T("Appended %lu records to status cache"),
+              (unsigned long)count);
+
+   m_sizeFile += buf.size();
+   m_countFileRecords += count;
+
+   for ( MfStatusMap::iterator i = m_status.begin(); i != m_status.end(); ++i )
+   {
+      i->second.isDirty = false;
+   }
+
+   return true;
+}
+
+bool MfStatusCache::Compact()
+{
+   String filename = GetFileName();
+
+   if ( !CreateDirFor(filename) )
+      return false;
+
+   wxTempFile file;
+   bool ok = file.Open(filename);
+
+   size_t size = 0;
+   if ( ok )
+   {
+      size = WriteBinaryHeader(file);
+      ok = size != 0;
+   }
+
+   if ( ok )
+   {
+      MfStatusBinHeader hdr;
+      hdr.magic = MFSTATUS_CACHE_MAGIC;
+      hdr.reserved = 0;
+
+      ok = file.Write(&hdr, sizeof(hdr));
+      size += sizeof(hdr);
+   }
+
+   // write only the valid entries, there is no need to keep the other ones
+   size_t count = 0;
+   if ( ok )
+   {
+      std::vector<char> buf;
+      for ( MfStatusMap::const_iterator i = m_status.begin();
+            i != m_status.end();
+            ++i )
       {
-         return false;
+         if ( i->second.status.IsValid() )
+         {
+            WriteRecord(buf, i->first, i->second.status);
+            count++;
+         }
       }
+
+      ok = buf.empty() || file.Write(&buf[0], buf.size());
+      size += buf.size();
+   }
+
+   if ( ok )
+   {
+      ok = file.Commit();
+   }
+
+   if ( !ok )
+   {
+      wxLogMessage(_("Some non vital information could be lost, please "
+                     "try to correct the problem and restart the program."));
+
+      wxLogError(_("Failed to write cache file."));
+
+      return false;
+   }
+
+   wxLogTrace(M_TRACE_MFSTATUS, _T("Compacted status cache to %lu records"),
+              (unsigned long)count);
+
+   m_sizeFile = size;
+   m_countFileRecords = count;
+   m_needsCompaction = false;
+
+   for ( MfStatusMap::iterator i = m_status.begin(); i != m_status.end(); ++i )
+   {
+      i->second.isDirty = false;
    }
 
    return true;
 }
 
+bool MfStatusCache::DoSave(wxTempFile& /* file */)
+{
+   FAIL_MSG( _T("MfStatusCache doesn't use text format any more") );
+
+   return false;
+}
+
 /* static */
 void MfStatusCache::Flush()
 {
@@ -40,6 +40,7 @@
 #include "MThread.h"
 
 #include "MFPrivate.h"
+#include "MailFolderCmn.h"
 #include "mail/Driver.h"
 #include "mail/FolderPool.h"
 #include "mail/MimeDecode.h"
@@ -396,6 +397,32 @@ bool MailFolder::PingAllOpened(wxFrame *frame)
    return rc;
 }
 
+/* static */
+bool MailFolder::IndexNewMailInOpened()
+{
+   // index just a few messages at once to keep the GUI responsive
+   static const size_t INDEX_AT_ONCE = 10;
+
+   bool more = false;
+
+   MFPool::Cookie cookie;
+   for ( MailFolder *mf = MFPool::GetFirst(cookie);
+         mf;
+         mf = MFPool::GetNext(cookie) )
+   {
+      // don't wait for the folder which is currently busy
+      if ( !mf->IsLocked() &&
+               ((MailFolderCmn *)mf)->IndexSomeNewMail(INDEX_AT_ONCE) )
+      {
+         more = true;
+      }
+
+      mf->DecRef();
+   }
+
+   return more;
+}
+
 /* static */
 bool
 MailFolder::CheckFolder(const MFolder *folder, wxFrame *frame)
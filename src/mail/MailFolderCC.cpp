@@ -66,6 +66,9 @@
 #include "MFPrivate.h"
 #include "mail/Driver.h"
 #include "mail/FolderPool.h"
+#include "mail/HeaderCache.h"
+#include "mail/MailThreadPool.h"
+#include "mail/MessageAppender.h"
 #include "mail/MimeDecode.h"
 #include "mail/ServerInfo.h"
 
@@ -73,6 +76,8 @@
 // wxFile::Exists() too
 #include <wx/file.h>
 
+#include <vector>
+
 class MPersMsgBox;
 
 // windows.h included from fontutil.h defines ERROR
@@ -98,7 +103,7 @@ extern "C"
    #undef LOCAL         // before including imap4r1.h which defines it too
 
    #define namespace cc__namespace
-   #include <imap4r1.h> // for LEVELSORT/THREAD in CanSort()/Thread()
+   #include <imap4r1.h> // for LEVELSORT/THREAD in CanSort()/Thread() and IDLE
    #undef namespace
 }
 
@@ -106,9 +111,17 @@ extern "C"
 #undef CreateDialog
 
 #define USE_READ_PROGRESS
-//#define USE_BLOCK_NOTIFY
 
-#ifdef USE_BLOCK_NOTIFY
+// block notifications are used to let the other threads use c-client while
+// a worker thread waits for the server, see MailLock::SuspendForIO()
+#if wxUSE_THREADS
+   #define USE_BLOCK_NOTIFY
+#endif
+
+// define this to log all block notifications
+//#define DEBUG_BLOCK_NOTIFY
+
+#ifdef DEBUG_BLOCK_NOTIFY
    #include <wx/datetime.h>
 #endif
 
@@ -152,6 +165,12 @@ extern const MPersMsgBox *M_MSGBOX_NO_NET_PING_ANYWAY;
 /// invalid value for MailFolderCC::m_chDelimiter
 #define ILLEGAL_DELIMITER ((char)-1)
 
+/// the status items we need when checking the folders for new mail
+static const int STATUS_FLAGS = SA_MESSAGES | SA_RECENT | SA_UNSEEN;
+
+/// IDLE must be reissued at least every 29 minutes according to RFC 2177
+static const time_t IDLE_RESTART_INTERVAL = 25*60;
+
 // ----------------------------------------------------------------------------
 // trace masks used (you have to wxLog::AddTraceMask() to enable the
 // correpsonding kind of messages)
@@ -266,6 +285,13 @@ extern "C"
 #endif
 };
 
+#ifdef USE_BLOCK_NOTIFY
+
+// the block notification callback installed by c-client itself
+static blocknotify_t gs_defaultBlockNotify = NULL;
+
+#endif // USE_BLOCK_NOTIFY
+
 namespace
 {
 
@@ -404,7 +430,12 @@ private:
    public:
       ConnCloseTimer() { }
 
-      virtual void Notify() { ServerInfoEntryCC::CheckTimeoutAll(); }
+      virtual void Notify()
+      {
+         MailLocker lock;
+
+         ServerInfoEntryCC::CheckTimeoutAll();
+      }
 
    private:
       DECLARE_NO_COPY_CLASS(ConnCloseTimer)
@@ -969,6 +1000,22 @@ public:
    }
 };
 
+// return true if the NETMBX we have refers to the same remote mailbox as the
+// one from c-client callback
+static bool IsSameNetMailbox(const NETMBX& mbxOur, const NETMBX& mbx)
+{
+   // FIXME: how to compare the hosts? many servers are multi homed so
+   //        neither string nor IP address comparison works!
+   //
+   // the way to fix it is probably use mail_open() before
+   // mail_status() and compare MAILSTREAMs instead of NETMBXs
+   return // !strcmp(mbxOur.host, mbx.host) &&
+          !strcmp(mbxOur.user, mbx.user) &&
+          !strcmp(mbxOur.mailbox, mbx.mailbox) &&
+          !strcmp(mbxOur.service, mbx.service) &&
+          (!mbxOur.port || (mbxOur.port == mbx.port));
+}
+
 // temporarily redirect mm_status callbacks and only remember the info they
 // provide in the given MAILSTATUS object instead of performing the usual
 // processing
@@ -1052,18 +1099,8 @@ private:
          // what have we got?
          if ( filename.empty() )
          {
-            // FIXME: how to compare the hosts? many servers are multi homed so
-            //        neither string nor IP address comparison works!
-            //
-            // the way to fix it is probably use mail_open() before
-            // mail_status() and compare MAILSTREAMs instead of NETMBXs
-
             // remote spec
-            if ( // strcmp(ms_mbx.host, mbx.host) ||
-                 strcmp(ms_mbx.user, mbx.user) ||
-                 strcmp(ms_mbx.mailbox, mbx.mailbox) ||
-                 strcmp(ms_mbx.service, mbx.service) ||
-                 (ms_mbx.port && (ms_mbx.port != mbx.port)) )
+            if ( !IsSameNetMailbox(ms_mbx, mbx) )
             {
                // skip the assignment below
                return;
@@ -1087,6 +1124,125 @@ String MMStatusRedirector::ms_filename;
 NETMBX MMStatusRedirector::ms_mbx;
 MAILSTATUS *MMStatusRedirector::ms_mailstatus = NULL;
 
+// the same as MMStatusRedirector but for several remote mailboxes at once,
+// used when checking the status of many folders on the same server
+class MMStatusCollector
+{
+public:
+   MMStatusCollector()
+   {
+      ms_collector = this;
+
+      gs_mmStatusRedirect = MMStatusCollectorHandler;
+   }
+
+   ~MMStatusCollector()
+   {
+      gs_mmStatusRedirect = NULL;
+
+      ms_collector = NULL;
+   }
+
+   // remember the status of the given mailbox in mailstatus
+   void Add(const char *mailbox, MAILSTATUS *mailstatus)
+   {
+      memset(mailstatus, 0, sizeof(*mailstatus));
+
+      Mailbox mbx;
+      if ( !mail_valid_net_parse((char *)mailbox, &mbx.netmbx) )
+      {
+         FAIL_MSG( _T("c-client failed to parse our spec?") );
+         return;
+      }
+
+      mbx.mailstatus = mailstatus;
+      m_mailboxes.push_back(mbx);
+   }
+
+private:
+   struct Mailbox
+   {
+      NETMBX netmbx;
+      MAILSTATUS *mailstatus;
+   };
+
+   static void MMStatusCollectorHandler(MAILSTREAM * /* stream */,
+                                        const char *name,
+                                        MAILSTATUS *mailstatus)
+   {
+      NETMBX mbx;
+      if ( !mail_valid_net_parse((char *)name, &mbx) )
+      {
+         FAIL_MSG( _T("c-client failed to parse its own spec?") );
+         return;
+      }
+
+      std::vector<Mailbox>& mailboxes = ms_collector->m_mailboxes;
+      for ( size_t n = 0; n < mailboxes.size(); n++ )
+      {
+         if ( IsSameNetMailbox(mailboxes[n].netmbx, mbx) )
+         {
+            memcpy(mailboxes[n].mailstatus, mailstatus, sizeof(*mailstatus));
+            break;
+         }
+      }
+   }
+
+   std::vector<Mailbox> m_mailboxes;
+
+   static MMStatusCollector *ms_collector;
+};
+
+MMStatusCollector *MMStatusCollector::ms_collector = NULL;
+
+// ----------------------------------------------------------------------------
+// FolderWatch: a connection idling in the folder we watch for new mail
+// ----------------------------------------------------------------------------
+
+class FolderWatch
+{
+public:
+   FolderWatch(const MFolder *folder, const String& spec, MAILSTREAM *stream)
+      : m_spec(spec)
+   {
+      m_folder = (MFolder *)folder; // const_cast needed for IncRef()/DecRef()
+      m_folder->IncRef();
+
+      m_stream = stream;
+      m_timeStart = time(NULL);
+   }
+
+   ~FolderWatch()
+   {
+      // this stream doesn't belong to any MailFolderCC
+      CCCallbackDisabler noCallbacks;
+
+      mail_close(m_stream);
+
+      m_folder->DecRef();
+   }
+
+   // the folder being watched
+   MFolder *m_folder;
+
+   // the spec used to open it
+   String m_spec;
+
+   // the stream idling in it
+   MAILSTREAM *m_stream;
+
+   // when did the current IDLE command start
+   time_t m_timeStart;
+
+private:
+   DECLARE_NO_COPY_CLASS(FolderWatch)
+};
+
+M_LIST_OWN(FolderWatchList, FolderWatch);
+
+/// all folders currently watched using IDLE
+static FolderWatchList *gs_folderWatches = NULL;
+
 // ----------------------------------------------------------------------------
 // ReadProgressInfo: create an instance of this object to start showing progress
 // info, delete it to make it disappear
@@ -1705,6 +1861,8 @@ void MailFolderCC::Init()
    m_InCritical = false;
 
    m_chDelimiter = ILLEGAL_DELIMITER;
+
+   m_headerCache = NULL;
 }
 
 MailFolderCC::~MailFolderCC()
@@ -2282,6 +2440,18 @@ MailFolderCC::Open(OpenMode openmode)
    // and update UID validity for the next time
    m_uidValidity = m_MailStream->uid_validity;
 
+   // load the headers cached during the previous sessions: this only makes
+   // sense for the remote folders with persistent UIDs, i.e. IMAP ones
+   if ( GetType() == MF_IMAP && !m_MailStream->uid_nosticky && !m_headerCache )
+   {
+      m_headerCache = new HeaderCacheFile(GetName());
+      if ( !m_headerCache->Open(m_uidValidity) )
+      {
+         delete m_headerCache;
+         m_headerCache = NULL;
+      }
+   }
+
    // update the flags for POP3 (which doesn't keep them itself) from our cache
    if ( GetType() == MF_POP )
    {
@@ -2328,6 +2498,8 @@ MailFolderCC::Open(OpenMode openmode)
 void
 MailFolderCC::Close(bool mayLinger)
 {
+   WaitForBgOps();
+
    wxLogTrace(TRACE_MF_CALLS, _T("Closing folder '%s'"), GetName());
 
    MailFolderCmn::Close(mayLinger);
@@ -2345,6 +2517,16 @@ MailFolderCC::Close(bool mayLinger)
          Pop3_SaveFlags(GetName(), m_MailStream);
       }
 
+      if ( m_headerCache )
+      {
+         // we can only drop the expunged messages from the cache if we know
+         // the UIDs of all of them
+         m_headerCache->Flush(m_uidIndex.IsComplete() ? &m_uidIndex : NULL);
+
+         delete m_headerCache;
+         m_headerCache = NULL;
+      }
+
 #ifdef USE_DIALUP
       if ( NeedsNetwork() && !mApplication->IsOnline() )
       {
@@ -2390,6 +2572,7 @@ MailFolderCC::Close(bool mayLinger)
    // normally the folder won't be reused any more but reset them just in case
    m_uidLast = UID_ILLEGAL;
    m_nMessages = 0;
+   m_uidIndex.Clear();
 
    // save our last new UID in case this folder is going to be reopened later
    String folderName = GetName();
@@ -2436,6 +2619,8 @@ MailFolderCC::ForceClose()
 
 bool MailFolderCC::Suspend()
 {
+   WaitForBgOps();
+
    if ( !NeedsNetwork() )
       return false;
 
@@ -2446,6 +2631,8 @@ bool MailFolderCC::Suspend()
 
 bool MailFolderCC::Resume()
 {
+   WaitForBgOps();
+
    ASSERT_MSG( !IsOpened(), "reopening already open folder?" );
 
    if ( !Open() )
@@ -2589,6 +2776,8 @@ void MailFolderCC::ReadConfig(MailFolderCmn::MFCmnOptions& config)
 void
 MailFolderCC::Checkpoint(void)
 {
+   WaitForBgOps();
+
    if ( m_MailStream == NULL )
      return; // nothing we can do anymore
 
@@ -2631,6 +2820,8 @@ MailFolderCC::Checkpoint(void)
 bool
 MailFolderCC::Ping(void)
 {
+   WaitForBgOps();
+
    // we don't want to reopen the folder from here, this leads to inifinite
    // loops if the network connection goes down because we are called from a
    // timer event and so if folder pinging taks too long, we will be called
@@ -2712,8 +2903,6 @@ MailFolderCC::PingOpenedFolder()
 bool
 MailFolderCC::DoCheckStatus(const MFolder *folder, MAILSTATUS *mailstatus)
 {
-   static const int STATUS_FLAGS = SA_MESSAGES | SA_RECENT | SA_UNSEEN;
-
    MBusyCursor busyCursor;
 
    // instead of calling mail_status() with NIL stream we always open the
@@ -2839,12 +3028,7 @@ bool MailFolderCC::CheckStatus(const MFolder *folder)
       return true;
    }
 
-   // remember the old status of the folder
-   MfStatusCache *mfStatusCache = MfStatusCache::Get();
-   MailFolderStatus status;
-   (void)mfStatusCache->GetStatus(folder->GetFullName(), &status);
-
-   // and check for the new one
+   // check for the new status of the folder
    MAILSTATUS mailstatus;
    if ( !DoCheckStatus(folder, &mailstatus) )
    {
@@ -2853,6 +3037,20 @@ bool MailFolderCC::CheckStatus(const MFolder *folder)
       return false;
    }
 
+   ProcessStatus(folder, mailstatus);
+
+   return true;
+}
+
+/* static */
+void
+MailFolderCC::ProcessStatus(const MFolder *folder, const MAILSTATUS& mailstatus)
+{
+   // compare with the old status of the folder
+   MfStatusCache *mfStatusCache = MfStatusCache::Get();
+   MailFolderStatus status;
+   (void)mfStatusCache->GetStatus(folder->GetFullName(), &status);
+
    // has anything changed?
    if ( mailstatus.messages != status.total ||
         mailstatus.recent != status.recent ||
@@ -2866,20 +3064,477 @@ bool MailFolderCC::CheckStatus(const MFolder *folder)
                                  ? mailstatus.recent
                                  : mailstatus.unseen;
 
-      if ( newmsgs )
-      {
-         ProcessNewMail(folder, newmsgs);
-      }
+      if ( newmsgs )
+      {
+         ProcessNewMail(folder, newmsgs);
+      }
+
+      // update the status shown in the tree anyhow
+      status.total = mailstatus.messages;
+      status.recent = mailstatus.recent;
+      status.unread = mailstatus.unseen;
+
+      mfStatusCache->UpdateStatus(folder->GetFullName(), status);
+   }
+}
+
+/* static */
+bool
+MailFolderCC::CheckStatusAll(const MFolder **folders,
+                             size_t count,
+                             bool *results,
+                             wxFrame *frame)
+{
+   // all folders on the same server are checked using a single connection
+   struct ServerBatch
+   {
+      ServerInfoEntryCC *server;
+      MAILSTREAM *stream;
+      String login,
+             password;
+      bool hasAuthInfo;
+
+      // true if we couldn't connect to this server at all
+      bool failed;
+
+      // the indices of the folders in the folders array
+      std::vector<size_t> indices;
+
+      // their specs, the STATUS commands are sent for the first countSent
+      std::vector<wxCharBuffer> specs;
+      size_t countSent;
+
+      // the results of the STATUS commands which were sent
+      std::vector<MAILSTATUS> mailstatus;
+      std::vector<long> ok;
+   };
+
+   std::vector<ServerBatch> batches;
+   std::vector<size_t> others;
+   for ( size_t n = 0; n < count; n++ )
+   {
+      const MFolder * const folder = folders[n];
+      ServerInfoEntryCC *server = NULL;
+      if ( folder->GetType() == MF_IMAP )
+      {
+         // the opened folders are just pinged by CheckFolder()
+         MailFolder * const mf = MailFolder::GetOpenedFolderFor(folder);
+         if ( mf )
+            mf->DecRef();
+         else
+            server = ServerInfoEntryCC::GetOrCreate(folder);
+      }
+
+      if ( !server )
+      {
+         others.push_back(n);
+         continue;
+      }
+
+      size_t b;
+      for ( b = 0; b < batches.size(); b++ )
+      {
+         if ( batches[b].server == server )
+            break;
+      }
+
+      if ( b == batches.size() )
+      {
+         batches.push_back(ServerBatch());
+         batches[b].server = server;
+         batches[b].stream = NULL;
+         batches[b].hasAuthInfo = false;
+         batches[b].failed = false;
+         batches[b].countSent = 0;
+      }
+
+      batches[b].indices.push_back(n);
+   }
+
+   MBusyCursor busyCursor;
+
+   // first send the commands to all servers without waiting for the replies,
+   // so that all of them work in parallel
+   for ( size_t b = 0; b < batches.size(); b++ )
+   {
+      ServerBatch& batch = batches[b];
+      const MFolder * const folder = folders[batch.indices[0]];
+
+      // this is the same as in DoCheckStatus()
+      batch.hasAuthInfo = batch.server->GetAuthInfo(batch.login,
+                                                    batch.password);
+      if ( !batch.hasAuthInfo )
+      {
+         batch.login = folder->GetLogin();
+         batch.password = folder->GetPassword();
+
+         if ( !GetAuthInfoForFolder(folder, batch.login, batch.password,
+                                    mApplication->TopLevelFrame()) )
+         {
+            batch.failed = true;
+            continue;
+         }
+      }
+
+      SetLoginData(batch.login, batch.password);
+
+      for ( size_t n = 0; n < batch.indices.size(); n++ )
+      {
+         batch.specs.push_back(MailFolder::GetImapSpec(folders[batch.indices[n]],
+                                                       batch.login).ToAscii());
+      }
+
+      batch.stream = batch.server->GetStream();
+      if ( !batch.stream )
+      {
+         CCCallbackDisabler noCallbacks;
+
+         batch.stream = MailOpen(NULL,
+                                 MailFolder::GetImapSpec(folder, batch.login),
+                                 OP_HALFOPEN | OP_READONLY);
+         if ( !batch.stream )
+         {
+            // don't try to connect to it again for each of its folders
+            batch.failed = true;
+            continue;
+         }
+      }
+
+      // the server may not be IMAP if we're mistaken about the folder type
+      if ( strcmp(batch.stream->dtb->name, "imap") != 0 )
+         continue;
+
+      std::vector<char *> specs(batch.specs.size());
+      for ( size_t n = 0; n < specs.size(); n++ )
+         specs[n] = batch.specs[n].data();
+
+      batch.countSent = imap_status_send(batch.stream, &specs[0], specs.size(),
+                                         STATUS_FLAGS);
+
+      wxLogTrace(TRACE_MF_CALLS,
+                 _T("MailFolderCC::CheckStatusAll(): sent %lu of %lu ")
+                 _T("STATUS commands to %s."),
+                 (unsigned long)batch.countSent,
+                 (unsigned long)specs.size(),
+                 folder->GetServer());
+   }
+
+   // now get the replies from all of them
+   for ( size_t b = 0; b < batches.size(); b++ )
+   {
+      ServerBatch& batch = batches[b];
+      if ( !batch.countSent )
+         continue;
+
+      batch.mailstatus.resize(batch.countSent);
+      batch.ok.resize(batch.countSent);
+
+      MMStatusCollector statusCollector;
+      for ( size_t n = 0; n < batch.countSent; n++ )
+         statusCollector.Add(batch.specs[n].data(), &batch.mailstatus[n]);
+
+      imap_status_receive(batch.stream, &batch.ok[0]);
+   }
+
+   // and finally process them: this is only done after getting all replies
+   // as processing new mail may take time
+   bool rc = true;
+   for ( size_t b = 0; b < batches.size(); b++ )
+   {
+      ServerBatch& batch = batches[b];
+      if ( batch.failed )
+      {
+         for ( size_t n = 0; n < batch.indices.size(); n++ )
+         {
+            ERRORMESSAGE(( _("Failed to check status of the folder '%s'"),
+                           folders[batch.indices[n]]->GetFullName() ));
+
+            results[batch.indices[n]] = false;
+         }
+
+         rc = false;
+         continue;
+      }
+
+      const size_t countSent = batch.countSent;
+      for ( size_t n = 0; n < countSent; n++ )
+      {
+         const MFolder * const folder = folders[batch.indices[n]];
+         const MAILSTATUS& mailstatus = batch.mailstatus[n];
+         if ( !batch.ok[n] ||
+               (mailstatus.flags & STATUS_FLAGS) != STATUS_FLAGS )
+         {
+            ERRORMESSAGE(( _("Failed to check status of the folder '%s'"),
+                           folder->GetFullName() ));
+
+            results[batch.indices[n]] = false;
+            rc = false;
+            continue;
+         }
+
+         ProcessStatus(folder, mailstatus);
+
+         results[batch.indices[n]] = true;
+      }
+
+      if ( batch.stream )
+      {
+         batch.server->KeepStream(batch.stream, folders[batch.indices[0]]);
+
+         if ( !batch.hasAuthInfo )
+            batch.server->SetAuthInfo(batch.login, batch.password);
+      }
+
+      // check the remaining folders, if any, one by one: this is done for
+      // those which couldn't be sent as a batch to the server
+      for ( size_t n = countSent; n < batch.indices.size(); n++ )
+         others.push_back(batch.indices[n]);
+   }
+
+   for ( size_t n = 0; n < others.size(); n++ )
+   {
+      const size_t idx = others[n];
+      if ( !(results[idx] = MailFolder::CheckFolder(folders[idx], frame)) )
+         rc = false;
+   }
+
+   return rc;
+}
+
+// ----------------------------------------------------------------------------
+// Watching the folders using IDLE
+// ----------------------------------------------------------------------------
+
+// get the status of the mailbox selected on the given IDLE stream: we can't
+// use STATUS for it as the servers are not required to support it for the
+// selected mailbox (RFC 3501 even recommends not doing it) and some of them
+// return stale data, but the stream already knows the number of messages and
+// the recent ones from the untagged responses and we only need to ask it for
+// the unseen ones
+static bool GetSelectedStatus(MAILSTREAM *stream, MAILSTATUS& mailstatus)
+{
+   // this processes all the updates sent by the server while we were idling
+   if ( !imap_idle_done(stream) )
+      return false;
+
+   SEARCHPGM *pgm = mail_newsearchpgm();
+   pgm->unseen = T;
+
+   // this frees pgm and marks the messages found as searched
+   if ( !mail_search_full(stream, NIL, pgm, SE_FREE) )
+      return false;
+
+   unsigned long unseen = 0;
+   for ( unsigned long n = 1; n <= stream->nmsgs; n++ )
+   {
+      if ( mail_elt(stream, n)->searched )
+         unseen++;
+   }
+
+   mailstatus.flags = STATUS_FLAGS;
+   mailstatus.messages = stream->nmsgs;
+   mailstatus.recent = stream->recent;
+   mailstatus.unseen = unseen;
+
+   return true;
+}
+
+// return the watch for the given folder or NULL
+static FolderWatch *FindFolderWatch(const MFolder *folder)
+{
+   if ( !gs_folderWatches )
+      return NULL;
+
+   const String name = folder->GetFullName();
+   for ( FolderWatchList::iterator i = gs_folderWatches->begin();
+         i != gs_folderWatches->end();
+         ++i )
+   {
+      if ( i->m_folder->GetFullName() == name )
+         return *i;
+   }
+
+   return NULL;
+}
+
+/* static */
+bool MailFolderCC::WatchFolder(const MFolder *folder)
+{
+   CHECK( folder, false, _T("MailFolderCC::WatchFolder(): NULL folder") );
+
+   if ( folder->GetType() != MF_IMAP )
+      return false;
+
+   if ( FindFolderWatch(folder) )
+      return true;
+
+   // we're called from background, so don't ask the user for the password
+   // here, it should be already known after checking the folder status
+   ServerInfoEntryCC *server = ServerInfoEntryCC::GetOrCreate(folder);
+   String login, password;
+   if ( !server || !server->GetAuthInfo(login, password) )
+   {
+      login = folder->GetLogin();
+      password = folder->GetPassword();
+
+      if ( !GetAuthInfoForFolder(folder, login, password, NULL) )
+         return false;
+   }
+
+   SetLoginData(login, password);
+
+   const String spec = MailFolder::GetImapSpec(folder, login);
+
+   MAILSTREAM *stream;
+   {
+      // this stream doesn't belong to any MailFolderCC
+      CCCallbackDisabler noCallbacks;
+
+      stream = MailOpen(NULL, spec, OP_READONLY);
+      if ( !stream )
+         return false;
+
+      if ( strcmp(stream->dtb->name, "imap") != 0 || !imap_idle_start(stream) )
+      {
+         wxLogTrace(TRACE_MF_CALLS,
+                    _T("Can't watch folder '%s': IDLE not supported."),
+                    folder->GetFullName());
+
+         mail_close(stream);
+
+         return false;
+      }
+   }
+
+   if ( !gs_folderWatches )
+      gs_folderWatches = new FolderWatchList;
+
+   gs_folderWatches->push_back(new FolderWatch(folder, spec, stream));
+
+   wxLogTrace(TRACE_MF_CALLS, _T("Started watching folder '%s'."),
+              folder->GetFullName());
+
+   return true;
+}
+
+/* static */
+void MailFolderCC::UnwatchFolder(const MFolder *folder)
+{
+   CHECK_RET( folder, _T("MailFolderCC::UnwatchFolder(): NULL folder") );
+
+   FolderWatch * const watch = FindFolderWatch(folder);
+   if ( !watch )
+      return;
+
+   for ( FolderWatchList::iterator i = gs_folderWatches->begin();
+         i != gs_folderWatches->end();
+         ++i )
+   {
+      if ( *i == watch )
+      {
+         gs_folderWatches->erase(i);
+         break;
+      }
+   }
+
+   wxLogTrace(TRACE_MF_CALLS, _T("Stopped watching folder '%s'."),
+              folder->GetFullName());
+}
+
+/* static */
+bool MailFolderCC::IsFolderWatched(const MFolder *folder)
+{
+   return FindFolderWatch(folder) != NULL;
+}
+
+/* static */
+void MailFolderCC::PollWatchedFolders()
+{
+   if ( !gs_folderWatches )
+      return;
+
+   const time_t timeNow = time(NULL);
+   for ( FolderWatchList::iterator i = gs_folderWatches->begin();
+         i != gs_folderWatches->end(); )
+   {
+      FolderWatch * const watch = *i;
+
+      MAILSTATUS mailstatus;
+      bool ok;
+      {
+         CCCallbackDisabler noCallbacks;
+
+         // this doesn't block, so it's fine to call it for all watches
+         if ( !imap_idle_poll(watch->m_stream) &&
+               timeNow - watch->m_timeStart < IDLE_RESTART_INTERVAL )
+         {
+            ++i;
+            continue;
+         }
+
+         // something happened in the folder (or we must restart IDLE
+         // anyhow): get its new status
+         ok = GetSelectedStatus(watch->m_stream, mailstatus) &&
+                  imap_idle_start(watch->m_stream);
+      }
+
+      if ( !ok )
+      {
+         // the connection was probably lost, the caller can try to watch
+         // this folder again if it wants
+         wxLogTrace(TRACE_MF_CALLS, _T("Stopped watching folder '%s'."),
+                    watch->m_folder->GetFullName());
+
+         i = gs_folderWatches->erase(i);
+         continue;
+      }
+
+      watch->m_timeStart = timeNow;
+
+      // do it outside of CCCallbackDisabler scope as processing new mail can
+      // result in opening the folder
+      ProcessStatus(watch->m_folder, mailstatus);
+
+      ++i;
+   }
+}
+
+// ----------------------------------------------------------------------------
+// MailFolder functions for checking many folders implemented using c-client
+// ----------------------------------------------------------------------------
+
+/* static */
+bool
+MailFolder::CheckFolders(const MFolder **folders,
+                         size_t count,
+                         bool *results,
+                         wxFrame *frame)
+{
+   return MailFolderCC::CheckStatusAll(folders, count, results, frame);
+}
 
-      // update the status shown in the tree anyhow
-      status.total = mailstatus.messages;
-      status.recent = mailstatus.recent;
-      status.unread = mailstatus.unseen;
+/* static */
+bool MailFolder::WatchFolder(const MFolder *folder)
+{
+   return MailFolderCC::WatchFolder(folder);
+}
 
-      mfStatusCache->UpdateStatus(folder->GetFullName(), status);
-   }
+/* static */
+void MailFolder::UnwatchFolder(const MFolder *folder)
+{
+   MailFolderCC::UnwatchFolder(folder);
+}
 
-   return true;
+/* static */
+bool MailFolder::IsFolderWatched(const MFolder *folder)
+{
+   return MailFolderCC::IsFolderWatched(folder);
+}
+
+/* static */
+void MailFolder::PollWatchedFolders()
+{
+   MailFolderCC::PollWatchedFolders();
 }
 
 // ----------------------------------------------------------------------------
@@ -2897,7 +3552,33 @@ MailFolderCC::Lock(void) const
 bool
 MailFolderCC::IsLocked(void) const
 {
-   return m_mutexExclLock.IsLocked() || m_mutexNewMail.IsLocked();
+   if ( m_mutexExclLock.IsLocked() || m_mutexNewMail.IsLocked() )
+      return true;
+
+#if wxUSE_THREADS
+   // don't let the main thread start using the folder in background if it
+   // would have to wait for the operations on it to complete
+   if ( wxThread::IsMain() && MailThreadPool::IsCreated() )
+   {
+      const MailFolder * const mf = this;
+      return MailThreadPool::Get()->HasTasksFor(mf);
+   }
+#endif // wxUSE_THREADS
+
+   return false;
+}
+
+void
+MailFolderCC::WaitForBgOps() const
+{
+#if wxUSE_THREADS
+   if ( wxThread::IsMain() && MailThreadPool::IsCreated() )
+   {
+      // the key used by ASMailFolder for the tasks of this folder
+      const MailFolder * const mf = this;
+      MailThreadPool::Get()->WaitForFolder(mf);
+   }
+#endif // wxUSE_THREADS
 }
 
 void
@@ -2936,9 +3617,86 @@ MailFolderCC::UpdateAfterAppend()
    }
 }
 
+// fill the data for appending the given message, return false on error (which
+// is logged)
+static bool
+GetAppendData(const Message& msg, MessageAppender::Data& data)
+{
+   String date;
+   msg.GetHeaderLine(_T("Date"), date);
+
+   MESSAGECACHE mc;
+   if ( mail_parse_date(&mc, UCHAR_CAST(date.char_str())) )
+   {
+      char buf[128];
+      data.date = mail_date(buf, &mc);
+   }
+
+   String text;
+   if ( !msg.WriteToString(text) )
+   {
+      wxLogError(_("Failed to retrieve the message text."));
+
+      return false;
+   }
+
+   const wxCharBuffer buf(text.To8BitData());
+   CHECK( buf, false, "message contains non-ASCII characters" );
+
+   data.text.assign(buf.data(), text.length());
+   data.flags = GetImapFlags(msg.GetStatus()).To8BitData().data();
+
+   return true;
+}
+
+// MessageAppender::Source retrieving the messages from another folder for
+// AppendMessages()
+class FolderAppendSource : public MessageAppender::Source
+{
+public:
+   FolderAppendSource(MailFolder *folder,
+                      const UIdArray& uids,
+                      MProgressDialog *pd)
+      : m_folder(folder),
+        m_uids(uids),
+        m_pd(pd)
+   {
+   }
+
+   virtual bool GetMessage(size_t n, MessageAppender::Data& data)
+   {
+      Message *msg = m_folder->GetMessage(m_uids[n]);
+      CHECK( msg, false, _T("copying inexistent message?") );
+
+      const bool ok = GetAppendData(*msg, data);
+      msg->DecRef();
+
+      return ok;
+   }
+
+   virtual bool OnRetrieve(size_t n)
+   {
+      return !m_pd || m_pd->Update(2*n + 1);
+   }
+
+   virtual bool OnAppended(size_t n)
+   {
+      return !m_pd || m_pd->Update(2*n);
+   }
+
+private:
+   MailFolder * const m_folder;
+   const UIdArray& m_uids;
+   MProgressDialog * const m_pd;
+
+   DECLARE_NO_COPY_CLASS(FolderAppendSource)
+};
+
 bool
 MailFolderCC::AppendMessage(const String& msg)
 {
+   WaitForBgOps();
+
    wxLogTrace(TRACE_MF_CALLS, _T("MailFolderCC(%s)::AppendMessage(string)"),
               GetName());
 
@@ -2967,6 +3725,8 @@ MailFolderCC::AppendMessage(const String& msg)
 bool
 MailFolderCC::AppendMessage(const Message& msg)
 {
+   WaitForBgOps();
+
    // TODO-OPT: This implementation is extremely inefficient for IMAP as it
    //           downloads the message text and then uploads it to the server
    //           back again, we ought to use mail_copy() instead of
@@ -2975,43 +3735,23 @@ MailFolderCC::AppendMessage(const Message& msg)
    wxLogTrace(TRACE_MF_CALLS, _T("MailFolderCC(%s)::AppendMessage(Message)"),
               GetName());
 
-   String date;
-   msg.GetHeaderLine(_T("Date"), date);
-
-   char *dateptr = NULL;
-   char datebuf[128];
-   MESSAGECACHE mc;
-   if ( mail_parse_date(&mc, UCHAR_CAST(date.char_str())) )
-   {
-     mail_date(datebuf, &mc);
-     dateptr = datebuf;
-   }
-
-   // append message text to folder
-   String tmp;
-   if ( !msg.WriteToString(tmp) )
-   {
-      wxLogError(_("Failed to retrieve the message text."));
-
+   MessageAppender::Data data;
+   if ( !GetAppendData(msg, data) )
       return false;
-   }
-
-   String flags = GetImapFlags(msg.GetStatus());
 
    if ( CheckConnection() )
    {
-      // keep the char buffer alive until after mail_append_full() returns
-      wxCharBuffer tmpbuf(tmp.To8BitData());
-      CHECK( tmpbuf, false, "message contains non-ASCII characters" );
-
       STRING str;
-      INIT(&str, mail_string, tmpbuf.data(), tmp.length());
+      INIT(&str, mail_string, const_cast<char *>(data.text.data()),
+           data.text.length());
 
       if ( mail_append_full(m_MailStream,
-                             m_ImapSpec.char_str(),
-                             flags.char_str(),
-                             dateptr,
-                             &str) )
+                            m_ImapSpec.char_str(),
+                            data.flags.empty() ? NIL
+                                               : CONST_CCAST(data.flags.c_str()),
+                            data.date.empty() ? NIL
+                                              : CONST_CCAST(data.date.c_str()),
+                            &str) )
       {
          UpdateAfterAppend();
 
@@ -3029,9 +3769,89 @@ MailFolderCC::AppendMessage(const Message& msg)
    return false;
 }
 
+bool
+MailFolderCC::AppendMessages(MailFolder *folderSrc,
+                             const UIdArray& uids,
+                             MProgressDialog *pd,
+                             UIdArray *uidsFailed)
+{
+   WaitForBgOps();
+
+   CHECK( folderSrc, false, _T("AppendMessages() needs a source folder") );
+
+   wxLogTrace(TRACE_MF_CALLS, _T("MailFolderCC(%s)::AppendMessages(%s, %lu)"),
+              GetName(), folderSrc->GetName(), (unsigned long)uids.GetCount());
+
+   if ( !CheckConnection() )
+   {
+      wxLogError(_("Failed to save messages to closed folder '%s'"),
+                 GetName());
+
+      if ( uidsFailed )
+         WX_APPEND_ARRAY(*uidsFailed, uids);
+
+      return false;
+   }
+
+   // when appending to IMAP servers supporting MULTIAPPEND and to the local
+   // files (the drivers truncate the file back on error) failing to append a
+   // batch means that none of its messages were appended, but the other
+   // drivers append the messages one by one and stop at the first error, so
+   // all messages before the last one given to c-client had been appended
+   bool atomic;
+   switch ( GetType() )
+   {
+      case MF_IMAP:
+         atomic = LEVELMULTIAPPEND(m_MailStream) != 0;
+         break;
+
+      case MF_MH:
+         atomic = false;
+         break;
+
+      default:
+         // if we're wrong, we will append some messages twice, but this is
+         // still better than losing them
+         atomic = true;
+   }
+
+   FolderAppendSource source(folderSrc, uids, pd);
+   MessageAppender appender(m_MailStream, m_ImapSpec.char_str(), atomic);
+
+   std::vector<size_t> failed;
+   const bool rc = appender.Append(source, uids.GetCount(), failed);
+
+   // some messages could have been appended even if we failed or were
+   // cancelled, so do it in any case
+   UpdateAfterAppend();
+
+   if ( !failed.empty() )
+   {
+      // c-client had already logged the reason of each failure, just give
+      // the summary if the caller doesn't do it
+      if ( uidsFailed )
+      {
+         for ( size_t n = 0; n < failed.size(); n++ )
+            uidsFailed->Add(uids[failed[n]]);
+      }
+      else
+      {
+         wxLogError(_("%lu of %lu messages couldn't be saved to the "
+                      "folder '%s'."),
+                    (unsigned long)failed.size(),
+                    (unsigned long)uids.GetCount(),
+                    GetName());
+      }
+   }
+
+   return rc;
+}
+
 bool
 MailFolderCC::SaveMessages(const UIdArray *selections, MFolder *folder)
 {
+   WaitForBgOps();
+
    CHECK( folder, false, _T("SaveMessages() needs a valid folder pointer") );
 
    size_t count = selections->Count();
@@ -3230,6 +4050,8 @@ MailFolderCC::SaveMessages(const UIdArray *selections, MFolder *folder)
 void
 MailFolderCC::ExpungeMessages(void)
 {
+   WaitForBgOps();
+
    wxLogTrace(TRACE_MF_CALLS, _T("MailFolderCC(%s)::ExpungeMessages()"),
               GetName());
 
@@ -3309,6 +4131,8 @@ unsigned long MailFolderCC::CountDeletedMessages() const
 
 bool MailFolderCC::DoCountMessages(MailFolderStatus *status) const
 {
+   WaitForBgOps();
+
    CHECK( status, false, _T("DoCountMessages: NULL pointer") );
 
    CHECK( m_MailStream, false, _T("DoCountMessages: folder is closed") );
@@ -3348,19 +4172,123 @@ bool MailFolderCC::DoCountMessages(MailFolderStatus *status) const
 MsgnoType
 MailFolderCC::GetMsgnoFromUID(UIdType uid) const
 {
+   WaitForBgOps();
+
    // garbage in, garbage out
    CHECK( uid != UID_ILLEGAL, MSGNO_ILLEGAL, _T("GetMsgnoFromUID: bad uid") );
 
    CHECK( m_MailStream, MSGNO_ILLEGAL, _T("GetMsgnoFromUID: folder closed") );
 
    // mail_msgno() is a slow function because it iterates over entire c-client
-   // internal cache but I don't see how to make it faster
+   // internal cache, so use our own index instead of it if we can
+   if ( !m_uidIndex.IsComplete() )
+      UpdateUIdIndex();
+
+   if ( m_uidIndex.IsComplete() && m_uidIndex.GetCount() == m_nMessages )
+      return m_uidIndex.Find(uid);
+
+   // we must have lost the connection while retrieving the UIDs, let c-client
+   // deal with it
    return mail_msgno(m_MailStream, uid);
 }
 
+void MailFolderCC::UpdateUIdIndex() const
+{
+   // normally the index is updated from HandleMailExists() but make sure it
+   // has the right size anyhow
+   if ( m_uidIndex.GetCount() < m_nMessages )
+      m_uidIndex.OnAdd(m_nMessages);
+
+   for ( MsgnoType msgno = m_uidIndex.GetFirstUnknown();
+         msgno != MSGNO_ILLEGAL;
+         msgno = m_uidIndex.GetFirstUnknown(msgno + 1) )
+   {
+      if ( !m_MailStream || msgno > m_MailStream->nmsgs )
+         break;
+
+      // we don't need to do anything if c-client already knows the UID,
+      // otherwise mail_uid() gets the UIDs of the subsequent messages without
+      // UIDs too (up to imap_uidlookahead of them), so we still need only a
+      // single server round trip per many messages
+      UIdType uid = mail_elt(m_MailStream, msgno)->private.uid;
+      if ( !uid )
+         uid = mail_uid(m_MailStream, msgno);
+
+      if ( !uid )
+      {
+         // something is wrong, don't insist
+         break;
+      }
+
+      m_uidIndex.Set(msgno, uid);
+   }
+}
+
+void
+MailFolderCC::PrefetchHeaders(const UIdArray& uids,
+                              const wxArrayString& headers)
+{
+   WaitForBgOps();
+
+   CHECK_RET( m_MailStream, _T("PrefetchHeaders: folder is closed") );
+
+   // the headers of the local folders are read directly from disk and there is
+   // no way to get them in one go for POP3 and NNTP, so this only makes sense
+   // for IMAP
+   if ( GetType() != MF_IMAP || uids.IsEmpty() )
+      return;
+
+   MailFolderLocker lockFolder(this);
+
+   // construct the string list containing all the headers we need, leaving it
+   // NULL if we want the entire header
+   STRINGLIST *slist = NULL;
+   for ( size_t n = headers.GetCount(); n > 0; n-- )
+   {
+      STRINGLIST *scur = mail_newstringlist();
+      const wxCharBuffer name(headers[n - 1].ToAscii());
+      scur->text.size = strlen(name);
+      scur->text.data = (unsigned char *)cpystr(name);
+      scur->next = slist;
+      slist = scur;
+   }
+
+   // don't retrieve the headers which are already in c-client cache: this is
+   // the case if either the entire header or all the lines we need are there
+   Sequence seq;
+   for ( size_t n = 0; n < uids.GetCount(); n++ )
+   {
+      const MsgnoType msgno = GetMsgnoFromUID(uids[n]);
+      if ( msgno == MSGNO_ILLEGAL || msgno > m_MailStream->nmsgs )
+         continue;
+
+      const MESSAGECACHE * const elt = mail_elt(m_MailStream, msgno);
+      if ( elt->private.msg.header.text.data &&
+            mail_match_lines(slist, elt->private.msg.lines, 0) )
+         continue;
+
+      seq.Add(uids[n]);
+   }
+
+   if ( seq.GetCount() )
+   {
+      wxLogTrace(TRACE_MF_CALLS,
+                 _T("Prefetching headers of %lu messages in '%s'"),
+                 (unsigned long)seq.GetCount(), GetName());
+
+      // this stores the headers in the cache of each message
+      imap_fetchheader_sequence(m_MailStream, seq.GetString().char_str(),
+                                slist, FT_UID);
+   }
+
+   mail_free_stringlist(&slist);
+}
+
 Message *
 MailFolderCC::GetMessage(unsigned long uid) const
 {
+   WaitForBgOps();
+
    Message* msg = NULL;
    if ( CheckConnection() )
    {
@@ -3463,6 +4391,8 @@ MsgnoArray *MailFolderCC::SearchByFlag(MessageStatus flag,
                                        int flags,
                                        MsgnoType last) const
 {
+   WaitForBgOps();
+
    SEARCHPGM *pgm = mail_newsearchpgm();
 
    // do we look for messages with this flag or without?
@@ -3566,6 +4496,8 @@ MsgnoArray *MailFolderCC::SearchByFlag(MessageStatus flag,
 UIdArray *
 MailFolderCC::SearchMessages(const SearchCriterium *crit, int flags)
 {
+   WaitForBgOps();
+
    CHECK( crit, NULL, _T("no criterium in SearchMessages") );
 
    // server side searching doesn't support all possible search criteria,
@@ -3674,6 +4606,8 @@ MailFolderCC::SetSequenceFlag(SequenceKind kind,
                               int flag,
                               bool set)
 {
+   WaitForBgOps();
+
    if ( !CanSetFlag(flag) )
    {
       ERRORMESSAGE((_("Impossible to set this flag for the folder '%s'."),
@@ -3936,6 +4870,8 @@ MailFolderCC::DebugDump() const
 bool
 MailFolderCC::SortMessages(MsgnoType *msgnos, const SortParams& sortParams)
 {
+   WaitForBgOps();
+
    CHECK( m_MailStream, false, _T("can't sort closed folder") );
 
    /*
@@ -4168,6 +5104,8 @@ static THREADNODE *CopyTree(THREADNODE* th)
 bool MailFolderCC::ThreadMessages(const ThreadParams& thrParams,
                                   ThreadData *thrData)
 {
+   WaitForBgOps();
+
    CHECK( m_MailStream, false, _T("can't thread closed folder") );
 
    // does the server support threading at all?
@@ -4258,9 +5196,21 @@ bool MailFolderCC::ThreadMessages(const ThreadParams& thrParams,
 // MailFolderCC working with the headers
 // ----------------------------------------------------------------------------
 
+UIdType MailFolderCC::GetUIdValidity() const
+{
+   // POP3 UIDs are just msgnos and its UID validity changes each time the
+   // folder is opened
+   if ( !m_MailStream || m_MailStream->uid_nosticky || GetType() == MF_POP )
+      return UID_ILLEGAL;
+
+   return m_uidValidity;
+}
+
 MsgnoType MailFolderCC::GetHeaderInfo(ArrayHeaderInfo& headers,
                                       const Sequence& seq)
 {
+   WaitForBgOps();
+
    CHECK( m_MailStream, 0, _T("GetHeaderInfo: folder is closed") );
 
    MailFolderLocker lockFolder(this);
@@ -4291,6 +5241,32 @@ MsgnoType MailFolderCC::GetHeaderInfo(ArrayHeaderInfo& headers,
    }
    //else: no progress dialog
 
+   // find the messages whose headers we have in the persistent cache: we only
+   // need to resync their flags, which could have changed since the last
+   // session, and this is done for all of them at once
+   MsgnoType nCached = 0;
+   if ( m_headerCache )
+   {
+      if ( !m_uidIndex.IsComplete() )
+         UpdateUIdIndex();
+
+      Sequence seqCached;
+
+      size_t n;
+      for ( UIdType i = seq.GetFirst(n); i != UID_ILLEGAL; i = seq.GetNext(i, n) )
+      {
+         const UIdType uid = m_uidIndex.Get(i);
+         if ( uid != UID_ILLEGAL && m_headerCache->Has(uid) )
+            seqCached.Add(i);
+      }
+
+      nCached = seqCached.GetCount();
+      if ( nCached && m_MailStream )
+      {
+         mail_fetch_flags(m_MailStream, seqCached.GetString().char_str(), NIL);
+      }
+   }
+
    // tell c-client to cache at least the number of messages equal to the
    // number of ones we're interested in (of course, there is no guarantee that
    // we are going to retrieve consequent messages but chances are we will and
@@ -4298,7 +5274,7 @@ MsgnoType MailFolderCC::GetHeaderInfo(ArrayHeaderInfo& headers,
    // scroll down soon
    //
    // the user can disable this by setting the option to -1
-   int lookAhead = m_LookAhead == -1 ? 0 : seq.GetCount() + 1;
+   int lookAhead = m_LookAhead == -1 ? 0 : seq.GetCount() - nCached + 1;
    if ( lookAhead < m_LookAhead )
    {
       // if the user wants to cache more headers than this, do as he says
@@ -4323,12 +5299,18 @@ MsgnoType MailFolderCC::GetHeaderInfo(ArrayHeaderInfo& headers,
          continue;
       }
 
-      ENVELOPE *env = mail_fetch_structure(m_MailStream, i, NIL, NIL);
-      if ( !env )
+      // don't retrieve the envelope at all if we have it in the cache
+      ENVELOPE *env = NULL;
+      const UIdType uid = nCached ? m_uidIndex.Get(i) : UID_ILLEGAL;
+      if ( uid == UID_ILLEGAL || !m_headerCache->Has(uid) )
       {
-         ASSERT_MSG( !m_MailStream, "failed to get sequence element envelope?" );
+         env = mail_fetch_structure(m_MailStream, i, NIL, NIL);
+         if ( !env )
+         {
+            ASSERT_MSG( !m_MailStream, "failed to get sequence element envelope?" );
 
-         continue;
+            continue;
+         }
       }
 
       if ( !OverviewHeaderEntry(&overviewData, elt, env) )
@@ -4380,6 +5362,56 @@ MailFolderCC::OverviewHeaderEntry(OverviewData *overviewData,
    // store what we've got
    HeaderInfo& entry = *overviewData->GetCurrent();
 
+   if ( env )
+   {
+      FillHeaderInfo(entry, elt, env);
+
+      if ( m_headerCache && entry.IsValid() )
+         m_headerCache->Add(entry);
+   }
+   else // take the header from the cache
+   {
+      CHECK( m_headerCache, false, _T("no envelope and no header cache?") );
+
+      const UIdType uid = m_uidIndex.Get(elt->msgno);
+      if ( !m_headerCache->Get(uid, entry) )
+      {
+         // the cache must be corrupted, get the header from the server
+         ENVELOPE *envReal = mail_fetch_structure(m_MailStream, elt->msgno,
+                                                  NIL, NIL);
+         if ( !envReal )
+            return false;
+
+         FillHeaderInfo(entry, elt, envReal);
+         if ( entry.IsValid() )
+            m_headerCache->Add(entry);
+      }
+      else if ( elt->valid )
+      {
+         // the cached flags may be out of date, use the ones we just got
+         entry.m_Status = GetMsgStatus(elt);
+      }
+   }
+
+   // update the progress dialog and also check if it wasn't cancelled by the
+   // user in the meantime
+   if ( !overviewData->UpdateProgress(entry) )
+   {
+      // cancelled by user
+      return false;
+   }
+
+   overviewData->Next();
+
+   // continue
+   return true;
+}
+
+void
+MailFolderCC::FillHeaderInfo(HeaderInfo& entry,
+                             MESSAGECACHE *elt,
+                             ENVELOPE *env)
+{
    // status
    entry.m_Status = GetMsgStatus(elt);
 
@@ -4445,22 +5477,11 @@ MailFolderCC::OverviewHeaderEntry(OverviewData *overviewData,
    entry.m_References = env->references;
    entry.m_InReplyTo = env->in_reply_to;
    entry.m_UId = mail_uid(m_MailStream, elt->msgno);
+   if ( entry.m_UId )
+      m_uidIndex.Set(elt->msgno, entry.m_UId);
 
    // set the font encoding to be used for displaying this entry
    entry.m_Encoding = encodingMsg;
-
-   // update the progress dialog and also check if it wasn't cancelled by the
-   // user in the meantime
-   if ( !overviewData->UpdateProgress(entry) )
-   {
-      // cancelled by user
-      return false;
-   }
-
-   overviewData->Next();
-
-   // continue
-   return true;
 }
 
 // ----------------------------------------------------------------------------
@@ -4508,6 +5529,9 @@ MailFolderCC::HandleMailExists(struct mail_stream *stream, MsgnoType msgnoMax)
       // real folder
       m_nMessages = msgnoMax;
 
+      // the UIDs of the new messages will be retrieved when needed
+      m_uidIndex.OnAdd(msgnoMax);
+
       // we don't have to do anything for empty folders except updating their
       // status
       if ( msgnoMax )
@@ -4596,6 +5620,10 @@ MailFolderCC::HandleMailExpunge(MsgnoType msgno)
    // adjust the stored msgnos which could become invalid
    UpdateMsgFlagsOnExpunge(msgno);
 
+   // keep the UID index in sync with the folder
+   if ( msgno <= m_uidIndex.GetCount() )
+      m_uidIndex.OnExpunge(msgno);
+
    // update the total number of messages
    if ( m_nMessages > 0 )
    {
@@ -4776,6 +5804,8 @@ MailFolderCC::CClientInit(void)
    (*pop3driver.parameters)(SET_MAXLOGINTRIALS, (void *)1);
 
 #ifdef USE_BLOCK_NOTIFY
+   gs_defaultBlockNotify =
+      (blocknotify_t)mail_parameters(NULL, GET_BLOCKNOTIFY, NULL);
    mail_parameters(NULL, SET_BLOCKNOTIFY, (void *)mahogany_block_notify);
 #endif // USE_BLOCK_NOTIFY
 
@@ -4860,6 +5890,9 @@ CCStreamCleaner::~CCStreamCleaner()
 
 void MailFolderCCCleanup(void)
 {
+   delete gs_folderWatches;
+   gs_folderWatches = NULL;
+
    ServerInfoEntryCC::DeleteAll();
 
    // as c-client lib doesn't seem to think that deallocating memory is
@@ -5736,6 +6769,10 @@ void MailFolderCC::StartReading(unsigned long total)
 #ifdef USE_READ_PROGRESS
    ASSERT_MSG( !gs_readProgressInfo, _T("can't start another read operation") );
 
+   // no progress dialogs can be shown from the background threads
+   if ( !wxThread::IsMain() )
+      return;
+
    // don't show the progress dialogs for the local folders - in practice, it
    // will never take really long time to read from them
    if ( IsLocalQuickFolder(GetType()) )
@@ -6016,6 +7053,7 @@ mm_fatal(char *str)
 
 void *mahogany_block_notify(int reason, void *data)
 {
+#ifdef DEBUG_BLOCK_NOTIFY
    #define LOG_BLOCK_REASON(what) \
       if ( reason == BLOCK_##what ) \
          printf("%s: mm_blocknotify(%s, %p)\n", \
@@ -6032,8 +7070,29 @@ void *mahogany_block_notify(int reason, void *data)
    LOG_BLOCK_REASON(TCPCLOSE)
    LOG_BLOCK_REASON(FILELOCK)
    printf("mm_blocknotify(UNKNOWN, %p)\n", data);
+#endif // DEBUG_BLOCK_NOTIFY
 
-   return NULL;
+   switch ( reason )
+   {
+      case BLOCK_NONE:
+         MailLock::ResumeAfterIO();
+         break;
+
+      case BLOCK_DNSLOOKUP:
+      case BLOCK_TCPOPEN:
+      case BLOCK_TCPREAD:
+      case BLOCK_TCPWRITE:
+      case BLOCK_TCPCLOSE:
+      case BLOCK_FILELOCK:
+         // no callbacks are called while c-client is blocked, so the other
+         // threads may use it in the meanwhile
+         MailLock::SuspendForIO();
+         break;
+   }
+
+   // the default handler blocks the alarms in the sensitive code
+   return gs_defaultBlockNotify ? (*gs_defaultBlockNotify)(reason, data)
+                                : NULL;
 }
 
 #endif // USE_BLOCK_NOTIFY
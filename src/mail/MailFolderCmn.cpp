@@ -66,11 +66,17 @@
 #include "MailFolderCmn.h"
 #include "MFPrivate.h"
 #include "mail/FolderPool.h"
+#include "mail/MailThreadPool.h"
+#include "mail/SearchIndex.h"
+#include "mail/SortKeys.h"
 #include "gui/wxMDialogs.h"
 #include "wx/persctrl.h"
 
 #include <wx/datetime.h>
 #include <wx/file.h>
+#include <wx/thread.h>                     // for wxIsMainThread()
+
+#include <algorithm>
 
 // ----------------------------------------------------------------------------
 // options we use here
@@ -311,6 +317,9 @@ static MfCloser *gs_MailFolderCloser = NULL;
 
 void MailFolderKeepAliveTimer::Notify(void)
 {
+   // timer notifications don't go through wxMApp::HandleEvent()
+   MailLocker lock;
+
    wxLogTrace(TRACE_MF_KEEPALIVE,
               "Keep alive timer triggered for \"%s\" at %s",
               m_mf->GetName(),
@@ -503,6 +512,8 @@ void MfCloser::RestartTimer()
 
 void MfCloseTimer::Notify(void)
 {
+   MailLocker lock;
+
    if ( mApplication->AllowBgProcessing() )
       m_mfCloser->OnTimer();
 }
@@ -779,7 +790,8 @@ MailFolderCmn::SaveMessagesToFile(const UIdArray *selections,
    scoped_ptr<MProgressDialog> pd;
    long threshold = GetProgressThreshold(GetProfile());
 
-   if ( threshold > 0 && n > threshold )
+   // we can't show any GUI if we're called from a worker thread
+   if ( threshold > 0 && n > threshold && wxIsMainThread() )
    {
       wxString msg;
       msg.Printf(_("Saving %d messages to the file '%s'..."),
@@ -855,7 +867,7 @@ MailFolderCmn::SaveMessages(const UIdArray *selections,
    scoped_ptr<MProgressDialog> pd;
    long threshold = GetProgressThreshold(mf->GetProfile());
 
-   if ( threshold > 0 && n > threshold )
+   if ( threshold > 0 && n > threshold && wxIsMainThread() )
    {
       // open a progress window:
       wxString msg;
@@ -873,22 +885,54 @@ MailFolderCmn::SaveMessages(const UIdArray *selections,
    // minimize the number of updates by only doing it once
    SuspendFolderUpdates suspend(mf);
 
+   UIdArray uidsFailed;
+   if ( mf->AppendMessages(this, *selections, pd.get(), &uidsFailed) )
+      return true;
+
+   // the errors for the individual messages had been already given, but it's
+   // useful to know how many of them were affected
+   if ( !uidsFailed.IsEmpty() )
+   {
+      wxLogError(_("%lu of %d messages couldn't be saved to the folder '%s'."),
+                 (unsigned long)uidsFailed.GetCount(), n, folder->GetName());
+   }
+
+   return false;
+}
+
+bool
+MailFolderCmn::AppendMessages(MailFolder *folderSrc,
+                              const UIdArray& uids,
+                              MProgressDialog *pd,
+                              UIdArray *uidsFailed)
+{
+   CHECK( folderSrc, false, _T("AppendMessages() needs a source folder") );
+
    bool rc = true;
-   for ( int i = 0; i < n; i++ )
+
+   const size_t count = uids.GetCount();
+   for ( size_t n = 0; n < count; n++ )
    {
-      if ( pd && !pd->Update(2*i + 1) )
+      if ( pd && !pd->Update(2*n + 1) )
       {
          // cancelled
          return false;
       }
 
-      Message *msg = GetMessage((*selections)[i]);
+      Message *msg = folderSrc->GetMessage(uids[n]);
       if ( msg )
       {
-         rc &= mf->AppendMessage(*msg);
+         if ( !AppendMessage(*msg) )
+         {
+            if ( uidsFailed )
+               uidsFailed->Add(uids[n]);
+
+            rc = false;
+         }
+
          msg->DecRef();
 
-         if ( pd && !pd->Update(2*i + 2) )
+         if ( pd && !pd->Update(2*n + 2) )
          {
             // cancelled
             return false;
@@ -987,9 +1031,48 @@ UIdArray *MailFolderCmn::SearchMessages(const SearchCriterium *crit, int flags)
 
    MsgnoType nMessages = GetMessageCount();
 
+   // use the full text index if possible to avoid retrieving the messages
+   // which can't match: they're those which had been already indexed but
+   // weren't found in the index
+   const MsgSearchIndex::Part part = MsgSearchIndex::GetPartFor(crit->m_What);
+   const UIdType uidValidity = GetUIdValidity();
+   MsgSearchIndex * const searchIndex = part != MsgSearchIndex::Part_Max &&
+                                          uidValidity != UID_ILLEGAL &&
+                                          MsgSearchIndex::CanSearchFor(crit->m_Key)
+                                          ? MsgSearchIndex::Get()
+                                          : NULL;
+
+   std::vector<UIdType> uidsCandidates,
+                        uidsIndexed;
+   if ( searchIndex )
+   {
+      std::vector<UIdType> uidsAll;
+      uidsAll.reserve(nMessages);
+      for ( size_t idx = 0; idx < nMessages; idx++ )
+      {
+         HeaderInfo *hi = hil->GetItemByIndex(idx);
+         if ( hi )
+            uidsAll.push_back(hi->GetUId());
+      }
+
+      std::sort(uidsAll.begin(), uidsAll.end());
+
+      // don't keep the messages which were deleted from the folder
+      searchIndex->Retain(GetName(), uidValidity, uidsAll);
+
+      if ( !searchIndex->Search(GetName(), uidValidity, part, crit->m_Key,
+                                uidsCandidates, uidsIndexed) )
+      {
+         // don't use the index at all, check all messages
+         uidsIndexed.clear();
+      }
+   }
+
    // show the progress dialog if the search is going to take a long time
+   // (and we're not called from a worker thread)
    if ( nMessages > (unsigned long)READ_CONFIG(GetProfile(),
-                                               MP_FOLDERPROGRESS_THRESHOLD) )
+                                               MP_FOLDERPROGRESS_THRESHOLD) &&
+         wxIsMainThread() )
    {
       String msg;
       msg.Printf(_("Searching in %lu messages..."), nMessages);
@@ -1011,55 +1094,77 @@ UIdArray *MailFolderCmn::SearchMessages(const SearchCriterium *crit, int flags)
          continue;
       }
 
-      if ( crit->m_What == SearchCriterium::SC_SUBJECT )
-      {
-         what = hi->GetSubject();
-      }
-      else if ( crit->m_What == SearchCriterium::SC_FROM )
+      const UIdType uid = hi->GetUId();
+
+      bool found;
+      if ( std::binary_search(uidsIndexed.begin(), uidsIndexed.end(), uid) &&
+            !std::binary_search(uidsCandidates.begin(),
+                                uidsCandidates.end(),
+                                uid) )
       {
-         what = hi->GetFrom();
+         // the index tells us that this message doesn't contain the search
+         // string, no need to retrieve it
+         found = false;
       }
-      else if ( crit->m_What == SearchCriterium::SC_TO )
+      else // we need to really check this message
       {
-         what = hi->GetTo();
-      }
-      else
-      {
-         Message_obj msg(GetMessage(hi->GetUId()));
-         if ( !msg )
+         if ( crit->m_What == SearchCriterium::SC_SUBJECT )
          {
-            FAIL_MSG( _T("SearchMessages: can't get message") );
-
-            continue;
+            what = hi->GetSubject();
          }
-
-         switch ( crit->m_What )
+         else if ( crit->m_What == SearchCriterium::SC_FROM )
+         {
+            what = hi->GetFrom();
+         }
+         else if ( crit->m_What == SearchCriterium::SC_TO )
          {
-            case SearchCriterium::SC_FULL:
-            case SearchCriterium::SC_BODY:
-               // FIXME: wrong for body as it checks the whole message
-               //        including header
-               what = msg->FetchText();
-               break;
-
-            case SearchCriterium::SC_HEADER:
-               what = msg->GetHeader();
-               break;
-
-            case SearchCriterium::SC_CC:
-               msg->GetDecodedHeaderLine(_T("CC"), what);
-               break;
-
-            default:
-               FAIL_MSG(_T("Unknown search criterium!"));
+            what = hi->GetTo();
          }
+         else
+         {
+            Message_obj msg(GetMessage(uid));
+            if ( !msg )
+            {
+               FAIL_MSG( _T("SearchMessages: can't get message") );
+
+               continue;
+            }
+
+            switch ( crit->m_What )
+            {
+               case SearchCriterium::SC_FULL:
+               case SearchCriterium::SC_BODY:
+                  // FIXME: wrong for body as it checks the whole message
+                  //        including header
+                  what = msg->FetchText();
+                  break;
+
+               case SearchCriterium::SC_HEADER:
+                  what = msg->GetHeader();
+                  break;
+
+               case SearchCriterium::SC_CC:
+                  msg->GetDecodedHeaderLine(_T("CC"), what);
+                  break;
+
+               default:
+                  FAIL_MSG(_T("Unknown search criterium!"));
+            }
+
+            // the messages are normally added to the index when they're
+            // retrieved but do it here too in case this folder messages
+            // don't do it, this doesn't do anything if it had been done
+            if ( searchIndex )
+               searchIndex->Add(GetName(), uidValidity, part, uid, what);
+         }
+
+         found = wxStrstr(what, crit->m_Key) != NULL;
       }
 
-      bool found = wxStrstr(what, crit->m_Key) != NULL;
       if ( found != crit->m_Invert )
       {
          // really found, remember its UID or msgno depending on the flags
-         results->Add(flags & SEARCH_UID ? hi->GetUId() : idx + 1);
+         results->Add(flags & SEARCH_UID ? uid : idx + 1);
       }
 
       // update the progress dialog and check for abort
@@ -1087,207 +1192,20 @@ UIdArray *MailFolderCmn::SearchMessages(const SearchCriterium *crit, int flags)
 
    delete progDlg;
 
-   return results;
-}
-
-// ----------------------------------------------------------------------------
-// MailFolderCmn sorting
-// ----------------------------------------------------------------------------
-
-// we can only sort one listing at a time currently as we use global data to
-// pass information to the C callback used by qsort() - if this proves to be a
-// significant limitation, we should reimplement sorting ourselves
-static struct SortData
-{
-   // the struct must be locked while in use
-   MMutex mutex;
-
-   // the listing which we're sorting
-   HeaderInfoList *hil;
-
-   // the parameters for sorting
-   SortParams sortParams;
-} gs_SortData;
-
-// return negative number if a < b, 0 if a == b and positive number if a > b
-#define CmpNumeric(a, b) ((a)-(b))
-
-static int ComputeStatusScore(int status)
-{
-   /*
-      The idea is to make the messages appear in the order of new, important,
-      recent or unread, other, answered so the scores are assigned in a way to
-      make new appear in front of the important, but the important before the
-      ones which are just recent or unread (remember that new == recent &&
-      unread)
-   */
-   enum
+   if ( !cont )
    {
-      SCORE_RECENT = 2,
-      SCORE_UNREAD = 3,
-      SCORE_IMPORTANT = 4,
-      SCORE_ANSWERED = -1
-   };
-
-   int score = 0;
+      // the results are incomplete, don't pretend that the search succeeded
+      delete results;
 
-   if ( status & MailFolder::MSG_STAT_RECENT )
-      score += SCORE_RECENT;
-
-   if ( !(status & MailFolder::MSG_STAT_SEEN) )
-      score += SCORE_UNREAD;
-
-   if ( status & MailFolder::MSG_STAT_FLAGGED )
-      score += SCORE_IMPORTANT;
-
-   if ( status & MailFolder::MSG_STAT_ANSWERED )
-      score += SCORE_ANSWERED;
-
-   return score;
-}
-
-static int CompareStatus(int stat1, int stat2)
-{
-   // deleted messages are considered to be less important than undeleted ones
-   if ( stat1 & MailFolder::MSG_STAT_DELETED )
-   {
-      if ( ! (stat2 & MailFolder::MSG_STAT_DELETED ) )
-         return -1;
-   }
-   else if ( stat2 & MailFolder::MSG_STAT_DELETED )
-   {
-      return 1;
+      return NULL;
    }
 
-   // now, messages are either both deleted or neither one is -- compare
-   // according to the other status bits
-   return CmpNumeric(ComputeStatusScore(stat1), ComputeStatusScore(stat2));
+   return results;
 }
 
-extern "C"
-{
-   static int SortComparisonFunction(const void *p1, const void *p2)
-   {
-      // check that the caller didn't forget to acquire the global data lock
-      ASSERT_MSG( gs_SortData.mutex.IsLocked(), _T("using unlocked gs_SortData") );
-
-      // convert msgnos to indices
-      MsgnoType n1 = *(MsgnoType *)p1 - 1,
-                n2 = *(MsgnoType *)p2 - 1;
-
-      HeaderInfo *hi1 = gs_SortData.hil->GetItemByIndex(n1),
-                 *hi2 = gs_SortData.hil->GetItemByIndex(n2);
-
-      int result = 0;
-
-      // if one header is invalid (presumable because it wasn't retrieved from
-      // server at all because the user aborted it), assume it is always less
-      // than the other
-      if ( !hi1->IsValid() )
-      {
-         // even if the second one is invalid, we may still return 1, it's not
-         // like it changes anything
-         result = -1;
-      }
-      else if ( !hi2->IsValid() )
-      {
-         // as hi1 is valid, it is greater
-         result = 1;
-      }
-
-      // copy it as we're going to modify it while processing
-      long sortOrder = gs_SortData.sortParams.sortOrder;
-      while ( !result && sortOrder != 0 )
-      {
-         long criterium = GetSortCrit(sortOrder);
-         sortOrder = GetSortNextCriterium(sortOrder);
-
-         // we rely on MessageSortOrder values being what they are: as _REV
-         // version immediately follows the normal order constant, we should
-         // reverse the comparison result for odd values of MSO_XXX
-         int reverse = criterium % 2;
-         switch ( criterium - reverse )
-         {
-            case MSO_NONE:
-               break;
-
-            case MSO_DATE:
-               result = CmpNumeric(hi1->GetDate(), hi2->GetDate());
-               break;
-
-            case MSO_SUBJECT:
-               {
-                  String
-                     subj1 = Address::NormalizeSubject(hi1->GetSubject()),
-                     subj2 = Address::NormalizeSubject(hi2->GetSubject());
-
-                  result = wxStricmp(subj1, subj2);
-               }
-               break;
-
-            case MSO_SENDER:
-               {
-                  // use "To" if needed
-                  String value1, value2;
-                  (void)HeaderInfo::GetFromOrTo
-                                    (
-                                       hi1,
-                                       gs_SortData.sortParams.detectOwnAddresses,
-                                       gs_SortData.sortParams.ownAddresses,
-                                       &value1
-                                    );
-
-                  (void)HeaderInfo::GetFromOrTo
-                                    (
-                                       hi2,
-                                       gs_SortData.sortParams.detectOwnAddresses,
-                                       gs_SortData.sortParams.ownAddresses,
-                                       &value2
-                                    );
-
-                  result = wxStricmp(value1, value2);
-               }
-               break;
-
-            case MSO_STATUS:
-               result = CompareStatus(hi1->GetStatus(), hi2->GetStatus());
-               break;
-
-            case MSO_SIZE:
-               result = CmpNumeric(hi1->GetSize(), hi2->GetSize());
-               break;
-
-            case MSO_SCORE:
-               // we don't store score any more in HeaderInfo
-#ifdef USE_HEADER_SCORE
-               result = CmpNumeric(hi1->GetScore(), hi2->GetScore());
-#else
-               FAIL_MSG(_T("unimplemented"));
-#endif // USE_HEADER_SCORE
-               break;
-
-            default:
-               FAIL_MSG(_T("unknown sorting criterium"));
-         }
-
-         if ( reverse )
-         {
-            if ( criterium == MSO_NONE )
-            {
-               // special case: result is 0 for MSO_NONE but -1 (reversed order)
-               // for MSO_NONE_REV
-               result = -1;
-            }
-            else // for all other cases just revert the result value
-            {
-               result = -result;
-            }
-         }
-      }
-
-      return result;
-   }
-}
+// ----------------------------------------------------------------------------
+// MailFolderCmn sorting
+// ----------------------------------------------------------------------------
 
 bool
 MailFolderCmn::SortMessages(MsgnoType *msgnos, const SortParams& sortParams)
@@ -1308,24 +1226,13 @@ MailFolderCmn::SortMessages(MsgnoType *msgnos, const SortParams& sortParams)
    // we need all headers, prefetch them
    hil->CacheMsgnos(1, count);
 
-   MLocker lock(gs_SortData.mutex);
-   gs_SortData.sortParams = sortParams;
-   gs_SortData.hil = hil.operator->();
+   // the sort keys object caches the keys computed for the messages during
+   // the previous sorts, so only the new messages need to be really sorted
+   MsgSortKeys *sortKeys = hil->GetSortKeys();
 
-   // start with unsorted listing
-   for ( MsgnoType n = 0; n < count; n++ )
-   {
-      // +1 because we want the msgnos, not indices
-      msgnos[n] = n + 1;
-   }
-
-   // now sort it
-   qsort(msgnos, count, sizeof(MsgnoType), SortComparisonFunction);
+   CHECK( sortKeys, false, _T("no sort keys for the listing?") );
 
-   // don't leave dangling pointers around
-   gs_SortData.hil = NULL;
-
-   return true;
+   return sortKeys->Sort(hil.operator->(), msgnos, sortParams);
 }
 
 // ----------------------------------------------------------------------------
@@ -1868,6 +1775,14 @@ MailFolderCmn::DoProcessNewMail(const MFolder *folder,
       }
    }
 
+   // remember the new messages in the full text index
+   // -------------------------------------------------
+
+   if ( mf )
+   {
+      ((MailFolderCmn *)mf)->IndexNewMail(*uidsNew);
+   }
+
    // finally, notify the user about it
    // ---------------------------------
 
@@ -1965,6 +1880,59 @@ MailFolderCmn::CollectNewMail(UIdArray& uidsNew, const String& newMailFolder)
    return true;
 }
 
+void
+MailFolderCmn::IndexNewMail(const UIdArray& uidsNew)
+{
+   if ( GetUIdValidity() == UID_ILLEGAL )
+      return;
+
+   // retrieving the headers could take a long time, so don't do it now but
+   // only when the program is idle, see IndexSomeNewMail()
+   WX_APPEND_ARRAY(m_uidsToIndex, uidsNew);
+}
+
+bool
+MailFolderCmn::IndexSomeNewMail(size_t count)
+{
+   if ( m_uidsToIndex.IsEmpty() )
+      return false;
+
+   MsgSearchIndex * const searchIndex = MsgSearchIndex::Get();
+   const UIdType uidValidity = GetUIdValidity();
+   if ( !searchIndex || uidValidity == UID_ILLEGAL )
+   {
+      m_uidsToIndex.Clear();
+
+      return false;
+   }
+
+   // only index the headers: they are small and often had been already
+   // indexed when they were retrieved by the filters, while the message text
+   // is indexed later when (and if) it is retrieved
+   size_t n;
+   for ( n = 0; n < m_uidsToIndex.GetCount() && count; n++ )
+   {
+      const UIdType uid = m_uidsToIndex[n];
+      if ( searchIndex->IsIndexed(GetName(), uidValidity,
+                                  MsgSearchIndex::Part_Header, uid) )
+         continue;
+
+      // the message could have been already deleted, just skip it then
+      Message_obj msg(GetMessage(uid));
+      if ( msg )
+      {
+         searchIndex->Add(GetName(), uidValidity,
+                          MsgSearchIndex::Part_Header, uid, msg->GetHeader());
+      }
+
+      count--;
+   }
+
+   m_uidsToIndex.RemoveAt(0, n);
+
+   return !m_uidsToIndex.IsEmpty();
+}
+
 /*
    The parameters have the following meaning:
 
@@ -2454,8 +2422,12 @@ wxFrame *MailFolderCmn::SetInteractiveFrame(wxFrame *frame)
 
 wxFrame *MailFolderCmn::GetInteractiveFrame() const
 {
-   // no interactivity at all in away mode
-   return mApplication->IsInAwayMode() ? NULL : m_frame;
+   // no interactivity at all in away mode nor in the background threads
+   // executing the folder operations as they can't use the GUI
+   if ( mApplication->IsInAwayMode() || !wxThread::IsMain() )
+      return NULL;
+
+   return m_frame;
 }
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,568 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/MailThreadPool.cpp: implementation of MailThreadPool
+// Purpose:     MailThreadPool executes folder operations in worker threads
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include  "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+#endif // USE_PCH
+
+#include "mail/MailThreadPool.h"
+
+#include <wx/tls.h>
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the limits for the global pool: we don't want to open too many connections
+// to the same server as many of them limit the number of connections per user
+// and there is not much to gain from running more threads than this anyhow
+static const size_t POOL_MAX_THREADS = 4;
+static const size_t POOL_MAX_THREADS_PER_SERVER = 2;
+
+// ----------------------------------------------------------------------------
+// globals
+// ----------------------------------------------------------------------------
+
+MailThreadPool *MailThreadPool::ms_pool = NULL;
+
+// the number of times the mail lock was entered by this thread before it was
+// released by MailLock::SuspendForIO(), 0 if it's not suspended
+static wxTLS_TYPE(size_t) tls_mailLockSuspended;
+
+#define gs_mailLockSuspended wxTLS_VALUE(tls_mailLockSuspended)
+
+// ----------------------------------------------------------------------------
+// MailLockData: the data of the global MailLock
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+struct MailLockData
+{
+   MailLockData() : cond(mutex) { owner = 0; count = 0; }
+
+   /// protects the other fields
+   wxMutex mutex;
+
+   /// signalled when the lock is released
+   wxCondition cond;
+
+   /// the thread holding the lock, only meaningful if count != 0
+   wxThreadIdType owner;
+
+   /// the number of times the lock was entered by the owner
+   size_t count;
+};
+
+// use a function to ensure that the lock is constructed before its first use
+MailLockData& GetMailLockData()
+{
+   static MailLockData s_data;
+
+   return s_data;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// MailThreadPool::Worker: the thread executing the tasks
+// ----------------------------------------------------------------------------
+
+class MailThreadPool::Worker : public wxThread
+{
+public:
+   Worker(MailThreadPool& pool)
+      : wxThread(wxTHREAD_JOINABLE),
+        m_pool(pool)
+   {
+   }
+
+protected:
+   virtual void *Entry()
+   {
+      m_pool.WorkerLoop();
+
+      return NULL;
+   }
+
+private:
+   MailThreadPool& m_pool;
+
+   DECLARE_NO_COPY_CLASS(Worker)
+};
+
+// ============================================================================
+// MailLock implementation
+// ============================================================================
+
+/* static */
+void MailLock::Enter()
+{
+   Reenter(1);
+}
+
+/* static */
+void MailLock::Leave()
+{
+   MailLockData& data = GetMailLockData();
+
+   wxMutexLocker lock(data.mutex);
+
+   CHECK_RET( data.count && data.owner == wxThread::GetCurrentId(),
+              _T("releasing the mail lock not held by this thread") );
+
+   if ( !--data.count )
+      data.cond.Signal();
+}
+
+/* static */
+size_t MailLock::LeaveAll()
+{
+   MailLockData& data = GetMailLockData();
+
+   wxMutexLocker lock(data.mutex);
+
+   if ( !data.count || data.owner != wxThread::GetCurrentId() )
+      return 0;
+
+   const size_t count = data.count;
+   data.count = 0;
+   data.cond.Signal();
+
+   return count;
+}
+
+/* static */
+void MailLock::Reenter(size_t count)
+{
+   MailLockData& data = GetMailLockData();
+   const wxThreadIdType self = wxThread::GetCurrentId();
+
+   wxMutexLocker lock(data.mutex);
+
+   if ( data.count && data.owner == self )
+   {
+      data.count += count;
+      return;
+   }
+
+   while ( data.count )
+      data.cond.Wait();
+
+   data.owner = self;
+   data.count = count;
+}
+
+/* static */
+void MailLock::SuspendForIO()
+{
+   // the main thread never releases the lock as the folder it is using could
+   // then be used by a worker thread, while the workers only execute the
+   // tasks for the folders which the main thread waits for before using them
+   if ( wxThread::IsMain() || gs_mailLockSuspended )
+      return;
+
+   gs_mailLockSuspended = LeaveAll();
+}
+
+/* static */
+void MailLock::ResumeAfterIO()
+{
+   if ( !gs_mailLockSuspended )
+      return;
+
+   Reenter(gs_mailLockSuspended);
+   gs_mailLockSuspended = 0;
+}
+
+// ============================================================================
+// MailThreadPool implementation
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// the global pool
+// ----------------------------------------------------------------------------
+
+/* static */
+MailThreadPool *MailThreadPool::Get()
+{
+   if ( !ms_pool )
+   {
+      ms_pool = new MailThreadPool(POOL_MAX_THREADS,
+                                   POOL_MAX_THREADS_PER_SERVER);
+   }
+
+   return ms_pool;
+}
+
+/* static */
+void MailThreadPool::CleanUp()
+{
+   delete ms_pool;
+   ms_pool = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// ctor/dtor
+// ----------------------------------------------------------------------------
+
+MailThreadPool::MailThreadPool(size_t maxThreads, size_t maxThreadsPerServer)
+              : m_maxThreads(maxThreads),
+                m_maxThreadsPerServer(maxThreadsPerServer),
+                m_condTask(m_mutex),
+                m_condDone(m_mutex)
+{
+   ASSERT_MSG( maxThreads && maxThreadsPerServer, _T("invalid pool limits") );
+
+   m_countIdle = 0;
+   m_serial = 0;
+   m_stopping = false;
+}
+
+MailThreadPool::~MailThreadPool()
+{
+   std::vector<Task *> tasksDiscarded;
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      m_stopping = true;
+
+      // discard all the tasks which hadn't been started yet, but keep the
+      // queues of the running ones as the workers still use them
+      FolderQueues::iterator i = m_queues.begin();
+      while ( i != m_queues.end() )
+      {
+         FolderQueue& queue = i->second;
+         for ( size_t n = 0; n < queue.tasks.size(); n++ )
+            tasksDiscarded.push_back(queue.tasks[n].task);
+
+         queue.tasks.clear();
+
+         if ( queue.running )
+            ++i;
+         else
+            m_queues.erase(i++);
+      }
+
+      m_condTask.Broadcast();
+   }
+
+   {
+      MailLocker lockMail;
+
+      for ( size_t n = 0; n < tasksDiscarded.size(); n++ )
+         delete tasksDiscarded[n];
+   }
+
+   // wait until the running tasks finish and the workers exit, they need the
+   // mail lock to do it
+   MailUnlocker unlockMail;
+
+   for ( size_t n = 0; n < m_threads.size(); n++ )
+   {
+      m_threads[n]->Wait();
+      delete m_threads[n];
+   }
+}
+
+// ----------------------------------------------------------------------------
+// public API
+// ----------------------------------------------------------------------------
+
+void
+MailThreadPool::Queue(Task *task,
+                      TaskId id,
+                      const void *folder,
+                      const String& server)
+{
+   CHECK_RET( task, _T("NULL task in MailThreadPool::Queue") );
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      CHECK_RET( !m_stopping, _T("queuing a task in the pool being deleted") );
+
+      TaskInfo info;
+      info.task = task;
+      info.id = id;
+      info.serial = m_serial++;
+
+      FolderQueue& queue = m_queues[folder];
+      queue.server = server;
+      queue.tasks.push_back(info);
+
+      // wake up the idle workers, if any: we don't know which of them can
+      // execute this task, so wake them all
+      if ( m_countIdle )
+         m_condTask.Broadcast();
+
+      // but also start a new one if there are more tasks which can be
+      // executed right now than idle workers: this happens if the idle ones
+      // had been already woken up for the previously queued tasks but didn't
+      // take them yet (the idle workers waiting because of the per-server
+      // limit don't matter as each of them takes at most one task)
+      if ( CountRunnable() <= m_countIdle )
+         return;
+
+      if ( m_threads.size() == m_maxThreads )
+      {
+         // the task will be executed by one of the existing workers when
+         // it's done with its current task
+         return;
+      }
+
+      wxThread * const thread = new Worker(*this);
+      if ( thread->Create() == wxTHREAD_NO_ERROR &&
+            thread->Run() == wxTHREAD_NO_ERROR )
+      {
+         m_threads.push_back(thread);
+         return;
+      }
+
+      delete thread;
+
+      wxLogError(_("Cannot create thread!"));
+
+      if ( !m_threads.empty() )
+      {
+         // one of the existing workers will execute it later
+         return;
+      }
+
+      // we have no workers at all, so execute the task ourselves below
+      queue.tasks.pop_back();
+      if ( queue.tasks.empty() && !queue.running )
+         m_queues.erase(folder);
+   }
+
+   MailLocker lockMail;
+
+   task->Execute();
+   delete task;
+}
+
+bool MailThreadPool::Cancel(TaskId id)
+{
+   Task *taskDiscarded = NULL;
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      for ( FolderQueues::iterator i = m_queues.begin();
+            i != m_queues.end();
+            ++i )
+      {
+         FolderQueue& queue = i->second;
+         if ( queue.running && queue.running->id == id )
+         {
+            // we can't stop it, but we can tell it to stop
+            wxAtomicInc(queue.running->task->m_cancelled);
+
+            return true;
+         }
+
+         for ( std::deque<TaskInfo>::iterator j = queue.tasks.begin();
+               j != queue.tasks.end();
+               ++j )
+         {
+            if ( j->id == id )
+            {
+               taskDiscarded = j->task;
+               queue.tasks.erase(j);
+
+               if ( queue.tasks.empty() && !queue.running )
+               {
+                  m_queues.erase(i);
+
+                  m_condDone.Broadcast();
+               }
+
+               break;
+            }
+         }
+
+         if ( taskDiscarded )
+            break;
+      }
+   }
+
+   if ( !taskDiscarded )
+      return false;
+
+   wxAtomicInc(taskDiscarded->m_cancelled);
+
+   MailLocker lockMail;
+   delete taskDiscarded;
+
+   return true;
+}
+
+void MailThreadPool::WaitForFolder(const void *folder)
+{
+   // this is called before every folder access from the main thread, so
+   // don't release the mail lock unless really necessary
+   if ( !HasTasksFor(folder) )
+      return;
+
+   // the tasks can't run without the mail lock, notice that it must be
+   // reacquired after unlocking m_mutex to avoid deadlocks
+   MailUnlocker unlockMail;
+
+   wxMutexLocker lock(m_mutex);
+
+   while ( m_queues.find(folder) != m_queues.end() )
+      m_condDone.Wait();
+}
+
+void MailThreadPool::WaitForAll()
+{
+   MailUnlocker unlockMail;
+
+   wxMutexLocker lock(m_mutex);
+
+   while ( !m_queues.empty() )
+      m_condDone.Wait();
+}
+
+bool MailThreadPool::HasTasksFor(const void *folder)
+{
+   wxMutexLocker lock(m_mutex);
+
+   return m_queues.find(folder) != m_queues.end();
+}
+
+// ----------------------------------------------------------------------------
+// worker threads
+// ----------------------------------------------------------------------------
+
+MailThreadPool::FolderQueues::iterator MailThreadPool::FindRunnable()
+{
+   FolderQueues::iterator found = m_queues.end();
+   for ( FolderQueues::iterator i = m_queues.begin(); i != m_queues.end(); ++i )
+   {
+      const FolderQueue& queue = i->second;
+
+      // only one task at a time can be running for a folder
+      if ( queue.running || queue.tasks.empty() )
+         continue;
+
+      if ( m_runningPerServer[queue.server] == m_maxThreadsPerServer )
+         continue;
+
+      // among all runnable tasks, choose the one queued first
+      if ( found == m_queues.end() ||
+            queue.tasks.front().serial < found->second.tasks.front().serial )
+      {
+         found = i;
+      }
+   }
+
+   return found;
+}
+
+size_t MailThreadPool::CountRunnable() const
+{
+   std::map<String, size_t> runningPerServer(m_runningPerServer);
+
+   size_t count = 0;
+   for ( FolderQueues::const_iterator i = m_queues.begin();
+         i != m_queues.end();
+         ++i )
+   {
+      const FolderQueue& queue = i->second;
+      if ( queue.running || queue.tasks.empty() )
+         continue;
+
+      size_t& running = runningPerServer[queue.server];
+      if ( running == m_maxThreadsPerServer )
+         continue;
+
+      running++;
+      count++;
+   }
+
+   return count;
+}
+
+void MailThreadPool::WorkerLoop()
+{
+   wxMutexLocker lock(m_mutex);
+
+   for ( ;; )
+   {
+      const FolderQueues::iterator i = FindRunnable();
+      if ( i == m_queues.end() )
+      {
+         if ( m_stopping )
+            break;
+
+         m_countIdle++;
+         m_condTask.Wait();
+         m_countIdle--;
+
+         continue;
+      }
+
+      // note that the iterator remains valid while the task is running as the
+      // queue of the folder with a running task is never erased
+      FolderQueue& queue = i->second;
+
+      TaskInfo info = queue.tasks.front();
+      queue.tasks.pop_front();
+      queue.running = &info;
+      m_runningPerServer[queue.server]++;
+
+      m_mutex.Unlock();
+
+      {
+         MailLocker lockMail;
+
+         info.task->Execute();
+      }
+
+      m_mutex.Lock();
+
+      queue.running = NULL;
+      m_runningPerServer[queue.server]--;
+
+      if ( queue.tasks.empty() )
+         m_queues.erase(i);
+
+      // another task for the same folder or server may be runnable now
+      m_condTask.Broadcast();
+      m_condDone.Broadcast();
+
+      // Cancel() can't access the task any more now that it's not running
+      m_mutex.Unlock();
+
+      {
+         // the task may release the mail objects it used
+         MailLocker lockMail;
+
+         delete info.task;
+      }
+
+      m_mutex.Lock();
+   }
+}
@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/MessageAppender.cpp - MessageAppender class implementation
+// Purpose:     MessageAppender appends many messages to a mailbox at once
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+#  include "Mcommon.h"
+#  include "Mcclient.h"
+#endif // USE_PCH
+
+#include "mail/MessageAppender.h"
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// trace mask, the same as used by MailFolderCC
+#define TRACE_MF_CALLS _T("mfcall")
+
+// the default maximal number of messages and their total size in a batch
+static const size_t APPEND_BATCH_MAX_COUNT = 100;
+static const size_t APPEND_BATCH_MAX_SIZE = 8*1024*1024;
+
+// ----------------------------------------------------------------------------
+// private types
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// a batch of messages passed to mail_append_multiple()
+struct AppendBatch
+{
+   AppendBatch() { next = 0; }
+
+   // the messages of the batch and their indices in the source
+   std::vector<MessageAppender::Data> messages;
+   std::vector<size_t> indices;
+
+   // the index of the next message to give to c-client
+   size_t next;
+
+   // the current message text
+   STRING str;
+};
+
+// initialize the c-client parameters for appending the given message, the
+// pointers remain valid while data is alive
+void
+InitAppendParams(const MessageAppender::Data& data,
+                 char **flags,
+                 char **date,
+                 STRING *str)
+{
+   *flags = data.flags.empty() ? NIL : const_cast<char *>(data.flags.c_str());
+   *date = data.date.empty() ? NIL : const_cast<char *>(data.date.c_str());
+
+   INIT(str, mail_string, const_cast<char *>(data.text.data()),
+        data.text.length());
+}
+
+} // anonymous namespace
+
+// append_t callback for mail_append_multiple() called by c-client for each
+// message it appends
+extern "C"
+{
+
+static long
+AppendBatchCallback(MAILSTREAM * /* stream */,
+                    void *data,
+                    char **flags,
+                    char **date,
+                    STRING **message)
+{
+   AppendBatch * const batch = static_cast<AppendBatch *>(data);
+
+   if ( batch->next == batch->messages.size() )
+   {
+      // no more messages in this batch
+      *message = NIL;
+
+      return LONGT;
+   }
+
+   // this is called only after the previous message was sent, so we can
+   // reuse the same STRING for all of them
+   InitAppendParams(batch->messages[batch->next++], flags, date, &batch->str);
+
+   *message = &batch->str;
+
+   return LONGT;
+}
+
+} // extern "C"
+
+// ============================================================================
+// MessageAppender implementation
+// ============================================================================
+
+MessageAppender::MessageAppender(MAILSTREAM *stream,
+                                 const char *mailbox,
+                                 bool atomic)
+               : m_stream(stream),
+                 m_mailbox(mailbox),
+                 m_atomic(atomic)
+{
+   m_maxCount = APPEND_BATCH_MAX_COUNT;
+   m_maxSize = APPEND_BATCH_MAX_SIZE;
+
+   m_cancelled = false;
+
+   m_countBatches =
+   m_countRetries = 0;
+}
+
+void MessageAppender::SetBatchLimits(size_t count, size_t size)
+{
+   CHECK_RET( count, _T("batch must contain at least one message") );
+
+   m_maxCount = count;
+   m_maxSize = size;
+}
+
+bool MessageAppender::AppendOne(const Data& data)
+{
+   char *flags,
+        *date;
+   STRING str;
+   InitAppendParams(data, &flags, &date, &str);
+
+   return mail_append_full(m_stream,
+                           const_cast<char *>(m_mailbox.c_str()),
+                           flags,
+                           date,
+                           &str) != NIL;
+}
+
+bool
+MessageAppender::Append(Source& source,
+                        size_t count,
+                        std::vector<size_t>& failed)
+{
+   m_cancelled = false;
+
+   const size_t countFailedOld = failed.size();
+
+   size_t n = 0;
+   while ( n < count )
+   {
+      // retrieve the messages of the next batch from the source
+      AppendBatch batch;
+      size_t size = 0;
+      for ( ; n < count; n++ )
+      {
+         if ( batch.messages.size() == m_maxCount || size >= m_maxSize )
+            break;
+
+         if ( !source.OnRetrieve(n) )
+         {
+            m_cancelled = true;
+
+            return false;
+         }
+
+         Data data;
+         if ( !source.GetMessage(n, data) )
+         {
+            failed.push_back(n);
+            continue;
+         }
+
+         size += data.text.length();
+         batch.messages.push_back(data);
+         batch.indices.push_back(n);
+      }
+
+      if ( batch.messages.empty() )
+         continue;
+
+      m_countBatches++;
+
+      if ( !mail_append_multiple(m_stream,
+                                 const_cast<char *>(m_mailbox.c_str()),
+                                 AppendBatchCallback,
+                                 &batch) )
+      {
+         // this batch failed, find out which of its messages we need to
+         // append again: either all of them or only those starting with the
+         // one which failed
+         size_t first = 0;
+         if ( !m_atomic && batch.next > 0 )
+            first = batch.next - 1;
+
+         wxLogTrace(TRACE_MF_CALLS,
+                    _T("MessageAppender(%s): appending %lu messages one by one"),
+                    m_mailbox.c_str(),
+                    (unsigned long)(batch.messages.size() - first));
+
+         // append them separately, so that the errors for one of them don't
+         // prevent the others from being appended
+         for ( size_t m = first; m < batch.messages.size(); m++ )
+         {
+            m_countRetries++;
+
+            if ( !AppendOne(batch.messages[m]) )
+               failed.push_back(batch.indices[m]);
+         }
+      }
+
+      if ( !source.OnAppended(n) )
+      {
+         // cancelled, but the messages were appended anyhow
+         m_cancelled = true;
+
+         return false;
+      }
+   }
+
+   return failed.size() == countFailedOld;
+}
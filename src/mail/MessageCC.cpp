@@ -29,6 +29,7 @@
 #endif // USE_PCH
 
 #include "mail/MimeDecode.h"
+#include "mail/SearchIndex.h"
 #include "AddressCC.h"
 #include "MailFolderCC.h"
 #include "MessageCC.h"
@@ -61,6 +62,86 @@
       return rc;                                                              \
    }
 
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the size of the chunks in which WriteRawPartData() retrieves the part text
+static const unsigned long PART_CHUNK_SIZE = 256*1024;
+
+// ----------------------------------------------------------------------------
+// globals
+// ----------------------------------------------------------------------------
+
+// the data used by PartDataGets() during WriteRawPartData() execution: as
+// mailgets callback doesn't take any user-defined parameter, we have to use
+// globals to pass it (this is safe as the folder is locked meanwhile)
+static struct PartDataGetsInfo
+{
+   // the sink to write the data to
+   MimePartSink *sink;
+
+   // the number of bytes read by the last fetch
+   unsigned long count;
+
+   // false if the sink refused the data
+   bool ok;
+} gs_partDataGetsInfo;
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+extern "C"
+{
+
+// mailgets callback passing the data to gs_partDataGetsInfo.sink
+static char *PartDataGets(readfn_t f,
+                          void *stream,
+                          unsigned long size,
+                          GETS_DATA * /* md */)
+{
+   PartDataGetsInfo& info = gs_partDataGetsInfo;
+
+   char buf[16384];
+   while ( size )
+   {
+      const unsigned long len = size < sizeof(buf) ? size : sizeof(buf);
+
+      // we must read all data even if the sink doesn't want it any more to
+      // keep the protocol in sync
+      (*f)(stream, len, buf);
+
+      if ( info.ok )
+         info.ok = info.sink->Write(buf, len);
+
+      info.count += len;
+      size -= len;
+   }
+
+   // we don't want c-client to cache anything
+   return NIL;
+}
+
+} // extern "C"
+
+// add the given part of the message to the full text index if possible
+static void AddToSearchIndex(const MailFolderCC *folder,
+                             UIdType uid,
+                             MsgSearchIndex::Part part,
+                             const String& text)
+{
+   MsgSearchIndex * const searchIndex = MsgSearchIndex::Get();
+   if ( !searchIndex )
+      return;
+
+   const UIdType uidValidity = folder->GetUIdValidity();
+   if ( uidValidity != UID_ILLEGAL )
+   {
+      searchIndex->Add(folder->GetName(), uidValidity, part, uid, text);
+   }
+}
+
 // ============================================================================
 // implementation
 // ============================================================================
@@ -252,6 +333,8 @@ String MessageCC::GetHeader(void) const
                                                   NULL, &len, FT_UID);
          m_folder->UnLock();
          str = String::From8BitData(cptr, len);
+
+         AddToSearchIndex(m_folder, m_uid, MsgSearchIndex::Part_Header, str);
       }
       else
       {
@@ -481,6 +564,13 @@ MessageCC::FetchText(void) const
 
             m_folder->UnLock();
 
+            // remember the words of this message for the future searches
+            if ( m_mailFullText )
+            {
+               AddToSearchIndex(m_folder, m_uid, MsgSearchIndex::Part_Text,
+                                wxString::From8BitData(m_mailFullText));
+            }
+
             // there once has been an assert here checking that the message
             // length was positive, but it makes no sense as 0 length messages
             // do exist - so I removed it
@@ -675,6 +765,95 @@ MessageCC::GetRawPartData(const MimePart& mimepart, unsigned long *lenptr)
    return DoGetPartAny(mimepart, lenptr, mail_fetch_body);
 }
 
+bool
+MessageCC::WriteRawPartData(const MimePart& mimepart, MimePartSink& sink)
+{
+   CHECK( m_folder, false, _T("MessageCC::WriteRawPartData() without folder?") );
+
+   CheckMIME();
+
+   MAILSTREAM *stream = m_folder->Stream();
+   if ( !stream )
+   {
+      ERRORMESSAGE((_("Impossible to retrieve message text: "
+                      "folder '%s' is closed."),
+                    m_folder->GetName()));
+      return false;
+   }
+
+   if ( !m_folder->Lock() )
+   {
+      ERRORMESSAGE((_("Impossible to retrieve message text: "
+                      "failed to lock folder '%s'."),
+                    m_folder->GetName()));
+      return false;
+   }
+
+   const unsigned long size = mimepart.GetSize();
+   const String& sp = mimepart.GetPartSpec();
+
+   PartDataGetsInfo& info = gs_partDataGetsInfo;
+   ASSERT_MSG( !info.sink, _T("WriteRawPartData() can't be reentered") );
+
+   info.sink = &sink;
+   info.ok = true;
+
+   mailgets_t mailgetsOld = (mailgets_t)mail_parameters(NIL, GET_GETS, NIL);
+   mail_parameters(NIL, SET_GETS, (void *)PartDataGets);
+
+   // fetch the part in chunks until we get less than we asked for
+   unsigned long pos = 0;
+   bool ok = true,
+        fetched = false;
+   for ( ;; )
+   {
+      info.count = 0;
+
+      if ( !mail_partial_body(stream, m_uid, sp.char_str(),
+                              pos, PART_CHUNK_SIZE, FT_UID) )
+      {
+         ok = false;
+         break;
+      }
+
+      fetched = true;
+
+      pos += info.count;
+
+      if ( !info.ok || !sink.OnProgress(pos, size) )
+      {
+         ok = false;
+         break;
+      }
+
+      if ( info.count < PART_CHUNK_SIZE )
+         break;
+   }
+
+   mail_parameters(NIL, SET_GETS, (void *)mailgetsOld);
+
+   info.sink = NULL;
+
+   m_folder->UnLock();
+
+   if ( !fetched )
+   {
+      // partial fetches are not supported by pre-IMAP4rev1 servers, fall back
+      // to retrieving the entire part at once
+      wxLogDebug(_T("Partial fetch of part %s failed, fetching it entirely."),
+                 sp);
+
+      unsigned long len;
+      const char *cptr = GetRawPartData(mimepart, &len);
+      if ( !cptr )
+         return !size;
+
+      ok = sink.Write(cptr, len) && sink.OnProgress(len, size);
+   }
+
+   return ok;
+}
+
 String
 MessageCC::GetPartHeaders(const MimePart& mimepart)
 {
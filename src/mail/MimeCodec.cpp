@@ -0,0 +1,1387 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/MimeCodec.cpp: Base64 and quoted-printable codecs
+// Author:      Mahogany team
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef  USE_PCH
+   #include "Mcommon.h"
+#endif // !USE_PCH
+
+#include "mail/MimeCodec.h"
+
+// SSE2 is always available when targeting x86-64 and can be enabled for x86
+#if defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #define M_CODEC_SSE2
+   #include <emmintrin.h>
+#endif
+
+// AVX2 is not, so with gcc and clang we compile AVX2 code even if it's not
+// enabled by default and only use it if the CPU supports it, while with the
+// other compilers we only use it if it's enabled for the entire program
+#if defined(M_CODEC_SSE2) && defined(__GNUC__)
+   #define M_CODEC_AVX2
+   #define M_TARGET_AVX2 __attribute__((target("avx2")))
+   #include <immintrin.h>
+#elif defined(__AVX2__)
+   #define M_CODEC_AVX2
+   #define M_TARGET_AVX2
+   #include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+   #include <intrin.h>
+#endif
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// special values in BASE64_VALUES table
+enum
+{
+   PAD = 0x40,    // padding character '='
+   WSP = 0x7e,    // whitespace: NUL, TAB, LF, FF, CR, SPC
+   JNK = 0x7f     // anything else
+};
+
+// the 6 bit value of each Base64 character, the same as used by c-client
+static const unsigned char BASE64_VALUES[256] =
+{
+   WSP,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,WSP,WSP,JNK,WSP,WSP,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   WSP,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK, 62,JNK,JNK,JNK, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61,JNK,JNK,JNK,PAD,JNK,JNK,
+   JNK,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,JNK,JNK,JNK,JNK,JNK,
+   JNK, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+   JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,JNK,
+};
+
+static const char BASE64_CHARS[] =
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// the maximal length of a QP line, the 76th position is only used by the '='
+// of the soft line break
+static const size_t QP_MAX_LINE_LEN = 75;
+
+// ----------------------------------------------------------------------------
+// local helper functions
+// ----------------------------------------------------------------------------
+
+// return the index of the lowest bit set in a non-zero mask
+static inline unsigned LowestBit(unsigned mask)
+{
+#ifdef _MSC_VER
+   unsigned long n;
+   _BitScanForward(&n, mask);
+   return n;
+#else
+   return __builtin_ctz(mask);
+#endif
+}
+
+// return the index of the highest bit set in a non-zero mask
+static inline unsigned HighestBit(unsigned mask)
+{
+#ifdef _MSC_VER
+   unsigned long n;
+   _BitScanReverse(&n, mask);
+   return n;
+#else
+   return 31 - __builtin_clz(mask);
+#endif
+}
+
+static inline bool IsHexDigit(unsigned char c)
+{
+   return (c >= '0' && c <= '9') ||
+            (c >= 'A' && c <= 'F') ||
+               (c >= 'a' && c <= 'f');
+}
+
+static inline unsigned char HexDigitValue(unsigned char c)
+{
+   return c <= '9' ? c - '0' : (c <= 'F' ? c - 'A' : c - 'a') + 10;
+}
+
+// return true if the character can't appear as is in QP-encoded text
+static inline bool NeedsQPEncoding(unsigned char c)
+{
+   return c < 0x20 || c >= 0x7f || c == '=';
+}
+
+// return the 3 bytes starting at the given position as a 24 bit number
+static inline int Load24(const unsigned char *p)
+{
+   return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+// ============================================================================
+// codec implementations
+// ============================================================================
+
+/*
+   The decoding and encoding functions below all use the same scalar code and
+   differ only in the functions they use for processing the data which doesn't
+   need any special handling in big blocks.
+ */
+
+struct CodecImpl
+{
+   // decode the complete blocks consisting only of Base64 data characters,
+   // stopping at the first block containing anything else, and return the
+   // number of characters decoded, which is always a multiple of 4
+   //
+   // the output buffer must have 4 bytes more than needed for the result
+   size_t (*decodeBase64)(const unsigned char *s,
+                          size_t len,
+                          unsigned char *d);
+
+   // encode the complete blocks of data in Base64 and return the number of
+   // bytes encoded, which is always a multiple of 3
+   size_t (*encodeBase64)(const unsigned char *s,
+                          size_t len,
+                          unsigned char *d);
+
+   // return the number of leading characters which are taken literally when
+   // decoding QP, i.e. everything except '=', CR and LF, and fill posEnd with
+   // the position after the last non-space among them or 0 if there is none
+   size_t (*scanQPLiteral)(const unsigned char *s,
+                           size_t len,
+                           size_t *posEnd);
+
+   // return the number of leading characters which don't need to be encoded
+   // in QP
+   size_t (*scanQPSafe)(const unsigned char *s, size_t len);
+};
+
+// ----------------------------------------------------------------------------
+// scalar implementation
+// ----------------------------------------------------------------------------
+
+static size_t
+ScanQPLiteralScalar(const unsigned char *s, size_t len, size_t *posEnd)
+{
+   *posEnd = 0;
+
+   size_t n;
+   for ( n = 0; n < len; n++ )
+   {
+      const unsigned char c = s[n];
+      if ( c == '=' || c == '\r' || c == '\n' )
+         break;
+
+      if ( c != ' ' )
+         *posEnd = n + 1;
+   }
+
+   return n;
+}
+
+static size_t ScanQPSafeScalar(const unsigned char *s, size_t len)
+{
+   size_t n;
+   for ( n = 0; n < len && !NeedsQPEncoding(s[n]); n++ )
+      ;
+
+   return n;
+}
+
+static const CodecImpl gs_codecScalar =
+{
+   NULL,
+   NULL,
+   ScanQPLiteralScalar,
+   ScanQPSafeScalar,
+};
+
+// ----------------------------------------------------------------------------
+// SSE2 implementation
+// ----------------------------------------------------------------------------
+
+#ifdef M_CODEC_SSE2
+
+// convert 16 Base64 characters to their 6 bit values, return false if any of
+// them is not a data character
+static inline bool Base64ToValuesSSE2(__m128i x, __m128i *values)
+{
+   const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)),
+                                       _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+   const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('a' - 1)),
+                                       _mm_cmplt_epi8(x, _mm_set1_epi8('z' + 1)));
+   const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1)),
+                                       _mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1)));
+   const __m128i plus = _mm_cmpeq_epi8(x, _mm_set1_epi8('+'));
+   const __m128i slash = _mm_cmpeq_epi8(x, _mm_set1_epi8('/'));
+
+   const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+                                      _mm_or_si128(_mm_or_si128(digit, plus),
+                                                   slash));
+   if ( _mm_movemask_epi8(valid) != 0xffff )
+      return false;
+
+   // the character classes are disjoint, so just combine their offsets
+   __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+   shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+   shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+   shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+   shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+
+   *values = _mm_add_epi8(x, shift);
+
+   return true;
+}
+
+// convert 6 bit values to Base64 characters
+static inline __m128i ValuesToBase64SSE2(__m128i values)
+{
+   __m128i shift = _mm_set1_epi8('A');
+   shift = _mm_add_epi8(shift,
+                        _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(25)),
+                                      _mm_set1_epi8('a' - 26 - 'A')));
+   shift = _mm_add_epi8(shift,
+                        _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(51)),
+                                      _mm_set1_epi8('0' - 52 - 'a' + 26)));
+   shift = _mm_add_epi8(shift,
+                        _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(61)),
+                                      _mm_set1_epi8('+' - 62 - '0' + 52)));
+   shift = _mm_add_epi8(shift,
+                        _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(62)),
+                                      _mm_set1_epi8('/' - 63 - '+' + 62)));
+
+   return _mm_add_epi8(values, shift);
+}
+
+// split the 24 bit values in each 32 bit lane into 4 bytes containing 6 bits
+// each, with the most significant bits in the first byte in memory order
+static inline __m128i SplitTripletsSSE2(__m128i u)
+{
+   const __m128i mask = _mm_set1_epi32(0x3f);
+
+   const __m128i
+      v0 = _mm_and_si128(_mm_srli_epi32(u, 18), mask),
+      v1 = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(u, 12), mask), 8),
+      v2 = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(u, 6), mask), 16),
+      v3 = _mm_slli_epi32(_mm_and_si128(u, mask), 24);
+
+   return _mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3));
+}
+
+static size_t
+DecodeBase64SSE2(const unsigned char *s, size_t len, unsigned char *d)
+{
+   size_t n;
+   for ( n = 0; len - n >= 16; n += 16 )
+   {
+      __m128i values;
+      if ( !Base64ToValuesSSE2
+            (
+               _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n)),
+               &values
+            ) )
+      {
+         break;
+      }
+
+      // combine the pairs of 6 bit values into 12 bit values and then pairs
+      // of those into 24 bit values in each 32 bit lane
+      const __m128i w = _mm_or_si128
+                        (
+                           _mm_slli_epi16(_mm_and_si128(values,
+                                                        _mm_set1_epi16(0xff)),
+                                          6),
+                           _mm_srli_epi16(values, 8)
+                        );
+      const __m128i u = _mm_or_si128
+                        (
+                           _mm_slli_epi32(_mm_and_si128(w,
+                                                        _mm_set1_epi32(0xffff)),
+                                          12),
+                           _mm_srli_epi32(w, 16)
+                        );
+
+      // there is no byte shuffle instruction in SSE2, so store the bytes of
+      // each lane individually
+      wxUint32 triplets[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(triplets), u);
+
+      for ( size_t i = 0; i < WXSIZEOF(triplets); i++ )
+      {
+         *d++ = (unsigned char)(triplets[i] >> 16);
+         *d++ = (unsigned char)(triplets[i] >> 8);
+         *d++ = (unsigned char)triplets[i];
+      }
+   }
+
+   return n;
+}
+
+static size_t
+EncodeBase64SSE2(const unsigned char *s, size_t len, unsigned char *d)
+{
+   size_t n;
+   for ( n = 0; len - n >= 12; n += 12, d += 16 )
+   {
+      const unsigned char * const p = s + n;
+      const __m128i u = _mm_setr_epi32(Load24(p), Load24(p + 3),
+                                       Load24(p + 6), Load24(p + 9));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                       ValuesToBase64SSE2(SplitTripletsSSE2(u)));
+   }
+
+   return n;
+}
+
+static size_t
+ScanQPLiteralSSE2(const unsigned char *s, size_t len, size_t *posEnd)
+{
+   *posEnd = 0;
+
+   size_t n;
+   for ( n = 0; len - n >= 16; n += 16 )
+   {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n));
+
+      const unsigned maskSpecial = _mm_movemask_epi8
+                                   (
+                                    _mm_or_si128
+                                    (
+                                       _mm_cmpeq_epi8(x, _mm_set1_epi8('=')),
+                                       _mm_or_si128
+                                       (
+                                          _mm_cmpeq_epi8(x, _mm_set1_epi8('\r')),
+                                          _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))
+                                       )
+                                    )
+                                   );
+      unsigned maskNonSpace =
+         ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(' '))) & 0xffff;
+
+      if ( maskSpecial )
+      {
+         const unsigned count = LowestBit(maskSpecial);
+         maskNonSpace &= (1u << count) - 1;
+         if ( maskNonSpace )
+            *posEnd = n + HighestBit(maskNonSpace) + 1;
+
+         return n + count;
+      }
+
+      if ( maskNonSpace )
+         *posEnd = n + HighestBit(maskNonSpace) + 1;
+   }
+
+   size_t posTail;
+   const size_t count = ScanQPLiteralScalar(s + n, len - n, &posTail);
+   if ( posTail )
+      *posEnd = n + posTail;
+
+   return n + count;
+}
+
+static size_t ScanQPSafeSSE2(const unsigned char *s, size_t len)
+{
+   size_t n;
+   for ( n = 0; len - n >= 16; n += 16 )
+   {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n));
+
+      // notice that the signed comparison treats 8 bit characters as negative
+      const __m128i safe = _mm_andnot_si128
+                           (
+                              _mm_cmpeq_epi8(x, _mm_set1_epi8('=')),
+                              _mm_and_si128
+                              (
+                                 _mm_cmpgt_epi8(x, _mm_set1_epi8(0x1f)),
+                                 _mm_cmplt_epi8(x, _mm_set1_epi8(0x7f))
+                              )
+                           );
+
+      const unsigned mask = _mm_movemask_epi8(safe);
+      if ( mask != 0xffff )
+         return n + LowestBit(~mask);
+   }
+
+   return n + ScanQPSafeScalar(s + n, len - n);
+}
+
+static const CodecImpl gs_codecSSE2 =
+{
+   DecodeBase64SSE2,
+   EncodeBase64SSE2,
+   ScanQPLiteralSSE2,
+   ScanQPSafeSSE2,
+};
+
+#endif // M_CODEC_SSE2
+
+// ----------------------------------------------------------------------------
+// AVX2 implementation
+// ----------------------------------------------------------------------------
+
+#ifdef M_CODEC_AVX2
+
+M_TARGET_AVX2
+static size_t
+DecodeBase64AVX2(const unsigned char *s, size_t len, unsigned char *d)
+{
+   size_t n;
+   for ( n = 0; len - n >= 32; n += 32, d += 24 )
+   {
+      const __m256i
+         x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + n));
+
+      const __m256i
+         upper = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('A' - 1)),
+                                  _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), x)),
+         lower = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('a' - 1)),
+                                  _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), x)),
+         digit = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('0' - 1)),
+                                  _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), x)),
+         plus = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('+')),
+         slash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('/'));
+
+      const __m256i
+         valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                                 _mm256_or_si256(_mm256_or_si256(digit, plus),
+                                                 slash));
+      if ( _mm256_movemask_epi8(valid) != -1 )
+         break;
+
+      __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+      shift = _mm256_or_si256(shift,
+                              _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+      shift = _mm256_or_si256(shift,
+                              _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+      shift = _mm256_or_si256(shift,
+                              _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+      shift = _mm256_or_si256(shift,
+                              _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+
+      const __m256i values = _mm256_add_epi8(x, shift);
+
+      // combine 4 6 bit values into 24 bits in each 32 bit lane and then
+      // extract the 3 bytes of each lane in the right order
+      const __m256i
+         w = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)),
+         u = _mm256_madd_epi16(w, _mm256_set1_epi32(0x00011000)),
+         bytes = _mm256_shuffle_epi8(u, _mm256_setr_epi8
+                                        (
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                          -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                          -1, -1, -1, -1
+                                        ));
+
+      // this writes 4 extra bytes after the end of output
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                       _mm256_castsi256_si128(bytes));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 12),
+                       _mm256_extracti128_si256(bytes, 1));
+   }
+
+   return n;
+}
+
+M_TARGET_AVX2
+static size_t
+EncodeBase64AVX2(const unsigned char *s, size_t len, unsigned char *d)
+{
+   // we read 16 bytes starting at offset 12 to get the second half of the
+   // block, so we need 4 more bytes than we actually encode
+   size_t n;
+   for ( n = 0; len - n >= 28; n += 24, d += 32 )
+   {
+      const __m256i in = _mm256_inserti128_si256
+                         (
+                           _mm256_castsi128_si256(_mm_loadu_si128(
+                              reinterpret_cast<const __m128i *>(s + n))),
+                           _mm_loadu_si128(
+                              reinterpret_cast<const __m128i *>(s + n + 12)),
+                           1
+                         );
+
+      // put each group of 3 bytes into a 32 bit lane as a 24 bit number
+      const __m256i u = _mm256_shuffle_epi8(in, _mm256_setr_epi8
+                                                (
+                                                   2, 1, 0, -1, 5, 4, 3, -1,
+                                                   8, 7, 6, -1, 11, 10, 9, -1,
+                                                   2, 1, 0, -1, 5, 4, 3, -1,
+                                                   8, 7, 6, -1, 11, 10, 9, -1
+                                                ));
+
+      const __m256i mask = _mm256_set1_epi32(0x3f);
+      const __m256i values = _mm256_or_si256
+      (
+         _mm256_or_si256
+         (
+            _mm256_and_si256(_mm256_srli_epi32(u, 18), mask),
+            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(u, 12), mask), 8)
+         ),
+         _mm256_or_si256
+         (
+            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(u, 6), mask), 16),
+            _mm256_slli_epi32(_mm256_and_si256(u, mask), 24)
+         )
+      );
+
+      __m256i shift = _mm256_set1_epi8('A');
+      shift = _mm256_add_epi8(shift, _mm256_and_si256(
+                  _mm256_cmpgt_epi8(values, _mm256_set1_epi8(25)),
+                  _mm256_set1_epi8('a' - 26 - 'A')));
+      shift = _mm256_add_epi8(shift, _mm256_and_si256(
+                  _mm256_cmpgt_epi8(values, _mm256_set1_epi8(51)),
+                  _mm256_set1_epi8('0' - 52 - 'a' + 26)));
+      shift = _mm256_add_epi8(shift, _mm256_and_si256(
+                  _mm256_cmpgt_epi8(values, _mm256_set1_epi8(61)),
+                  _mm256_set1_epi8('+' - 62 - '0' + 52)));
+      shift = _mm256_add_epi8(shift, _mm256_and_si256(
+                  _mm256_cmpgt_epi8(values, _mm256_set1_epi8(62)),
+                  _mm256_set1_epi8('/' - 63 - '+' + 62)));
+
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(d),
+                          _mm256_add_epi8(values, shift));
+   }
+
+   return n;
+}
+
+M_TARGET_AVX2
+static size_t
+ScanQPLiteralAVX2(const unsigned char *s, size_t len, size_t *posEnd)
+{
+   *posEnd = 0;
+
+   size_t n;
+   for ( n = 0; len - n >= 32; n += 32 )
+   {
+      const __m256i
+         x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + n));
+
+      const unsigned maskSpecial = _mm256_movemask_epi8
+                                   (
+                                    _mm256_or_si256
+                                    (
+                                       _mm256_cmpeq_epi8(x, _mm256_set1_epi8('=')),
+                                       _mm256_or_si256
+                                       (
+                                          _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')),
+                                          _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'))
+                                       )
+                                    )
+                                   );
+      unsigned maskNonSpace =
+         ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+
+      if ( maskSpecial )
+      {
+         const unsigned count = LowestBit(maskSpecial);
+         maskNonSpace &= (1u << count) - 1;
+         if ( maskNonSpace )
+            *posEnd = n + HighestBit(maskNonSpace) + 1;
+
+         return n + count;
+      }
+
+      if ( maskNonSpace )
+         *posEnd = n + HighestBit(maskNonSpace) + 1;
+   }
+
+   size_t posTail;
+   const size_t count = ScanQPLiteralScalar(s + n, len - n, &posTail);
+   if ( posTail )
+      *posEnd = n + posTail;
+
+   return n + count;
+}
+
+M_TARGET_AVX2
+static size_t ScanQPSafeAVX2(const unsigned char *s, size_t len)
+{
+   size_t n;
+   for ( n = 0; len - n >= 32; n += 32 )
+   {
+      const __m256i
+         x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + n));
+
+      const __m256i safe = _mm256_andnot_si256
+                           (
+                              _mm256_cmpeq_epi8(x, _mm256_set1_epi8('=')),
+                              _mm256_and_si256
+                              (
+                                 _mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x1f)),
+                                 _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), x)
+                              )
+                           );
+
+      const unsigned mask = _mm256_movemask_epi8(safe);
+      if ( mask != 0xffffffff )
+         return n + LowestBit(~mask);
+   }
+
+   return n + ScanQPSafeScalar(s + n, len - n);
+}
+
+static const CodecImpl gs_codecAVX2 =
+{
+   DecodeBase64AVX2,
+   EncodeBase64AVX2,
+   ScanQPLiteralAVX2,
+   ScanQPSafeAVX2,
+};
+
+#endif // M_CODEC_AVX2
+
+// ----------------------------------------------------------------------------
+// codec selection
+// ----------------------------------------------------------------------------
+
+// return the implementation of the given codec or NULL if it's not available
+static const CodecImpl *GetCodecImpl(MIME::Codec codec)
+{
+   switch ( codec )
+   {
+      case MIME::Codec_Scalar:
+         return &gs_codecScalar;
+
+      case MIME::Codec_SSE2:
+#ifdef M_CODEC_SSE2
+         return &gs_codecSSE2;
+#else
+         break;
+#endif
+
+      case MIME::Codec_AVX2:
+#ifdef M_CODEC_AVX2
+   #ifdef __GNUC__
+         // we can be called during static initialization
+         __builtin_cpu_init();
+         if ( !__builtin_cpu_supports("avx2") )
+            break;
+   #endif
+         return &gs_codecAVX2;
+#else
+         break;
+#endif
+
+      case MIME::Codec_Max:
+         break;
+   }
+
+   return NULL;
+}
+
+static MIME::Codec GetBestCodec()
+{
+   for ( int codec = MIME::Codec_Max - 1; codec > MIME::Codec_Scalar; codec-- )
+   {
+      if ( GetCodecImpl(static_cast<MIME::Codec>(codec)) )
+         return static_cast<MIME::Codec>(codec);
+   }
+
+   return MIME::Codec_Scalar;
+}
+
+static MIME::Codec gs_codec = GetBestCodec();
+static const CodecImpl *gs_impl = GetCodecImpl(gs_codec);
+
+// ============================================================================
+// MIME codec functions
+// ============================================================================
+
+MIME::Codec MIME::GetCodec()
+{
+   return gs_codec;
+}
+
+bool MIME::SetCodec(Codec codec)
+{
+   const CodecImpl * const impl = GetCodecImpl(codec);
+   if ( !impl )
+      return false;
+
+   gs_codec = codec;
+   gs_impl = impl;
+
+   return true;
+}
+
+const char *MIME::GetCodecName(Codec codec)
+{
+   static const char *names[] = { "scalar", "SSE2", "AVX2" };
+
+   wxCOMPILE_TIME_ASSERT( WXSIZEOF(names) == Codec_Max, CodecNamesMismatch );
+
+   CHECK( codec >= 0 && codec < Codec_Max, "", "invalid codec" );
+
+   return names[codec];
+}
+
+// ----------------------------------------------------------------------------
+// Base64
+// ----------------------------------------------------------------------------
+
+bool MIME::DecodeBase64(const void *src, size_t len, void *dst, size_t *lenDst)
+{
+   const unsigned char *s = static_cast<const unsigned char *>(src);
+   const unsigned char * const end = s + len;
+
+   unsigned char * const start = static_cast<unsigned char *>(dst);
+   unsigned char *d = start;
+
+   const CodecImpl * const impl = gs_impl;
+
+   // position in the current quantum of 4 characters
+   int e = 0;
+
+   // false if the last block couldn't be decoded using impl->decodeBase64(),
+   // we don't try it again until the end of the current line then
+   bool tryBlocks = impl->decodeBase64 != NULL;
+
+   *lenDst = 0;
+
+   while ( s != end )
+   {
+      if ( tryBlocks && !e )
+      {
+         const size_t n = impl->decodeBase64(s, end - s, d);
+         s += n;
+         d += (n / 4)*3;
+
+         if ( s == end )
+            break;
+
+         tryBlocks = false;
+      }
+
+      const unsigned char c = BASE64_VALUES[*s++];
+      switch ( c )
+      {
+         default: // data character
+            switch ( e++ )
+            {
+               case 0:
+                  *d = c << 2;         // byte 1: high 6 bits
+                  break;
+
+               case 1:
+                  *d++ |= c >> 4;      // byte 1: low 2 bits
+                  *d = c << 4;         // byte 2: high 4 bits
+                  break;
+
+               case 2:
+                  *d++ |= c >> 2;      // byte 2: low 4 bits
+                  *d = c << 6;         // byte 3: high 2 bits
+                  break;
+
+               case 3:
+                  *d++ |= c;           // byte 3: low 6 bits
+                  e = 0;
+                  break;
+            }
+            break;
+
+         case WSP:
+            tryBlocks = impl->decodeBase64 != NULL;
+            break;
+
+         case PAD:
+            switch ( e++ )
+            {
+               case 3:
+                  // one '=' is enough at the end of the last quantum, but
+                  // check that there is no more data after it: this happens
+                  // if something (e.g. a mailing list manager) appended text
+                  // to a Base64-encoded message
+                  for ( ; s != end; ++s )
+                  {
+                     if ( BASE64_VALUES[*s] < PAD )
+                     {
+                        wxLogDebug("Possible data truncation in Base64 "
+                                   "encoded data.");
+                        break;
+                     }
+                  }
+
+                  s = end;
+                  break;
+
+               case 2:
+                  // a second '=' must follow in this case
+                  if ( s != end && *s == '=' )
+                     break;
+                  // fall through
+
+               default:
+                  return false;
+            }
+            break;
+
+         case JNK:
+            return false;
+      }
+   }
+
+   *lenDst = d - start;
+
+   return true;
+}
+
+size_t
+MIME::EncodeBase64(const void *src, size_t len, void *dst, size_t lineLen)
+{
+   ASSERT_MSG( lineLen % 4 == 0, "Base64 line length must be a multiple of 4" );
+
+   const unsigned char *s = static_cast<const unsigned char *>(src);
+
+   unsigned char * const start = static_cast<unsigned char *>(dst);
+   unsigned char *d = start;
+
+   const CodecImpl * const impl = gs_impl;
+
+   // the number of input bytes to put on each line of output
+   const size_t lenLine = lineLen ? (lineLen / 4)*3 : len;
+
+   while ( len )
+   {
+      size_t lenChunk = wxMin(len, lenLine);
+      len -= lenChunk;
+
+      if ( impl->encodeBase64 )
+      {
+         const size_t n = impl->encodeBase64(s, lenChunk, d);
+         s += n;
+         d += (n / 3)*4;
+         lenChunk -= n;
+      }
+
+      for ( ; lenChunk >= 3; lenChunk -= 3, s += 3 )
+      {
+         *d++ = BASE64_CHARS[s[0] >> 2];
+         *d++ = BASE64_CHARS[((s[0] << 4) | (s[1] >> 4)) & 0x3f];
+         *d++ = BASE64_CHARS[((s[1] << 2) | (s[2] >> 6)) & 0x3f];
+         *d++ = BASE64_CHARS[s[2] & 0x3f];
+      }
+
+      if ( lenChunk )
+      {
+         const unsigned char s1 = lenChunk > 1 ? s[1] : 0;
+
+         *d++ = BASE64_CHARS[s[0] >> 2];
+         *d++ = BASE64_CHARS[((s[0] << 4) | (s1 >> 4)) & 0x3f];
+         *d++ = lenChunk > 1 ? BASE64_CHARS[(s1 << 2) & 0x3f] : '=';
+         *d++ = '=';
+
+         s += lenChunk;
+      }
+
+      if ( lineLen )
+      {
+         *d++ = '\r';
+         *d++ = '\n';
+      }
+   }
+
+   return d - start;
+}
+
+// ----------------------------------------------------------------------------
+// quoted-printable
+// ----------------------------------------------------------------------------
+
+size_t MIME::DecodeQP(const void *src, size_t len, void *dst)
+{
+   const unsigned char *s = static_cast<const unsigned char *>(src);
+   const unsigned char * const end = s + len;
+
+   unsigned char * const start = static_cast<unsigned char *>(dst);
+   unsigned char *d = start;
+
+   // the position after the last non-space character: trailing spaces are
+   // removed at the end of line
+   unsigned char *t = d;
+
+   const CodecImpl * const impl = gs_impl;
+
+   bool hadInvalid = false;
+
+   while ( s != end )
+   {
+      size_t posEnd;
+      const size_t n = impl->scanQPLiteral(s, end - s, &posEnd);
+      if ( n )
+      {
+         memcpy(d, s, n);
+         if ( posEnd )
+            t = d + posEnd;
+
+         d += n;
+         s += n;
+
+         if ( s == end )
+            break;
+      }
+
+      unsigned char c = *s++;
+      switch ( c )
+      {
+         case '=':
+            if ( s == end )
+               break;
+
+            c = *s++;
+            switch ( c )
+            {
+               case '\0':
+                  // end of data, the NUL will be copied as is
+                  s--;
+                  break;
+
+               case '\r':
+                  // soft line break
+                  if ( s != end && *s == '\n' )
+                     s++;
+                  // fall through
+
+               case '\n':
+                  // bare LF soft line break, accept any trailing spaces
+                  t = d;
+                  break;
+
+               default:
+                  if ( !IsHexDigit(c) || s == end || !IsHexDigit(*s) )
+                  {
+                     // this happens if something (e.g. a mailing list
+                     // manager) appended text to QP-encoded message part,
+                     // there is no way to know where the encoded data ends
+                     // so take the invalid sequence literally
+                     if ( !hadInvalid )
+                     {
+                        wxLogDebug("Invalid quoted-printable sequence "
+                                   "\"=%c\".", c);
+                        hadInvalid = true;
+                     }
+
+                     // for compatibility with c-client, skip the invalid
+                     // character following a valid hex digit
+                     *d++ = '=';
+                     *d++ = c;
+                     if ( IsHexDigit(c) && s != end )
+                        s++;
+                     t = d;
+                     break;
+                  }
+
+                  *d++ = (HexDigitValue(c) << 4) | HexDigitValue(*s++);
+                  t = d;
+            }
+            break;
+
+         case '\r':
+         case '\n':
+            // remove the trailing spaces before the end of line
+            d = t;
+            *d++ = c;
+            t = d;
+            break;
+
+         default:
+            FAIL_MSG( "unexpected character in QP decoder" );
+            *d++ = c;
+            t = d;
+      }
+   }
+
+   return d - start;
+}
+
+size_t MIME::EncodeQP(const void *src, size_t len, void *dst)
+{
+   const unsigned char *s = static_cast<const unsigned char *>(src);
+   const unsigned char * const end = s + len;
+
+   unsigned char * const start = static_cast<unsigned char *>(dst);
+   unsigned char *d = start;
+
+   const CodecImpl * const impl = gs_impl;
+
+   size_t lineLen = 0;
+   while ( s != end )
+   {
+      // copy as many characters as fit on this line at once
+      size_t n = impl->scanQPSafe(s, wxMin(size_t(end - s),
+                                           QP_MAX_LINE_LEN - lineLen));
+
+      // but a space before the end of line must be encoded
+      if ( n && s[n - 1] == ' ' && s + n != end && s[n] == '\r' )
+         n--;
+
+      if ( n )
+      {
+         memcpy(d, s, n);
+         d += n;
+         s += n;
+         lineLen += n;
+
+         continue;
+      }
+
+      const unsigned char c = *s++;
+      if ( c == '\r' && s != end && *s == '\n' )
+      {
+         // preserve the line breaks
+         *d++ = '\r';
+         *d++ = *s++;
+
+         lineLen = 0;
+      }
+      else if ( NeedsQPEncoding(c) || (c == ' ' && s != end && *s == '\r') )
+      {
+         if ( (lineLen += 3) > QP_MAX_LINE_LEN )
+         {
+            *d++ = '=';
+            *d++ = '\r';
+            *d++ = '\n';
+
+            lineLen = 3;
+         }
+
+         *d++ = '=';
+         *d++ = HEX_DIGITS[c >> 4];
+         *d++ = HEX_DIGITS[c & 0xf];
+      }
+      else // ordinary character which doesn't fit on this line
+      {
+         if ( ++lineLen > QP_MAX_LINE_LEN )
+         {
+            *d++ = '=';
+            *d++ = '\r';
+            *d++ = '\n';
+
+            lineLen = 1;
+         }
+
+         *d++ = c;
+      }
+   }
+
+   return d - start;
+}
+
+// ----------------------------------------------------------------------------
+// StreamDecoder
+// ----------------------------------------------------------------------------
+
+MIME::StreamDecoder::StreamDecoder(Encoding encoding, bool keepTrailing)
+                   : m_encoding(encoding),
+                     m_keepTrailing(keepTrailing)
+{
+   m_state = State_Data;
+   m_lenQuantum = 0;
+   m_hasErrors = false;
+}
+
+const void *MIME::StreamDecoder::GetOutput(size_t *lenDst) const
+{
+   *lenDst = m_out.size();
+
+   return m_out.empty() ? NULL : &m_out[0];
+}
+
+void MIME::StreamDecoder::Output(const unsigned char *s, size_t len)
+{
+   m_out.insert(m_out.end(), s, s + len);
+}
+
+const void *
+MIME::StreamDecoder::Decode(const void *src, size_t len, size_t *lenDst)
+{
+   m_out.clear();
+
+   if ( len )
+   {
+      const unsigned char * const s = static_cast<const unsigned char *>(src);
+      switch ( m_encoding )
+      {
+         case Encoding_Base64:
+            DecodeBase64Chunk(s, len);
+            break;
+
+         case Encoding_QP:
+            DecodeQPChunk(s, len);
+            break;
+      }
+   }
+
+   return GetOutput(lenDst);
+}
+
+const void *MIME::StreamDecoder::Flush(size_t *lenDst)
+{
+   m_out.clear();
+
+   switch ( m_encoding )
+   {
+      case Encoding_Base64:
+         switch ( m_state )
+         {
+            case State_Data:
+               // the data was truncated, decode whatever we have
+               DecodePending(m_pending.size());
+               break;
+
+            case State_Padding:
+               DecodePadding(true);
+               break;
+
+            case State_Verbatim:
+            case State_Done:
+               break;
+         }
+         break;
+
+      case Encoding_QP:
+         if ( !m_pending.empty() )
+         {
+            m_out.resize(GetQPDecodedMaxLen(m_pending.size()));
+            m_out.resize(DecodeQP(&m_pending[0], m_pending.size(), &m_out[0]));
+            m_pending.clear();
+         }
+         break;
+   }
+
+   m_state = State_Done;
+
+   return GetOutput(lenDst);
+}
+
+void MIME::StreamDecoder::DecodePending(size_t len)
+{
+   if ( !len )
+      return;
+
+   const size_t lenOut = m_out.size();
+   m_out.resize(lenOut + GetBase64DecodedMaxLen(len));
+
+   // this can't fail as m_pending only contains valid characters
+   size_t lenDecoded;
+   if ( !DecodeBase64(&m_pending[0], len, &m_out[lenOut], &lenDecoded) )
+   {
+      FAIL_MSG( "unexpected failure to decode Base64 data" );
+
+      lenDecoded = 0;
+   }
+
+   m_out.resize(lenOut + lenDecoded);
+   m_pending.erase(m_pending.begin(), m_pending.begin() + len);
+}
+
+void MIME::StreamDecoder::DecodeBase64Chunk(const unsigned char *s, size_t len)
+{
+   const unsigned char * const end = s + len;
+
+   switch ( m_state )
+   {
+      case State_Data:
+         {
+            // copy just the significant characters to m_pending
+            const size_t lenOld = m_pending.size();
+            m_pending.resize(lenOld + len);
+
+            unsigned char * const start = &m_pending[0];
+            unsigned char *d = start + lenOld;
+            for ( ; s != end; ++s )
+            {
+               const unsigned char c = BASE64_VALUES[*s];
+               if ( c < PAD )
+                  *d++ = *s;
+               else if ( c != WSP )
+                  break;
+            }
+
+            m_pending.resize(d - start);
+         }
+
+         if ( s == end )
+         {
+            // decode all complete quanta, keeping the last incomplete one
+            DecodePending((m_pending.size() / 4)*4);
+            break;
+         }
+
+         if ( *s == '=' )
+         {
+            DecodePending((m_pending.size() / 4)*4);
+
+            m_lenQuantum = m_pending.size();
+            m_pending.insert(m_pending.end(), s, end);
+            m_state = State_Padding;
+
+            DecodePadding(false);
+            break;
+         }
+
+         // invalid character: decode what we have and take the rest as is
+         DecodePending(m_pending.size());
+
+         m_hasErrors = true;
+         m_state = State_Verbatim;
+         // fall through
+
+      case State_Verbatim:
+         Output(s, end - s);
+         break;
+
+      case State_Padding:
+         m_pending.insert(m_pending.end(), s, end);
+         DecodePadding(false);
+         break;
+
+      case State_Done:
+         break;
+   }
+}
+
+void MIME::StreamDecoder::DecodePadding(bool flush)
+{
+   const size_t lenTail = m_pending.size() - m_lenQuantum;
+   const unsigned char * const tail = &m_pending[m_lenQuantum];
+
+   // the number of '=' characters needed to complete the last quantum: one if
+   // it has 3 characters and two (without any whitespace between them) if it
+   // has 2, while a single character can't be a valid quantum at all
+   size_t lenPad = 0;
+   switch ( m_lenQuantum )
+   {
+      case 3:
+         lenPad = 1;
+         break;
+
+      case 2:
+         if ( lenTail < 2 && !flush )
+            return;
+
+         if ( lenTail >= 2 && tail[1] == '=' )
+            lenPad = 2;
+         break;
+   }
+
+   if ( !lenPad )
+   {
+      m_hasErrors = true;
+      m_state = State_Verbatim;
+
+      Output(&m_pending[0], m_pending.size());
+      m_pending.clear();
+      return;
+   }
+
+   size_t lenSkip = lenPad;
+   if ( m_keepTrailing )
+   {
+      // also skip the line break after the padding if there is one, we need
+      // to wait for it to arrive to know it
+      if ( lenTail < lenPad + 2 && !flush )
+         return;
+
+      if ( lenTail >= lenPad + 2 &&
+            tail[lenPad] == '\r' && tail[lenPad + 1] == '\n' )
+      {
+         lenSkip += 2;
+      }
+   }
+
+   DecodePending(m_lenQuantum + lenPad);
+
+   if ( m_keepTrailing )
+   {
+      m_out.insert(m_out.end(),
+                   m_pending.begin() + (lenSkip - lenPad), m_pending.end());
+
+      m_state = State_Verbatim;
+   }
+   else // ignore anything after the end of data
+   {
+      m_state = State_Done;
+   }
+
+   m_pending.clear();
+}
+
+void MIME::StreamDecoder::DecodeQPChunk(const unsigned char *s, size_t len)
+{
+   // decode the data directly if there is nothing pending from the previous
+   // chunk, otherwise append it to the pending line first
+   const bool usePending = !m_pending.empty();
+   if ( usePending )
+   {
+      m_pending.insert(m_pending.end(), s, s + len);
+
+      s = &m_pending[0];
+      len = m_pending.size();
+   }
+
+   // we can only decode the complete lines because the trailing whitespace
+   // is removed from them, so find the end of the last one
+   size_t lenDecode = len;
+   while ( lenDecode && s[lenDecode - 1] != '\n' )
+      lenDecode--;
+
+   if ( !lenDecode )
+   {
+      // a very long line (or a chunk smaller than a line): decode it too but
+      // keep its trailing whitespace and anything which could be a part of
+      // an escape sequence, i.e. stop at least 2 characters after the last
+      // '=' (as we don't know if it starts a sequence or is a part of one)
+      lenDecode = len;
+      for ( ;; )
+      {
+         const unsigned char c = lenDecode ? s[lenDecode - 1] : '\0';
+         if ( c == ' ' || c == '\t' || c == '\r' || c == '=' )
+            lenDecode--;
+         else if ( lenDecode > 1 && s[lenDecode - 2] == '=' )
+            lenDecode -= 2;
+         else
+            break;
+      }
+   }
+
+   m_out.resize(GetQPDecodedMaxLen(lenDecode) + 1);
+   m_out.resize(DecodeQP(s, lenDecode, &m_out[0]));
+
+   if ( usePending )
+   {
+      m_pending.erase(m_pending.begin(), m_pending.begin() + lenDecode);
+   }
+   else
+   {
+      m_pending.assign(s + lenDecode, s + len);
+   }
+}
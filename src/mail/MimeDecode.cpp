@@ -24,21 +24,12 @@
    #include <wx/utils.h>
 #endif // !USE_PCH
 
+#include "mail/MimeCodec.h"
 #include "mail/MimeDecode.h"
 
 #include <wx/fontmap.h>
 #include <wx/tokenzr.h>
 
-// ----------------------------------------------------------------------------
-// local helper functions
-// ----------------------------------------------------------------------------
-
-// this should only be used for const-incorrect c-client functions
-static inline unsigned char *UCHAR_CCAST(const char *s)
-{
-   return reinterpret_cast<unsigned char *>(const_cast<char *>(s));
-}
-
 // ============================================================================
 // implementation
 // ============================================================================
@@ -324,16 +315,21 @@ String DecodeHeaderOnce(const String& in, wxFontEncoding *pEncoding)
          {
             const unsigned long lenEncWord = encWord.length();
 
-            // now decode the text using c-client functions
-            unsigned long len;
-            void *text;
+            // decode the text directly into the buffer for the last word
+            const size_t lenOld = textLastWord.length();
+            size_t len;
+            bool ok = true;
             if ( enc2047 == MIME::Encoding_Base64 )
             {
-               text = rfc822_base64(UCHAR_CCAST(encWord.data()), lenEncWord, &len);
+               textLastWord.resize(lenOld +
+                                   MIME::GetBase64DecodedMaxLen(lenEncWord));
+
+               ok = MIME::DecodeBase64(encWord.data(), lenEncWord,
+                                       &textLastWord[lenOld], &len);
             }
             else // QP
             {
-               // cclient rfc822_qprint() behaves correctly and leaves '_' in the
+               // MIME::DecodeQP() behaves correctly and leaves '_' in the
                // QP encoded text because this is what RFC says, however many
                // broken clients replace spaces with underscores and so we undo it
                // here -- in this case it's better to be user-friendly than
@@ -347,17 +343,13 @@ String DecodeHeaderOnce(const String& in, wxFontEncoding *pEncoding)
                   }
                }
 
-               text = rfc822_qprint(UCHAR_CCAST(encWord.data()), lenEncWord, &len);
-            }
-
-            if ( text )
-            {
-               const char * const ctext = static_cast<char *>(text);
-
-               textLastWord.append(ctext, ctext + len);
+               textLastWord.resize(lenOld + MIME::GetQPDecodedMaxLen(lenEncWord));
 
-               fs_give(&text);
+               len = MIME::DecodeQP(encWord.data(), lenEncWord,
+                                    &textLastWord[lenOld]);
             }
+
+            textLastWord.resize(ok ? lenOld + len : lenOld);
          }
 
          // forget the space before this encoded word, it must be ignored
@@ -543,15 +535,8 @@ EncodeTextBase64(const char* in, const std::string& csName)
       if ( !out.empty() )
          out += "\r\n  ";
 
-      // rfc822_binary() splits lines after 60 characters so don't make
-      // chunks longer than this as the base64-encoded headers can't have
-      // EOLs in them
-      static const int CCLIENT_MAX_BASE64_LEN = 60;
-
-      // but if the charset name is sufficiently long, we may need to make them
-      // shorter than this
-      size_t lenRemaining = wxMin(CCLIENT_MAX_BASE64_LEN,
-                                  RFC2047_MAXWORD_LEN - overhead);
+      // encoded text can't be longer than the maximal word length
+      const size_t lenRemaining = RFC2047_MAXWORD_LEN - overhead;
 
       // we can calculate how many characters we may put on one line directly
       size_t len = (lenRemaining / 4) * 3;
@@ -563,30 +548,17 @@ EncodeTextBase64(const char* in, const std::string& csName)
          len = lenMax;
       }
 
-      // do encode this word
-      unsigned char *text = const_cast<unsigned char*>(s); // cast for cclient
-
-      // length of the encoded text and the text itself
-      unsigned long lenEnc;
-      unsigned char *textEnc = rfc822_binary(text, len, &lenEnc);
-
-      while ( textEnc[lenEnc - 2] == '\r' && textEnc[lenEnc - 1] == '\n' )
-      {
-         // discard eol which we don't need in the header
-         lenEnc -= 2;
-      }
-
-      // put into string as we might want to do some more replacements...
-      std::string encword(CHAR_CAST(textEnc), lenEnc);
-
       // append this word to the header
       out += "=?";
       out += csName;
       out += "?B?";
-      out += encword;
-      out += "?=";
 
-      fs_give((void **)&textEnc);
+      // encode it directly into the output string
+      const size_t lenOut = out.length();
+      out.resize(lenOut + MIME::GetBase64EncodedMaxLen(len));
+      out.resize(lenOut + MIME::EncodeBase64(s, len, &out[lenOut]));
+
+      out += "?=";
 
       // skip the already encoded part
       s += len;
@@ -101,6 +101,11 @@ const void *MimePartCC::GetRawContent(unsigned long *len) const
    return GetMessage()->GetRawPartData(*this, len);
 }
 
+bool MimePartCC::WriteRawContent(MimePartSink& sink) const
+{
+   return GetMessage()->WriteRawPartData(*this, sink);
+}
+
 String MimePartCC::GetHeaders() const
 {
    return GetMessage()->GetPartHeaders(*this);
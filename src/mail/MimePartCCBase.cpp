@@ -28,10 +28,63 @@
 
 #include <wx/fontmap.h>
 
+#include "mail/MimeCodec.h"
 #include "mail/MimeDecode.h"
 #include "MimePartCCBase.h"
 #include "MailFolder.h"         // for DecodeHeader()
 
+// ----------------------------------------------------------------------------
+// DecodingSink: MimePartSink decoding the data before passing it to another one
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+class DecodingSink : public MimePartSink
+{
+public:
+   DecodingSink(MimePartSink& sink,
+                MIME::StreamDecoder::Encoding encoding,
+                bool keepTrailing)
+      : m_sink(sink),
+        m_decoder(encoding, keepTrailing)
+   {
+   }
+
+   virtual bool Write(const void *data, size_t len)
+   {
+      size_t lenDecoded;
+      const void *p = m_decoder.Decode(data, len, &lenDecoded);
+
+      return !lenDecoded || m_sink.Write(p, lenDecoded);
+   }
+
+   virtual bool OnProgress(size_t done, size_t total)
+   {
+      return m_sink.OnProgress(done, total);
+   }
+
+   // must be called after writing all data
+   bool Flush()
+   {
+      size_t lenDecoded;
+      const void *p = m_decoder.Flush(&lenDecoded);
+
+      return !lenDecoded || m_sink.Write(p, lenDecoded);
+   }
+
+   bool HasErrors() const { return m_decoder.HasErrors(); }
+
+private:
+   MimePartSink& m_sink;
+
+   MIME::StreamDecoder m_decoder;
+
+   DECLARE_NO_COPY_CLASS(DecodingSink)
+};
+
+} // anonymous namespace
+
 // ============================================================================
 // MimePartCCBase implementation
 // ============================================================================
@@ -331,24 +384,21 @@ MimePartCCBase::DecodeRawContent(const void *cptr, unsigned long *lenptr)
    switch ( GetTransferEncoding() )
    {
       case ENCQUOTEDPRINTABLE:   // human-readable 8-as-7 bit data
-         m_content = rfc822_qprint(text, size, lenptr);
-
-         // some broken mailers sent messages with QP specified as the content
-         // transfer encoding in the headers but don't encode the message
-         // properly - in this case show it as plain text which is better than
-         // not showing it at all
-         if ( m_content )
          {
-            m_ownsContent = true;
+            // notice that decoding QP never fails: some broken mailers send
+            // messages with QP specified as the content transfer encoding in
+            // the headers but don't encode the message properly and in this
+            // case the invalid escape sequences are left as is, which is
+            // better than not showing the text at all
+            m_content = fs_get(MIME::GetQPDecodedMaxLen(size) + 1);
 
-            break;
-         }
-         //else: treat it as plain text
-
-         // it was overwritten by rfc822_qprint() above
-         *lenptr = size;
+            const size_t len = MIME::DecodeQP(text, size, m_content);
+            static_cast<char *>(m_content)[len] = '\0';
 
-         // fall through
+            *lenptr = len;
+            m_ownsContent = true;
+         }
+         break;
 
       case ENC7BIT:        // 7 bit SMTP semantic data
       case ENC8BIT:        // 8 bit SMTP semantic data
@@ -433,9 +483,15 @@ MimePartCCBase::DecodeRawContent(const void *cptr, unsigned long *lenptr)
             }
          }
 
-         m_content = rfc822_base64(text, size, lenptr);
-         if ( !m_content )
+         // allocate enough space for the slack, if any, right now to avoid
+         // reallocating the buffer later
+         m_content = fs_get(MIME::GetBase64DecodedMaxLen(size) + sizeSlack + 1);
+
+         size_t len;
+         if ( !MIME::DecodeBase64(text, size, m_content, &len) )
          {
+            fs_give(&m_content);
+
             wxLogWarning(_("Failed to decode binary message part, "
                            "message could be corrupted."));
 
@@ -450,14 +506,17 @@ MimePartCCBase::DecodeRawContent(const void *cptr, unsigned long *lenptr)
          {
             // append the non Base64-encoded chunk, if any, to the end of decoded
             // data
+            char * const content = static_cast<char *>(m_content);
             if ( sizeSlack )
             {
-               fs_resize(&m_content, *lenptr + sizeSlack);
-               memcpy((char *)m_content + *lenptr, startSlack, sizeSlack);
+               memcpy(content + len, startSlack, sizeSlack);
 
-               *lenptr += sizeSlack;
+               len += sizeSlack;
             }
 
+            content[len] = '\0';
+
+            *lenptr = len;
             m_ownsContent = true;
          }
    }
@@ -467,6 +526,58 @@ MimePartCCBase::DecodeRawContent(const void *cptr, unsigned long *lenptr)
    return m_content;
 }
 
+bool MimePartCCBase::WriteRawContent(MimePartSink& sink) const
+{
+   unsigned long len;
+   const void *cptr = GetRawContent(&len);
+   if ( !cptr )
+      return !GetSize();
+
+   return sink.Write(cptr, len) && sink.OnProgress(len, GetSize());
+}
+
+bool MimePartCCBase::WriteContent(MimePartSink& sink) const
+{
+   // if we had already decoded the contents, just reuse it
+   if ( m_ownsContent )
+   {
+      return sink.Write(m_content, m_lenContent) &&
+               sink.OnProgress(GetSize(), GetSize());
+   }
+
+   MIME::StreamDecoder::Encoding encoding;
+   switch ( GetTransferEncoding() )
+   {
+      case ENCQUOTEDPRINTABLE:
+         encoding = MIME::StreamDecoder::Encoding_QP;
+         break;
+
+      case ENCBASE64:
+         encoding = MIME::StreamDecoder::Encoding_Base64;
+         break;
+
+      default:
+         // nothing to decode
+         return WriteRawContent(sink);
+   }
+
+   // keep the text appended to the top level part by the mailing list
+   // software, just as DecodeRawContent() does
+   DecodingSink sinkDecoding(sink, encoding, !GetParent());
+   if ( !WriteRawContent(sinkDecoding) || !sinkDecoding.Flush() )
+      return false;
+
+   if ( sinkDecoding.HasErrors() && GetParent() )
+   {
+      // we still wrote the invalid data as is, this is better than nothing,
+      // see the comment in DecodeRawContent()
+      wxLogWarning(_("Failed to decode binary message part, "
+                     "message could be corrupted."));
+   }
+
+   return true;
+}
+
 String MimePartCCBase::GetTextContent() const
 {
    unsigned long len;
@@ -0,0 +1,920 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/SearchIndex.cpp: implementation of MsgSearchIndex class
+// Purpose:     MsgSearchIndex allows to search messages without the server
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include  "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+
+   #include "MApplication.h"
+#endif // USE_PCH
+
+#include <wx/file.h>
+#include <wx/textfile.h>
+
+#include "CacheFile.h"
+#include "mail/SearchIndex.h"
+
+#include <algorithm>
+#include <iterator>
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the words longer than this are not indexed: they're almost certainly not
+// words at all but parts of encoded attachments or similar junk
+static const size_t MAX_TERM_LEN = 40;
+
+// the prefixes used for the lines of the index file for each part
+static const wxChar *INDEX_PART_PREFIXES[MsgSearchIndex::Part_Max] =
+{
+   _T("t"),    // Part_Text
+   _T("h"),    // Part_Header
+};
+
+// ----------------------------------------------------------------------------
+// private types
+// ----------------------------------------------------------------------------
+
+// sorted array of UIDs
+typedef std::vector<UIdType> UIdVector;
+
+// a single word of the search string
+struct SearchWord
+{
+   String term;
+
+   // if true, the word in the message may continue before/after this one
+   bool openLeft,
+        openRight;
+};
+
+typedef std::vector<SearchWord> SearchWords;
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// split the text in (lower case) words calling the functor for each of them
+template <typename F>
+static void ForEachWord(const String& text, F& f)
+{
+   String term;
+   size_t start = 0;
+
+   const size_t len = text.length();
+   for ( size_t n = 0; n <= len; n++ )
+   {
+      const wxChar ch = n < len ? (wxChar)text[n] : _T('\0');
+      if ( ch && wxIsalnum(ch) )
+      {
+         if ( term.empty() )
+            start = n;
+
+         term += (wxChar)wxTolower(ch);
+      }
+      else if ( !term.empty() )
+      {
+         f(term, start == 0, n == len);
+
+         term.clear();
+      }
+   }
+}
+
+// functor for ForEachWord() collecting all words of the message
+class TermsCollector
+{
+public:
+   TermsCollector(std::vector<String>& terms) : m_terms(terms)
+   {
+      m_hasLong = false;
+   }
+
+   void operator()(const String& term, bool, bool)
+   {
+      if ( term.length() <= MAX_TERM_LEN )
+         m_terms.push_back(term);
+      else
+         m_hasLong = true;
+   }
+
+   // return true if there were any words too long to be indexed
+   bool HasLong() const { return m_hasLong; }
+
+private:
+   std::vector<String>& m_terms;
+   bool m_hasLong;
+};
+
+// functor for ForEachWord() collecting the words of the search string
+class SearchWordsCollector
+{
+public:
+   SearchWordsCollector(SearchWords& words) : m_words(words)
+   {
+      m_tooLong = false;
+   }
+
+   void operator()(const String& term, bool openLeft, bool openRight)
+   {
+      if ( term.length() > MAX_TERM_LEN )
+         m_tooLong = true;
+
+      SearchWord word;
+      word.term = term;
+      word.openLeft = openLeft;
+      word.openRight = openRight;
+      m_words.push_back(word);
+   }
+
+   bool HasTooLong() const { return m_tooLong; }
+
+private:
+   SearchWords& m_words;
+   bool m_tooLong;
+};
+
+// parse the search string, return false if it can't be searched for
+static bool ParseSearchString(const String& key, SearchWords& words)
+{
+   SearchWordsCollector collector(words);
+   ForEachWord(key, collector);
+
+   return !words.empty() && !collector.HasTooLong();
+}
+
+// insert the UID into a sorted array, return false if it was already there
+static bool InsertUId(UIdVector& uids, UIdType uid)
+{
+   // the messages are usually indexed in order, optimize for this case
+   if ( uids.empty() || uids.back() < uid )
+   {
+      uids.push_back(uid);
+      return true;
+   }
+
+   UIdVector::iterator i = std::lower_bound(uids.begin(), uids.end(), uid);
+   if ( i != uids.end() && *i == uid )
+      return false;
+
+   uids.insert(i, uid);
+
+   return true;
+}
+
+// remove all elements not in uidsKeep from the sorted array uids
+static void RetainUIds(UIdVector& uids, const UIdVector& uidsKeep)
+{
+   UIdVector result;
+   std::set_intersection(uids.begin(), uids.end(),
+                         uidsKeep.begin(), uidsKeep.end(),
+                         std::back_inserter(result));
+   uids.swap(result);
+}
+
+// add the UIDs from the second sorted array to the first one
+static void MergeUIds(UIdVector& uids, const UIdVector& uidsNew)
+{
+   if ( uids.empty() )
+   {
+      uids = uidsNew;
+      return;
+   }
+
+   UIdVector result;
+   std::set_union(uids.begin(), uids.end(),
+                  uidsNew.begin(), uidsNew.end(),
+                  std::back_inserter(result));
+   uids.swap(result);
+}
+
+// parse a line containing delta-encoded list of UIDs
+static bool ParseUIds(const String& s, UIdVector& uids)
+{
+   UIdType uid = 0;
+
+   const wxChar *p = s.c_str();
+   while ( *p )
+   {
+      wxChar *end;
+      const unsigned long delta = wxStrtoul(p, &end, 10);
+      if ( end == p || !delta )
+         return false;
+
+      uid += delta;
+      uids.push_back(uid);
+
+      p = end;
+      if ( *p == _T(' ') )
+         p++;
+   }
+
+   return true;
+}
+
+// write the sorted list of UIDs in delta-encoded form
+static void FormatUIds(const UIdVector& uids, String& s)
+{
+   UIdType uidPrev = 0;
+   for ( UIdVector::const_iterator i = uids.begin(); i != uids.end(); ++i )
+   {
+      s << _T(' ') << *i - uidPrev;
+      uidPrev = *i;
+   }
+}
+
+// ----------------------------------------------------------------------------
+// FolderSearchIndex: the index for a single folder
+// ----------------------------------------------------------------------------
+
+/*
+   The format of the index file is:
+
+   - the UID validity on the first line after the header
+   - for each part, the line starting with the uppercase part prefix followed
+     by the list of UIDs of all indexed messages
+   - for each part, the line starting with the uppercase part prefix and '*'
+     followed by the list of UIDs of the messages containing words too long
+     to be indexed (it may be omitted if there are none)
+   - for each word and part in which it occurs, the line with the part
+     prefix, the word and the list of UIDs of the messages containing it
+
+   All UID lists are sorted and delta-encoded to make the file smaller.
+
+   The lines for the newly indexed messages are simply appended to the end of
+   the file, so the same list may occur several times in it and all of its
+   occurrences must be merged together when loading it. The lines with the
+   indexed messages UIDs are always written after the lines for their words,
+   so that a partially appended message is never considered to be indexed.
+ */
+class FolderSearchIndex : public CacheFile
+{
+public:
+   FolderSearchIndex(const String& folderName, UIdType uidValidity)
+      : m_folderName(folderName)
+   {
+      m_uidValidity = uidValidity;
+      m_needsRewrite = false;
+      m_countLinesSaved = 0;
+      m_countLinesAppended = 0;
+
+      Load();
+   }
+
+   // get the UID validity of the data we have
+   UIdType GetUIdValidity() const { return m_uidValidity; }
+
+   // forget everything we have and start indexing with the new UID validity
+   void Reset(UIdType uidValidity)
+   {
+      for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+      {
+         m_parts[n].Clear();
+         m_added[n].Clear();
+      }
+
+      m_uidValidity = uidValidity;
+      m_needsRewrite = true;
+   }
+
+   bool IsIndexed(MsgSearchIndex::Part part, UIdType uid) const
+   {
+      const UIdVector& indexed = m_parts[part].indexed;
+      return std::binary_search(indexed.begin(), indexed.end(), uid);
+   }
+
+   void Add(MsgSearchIndex::Part part, UIdType uid, const String& text)
+   {
+      if ( IsIndexed(part, uid) )
+         return;
+
+      std::vector<String> terms;
+      TermsCollector collector(terms);
+      ForEachWord(text, collector);
+
+      std::sort(terms.begin(), terms.end());
+      terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+      m_parts[part].Add(uid, terms, collector.HasLong());
+
+      // also remember the new data to append it to the file later, unless
+      // the file is going to be rewritten entirely anyhow
+      if ( !m_needsRewrite )
+         m_added[part].Add(uid, terms, collector.HasLong());
+   }
+
+   void Retain(const UIdVector& uids)
+   {
+      for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+      {
+         PartIndex& pi = m_parts[n];
+
+         const size_t countOld = pi.indexed.size();
+         RetainUIds(pi.indexed, uids);
+         if ( pi.indexed.size() == countOld )
+            continue;
+
+         RetainUIds(pi.longWords, uids);
+
+         for ( Terms::iterator i = pi.terms.begin(); i != pi.terms.end(); )
+         {
+            RetainUIds(i->second, uids);
+            if ( i->second.empty() )
+               pi.terms.erase(i++);
+            else
+               ++i;
+         }
+
+         // we can't remove anything from the file by appending to it
+         m_needsRewrite = true;
+      }
+
+      if ( m_needsRewrite )
+      {
+         for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+            m_added[n].Clear();
+      }
+   }
+
+   void Search(MsgSearchIndex::Part part,
+               const SearchWords& words,
+               UIdVector& uids,
+               UIdVector& uidsIndexed) const
+   {
+      const PartIndex& pi = m_parts[part];
+      const Terms& terms = pi.terms;
+
+      uidsIndexed = pi.indexed;
+
+      for ( SearchWords::const_iterator w = words.begin();
+            w != words.end();
+            ++w )
+      {
+         // find all messages containing this word
+         UIdVector uidsWord;
+         if ( !w->openLeft && !w->openRight )
+         {
+            Terms::const_iterator i = terms.find(w->term);
+            if ( i != terms.end() )
+               uidsWord = i->second;
+         }
+         else
+         {
+            if ( !w->openLeft )
+            {
+               // the words starting with this one are contiguous in the map
+               for ( Terms::const_iterator i = terms.lower_bound(w->term);
+                     i != terms.end() && i->first.StartsWith(w->term);
+                     ++i )
+               {
+                  MergeUIds(uidsWord, i->second);
+               }
+            }
+            else // no choice but to check all words
+            {
+               for ( Terms::const_iterator i = terms.begin();
+                     i != terms.end();
+                     ++i )
+               {
+                  const String& term = i->first;
+
+                  bool matches;
+                  if ( w->openRight )
+                     matches = term.find(w->term) != String::npos;
+                  else
+                     matches = term.EndsWith(w->term);
+
+                  if ( matches )
+                     MergeUIds(uidsWord, i->second);
+               }
+            }
+
+            // this word may also be a part of a word which wasn't indexed
+            MergeUIds(uidsWord, pi.longWords);
+         }
+
+         if ( w == words.begin() )
+         {
+            uids.swap(uidsWord);
+         }
+         else
+         {
+            RetainUIds(uids, uidsWord);
+         }
+
+         if ( uids.empty() )
+            break;
+      }
+   }
+
+   // save the index to disk if it was modified
+   bool SaveIfNeeded()
+   {
+      if ( !m_needsRewrite )
+      {
+         bool hasAdded = false;
+         for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+         {
+            if ( !m_added[n].indexed.empty() )
+               hasAdded = true;
+         }
+
+         if ( !hasAdded )
+            return true;
+
+         // appending is much faster than rewriting the entire file but makes
+         // it grow and slower to load, so rewrite it once the appended data
+         // becomes as big as the rest of it
+         if ( m_countLinesAppended < m_countLinesSaved && Append() )
+         {
+            for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+               m_added[n].Clear();
+
+            return true;
+         }
+      }
+
+      if ( !Save() )
+         return false;
+
+      for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+         m_added[n].Clear();
+
+      m_needsRewrite = false;
+      m_countLinesAppended = 0;
+
+      return true;
+   }
+
+protected:
+   virtual String GetFileName() const
+   {
+      String folderNameFixed = m_folderName;
+      folderNameFixed.Replace(_T("/"), _T("_"));
+
+      String filename;
+      filename << mApplication->GetLocalDir() << DIR_SEPARATOR
+               << _T("index") << DIR_SEPARATOR << folderNameFixed;
+
+      return filename;
+   }
+
+   virtual String GetFileHeader() const
+   {
+      return _T("Mahogany Search Index File (version %d.%d)");
+   }
+
+   virtual int GetFormatVersion() const
+   {
+      return BuildVersion(1, 1);
+   }
+
+   virtual bool DoLoad(const wxTextFile& file, int version);
+   virtual bool DoSave(wxTempFile& file);
+
+private:
+   // the index of a single part of the messages
+   typedef std::map<String, UIdVector> Terms;
+
+   struct PartIndex
+   {
+      // add a message with the given sorted unique words
+      void Add(UIdType uid, const std::vector<String>& termsNew, bool hasLong)
+      {
+         InsertUId(indexed, uid);
+
+         for ( std::vector<String>::const_iterator i = termsNew.begin();
+               i != termsNew.end();
+               ++i )
+         {
+            InsertUId(terms[*i], uid);
+         }
+
+         if ( hasLong )
+            InsertUId(longWords, uid);
+      }
+
+      void Clear()
+      {
+         indexed.clear();
+         longWords.clear();
+         terms.clear();
+      }
+
+      // all messages whose this part we have indexed
+      UIdVector indexed;
+
+      // the messages containing the words too long to be indexed
+      UIdVector longWords;
+
+      // the messages containing each word
+      Terms terms;
+   };
+
+   // write the lines for the given part to the file, return the number of
+   // lines written or (size_t)-1 on error
+   template <class File>
+   static size_t WritePart(File& file, int part, const PartIndex& pi);
+
+   // append the lines for the messages indexed since the last save to the
+   // file
+   bool Append();
+
+   // all the data
+   PartIndex m_parts[MsgSearchIndex::Part_Max];
+
+   // the data added since the file was saved
+   PartIndex m_added[MsgSearchIndex::Part_Max];
+
+   String m_folderName;
+
+   UIdType m_uidValidity;
+
+   // true if the file must be rewritten entirely as we removed something from
+   // the index, or if it doesn't exist yet or contains outdated data
+   bool m_needsRewrite;
+
+   // the number of lines written when the file was last rewritten and the
+   // number of lines appended to it since then
+   size_t m_countLinesSaved,
+          m_countLinesAppended;
+
+   DECLARE_NO_COPY_CLASS(FolderSearchIndex)
+};
+
+bool FolderSearchIndex::DoLoad(const wxTextFile& file, int version)
+{
+   unsigned long uidValidity;
+   if ( !file[1].ToULong(&uidValidity) )
+      return false;
+
+   // the files created by the previous versions didn't record the messages
+   // with long words, so we could miss some of them if we used these files
+   if ( uidValidity != m_uidValidity || version < BuildVersion(1, 1) )
+   {
+      // the index is useless, it will be overwritten when we save it
+      m_needsRewrite = true;
+
+      return true;
+   }
+
+   const size_t count = file.GetLineCount();
+   for ( size_t n = 2; n < count; n++ )
+   {
+      const String& line = file[n];
+
+      String prefix = line.BeforeFirst(_T(' '));
+
+      const bool isLong = prefix.EndsWith(_T("*"), &prefix);
+
+      int part;
+      for ( part = 0; part < MsgSearchIndex::Part_Max; part++ )
+      {
+         if ( prefix.IsSameAs(INDEX_PART_PREFIXES[part], false) )
+            break;
+      }
+
+      if ( part == MsgSearchIndex::Part_Max )
+      {
+         wxLogDebug(_T("%s(%lu): unknown search index line ignored."),
+                    file.GetName(), (unsigned long)n + 1);
+         continue;
+      }
+
+      UIdVector *uids;
+      String rest = line.AfterFirst(_T(' '));
+      if ( prefix == INDEX_PART_PREFIXES[part] )
+      {
+         // a word line
+         uids = &m_parts[part].terms[rest.BeforeFirst(_T(' '))];
+         rest = rest.AfterFirst(_T(' '));
+      }
+      else if ( isLong )
+      {
+         uids = &m_parts[part].longWords;
+      }
+      else // the line with all indexed messages
+      {
+         uids = &m_parts[part].indexed;
+      }
+
+      // this line may be appended to another one for the same list
+      UIdVector uidsLine;
+      if ( !ParseUIds(rest, uidsLine) )
+      {
+         // don't use a partially loaded index
+         Reset(m_uidValidity);
+
+         return false;
+      }
+
+      MergeUIds(*uids, uidsLine);
+   }
+
+   // remember how big the file would be if we rewrote it now to rewrite it
+   // when too many lines are appended to it
+   m_countLinesSaved = 0;
+   for ( int part = 0; part < MsgSearchIndex::Part_Max; part++ )
+      m_countLinesSaved += 2 + m_parts[part].terms.size();
+
+   if ( count > m_countLinesSaved + 2 )
+      m_countLinesAppended = count - m_countLinesSaved - 2;
+
+   return true;
+}
+
+template <class File>
+size_t FolderSearchIndex::WritePart(File& file, int part, const PartIndex& pi)
+{
+   size_t count = 0;
+
+   String line;
+   for ( Terms::const_iterator i = pi.terms.begin();
+         i != pi.terms.end();
+         ++i )
+   {
+      line.clear();
+      line << INDEX_PART_PREFIXES[part] << _T(' ') << i->first;
+      FormatUIds(i->second, line);
+      line << _T('\n');
+      if ( !file.Write(line) )
+         return (size_t)-1;
+
+      count++;
+   }
+
+   if ( !pi.longWords.empty() )
+   {
+      line = String(INDEX_PART_PREFIXES[part]).Upper() + _T('*');
+      FormatUIds(pi.longWords, line);
+      line << _T('\n');
+      if ( !file.Write(line) )
+         return (size_t)-1;
+
+      count++;
+   }
+
+   // this must be done last, see the comment before FolderSearchIndex
+   line = String(INDEX_PART_PREFIXES[part]).Upper();
+   FormatUIds(pi.indexed, line);
+   line << _T('\n');
+   if ( !file.Write(line) )
+      return (size_t)-1;
+
+   return count + 1;
+}
+
+bool FolderSearchIndex::DoSave(wxTempFile& file)
+{
+   String line;
+   line << m_uidValidity << _T('\n');
+   if ( !file.Write(line) )
+      return false;
+
+   size_t countLines = 0;
+   for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+   {
+      const size_t count = WritePart(file, n, m_parts[n]);
+      if ( count == (size_t)-1 )
+         return false;
+
+      countLines += count;
+   }
+
+   m_countLinesSaved = countLines;
+
+   return true;
+}
+
+bool FolderSearchIndex::Append()
+{
+   const String filename = GetFileName();
+   if ( !wxFile::Exists(filename) )
+      return false;
+
+   wxFile file(filename, wxFile::write_append);
+   if ( !file.IsOpened() )
+      return false;
+
+   for ( int n = 0; n < MsgSearchIndex::Part_Max; n++ )
+   {
+      if ( m_added[n].indexed.empty() )
+         continue;
+
+      const size_t count = WritePart(file, n, m_added[n]);
+      if ( count == (size_t)-1 )
+         return false;
+
+      m_countLinesAppended += count;
+   }
+
+   return true;
+}
+
+// ============================================================================
+// MsgSearchIndex implementation
+// ============================================================================
+
+static MsgSearchIndex *gs_msgSearchIndex = NULL;
+
+// ----------------------------------------------------------------------------
+// MsgSearchIndex creation and saving
+// ----------------------------------------------------------------------------
+
+/* static */
+void MsgSearchIndex::Init()
+{
+   // the index is used by the worker threads, so it must be created before
+   // they're started instead of on demand
+   CHECK_RET( !gs_msgSearchIndex, _T("MsgSearchIndex::Init() called twice") );
+
+   gs_msgSearchIndex = new MsgSearchIndex;
+}
+
+/* static */
+MsgSearchIndex *MsgSearchIndex::Get()
+{
+   return gs_msgSearchIndex;
+}
+
+/* static */
+void MsgSearchIndex::CleanUp()
+{
+   if ( gs_msgSearchIndex )
+   {
+      delete gs_msgSearchIndex;
+      gs_msgSearchIndex = NULL;
+   }
+}
+
+/* static */
+void MsgSearchIndex::Flush()
+{
+   if ( gs_msgSearchIndex )
+   {
+      MutexLocker<MTMutex> lock(gs_msgSearchIndex->m_mutex);
+
+      gs_msgSearchIndex->DoFlush();
+   }
+}
+
+MsgSearchIndex::~MsgSearchIndex()
+{
+   DoFlush();
+
+   for ( FolderIndices::iterator i = m_folders.begin();
+         i != m_folders.end();
+         ++i )
+   {
+      delete i->second;
+   }
+}
+
+void MsgSearchIndex::DoFlush()
+{
+   for ( FolderIndices::iterator i = m_folders.begin();
+         i != m_folders.end();
+         ++i )
+   {
+      i->second->SaveIfNeeded();
+   }
+}
+
+FolderSearchIndex *
+MsgSearchIndex::GetFolderIndex(const String& folderName, UIdType uidValidity)
+{
+   CHECK( uidValidity != UID_ILLEGAL, NULL,
+          _T("can't index folder without persistent UIDs") );
+
+   FolderSearchIndex *& index = m_folders[folderName];
+   if ( !index )
+   {
+      index = new FolderSearchIndex(folderName, uidValidity);
+   }
+
+   if ( index->GetUIdValidity() != uidValidity )
+   {
+      index->Reset(uidValidity);
+   }
+
+   return index;
+}
+
+// ----------------------------------------------------------------------------
+// MsgSearchIndex search parameters
+// ----------------------------------------------------------------------------
+
+/* static */
+MsgSearchIndex::Part MsgSearchIndex::GetPartFor(SearchCriterium::Type what)
+{
+   switch ( what )
+   {
+      case SearchCriterium::SC_FULL:
+      case SearchCriterium::SC_BODY:
+         // this is consistent with MailFolderCmn::SearchMessages() which
+         // searches in the message text for both of them
+         return Part_Text;
+
+      case SearchCriterium::SC_HEADER:
+         return Part_Header;
+
+      default:
+         // the other criteria either use the cached headers which are
+         // already available locally or need a specific header
+         return Part_Max;
+   }
+}
+
+/* static */
+bool MsgSearchIndex::CanSearchFor(const String& key)
+{
+   SearchWords words;
+   return ParseSearchString(key, words);
+}
+
+// ----------------------------------------------------------------------------
+// MsgSearchIndex indexing and searching
+// ----------------------------------------------------------------------------
+
+bool MsgSearchIndex::IsIndexed(const String& folderName,
+                               UIdType uidValidity,
+                               Part part,
+                               UIdType uid)
+{
+   CHECK( part < Part_Max, false, _T("invalid message part") );
+
+   MutexLocker<MTMutex> lock(m_mutex);
+
+   FolderSearchIndex *index = GetFolderIndex(folderName, uidValidity);
+
+   return index && index->IsIndexed(part, uid);
+}
+
+void MsgSearchIndex::Add(const String& folderName,
+                         UIdType uidValidity,
+                         Part part,
+                         UIdType uid,
+                         const String& text)
+{
+   CHECK_RET( part < Part_Max, _T("invalid message part") );
+
+   MutexLocker<MTMutex> lock(m_mutex);
+
+   FolderSearchIndex *index = GetFolderIndex(folderName, uidValidity);
+   if ( index )
+      index->Add(part, uid, text);
+}
+
+void MsgSearchIndex::Retain(const String& folderName,
+                            UIdType uidValidity,
+                            const std::vector<UIdType>& uids)
+{
+   MutexLocker<MTMutex> lock(m_mutex);
+
+   FolderSearchIndex *index = GetFolderIndex(folderName, uidValidity);
+   if ( index )
+      index->Retain(uids);
+}
+
+bool MsgSearchIndex::Search(const String& folderName,
+                            UIdType uidValidity,
+                            Part part,
+                            const String& key,
+                            std::vector<UIdType>& uids,
+                            std::vector<UIdType>& uidsIndexed)
+{
+   CHECK( part < Part_Max, false, _T("invalid message part") );
+
+   SearchWords words;
+   if ( !ParseSearchString(key, words) )
+      return false;
+
+   MutexLocker<MTMutex> lock(m_mutex);
+
+   FolderSearchIndex *index = GetFolderIndex(folderName, uidValidity);
+   if ( !index )
+      return false;
+
+   index->Search(part, words, uids, uidsIndexed);
+
+   return true;
+}
@@ -32,6 +32,7 @@
 
 #include "Mversion.h"
 #include "MailFolderCC.h"
+#include "mail/MimeCodec.h"
 #include "mail/MimeDecode.h"
 
 #include "LogCircle.h"
@@ -56,6 +57,7 @@
 #include "SendMessage.h"
 #include "SendMessageCC.h"
 #include "Mcclient.h"
+#include "mail/SendSession.h"
 
 #include "XFace.h"
 #include "gui/wxMDialogs.h"
@@ -125,6 +127,10 @@ extern const MPersMsgBox *M_MSGBOX_SEND_OFFLINE;
 // trace mask for message sending/queuing operations
 #define TRACE_SEND   "send"
 
+// the length of the lines of Base64-encoded message parts, this is the
+// maximum allowed by RFC 2045
+static const size_t BASE64_LINE_LEN = 76;
+
 // ----------------------------------------------------------------------------
 // private functions
 // ----------------------------------------------------------------------------
@@ -158,6 +164,75 @@ PARAMETER *CreateBodyParameter(const char *name, const char *value)
    return par;
 }
 
+// encode the contents of all body parts which need it using our own MIME
+// codecs, which are much faster than c-client ones
+//
+// this does the same thing as rfc822_encode_body_7bit() (or _8bit() if ok8bit
+// is true) for the parts contents, but they still need to be called after it
+// as they also take care of the other things, e.g. multipart boundaries
+void EncodeBodyContents(BODY *body, bool ok8bit)
+{
+   if ( !body )
+      return;
+
+   switch ( body->type )
+   {
+      case TYPEMULTIPART:
+         for ( PART *part = body->nested.part; part; part = part->next )
+            EncodeBodyContents(&part->body, ok8bit);
+         break;
+
+      case TYPEMESSAGE:
+         // encapsulated messages are never encoded
+         break;
+
+      default:
+         {
+            unsigned char *data = body->contents.text.data;
+            const size_t len = body->contents.text.size;
+
+            unsigned char *dataEnc;
+            size_t lenEnc;
+            switch ( body->encoding )
+            {
+               case ENCBINARY:
+                  dataEnc = (unsigned char *)fs_get
+                            (
+                              MIME::GetBase64EncodedMaxLen(len, BASE64_LINE_LEN)
+                              + 1
+                            );
+                  lenEnc = MIME::EncodeBase64(data, len, dataEnc,
+                                              BASE64_LINE_LEN);
+                  body->encoding = ENCBASE64;
+                  break;
+
+               case ENC8BIT:
+                  if ( ok8bit )
+                     return;
+
+                  dataEnc = (unsigned char *)fs_get
+                            (
+                              MIME::GetQPEncodedMaxLen(len) + 1
+                            );
+                  lenEnc = MIME::EncodeQP(data, len, dataEnc);
+                  body->encoding = ENCQUOTEDPRINTABLE;
+                  break;
+
+               default:
+                  // nothing to do
+                  return;
+            }
+
+            dataEnc[lenEnc] = '\0';
+
+            body->contents.text.data = dataEnc;
+            body->contents.text.size = lenEnc;
+
+            fs_give((void **)&data);
+         }
+   }
+}
+
 } // anonymous namespace
 
 // ----------------------------------------------------------------------------
@@ -357,6 +432,7 @@ SendMessageCC::SendMessageCC(const Profile *profile,
              : m_profile(profile)
 {
    m_frame = frame;
+   m_session = NULL;
    m_encHeaders = wxFONTENCODING_SYSTEM;
 
    m_cloneOfExisting = false;
@@ -1126,6 +1202,7 @@ SendMessageCC::Sign()
 {
    // get the text to sign
    BODY * const bodyOrig = GetBody();
+   EncodeBodyContents(bodyOrig, false /* 7 bit */);
    rfc822_encode_body_7bit(NULL /* env is unused */, bodyOrig);
 
    String textToSign;
@@ -1757,8 +1834,6 @@ SendMessageCC::SendNow(String *errGeneral, String *errDetailed)
    if ( !driverCC || !driverCC->Initialize() )
       return false;
 
-   SENDSTREAM *stream = NIL;
-
    // construct the server string for c-client
    String server = m_ServerHost;
 
@@ -1844,23 +1919,21 @@ SendMessageCC::SendNow(String *errGeneral, String *errDetailed)
    //else: other protocols don't use SSL
 #endif // USE_SSL
 
-   // prepare the hostlist for c-client: we use only one server
-   wxCharBuffer serverAsCharBuf(server.mb_str());
-   char *hostlist[2];
-   hostlist[0] = (char *)serverAsCharBuf.data();
-   hostlist[1] = NIL;
-
-   int options = READ_CONFIG(m_profile, MP_DEBUG_CCLIENT) ? SOP_DEBUG : 0;
+   long options = READ_CONFIG(m_profile, MP_DEBUG_CCLIENT) ? SOP_DEBUG : 0;
 
+   bool success;
    switch ( m_Protocol )
    {
       case Prot_SMTP:
+      case Prot_NNTP:
          {
             wxLogTrace(TRACE_SEND,
-                       "Trying to open connection to SMTP server \"%s\"",
+                       "Sending message using %s server \"%s\"",
+                       m_Protocol == Prot_SMTP ? "SMTP" : "NNTP",
                        m_ServerHost);
 
-            if ( READ_CONFIG(m_profile, MP_SMTP_USE_8BIT) )
+            if ( m_Protocol == Prot_SMTP &&
+                  READ_CONFIG(m_profile, MP_SMTP_USE_8BIT) )
             {
                options |= SOP_8BITMIME;
             }
@@ -1868,8 +1941,10 @@ SendMessageCC::SendNow(String *errGeneral, String *errDetailed)
 #ifdef USE_OWN_CCLIENT
             // do we need to disable any authentificators (presumably because
             // they're incorrectly implemented by the server)?
-            const String authsToDisable(READ_CONFIG_TEXT(m_profile,
-                                                         MP_SMTP_DISABLED_AUTHS));
+            const String authsToDisable(m_Protocol == Prot_SMTP
+                                          ? READ_CONFIG_TEXT(m_profile,
+                                                   MP_SMTP_DISABLED_AUTHS)
+                                          : String());
             if ( !authsToDisable.empty() )
             {
                smtp_parameters(SET_SMTPDISABLEDAUTHS,
@@ -1877,7 +1952,17 @@ SendMessageCC::SendNow(String *errGeneral, String *errDetailed)
             }
 #endif // USE_OWN_CCLIENT
 
-            stream = smtp_open_full(NIL, hostlist, CONST_CCAST("smtp"), NIL, options);
+            // use a temporary session, closing the connection when we
+            // return, if we're not sending many messages in a row
+            SendSession sessionTmp;
+            SendSession& session = m_session ? *m_session : sessionTmp;
+
+            {
+               Rfc822OutputRedirector redirect(m_headers);
+
+               success = session.Send(m_Protocol, server, options,
+                                      m_Envelope, GetBody(), errDetailed);
+            }
 
 #ifdef USE_OWN_CCLIENT
             // don't leave any dangling pointers
@@ -1889,14 +1974,6 @@ SendMessageCC::SendNow(String *errGeneral, String *errDetailed)
          }
          break;
 
-      case Prot_NNTP:
-         wxLogTrace(TRACE_SEND,
-                    "Trying to open connection to NNTP server \"%s\"",
-                    m_ServerHost);
-
-         stream = nntp_open_full(NIL, hostlist, CONST_CCAST("nntp"), NIL, options);
-         break;
-
 #ifdef OS_UNIX
          case Prot_Sendmail:
          {
@@ -1962,39 +2039,11 @@ SendMessageCC::SendNow(String *errGeneral, String *errDetailed)
          case Prot_Illegal:
          default:
             FAIL_MSG("illegal protocol");
-   }
-
-   bool success;
-   if ( stream )
-   {
-      Rfc822OutputRedirector redirect(m_headers);
-
-      switch ( m_Protocol )
-      {
-         case Prot_SMTP:
-            success = smtp_mail(stream, CONST_CCAST("MAIL"),
-                                m_Envelope, GetBody()) != NIL;
-            *errDetailed = wxString::From8BitData(stream->reply);
-            smtp_close (stream);
-            break;
-
-         case Prot_NNTP:
-            success = nntp_mail(stream, m_Envelope, GetBody()) != NIL;
-            *errDetailed = wxString::From8BitData(stream->reply);
-            nntp_close (stream);
-            break;
-
-         // make gcc happy
-         case Prot_Illegal:
-         default:
-            FAIL_MSG("illegal protocol");
             success = false;
-      }
-
-      if ( success )
-         return true;
    }
-   //else: error in opening stream
+
+   if ( success )
+      return true;
 
    MLogCircle& log = MailFolder::GetLogCircle();
    if ( !errDetailed->empty() )
@@ -2191,6 +2240,8 @@ long Rfc822OutputRedirector::FullRfc822Output(char *headers,
                                               void *stream,
                                               long ok8bit)
 {
+  EncodeBodyContents(body, ok8bit != 0);
+
   if ( ok8bit )
      rfc822_encode_body_8bit(env, body);
   else
@@ -0,0 +1,262 @@
+///////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/SendSession.cpp - SendSession class implementation
+// Purpose:     SendSession keeps SMTP/NNTP connections open between messages
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include "Mpch.h"
+
+#ifndef USE_PCH
+#  include "Mcommon.h"
+#  include "Mcclient.h"
+#endif // USE_PCH
+
+#include "mail/SendSession.h"
+
+#include <wx/stopwatch.h>
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// trace mask, the same as used by SendMessageCC
+#define TRACE_SEND   "send"
+
+// the reply codes meaning that the server is closing the connection
+static const long SMTP_CLOSING = 421;
+static const long NNTP_CLOSING = 400;
+
+// ============================================================================
+// SendSession implementation
+// ============================================================================
+
+SendSession::SendSession()
+{
+   m_timing.msConnect =
+   m_timing.msSend = 0;
+   m_timing.retried = false;
+
+   m_countMessages =
+   m_countConnections = 0;
+}
+
+SendSession::~SendSession()
+{
+   Close();
+}
+
+void SendSession::Close()
+{
+   for ( size_t n = 0; n < m_connections.size(); n++ )
+   {
+      CloseStream(m_connections[n].protocol, m_connections[n].stream);
+   }
+
+   m_connections.clear();
+}
+
+SendSession::Connection *
+SendSession::FindConnection(Protocol protocol,
+                            const String& server,
+                            long options)
+{
+   for ( size_t n = 0; n < m_connections.size(); n++ )
+   {
+      Connection& conn = m_connections[n];
+      if ( conn.protocol == protocol &&
+            conn.server == server &&
+               conn.options == options )
+      {
+         return &conn;
+      }
+   }
+
+   return NULL;
+}
+
+/* static */
+SENDSTREAM *
+SendSession::Open(Protocol protocol, const String& server, long options)
+{
+   // prepare the hostlist for c-client: we use only one server
+   wxCharBuffer serverAsCharBuf(server.mb_str());
+   char *hostlist[2];
+   hostlist[0] = (char *)serverAsCharBuf.data();
+   hostlist[1] = NIL;
+
+   switch ( protocol )
+   {
+      case Prot_SMTP:
+         return smtp_open_full(NIL, hostlist, CONST_CCAST("smtp"), NIL,
+                               options);
+
+      case Prot_NNTP:
+         return nntp_open_full(NIL, hostlist, CONST_CCAST("nntp"), NIL,
+                               options);
+
+      default:
+         FAIL_MSG( "SendSession can only be used with SMTP and NNTP" );
+   }
+
+   return NULL;
+}
+
+/* static */
+bool
+SendSession::DoSend(Protocol protocol,
+                    SENDSTREAM *stream,
+                    ENVELOPE *env,
+                    BODY *body)
+{
+   switch ( protocol )
+   {
+      case Prot_SMTP:
+         return smtp_mail(stream, CONST_CCAST("MAIL"), env, body) != NIL;
+
+      case Prot_NNTP:
+         return nntp_mail(stream, env, body) != NIL;
+
+      default:
+         FAIL_MSG( "illegal protocol" );
+   }
+
+   return false;
+}
+
+/* static */
+bool SendSession::IsConnectionLost(Protocol protocol, SENDSTREAM *stream)
+{
+   if ( !stream->netstream )
+      return true;
+
+   const long code = stream->reply ? atol(stream->reply) : 0;
+
+   return code == (protocol == Prot_SMTP ? SMTP_CLOSING : NNTP_CLOSING);
+}
+
+/* static */
+void SendSession::CloseStream(Protocol protocol, SENDSTREAM *stream)
+{
+   switch ( protocol )
+   {
+      case Prot_SMTP:
+         smtp_close(stream);
+         break;
+
+      case Prot_NNTP:
+         nntp_close(stream);
+         break;
+
+      default:
+         FAIL_MSG( "illegal protocol" );
+   }
+}
+
+bool
+SendSession::Send(Protocol protocol,
+                  const String& server,
+                  long options,
+                  ENVELOPE *env,
+                  BODY *body,
+                  String *reply)
+{
+   CHECK( protocol == Prot_SMTP || protocol == Prot_NNTP, false,
+          "SendSession can only be used with SMTP and NNTP" );
+
+   m_timing.msConnect =
+   m_timing.msSend = 0;
+   m_timing.retried = false;
+
+   wxStopWatch sw;
+
+   SENDSTREAM *stream = NULL;
+   Connection * const conn = FindConnection(protocol, server, options);
+   if ( conn )
+   {
+      stream = conn->stream;
+
+      // it will be put back if it's still usable after sending
+      m_connections.erase(m_connections.begin() + (conn - &m_connections[0]));
+   }
+
+   bool reused = stream != NULL;
+   bool success = false;
+   for ( ;; )
+   {
+      if ( !stream )
+      {
+         wxLogTrace(TRACE_SEND, "Opening connection to %s server \"%s\"",
+                    protocol == Prot_SMTP ? "SMTP" : "NNTP", server);
+
+         sw.Start();
+         stream = Open(protocol, server, options);
+         m_timing.msConnect += sw.Time();
+
+         if ( !stream )
+            break;
+
+         m_countConnections++;
+      }
+
+      sw.Start();
+      success = DoSend(protocol, stream, env, body);
+      m_timing.msSend = sw.Time();
+
+      if ( reply )
+         *reply = wxString::From8BitData(stream->reply);
+
+      if ( success || !IsConnectionLost(protocol, stream) )
+         break;
+
+      CloseStream(protocol, stream);
+      stream = NULL;
+
+      // if the connection was new, there is no sense in retrying
+      if ( !reused )
+         break;
+
+      wxLogTrace(TRACE_SEND, "Connection to \"%s\" was closed by server, "
+                 "sending the message again", server);
+
+      reused = false;
+      m_timing.retried = true;
+   }
+
+   if ( stream )
+   {
+      // keep the connection for the next message
+      Connection connNew;
+      connNew.protocol = protocol;
+      connNew.server = server;
+      connNew.options = options;
+      connNew.stream = stream;
+
+      m_connections.push_back(connNew);
+   }
+
+   if ( success )
+   {
+      m_countMessages++;
+
+      wxLogTrace(TRACE_SEND, "Message sent in %ld ms (connecting: %ld ms%s)",
+                 m_timing.msConnect + m_timing.msSend,
+                 m_timing.msConnect,
+                 m_timing.retried ? ", retried" : "");
+   }
+
+   return success;
+}
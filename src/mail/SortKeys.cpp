@@ -0,0 +1,478 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/SortKeys.cpp: implementation of MsgSortKeys class
+// Purpose:     MsgSortKeys caches the keys used for sorting the messages
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include  "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+   #include "Sorting.h"
+#endif // USE_PCH
+
+#include "HeaderInfo.h"
+#include "Address.h"
+
+#include "mail/SortKeys.h"
+
+#include <algorithm>
+#include <iterator>
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// return negative number if a < b, 0 if a == b and positive number if a > b
+template <typename T>
+static inline int CmpValues(const T& a, const T& b)
+{
+   return a < b ? -1 : b < a ? 1 : 0;
+}
+
+static int ComputeStatusScore(int status)
+{
+   /*
+      The idea is to make the messages appear in the order of new, important,
+      recent or unread, other, answered so the scores are assigned in a way to
+      make new appear in front of the important, but the important before the
+      ones which are just recent or unread (remember that new == recent &&
+      unread)
+   */
+   enum
+   {
+      SCORE_RECENT = 2,
+      SCORE_UNREAD = 3,
+      SCORE_IMPORTANT = 4,
+      SCORE_ANSWERED = -1
+   };
+
+   int score = 0;
+
+   if ( status & MailFolder::MSG_STAT_RECENT )
+      score += SCORE_RECENT;
+
+   if ( !(status & MailFolder::MSG_STAT_SEEN) )
+      score += SCORE_UNREAD;
+
+   if ( status & MailFolder::MSG_STAT_FLAGGED )
+      score += SCORE_IMPORTANT;
+
+   if ( status & MailFolder::MSG_STAT_ANSWERED )
+      score += SCORE_ANSWERED;
+
+   return score;
+}
+
+// compute the key used for comparing the message status: deleted messages are
+// considered to be less important than undeleted ones and the messages which
+// are either both deleted or not are compared according to the other bits
+static int ComputeStatusKey(int status)
+{
+   // the scores are all in -1..9 range, so this is enough to ensure that all
+   // deleted messages compare less than the undeleted ones
+   static const int DELETED_OFFSET = 100;
+
+   int key = ComputeStatusScore(status);
+   if ( status & MailFolder::MSG_STAT_DELETED )
+      key -= DELETED_OFFSET;
+
+   return key;
+}
+
+// ============================================================================
+// implementation
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// MsgSortKeys::Comparator
+// ----------------------------------------------------------------------------
+
+class MsgSortKeys::Comparator
+{
+public:
+   Comparator(const MsgSortKeys& keys, const Criteria& criteria)
+      : m_keys(keys), m_criteria(criteria)
+   {
+   }
+
+   // this is used with msgnos and not indices
+   bool operator()(MsgnoType msgno1, MsgnoType msgno2) const
+   {
+      return Compare(msgno1 - 1, msgno2 - 1) < 0;
+   }
+
+private:
+   int Compare(MsgnoType idx1, MsgnoType idx2) const
+   {
+      // if one header is invalid (presumable because it wasn't retrieved from
+      // server at all because the user aborted it), it is always less than
+      // the other one
+      const bool invalid1 = (m_keys.m_state[idx1] & Key_Invalid) != 0,
+                 invalid2 = (m_keys.m_state[idx2] & Key_Invalid) != 0;
+      if ( invalid1 || invalid2 )
+         return invalid1 == invalid2 ? 0 : invalid1 ? -1 : 1;
+
+      for ( Criteria::const_iterator i = m_criteria.begin();
+            i != m_criteria.end();
+            ++i )
+      {
+         int result = 0;
+         switch ( i->crit )
+         {
+            case MSO_NONE:
+               // the arrival order
+               result = CmpValues(idx1, idx2);
+               break;
+
+            case MSO_DATE:
+               result = CmpValues(m_keys.m_dates[idx1], m_keys.m_dates[idx2]);
+               break;
+
+            case MSO_SUBJECT:
+               result = m_keys.m_subjects[idx1].compare(m_keys.m_subjects[idx2]);
+               break;
+
+            case MSO_SENDER:
+               result = m_keys.m_senders[idx1].compare(m_keys.m_senders[idx2]);
+               break;
+
+            case MSO_STATUS:
+               result = CmpValues(m_keys.m_statuses[idx1],
+                                  m_keys.m_statuses[idx2]);
+               break;
+
+            case MSO_SIZE:
+               result = CmpValues(m_keys.m_sizes[idx1], m_keys.m_sizes[idx2]);
+               break;
+
+            default:
+               // Sort() doesn't put anything else in m_criteria
+               ;
+         }
+
+         if ( result )
+            return i->reverse ? -result : result;
+      }
+
+      return 0;
+   }
+
+   const MsgSortKeys& m_keys;
+   const Criteria& m_criteria;
+};
+
+// ----------------------------------------------------------------------------
+// MsgSortKeys synchronization with the listing
+// ----------------------------------------------------------------------------
+
+MsgSortKeys::MsgSortKeys()
+{
+   m_senderDetectOwn = false;
+   m_orderHasInvalid = false;
+}
+
+void MsgSortKeys::ForgetOrder()
+{
+   m_order.clear();
+   m_orderHasInvalid = false;
+}
+
+void MsgSortKeys::Clear()
+{
+   m_subjects.clear();
+   m_senders.clear();
+   m_dates.clear();
+   m_sizes.clear();
+   m_statuses.clear();
+   m_state.clear();
+
+   ForgetOrder();
+}
+
+void MsgSortKeys::OnAdd(MsgnoType countNew)
+{
+   if ( countNew < m_state.size() )
+   {
+      // this is not supposed to happen, but if it does, we can't know which
+      // messages disappeared so start from scratch
+      Clear();
+   }
+
+   // the keys for the new messages will be computed during the next sort
+   m_subjects.resize(countNew);
+   m_senders.resize(countNew);
+   m_dates.resize(countNew);
+   m_sizes.resize(countNew);
+   m_statuses.resize(countNew);
+   m_state.resize(countNew, 0);
+}
+
+void MsgSortKeys::OnRemove(MsgnoType idx)
+{
+   if ( idx < m_state.size() )
+   {
+      m_subjects.erase(m_subjects.begin() + idx);
+      m_senders.erase(m_senders.begin() + idx);
+      m_dates.erase(m_dates.begin() + idx);
+      m_sizes.erase(m_sizes.begin() + idx);
+      m_statuses.erase(m_statuses.begin() + idx);
+      m_state.erase(m_state.begin() + idx);
+   }
+
+   // removing a message doesn't change the relative order of the remaining
+   // ones, so we just need to remove it from m_order and adjust the msgnos
+   // following it
+   const MsgnoType msgnoRemoved = idx + 1;
+
+   std::vector<MsgnoType>::iterator out = m_order.begin();
+   for ( std::vector<MsgnoType>::const_iterator i = m_order.begin();
+         i != m_order.end();
+         ++i )
+   {
+      const MsgnoType msgno = *i;
+      if ( msgno != msgnoRemoved )
+         *out++ = msgno > msgnoRemoved ? msgno - 1 : msgno;
+   }
+
+   m_order.erase(out, m_order.end());
+}
+
+// ----------------------------------------------------------------------------
+// MsgSortKeys keys computation
+// ----------------------------------------------------------------------------
+
+void MsgSortKeys::ComputeKeys(const HeaderInfoList *hil,
+                              MsgnoType idx,
+                              const SortParams& sortParams,
+                              int keysNeeded)
+{
+   const HeaderInfo *hi = hil->GetItemByIndex(idx);
+   if ( !hi || !hi->IsValid() )
+   {
+      // don't compute anything, we'll try again the next time
+      m_state[idx] = Key_Invalid;
+      return;
+   }
+
+   unsigned char& state = m_state[idx];
+   state &= ~Key_Invalid;
+
+   if ( !(state & Key_Basic) )
+   {
+      m_dates[idx] = hi->GetDate();
+      m_sizes[idx] = hi->GetSize();
+      m_statuses[idx] = ComputeStatusKey(hi->GetStatus());
+
+      state |= Key_Basic;
+   }
+
+   if ( (keysNeeded & Key_Subject) && !(state & Key_Subject) )
+   {
+      m_subjects[idx] = Address::NormalizeSubject(hi->GetSubject()).Lower();
+
+      state |= Key_Subject;
+   }
+
+   if ( (keysNeeded & Key_Sender) && !(state & Key_Sender) )
+   {
+      String sender;
+      (void)HeaderInfo::GetFromOrTo
+                        (
+                           hi,
+                           sortParams.detectOwnAddresses,
+                           sortParams.ownAddresses,
+                           &sender
+                        );
+
+      m_senders[idx] = sender.Lower();
+
+      state |= Key_Sender;
+   }
+}
+
+bool MsgSortKeys::RefreshStatus(const HeaderInfoList *hil)
+{
+   // unlike the other keys, the status of the message may change
+   bool changed = false;
+
+   const size_t count = m_state.size();
+   for ( size_t n = 0; n < count; n++ )
+   {
+      if ( !(m_state[n] & Key_Basic) )
+         continue;
+
+      const HeaderInfo *hi = hil->GetItemByIndex(n);
+      if ( !hi )
+         continue;
+
+      const int status = ComputeStatusKey(hi->GetStatus());
+      if ( status != m_statuses[n] )
+      {
+         m_statuses[n] = status;
+
+         changed = true;
+      }
+   }
+
+   return changed;
+}
+
+// ----------------------------------------------------------------------------
+// MsgSortKeys sorting
+// ----------------------------------------------------------------------------
+
+bool MsgSortKeys::Sort(const HeaderInfoList *hil,
+                       MsgnoType *msgnos,
+                       const SortParams& sortParams)
+{
+   CHECK( hil && msgnos, false, _T("NULL parameter in MsgSortKeys::Sort") );
+
+   const MsgnoType count = hil->Count();
+
+   // normally our owner keeps us in sync, but be tolerant in case it didn't
+   if ( count != m_state.size() )
+   {
+      if ( count < m_state.size() )
+         Clear();
+
+      OnAdd(count);
+   }
+
+   // decode the sort order once instead of doing it in every comparison
+   Criteria criteria;
+   int keysNeeded = Key_Basic;
+   bool usesStatus = false;
+   for ( long sortOrder = sortParams.sortOrder;
+         sortOrder;
+         sortOrder = GetSortNextCriterium(sortOrder) )
+   {
+      Criterium c;
+      c.crit = GetSortCritDirect(sortOrder);
+      c.reverse = IsSortCritReversed(sortOrder);
+
+      switch ( c.crit )
+      {
+         case MSO_SUBJECT:
+            keysNeeded |= Key_Subject;
+            break;
+
+         case MSO_SENDER:
+            keysNeeded |= Key_Sender;
+            break;
+
+         case MSO_STATUS:
+            usesStatus = true;
+            break;
+
+         case MSO_NONE:
+         case MSO_DATE:
+         case MSO_SIZE:
+            break;
+
+         case MSO_SCORE:
+            // we don't store score any more in HeaderInfo
+            FAIL_MSG(_T("sorting by score is unimplemented"));
+            continue;
+
+         default:
+            FAIL_MSG(_T("unknown sorting criterium"));
+            continue;
+      }
+
+      criteria.push_back(c);
+   }
+
+   // the sender key depends on the own addresses settings, if they changed,
+   // we need to recompute it
+   if ( (keysNeeded & Key_Sender) &&
+         (sortParams.detectOwnAddresses != m_senderDetectOwn ||
+          (m_senderDetectOwn &&
+           sortParams.ownAddresses != m_senderOwnAddresses)) )
+   {
+      m_senderDetectOwn = sortParams.detectOwnAddresses;
+      m_senderOwnAddresses = sortParams.ownAddresses;
+
+      for ( MsgnoType n = 0; n < count; n++ )
+         m_state[n] &= ~Key_Sender;
+
+      ForgetOrder();
+   }
+
+   const bool statusChanged = usesStatus && RefreshStatus(hil);
+
+   // can we reuse the result of the previous sort?
+   MsgnoType countOld = m_order.size();
+   if ( !countOld ||
+         countOld > count ||
+          m_orderHasInvalid ||
+           statusChanged ||
+            m_orderParams != sortParams )
+   {
+      ForgetOrder();
+
+      countOld = 0;
+   }
+
+   // compute the keys for all messages which don't have them yet: if we
+   // reuse m_order, the old messages already have all of them
+   bool hasInvalid = false;
+   for ( MsgnoType n = 0; n < count; n++ )
+   {
+      if ( (m_state[n] & keysNeeded) != keysNeeded )
+         ComputeKeys(hil, n, sortParams, keysNeeded);
+
+      if ( m_state[n] & Key_Invalid )
+         hasInvalid = true;
+   }
+
+   // sort the new messages (or all of them if we can't reuse m_order)
+   std::vector<MsgnoType> sorted;
+   sorted.reserve(count - countOld);
+   for ( MsgnoType msgno = countOld + 1; msgno <= count; msgno++ )
+      sorted.push_back(msgno);
+
+   const Comparator cmp(*this, criteria);
+   std::stable_sort(sorted.begin(), sorted.end(), cmp);
+
+   if ( countOld )
+   {
+      // merge the new messages into the existing order: as std::merge() puts
+      // the elements from the first range before the equal elements from the
+      // second one and all new msgnos are greater than the old ones, we get
+      // exactly the same result as if we sorted everything
+      std::vector<MsgnoType> merged;
+      merged.reserve(count);
+      std::merge(m_order.begin(), m_order.end(),
+                 sorted.begin(), sorted.end(),
+                 std::back_inserter(merged),
+                 cmp);
+
+      m_order.swap(merged);
+   }
+   else
+   {
+      m_order.swap(sorted);
+   }
+
+   m_orderParams = sortParams;
+   m_orderHasInvalid = hasInvalid;
+
+   std::copy(m_order.begin(), m_order.end(), msgnos);
+
+   return true;
+}
@@ -32,6 +32,7 @@
 
 #include <wx/imaglist.h>
 #include <wx/persist/bookctrl.h>
+#include <wx/stopwatch.h>
 
 #include "MAtExit.h"
 
@@ -249,6 +250,77 @@ static wxArrayString SplitParams(const String& paramsAll)
    return strutil_restore_array(paramsAllReal, FILTERS_SEPARATOR);
 }
 
+// ----------------------------------------------------------------------------
+// SpamFilterParams: the parsed parameters of CheckIfSpam()
+// ----------------------------------------------------------------------------
+
+class SpamFilterParams
+{
+public:
+   // break down the parameters (if we have any) into names and values
+   SpamFilterParams(const String& paramsAll)
+   {
+      m_useConfigured = paramsAll.empty();
+      if ( m_useConfigured )
+         return;
+
+      wxArrayString params(SplitParams(paramsAll));
+      const size_t count = params.GetCount();
+      for ( size_t n = 0; n < count; n++ )
+      {
+         const wxString& param = params[n];
+         int pos = param.Find(_T('='));
+
+         wxString name,
+                  val;
+         if ( pos != wxNOT_FOUND )
+         {
+            name = wxString(param, pos);
+            val = param.c_str() + pos + 1;
+         }
+         else // no value, use default options
+         {
+            name = param;
+         }
+
+
+         // insert the value in the same position in values array as name is
+         // going to have in the names one (as it's sorted we don't know where
+         // will it be)
+         m_values.Insert(val, m_names.Add(name));
+      }
+   }
+
+   // return false if the filter with the given name shouldn't be used,
+   // otherwise fill param with its options
+   bool Get(const Profile *profile, const char *name, String *param) const
+   {
+      if ( m_useConfigured )
+      {
+         // use only configured filters
+         return IsSpamFilterEnabled(profile, name);
+      }
+
+      int n = m_names.Index(name);
+      if ( n == wxNOT_FOUND )
+      {
+         // skip filters not appearing in paramsAll
+         return false;
+      }
+
+      *param = m_values[(size_t)n];
+
+      return true;
+   }
+
+private:
+   wxSortedArrayString m_names;
+   wxArrayString m_values;
+
+   // true if no parameters were given at all
+   bool m_useConfigured;
+};
+
 // ----------------------------------------------------------------------------
 // local globals
 // ----------------------------------------------------------------------------
@@ -345,6 +417,34 @@ void SpamFilter::Train(const Message& msg, bool isSpam)
    }
 }
 
+/* static */
+void
+SpamFilter::Train(const ArrayMessages& msgs, bool isSpam, SpamBatchStats *stats)
+{
+   wxStopWatch sw;
+
+   if ( msgs.empty() )
+      return;
+
+   Profile * const profile = GetProfile(*msgs[0]);
+   if ( !profile )
+      return;
+
+   LoadAll();
+
+   for ( SpamFilter *p = ms_first; p; p = p->m_next )
+   {
+      if ( IsSpamFilterEnabled(profile, p->GetName()) )
+         p->DoTrainBatch(profile, msgs, isSpam);
+   }
+
+   if ( stats )
+   {
+      stats->count = msgs.size();
+      stats->msElapsed = sw.Time();
+   }
+}
+
 /* static */
 bool
 SpamFilter::CheckIfSpam(const Message& msg,
@@ -357,61 +457,14 @@ SpamFilter::CheckIfSpam(const Message& msg,
 
    LoadAll();
 
-   // break down the parameters (if we have any) into names and values
-   wxSortedArrayString names;
-   wxArrayString values;
-   if ( !paramsAll.empty() )
-   {
-      wxArrayString params(SplitParams(paramsAll));
-      const size_t count = params.GetCount();
-      for ( size_t n = 0; n < count; n++ )
-      {
-         const wxString& param = params[n];
-         int pos = param.Find(_T('='));
-
-         wxString name,
-                  val;
-         if ( pos != wxNOT_FOUND )
-         {
-            name = wxString(param, pos);
-            val = param.c_str() + pos + 1;
-         }
-         else // no value, use default options
-         {
-            name = param;
-         }
-
-
-         // insert the value in the same position in values array as name is
-         // going to have in the names one (as it's sorted we don't know where
-         // will it be)
-         values.Insert(val, names.Add(name));
-      }
-   }
-
+   const SpamFilterParams params(paramsAll);
 
    // now try all filters in turn until one of them returns true
    for ( SpamFilter *p = ms_first; p; p = p->m_next )
    {
-      const String name(p->GetName());
-
       String param;
-      if ( !paramsAll.empty() )
-      {
-         int n = names.Index(name);
-         if ( n == wxNOT_FOUND )
-         {
-            // skip filters not appearing in paramsAll
-            continue;
-         }
-
-         param = values[(size_t)n];
-      }
-      else // use only configured filters
-      {
-         if ( !IsSpamFilterEnabled(profile, p->GetName()) )
-            continue;
-      }
+      if ( !params.Get(profile, p->GetName(), &param) )
+         continue;
 
       // DoCheckIfSpam() may return -1 in addition to true or false which is
       // treated as "definitively false", i.e. not only this spam filter didn't
@@ -423,7 +476,7 @@ SpamFilter::CheckIfSpam(const Message& msg,
             if ( result )
             {
                *result = String::Format("recognized as spam by %s filter: %s",
-                                        name, *result);
+                                        p->GetName(), *result);
             }
             return true;
 
@@ -431,7 +484,7 @@ SpamFilter::CheckIfSpam(const Message& msg,
             if ( result )
             {
                *result = String::Format("recognized as non-spam by %s filter: %s",
-                                        name, *result);
+                                        p->GetName(), *result);
             }
             return false;
 
@@ -448,6 +501,146 @@ SpamFilter::CheckIfSpam(const Message& msg,
    return false;
 }
 
+/* static */
+void
+SpamFilter::CheckIfSpam(const ArrayMessages& msgs,
+                        const String& paramsAll,
+                        wxArrayInt& isSpam,
+                        wxArrayString *results,
+                        SpamBatchStats *stats)
+{
+   wxStopWatch sw;
+
+   const size_t count = msgs.size();
+
+   isSpam.clear();
+   isSpam.Add(false, count);
+   if ( results )
+   {
+      results->clear();
+      results->Add(wxEmptyString, count);
+   }
+
+   if ( !count )
+      return;
+
+   Profile * const profile = GetProfile(*msgs[0]);
+   if ( !profile )
+      return;
+
+   LoadAll();
+
+   const SpamFilterParams params(paramsAll);
+
+   // the indices of the messages which still need to be checked, i.e. which
+   // hadn't been classified by any of the filters yet
+   wxArrayInt indices;
+   indices.reserve(count);
+   for ( size_t n = 0; n < count; n++ )
+      indices.push_back(n);
+
+   for ( SpamFilter *p = ms_first; p && !indices.empty(); p = p->m_next )
+   {
+      String param;
+      if ( !params.Get(profile, p->GetName(), &param) )
+         continue;
+
+      ArrayMessages msgsToCheck;
+      msgsToCheck.reserve(indices.size());
+      for ( size_t n = 0; n < indices.size(); n++ )
+         msgsToCheck.push_back(msgs[indices[n]]);
+
+      wxArrayInt rcs;
+      wxArrayString texts;
+      p->DoCheckIfSpamBatch(profile, msgsToCheck, param, rcs, texts);
+
+      CHECK_RET( rcs.size() == msgsToCheck.size() &&
+                  texts.size() == msgsToCheck.size(),
+                 "DoCheckIfSpamBatch() didn't return all results" );
+
+      // as in CheckIfSpam() above, -1 means that the message is definitively
+      // not a spam and shouldn't be checked by the other filters
+      wxArrayInt indicesLeft;
+      for ( size_t n = 0; n < indices.size(); n++ )
+      {
+         const size_t idx = indices[n];
+         switch ( rcs[n] )
+         {
+            case true:
+               isSpam[idx] = true;
+               if ( results )
+               {
+                  (*results)[idx] =
+                     String::Format("recognized as spam by %s filter: %s",
+                                    p->GetName(), texts[n]);
+               }
+
+               if ( stats )
+                  stats->countSpam++;
+               break;
+
+            case -1:
+               if ( results )
+               {
+                  (*results)[idx] =
+                     String::Format("recognized as non-spam by %s filter: %s",
+                                    p->GetName(), texts[n]);
+               }
+               break;
+
+            default:
+               FAIL_MSG( "unexpected DoCheckIfSpamBatch() result" );
+               // fall through
+
+            case false:
+               indicesLeft.push_back(idx);
+         }
+      }
+
+      indices = indicesLeft;
+   }
+
+   if ( stats )
+   {
+      stats->count = count;
+      stats->msElapsed = sw.Time();
+   }
+}
+
+// ----------------------------------------------------------------------------
+// default implementations of the batch operations
+// ----------------------------------------------------------------------------
+
+void
+SpamFilter::DoTrainBatch(const Profile *profile,
+                         const ArrayMessages& msgs,
+                         bool isSpam)
+{
+   const size_t count = msgs.size();
+   for ( size_t n = 0; n < count; n++ )
+      DoTrain(profile, *msgs[n], isSpam);
+}
+
+void
+SpamFilter::DoCheckIfSpamBatch(const Profile *profile,
+                               const ArrayMessages& msgs,
+                               const String& param,
+                               wxArrayInt& isSpam,
+                               wxArrayString& results)
+{
+   const size_t count = msgs.size();
+   isSpam.clear();
+   results.clear();
+   isSpam.reserve(count);
+   results.reserve(count);
+   for ( size_t n = 0; n < count; n++ )
+   {
+      String result;
+      isSpam.push_back(DoCheckIfSpam(profile, *msgs[n], param, &result));
+      results.push_back(result);
+   }
+}
+
 // ----------------------------------------------------------------------------
 // spam filters configuration
 // ----------------------------------------------------------------------------
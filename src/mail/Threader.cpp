@@ -0,0 +1,907 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/Threader.cpp: implementation of MsgThreader
+// Purpose:     MsgThreader incrementally threads the messages of a listing
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include  "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+
+   #include "Threading.h"
+#endif // USE_PCH
+
+#include "mail/Threader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// rebuild everything if more than this part of the inserted messages had been
+// removed since the last rebuild
+static const size_t REBUILD_RATIO = 2;
+
+// don't bother rebuilding the small listings
+static const size_t REBUILD_MIN_REMOVED = 1000;
+
+// sort the lists of nodes at least this long by message index instead of
+// using std::sort(), this is faster for the top level nodes of big folders
+static const size_t SORT_BY_INDEX_MIN = 1000;
+
+// the initial size of the InternTable, must be a power of 2
+static const size_t INTERN_TABLE_INITIAL_SIZE = 1024;
+
+// ----------------------------------------------------------------------------
+// private functions
+// ----------------------------------------------------------------------------
+
+// find the next "<...@...>" in the string starting from the given position,
+// return its length (0 if not found) and update pos to point to its start
+static size_t FindNextMessageId(const char *s, size_t len, size_t& pos)
+{
+   enum
+   {
+      notInRef,
+      openingSeen,
+      atSeen
+   } state = notInRef;
+
+   size_t start = 0;
+   for ( size_t i = pos; i < len; i++ )
+   {
+      switch ( s[i] )
+      {
+         case '<':
+            // a new '<' always starts a new reference, so that we don't
+            // take garbage before the real one as part of it
+            start = i;
+            state = openingSeen;
+            break;
+
+         case '@':
+            if ( state == openingSeen )
+               state = atSeen;
+            break;
+
+         case '>':
+            if ( state == atSeen )
+            {
+               pos = start;
+               return i + 1 - start;
+            }
+            break;
+      }
+   }
+
+   pos = len;
+
+   return 0;
+}
+
+// ============================================================================
+// MsgThreader::InternTable implementation
+// ============================================================================
+
+void MsgThreader::InternTable::Clear()
+{
+   m_chars.clear();
+   m_slots.clear();
+   m_countUsed = 0;
+}
+
+/* static */
+size_t MsgThreader::InternTable::Hash(const char *s, size_t len)
+{
+   // FNV-1a hash
+   size_t h = 2166136261u;
+   for ( size_t n = 0; n < len; n++ )
+   {
+      h ^= (unsigned char)s[n];
+      h *= 16777619u;
+   }
+
+   return h;
+}
+
+size_t MsgThreader::InternTable::FindSlot(const char *s, size_t len) const
+{
+   const size_t mask = m_slots.size() - 1;
+   for ( size_t n = Hash(s, len) & mask; ; n = (n + 1) & mask )
+   {
+      const Slot& slot = m_slots[n];
+      if ( slot.value == NO_ID )
+         return n;
+
+      if ( slot.len == len && memcmp(&m_chars[slot.offset], s, len) == 0 )
+         return n;
+   }
+}
+
+MsgThreader::Id MsgThreader::InternTable::Find(const char *s, size_t len) const
+{
+   if ( m_slots.empty() )
+      return NO_ID;
+
+   return m_slots[FindSlot(s, len)].value;
+}
+
+void MsgThreader::InternTable::Grow()
+{
+   std::vector<Slot> slots;
+   slots.swap(m_slots);
+
+   Slot slotEmpty;
+   slotEmpty.offset =
+   slotEmpty.len = 0;
+   slotEmpty.value = NO_ID;
+
+   m_slots.resize(slots.empty() ? INTERN_TABLE_INITIAL_SIZE : 2*slots.size(),
+                  slotEmpty);
+
+   for ( size_t n = 0; n < slots.size(); n++ )
+   {
+      const Slot& slot = slots[n];
+      if ( slot.value != NO_ID )
+         m_slots[FindSlot(&m_chars[slot.offset], slot.len)] = slot;
+   }
+}
+
+void MsgThreader::InternTable::Add(const char *s, size_t len, Id value)
+{
+   // keep the load factor below 1/2
+   if ( 2*(m_countUsed + 1) > m_slots.size() )
+      Grow();
+
+   Slot& slot = m_slots[FindSlot(s, len)];
+   ASSERT_MSG( slot.value == NO_ID, _T("string already interned") );
+
+   slot.offset = m_chars.size();
+   slot.len = len;
+   slot.value = value;
+
+   m_chars.insert(m_chars.end(), s, s + len);
+
+   m_countUsed++;
+}
+
+// ============================================================================
+// MsgThreader implementation
+// ============================================================================
+
+const MsgThreader::NodeId MsgThreader::NO_NODE;
+const MsgnoType MsgThreader::NO_MESSAGE;
+const MsgThreader::Id MsgThreader::NO_ID;
+const MsgThreader::NodeId MsgThreader::ROOT_NODE;
+
+MsgThreader::MsgThreader()
+{
+   m_count = 0;
+
+   ClearContainers();
+}
+
+// ----------------------------------------------------------------------------
+// synchronization with the listing
+// ----------------------------------------------------------------------------
+
+void MsgThreader::ClearContainers()
+{
+   m_containers.clear();
+   m_messages.clear();
+   m_ids.Clear();
+   m_subjects.Clear();
+   m_countSubjects = 0;
+   m_countRemoved = 0;
+   m_mustRenumber = false;
+
+   m_nodes.clear();
+   m_subjectNodes.clear();
+}
+
+void MsgThreader::Clear()
+{
+   ClearContainers();
+
+   m_count = 0;
+}
+
+void MsgThreader::OnAdd(MsgnoType countNew)
+{
+   if ( countNew < m_messages.size() )
+   {
+      FAIL_MSG( _T("number of messages can't decrease in OnAdd()") );
+
+      ClearContainers();
+   }
+
+   m_count = countNew;
+}
+
+void MsgThreader::OnRemove(MsgnoType idx)
+{
+   CHECK_RET( idx < m_count, _T("invalid index in MsgThreader::OnRemove") );
+
+   m_count--;
+
+   if ( idx >= m_messages.size() )
+   {
+      // this message hadn't been inserted yet
+      return;
+   }
+
+   // the container of this message becomes empty but we leave it in place
+   // as it may be referenced by the other messages
+   m_containers[m_messages[idx].container].idx = NO_MESSAGE;
+
+   m_messages.erase(m_messages.begin() + idx);
+
+   // the indices of all the subsequent messages change too, but don't update
+   // them in their containers now as many messages are often removed at once
+   m_mustRenumber = true;
+
+   m_countRemoved++;
+
+   // the tree refers to the old indices
+   m_nodes.clear();
+}
+
+// ----------------------------------------------------------------------------
+// containers
+// ----------------------------------------------------------------------------
+
+MsgThreader::Id MsgThreader::NewContainer()
+{
+   Container c;
+   c.idx = NO_MESSAGE;
+   c.parent =
+   c.child =
+   c.prev =
+   c.next = NO_ID;
+
+   m_containers.push_back(c);
+
+   return m_containers.size() - 1;
+}
+
+MsgThreader::Id MsgThreader::GetContainer(const char *id, size_t len)
+{
+   Id container = m_ids.Find(id, len);
+   if ( container == NO_ID )
+   {
+      container = NewContainer();
+      m_ids.Add(id, len, container);
+   }
+
+   return container;
+}
+
+void MsgThreader::LinkContainer(Id parent, Id child)
+{
+   Container& c = m_containers[child];
+   Container& p = m_containers[parent];
+
+   ASSERT_MSG( c.parent == NO_ID, _T("container already has a parent") );
+
+   // insert it in the beginning, the order of children doesn't matter
+   c.parent = parent;
+   c.prev = NO_ID;
+   c.next = p.child;
+   if ( p.child != NO_ID )
+      m_containers[p.child].prev = child;
+   p.child = child;
+}
+
+void MsgThreader::UnlinkContainer(Id container)
+{
+   Container& c = m_containers[container];
+
+   if ( c.prev != NO_ID )
+      m_containers[c.prev].next = c.next;
+   else
+      m_containers[c.parent].child = c.next;
+
+   if ( c.next != NO_ID )
+      m_containers[c.next].prev = c.prev;
+
+   c.parent =
+   c.prev =
+   c.next = NO_ID;
+}
+
+bool MsgThreader::IsAncestorContainer(Id ancestor, Id container) const
+{
+   for ( Id p = m_containers[container].parent;
+         p != NO_ID;
+         p = m_containers[p].parent )
+   {
+      if ( p == ancestor )
+         return true;
+   }
+
+   return false;
+}
+
+void MsgThreader::Insert(MsgnoType idx, const Headers& headers)
+{
+   ASSERT_MSG( idx == m_messages.size(), _T("messages must be inserted in order") );
+
+   // find the container for this message: it could have been already created
+   // if this message was referenced by another one
+   const wxCharBuffer idBuf(headers.id.utf8_str());
+   const char * const idStr = idBuf.data();
+   size_t pos = 0;
+   const size_t lenId = FindNextMessageId(idStr, strlen(idStr), pos);
+
+   Id container = NO_ID;
+   if ( lenId )
+   {
+      container = m_ids.Find(idStr + pos, lenId);
+      if ( container == NO_ID )
+      {
+         container = NewContainer();
+         m_ids.Add(idStr + pos, lenId, container);
+      }
+      else if ( m_containers[container].idx != NO_MESSAGE )
+      {
+         // two messages with the same id, give a new (anonymous) container
+         // to this one
+         container = NO_ID;
+      }
+   }
+
+   if ( container == NO_ID )
+      container = NewContainer();
+
+   m_containers[container].idx = idx;
+
+   MessageInfo info;
+   info.container = container;
+   info.isReply = headers.isReply;
+   info.subject = NO_ID;
+   if ( !headers.subject.empty() )
+   {
+      const wxCharBuffer subjBuf(headers.subject.utf8_str());
+      const size_t lenSubj = strlen(subjBuf);
+      info.subject = m_subjects.Find(subjBuf, lenSubj);
+      if ( info.subject == NO_ID )
+      {
+         info.subject = m_countSubjects++;
+         m_subjects.Add(subjBuf, lenSubj, info.subject);
+      }
+   }
+
+   m_messages.push_back(info);
+
+   // now link together the containers for all references: they go from the
+   // root to the leaf, so each of them is the parent of the next one
+   const wxCharBuffer refsBuf(headers.references.utf8_str());
+   const char * const refsStr = refsBuf.data();
+   const size_t lenRefs = strlen(refsStr);
+
+   // if a reference is duplicated, we keep the last occurrence of it: this
+   // ensures that In-Reply-To, which comes last, is used as the parent even
+   // if it also appears, in a wrong place, in References
+   m_refs.clear();
+   for ( pos = 0; ; )
+   {
+      const size_t len = FindNextMessageId(refsStr, lenRefs, pos);
+      if ( !len )
+         break;
+
+      const Id ref = GetContainer(refsStr + pos, len);
+      for ( size_t n = 0; n < m_refs.size(); n++ )
+      {
+         if ( m_refs[n] == ref )
+         {
+            m_refs.erase(m_refs.begin() + n);
+            break;
+         }
+      }
+
+      m_refs.push_back(ref);
+
+      pos += len;
+   }
+
+   Id parent = NO_ID;
+   for ( size_t n = 0; n < m_refs.size(); n++ )
+   {
+      const Id ref = m_refs[n];
+
+      // don't change the existing links, the first message to establish them
+      // wins, and don't create loops
+      if ( parent != NO_ID &&
+            m_containers[ref].parent == NO_ID &&
+             parent != ref &&
+              !IsAncestorContainer(ref, parent) )
+      {
+         LinkContainer(parent, ref);
+      }
+
+      parent = ref;
+   }
+
+   // the last reference is the parent of this message unless this would
+   // create a loop
+   if ( parent != NO_ID &&
+         (parent == container || IsAncestorContainer(container, parent)) )
+   {
+      parent = NO_ID;
+   }
+
+   // if the container already has a parent, some of the references seen
+   // before were missing some links: use the ones of this message
+   const Id parentOld = m_containers[container].parent;
+   if ( parentOld != NO_ID )
+   {
+      if ( parentOld == parent )
+         return;
+
+      UnlinkContainer(container);
+   }
+
+   if ( parent != NO_ID )
+      LinkContainer(parent, container);
+}
+
+// ----------------------------------------------------------------------------
+// thread tree nodes
+// ----------------------------------------------------------------------------
+
+MsgThreader::NodeId MsgThreader::NewNode(MsgnoType idx, MsgnoType idxSubject)
+{
+   Node node;
+   node.idx = idx;
+   node.idxSubject = idxSubject;
+   node.parent =
+   node.child =
+   node.last =
+   node.prev =
+   node.next = NO_NODE;
+   node.countChildren = 0;
+
+   m_nodes.push_back(node);
+
+   return m_nodes.size() - 1;
+}
+
+void MsgThreader::AppendNode(NodeId parent, NodeId node)
+{
+   Node& n = m_nodes[node];
+   Node& p = m_nodes[parent];
+
+   n.parent = parent;
+   n.prev = p.last;
+   n.next = NO_NODE;
+
+   if ( p.last != NO_NODE )
+      m_nodes[p.last].next = node;
+   else
+      p.child = node;
+
+   p.last = node;
+   p.countChildren++;
+}
+
+void MsgThreader::UnlinkNode(NodeId node)
+{
+   Node& n = m_nodes[node];
+   Node& p = m_nodes[n.parent];
+
+   if ( n.prev != NO_NODE )
+      m_nodes[n.prev].next = n.next;
+   else
+      p.child = n.next;
+
+   if ( n.next != NO_NODE )
+      m_nodes[n.next].prev = n.prev;
+   else
+      p.last = n.prev;
+
+   p.countChildren--;
+
+   n.parent =
+   n.prev =
+   n.next = NO_NODE;
+}
+
+void MsgThreader::ReplaceNode(NodeId nodeOld, NodeId nodeNew)
+{
+   UnlinkNode(nodeNew);
+
+   Node& o = m_nodes[nodeOld];
+   Node& n = m_nodes[nodeNew];
+   Node& p = m_nodes[o.parent];
+
+   n.parent = o.parent;
+   n.prev = o.prev;
+   n.next = o.next;
+
+   if ( o.prev != NO_NODE )
+      m_nodes[o.prev].next = nodeNew;
+   else
+      p.child = nodeNew;
+
+   if ( o.next != NO_NODE )
+      m_nodes[o.next].prev = nodeNew;
+   else
+      p.last = nodeNew;
+
+   o.parent =
+   o.prev =
+   o.next = NO_NODE;
+}
+
+bool MsgThreader::IsAncestorNode(NodeId ancestor, NodeId node) const
+{
+   for ( NodeId p = m_nodes[node].parent; p != NO_NODE; p = m_nodes[p].parent )
+   {
+      if ( p == ancestor )
+         return true;
+   }
+
+   return false;
+}
+
+bool MsgThreader::SortByIndex()
+{
+   // the keys are the indices of different messages, so we can sort them in
+   // linear time by putting each node at the position of its message
+   m_byIndex.assign(m_messages.size(), NO_NODE);
+   for ( size_t n = 0; n < m_sorted.size(); n++ )
+   {
+      NodeId& node = m_byIndex[m_sorted[n].first];
+      if ( node != NO_NODE )
+         return false;
+
+      node = m_sorted[n].second;
+   }
+
+   m_sorted.clear();
+   for ( size_t idx = 0; idx < m_byIndex.size(); idx++ )
+   {
+      if ( m_byIndex[idx] != NO_NODE )
+         m_sorted.push_back(std::make_pair(idx, m_byIndex[idx]));
+   }
+
+   return true;
+}
+
+void MsgThreader::SortChildren(NodeId node)
+{
+   if ( m_nodes[node].countChildren < 2 )
+      return;
+
+   // the dummy nodes are shown at the position of their first child
+   m_sorted.clear();
+   bool sorted = true;
+   for ( NodeId n = m_nodes[node].child; n != NO_NODE; n = m_nodes[n].next )
+   {
+      const Node& kid = m_nodes[n];
+      const MsgnoType idx = kid.idx == NO_MESSAGE ? kid.idxSubject : kid.idx;
+      if ( !m_sorted.empty() && idx < m_sorted.back().first )
+         sorted = false;
+
+      m_sorted.push_back(std::make_pair(idx, n));
+   }
+
+   // they usually already are in order
+   if ( sorted )
+      return;
+
+   if ( m_sorted.size() < SORT_BY_INDEX_MIN || !SortByIndex() )
+      std::sort(m_sorted.begin(), m_sorted.end());
+
+   // relink the children in the new order
+   NodeId prev = NO_NODE;
+   for ( size_t n = 0; n < m_sorted.size(); n++ )
+   {
+      const NodeId kid = m_sorted[n].second;
+      m_nodes[kid].prev = prev;
+      if ( prev != NO_NODE )
+         m_nodes[prev].next = kid;
+
+      prev = kid;
+   }
+
+   m_nodes[prev].next = NO_NODE;
+
+   m_nodes[node].child = m_sorted.front().second;
+   m_nodes[node].last = prev;
+}
+
+// ----------------------------------------------------------------------------
+// building the thread tree
+// ----------------------------------------------------------------------------
+
+void MsgThreader::CollectChildren(Id container)
+{
+   // the empty containers are pruned by replacing them with their children
+   m_kids.clear();
+   m_stack.clear();
+
+   Id c = m_containers[container].child;
+   for ( ;; )
+   {
+      if ( c == NO_ID )
+      {
+         if ( m_stack.empty() )
+            break;
+
+         c = m_stack.back();
+         m_stack.pop_back();
+         continue;
+      }
+
+      const Container& cont = m_containers[c];
+      if ( cont.idx != NO_MESSAGE )
+      {
+         m_kids.push_back(c);
+         c = cont.next;
+      }
+      else // empty container
+      {
+         // examine its children and then continue with its siblings
+         m_stack.push_back(cont.next);
+         c = cont.child;
+      }
+   }
+}
+
+void MsgThreader::BuildTree()
+{
+   m_nodes.clear();
+   m_work.clear();
+
+   const NodeId root = NewNode(NO_MESSAGE, NO_MESSAGE);
+
+   const size_t count = m_containers.size();
+   for ( Id c = 0; c < count; c++ )
+   {
+      const Container& cont = m_containers[c];
+      if ( cont.parent != NO_ID )
+         continue;
+
+      if ( cont.idx != NO_MESSAGE )
+      {
+         const NodeId node = NewNode(cont.idx, cont.idx);
+         AppendNode(root, node);
+         m_work.push_back(std::make_pair(c, node));
+      }
+      else // an empty root container
+      {
+         CollectChildren(c);
+
+         // remove it if it has no children, replace it with its only child
+         // if it has one and make it a dummy node if it has several
+         NodeId parent = root;
+         if ( m_kids.size() > 1 )
+         {
+            // the dummy node uses the subject of the message shown first
+            // under it, independently of the order of the children
+            MsgnoType idxFirst = m_containers[m_kids[0]].idx;
+            for ( size_t n = 1; n < m_kids.size(); n++ )
+            {
+               if ( m_containers[m_kids[n]].idx < idxFirst )
+                  idxFirst = m_containers[m_kids[n]].idx;
+            }
+
+            parent = NewNode(NO_MESSAGE, idxFirst);
+            AppendNode(root, parent);
+         }
+
+         for ( size_t n = 0; n < m_kids.size(); n++ )
+         {
+            const MsgnoType idx = m_containers[m_kids[n]].idx;
+            const NodeId node = NewNode(idx, idx);
+            AppendNode(parent, node);
+            m_work.push_back(std::make_pair(m_kids[n], node));
+         }
+      }
+
+      // build the subtrees of the nodes created above
+      while ( !m_work.empty() )
+      {
+         const Id container = m_work.back().first;
+         const NodeId parent = m_work.back().second;
+         m_work.pop_back();
+
+         CollectChildren(container);
+         for ( size_t n = 0; n < m_kids.size(); n++ )
+         {
+            const MsgnoType idx = m_containers[m_kids[n]].idx;
+            const NodeId node = NewNode(idx, idx);
+            AppendNode(parent, node);
+            m_work.push_back(std::make_pair(m_kids[n], node));
+         }
+      }
+   }
+}
+
+void MsgThreader::BreakThreads()
+{
+   m_stack.clear();
+   for ( NodeId n = m_nodes[ROOT_NODE].child; n != NO_NODE; n = m_nodes[n].next )
+      m_stack.push_back(n);
+
+   while ( !m_stack.empty() )
+   {
+      const NodeId node = m_stack.back();
+      m_stack.pop_back();
+
+      const NodeId parent = m_nodes[node].parent;
+      if ( parent != ROOT_NODE && GetSubject(node) != GetSubject(parent) )
+      {
+         // subject changed, make this message start a new thread
+         UnlinkNode(node);
+         AppendNode(ROOT_NODE, node);
+
+         // the dummy nodes are only useful if they have several children
+         if ( m_nodes[parent].idx == NO_MESSAGE )
+         {
+            if ( m_nodes[parent].countChildren == 0 )
+               UnlinkNode(parent);
+            else if ( m_nodes[parent].countChildren == 1 )
+               ReplaceNode(parent, m_nodes[parent].child);
+         }
+      }
+
+      for ( NodeId n = m_nodes[node].child; n != NO_NODE; n = m_nodes[n].next )
+         m_stack.push_back(n);
+   }
+}
+
+void MsgThreader::GatherSubjects()
+{
+   // find the most interesting node for each subject: the first one seen in
+   // depth first order unless a node without "Re:" is seen later, the
+   // children are sorted first for the result not to depend on the order in
+   // which the messages were inserted
+   //
+   // notice that the replies to the messages without subject are not taken
+   // into account, as the JWZ threader always did
+   m_subjectNodes.assign(m_countSubjects, NO_NODE);
+
+   SortChildren(ROOT_NODE);
+
+   bool hasSubjects = false;
+   NodeId node = m_nodes[ROOT_NODE].child;
+   while ( node != NO_NODE )
+   {
+      SortChildren(node);
+
+      const Id subject = GetSubject(node);
+      if ( subject != NO_ID )
+      {
+         const NodeId old = m_subjectNodes[subject];
+         if ( old == NO_NODE || (IsReply(old) && !IsReply(node)) )
+            m_subjectNodes[subject] = node;
+
+         hasSubjects = true;
+      }
+
+      // go to the next node in depth first order
+      if ( m_nodes[node].child != NO_NODE && subject != NO_ID )
+      {
+         node = m_nodes[node].child;
+      }
+      else
+      {
+         while ( node != ROOT_NODE && m_nodes[node].next == NO_NODE )
+            node = m_nodes[node].parent;
+
+         node = node == ROOT_NODE ? NO_NODE : m_nodes[node].next;
+      }
+   }
+
+   if ( !hasSubjects )
+      return;
+
+   // now merge the top level nodes with the same subject
+   NodeId next;
+   for ( NodeId c = m_nodes[ROOT_NODE].child; c != NO_NODE; c = next )
+   {
+      next = m_nodes[c].next;
+
+      const Id subject = GetSubject(c);
+      if ( subject == NO_ID )
+         continue;
+
+      const NodeId old = m_subjectNodes[subject];
+      if ( old == c || IsAncestorNode(c, old) )
+         continue;
+
+      UnlinkNode(c);
+
+      if ( IsReply(c) && !IsReply(old) )
+      {
+         // make this message a child of the other one
+         AppendNode(old, c);
+      }
+      else if ( m_nodes[old].parent == ROOT_NODE )
+      {
+         // make both of them children of a new dummy node: we reuse the old
+         // node for it as m_subjectNodes points to it
+         const NodeId nodeNew = NewNode(m_nodes[old].idx,
+                                        m_nodes[old].idxSubject);
+
+         // NB: don't keep references to m_nodes elements across NewNode()
+         NodeId kid;
+         while ( (kid = m_nodes[old].child) != NO_NODE )
+         {
+            UnlinkNode(kid);
+            AppendNode(nodeNew, kid);
+         }
+
+         NodeId first = c,
+                second = nodeNew;
+         if ( m_nodes[first].idxSubject > m_nodes[second].idxSubject )
+            std::swap(first, second);
+
+         m_nodes[old].idx = NO_MESSAGE;
+         m_nodes[old].idxSubject = m_nodes[first].idxSubject;
+
+         AppendNode(old, first);
+         AppendNode(old, second);
+      }
+      else
+      {
+         // make it a sibling of the other one
+         AppendNode(m_nodes[old].parent, c);
+      }
+   }
+}
+
+void MsgThreader::Thread(const Source& source, const ThreadParams& thrParams)
+{
+   if ( m_countRemoved > REBUILD_MIN_REMOVED &&
+         m_countRemoved*REBUILD_RATIO > m_messages.size() )
+   {
+      // there are too many unused containers now, start from scratch
+      ClearContainers();
+   }
+   else if ( m_mustRenumber )
+   {
+      const size_t count = m_messages.size();
+      for ( size_t n = 0; n < count; n++ )
+         m_containers[m_messages[n].container].idx = n;
+
+      m_mustRenumber = false;
+   }
+
+   // insert the new messages
+   Headers headers;
+   for ( MsgnoType idx = m_messages.size(); idx < m_count; idx++ )
+   {
+      source.GetHeaders(idx, headers);
+
+      Insert(idx, headers);
+   }
+
+   BuildTree();
+
+   if ( thrParams.breakThread )
+      BreakThreads();
+
+   if ( thrParams.gatherSubjects )
+      GatherSubjects();
+}
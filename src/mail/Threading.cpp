@@ -29,6 +29,8 @@
    #include "Mcclient.h"      // need THREADNODE
 #endif // USE_PCH
 
+#include <vector>
+
 // ----------------------------------------------------------------------------
 // options we use
 // ----------------------------------------------------------------------------
@@ -111,11 +113,29 @@ ThreadData::ThreadData(MsgnoType count)
 
 void ThreadData::killTree()
 {
+   // mail_free_threadnode() is recursive and would overflow the stack for
+   // long threads (or just many messages, as the siblings are freed
+   // recursively too), so detach the nodes and free them one by one
+   std::vector<THREADNODE *> nodes;
    if ( m_root )
+      nodes.push_back(m_root);
+
+   while ( !nodes.empty() )
    {
-      mail_free_threadnode(&m_root);
-      m_root = NULL;
+      THREADNODE *node = nodes.back();
+      nodes.pop_back();
+
+      if ( node->next )
+         nodes.push_back(node->next);
+      if ( node->branch )
+         nodes.push_back(node->branch);
+
+      node->next =
+      node->branch = NULL;
+      mail_free_threadnode(&node);
    }
+
+   m_root = NULL;
 }
 
 ThreadData::~ThreadData()
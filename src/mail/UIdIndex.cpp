@@ -0,0 +1,166 @@
+//////////////////////////////////////////////////////////////////////////////
+// Project:     M - cross platform e-mail GUI client
+// File name:   mail/UIdIndex.cpp: implementation of UIdIndex class
+// Purpose:     UIdIndex allows to quickly find the msgno from UID
+// Author:      Mahogany team
+// Modified by:
+// Created:     18.10.26
+// CVS-ID:      $Id$
+// Copyright:   (C) 2026 Mahogany Team
+// Licence:     M license
+///////////////////////////////////////////////////////////////////////////////
+
+// ============================================================================
+// declarations
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// headers
+// ----------------------------------------------------------------------------
+
+#include  "Mpch.h"
+
+#ifndef USE_PCH
+   #include "Mcommon.h"
+#endif // USE_PCH
+
+#include "mail/UIdIndex.h"
+
+#include <algorithm>
+
+// ============================================================================
+// implementation
+// ============================================================================
+
+UIdIndex::UIdIndex()
+{
+   m_countUnknown = 0;
+   m_idxFirstUnknown = 0;
+   m_isSorted = true;
+}
+
+void UIdIndex::Clear()
+{
+   m_uids.clear();
+   m_countUnknown = 0;
+   m_idxFirstUnknown = 0;
+   m_isSorted = true;
+}
+
+void UIdIndex::OnAdd(MsgnoType countNew)
+{
+   const size_t countOld = m_uids.size();
+   if ( countNew < countOld )
+   {
+      // we can't know which messages disappeared, so start from scratch
+      FAIL_MSG( _T("number of messages decreased in UIdIndex::OnAdd()?") );
+
+      Clear();
+      OnAdd(countNew);
+
+      return;
+   }
+
+   if ( countNew == countOld )
+      return;
+
+   m_uids.resize(countNew, UID_UNKNOWN);
+
+   if ( !m_countUnknown )
+      m_idxFirstUnknown = countOld;
+
+   m_countUnknown += countNew - countOld;
+}
+
+void UIdIndex::OnExpunge(MsgnoType msgno)
+{
+   CHECK_RET( msgno != MSGNO_ILLEGAL && msgno <= m_uids.size(),
+              _T("invalid msgno in UIdIndex::OnExpunge()") );
+
+   const size_t idx = msgno - 1;
+   if ( m_uids[idx] == UID_UNKNOWN )
+      m_countUnknown--;
+
+   // this is linear in the number of messages but so is c-client processing
+   // of the expunge notifications
+   m_uids.erase(m_uids.begin() + idx);
+
+   if ( idx < m_idxFirstUnknown )
+      m_idxFirstUnknown--;
+}
+
+void UIdIndex::Set(MsgnoType msgno, UIdType uid)
+{
+   CHECK_RET( msgno != MSGNO_ILLEGAL, _T("invalid msgno in UIdIndex::Set()") );
+
+   CHECK_RET( uid != UID_UNKNOWN && uid != UID_ILLEGAL,
+              _T("invalid UID in UIdIndex::Set()") );
+
+   // we may be called for the new messages before OnAdd()
+   if ( msgno > m_uids.size() )
+      OnAdd(msgno);
+
+   const size_t idx = msgno - 1;
+   UIdType& uidOld = m_uids[idx];
+   if ( uidOld == uid )
+      return;
+
+   if ( uidOld == UID_UNKNOWN )
+      m_countUnknown--;
+
+   uidOld = uid;
+}
+
+MsgnoType UIdIndex::GetFirstUnknown(MsgnoType msgnoStart) const
+{
+   if ( !m_countUnknown )
+      return MSGNO_ILLEGAL;
+
+   // update the hint as we go, this is just an optimization
+   size_t& idxFirstUnknown = const_cast<UIdIndex *>(this)->m_idxFirstUnknown;
+
+   const size_t count = m_uids.size();
+   while ( idxFirstUnknown < count && m_uids[idxFirstUnknown] != UID_UNKNOWN )
+      idxFirstUnknown++;
+
+   size_t idx = msgnoStart ? msgnoStart - 1 : 0;
+   if ( idx < idxFirstUnknown )
+      idx = idxFirstUnknown;
+
+   for ( ; idx < count; idx++ )
+   {
+      if ( m_uids[idx] == UID_UNKNOWN )
+         return idx + 1;
+   }
+
+   return MSGNO_ILLEGAL;
+}
+
+MsgnoType UIdIndex::Find(UIdType uid) const
+{
+   ASSERT_MSG( IsComplete(), _T("UIdIndex::Find() called for incomplete index") );
+
+   if ( m_isSorted )
+   {
+      std::vector<UIdType>::const_iterator
+         i = std::lower_bound(m_uids.begin(), m_uids.end(), uid);
+      if ( i != m_uids.end() && *i == uid )
+         return (i - m_uids.begin()) + 1;
+   }
+
+   // either the UIDs are not sorted or this UID is not in the folder at all,
+   // linear search allows to distinguish between these cases
+   std::vector<UIdType>::const_iterator
+      i = std::find(m_uids.begin(), m_uids.end(), uid);
+   if ( i == m_uids.end() )
+      return MSGNO_ILLEGAL;
+
+   if ( m_isSorted )
+   {
+      wxLogDebug(_T("UIDs are not in ascending order, using linear search."));
+
+      m_isSorted = false;
+   }
+
+   return (i - m_uids.begin()) + 1;
+}
@@ -295,24 +295,22 @@ MailFolderVirt::Msg *MailFolderVirt::GetMsgFromMsgno(MsgnoType msgno) const
 
 MailFolderVirt::Msg *MailFolderVirt::GetMsgFromUID(UIdType uid) const
 {
-   MsgCookie cookie;
-   for ( Msg *msg = GetFirstMsg(cookie); msg; msg = GetNextMsg(cookie) )
-   {
-      if ( msg->uidVirt == uid )
-      {
-         return msg;
-      }
-   }
+   const MsgnoType msgno = GetMsgnoFromUID(uid);
 
-   FAIL_MSG( _T("no message with such UID in the virtual folder") );
+   CHECK( msgno != MSGNO_ILLEGAL, NULL,
+          _T("no message with such UID in the virtual folder") );
 
-   return NULL;
+   return m_messages[msgno - 1];
 }
 
 void MailFolderVirt::AddMsg(MailFolderVirt::Msg *msg)
 {
    CHECK_RET( msg, _T("NULL Msg in MailFolderVirt?") );
 
+   // GetMsgnoFromUID() relies on this
+   ASSERT_MSG( !GetMsgCount() || m_messages.Last()->uidVirt < msg->uidVirt,
+               _T("messages must be added in UID order") );
+
    m_underlyingMFs.insert(msg->mf);
 
    m_messages.Add(msg);
@@ -535,14 +533,22 @@ bool MailFolderVirt::DoCountMessages(MailFolderStatus *status) const
 
 MsgnoType MailFolderVirt::GetMsgnoFromUID(UIdType uid) const
 {
-   MsgnoType n = 1;
-   MsgCookie cookie;
-   for ( Msg *msg = GetFirstMsg(cookie); msg; msg = GetNextMsg(cookie), n++ )
+   // AddMsg() always appends messages with the new, greater, UID to the end
+   // and deleting messages doesn't change the order of the remaining ones, so
+   // m_messages is always sorted by UID and we can use binary search here
+   size_t lo = 0,
+          hi = GetMsgCount();
+   while ( lo < hi )
    {
-      if ( msg->uidVirt == uid )
-      {
-         return n;
-      }
+      const size_t mid = lo + (hi - lo) / 2;
+      const UIdType uidMid = m_messages[mid]->uidVirt;
+      if ( uidMid == uid )
+         return mid + 1;
+
+      if ( uidMid < uid )
+         lo = mid + 1;
+      else
+         hi = mid;
    }
 
    return MSGNO_ILLEGAL;
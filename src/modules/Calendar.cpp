@@ -36,6 +36,8 @@
 #include "HeaderInfo.h"
 #include "SendMessage.h"
 
+#include "mail/MailThreadPool.h"
+
 #include "gui/wxOptionsDlg.h"
 #include "gui/wxOptionsPage.h"
 #include "gui/wxMainFrame.h"
@@ -228,6 +230,9 @@ private:
 void
 DayCheckTimer::Notify(void)
 {
+   // the calendar folder is a mail folder, see MailLock
+   MailLocker lock;
+
    m_Module->OnTimer();
 }
 
@@ -46,6 +46,8 @@
 
 #include <wx/regex.h>   // wxRegEx::Flags
 
+#include <vector>
+
 #ifdef USE_PYTHON
 #    include "MPython.h"      // Python fix for PyObject / presult
 #    include "PythonHelp.h"   // Python fix for PythonCallback
@@ -69,6 +71,12 @@ static String gs_spamTest;                // MT-FIXME
 // constants
 // ----------------------------------------------------------------------------
 
+// the trace mask for the filters execution
+#define TRACE_FILTERS _T("filters")
+
+// the number of messages checked by the spam filters at once
+static const size_t SPAM_BATCH_SIZE = 200;
+
 // all recipient headers, more can be added (but always NULL terminate!)
 static const char *headersRecipients[] =
 {
@@ -263,6 +271,12 @@ public:
    /// check if a function is already defined
    const FunctionDefinition *FindFunction(const String &name);
 
+   /// precompile the constant arguments and remember the headers used
+   void CompileFunctionCall(const String &name, ArgList *args);
+
+   /// remember that the given header is used by the program
+   void AddHeaderUsed(const String &name);
+
    /**@name for runtime information */
    //@{
 
@@ -277,6 +291,16 @@ public:
    Message * GetMessage(void) const
       { SafeIncRef(m_MailMessage); return m_MailMessage; }
 
+   /**
+      Get the result of the spam check done in advance for the message.
+
+      @return true if the result is available, false if the message must be
+              checked now
+   */
+   bool GetSpamResult(const String& params,
+                      bool *isSpam,
+                      String *result) const;
+
    //@}
 
    /// obtain the interface to the main program
@@ -325,6 +349,9 @@ private:
    // the message itself
    Message *m_MailMessage;
 
+   // the index of the message in the array of messages being filtered
+   size_t m_MessageIndex;
+
    // the folder we're working in
    MailFolder *m_MailFolder;
 
@@ -334,11 +361,38 @@ private:
    // the folder the message was copied or moved to or empty
    String m_copiedTo;
 
-   // the optimization hints - set in FindFunction(), used in Apply()
-   bool m_hasToFunc,
-        m_hasRcptFunc,
-        m_hasHdrLineFunc,
-        m_hasHeaderFunc;
+   // the headers used by the program: set in CompileFunctionCall() and used
+   // in Apply() to retrieve them for all messages at once
+   wxArrayString m_headersUsed;
+
+   // true if the program needs the entire message header (or some headers
+   // which can't be determined before running it)
+   bool m_needsHeader;
+
+   // the parameters of the spam checks done by the program: set in
+   // CompileFunctionCall() and used in Apply() to check all messages at once
+   //
+   // only the checks which are always performed for every message are
+   // collected here as checking a message for spam may have side effects
+   // (e.g. DSPAM learns from all the messages it processes and RBL checks
+   // perform DNS queries) which we must not have for the messages for which
+   // isspam() wouldn't have been called at all
+   wxArrayString m_spamParams;
+
+   // the results of these checks for all messages, indexed by the message
+   // index: m_spamIsSpam[n] and m_spamResults[n] correspond to m_spamParams[n]
+   // and are empty if the messages couldn't be checked in advance
+   std::vector<wxArrayInt> m_spamIsSpam;
+   std::vector<wxArrayString> m_spamResults;
+
+   // the nesting level of the conditionally evaluated parts of the program
+   // (operands of the short-circuit operators, branches of "?:" and
+   // "if"/"else", function arguments) at the current parse position
+   int m_conditional;
+
+   // true if a function which may stop the program evaluation, such as
+   // delete(), had been already parsed: the rest of it may be not evaluated
+   bool m_mayAbort;
 
    friend class FilterRuleApply;
 
@@ -475,7 +529,8 @@ private:
    String CreditsForStatusBar();
    String ResultsMessage();
    bool UpdateProgressDialog();
-   void HeaderCacheHints();
+   void PrefetchHeaders();
+   void CheckSpamAll();
    bool Evaluate();
    bool ProgressCopy();
    bool CopyToOneFolder();
@@ -522,6 +577,9 @@ public:
    virtual const Value Evaluate(void) const = 0;
    virtual String ToString(void) const
       { return Evaluate().ToString(); }
+
+   /// return true if the value of this node doesn't depend on the message
+   virtual bool IsConstant(void) const { return false; }
 #ifdef DEBUG
    virtual String Debug(void) const = 0;
 #endif
@@ -604,6 +662,7 @@ class Number : public SyntaxNode
 public:
    Number(long v) { m_value = v; }
    virtual const Value Evaluate() const { MOcheck(); return m_value; }
+   virtual bool IsConstant() const { return true; }
 #ifdef DEBUG
    virtual String Debug(void) const
       { MOcheck(); String s; s.Printf(_T("%ld"), m_value); return s; }
@@ -619,6 +678,7 @@ public:
    StringConstant(String v) : m_String(v) {}
    virtual const Value Evaluate() const
       { MOcheck(); return m_String; }
+   virtual bool IsConstant() const { return true; }
 
 #ifdef DEBUG
    virtual String Debug(void) const
@@ -647,6 +707,7 @@ public:
          return ! (v.MakeNumber() ?
             v.GetNumber() : (long)v.GetString().Length());
       }
+   virtual bool IsConstant() const { return m_Sn->IsConstant(); }
 #ifdef DEBUG
    virtual String Debug(void) const
       {
@@ -673,6 +734,7 @@ public:
          return -(v.MakeNumber() ?
             v.GetNumber() : (long)v.GetString().Length());
       }
+   virtual bool IsConstant() const { return m_Sn->IsConstant(); }
 #ifdef DEBUG
    virtual String Debug(void) const
       {
@@ -720,6 +782,9 @@ public:
          m_MaxArgs = ARGLIST_DEFAULT_LENGTH;
          m_Args = new SyntaxNodePtr[m_MaxArgs];
          m_NArgs = 0;
+         m_RegEx = NULL;
+         m_MInterface = NULL;
+         m_hasLowerNeedle = false;
       }
    ~ArgList()
       {
@@ -727,6 +792,8 @@ public:
          for(size_t i = 0; i < m_NArgs; ++i)
             delete m_Args[i];
          delete [] m_Args;
+         if ( m_RegEx )
+            m_MInterface->strutil_freeRegEx(m_RegEx);
       }
    void Add(const SyntaxNode *arg)
       {
@@ -753,10 +820,54 @@ public:
          ASSERT(n < m_NArgs);
          return m_Args[n];
       }
+
+   /**@name Precompiled constant arguments
+
+      These are set by FilterRuleImpl::CompileFunctionCall() if the pattern
+      argument of the matching functions is a constant.
+    */
+   //@{
+
+   /// set the compiled regex, we take ownership of it
+   void SetRegEx(strutil_RegEx *re, MInterface *minterface)
+      {
+         ASSERT(!m_RegEx);
+         m_RegEx = re;
+         m_MInterface = minterface;
+      }
+
+   /// get the compiled regex or NULL
+   strutil_RegEx *GetRegEx() const { return m_RegEx; }
+
+   /// set the already lower cased string to search for
+   void SetLowerNeedle(const String& needle)
+      {
+         m_LowerNeedle = needle;
+         m_hasLowerNeedle = true;
+      }
+
+   /// get the lower cased string to search for, return false if none
+   bool GetLowerNeedle(String *needle) const
+      {
+         if ( !m_hasLowerNeedle )
+            return false;
+
+         *needle = m_LowerNeedle;
+         return true;
+      }
+
+   //@}
 private:
    SyntaxNodePtr *m_Args;
    size_t m_MaxArgs;
    size_t m_NArgs;
+
+   strutil_RegEx *m_RegEx;
+   MInterface *m_MInterface;   // used to free m_RegEx
+
+   String m_LowerNeedle;
+   bool m_hasLowerNeedle;
+
    MOBJECT_NAME(ArgList)
 };
 
@@ -818,6 +929,12 @@ public:
               ? m_Left->Evaluate()
               : m_Right->Evaluate();
       }
+   virtual bool IsConstant(void) const
+      {
+         return m_Cond->IsConstant() &&
+                m_Left->IsConstant() &&
+                m_Right->IsConstant();
+      }
 #ifdef DEBUG
    virtual String Debug(void) const
       {
@@ -853,6 +970,8 @@ public:
          delete m_Left;
          delete m_Right;
       }
+   virtual bool IsConstant(void) const
+      { return m_Left->IsConstant() && m_Right->IsConstant(); }
 #ifdef DEBUG
    virtual const wxChar *OperName(void) const = 0;
    String Debug(void) const
@@ -1031,6 +1150,29 @@ private:
    MOBJECT_NAME(IfElse)
 };
 
+// replace the node whose value doesn't depend on the message being filtered
+// with a constant node with the same value: this is done when parsing the
+// program to avoid evaluating the same expression for each message
+static const SyntaxNode *FoldConstants(const SyntaxNode *sn)
+{
+   if ( !sn->IsConstant() )
+      return sn;
+
+   const Value v = sn->Evaluate();
+
+   const SyntaxNode *folded;
+   if ( v.IsNumber() )
+      folded = new Number(v.GetNumber());
+   else if ( v.IsString() )
+      folded = new StringConstant(v.GetString());
+   else // error: leave the original expression, it will be evaluated later
+      return sn;
+
+   delete sn;
+
+   return folded;
+}
+
 static const FunctionList *BuiltinFunctions(void);
 
 const FunctionDefinition *
@@ -1041,25 +1183,91 @@ FilterRuleImpl::FindFunction(const String &name)
    for (FunctionList::iterator i = list->begin(); i != list->end(); ++i)
    {
       if ( name == i->GetName() )
-      {
-         // remember if we have some particular functions - we use it to
-         // optimize filter execution in Apply()
-         if ( name == _T("to") )
-            m_hasToFunc = true;
-         else if ( name == _T("recipients") )
-            m_hasRcptFunc = true;
-         else if ( name == _T("headerline") )
-            m_hasHdrLineFunc = true;
-         else if ( name == _T("header") )
-            m_hasHeaderFunc = true;
-
          return i.operator->();
-      }
    }
 
    return NULL;
 }
 
+void
+FilterRuleImpl::AddHeaderUsed(const String &name)
+{
+   if ( m_headersUsed.Index(name, false /* case insensitive */) == wxNOT_FOUND )
+      m_headersUsed.Add(name);
+}
+
+void
+FilterRuleImpl::CompileFunctionCall(const String &name, ArgList *args)
+{
+   // remember which headers the functions use - we use it to retrieve them
+   // for all messages at once in Apply()
+   if ( name == _T("to") )
+   {
+      AddHeaderUsed(_T("To"));
+   }
+   else if ( name == _T("recipients") || name == _T("istome") )
+   {
+      for ( const char **h = headersRecipients; *h; h++ )
+         AddHeaderUsed(*h);
+
+      if ( name == _T("istome") )
+         AddHeaderUsed(_T("List-Post"));
+   }
+   else if ( name == _T("headerline") )
+   {
+      // we can only know which header is used if it's a constant
+      if ( args->Count() == 1 && args->GetArg(0)->IsConstant() )
+         AddHeaderUsed(args->GetArg(0)->Evaluate().ToString());
+      else
+         m_needsHeader = true;
+   }
+   else if ( name == _T("header") )
+   {
+      m_needsHeader = true;
+   }
+   else if ( name == _T("delete") || name == _T("zap") ||
+             name == _T("move") || name == _T("nop") )
+   {
+      m_mayAbort = true;
+   }
+   else if ( name == _T("isspam") )
+   {
+      // we can only check all messages in advance if the parameters are known
+      // and if this check is done for all of them anyhow
+      if ( !m_conditional && !m_mayAbort &&
+            args->Count() == 1 && args->GetArg(0)->IsConstant() )
+      {
+         const String params = args->GetArg(0)->Evaluate().ToString();
+         if ( m_spamParams.Index(params) == wxNOT_FOUND )
+            m_spamParams.Add(params);
+      }
+   }
+
+   // the second argument of the matching functions is almost always a
+   // constant, avoid lower casing it or compiling the regex for each message
+   if ( args->Count() != 2 || !args->GetArg(1)->IsConstant() )
+      return;
+
+   if ( name == _T("matchregex") || name == _T("matchregexi") )
+   {
+      strutil_RegEx *re = m_MInterface->strutil_compileRegEx
+                          (
+                           args->GetArg(1)->Evaluate().ToString(),
+                           name == _T("matchregexi") ? wxRE_ICASE : 0
+                          );
+
+      // if it failed, the error will be given when evaluating the function
+      if ( re )
+         args->SetRegEx(re, m_MInterface);
+   }
+   else if ( name == _T("containsi") || name == _T("matchi") )
+   {
+      String needle = args->GetArg(1)->Evaluate().ToString();
+      m_MInterface->strutil_tolower(needle);
+      args->SetLowerNeedle(needle);
+   }
+}
+
 void
 FilterRuleImpl::Error(const String &error)
 {
@@ -1361,7 +1569,9 @@ FilterRuleImpl::ParseIfElse(void)
    }
    NextToken(); // swallow ')'
 
+   m_conditional++;
    const SyntaxNode *ifBlock = ParseBlock();
+   m_conditional--;
    if(! ifBlock) {
       delete condition;
       return NULL;
@@ -1372,10 +1582,12 @@ FilterRuleImpl::ParseIfElse(void)
    {
       // we must parse the else branch, too:
       NextToken(); // swallow the "else"
+      m_conditional++;
       if(token.IsIdentifier(_T("if")))
          elseBlock = ParseIfElse();
       else
          elseBlock = ParseBlock();
+      m_conditional--;
       if(! elseBlock)
       {
          delete condition;
@@ -1486,7 +1698,9 @@ FilterRuleImpl::ParseQueryOp(void)
    if(!token.IsChar('?'))
            return sn;
    NextToken();
+   m_conditional++;
    const SyntaxNode *left = ParseExpression();
+   m_conditional--;
    if(left == NULL) {
       Error(_("Expected expression after '?'"));
       delete sn;
@@ -1499,13 +1713,15 @@ FilterRuleImpl::ParseQueryOp(void)
       return NULL;
    }
    NextToken();
+   m_conditional++;
    const SyntaxNode *right = ParseExpression();
+   m_conditional--;
    if (right == NULL) {
       Error(_("Expected expression after ':'"));
       delete left; delete sn;
       return NULL;
    }
-   return new QueryOp(sn, left, right);
+   return FoldConstants(new QueryOp(sn, left, right));
 }
 
 // These little ditties will be needed a number of times, so they
@@ -1519,6 +1735,13 @@ FilterRuleImpl::ParseQueryOp(void)
 // That is, a string of left-associative operators at the same
 // precedence level.  The operands are all of type `part'
 typedef const SyntaxNode *(*OpCreate)(const SyntaxNode *l, const SyntaxNode *r);
+
+// return true if the right operand of this operator isn't always evaluated
+static inline bool IsShortCircuit(OpCreate op)
+{
+   return op == OperatorAnd::Create || op == OperatorOr::Create;
+}
+
 #define LeftAssoc(name,opers,part,msg) \
 const SyntaxNode * \
 FilterRuleImpl::Parse##name(void) \
@@ -1533,13 +1756,18 @@ FilterRuleImpl::Parse##name(void) \
       if (op == NULL) \
          break; \
       NextToken(); \
+      const bool cond = IsShortCircuit(op); \
+      if (cond) \
+         m_conditional++; \
       const SyntaxNode *exp = Parse##part(); \
+      if (cond) \
+         m_conditional--; \
       if (exp == NULL) { \
          delete expr; \
          Error(msg); \
          return NULL; \
       } \
-      expr = (*op)(expr, exp); \
+      expr = FoldConstants((*op)(expr, exp)); \
    } \
    return expr; \
 }
@@ -1677,7 +1905,7 @@ FilterRuleImpl::ParseRelational(void)
       Error(_("Expected expression after relational operator"));
       return NULL;
    }
-   return (*op)(expr, exp);
+   return FoldConstants((*op)(expr, exp));
 }
 
 static inline OpCreate
@@ -1748,7 +1976,7 @@ FilterRuleImpl::ParseUnary(void)
             Error(_("Expected unary after negation operator."));
             return NULL;
          }
-         sn = new Negation(sn);
+         sn = FoldConstants(new Negation(sn));
       }
    }
    else if( token.IsOperator() )
@@ -1771,7 +1999,7 @@ FilterRuleImpl::ParseUnary(void)
             sn = ParseUnary();
             if (sn == NULL)
                return NULL;
-            sn = new Negative(sn);
+            sn = FoldConstants(new Negative(sn));
          }
       }
    }
@@ -1825,7 +2053,10 @@ FilterRuleImpl::ParseFunctionCall(Token id)
    {
       for(;;)
       {
+         // the function doesn't have to evaluate its arguments
+         m_conditional++;
          const SyntaxNode *expr = ParseExpression();
+         m_conditional--;
          if(expr)
             args->Add(expr);
          else
@@ -1858,6 +2089,9 @@ FilterRuleImpl::ParseFunctionCall(Token id)
       delete args;
       return NULL;
    }
+
+   CompileFunctionCall(id.GetIdentifier(), args);
+
    return new FunctionCall(fd, args, this);
 }
 
@@ -1884,6 +2118,10 @@ static Value func_isspam(ArgList *args, FilterRuleImpl *p)
    const wxString param(args->GetArg(0)->Evaluate().GetString());
    gs_spamTest.clear();
 
+   bool isSpam;
+   if ( p->GetSpamResult(param, &isSpam, &gs_spamTest) )
+      return isSpam;
+
    return SpamFilter::CheckIfSpam(*msg, param, &gs_spamTest);
 }
 
@@ -1917,11 +2155,14 @@ static Value func_containsi(ArgList *args, FilterRuleImpl *p)
    if(args->Count() != 2)
       return 0;
    const Value v1 = args->GetArg(0)->Evaluate();
-   const Value v2 = args->GetArg(1)->Evaluate();
    String haystack = v1.ToString();
-   String needle = v2.ToString();
    p->GetInterface()->strutil_tolower(haystack);
-   p->GetInterface()->strutil_tolower(needle);
+   String needle;
+   if ( !args->GetLowerNeedle(&needle) )
+   {
+      needle = args->GetArg(1)->Evaluate().ToString();
+      p->GetInterface()->strutil_tolower(needle);
+   }
    return haystack.Find(needle) != -1;
 }
 
@@ -1955,11 +2196,14 @@ static Value func_matchi(ArgList *args, FilterRuleImpl *p)
    if(args->Count() != 2)
       return 0;
    const Value v1 = args->GetArg(0)->Evaluate();
-   const Value v2 = args->GetArg(1)->Evaluate();
    String haystack = v1.ToString();
-   String needle = v2.ToString();
    p->GetInterface()->strutil_tolower(haystack);
-   p->GetInterface()->strutil_tolower(needle);
+   String needle;
+   if ( !args->GetLowerNeedle(&needle) )
+   {
+      needle = args->GetArg(1)->Evaluate().ToString();
+      p->GetInterface()->strutil_tolower(needle);
+   }
    return haystack == needle;
 }
 
@@ -1969,16 +2213,22 @@ static Value DoMatchRegEx(ArgList *args, FilterRuleImpl *p, int flags = 0)
    if(args->Count() != 2)
       return 0;
    const Value v1 = args->GetArg(0)->Evaluate();
-   const Value v2 = args->GetArg(1)->Evaluate();
    String haystack = v1.ToString();
-   String needle = v2.ToString();
-   strutil_RegEx * re = p->GetInterface()->
-                           strutil_compileRegEx(needle, flags);
-   if(! re) return FALSE;
+
+   // use the regex precompiled from the constant pattern if we have it
+   strutil_RegEx *re = args->GetRegEx();
+   const bool ownRegEx = re == NULL;
+   if ( ownRegEx )
+   {
+      const Value v2 = args->GetArg(1)->Evaluate();
+      re = p->GetInterface()->strutil_compileRegEx(v2.ToString(), flags);
+      if(! re) return FALSE;
+   }
 
    // yes, 0, don't use flags here
    bool rc = p->GetInterface()->strutil_matchRegEx(re, haystack, 0);
-   p->GetInterface()->strutil_freeRegEx(re);
+   if ( ownRegEx )
+      p->GetInterface()->strutil_freeRegEx(re);
    return rc;
 }
 
@@ -2615,14 +2865,14 @@ FilterRuleImpl::FilterRuleImpl(const char* filterrule,
    m_FilterModule->IncRef();
 #endif
 
-   m_hasToFunc =
-   m_hasRcptFunc =
-   m_hasHdrLineFunc =
-   m_hasHeaderFunc = false;
+   m_needsHeader = false;
+   m_conditional = 0;
+   m_mayAbort = false;
 
    m_Program = Parse(filterrule);
    m_MessageUId = UID_ILLEGAL;
    m_MailMessage = NULL;
+   m_MessageIndex = 0;
    m_MailFolder = NULL;
 }
 
@@ -2635,6 +2885,29 @@ FilterRuleImpl::~FilterRuleImpl()
 #endif
 }
 
+bool
+FilterRuleImpl::GetSpamResult(const String& params,
+                              bool *isSpam,
+                              String *result) const
+{
+   const int n = m_spamParams.Index(params);
+   if ( n == wxNOT_FOUND )
+      return false;
+
+   const wxArrayInt& isSpamAll = m_spamIsSpam[n];
+   if ( m_MessageIndex >= isSpamAll.size() )
+      return false;
+
+   // -1 means that the message hadn't been checked
+   if ( isSpamAll[m_MessageIndex] == -1 )
+      return false;
+
+   *isSpam = isSpamAll[m_MessageIndex] != 0;
+   *result = m_spamResults[n][m_MessageIndex];
+
+   return true;
+}
+
 #ifdef DEBUG
 
 void FilterRuleImpl::Debug(void)
@@ -2712,6 +2985,10 @@ FilterRuleApply::LoopEvaluate()
 {
    bool allOk = true;
 
+   PrefetchHeaders();
+
+   CheckSpamAll();
+
    // first decide what should we do with the messages: fill the arrays with
    // the operations to perform and the destination folder if the operation
    // involves copying the message
@@ -2727,8 +3004,6 @@ FilterRuleApply::LoopEvaluate()
          continue;
       }
 
-      HeaderCacheHints();
-
       if ( !Evaluate() )
       {
          allOk = false;
@@ -2829,6 +3104,7 @@ bool
 FilterRuleApply::GetMessage()
 {
    m_parent->m_MessageUId = m_msgs[m_idx];
+   m_parent->m_MessageIndex = m_idx;
 
    if ( m_parent->m_MessageUId == UID_ILLEGAL )
    {
@@ -2854,33 +3130,101 @@ FilterRuleApply::GetMessage()
 }
 
 void
-FilterRuleApply::HeaderCacheHints()
+FilterRuleApply::PrefetchHeaders()
 {
-   // do some heuristic optimizations: if our program contains requests
-   // for the entire message header, get it first because like this it
-   // will be cached and all other requests will use it - otherwise we'd
-   // have to make several trips to server to get a few separate fields
-   // first and only then retrieve the header
+   // retrieve all the headers which the program is going to look at for all
+   // messages at once instead of making several trips to server for each of
+   // them when they're requested by the filter functions
    //
-   // in the same way, retrieve all the recipients if we need them anyhow
-   // before retrieving "To" &c
-   if ( m_parent->m_hasHeaderFunc )
+   // if the program needs the entire header, get just it because all the
+   // other requests will use it once it's cached
+   MailFolder * const mf = m_parent->m_MailFolder;
+   if ( m_parent->m_needsHeader )
+      mf->PrefetchHeaders(m_msgs, wxArrayString());
+   else if ( !m_parent->m_headersUsed.empty() )
+      mf->PrefetchHeaders(m_msgs, m_parent->m_headersUsed);
+}
+
+void
+FilterRuleApply::CheckSpamAll()
+{
+   // check all messages with the spam filters at once instead of checking
+   // them one by one when isspam() is called as this is much faster for the
+   // filters which can process several messages together
+   const wxArrayString& params = m_parent->m_spamParams;
+   const size_t countParams = params.size();
+   if ( !countParams )
+      return;
+
+   const size_t count = m_msgs.GetCount();
+   m_parent->m_spamIsSpam.assign(countParams, wxArrayInt());
+   m_parent->m_spamResults.assign(countParams, wxArrayString());
+   for ( size_t n = 0; n < countParams; n++ )
    {
-      if ( m_parent->m_hasToFunc || m_parent->m_hasRcptFunc
-         || m_parent->m_hasHdrLineFunc )
-      {
-         // pre-retrieve the whole header
-         (void)m_parent->m_MailMessage->GetHeader();
-      }
+      m_parent->m_spamIsSpam[n].Add(-1, count);
+      m_parent->m_spamResults[n].Add(wxEmptyString, count);
    }
-   else if ( m_parent->m_hasRcptFunc )
+
+   MailFolder * const mf = m_parent->m_MailFolder;
+
+   SpamBatchStats statsAll;
+   ArrayMessages msgs;
+   wxArrayInt indices;
+   for ( size_t first = 0; first < count; first += SPAM_BATCH_SIZE )
    {
-      if ( m_parent->m_hasToFunc )
+      const size_t last = wxMin(first + SPAM_BATCH_SIZE, count);
+      if ( m_pd )
       {
-         // pre-fetch the recipient headers which include "To"
-         (void)m_parent->m_MailMessage->GetHeaderLines(headersRecipients);
+         const String
+            textPD(wxString::Format(_("Checking messages %zu to %zu for spam..."),
+                                    first + 1, last));
+         if ( !m_pd->Update(0, textPD) )
+         {
+            // cancelled, the remaining messages will be checked when
+            // filtering them (if this happens at all)
+            break;
+         }
       }
+
+      for ( size_t n = first; n < last; n++ )
+      {
+         Message * const msg = mf->GetMessage(m_msgs[n]);
+         if ( msg )
+         {
+            msgs.push_back(msg);
+            indices.push_back(n);
+         }
+      }
+
+      for ( size_t p = 0; p < countParams; p++ )
+      {
+         wxArrayInt isSpam;
+         wxArrayString results;
+         SpamBatchStats stats;
+         SpamFilter::CheckIfSpam(msgs, params[p], isSpam, &results, &stats);
+
+         for ( size_t n = 0; n < indices.size(); n++ )
+         {
+            m_parent->m_spamIsSpam[p][indices[n]] = isSpam[n];
+            m_parent->m_spamResults[p][indices[n]] = results[n];
+         }
+
+         statsAll.count += stats.count;
+         statsAll.countSpam += stats.countSpam;
+         statsAll.msElapsed += stats.msElapsed;
+      }
+
+      for ( size_t n = 0; n < msgs.size(); n++ )
+         msgs[n]->DecRef();
+      msgs.clear();
+      indices.clear();
    }
+
+   wxLogTrace(TRACE_FILTERS,
+              _T("Checked %zu messages for spam in %ldms (%.0f msgs/s), ")
+              _T("%zu spams found"),
+              statsAll.count, statsAll.msElapsed, statsAll.GetRate(),
+              statsAll.countSpam);
 }
 
 bool
@@ -42,18 +42,32 @@
 #include "MModule.h"
 #include "MInterface.h"
 
+#include "modules/Migrate.h"
+
 #include "ListReceiver.h"
 
 #include "UIdArray.h"
 #include "HeaderInfo.h"
+#include "CacheFile.h"
 
 #include "ASMailFolder.h"               // for ATT_NOINFERIORS
 
+#include "mail/MailThreadPool.h"
+
 #include "gui/wxDialogLayout.h"
 #include "gui/wxMainFrame.h"
 #include "gui/wxBrowseButton.h"
 
 #include <wx/wizard.h>
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/file.h>                    // for wxTempFile
+#include <wx/filename.h>
+#include <wx/stopwatch.h>
+
+#include <map>
+#include <set>
+#include <vector>
 
 // if we're still using old headers
 #ifndef wxRB_SINGLE
@@ -68,130 +82,252 @@
 // folder which has both subfolders and messages
 #define MESSAGES_SUFFIX ".messages"
 
+// the first line of the migration journal file
+#define MIGRATE_JOURNAL_HEADER _T("Mahogany Migration Journal (version 1.0)")
+
 // ----------------------------------------------------------------------------
-// MigrateImapServer: IMAP server parameters
+// MigrateModule: implementation of MModule by this plugin
 // ----------------------------------------------------------------------------
 
-struct MigrateImapServer
+class MigrateModule : public MModule_Migrate
 {
-   // the server name
-   String server;
-
-   // the port or -1 for default
-   int port;
-
-   // the starting folder or empty if root
-   String root;
-
-   // the username and password (anonymous access if empty)
-   String username,
-          password;
+public:
+   MigrateModule(MInterface *minterface);
 
-   // the delimiter of the folder names (NUL initially meaning "unknown")
-   char delimiter;
+   virtual int Entry(int arg, ...);
 
-#ifdef USE_SSL
-   // use SSL to access this server?
-   bool useSSL;
-#endif // USE_SSL
+   // implement MModule_Migrate methods
+   virtual bool Migrate(MigrateData& data,
+                        MigrateProgress *progress,
+                        MigrateStats *stats);
+   virtual bool MigrateLocalTree(const String& from, const String& to);
 
-   MigrateImapServer()
-   {
-      port = -1;
+private:
+   // add a menu entry for us to the main frame menu, return true if ok
+   bool RegisterWithMainFrame();
 
-      delimiter = '\0';
+   // the main worker function
+   bool DoMigrate();
 
-#ifdef USE_SSL
-      useSSL = false;
-#endif // USE_SSL
-   }
+   MMODULE_DEFINE();
 };
 
+// ============================================================================
+// migration engine classes
+// ============================================================================
+
 // ----------------------------------------------------------------------------
-// MigrateLocal: local storage parameters
+// MigrateJournal: remembers the messages already copied
 // ----------------------------------------------------------------------------
 
-struct MigrateLocal
+/*
+   The journal is a text file in the cache directory whose name depends on
+   the migration source and destination. Its first line identifies the file
+   format, the second one contains the description of the migration and all
+   the subsequent ones have the following format:
+
+      folder name TAB UID validity TAB space separated UIDs
+
+   A new line is appended to the file after copying each batch of messages, so
+   the journal is never more than one batch behind the destination contents.
+ */
+class MigrateJournal
 {
-   // the directory in which to create the files
-   String root;
+public:
+   MigrateJournal() { }
 
-   // the format of the folders to create
-   FileMailboxFormat format;
+   // open the journal for the given migration, loading its existing entries
+   bool Open(const MigrateData& data);
 
-   MigrateLocal()
-   {
-      // use MBOX by default
-      format = FileMbox_MBOX;
-   }
-};
+   // fill uids with the UIDs of the messages already copied from the given
+   // folder, if its UID validity didn't change since then
+   void GetCopied(const String& folder,
+                  UIdType uidValidity,
+                  std::set<UIdType>& uids);
 
-// ----------------------------------------------------------------------------
-// MigrateData: the parameters of migration procedure
-// ----------------------------------------------------------------------------
+   // remember that the given messages were copied, this writes them to disk
+   // immediately
+   bool AddCopied(const String& folder,
+                  UIdType uidValidity,
+                  const UIdArray& uids);
 
-struct MigrateData
-{
-   // the server we're copying the mail from
-   MigrateImapServer source;
+   // close and delete the journal, called when the migration is complete
+   void Remove();
 
-   // if true, use dstIMAP below, otherwise use dstLocal
-   bool toIMAP;
+private:
+   // the messages copied from one folder
+   struct FolderEntry
+   {
+      FolderEntry() { uidValidity = UID_ILLEGAL; }
 
-   // the delimiter of the folder names (NUL initially meaning "unknown")
-   char delimiterDst;
+      UIdType uidValidity;
+      std::set<UIdType> uids;
+   };
 
-   // the destination server
-   MigrateImapServer dstIMAP;
+   typedef std::map<String, FolderEntry> FolderEntries;
 
-   // or the local file(s)
-   MigrateLocal dstLocal;
+   // return the description of the migration stored in the journal
+   static String GetDescription(const MigrateData& data);
 
-   // the number of folders on the source server (-1 if unknown)
-   int countFolders;
+   // return the beginning of the journal line for the given folder
+   static String GetLinePrefix(const String& folder, UIdType uidValidity);
 
-   // the (full) names of the folders to migrate (empty if countFolders == -1)
-   wxArrayString folderNames;
+   // parse the entries of the existing journal
+   void Load(const String& entries);
 
-   // the flags (ASMailFolder::ATT_XXX bit masks combination)
-   wxArrayInt folderFlags;
+   // rewrite the journal file with just the (valid) entries we have
+   bool Save(const String& desc);
 
-   MigrateData()
-   {
-      toIMAP = true;
 
-      delimiterDst = '\0';
+   FolderEntries m_entries;
 
-      countFolders = -1;
-   }
+   String m_filename;
 
-   // add a new folder to folderNames/folderFlags arrays
-   void AddFolder(const String& path, char delim, long flags);
+   wxFFile m_file;
 
-   // must be called at the end of folder enumeration to set the
-   // ATT_NOINFERIORS flags for the folders correctly
-   void FixFolderFlags();
+   // protects all the data above as AddCopied() is called by worker threads
+   wxMutex m_mutex;
+
+   DECLARE_NO_COPY_CLASS(MigrateJournal)
 };
 
 // ----------------------------------------------------------------------------
-// MigrateModule: implementation of MModule by this plugin
+// MigrateEngine: copies all folders described by MigrateData
 // ----------------------------------------------------------------------------
 
-class MigrateModule : public MModule
+/*
+   The engine works in the main thread but, if threads are enabled, the
+   messages of up to MigrateData::maxConnections folders are copied by the
+   global MailThreadPool workers. The folders are still opened and closed in
+   the main thread only and each of them is only used by one thread at a
+   time. The workers hold MailLock while copying, so they never run c-client
+   or our mail code concurrently with each other or with the main thread:
+   only the network I/O, during which they release the lock, overlaps. This
+   is what makes copying several folders at once faster, as each of them
+   uses its own connection to the servers.
+ */
+class MigrateEngine
 {
 public:
-   MigrateModule(MInterface *minterface);
+   MigrateEngine(MigrateData& data, MigrateProgress *progress);
 
-   virtual int Entry(int arg, ...);
+   // enumerate the source folders, filling data.folderNames and folderFlags
+   // and updating countFolders which remains -1 if this failed
+   static bool ListFolders(MigrateData& data);
+
+   // do the migration, return false if it couldn't be done at all, the
+   // errors while copying the individual folders are only counted in stats
+   bool Run();
+
+   // get the statistics
+   const MigrateStats& GetStats() const { return m_stats; }
+
+   // return true if the migration was cancelled
+   bool IsCancelled() const { return m_cancelled != 0; }
 
 private:
-   // add a menu entry for us to the main frame menu, return true if ok
-   bool RegisterWithMainFrame();
+   // the state of a folder being copied
+   struct FolderCopy
+   {
+      // its name relative to the root
+      String name;
 
-   // the main worker function
-   bool DoMigrate();
+      // the opened source and destination folders
+      MailFolder *mfSrc,
+                 *mfDst;
 
-   MMODULE_DEFINE();
+      // true if all the messages were copied
+      bool ok;
+   };
+
+   // the task copying the messages of one folder
+   class CopyTask;
+
+   friend class CopyTask;
+
+   // enumerate the local source folders recursively
+   static void ListLocalFolders(MigrateData& data,
+                                const String& dir,
+                                const String& prefix);
+
+   // return the type of the source folders
+   MFolderType GetSrcType() const;
+
+   // return the type of the folders we're creating
+   MFolderType GetDstType() const;
+
+   // returns the folder to copy from
+   MailFolder *OpenSource(const String& name);
+
+   // return the MFolder to copy to
+   MFolder *GetDstFolder(const String& name, int flags);
+
+   // set the access parameters for an IMAP folder (GetDstFolder() helper)
+   void SetAccessParameters(MFolder *folderDst);
+
+   // get the dst folder name corresponding to the given source folder
+   String GetDstNameForSource(const String& name) const;
+
+   // get the full source folder name to show to the user
+   String GetFullSourceName(const String& name) const;
+
+   // create the local directories for the destination folders and determine
+   // the destination delimiter, this must be done before starting copying
+   bool PrepareDst();
+
+   // open the folders for the given folder and return the object which must
+   // be passed to CopyFolder() or NULL if there is nothing to copy
+   FolderCopy *StartFolder(int n);
+
+   // copy the messages of the folder opened by StartFolder() and add it to
+   // m_copiesDone, this is called in a worker thread and must not use the
+   // profiles nor open or close the folders
+   void CopyFolder(FolderCopy *copy);
+
+   // CopyFolder() helper returning true if all messages were copied
+   bool DoCopyFolder(FolderCopy *copy);
+
+   // close the folders and update the statistics once CopyFolder() is done
+   void FinishFolder(FolderCopy *copy);
+
+   // finish all folders copied since the last call, return their number
+   size_t FinishDoneFolders();
+
+   // update the message statistics, may be called from any thread, return
+   // false if the migration was cancelled
+   bool UpdateMessageStats(unsigned long copied,
+                           unsigned long skipped,
+                           unsigned long duplicate,
+                           unsigned long failed);
+
+   // notify m_progress about the progress, return false if cancelled
+   bool ReportProgress();
+
+
+   MigrateData& m_data;
+
+   MigrateProgress * const m_progress;
+
+   MigrateStats m_stats;
+
+   MigrateJournal m_journal;
+
+   // true if m_journal should be used
+   bool m_useJournal;
+
+   // non 0 if we were cancelled
+   wxAtomicInt m_cancelled;
+
+   // the folders copied by the worker threads and not finished yet
+   std::vector<FolderCopy *> m_copiesDone;
+
+   // protects m_stats and m_copiesDone
+   wxMutex m_mutex;
+
+   // signalled when a folder copy is done
+   wxCondition m_condDone;
+
+   DECLARE_NO_COPY_CLASS(MigrateEngine)
 };
 
 // ============================================================================
@@ -272,8 +408,7 @@ private:
 // MigrateWizard: the wizard used to interact with the user
 // ----------------------------------------------------------------------------
 
-class MigrateWizard : public wxWizard,
-                      public ListEventReceiver
+class MigrateWizard : public wxWizard
 {
 public:
    // all our pages
@@ -319,10 +454,6 @@ public:
    virtual bool HasNextPage(wxWizardPage *page);
    virtual bool HasPrevPage(wxWizardPage *page);
 
-   // implement ListEventReceiver methods
-   virtual void OnListFolder(const String& path, wxChar delim, long flags);
-   virtual void OnNoMoreFolders();
-
 private:
    // return, creating if necessary, the given page
    wxWizardPage *GetPage(Page page);
@@ -332,9 +463,6 @@ private:
    // the pages (created on demand by GetPage())
    wxWizardPage *m_pages[Page_Max];
 
-   // false while we're waiting for the events from ListFolders()
-   bool m_doneWithList;
-
    DECLARE_NO_COPY_CLASS(MigrateWizard)
 };
 
@@ -526,11 +654,15 @@ private:
 // MigrateWizardProgressPage: fourth and final page, show migration progress
 // ----------------------------------------------------------------------------
 
-class MigrateWizardProgressPage : public MigrateWizardPage
+class MigrateWizardProgressPage : public MigrateWizardPage,
+                                  public MigrateProgress
 {
 public:
    MigrateWizardProgressPage(MigrateWizard *parent);
 
+   // implement MigrateProgress method
+   virtual bool OnProgress(const MigrateStats& stats);
+
 protected:
    // enable/disable all wizard buttons
    void EnableWizardButtons(bool enable);
@@ -546,55 +678,14 @@ protected:
    void OnShow(wxShowEvent& event);
 
 private:
-   // update the messages progress meter
-   bool UpdateMessageProgress();
-
-   // update the folder progress meter (also updates the messages one)
-   bool UpdateFolderProgress();
-
    // update the status shown in m_labelStatus
    bool UpdateStatus(const String& msg);
 
-
-   // returns the folder to copy from
-   MailFolder *OpenSource(const MigrateImapServer& imapData,
-                          const String& name);
-
-   // return the MFolder to copy to
-   MFolder *GetDstFolder(const String& name, int flags);
-
-   // set the access parameters for an IMAP folder (GetDstFolder() helper)
-   void SetAccessParameters(MFolder *folderDst);
-
-   // return the type of the folders we're creating
-   MFolderType GetDstType() const;
-
-   // get the dst folder name corresponding to the given source folder
-   String GetDstNameForSource(const String& name);
-
-   // do copy all messages
-   bool CopyMessages(MailFolder *mfSrc, MFolder *folderDst);
-
-   // process the source folder with this name
-   bool ProcessOneFolder(const String& name, int flags);
-
-   // create the target folder corresponding to the non-selectable source one
-   bool CreateDstDirectory(const String& name);
-
-   // process all folders
-   bool ProcessAllFolders();
-
-   // wrapper arounnd ProcessAllFolders()
+   // do the migration
    void DoMigration();
 
 
    // data
-   int m_nFolder,                   // current folder or -1 if none yet
-       m_nMessage,                  // current message in current folder
-       m_countMessages;             // total number of messages or -1
-
-   size_t m_nErrors;                // number of folders we couldn't copy
-
    bool m_continue;                 // set to false if we're cancelled
 
    // the GUI controls
@@ -708,125 +799,1186 @@ MigrateModule::DoMigrate()
    return done ? 0 : 1;
 }
 
-// ============================================================================
-// GUI classes implementation
-// ============================================================================
+bool
+MigrateModule::Migrate(MigrateData& data,
+                       MigrateProgress *progress,
+                       MigrateStats *stats)
+{
+   MigrateEngine engine(data, progress);
 
-// ----------------------------------------------------------------------------
-// IMAPServerPanel
-// ----------------------------------------------------------------------------
+   const bool ok = engine.Run();
 
-BEGIN_EVENT_TABLE(IMAPServerPanel, wxEnhancedPanel)
-   EVT_TEXT(-1, IMAPServerPanel::OnText)
-END_EVENT_TABLE()
+   if ( stats )
+      *stats = engine.GetStats();
 
-IMAPServerPanel::IMAPServerPanel(wxWindow *parent, MigrateImapServer *imapData)
-               : wxEnhancedPanel(parent)
-{
-   m_imapData = imapData;
-   m_folder = NULL;
-   m_isDirty = false;
+   return ok && !engine.IsCancelled() && !engine.GetStats().foldersFailed;
+}
 
-   // the controls data
-   enum Fields
+// parse the "[format:]directory" string used by MigrateLocalTree()
+static void ParseLocalTreeSpec(const String& spec, MigrateLocal& local)
+{
+   static const struct
    {
-      Label_Server,
-      Label_Root,
-      Label_Login,
-      Label_Password,
-#ifdef USE_SSL
-      Label_SSL,
-#endif // USE_SSL
-      Label_Max
+      const wxChar *prefix;
+      FileMailboxFormat format;
+   } formats[] =
+   {
+      { _T("mbx:"),  FileMbox_MBX  },
+      { _T("mbox:"), FileMbox_MBOX },
+      { _T("mh:"),   FileMbox_Max  },
    };
 
-   wxArrayString labels;
-   labels.Add(_("&Server:"));
-   labels.Add(_("&Root folder:"));
-   labels.Add(_("&User name:"));
-   labels.Add(_("&Password:"));
-#ifdef USE_SSL
-   labels.Add(_("Use SS&L"));
-#endif // USE_SSL
+   for ( size_t n = 0; n < WXSIZEOF(formats); n++ )
+   {
+      if ( spec.StartsWith(formats[n].prefix, &local.root) )
+      {
+         local.format = formats[n].format;
+         return;
+      }
+   }
 
-   // check that we didn't forget to update something
-   ASSERT_MSG( labels.GetCount() == Label_Max, _T("label count mismatch") );
+   local.root = spec;
+}
 
-   const long widthMax = GetMaxLabelWidth(labels, this);
+bool
+MigrateModule::MigrateLocalTree(const String& from, const String& to)
+{
+   MigrateData data;
+   data.fromIMAP = false;
+   data.toIMAP = false;
+   ParseLocalTreeSpec(from, data.srcLocal);
+   ParseLocalTreeSpec(to, data.dstLocal);
+
+   wxStopWatch sw;
+
+   MigrateStats stats;
+   const bool ok = Migrate(data, NULL, &stats);
+
+   const long msElapsed = sw.Time();
+
+   wxLogMessage(_("Migrated %d folders (%d failed) from \"%s\" to \"%s\" "
+                  "in %ldms: %lu messages copied (%.0f msgs/s), %lu skipped, "
+                  "%lu duplicate, %lu failed."),
+                stats.foldersDone, stats.foldersFailed,
+                data.srcLocal.root, data.dstLocal.root,
+                msElapsed,
+                stats.messagesCopied,
+                msElapsed ? stats.messagesCopied*1000./msElapsed : 0.,
+                stats.messagesSkipped,
+                stats.messagesDuplicate,
+                stats.messagesFailed);
+
+   return ok;
+}
 
-   // create the controls: server and the root folder to use on it
-   m_textServer = CreateFolderEntry(labels[Label_Server], widthMax, NULL,
-                                    &m_btnFolder);
-   m_textRoot = CreateTextWithLabel(labels[Label_Root], widthMax, m_textServer);
+// ============================================================================
+// migration engine implementation
+// ============================================================================
 
-   // the authentication parameters
-   m_textLogin = CreateTextWithLabel(labels[Label_Login], widthMax, m_textRoot);
-   m_textPass = CreateTextWithLabel(labels[Label_Password], widthMax,
-                                    m_textLogin, 0, wxTE_PASSWORD);
+// ----------------------------------------------------------------------------
+// MigrateJournal
+// ----------------------------------------------------------------------------
 
-#ifdef USE_SSL
-   m_chkSSL = CreateCheckBox(labels[Label_SSL], widthMax, m_textPass);
-#endif // USE_SSL
+/* static */
+String MigrateJournal::GetDescription(const MigrateData& data)
+{
+   String desc;
+   if ( data.fromIMAP )
+   {
+      desc << _T("imap://") << data.source.username << _T('@')
+           << data.source.server << _T('/') << data.source.root;
+   }
+   else
+   {
+      desc << _T("local:") << data.srcLocal.root;
+   }
+
+   desc << _T(" -> ");
+
+   if ( data.toIMAP )
+   {
+      desc << _T("imap://") << data.dstIMAP.username << _T('@')
+           << data.dstIMAP.server << _T('/') << data.dstIMAP.root;
+   }
+   else
+   {
+      desc << _T("local:") << data.dstLocal.root
+           << _T(':') << (int)data.dstLocal.format;
+   }
+
+   return desc;
 }
 
-IMAPServerPanel::~IMAPServerPanel()
+/* static */
+String MigrateJournal::GetLinePrefix(const String& folder, UIdType uidValidity)
 {
-   if ( m_folder )
-      m_folder->DecRef();
+   return String::Format(_T("%s\t%lu\t"), folder, (unsigned long)uidValidity);
 }
 
-bool IMAPServerPanel::TransferDataToWindow()
+bool MigrateJournal::Open(const MigrateData& data)
 {
-   CHECK( m_imapData, false, _T("no data in IMAPServerPanel") );
+   const String desc = GetDescription(data);
 
-   String server = m_imapData->server;
-   if ( m_imapData->port != -1 )
+   // use FNV-1a hash of the description as the file name
+   unsigned long hash = 2166136261ul;
+   const wxCharBuffer buf(desc.utf8_str());
+   for ( const char *p = buf; *p; p++ )
    {
-      server += String::Format(_T(":%d"), m_imapData->port);
+      hash ^= (unsigned char)*p;
+      hash = (hash * 16777619ul) & 0xffffffff;
    }
 
-   m_textServer->SetValue(server);
+   m_filename.clear();
+   m_filename << CacheFile::GetCacheDirName() << DIR_SEPARATOR
+              << String::Format(_T("migrate-%08lx.journal"), hash);
 
-   m_textRoot->SetValue(m_imapData->root);
-   m_textLogin->SetValue(m_imapData->username);
-   m_textPass->SetValue(m_imapData->password);
+   if ( !CacheFile::CreateDirFor(m_filename) )
+      return false;
 
-#ifdef USE_SSL
-   m_chkSSL->SetValue(m_imapData->useSSL);
-#endif // USE_SSL
+   // load the existing journal if it's for the same migration
+   if ( wxFileExists(m_filename) )
+   {
+      wxFFile fileOld(m_filename, _T("rb"));
 
-   UpdateForwardBtnUI();
+      String contents;
+      if ( fileOld.IsOpened() && fileOld.ReadAll(&contents, wxConvUTF8) )
+      {
+         String rest;
+         if ( contents.StartsWith(MIGRATE_JOURNAL_HEADER _T("\n"), &rest) &&
+               rest.BeforeFirst(_T('\n')) == desc )
+         {
+            Load(rest.AfterFirst(_T('\n')));
 
-   return true;
+            wxLogDebug(_T("Resuming migration using journal \"%s\"."),
+                       m_filename);
+         }
+      }
+   }
+
+   if ( !Save(desc) )
+   {
+      wxLogError(_("Failed to write the migration journal \"%s\"."),
+                 m_filename);
+
+      return false;
+   }
+
+   return m_file.Open(m_filename, _T("ab"));
 }
 
-bool IMAPServerPanel::TransferDataFromWindow()
+void MigrateJournal::Load(const String& entries)
 {
-   // extract the host name and the port from the provided string
-   String server = m_textServer->GetValue();
-   const size_t posColon = server.find(_T(':'));
-   if ( posColon != String::npos )
+   const wxArrayString lines = wxSplit(entries, _T('\n'), _T('\0'));
+
+   // the last line is either empty or incomplete, if we were interrupted
+   // while writing it, and so can't be trusted in any case
+   for ( size_t n = 0; n + 1 < lines.size(); n++ )
    {
-      const String port = server.substr(posColon);
+      const wxArrayString fields = wxSplit(lines[n], _T('\t'), _T('\0'));
 
-      unsigned long l;
-      if ( !port.ToULong(&l) || l > INT_MAX )
+      unsigned long uidValidity;
+      if ( fields.size() != 3 || !fields[1].ToULong(&uidValidity) )
       {
-         wxLogError(_("Invalid port specification: %s"), port);
+         wxLogDebug(_T("Invalid line %lu in migration journal ignored."),
+                    (unsigned long)n + 3);
+         continue;
+      }
 
-         return false;
+      // only the entries for the latest UID validity are useful
+      FolderEntry& entry = m_entries[fields[0]];
+      if ( entry.uidValidity != uidValidity )
+      {
+         entry.uidValidity = uidValidity;
+         entry.uids.clear();
       }
 
-      if ( (unsigned long)m_imapData->port != l )
+      const wxArrayString uids = wxSplit(fields[2], _T(' '), _T('\0'));
+      for ( size_t m = 0; m < uids.size(); m++ )
       {
-         // cast is safe because of the check above
-         m_imapData->port = (int)l;
+         unsigned long uid;
+         if ( uids[m].ToULong(&uid) )
+            entry.uids.insert(uid);
+      }
+   }
+}
 
-         m_isDirty = true;
+bool MigrateJournal::Save(const String& desc)
+{
+   wxTempFile file(m_filename);
+
+   bool ok = file.IsOpened() &&
+               file.Write(MIGRATE_JOURNAL_HEADER _T("\n") + desc + _T('\n'),
+                          wxConvUTF8);
+
+   for ( FolderEntries::const_iterator i = m_entries.begin();
+         ok && i != m_entries.end();
+         ++i )
+   {
+      String line = GetLinePrefix(i->first, i->second.uidValidity);
+      for ( std::set<UIdType>::const_iterator j = i->second.uids.begin();
+            j != i->second.uids.end();
+            ++j )
+      {
+         line << *j << _T(' ');
       }
 
-      // remove the port pat from the host string
-      server.erase(posColon);
+      line += _T('\n');
+
+      ok = file.Write(line, wxConvUTF8);
+   }
+
+   return ok && file.Commit();
+}
+
+void MigrateJournal::GetCopied(const String& folder,
+                               UIdType uidValidity,
+                               std::set<UIdType>& uids)
+{
+   wxMutexLocker lock(m_mutex);
+
+   FolderEntries::const_iterator i = m_entries.find(folder);
+   if ( i != m_entries.end() && i->second.uidValidity == uidValidity )
+      uids = i->second.uids;
+}
+
+bool MigrateJournal::AddCopied(const String& folder,
+                               UIdType uidValidity,
+                               const UIdArray& uids)
+{
+   // the folder names with these characters would break the file format
+   if ( folder.find_first_of(_T("\t\n")) != String::npos )
+      return false;
+
+   wxMutexLocker lock(m_mutex);
+
+   CHECK( m_file.IsOpened(), false, _T("migration journal not opened") );
+
+   FolderEntry& entry = m_entries[folder];
+   if ( entry.uidValidity != uidValidity )
+   {
+      entry.uidValidity = uidValidity;
+      entry.uids.clear();
+   }
+
+   String line = GetLinePrefix(folder, uidValidity);
+   for ( size_t n = 0; n < uids.GetCount(); n++ )
+   {
+      entry.uids.insert(uids[n]);
+
+      line << uids[n] << _T(' ');
+   }
+
+   line += _T('\n');
+
+   return m_file.Write(line, wxConvUTF8) && m_file.Flush();
+}
+
+void MigrateJournal::Remove()
+{
+   wxMutexLocker lock(m_mutex);
+
+   m_file.Close();
+   m_entries.clear();
+
+   if ( !m_filename.empty() && wxFileExists(m_filename) )
+      wxRemoveFile(m_filename);
+}
+
+// ----------------------------------------------------------------------------
+// MigrateEngine::CopyTask
+// ----------------------------------------------------------------------------
+
+class MigrateEngine::CopyTask : public MailThreadPool::Task
+{
+public:
+   CopyTask(MigrateEngine& engine, FolderCopy *copy)
+      : m_engine(engine), m_copy(copy)
+   {
+   }
+
+   virtual void Execute() { m_engine.CopyFolder(m_copy); }
+
+private:
+   MigrateEngine& m_engine;
+
+   FolderCopy * const m_copy;
+
+   DECLARE_NO_COPY_CLASS(CopyTask)
+};
+
+// ----------------------------------------------------------------------------
+// MigrateEngine
+// ----------------------------------------------------------------------------
+
+MigrateEngine::MigrateEngine(MigrateData& data, MigrateProgress *progress)
+             : m_data(data),
+               m_progress(progress),
+               m_cancelled(0),
+               m_condDone(m_mutex)
+{
+   m_useJournal = false;
+}
+
+/* static */
+bool MigrateEngine::ListFolders(MigrateData& data)
+{
+   // forget the results of the previous enumeration, if any
+   data.folderNames.Empty();
+   data.folderFlags.Empty();
+   data.countFolders = -1;
+
+   if ( !data.fromIMAP )
+   {
+      if ( !wxDirExists(data.srcLocal.root) )
+         return false;
+
+      data.countFolders = 0;
+      ListLocalFolders(data, data.srcLocal.root, String());
+      data.FixFolderFlags();
+
+      return true;
+   }
+
+   // the helper class collecting the results of ListFolders()
+   class FolderLister : public ListEventReceiver
+   {
+   public:
+      FolderLister(MigrateData& data) : m_data(data) { m_done = false; }
+
+      bool IsDone() const { return m_done; }
+
+      virtual void OnListFolder(const String& path, wxChar delim, long flags)
+      {
+         m_data.AddFolder(path, delim, flags);
+      }
+
+      virtual void OnNoMoreFolders()
+      {
+         m_data.FixFolderFlags();
+
+         m_done = true;
+      }
+
+   private:
+      MigrateData& m_data;
+
+      // false while we're waiting for the events from ListFolders()
+      bool m_done;
+   };
+
+   MFolder_obj folderSrc(MFolder::CreateTemp(wxEmptyString, MF_IMAP));
+   CHECK( folderSrc, false, _T("MFolder::CreateTemp() failed?") );
+
+   const MigrateImapServer& imapData = data.source;
+   folderSrc->SetServer(imapData.server);
+   folderSrc->SetPath(imapData.root);
+   folderSrc->SetAuthInfo(imapData.username, imapData.password);
+
+#ifdef USE_SSL
+   if ( imapData.useSSL )
+   {
+      // we don't have a separate checkbox for accepting unsigned SSL
+      // certs because of lack of space in the dialog but we do accept
+      // them here because always accepting them is better than never
+      // doing it
+      folderSrc->SetSSL(SSLSupport_SSL, SSLCert_AcceptUnsigned);
+   }
+#endif // USE_SSL
+
+   ASMailFolder *asmf = ASMailFolder::OpenFolder
+                        (
+                         folderSrc,
+                         MailFolder::HalfOpen
+                        );
+   if ( !asmf )
+      return false;
+
+   data.countFolders = 0;
+
+   FolderLister lister(data);
+   if ( lister.ListAll(asmf) )
+   {
+      // process the events from ListFolders
+      do
+      {
+         MEventManager::ForceDispatchPending();
+      }
+      while ( !lister.IsDone() );
+   }
+
+   asmf->DecRef();
+
+   return true;
+}
+
+/* static */
+void MigrateEngine::ListLocalFolders(MigrateData& data,
+                                     const String& dir,
+                                     const String& prefix)
+{
+   wxDir d(dir);
+   if ( !d.IsOpened() )
+      return;
+
+   // for MH folders the directories are the folders and the files are the
+   // messages, otherwise the files are the folders and the directories
+   // just contain them
+   const bool isMH = data.srcLocal.format == FileMbox_Max;
+
+   wxString name;
+   for ( bool cont = d.GetFirst(&name, wxEmptyString, wxDIR_DIRS);
+         cont;
+         cont = d.GetNext(&name) )
+   {
+      const String path = prefix.empty() ? name : prefix + _T('/') + name;
+
+      data.AddFolder(path, '/', isMH ? 0 : ASMailFolder::ATT_NOSELECT);
+
+      ListLocalFolders(data, dir + DIR_SEPARATOR + name, path);
+   }
+
+   if ( isMH )
+      return;
+
+   for ( bool cont = d.GetFirst(&name, wxEmptyString, wxDIR_FILES);
+         cont;
+         cont = d.GetNext(&name) )
+   {
+      data.AddFolder(prefix.empty() ? name : prefix + _T('/') + name, '/', 0);
+   }
+}
+
+MFolderType
+MigrateEngine::GetSrcType() const
+{
+   if ( m_data.fromIMAP )
+      return MF_IMAP;
+
+   return m_data.srcLocal.format == FileMbox_Max ? MF_MH : MF_FILE;
+}
+
+MFolderType
+MigrateEngine::GetDstType() const
+{
+   MFolderType folderType;
+   if ( m_data.toIMAP )
+   {
+      folderType = MF_IMAP;
+   }
+   else // file, but which?
+   {
+      folderType = m_data.dstLocal.format == FileMbox_Max ? MF_MH : MF_FILE;
+   }
+
+   return folderType;
+}
+
+MailFolder *
+MigrateEngine::OpenSource(const String& name)
+{
+   MFolder_obj folderSrc(MFolder::CreateTemp(wxEmptyString, GetSrcType()));
+   CHECK( folderSrc, NULL, _T("MFolder::CreateTemp() failed?") );
+
+   String path;
+   if ( m_data.fromIMAP )
+   {
+      const MigrateImapServer& imapData = m_data.source;
+
+      folderSrc->SetServer(imapData.server);
+
+      path = imapData.root;
+      if ( !name.empty() )
+      {
+         path << imapData.delimiter << name;
+      }
+
+      folderSrc->SetAuthInfo(imapData.username, imapData.password);
+
+#ifdef USE_SSL
+      if ( imapData.useSSL )
+      {
+         folderSrc->SetSSL(SSLSupport_SSL, SSLCert_AcceptUnsigned);
+      }
+#endif // USE_SSL
+   }
+   else // local source
+   {
+      path << m_data.srcLocal.root << _T('/') << name;
+   }
+
+   folderSrc->SetPath(path);
+
+   return MailFolder::OpenFolder(folderSrc, MailFolder::ReadOnly);
+}
+
+String
+MigrateEngine::GetDstNameForSource(const String& name) const
+{
+   // when we start from source folder foo we want the target folder for foo to
+   // be named foo (and not have empty name) so always append source.root to
+   // the path
+   String path = m_data.dstLocal.root,
+          rootSrc = m_data.GetSourceRoot();
+
+   const char delimiterSrc = m_data.GetSourceDelimiter();
+
+   if ( !rootSrc.empty() )
+   {
+      if ( !path.empty() )
+         path += delimiterSrc;
+
+      path += rootSrc;
+   }
+
+   if ( !name.empty() )
+   {
+      if ( !path.empty() )
+         path += delimiterSrc;
+
+      path += name;
+   }
+
+   // make it into the dst path: it can have different delimiter
+   if ( m_data.delimiterDst && m_data.delimiterDst != delimiterSrc )
+   {
+      path.Replace(String(delimiterSrc), String(m_data.delimiterDst));
+   }
+
+   return path;
+}
+
+String
+MigrateEngine::GetFullSourceName(const String& name) const
+{
+   String fullname = m_data.GetSourceRoot();
+
+   if ( !fullname.empty() && !name.empty() )
+      fullname += m_data.GetSourceDelimiter();
+
+   fullname += name;
+
+   return fullname;
+}
+
+MFolder *
+MigrateEngine::GetDstFolder(const String& name, int flags)
+{
+   // which kind of folder are we going to create?
+   MFolderType folderType = GetDstType();
+   MFolder *folderDst = MFolder::CreateTemp(wxEmptyString, folderType);
+   CHECK( folderDst, NULL, _T("MFolder::CreateTemp() failed?") );
+
+   if ( folderType == MF_FILE )
+   {
+      folderDst->SetFileMboxFormat(m_data.dstLocal.format);
+   }
+
+   String path = GetDstNameForSource(name);
+
+   // there is a complication here: although IMAP folders may (depending on
+   // server) contain both messages and subfolders, this is impossible with
+   // MBOX and MBX folders (although ok with MH) and the way we deal with this
+   // is to put the messages in a file named "folder.messages" (the directory
+   // for the subfolders is created by PrepareDst())
+   if ( folderType == MF_FILE )
+   {
+      if ( !(flags & ASMailFolder::ATT_NOINFERIORS) )
+      {
+         path += MESSAGES_SUFFIX;
+      }
+   }
+   else if ( folderType == MF_IMAP )
+   {
+      // TODO: some IMAP servers do support folders which have both messages
+      //       and subfolders, we should test for this -- but for now we
+      //       suppose the worst case
+      if ( !(flags & ASMailFolder::ATT_NOINFERIORS) )
+      {
+         path += MESSAGES_SUFFIX;
+      }
+
+      SetAccessParameters(folderDst);
+   }
+
+   folderDst->SetPath(path);
+
+   return folderDst;
+}
+
+void
+MigrateEngine::SetAccessParameters(MFolder *folderDst)
+{
+   CHECK_RET( folderDst, _T("NULL folder in SetAccessParameters") );
+
+   if ( folderDst->GetType() == MF_IMAP )
+   {
+      const MigrateImapServer& dstIMAP = m_data.dstIMAP;
+      folderDst->SetServer(dstIMAP.server);
+      folderDst->SetAuthInfo(dstIMAP.username, dstIMAP.password);
+
+#ifdef USE_SSL
+      folderDst->SetSSL(dstIMAP.useSSL ? SSLSupport_SSL : SSLSupport_None,
+                        SSLCert_AcceptUnsigned);
+#endif // USE_SSL
+   }
+}
+
+bool MigrateEngine::PrepareDst()
+{
+   if ( !m_data.delimiterDst )
+   {
+      MFolder_obj folderDst(MFolder::CreateTemp(wxEmptyString, GetDstType()));
+      SetAccessParameters(folderDst);
+
+      m_data.delimiterDst = MailFolder::GetFolderDelimiter(folderDst);
+   }
+
+   if ( m_data.toIMAP )
+   {
+      // we don't have to do anything, the folders will be created when we
+      // access them for the first time
+      return true;
+   }
+
+   // ensure that the directory where we're going to create our files exists
+   const String& dir = m_data.dstLocal.root;
+   if ( !dir.empty() &&
+         !wxFileName::Mkdir(dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL) )
+   {
+      wxLogError(_("Can't create the directory for the mailbox files.\n"
+                   "\n"
+                   "Migration aborted"));
+
+      return false;
+   }
+
+   // create the directories for all folders having subfolders now as the
+   // folders are copied in parallel and so the subfolder could be copied
+   // before its parent otherwise
+   const bool isMH = GetDstType() == MF_MH;
+   for ( int n = 0; n < m_data.countFolders; n++ )
+   {
+      const int flags = m_data.folderFlags[n];
+      if ( !(flags & ASMailFolder::ATT_NOSELECT) )
+      {
+         // the MH folders are directories created by c-client anyhow and
+         // the other ones only need a directory for their subfolders
+         if ( isMH || (flags & ASMailFolder::ATT_NOINFERIORS) )
+            continue;
+      }
+
+      const String& name = m_data.folderNames[n];
+      const String path = GetDstNameForSource(name);
+      if ( !wxFileName::Mkdir(path, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL) )
+      {
+         // it's not a fatal error (no messages lost...) but still worth
+         // noting
+         wxLogWarning(_("Failed to create directory \"%s\" for folder \"%s\""),
+                      path, name);
+      }
+   }
+
+   return true;
+}
+
+MigrateEngine::FolderCopy *MigrateEngine::StartFolder(int n)
+{
+   const String& name = m_data.folderNames[n];
+   const int flags = m_data.folderFlags[n];
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.folderCurrent = GetFullSourceName(name);
+   }
+
+   // is this a "file" or a "directory"? in the latter case, it had been
+   // already created by PrepareDst()
+   if ( flags & ASMailFolder::ATT_NOSELECT )
+   {
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.foldersDone++;
+
+      return NULL;
+   }
+
+   // open the source folder
+   MailFolder *mfSrc = OpenSource(name);
+   if ( !mfSrc )
+   {
+      wxLogError(_("Failed to open source folder \"%s\""), name);
+
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.foldersDone++;
+      m_stats.foldersFailed++;
+
+      return NULL;
+   }
+
+   // don't create the target folder if the destination is empty and has
+   // subfolders: i.e. we do create empty folders if they contain messages only
+   // but we want to avoid creating empty "folder.messages" files if we have a
+   // "folder" directory
+   const unsigned long count = mfSrc->GetMessageCount();
+   if ( !(flags & ASMailFolder::ATT_NOINFERIORS) && !count )
+   {
+      mfSrc->DecRef();
+
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.foldersDone++;
+
+      return NULL;
+   }
+
+   // create the folder to save the messages to
+   MFolder_obj folderDst(GetDstFolder(name, flags));
+   MailFolder *mfDst = MailFolder::OpenFolder(folderDst);
+   if ( !mfDst )
+   {
+      wxLogError(_("Failed to create the target folder \"%s\""), name);
+
+      mfSrc->DecRef();
+
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.foldersDone++;
+      m_stats.foldersFailed++;
+
+      return NULL;
+   }
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.countMessages += count;
+   }
+
+   FolderCopy *copy = new FolderCopy;
+   copy->name = name;
+   copy->mfSrc = mfSrc;
+   copy->mfDst = mfDst;
+   copy->ok = false;
+
+   return copy;
+}
+
+void MigrateEngine::CopyFolder(FolderCopy *copy)
+{
+   copy->ok = DoCopyFolder(copy);
+
+   wxMutexLocker lock(m_mutex);
+
+   m_copiesDone.push_back(copy);
+
+   m_condDone.Signal();
+}
+
+bool MigrateEngine::DoCopyFolder(FolderCopy *copy)
+{
+   MailFolder * const mfSrc = copy->mfSrc;
+   MailFolder * const mfDst = copy->mfDst;
+
+   // find the messages which had been already copied before
+   const UIdType uidValidity = mfSrc->GetUIdValidity();
+
+   std::set<UIdType> uidsDone;
+   if ( m_useJournal && uidValidity != UID_ILLEGAL )
+   {
+      m_journal.GetCopied(copy->name, uidValidity, uidsDone);
+   }
+
+   std::set<String> idsDst;
+   if ( m_data.skipDuplicates && mfDst->GetMessageCount() )
+   {
+      HeaderInfoList_obj headersDst(mfDst->GetHeaders());
+      const MsgnoType countDst = headersDst ? headersDst->Count() : 0;
+      for ( MsgnoType n = 0; n < countDst; n++ )
+      {
+         HeaderInfo *hi = headersDst->GetItemByIndex(n);
+         if ( hi && !hi->GetId().empty() )
+            idsDst.insert(hi->GetId());
+      }
+   }
+
+   // and collect the UIDs of all the other ones
+   UIdArray uids;
+   unsigned long skipped = 0,
+                 duplicate = 0,
+                 failed = 0;
+
+   HeaderInfoList_obj headers(mfSrc->GetHeaders());
+   const MsgnoType count = headers ? headers->Count() : 0;
+   for ( MsgnoType n = 0; n < count; n++ )
+   {
+      HeaderInfo *hi = headers->GetItemByIndex(n);
+      if ( !hi )
+      {
+         wxLogError(_("Failed to retrieve header for message %lu"),
+                    (unsigned long)n);
+         failed++;
+         continue;
+      }
+
+      const UIdType uid = hi->GetUId();
+      if ( uidsDone.count(uid) )
+      {
+         skipped++;
+      }
+      else if ( !hi->GetId().empty() && idsDst.count(hi->GetId()) )
+      {
+         duplicate++;
+      }
+      else
+      {
+         uids.Add(uid);
+      }
+   }
+
+   bool ok = !failed;
+   if ( !UpdateMessageStats(0, skipped, duplicate, failed) )
+      return ok;
+
+   // now copy them in batches
+   const size_t countToCopy = uids.GetCount();
+   const size_t batchSize = m_data.batchSize ? m_data.batchSize : 1;
+   for ( size_t start = 0; start < countToCopy; start += batchSize )
+   {
+      UIdArray batch;
+      const size_t end = wxMin(start + batchSize, countToCopy);
+      batch.Alloc(end - start);
+      for ( size_t n = start; n < end; n++ )
+      {
+         batch.Add(uids[n]);
+      }
+
+      UIdArray uidsFailed;
+      if ( !mfDst->AppendMessages(mfSrc, batch, NULL, &uidsFailed) )
+      {
+         wxLogError(_("Failed to copy some messages from folder \"%s\""),
+                    GetFullSourceName(copy->name));
+
+         ok = false;
+
+         // we can't know which messages were copied then, so don't remember
+         // any of them
+         if ( uidsFailed.IsEmpty() )
+            uidsFailed = batch;
+      }
+
+      for ( size_t n = 0; n < uidsFailed.GetCount(); n++ )
+      {
+         batch.Remove(uidsFailed[n]);
+      }
+
+      if ( m_useJournal && uidValidity != UID_ILLEGAL && !batch.IsEmpty() )
+      {
+         if ( !m_journal.AddCopied(copy->name, uidValidity, batch) )
+         {
+            wxLogDebug(_T("Failed to update migration journal for \"%s\"."),
+                       copy->name);
+         }
+      }
+
+      if ( !UpdateMessageStats(batch.GetCount(), 0, 0, uidsFailed.GetCount()) )
+         break;
+   }
+
+   return ok;
+}
+
+void MigrateEngine::FinishFolder(FolderCopy *copy)
+{
+   // it's important to close the destination folder first to commit all
+   // changes to it
+   copy->mfDst->DecRef();
+   copy->mfSrc->DecRef();
+
+   {
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.foldersDone++;
+      if ( !copy->ok )
+         m_stats.foldersFailed++;
+   }
+
+   if ( !copy->ok )
+   {
+      wxLogError(_("Failed to copy messages from folder \"%s\""),
+                 GetFullSourceName(copy->name));
+   }
+
+   delete copy;
+}
+
+size_t MigrateEngine::FinishDoneFolders()
+{
+   std::vector<FolderCopy *> copies;
+   {
+      wxMutexLocker lock(m_mutex);
+
+      copies.swap(m_copiesDone);
+   }
+
+   for ( size_t n = 0; n < copies.size(); n++ )
+   {
+      FinishFolder(copies[n]);
+   }
+
+   return copies.size();
+}
+
+bool MigrateEngine::UpdateMessageStats(unsigned long copied,
+                                       unsigned long skipped,
+                                       unsigned long duplicate,
+                                       unsigned long failed)
+{
+   {
+      wxMutexLocker lock(m_mutex);
+
+      m_stats.messagesCopied += copied;
+      m_stats.messagesSkipped += skipped;
+      m_stats.messagesDuplicate += duplicate;
+      m_stats.messagesFailed += failed;
+   }
+
+   // when copying in the main thread, this is our only chance to update the
+   // progress, otherwise Run() does it
+   if ( wxThread::IsMain() && !ReportProgress() )
+      return false;
+
+   return !IsCancelled();
+}
+
+bool MigrateEngine::ReportProgress()
+{
+   if ( !IsCancelled() && m_progress )
+   {
+      MigrateStats stats;
+      {
+         wxMutexLocker lock(m_mutex);
+
+         stats = m_stats;
+      }
+
+      if ( !m_progress->OnProgress(stats) )
+         wxAtomicInc(m_cancelled);
+   }
+
+   return !IsCancelled();
+}
+
+bool MigrateEngine::Run()
+{
+   if ( m_data.countFolders == -1 && !ListFolders(m_data) )
+   {
+      wxLogError(_("Failed to retrieve the list of folders to migrate."));
+
+      return false;
+   }
+
+   m_stats.countFolders = m_data.countFolders;
+
+   if ( !PrepareDst() )
+      return false;
+
+   // failing to use the journal is not fatal, we just won't be able to resume
+   m_useJournal = m_data.useJournal && m_journal.Open(m_data);
+
+   wxStopWatch sw;
+
+#if wxUSE_THREADS
+   const size_t maxRunning = m_data.maxConnections > 0 ? m_data.maxConnections
+                                                       : 1;
+
+   // use the global pool and the same key as ASMailFolder for the source
+   // folder, so that if the user opens it in the GUI meanwhile, the main
+   // thread waits for us to finish with it before accessing it (notice that
+   // the pool also limits the number of connections to the source server)
+   MailThreadPool * const pool = MailThreadPool::Get();
+   const String serverSrc = m_data.fromIMAP ? m_data.source.server : String();
+#else // !wxUSE_THREADS
+   const size_t maxRunning = 1;
+#endif // wxUSE_THREADS/!wxUSE_THREADS
+
+   size_t countRunning = 0;
+   for ( int next = 0; ; )
+   {
+      // start copying as many folders as we can
+      while ( next < m_data.countFolders &&
+               countRunning < maxRunning &&
+                  !IsCancelled() )
+      {
+         FolderCopy *copy = StartFolder(next++);
+         if ( !copy )
+            continue;
+
+         countRunning++;
+
+#if wxUSE_THREADS
+         // take the task id from the same sequence as ASMailFolder tickets
+         // as they share the pool and CancelTicket() mustn't cancel our task
+         const MailFolder * const mf = copy->mfSrc;
+         pool->Queue(new CopyTask(*this, copy), ASMailFolder::GetTicket(),
+                     mf, serverSrc);
+#else // !wxUSE_THREADS
+         CopyFolder(copy);
+#endif // wxUSE_THREADS/!wxUSE_THREADS
+      }
+
+      countRunning -= FinishDoneFolders();
+
+      ReportProgress();
+
+      if ( !countRunning && (next == m_data.countFolders || IsCancelled()) )
+         break;
+
+#if wxUSE_THREADS
+      // wait until some folder is done but update the progress regularly,
+      // the workers can't do anything without the mail lock, so release it
+      // while waiting (and reacquire it only after unlocking m_mutex)
+      MailUnlocker unlockMail;
+
+      wxMutexLocker lock(m_mutex);
+      if ( m_copiesDone.empty() )
+         m_condDone.WaitTimeout(100);
+#endif // wxUSE_THREADS
+   }
+
+   wxLogDebug(_T("Migrated %d folders (%d failed) in %ld ms: %lu messages "
+                 "copied, %lu skipped, %lu duplicate, %lu failed."),
+              m_stats.foldersDone, m_stats.foldersFailed, sw.Time(),
+              m_stats.messagesCopied, m_stats.messagesSkipped,
+              m_stats.messagesDuplicate, m_stats.messagesFailed);
+
+   // the journal is not needed any more once everything was copied
+   if ( m_useJournal && !IsCancelled() && !m_stats.foldersFailed )
+      m_journal.Remove();
+
+   return true;
+}
+
+// ============================================================================
+// GUI classes implementation
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// IMAPServerPanel
+// ----------------------------------------------------------------------------
+
+BEGIN_EVENT_TABLE(IMAPServerPanel, wxEnhancedPanel)
+   EVT_TEXT(-1, IMAPServerPanel::OnText)
+END_EVENT_TABLE()
+
+IMAPServerPanel::IMAPServerPanel(wxWindow *parent, MigrateImapServer *imapData)
+               : wxEnhancedPanel(parent)
+{
+   m_imapData = imapData;
+   m_folder = NULL;
+   m_isDirty = false;
+
+   // the controls data
+   enum Fields
+   {
+      Label_Server,
+      Label_Root,
+      Label_Login,
+      Label_Password,
+#ifdef USE_SSL
+      Label_SSL,
+#endif // USE_SSL
+      Label_Max
+   };
+
+   wxArrayString labels;
+   labels.Add(_("&Server:"));
+   labels.Add(_("&Root folder:"));
+   labels.Add(_("&User name:"));
+   labels.Add(_("&Password:"));
+#ifdef USE_SSL
+   labels.Add(_("Use SS&L"));
+#endif // USE_SSL
+
+   // check that we didn't forget to update something
+   ASSERT_MSG( labels.GetCount() == Label_Max, _T("label count mismatch") );
+
+   const long widthMax = GetMaxLabelWidth(labels, this);
+
+   // create the controls: server and the root folder to use on it
+   m_textServer = CreateFolderEntry(labels[Label_Server], widthMax, NULL,
+                                    &m_btnFolder);
+   m_textRoot = CreateTextWithLabel(labels[Label_Root], widthMax, m_textServer);
+
+   // the authentication parameters
+   m_textLogin = CreateTextWithLabel(labels[Label_Login], widthMax, m_textRoot);
+   m_textPass = CreateTextWithLabel(labels[Label_Password], widthMax,
+                                    m_textLogin, 0, wxTE_PASSWORD);
+
+#ifdef USE_SSL
+   m_chkSSL = CreateCheckBox(labels[Label_SSL], widthMax, m_textPass);
+#endif // USE_SSL
+}
+
+IMAPServerPanel::~IMAPServerPanel()
+{
+   if ( m_folder )
+      m_folder->DecRef();
+}
+
+bool IMAPServerPanel::TransferDataToWindow()
+{
+   CHECK( m_imapData, false, _T("no data in IMAPServerPanel") );
+
+   String server = m_imapData->server;
+   if ( m_imapData->port != -1 )
+   {
+      server += String::Format(_T(":%d"), m_imapData->port);
+   }
+
+   m_textServer->SetValue(server);
+
+   m_textRoot->SetValue(m_imapData->root);
+   m_textLogin->SetValue(m_imapData->username);
+   m_textPass->SetValue(m_imapData->password);
+
+#ifdef USE_SSL
+   m_chkSSL->SetValue(m_imapData->useSSL);
+#endif // USE_SSL
+
+   UpdateForwardBtnUI();
+
+   return true;
+}
+
+bool IMAPServerPanel::TransferDataFromWindow()
+{
+   // extract the host name and the port from the provided string
+   String server = m_textServer->GetValue();
+   const size_t posColon = server.find(_T(':'));
+   if ( posColon != String::npos )
+   {
+      const String port = server.substr(posColon);
+
+      unsigned long l;
+      if ( !port.ToULong(&l) || l > INT_MAX )
+      {
+         wxLogError(_("Invalid port specification: %s"), port);
+
+         return false;
+      }
+
+      if ( (unsigned long)m_imapData->port != l )
+      {
+         // cast is safe because of the check above
+         m_imapData->port = (int)l;
+
+         m_isDirty = true;
+      }
+
+      // remove the port pat from the host string
+      server.erase(posColon);
    }
 
    if ( m_imapData->server != server )
@@ -1177,518 +2329,189 @@ MigrateWizardConfirmPage::MigrateWizardConfirmPage(MigrateWizard *parent)
                            BuildMsg(parent)
                           )
 {
-}
-
-String
-MigrateWizardConfirmPage::BuildMsg(MigrateWizard *parent) const
-{
-   const MigrateData& data = parent->Data();
-
-   String msg;
-
-   msg.Printf(_("About to start copying %d folders from the\n"
-                "server %s"),
-              data.countFolders, data.source.server);
-
-   const String& rootSrc = data.source.root;
-   if ( !rootSrc.empty() )
-      msg += String::Format(_(" (under %s only)"), rootSrc);
-
-   msg += _T('\n');
-
-   if ( data.toIMAP )
-   {
-      msg += String::Format
-             (
-               _("to the IMAP server\n%s"),
-               data.dstIMAP.server
-             );
-
-      const String& rootDst = data.dstIMAP.root;
-      if ( !rootDst.empty() )
-         msg += String::Format(_(" (under %s)"), rootDst);
-
-      msg += _T('\n');
-   }
-   else
-   {
-      msg += String::Format
-             (
-               _("to the files in %s format under the\n"
-                 "directory \"%s\""),
-               LocalPanel::GetFormatName(data.dstLocal.format),
-               data.dstLocal.root
-             );
-   }
-
-   msg += _("\n\nPlease press \"Next\" to continue, \"Back\" to\n"
-            "modify the migration parameters\n"
-            "or \"Cancel\" to abort the operation.");
-
-   return msg;
-}
-
-// ----------------------------------------------------------------------------
-// MigrateWizardProgressPage
-// ----------------------------------------------------------------------------
-
-BEGIN_EVENT_TABLE(MigrateWizardProgressPage, MigrateWizardPage)
-   EVT_SHOW(MigrateWizardProgressPage::OnShow)
-
-   EVT_BUTTON(wxID_OK, MigrateWizardProgressPage::OnButtonOk)
-   EVT_BUTTON(wxID_CANCEL, MigrateWizardProgressPage::OnButtonCancel)
-END_EVENT_TABLE()
-
-MigrateWizardProgressPage::MigrateWizardProgressPage(MigrateWizard *parent)
-                         : MigrateWizardPage
-                           (
-                              parent,
-                              MigrateWizard::Page_Progress
-                           )
-{
-   m_continue = true;
-
-   // create the GUI controls
-   wxSizer *sizer = new wxBoxSizer(wxVERTICAL);
-   sizer->Add
-          (
-            new wxStaticText
-                (
-                  this,
-                  -1,
-                  _("You may press \"Abort\" at any moment to\n"
-                    "abort the migration but please be warned that\n"
-                    "it will be impossible to resume it later.")
-                ),
-            0,
-            wxALL,
-            LAYOUT_X_MARGIN
-          );
-
-   sizer->Add(0, 2*LAYOUT_Y_MARGIN);
-
-   m_labelFolder = new wxStaticText(this, -1, wxEmptyString);
-   sizer->Add(m_labelFolder, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
-
-   m_gaugeFolder = new wxGauge(this, -1, Data().countFolders,
-                               wxDefaultPosition, wxDefaultSize,
-                               wxGA_HORIZONTAL | wxGA_SMOOTH);
-   sizer->Add(m_gaugeFolder, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
-
-   m_labelMsg = new wxStaticText(this, -1, wxEmptyString);
-   sizer->Add(m_labelMsg, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
-
-   m_gaugeMsg = new wxGauge(this, -1, 0, // range will be set later
-                            wxDefaultPosition, wxDefaultSize,
-                            wxGA_HORIZONTAL | wxGA_SMOOTH);
-   sizer->Add(m_gaugeMsg, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
-
-   sizer->Add(0, 4*LAYOUT_Y_MARGIN);
-
-   m_btnAbort = new wxButton(this, wxID_CANCEL, _("&Abort"));
-   sizer->Add(m_btnAbort,
-              0, wxALL | wxALIGN_CENTER_HORIZONTAL, LAYOUT_X_MARGIN);
-
-   sizer->Add(0, 4*LAYOUT_Y_MARGIN);
-
-   m_labelStatus = new wxStaticText(this, -1, _("Working..."),
-                                    wxDefaultPosition, wxDefaultSize,
-                                    wxALIGN_CENTRE);
-   sizer->Add(m_labelStatus, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
-
-   SetSizer(sizer);
-}
-
-bool MigrateWizardProgressPage::UpdateMessageProgress()
-{
-   m_labelMsg->SetLabel
-               (
-                  wxString::Format
-                  (
-                     _("Message: %d/%d"),
-                     m_nMessage + 1,
-                     m_countMessages
-                  )
-               );
-
-   m_gaugeMsg->SetValue(m_nMessage);
-
-   wxYield();
-
-   return m_continue;
-}
-
-bool MigrateWizardProgressPage::UpdateFolderProgress()
-{
-   String fullname = Data().source.root,
-          name = Data().folderNames[m_nFolder];
-
-   if ( !fullname.empty() && !name.empty() )
-      fullname += Data().source.delimiter;
-
-   fullname += name;
-
-   m_labelFolder->SetLabel
-                  (
-                     wxString::Format
-                     (
-                        _("Folder: %d/%d (%s)"),
-                        m_nFolder + 1,
-                        Data().countFolders,
-                        fullname
-                     )
-                  );
-
-   m_gaugeFolder->SetValue(m_nFolder);
-
-   wxYield();
-
-   return m_continue;
-}
-
-bool MigrateWizardProgressPage::UpdateStatus(const String& msg)
-{
-   // we need to relayout because the size of the control changed and it must
-   // be recentred
-   m_labelStatus->SetLabel(msg);
-
-   Layout();
-
-   wxYield();
-
-   return m_continue;
-}
-
-void MigrateWizardProgressPage::EnableWizardButtons(bool enable)
-{
-   // when we (re)enable the buttons, only "Finish" still makes sense, but when
-   // we disable them, we want to disable all of them
-   EnableButtons(enable ? MigrateWizard::Btn_Next
-                        : MigrateWizard::Btn_All, enable);
-}
-
-MailFolder *
-MigrateWizardProgressPage::OpenSource(const MigrateImapServer& imapData,
-                                      const String& name)
-{
-   MFolder_obj folderSrc(MFolder::CreateTemp(wxEmptyString, MF_IMAP));
-   CHECK( folderSrc, NULL, _T("MFolder::CreateTemp() failed?") );
-
-   folderSrc->SetServer(imapData.server);
-
-   String path = imapData.root;
-   if ( !name.empty() )
-   {
-      path << Data().source.delimiter << name;
-   }
-   folderSrc->SetPath(path);
-
-   folderSrc->SetAuthInfo(imapData.username, imapData.password);
-
-#ifdef USE_SSL
-   if ( imapData.useSSL )
-   {
-      folderSrc->SetSSL(SSLSupport_SSL, SSLCert_AcceptUnsigned);
-   }
-#endif // USE_SSL
-
-   return MailFolder::OpenFolder(folderSrc, MailFolder::ReadOnly);
-}
-
-MFolderType
-MigrateWizardProgressPage::GetDstType() const
-{
-   MFolderType folderType;
-   if ( Data().toIMAP )
-   {
-      folderType = MF_IMAP;
-   }
-   else // file, but which?
-   {
-      folderType = Data().dstLocal.format == FileMbox_Max ? MF_MH : MF_FILE;
-   }
-
-   return folderType;
-}
-
-String
-MigrateWizardProgressPage::GetDstNameForSource(const String& name)
-{
-   // when we start from source folder foo we want the target folder for foo to
-   // be named foo (and not have empty name) so always append source.root to
-   // the path
-   String path = Data().dstLocal.root,
-          rootSrc = Data().source.root;
-
-   const char delimiterSrc = Data().source.delimiter;
-
-   if ( !rootSrc.empty() )
-   {
-      if ( !path.empty() )
-         path += delimiterSrc;
-
-      path += rootSrc;
-   }
-
-   if ( !name.empty() )
-   {
-      if ( !path.empty() )
-         path += delimiterSrc;
-
-      path += name;
-   }
-
-   // make it into the dst path: it can have different delimiter
-   for ( size_t n = 0; n < path.length(); n++ )
-   {
-      if ( path[n] == delimiterSrc )
-      {
-         if ( !Data().delimiterDst )
-         {
-            MFolder_obj folderDst(MFolder::CreateTemp(wxEmptyString, GetDstType()));
-            SetAccessParameters(folderDst);
+}
 
-            Data().delimiterDst = MailFolder::GetFolderDelimiter(folderDst);
+String
+MigrateWizardConfirmPage::BuildMsg(MigrateWizard *parent) const
+{
+   const MigrateData& data = parent->Data();
 
-            if ( Data().delimiterDst == delimiterSrc )
-            {
-               // nothing to do, finally!
-               break;
-            }
-         }
+   String msg;
 
-         path[n] = Data().delimiterDst;
-      }
-   }
+   msg.Printf(_("About to start copying %d folders from the\n"
+                "server %s"),
+              data.countFolders, data.source.server);
 
-   return path;
-}
+   const String& rootSrc = data.source.root;
+   if ( !rootSrc.empty() )
+      msg += String::Format(_(" (under %s only)"), rootSrc);
 
-MFolder *
-MigrateWizardProgressPage::GetDstFolder(const String& name, int flags)
-{
-   // which kind of folder are we going to create?
-   MFolderType folderType = GetDstType();
-   MFolder *folderDst = MFolder::CreateTemp(wxEmptyString, folderType);
-   CHECK( folderDst, NULL, _T("MFolder::CreateTemp() failed?") );
+   msg += _T('\n');
 
-   if ( folderType == MF_FILE )
+   if ( data.toIMAP )
    {
-      folderDst->SetFileMboxFormat(Data().dstLocal.format);
-   }
-
-   String path = GetDstNameForSource(name);
+      msg += String::Format
+             (
+               _("to the IMAP server\n%s"),
+               data.dstIMAP.server
+             );
 
-   // there is a complication here: although IMAP folders may (depending on
-   // server) contain both messages and subfolders, this is impossible with
-   // MBOX and MBX folders (although ok with MH) and the way we deal with this
-   // is to put the messages in a file named "folder.messages"
-   if ( folderType == MF_FILE )
-   {
-      if ( !(flags & ASMailFolder::ATT_NOINFERIORS) )
-      {
-         // create a subdirectory for the subfolders if it doesn't exist yet
-         if ( !wxDirExists(path) && !wxMkdir(path) )
-         {
-            wxLogWarning(_("Failed to create directory \"%s\" for folder \"%s\""),
-                         path, name);
-         }
+      const String& rootDst = data.dstIMAP.root;
+      if ( !rootDst.empty() )
+         msg += String::Format(_(" (under %s)"), rootDst);
 
-         // and modify the name for the file itself
-         path += MESSAGES_SUFFIX;
-      }
+      msg += _T('\n');
    }
-   else // MF_IMAP
+   else
    {
-      // TODO: some IMAP servers do support folders which have both messages
-      //       and subfolders, we should test for this -- but for now we
-      //       suppose the worst case
-      if ( !(flags & ASMailFolder::ATT_NOINFERIORS) )
-      {
-         path += MESSAGES_SUFFIX;
-      }
-
-      SetAccessParameters(folderDst);
+      msg += String::Format
+             (
+               _("to the files in %s format under the\n"
+                 "directory \"%s\""),
+               LocalPanel::GetFormatName(data.dstLocal.format),
+               data.dstLocal.root
+             );
    }
 
-   folderDst->SetPath(path);
+   msg += _("\n\nPlease press \"Next\" to continue, \"Back\" to\n"
+            "modify the migration parameters\n"
+            "or \"Cancel\" to abort the operation.");
 
-   return folderDst;
+   return msg;
 }
 
-void
-MigrateWizardProgressPage::SetAccessParameters(MFolder *folderDst)
-{
-   CHECK_RET( folderDst, _T("NULL folder in SetAccessParameters") );
+// ----------------------------------------------------------------------------
+// MigrateWizardProgressPage
+// ----------------------------------------------------------------------------
 
-   if ( folderDst->GetType() == MF_IMAP )
-   {
-      const MigrateImapServer& dstIMAP = Data().dstIMAP;
-      folderDst->SetServer(dstIMAP.server);
-      folderDst->SetAuthInfo(dstIMAP.username, dstIMAP.password);
+BEGIN_EVENT_TABLE(MigrateWizardProgressPage, MigrateWizardPage)
+   EVT_SHOW(MigrateWizardProgressPage::OnShow)
 
-#ifdef USE_SSL
-      folderDst->SetSSL(dstIMAP.useSSL ? SSLSupport_SSL : SSLSupport_None,
-                        SSLCert_AcceptUnsigned);
-#endif // USE_SSL
-   }
-}
+   EVT_BUTTON(wxID_OK, MigrateWizardProgressPage::OnButtonOk)
+   EVT_BUTTON(wxID_CANCEL, MigrateWizardProgressPage::OnButtonCancel)
+END_EVENT_TABLE()
 
-bool
-MigrateWizardProgressPage::CopyMessages(MailFolder *mfSrc, MFolder *folderDst)
+MigrateWizardProgressPage::MigrateWizardProgressPage(MigrateWizard *parent)
+                         : MigrateWizardPage
+                           (
+                              parent,
+                              MigrateWizard::Page_Progress
+                           )
 {
-   UIdArray uids;
-   uids.Add(UID_ILLEGAL);
+   m_continue = true;
 
-   HeaderInfoList_obj headers(mfSrc->GetHeaders());
+   // create the GUI controls
+   wxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+   sizer->Add
+          (
+            new wxStaticText
+                (
+                  this,
+                  -1,
+                  _("You may press \"Abort\" at any moment to\n"
+                    "abort the migration: it will be resumed from\n"
+                    "where it stopped when you run it again.")
+                ),
+            0,
+            wxALL,
+            LAYOUT_X_MARGIN
+          );
 
-   m_countMessages = headers->Count();
-   m_gaugeMsg->SetRange(m_countMessages);
+   sizer->Add(0, 2*LAYOUT_Y_MARGIN);
 
-   for ( m_nMessage = 0; m_nMessage < m_countMessages; m_nMessage++ )
-   {
-      if ( !UpdateMessageProgress() )
-      {
-         // cancelled
-         return true;
-      }
+   m_labelFolder = new wxStaticText(this, -1, wxEmptyString);
+   sizer->Add(m_labelFolder, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
 
-      HeaderInfo *hi = headers->GetItemByIndex(m_nMessage);
-      if ( !hi )
-      {
-         wxLogError(_("Failed to retrieve header for message %d"),
-                    m_nMessage);
-         continue;
-      }
+   m_gaugeFolder = new wxGauge(this, -1, Data().countFolders,
+                               wxDefaultPosition, wxDefaultSize,
+                               wxGA_HORIZONTAL | wxGA_SMOOTH);
+   sizer->Add(m_gaugeFolder, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
 
-      uids[0] = hi->GetUId();
-      if ( !mfSrc->SaveMessages(&uids, folderDst) )
-      {
-         wxLogError(_("Failed to copy the message %d from folder \"%s\""),
-                    m_nMessage,
-                    Data().folderNames[m_nFolder]);
+   m_labelMsg = new wxStaticText(this, -1, wxEmptyString);
+   sizer->Add(m_labelMsg, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
 
-         return false;
-      }
-   }
+   m_gaugeMsg = new wxGauge(this, -1, 0, // range will be set later
+                            wxDefaultPosition, wxDefaultSize,
+                            wxGA_HORIZONTAL | wxGA_SMOOTH);
+   sizer->Add(m_gaugeMsg, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
 
-   return true;
-}
+   sizer->Add(0, 4*LAYOUT_Y_MARGIN);
 
-bool MigrateWizardProgressPage::CreateDstDirectory(const String& name)
-{
-   if ( Data().toIMAP )
-   {
-      // we don't have to do anything, it will be created when we access the
-      // first subfolder of this folder (which will also be created
-      // automatically)
-      return true;
-   }
-   else // local file destination
-   {
-      // create a directory if it doesn't exist yet
-      const String dir = GetDstNameForSource(name);
-      return wxDirExists(dir) || wxMkdir(dir);
-   }
+   m_btnAbort = new wxButton(this, wxID_CANCEL, _("&Abort"));
+   sizer->Add(m_btnAbort,
+              0, wxALL | wxALIGN_CENTER_HORIZONTAL, LAYOUT_X_MARGIN);
+
+   sizer->Add(0, 4*LAYOUT_Y_MARGIN);
+
+   m_labelStatus = new wxStaticText(this, -1, _("Working..."),
+                                    wxDefaultPosition, wxDefaultSize,
+                                    wxALIGN_CENTRE);
+   sizer->Add(m_labelStatus, 0, wxALL | wxEXPAND, LAYOUT_X_MARGIN);
+
+   SetSizer(sizer);
 }
 
-bool MigrateWizardProgressPage::ProcessOneFolder(const String& name, int flags)
+bool MigrateWizardProgressPage::OnProgress(const MigrateStats& stats)
 {
-   // open the source folder
-   MailFolder_obj mf(OpenSource(Data().source, name));
-   if ( !mf )
-   {
-      wxLogError(_("Failed to open source folder \"%s\""), name);
+   m_labelFolder->SetLabel
+                  (
+                     wxString::Format
+                     (
+                        _("Folder: %d/%d (%s)"),
+                        stats.foldersDone,
+                        stats.countFolders,
+                        stats.folderCurrent
+                     )
+                  );
 
-      return false;
-   }
+   m_gaugeFolder->SetValue(stats.foldersDone);
 
-   // don't create the target folder if the destination is empty and has
-   // subfolders: i.e. we do create empty folders if they contain messages only
-   // but we want to avoid creating empty "folder.messages" files if we have a
-   // "folder" directory
-   if ( !(flags & ASMailFolder::ATT_NOINFERIORS) && !mf->GetMessageCount() )
-   {
-      // nothing to do
-      return true;
-   }
+   const unsigned long countDone = stats.GetMessagesDone();
+   m_labelMsg->SetLabel
+               (
+                  wxString::Format
+                  (
+                     _("Message: %lu/%lu"),
+                     countDone,
+                     stats.countMessages
+                  )
+               );
 
-   // create the folder to save the messages to
-   MFolder_obj folderDst(GetDstFolder(name, flags));
-   MailFolder_obj mfDst(MailFolder::OpenFolder(folderDst));
-   if ( !mfDst )
-   {
-      wxLogError(_("Failed to create the target folder \"%s\""), name);
+   m_gaugeMsg->SetRange(stats.countMessages);
+   m_gaugeMsg->SetValue(countDone);
 
-      return false;
-   }
+   wxYield();
 
-   // now copy all the messages from src to dst
-   return CopyMessages(mf, folderDst);
+   return m_continue;
 }
 
-bool MigrateWizardProgressPage::ProcessAllFolders()
+bool MigrateWizardProgressPage::UpdateStatus(const String& msg)
 {
-   // ensure that the directory where we're going to create our files exists
-   if ( !Data().toIMAP )
-   {
-      const String& dir = Data().dstLocal.root;
-      if ( !dir.empty() && !wxDirExists(dir) )
-      {
-         if ( !wxMkdir(dir) )
-         {
-            wxLogError(_("Can't create the directory for the mailbox files.\n"
-                         "\n"
-                         "Migration aborted"));
-
-            return false;
-         }
-      }
-   }
-
-   for ( m_nFolder = 0, m_nErrors = 0;
-         m_nFolder < Data().countFolders;
-         m_nFolder++ )
-   {
-      if ( !UpdateFolderProgress() )
-      {
-         // cancelled
-         break;
-      }
+   // we need to relayout because the size of the control changed and it must
+   // be recentred
+   m_labelStatus->SetLabel(msg);
 
-      const String& name = Data().folderNames[m_nFolder];
+   Layout();
 
-      // is this a "file" or a "directory"?
-      if ( Data().folderFlags[m_nFolder] & ASMailFolder::ATT_NOSELECT )
-      {
-         // just create the corresponding directory or folder
-         if ( !CreateDstDirectory(name) )
-         {
-            // it's not a fatal error (no messages lost...) but still worth
-            // noting
-            wxLogWarning(_("Failed to copy the folder \"%s\""), name);
-         }
-      }
-      else // a "file"-like folder, copy the messages from it
-      {
-         if ( !ProcessOneFolder(name, Data().folderFlags[m_nFolder]) )
-         {
-            wxLogError(_("Failed to copy messages from folder \"%s\""),
-                       name);
+   wxYield();
 
-            m_nErrors++;
-         }
-      }
-   }
+   return m_continue;
+}
 
-   return true;
+void MigrateWizardProgressPage::EnableWizardButtons(bool enable)
+{
+   // when we (re)enable the buttons, only "Finish" still makes sense, but when
+   // we disable them, we want to disable all of them
+   EnableButtons(enable ? MigrateWizard::Btn_Next
+                        : MigrateWizard::Btn_All, enable);
 }
 
 void MigrateWizardProgressPage::DoMigration()
 {
    EnableWizardButtons(false);
 
-   bool ok = ProcessAllFolders();
+   MigrateEngine engine(Data(), this);
+   bool ok = engine.Run();
 
    // update the UI to show that we're done now
    m_btnAbort->Disable();
@@ -1698,26 +2521,37 @@ void MigrateWizardProgressPage::DoMigration()
    m_labelMsg->Disable();
    m_gaugeMsg->Disable();
 
+   const MigrateStats& stats = engine.GetStats();
+
    String msg;
    if ( !ok )
    {
       msg = _("Migration couldn't be done.");
    }
-   else if ( m_continue )
+   else if ( !engine.IsCancelled() )
    {
-      m_gaugeMsg->SetValue(m_countMessages);
+      m_gaugeMsg->SetValue(m_gaugeMsg->GetRange());
       m_gaugeFolder->SetValue(Data().countFolders);
 
-      if ( m_nErrors )
+      if ( stats.foldersFailed )
       {
          wxLogError(_("There were errors during the migration."));
 
-         msg.Printf(_("Done with %u error(s)"), m_nErrors);
+         msg.Printf(_("Done with %d error(s)"), stats.foldersFailed);
       }
       else
       {
          msg = _("Completed successfully.");
       }
+
+      const unsigned long countSkipped = stats.messagesSkipped +
+                                          stats.messagesDuplicate;
+      if ( countSkipped )
+      {
+         msg += _T('\n');
+         msg += wxString::Format(_("(%lu message(s) had been already copied)"),
+                                 countSkipped);
+      }
    }
    else // cancelled
    {
@@ -1753,9 +2587,10 @@ void MigrateWizardProgressPage::OnButtonOk(wxCommandEvent& /* event */)
 
 void MigrateWizardProgressPage::OnButtonCancel(wxCommandEvent& /* event */)
 {
-   if ( wxMessageBox(_("Warning: you won't be able to resume later!"
+   if ( wxMessageBox(_("The folders being copied now will be completed\n"
+                       "the next time you run the migration.\n"
                        "\n"
-                       "Are you still sure you want to abort?"),
+                       "Are you sure you want to abort?"),
                      _("Mahogany: Please confirm"),
                      wxYES_NO | wxICON_QUESTION | wxNO_DEFAULT) == wxYES )
    {
@@ -1870,46 +2705,7 @@ wxWizardPage *MigrateWizard::GetNextPage(Page page)
       {
          MProgressInfo progress(this, _("Accessing IMAP server..."));
 
-         MFolder_obj folderSrc(MFolder::CreateTemp(wxEmptyString, MF_IMAP));
-
-         const MigrateImapServer& imapData = Data().source;
-         folderSrc->SetServer(imapData.server);
-         folderSrc->SetPath(imapData.root);
-         folderSrc->SetAuthInfo(imapData.username, imapData.password);
-
-#ifdef USE_SSL
-         if ( imapData.useSSL )
-         {
-            // we don't have a separate checkbox for accepting unsigned SSL
-            // certs because of lack of space in the dialog but we do accept
-            // them here because always accepting them is better than never
-            // doing it
-            folderSrc->SetSSL(SSLSupport_SSL, SSLCert_AcceptUnsigned);
-         }
-#endif // USE_SSL
-
-         ASMailFolder *asmf = ASMailFolder::OpenFolder
-                              (
-                               folderSrc,
-                               MailFolder::HalfOpen
-                              );
-         if ( asmf )
-         {
-            Data().countFolders = 0;
-            m_doneWithList = false;
-
-            if ( ListAll(asmf) )
-            {
-               // process the events from ListFolders
-               do
-               {
-                  MEventManager::ForceDispatchPending();
-               }
-               while ( !m_doneWithList );
-            }
-
-            asmf->DecRef();
-         }
+         MigrateEngine::ListFolders(Data());
       }
 
       switch ( Data().countFolders )
@@ -1976,27 +2772,14 @@ bool MigrateWizard::HasPrevPage(wxWizardPage *page)
    return ((MigrateWizardPage *)page)->GetId() != Page_Source;
 }
 
-void
-MigrateWizard::OnListFolder(const String& path, wxChar delim, long flags)
-{
-   Data().AddFolder(path, delim, flags);
-}
-
-void
-MigrateWizard::OnNoMoreFolders()
-{
-   Data().FixFolderFlags();
-
-   m_doneWithList = true;
-}
-
 // ----------------------------------------------------------------------------
 // MigrateData implementation
 // ----------------------------------------------------------------------------
 
 void MigrateData::AddFolder(const String& path, char delim, long flags)
 {
-   source.delimiter = delim;
+   if ( fromIMAP )
+      source.delimiter = delim;
 
    // we abuse ATT_NOINFERIORS flag here to mean not only that the folder
    // doesn't have children but also to imply that a folder without this
@@ -2028,7 +2811,7 @@ void MigrateData::FixFolderFlags()
       }
       else // check if this folder is a child of some of the previous folders
       {
-         String parent = name.BeforeLast(source.delimiter);
+         String parent = name.BeforeLast(GetSourceDelimiter());
          if ( !parent.empty() )
          {
             idx = folderNames.Index(parent);
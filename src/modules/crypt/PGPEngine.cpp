@@ -34,6 +34,7 @@
 
 #include "modules/MCrypt.h"
 #include "gui/wxMDialogs.h"
+#include "GnuPGSession.h"
 
 #include <wx/textfile.h>
 #include <wx/process.h>
@@ -75,8 +76,55 @@ String ReadNumber(const wxChar *& pc)
    return String(start, pc - start);
 }
 
+// Lines received from GPG are normally encoded in UTF-8, but they may contain
+// bytes sequences invalid in UTF-8 in practice, see the comment in
+// PGPEngine::ExecCommand(), so convert them carefully.
+String FromGPGOutput(const std::string& line)
+{
+   static wxMBConvUTF8 nonStrictUTF8(wxMBConvUTF8::MAP_INVALID_UTF8_TO_OCTAL);
+
+   return String(line.c_str(), nonStrictUTF8);
+}
+
 } // anonymous namespace
 
+// ----------------------------------------------------------------------------
+// SigStatusParser: interprets the GnuPG status lines about the signatures
+// ----------------------------------------------------------------------------
+
+class SigStatusParser
+{
+public:
+   SigStatusParser(MCryptoEngineOutputLog *log)
+      : m_log(log)
+   {
+      m_lastNotationCritical = false;
+   }
+
+   /**
+     Process a single status line.
+
+     @param code the status keyword, e.g. "GOODSIG"
+     @param pc the rest of the status line following the keyword
+     @param status updated with the result of the signature check
+     @return true if the line was processed or false if it's not about the
+             signatures
+    */
+   bool Process(const String& code,
+                const wxChar *pc,
+                MCryptoEngine::Status& status);
+
+private:
+   MCryptoEngineOutputLog * const m_log;
+
+   // the value of the last NOTATION_NAME line, if any, and whether it's
+   // critical
+   wxString m_lastNotationName;
+   bool m_lastNotationCritical;
+
+   DECLARE_NO_COPY_CLASS(SigStatusParser)
+};
+
 // ----------------------------------------------------------------------------
 // PassphraseManager: this class can be used to remember the passphrases
 //                    instead of asking the user to reenter them again and
@@ -117,6 +165,28 @@ private:
    static UserPassMap m_map;
 };
 
+// ----------------------------------------------------------------------------
+// CachedSignature: the result of checking a signature remembered by PGPEngine
+// ----------------------------------------------------------------------------
+
+struct CachedSignature
+{
+   CachedSignature() { status = MCryptoEngine::MAX_ERROR; }
+
+   // the signed text: we only use the cached result if it's the same, as
+   // Message-IDs are not guaranteed to be unique
+   String message;
+
+   // the result of the check and the information from the log
+   MCryptoEngine::Status status;
+   String userID,
+          publicKey;
+   wxArrayString messages;
+};
+
+// the key of this map is the Message-ID and the signature text
+WX_DECLARE_STRING_HASH_MAP(CachedSignature, CachedSignaturesMap);
+
 // ----------------------------------------------------------------------------
 // PGPEngine class
 // ----------------------------------------------------------------------------
@@ -148,11 +218,15 @@ public:
                                           const String& signature,
                                           MCryptoEngineOutputLog *log);
 
+   virtual void VerifyDetachedSignatures(DetachedSignatures& sigs);
+
    virtual Status GetPublicKey(const String& pk,
                                const String& server,
                                MCryptoEngineOutputLog *log) const;
 
 protected:
+   PGPEngine() : m_session(wxEmptyString) { m_sigCacheSize = 0; }
+
    /**
       Executes PGP/GPG with messageIn on stdin and puts stdout into messageOut.
 
@@ -167,7 +241,48 @@ protected:
                       String& messageOut,
                       MCryptoEngineOutputLog *log);
 
+   /**
+      Verifies a single detached signature using ExecCommand().
+
+      This is used when GnuPGSession is not available.
+    */
+   Status DoVerifyDetachedSignature(const String& message,
+                                    const String& signature,
+                                    MCryptoEngineOutputLog *log);
+
+   /**
+      Get the result of checking the signature returned by GnuPGSession.
+
+      @param sig the signature checked by the session
+      @param log the object to place output log into, can't be NULL
+    */
+   Status GetSessionResult(const GnuPGSession::DetachedSignature& sig,
+                           MCryptoEngineOutputLog *log);
+
+   /**
+      @name Cache of the signatures checked so far.
+    */
+   //@{
+
+   /// Fill in the signature status from cache if possible, return true if ok
+   bool GetCachedSignature(DetachedSignature& sig) const;
+
+   /// Remember the result of checking the signature if it's worth doing it
+   void CacheSignature(const DetachedSignature& sig,
+                       const MCryptoEngineOutputLog& log);
+
+   //@}
+
 private:
+   // the session used for checking the signatures in batches
+   GnuPGSession m_session;
+
+   // the results of the signatures verifications done in this program session
+   CachedSignaturesMap m_sigCache;
+
+   // the approximate amount of memory used by m_sigCache
+   size_t m_sigCacheSize;
+
    DECLARE_CRYPTO_ENGINE(PGPEngine)
 };
 
@@ -336,10 +451,7 @@ PGPEngine::ExecCommand(const String& options,
    size_t lenIn = strlen(bufIn);
    const char *ptrIn = bufIn;
 
-   // the value of the last NOTATION_NAME line, if any, and whether it's
-   // critical
-   wxString lastNotationName;
-   bool lastNotationCritical = false;
+   SigStatusParser sigParser(log);
 
    bool outEof = false,
         errEof = false;
@@ -433,17 +545,9 @@ PGPEngine::ExecCommand(const String& options,
             if ( *pc )
                pc++; // skip the space/TAB
 
-            if ( code == _T("GOODSIG") ||
-                 code == _T("VALIDSIG") ||
-                 code == _T("SIG_ID") ||
-                 code == _T("DECRYPTION_OKAY") )
+            if ( sigParser.Process(code, pc, status) )
             {
-               if ( status != SIGNATURE_EXPIRED_ERROR )
-               {
-                  wxLogStatus(_("Valid signature from \"%s\""),
-                              log->GetUserID());
-                  status = OK;
-               }
+               // nothing else to do
             }
             else if ( code == _T("BADARMOR") )
             {
@@ -455,36 +559,6 @@ PGPEngine::ExecCommand(const String& options,
                // into the output
                messageOut = messageIn;
             }
-            else if ( code == _T("EXPSIG") || code == _T("EXPKEYSIG") )
-            {
-               wxLogWarning(_("Expired signature from \"%s\""), pc);
-
-               status = SIGNATURE_EXPIRED_ERROR;
-            }
-            else if ( code == _T("BADSIG") )
-            {
-               status = SIGNATURE_ERROR;
-            }
-            else if ( code == _T("ERRSIG") )
-            {
-               // TODO: analyze the last field
-               status = SIGNATURE_CHECK_ERROR;
-            }
-            else if ( code == _T("NODATA") )
-            {
-               status = NO_DATA_ERROR;
-            }
-            else if ( code.StartsWith(_T("TRUST_")) )
-            {
-               if ( code == _T("TRUST_UNDEFINED") ||
-                    code == _T("TRUST_NEVER") )
-               {
-                  status = SIGNATURE_UNTRUSTED_WARNING;
-                  wxLogStatus(_("Valid signature from (invalid) \"%s\""),
-                              log->GetUserID());
-               }
-               // else: "_MARGINAL, _FULLY and _ULTIMATE" do not trigger a warning
-            }
             else if ( code == _T("USERID_HINT") )
             {
                // skip the key id
@@ -567,12 +641,6 @@ PGPEngine::ExecCommand(const String& options,
                   FAIL_MSG( _T("unexpected GET_XXX") );
                }
             }
-            else if ( code == _T("NO_PUBKEY") )
-            {
-               log->SetPublicKey(pc);              // till the end of line
-
-               status = NONEXISTING_KEY_ERROR;
-            }
             else if ( code == _T("IMPORTED") )
             {
                const wxChar * const pSpace = wxStrchr(pc, _T(' '));
@@ -715,28 +783,6 @@ PGPEngine::ExecCommand(const String& options,
                                  "(%s) is available."), keys);
                }
             }
-            else if ( code == "NOTATION_NAME" )
-            {
-               lastNotationName = pc;
-               lastNotationCritical = false;
-            }
-            else if ( code == "NOTATION_FLAGS" )
-            {
-               if ( *pc == '1' )
-                  lastNotationCritical = true;
-
-               // we ignore the "human readable" flag because it's not clear
-               // how exactly should it be handled
-            }
-            else if ( code == "NOTATION_DATA" )
-            {
-               const wxString data(pc);
-               if ( lastNotationCritical )
-               {
-                  wxLogWarning(_("Critical notation in the signature: %s=%s"),
-                               lastNotationName, data);
-               }
-            }
             else if ( code == _T("END_DECRYPTION") ||
                       code == _T("GOODMDC") ||     // what does it mean?
                       code == _T("GOT_IT") ||
@@ -765,12 +811,6 @@ PGPEngine::ExecCommand(const String& options,
                         )
                     );
             }
-            // Extract user id used to sign
-            if ( log && (code == _T("GOODSIG") || code == _T("BADSIG")) )
-            {
-               String userId = String(pc).AfterFirst(' ');
-               log->SetUserID(userId);
-            }
          }
 #ifndef DEBUG // In non-debug mode, log only free-form output
          else // normal (free form) GPG output
@@ -802,6 +842,100 @@ PGPEngine::ExecCommand(const String& options,
    return status;
 }
 
+// ----------------------------------------------------------------------------
+// SigStatusParser
+// ----------------------------------------------------------------------------
+
+bool
+SigStatusParser::Process(const String& code,
+                         const wxChar *pc,
+                         MCryptoEngine::Status& status)
+{
+   if ( code == _T("GOODSIG") ||
+        code == _T("VALIDSIG") ||
+        code == _T("SIG_ID") ||
+        code == _T("DECRYPTION_OKAY") )
+   {
+      if ( status != MCryptoEngine::SIGNATURE_EXPIRED_ERROR )
+      {
+         wxLogStatus(_("Valid signature from \"%s\""),
+                     m_log->GetUserID());
+         status = MCryptoEngine::OK;
+      }
+   }
+   else if ( code == _T("EXPSIG") || code == _T("EXPKEYSIG") )
+   {
+      wxLogWarning(_("Expired signature from \"%s\""), pc);
+
+      status = MCryptoEngine::SIGNATURE_EXPIRED_ERROR;
+   }
+   else if ( code == _T("BADSIG") )
+   {
+      status = MCryptoEngine::SIGNATURE_ERROR;
+   }
+   else if ( code == _T("ERRSIG") )
+   {
+      // TODO: analyze the last field
+      status = MCryptoEngine::SIGNATURE_CHECK_ERROR;
+   }
+   else if ( code == _T("NODATA") )
+   {
+      status = MCryptoEngine::NO_DATA_ERROR;
+   }
+   else if ( code.StartsWith(_T("TRUST_")) )
+   {
+      if ( code == _T("TRUST_UNDEFINED") ||
+           code == _T("TRUST_NEVER") )
+      {
+         status = MCryptoEngine::SIGNATURE_UNTRUSTED_WARNING;
+         wxLogStatus(_("Valid signature from (invalid) \"%s\""),
+                     m_log->GetUserID());
+      }
+      // else: "_MARGINAL, _FULLY and _ULTIMATE" do not trigger a warning
+   }
+   else if ( code == _T("NO_PUBKEY") )
+   {
+      m_log->SetPublicKey(pc);              // till the end of line
+
+      status = MCryptoEngine::NONEXISTING_KEY_ERROR;
+   }
+   else if ( code == "NOTATION_NAME" )
+   {
+      m_lastNotationName = pc;
+      m_lastNotationCritical = false;
+   }
+   else if ( code == "NOTATION_FLAGS" )
+   {
+      if ( *pc == '1' )
+         m_lastNotationCritical = true;
+
+      // we ignore the "human readable" flag because it's not clear how
+      // exactly should it be handled
+   }
+   else if ( code == "NOTATION_DATA" )
+   {
+      const wxString data(pc);
+      if ( m_lastNotationCritical )
+      {
+         wxLogWarning(_("Critical notation in the signature: %s=%s"),
+                      m_lastNotationName, data);
+      }
+   }
+   else
+   {
+      return false;
+   }
+
+   // Extract user id used to sign
+   if ( m_log && (code == _T("GOODSIG") || code == _T("BADSIG")) )
+   {
+      String userId = String(pc).AfterFirst(' ');
+      m_log->SetUserID(userId);
+   }
+
+   return true;
+}
+
 // ----------------------------------------------------------------------------
 // PGPEngine: encryption
 // ----------------------------------------------------------------------------
@@ -893,6 +1027,109 @@ PGPEngine::Status
 PGPEngine::VerifyDetachedSignature(const String& message,
                                    const String& signature,
                                    MCryptoEngineOutputLog *log)
+{
+   DetachedSignatures sigs(1);
+   sigs[0].message = message;
+   sigs[0].signature = signature;
+   sigs[0].log = log;
+
+   VerifyDetachedSignatures(sigs);
+
+   return sigs[0].status;
+}
+
+void
+PGPEngine::VerifyDetachedSignatures(DetachedSignatures& sigs)
+{
+   // we don't need to check the signatures we had already checked
+   std::vector<DetachedSignature *> todo;
+   for ( DetachedSignatures::iterator i = sigs.begin(); i != sigs.end(); ++i )
+   {
+      if ( !GetCachedSignature(*i) )
+         todo.push_back(&*i);
+   }
+
+   if ( todo.empty() )
+      return;
+
+   // check all the remaining ones at once if we can
+   const String pgp = READ_APPCONFIG_TEXT(MP_PGP_COMMAND);
+
+   GnuPGSession::DetachedSignatures sessionSigs(todo.size());
+   bool inSession = false;
+   if ( !pgp.empty() && GnuPGSession::IsSupported() )
+   {
+      for ( size_t n = 0; n < todo.size(); n++ )
+      {
+         // the message contains the raw bytes of the signed part
+         const wxCharBuffer message(todo[n]->message.To8BitData());
+         sessionSigs[n].data.assign(message.data(), message.length());
+
+         const wxCharBuffer signature(todo[n]->signature.ToUTF8());
+         sessionSigs[n].signature.assign(signature.data(), signature.length());
+      }
+
+      m_session.SetCommand(pgp);
+      inSession = m_session.VerifyDetached(sessionSigs);
+   }
+
+   for ( size_t n = 0; n < todo.size(); n++ )
+   {
+      DetachedSignature& sig = *todo[n];
+
+      MCryptoEngineOutputLog logDummy(NULL);
+      MCryptoEngineOutputLog * const log = sig.log ? sig.log : &logDummy;
+
+      // if we couldn't run gpg ourselves, fall back to ExecCommand() which
+      // also proposes the user to configure its location if necessary
+      sig.status = inSession ? GetSessionResult(sessionSigs[n], log)
+                             : DoVerifyDetachedSignature(sig.message,
+                                                         sig.signature,
+                                                         log);
+
+      CacheSignature(sig, *log);
+   }
+}
+
+PGPEngine::Status
+PGPEngine::GetSessionResult(const GnuPGSession::DetachedSignature& sig,
+                            MCryptoEngineOutputLog *log)
+{
+   log->AddMessage(String::Format(_("Verifying the signature using \"%s\""),
+                                  m_session.GetCommand()));
+
+   if ( !sig.processed )
+   {
+      log->AddMessage(_("GnuPG didn't check this signature."));
+
+      return SIGNATURE_CHECK_ERROR;
+   }
+
+   SigStatusParser sigParser(log);
+   Status status = MAX_ERROR;
+   for ( size_t n = 0; n < sig.status.size(); n++ )
+   {
+      const String line(FromGPGOutput(sig.status[n]));
+      log->AddMessage(_T("[GNUPG:] ") + line);
+
+      const String code(line.BeforeFirst(' '));
+      const String rest(line.AfterFirst(' '));
+
+      // all the other lines (e.g. KEY_CONSIDERED or NEWSIG) are of no
+      // interest to us here
+      sigParser.Process(code, rest.wx_str(), status);
+   }
+
+   for ( size_t n = 0; n < sig.messages.size(); n++ )
+      log->AddMessage(FromGPGOutput(sig.messages[n]));
+
+   return status;
+}
+
+PGPEngine::Status
+PGPEngine::DoVerifyDetachedSignature(const String& message,
+                                     const String& signature,
+                                     MCryptoEngineOutputLog *log)
 {
    // create temporary files to store the signature and the message text:
    // Using a temp file for both is necessary because GPG does not allow anything
@@ -926,6 +1163,94 @@ PGPEngine::VerifyDetachedSignature(const String& message,
                       wxEmptyString, messageOut, log);
 }
 
+// ----------------------------------------------------------------------------
+// PGPEngine: signatures cache
+// ----------------------------------------------------------------------------
+
+// the maximal amount of memory used by the cache of the signatures: this is
+// enough for a few thousands of typical messages
+static const size_t PGP_SIG_CACHE_MAX_SIZE = 4*1024*1024;
+
+bool
+PGPEngine::GetCachedSignature(DetachedSignature& sig) const
+{
+   if ( sig.messageId.empty() )
+      return false;
+
+   const CachedSignaturesMap::const_iterator
+      i = m_sigCache.find(sig.messageId + '\n' + sig.signature);
+   if ( i == m_sigCache.end() || i->second.message != sig.message )
+      return false;
+
+   const CachedSignature& cached = i->second;
+
+   sig.status = cached.status;
+   if ( sig.log )
+   {
+      sig.log->SetUserID(cached.userID);
+      sig.log->SetPublicKey(cached.publicKey);
+
+      const size_t count = cached.messages.size();
+      for ( size_t n = 0; n < count; n++ )
+         sig.log->AddMessage(cached.messages[n]);
+
+      sig.log->AddMessage(_("(This is the result of an earlier check of "
+                            "the same signature.)"));
+   }
+
+   return true;
+}
+
+void
+PGPEngine::CacheSignature(const DetachedSignature& sig,
+                          const MCryptoEngineOutputLog& log)
+{
+   if ( sig.messageId.empty() )
+      return;
+
+   // only cache the definitive results: the other errors may go away, e.g.
+   // the missing public key can be imported or the user may configure gpg
+   // location
+   switch ( sig.status )
+   {
+      case OK:
+      case SIGNATURE_EXPIRED_ERROR:
+      case SIGNATURE_UNTRUSTED_WARNING:
+      case SIGNATURE_ERROR:
+      case NO_DATA_ERROR:
+         break;
+
+      default:
+         return;
+   }
+
+   const String key = sig.messageId + '\n' + sig.signature;
+   const size_t size = key.length() + sig.message.length();
+   if ( m_sigCacheSize + size > PGP_SIG_CACHE_MAX_SIZE )
+   {
+      // it's simpler to just start afresh than to track the least recently
+      // used entries and this doesn't happen often anyhow
+      m_sigCache.clear();
+      m_sigCacheSize = 0;
+
+      if ( size > PGP_SIG_CACHE_MAX_SIZE )
+         return;
+   }
+
+   CachedSignature& cached = m_sigCache[key];
+   cached.message = sig.message;
+   cached.status = sig.status;
+   cached.userID = log.GetUserID();
+   cached.publicKey = log.GetPublicKey();
+
+   cached.messages.clear();
+   const size_t count = log.GetMessageCount();
+   for ( size_t n = 0; n < count; n++ )
+      cached.messages.push_back(log.GetMessage(n));
+
+   m_sigCacheSize += size;
+}
+
 // ----------------------------------------------------------------------------
 // PGPEngine key management
 // ----------------------------------------------------------------------------
@@ -28,6 +28,8 @@
    #include <wx/msgdlg.h>        // for wxMessageBox
 #endif //USE_PCH
 
+#include <wx/stopwatch.h>
+
 #include "MFolder.h"
 #include "MailFolder.h"
 #include "Message.h"
@@ -36,12 +38,11 @@
 #include "SpamFilter.h"
 #include "gui/SpamOptionsPage.h"
 
+#include "modules/Dspam.h"
+
 extern "C"
 {
-   #define class klass
-   #include <libdspam.h>
    #include <hash_drv.h>
-   #undef class
 }
 
 // ----------------------------------------------------------------------------
@@ -50,6 +51,10 @@ extern "C"
 
 static const char *DSPAM_USER_NAME = "mahogany";
 
+// the number of messages retrieved from the folder and processed at once
+// during training
+static const size_t TRAIN_BATCH_SIZE = 100;
+
 // base class used by DspamProcess/ClassifyCtx
 class DspamCtx
 {
@@ -186,6 +191,14 @@ protected:
                              const Message& msg,
                              const String& param,
                              String *result);
+   virtual void DoTrainBatch(const Profile *profile,
+                             const ArrayMessages& msgs,
+                             bool isSpam);
+   virtual void DoCheckIfSpamBatch(const Profile *profile,
+                                   const ArrayMessages& msgs,
+                                   const String& param,
+                                   wxArrayInt& isSpam,
+                                   wxArrayString& results);
    virtual const char *GetOptionPageIconName() const { return "dspam"; }
    virtual SpamOptionsPage *CreateOptionPage(MBookCtrl *notebook,
                                              Profile *profile) const;
@@ -204,6 +217,36 @@ private:
       virtual ~ContextHandler() { }
    };
 
+   // ContextHandler used by DoCheckIfSpam() and DoCheckIfSpamBatch()
+   class CheckContextHandler : public ContextHandler
+   {
+   public:
+      CheckContextHandler()
+      {
+         m_isSpam = false;
+         m_probability = 0;
+      }
+
+      virtual void OnDone(DSPAM_CTX *ctx)
+      {
+         m_probability = ctx->confidence;
+         m_isSpam = ctx->result == DSR_ISSPAM;
+      }
+
+      // return the result for the last processed message
+      bool IsSpam() const { return m_isSpam; }
+
+      // return the explanation of the result for the last processed message
+      String GetResult() const
+      {
+         return String::Format(_T("probability = %0.3f"), m_probability);
+      }
+
+   private:
+      bool m_isSpam;
+      float m_probability;
+   };
+
    // ContextHandler used by DoReclassify() and DoTrain()
    class ClassifyContextHandler : public ContextHandler
    {
@@ -236,6 +279,10 @@ private:
    // false if we failed, use ContextHandler to customize processing
    bool DoProcess(const Message& msg, ContextHandler& handler);
 
+   // same as DoProcess() above but uses the given context: this allows to
+   // process several messages without recreating it every time
+   bool DoProcess(DspamCtx& ctx, const Message& msg, ContextHandler& handler);
+
 
    DspamCtx *m_ctx;
 
@@ -324,6 +371,12 @@ bool DspamFilter::DoProcess(const Message& msg, ContextHandler& handler)
    if ( !ctx )
       return false;
 
+   return DoProcess(ctx, msg, handler);
+}
+
+bool
+DspamFilter::DoProcess(DspamCtx& ctx, const Message& msg, ContextHandler& handler)
+{
    String str;
    if ( !msg.WriteToString(str) )
    {
@@ -332,6 +385,9 @@ bool DspamFilter::DoProcess(const Message& msg, ContextHandler& handler)
       return false;
    }
 
+   // forget the previous message processed using the same context
+   DspamResetCtx(ctx);
+
    handler.OnInit(ctx);
 
    if ( dspam_process(ctx, str.To8BitData()) != 0 )
@@ -370,40 +426,60 @@ DspamFilter::DoCheckIfSpam(const Profile * /* profile */,
                            const String& param,
                            String *result)
 {
-   class CheckContextHandler : public ContextHandler
-   {
-   public:
-      CheckContextHandler(bool *rc, float *probability)
-      {
-         m_rc = rc;
-         m_probability = probability;
-      }
+   ASSERT_MSG( param.empty(), _T("DspamFilter has no parameters") );
 
-      virtual void OnDone(DSPAM_CTX *ctx)
-      {
-         *m_probability = ctx->confidence;
-         *m_rc = ctx->result == DSR_ISSPAM;
-      }
+   CheckContextHandler handler;
+   if ( !DoProcess(msg, handler) || !handler.IsSpam() )
+      return false;
 
-   private:
-      bool *m_rc;
-      float *m_probability;
-   };
+   if ( result )
+      *result = handler.GetResult();
+
+   return true;
+}
+
+void DspamFilter::DoTrainBatch(const Profile * /* profile */,
+                               const ArrayMessages& msgs,
+                               bool isSpam)
+{
+   DspamProcessCtx ctx;
+   if ( !ctx )
+      return;
+
+   ClassifyContextHandler handler(ClassifyContextHandler::Train, isSpam);
+
+   const size_t count = msgs.size();
+   for ( size_t n = 0; n < count; n++ )
+      DoProcess(ctx, *msgs[n], handler);
+}
 
+void DspamFilter::DoCheckIfSpamBatch(const Profile * /* profile */,
+                                     const ArrayMessages& msgs,
+                                     const String& param,
+                                     wxArrayInt& isSpam,
+                                     wxArrayString& results)
+{
    ASSERT_MSG( param.empty(), _T("DspamFilter has no parameters") );
 
-   bool rc;
-   float probability;
-   CheckContextHandler handler(&rc, &probability);
-   if ( !DoProcess(msg, handler) || !rc )
-      return false;
+   const size_t count = msgs.size();
+   isSpam.clear();
+   isSpam.Add(false, count);
+   results.clear();
+   results.Add(wxEmptyString, count);
 
-   if ( result )
+   DspamProcessCtx ctx;
+   if ( !ctx )
+      return;
+
+   CheckContextHandler handler;
+   for ( size_t n = 0; n < count; n++ )
    {
-      result->Printf(_T("probability = %0.3f"), probability);
+      if ( DoProcess(ctx, *msgs[n], handler) && handler.IsSpam() )
+      {
+         isSpam[n] = true;
+         results[n] = handler.GetResult();
+      }
    }
-
-   return true;
 }
 
 // ----------------------------------------------------------------------------
@@ -516,28 +592,47 @@ void DspamFilter::Train(wxWindow *parent)
                      wxPD_CAN_ABORT
                    );
 
-   for ( size_t n = 0; n < count; n++ )
+   // retrieve the messages and train DSPAM with them in batches: this is
+   // much faster than processing them one by one
+   wxStopWatch sw;
+   size_t countTrained = 0;
+   ArrayMessages msgs;
+   for ( size_t n = 0; n < count; )
    {
-      if ( !pd.Update(n + 1, String::Format(_("Message %zu of %zu"), n, count)) )
+      if ( !pd.Update(n, String::Format(_("Message %zu of %zu"), n, count)) )
       {
          // cancelled by user
          break;
       }
 
-      HeaderInfo *hi = hil->GetItemByIndex(n);
-      if ( hi )
+      const size_t last = wxMin(n + TRAIN_BATCH_SIZE, count);
+      for ( ; n < last; n++ )
       {
-         Message_obj msg(mf->GetMessage(hi->GetUId()));
-         if ( msg )
+         HeaderInfo *hi = hil->GetItemByIndex(n);
+         Message *msg = hi ? mf->GetMessage(hi->GetUId()) : NULL;
+         if ( !msg )
          {
-            DoTrain(NULL /* unused */, *msg, isSpam);
-
+            wxLogWarning(_("Failed to retrieve message #%zu."), n);
             continue;
          }
+
+         msgs.push_back(msg);
       }
 
-      wxLogWarning(_("Failed to retrieve message #%zu."), n);
+      DoTrainBatch(NULL /* unused */, msgs, isSpam);
+
+      countTrained += msgs.size();
+      for ( size_t i = 0; i < msgs.size(); i++ )
+         msgs[i]->DecRef();
+      msgs.clear();
    }
+
+   const long msElapsed = sw.Time();
+   wxLogMessage(_("DSPAM was trained with %zu messages in %.1f seconds "
+                  "(%.0f messages per second)."),
+                countTrained,
+                msElapsed / 1000.,
+                msElapsed ? (1000.*countTrained)/msElapsed : 0.);
 }
 
 // ----------------------------------------------------------------------------
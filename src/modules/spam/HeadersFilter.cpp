@@ -46,6 +46,8 @@
 #include "SpamFilter.h"
 #include "gui/SpamOptionsPage.h"
 
+#include "mail/Dnsbl.h"
+
 #ifdef OS_MAC
    #undef USE_RBL
 #endif
@@ -963,65 +965,8 @@ static bool CheckWhiteList(const Message& msg, String *match)
 
 #ifdef USE_RBL
 
-
-#ifndef __STRICT_ANSI__
-#define __STRICT_ANSI__
-#endif
-#include <netinet/in.h>
-
-// FreeBSD uses a variable name "class"
-#define class xxclass
-#undef MIN  // defined by glib.h
-#undef MAX  // defined by glib.h
-#include <arpa/nameser.h>
-#undef class
-
-#include <resolv.h>
-#include <netdb.h>
-
-#ifdef OS_SOLARIS
-   extern "C" {
-   // Solaris 2.5.1 has no prototypes for it:
-   extern int res_init(void);
-   extern int res_query(const char *, int , int ,
-                        unsigned char *, int);
-   };
-#endif
-
-#define BUFLEN 512
-
-/* rblcheck()
- * Checks the specified dotted-quad address against the provided RBL
- * domain. If "txt" is non-zero, we perform a TXT record lookup. We
- * return the text returned from a TXT match, or an empty string, on
- * a successful match, or NULL on an unsuccessful match. */
-static
-bool CheckRBL( int a, int b, int c, int d, const String & rblDomain)
-{
-   char * answerBuffer = new char[ BUFLEN ];
-   int len;
-
-   String domain;
-   domain.Printf(_T("%d.%d.%d.%d.%s"), d, c, b, a, rblDomain );
-
-   res_init();
-   len = res_query( domain.ToAscii(), C_IN, T_A,
-                    (unsigned char *)answerBuffer, PACKETSZ );
-
-   if ( len != -1 )
-   {
-      if ( len > PACKETSZ ) // buffer was too short, re-alloc:
-      {
-         delete [] answerBuffer;
-         answerBuffer = new char [ len ];
-         // and again:
-         len = res_query( domain.ToAscii(), C_IN, T_A,
-                          (unsigned char *) answerBuffer, len );
-      }
-   }
-   delete [] answerBuffer;
-   return len != -1; // found, so it's known spam
-}
+// the maximal time to wait for the answers from all blacklists, in ms
+static const long RBL_TIMEOUT = 3000;
 
 static const wxChar * gs_RblSites[] =
 { _T("rbl.maps.vix.com"), _T("relays.orbs.org"), _T("rbl.dorkslayers.com"), NULL };
@@ -1061,6 +1006,31 @@ static bool findIP(String &header,
    return false;
 }
 
+// add all IP addresses enclosed in the given characters in the header to the
+// array, skipping the duplicates and the addresses which can't be listed
+static void CollectIPs(const String& header,
+                       char openChar, char closeChar,
+                       wxArrayString& addresses)
+{
+   String testHeader = header;
+   while ( !testHeader.empty() )
+   {
+      int a, b, c, d;
+      if ( !findIP(testHeader, openChar, closeChar, &a, &b, &c, &d) )
+         break;
+
+      // loopback and private (RFC 1918) addresses are never blacklisted
+      if ( a == 127 || a == 10 ||
+            (a == 172 && b >= 16 && b <= 31) ||
+               (a == 192 && b == 168) )
+         continue;
+
+      const String ip = String::Format(_T("%d.%d.%d.%d"), a, b, c, d);
+      if ( addresses.Index(ip) == wxNOT_FOUND )
+         addresses.Add(ip);
+   }
+}
+
 #endif // USE_RBL
 
 // ----------------------------------------------------------------------------
@@ -1181,42 +1151,24 @@ HeadersFilter::DoCheckIfSpam(const Profile *profile,
       {
          msg.GetHeaderLine(_T("Received"), value);
 
-         int a,b,c,d;
-         String testHeader = value;
+         // collect all addresses first to look them up in all blacklists
+         // at once instead of waiting for each answer in turn
+         wxArrayString addresses;
+         CollectIPs(value, '(', ')', addresses);
+         CollectIPs(value, '[', ']', addresses);
 
          bool rc = false;
-         while ( !rc && !testHeader.empty() )
+         if ( !addresses.empty() )
          {
-            if (findIP(testHeader, '(', ')', &a, &b, &c, &d))
-            {
-               for ( int i = 0; gs_RblSites[i]; ++i )
-               {
-                  if ( CheckRBL(a,b,c,d,gs_RblSites[i]) )
-                  {
-                     rc = true;
-                     break;
-                  }
-               }
-            }
-         }
-
-         if ( !rc )
-         {
-            testHeader = value;
-            while ( !rc && !testHeader.empty() )
-            {
-               if (findIP(testHeader, '[', ']', &a, &b, &c, &d))
-               {
-                  for ( int i = 0; gs_RblSites[i] ; ++i )
-                  {
-                     if ( CheckRBL(a,b,c,d,gs_RblSites[i]) )
-                     {
-                        rc = true;
-                        break;
-                     }
-                  }
-               }
-            }
+            wxArrayString zones;
+            for ( int i = 0; gs_RblSites[i]; ++i )
+               zones.Add(gs_RblSites[i]);
+
+            String match;
+            rc = DnsblChecker::Get()->IsListed(addresses, zones,
+                                               RBL_TIMEOUT, &match);
+            if ( rc )
+               wxLogDebug(_T("Message is blacklisted: %s"), match.c_str());
          }
 
          /*FIXME: if it is a hostname, maybe do a DNS lookup first? */
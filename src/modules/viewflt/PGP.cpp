@@ -41,7 +41,7 @@ public:
    PGPFilter(MessageView *msgView, ViewFilter *next, bool enable);
 
 protected:
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 
@@ -152,7 +152,7 @@ PGPFilter::PGPFilter(MessageView *msgView, ViewFilter *next, bool enable)
 // ----------------------------------------------------------------------------
 
 void
-PGPFilter::DoProcess(String& text,
+PGPFilter::DoProcess(const ViewText& text,
                      MessageViewer *viewer,
                      MTextStyle& style)
 {
@@ -160,21 +160,22 @@ PGPFilter::DoProcess(String& text,
    //
    // there should be a BEGIN line near the start of the message
    const wxChar *beginNext = NULL;
-   const wxChar *start = text.c_str();
+   const wxChar *start = text.begin();
+   const wxChar * const textEnd = text.end();
    for ( size_t numLines = 0; numLines < 10; numLines++ )
    {
       const wxChar *p = start;
-      if ( AdvanceIfMatches(&p, PGP_BEGIN_PREFIX) )
+      if ( AdvanceIfMatches(&p, PGP_BEGIN_PREFIX) && p <= textEnd )
       {
          beginNext = p;
          break;
       }
 
       // try the next line (but only if not already at the end)
-      if ( !*p )
+      if ( start >= textEnd )
          break;
 
-      p = wxStrchr(start, _T('\n'));
+      p = text.Find(_T('\n'), start);
       if ( !p )
          break; // no more text
 
@@ -211,16 +212,18 @@ PGPFilter::DoProcess(String& text,
       if ( ok ) // ok, it starts with something valid
       {
          // now locate the end line
-         const wxChar *pc = start + text.length() - 1;
+         const wxChar *pc = textEnd - 1;
 
          bool foundEnd = false;
          for ( ;; )
          {
             // optimistically suppose that this line will be the END one
             end = pc + 2;
+            if ( end > textEnd )
+               end = textEnd;
 
             // find the beginning of this line
-            while ( *pc != '\n' && pc >= start )
+            while ( pc >= start && *pc != '\n' )
             {
                pc--;
             }
@@ -276,7 +279,7 @@ PGPFilter::DoProcess(String& text,
       if ( ok )
       {
          // output the part before the BEGIN line, if any
-         String prolog(text.c_str(), start);
+         const ViewText prolog(text.begin(), start);
          if ( !prolog.empty() )
          {
             m_next->Process(prolog, viewer, style);
@@ -415,7 +418,7 @@ PGPFilter::DoProcess(String& text,
             viewer->InsertText(_T("\r\n"), style);
 
          // output the part after the END line, if any
-         String epilog(end);
+         const ViewText epilog(end, textEnd);
          if ( !epilog.empty() )
          {
             m_next->Process(epilog, viewer, style);
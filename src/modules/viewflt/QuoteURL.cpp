@@ -132,7 +132,7 @@ protected:
    };
 
    // the main work function
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 
@@ -272,7 +272,7 @@ QuoteURLFilter::FindURLIfNeeded(const wxChar *s, int& len)
 }
 
 void
-QuoteURLFilter::DoProcess(String& text,
+QuoteURLFilter::DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style)
 {
@@ -283,11 +283,13 @@ QuoteURLFilter::DoProcess(String& text,
 
    QuoteData quoteData;
 
-   const wxChar *lineCur = text.c_str();
+   const wxChar *lineCur = text.begin();
+   const wxChar * const end = text.end();
 
    int lenURL;
-   const wxChar *startURL = FindURLIfNeeded(lineCur, lenURL);
-   while ( *lineCur )
+   const wxChar *startURL = text.empty() ? NULL
+                                         : FindURLIfNeeded(lineCur, lenURL);
+   while ( lineCur < end )
    {
       if ( m_options.quotedColourize )
       {
@@ -300,21 +302,33 @@ QuoteURLFilter::DoProcess(String& text,
       }
 
       // find the start of the next line
-      const wxChar *lineNext = wxStrchr(lineCur, _T('\n'));
+      const wxChar *lineNext = text.Find(_T('\n'), lineCur);
 
       // and look for all URLs on the current line
       const wxChar *endURL = lineCur;
       while ( startURL &&
                (lineCur <= startURL && (!lineNext || startURL < lineNext)) )
       {
+         // FindURL() doesn't know where our text ends and could have found
+         // an URL after it
+         if ( startURL >= end )
+         {
+            startURL = NULL;
+            break;
+         }
+
          // insert the text before URL (endURL is the end of previous URL, not
          // this one or the start of line initially)
-         String textBefore(endURL, startURL);
-         m_next->Process(textBefore, viewer, style);
+         if ( startURL != endURL )
+            m_next->Process(ViewText(endURL, startURL), viewer, style);
 
-         // then the URL itself (we use the same string for text and URL)
+         // then the URL itself (we use the same string for text and URL): this
+         // is the only place where we need a string as URLs are rare anyhow
          endURL = startURL + lenURL;
-         String url(startURL, endURL);
+         if ( endURL > end )
+            endURL = end;
+
+         const String url(startURL, endURL);
          m_next->ProcessURL(url, url, viewer);
 
          // if the URL wraps to the next line, we consider that we're still on
@@ -322,17 +336,17 @@ QuoteURLFilter::DoProcess(String& text,
          // the line is wrapped
          while ( lineNext && endURL > lineNext )
          {
-            lineNext = wxStrchr(lineNext + 1, _T('\n'));
+            lineNext = text.Find(_T('\n'), lineNext + 1);
          }
 
          // now look for the next URL
-         startURL = FindURLIfNeeded(endURL, lenURL);
+         startURL = endURL < end ? FindURLIfNeeded(endURL, lenURL) : NULL;
       }
 
       // finally insert everything after the last URL (if any)
-      String textAfter(endURL, lineNext ? lineNext + 1
-                                        : text.c_str() + text.length());
-      m_next->Process(textAfter, viewer, style);
+      const wxChar * const endLine = lineNext ? lineNext + 1 : end;
+      if ( endLine != endURL )
+         m_next->Process(ViewText(endURL, endLine), viewer, style);
 
       if ( !lineNext )
          break;
@@ -341,4 +355,3 @@ QuoteURLFilter::DoProcess(String& text,
       lineCur = lineNext + 1;
    }
 }
-
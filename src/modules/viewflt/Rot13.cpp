@@ -37,7 +37,7 @@ public:
       : ViewFilter(msgView, next, enable) { }
 
 protected:
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 };
@@ -59,10 +59,13 @@ IMPLEMENT_VIEWER_FILTER(Rot13Filter,
                         "(c) 2002 Vadim Zeitlin <vadim@wxwindows.org>");
 
 void
-Rot13Filter::DoProcess(String& text,
+Rot13Filter::DoProcess(const ViewText& textOrig,
                        MessageViewer *viewer,
                        MTextStyle& style)
 {
+   // we modify the text so we need to make a copy of it
+   String text = textOrig.ToString();
+
    for ( String::iterator i = text.begin(),
                         end = text.end();
          i != end;
@@ -62,7 +62,7 @@ protected:
       bool operator==(const Options& o) const { return SigCol == o.SigCol; }
    };
 
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 
@@ -140,8 +140,23 @@ IMPLEMENT_VIEWER_FILTER(SignatureFilter,
                         gettext_noop("Signature"),
                         "(c) 2002 Vadim Zeitlin <vadim@wxwindows.org>");
 
+// return true if the line starting at pc is a signature delimiter
+static bool IsSigDelimiter(const wxChar *pc, const wxChar *end)
+{
+   // NB: we accept "-- " (canonical) but also just "--" which is
+   //     unfortunately used by some people.
+   //     But we always make sure that the line ends just after.
+   if ( end - pc < 3 || pc[0] != '-' || pc[1] != '-' )
+      return false;
+
+   if ( pc[2] == '\r' || pc[2] == '\n' )
+      return true;
+
+   return pc[2] == ' ' && end - pc > 3 && (pc[3] == '\r' || pc[3] == '\n');
+}
+
 void
-SignatureFilter::DoProcess(String& text,
+SignatureFilter::DoProcess(const ViewText& text,
                            MessageViewer *viewer,
                            MTextStyle& style)
 {
@@ -152,16 +167,17 @@ SignatureFilter::DoProcess(String& text,
    if ( text.empty() )
       return;
 
-   String signature;
+   const wxChar *start = text.begin();
+   const wxChar *pc = text.end() - 1;
 
-   const wxChar *start = text.c_str();
-   const wxChar *pc = start + text.length() - 1;
+   // the start of the signature if we find it
+   const wxChar *startSig = text.end();
 
    // while we're not too far from end
    for ( size_t numLinesFromEnd = 0; numLinesFromEnd < 10; numLinesFromEnd++ )
    {
       // look for the start of this line:
-      while ( *pc != '\n' && pc >= start )
+      while ( pc >= start && *pc != '\n' )
       {
          pc--;
       }
@@ -170,16 +186,10 @@ SignatureFilter::DoProcess(String& text,
       pc++;
 
       // is it a signature delimiter?
-      //
-      // NB: we accept "-- " (canonical) but also just "--" which is
-      //     unfortunately used by some people.
-      //     But we always make sure that the line ends just after.
-      if ( pc[0] == '-' && pc[1] == '-' &&
-               ((pc[2] == ' ' && (pc[3] == '\r' || pc[3] == '\n')) || pc[2] == '\r' || pc[2] == '\n') )
+      if ( IsSigDelimiter(pc, text.end()) )
       {
-         // remember the signature and cut it off
-         signature = pc;
-         text.resize(pc - start);
+         // remember where the signature starts
+         startSig = pc;
 
          break;
       }
@@ -199,7 +209,7 @@ SignatureFilter::DoProcess(String& text,
 
       // skip '\n' and '\r' if it's present -- surprizingly enough, we might
       // not have it (this happens to me inside a PGP encrypted message)
-      if ( *--pc == '\r' )
+      if ( pc > start && *--pc == '\r' )
       {
          // skip '\r' as well
          --pc;
@@ -207,10 +217,10 @@ SignatureFilter::DoProcess(String& text,
    }
 
    // first show the main text normally
-   m_next->Process(text, viewer, style);
+   m_next->Process(ViewText(start, startSig), viewer, style);
 
    // and then show the signature specially, if any
-   if ( !signature.empty() )
+   if ( startSig != text.end() )
    {
       // the main message text ends here
       m_next->EndText();
@@ -219,9 +229,8 @@ SignatureFilter::DoProcess(String& text,
       wxColour colOld = style.GetTextColour();
       style.SetTextColour(m_options.SigCol);
 
-      m_next->Process(signature, viewer, style);
+      m_next->Process(ViewText(startSig, text.end()), viewer, style);
 
       style.SetTextColour(colOld);
    }
 }
-
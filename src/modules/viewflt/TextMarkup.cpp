@@ -40,7 +40,7 @@ public:
       : ViewFilter(msgView, next, enable) { }
 
 protected:
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 };
@@ -72,7 +72,7 @@ IMPLEMENT_VIEWER_FILTER(TextMarkupFilter,
  */
 
 void
-TextMarkupFilter::DoProcess(String& text,
+TextMarkupFilter::DoProcess(const ViewText& text,
                             MessageViewer *viewer,
                             MTextStyle& style)
 {
@@ -89,11 +89,14 @@ TextMarkupFilter::DoProcess(String& text,
    // are we at the start of a new word?
    bool atWordStart = true;
 
-   // the strings containing the text for the current state (normal or
-   // highlighted)
-   String textNormal,
-          textSpecial;
-   for ( const wxChar *pc = text.c_str(); ; pc++ )
+   // the start of the text for the current state (normal or highlighted): as
+   // the highlighted text always immediately follows chLastSpecial, we can
+   // revert to treating it as normal text by just rewinding to this character
+   const wxChar *startNormal = text.begin(),
+                *startSpecial = NULL;
+
+   const wxChar * const end = text.end();
+   for ( const wxChar *pc = text.begin(); pc < end; pc++ )
    {
       switch ( *pc )
       {
@@ -107,43 +110,40 @@ TextMarkupFilter::DoProcess(String& text,
                   // yes: treat it as a markup character
 
                   // output the normal text we had so far
-                  m_next->Process(textNormal, viewer, style);
-                  textNormal.clear();
+                  if ( pc != startNormal )
+                  {
+                     m_next->Process(ViewText(startNormal, pc), viewer, style);
+                  }
 
                   // change state and reset the associated info
                   chLastSpecial = *pc;
                   state = chLastSpecial == _T('*') ? Bold : Italic;
+                  startSpecial = pc + 1;
                }
-               else // no, it's in the middle of the word
-               {
-                  // treat it as a normal character then;
-                  textNormal += *pc;
-               }
+               //else: no, it's in the middle of the word, treat it as a
+               //      normal character then
             }
             else // ending markup tag?
             {
                // should we highlight what we've got so far?
-               if ( *pc != chLastSpecial || textSpecial.empty() )
+               if ( *pc != chLastSpecial || pc == startSpecial )
                {
                   // markup mismatch or nothing between 2 delimiters --
                   // consider there was no intention to use the last special
                   // character for markup at all
-                  textNormal = chLastSpecial + textSpecial + *pc;
-
+                  startNormal = startSpecial - 1;
                   state = Normal;
-                  textSpecial.clear();
                }
                else // matching tag
                {
                   // is it really the end of markup or can it continue further?
-                  if ( wxIsalnum(pc[1]) )
+                  if ( pc + 1 < end && wxIsalnum(pc[1]) )
                   {
                      // it seems to continue, don't output anything for now
 
                      // this will be replaced by a space later if it turns out
                      // that it was indeed highlighted (i.e. if we find a
                      // matchin markup terminator later)
-                     textSpecial += *pc;
                   }
                   else // end of markup
                   {
@@ -156,16 +156,27 @@ TextMarkupFilter::DoProcess(String& text,
                      else // italic
                         font.SetStyle(wxFONTSTYLE_ITALIC);
 
+                     style.SetFont(font);
+
                      // replace intermediate markup characters with spaces to
-                     // render _the_multi_word_examples_ correctly
-                     textSpecial.Replace(String(chLastSpecial), _T(" "));
+                     // render _the_multi_word_examples_ correctly, this is
+                     // the only case when we need to copy the text
+                     const ViewText textSpecial(startSpecial, pc);
+                     if ( textSpecial.Find(chLastSpecial, startSpecial) )
+                     {
+                        String str = textSpecial.ToString();
+                        str.Replace(String(chLastSpecial), _T(" "));
+                        m_next->Process(str, viewer, style);
+                     }
+                     else
+                     {
+                        m_next->Process(textSpecial, viewer, style);
+                     }
 
-                     style.SetFont(font);
-                     m_next->Process(textSpecial, viewer, style);
                      style.SetFont(fontOld);
 
                      state = Normal;
-                     textSpecial.clear();
+                     startNormal = pc + 1;
                   }
                }
             }
@@ -181,37 +192,20 @@ TextMarkupFilter::DoProcess(String& text,
                if ( !wxIsalnum(*pc) && *pc != _T('\'') )
                {
                   // we decide that the last special character wasn't meant
-                  // to begin the markup after all
-
-                  // don't forget to treat the markup symbol which isn't one
-                  // literally
-                  textNormal = chLastSpecial;
-
-                  textNormal += textSpecial;
-                  textSpecial.clear();
+                  // to begin the markup after all, so treat it literally
+                  startNormal = startSpecial - 1;
                   state = Normal;
                }
             }
-
-            // do not append an extra NUL to the text, strings with embedded
-            // NULs confuse the code elsewhere
-            if ( *pc )
-            {
-               (state == Normal ? textNormal : textSpecial) += *pc;
-            }
-      }
-
-      if ( *pc == _T('\0') )
-      {
-         // end of text
-         ASSERT_MSG( state == Normal, _T("logic error in TextMarkupFilter") );
-
-         m_next->Process(textNormal, viewer, style);
-
-         break;
       }
 
       atWordStart = wxIsspace(*pc);
    }
-}
 
+   // if the text ended in the middle of the markup, it wasn't one
+   if ( state != Normal )
+      startNormal = startSpecial - 1;
+
+   if ( startNormal != end )
+      m_next->Process(ViewText(startNormal, end), viewer, style);
+}
@@ -40,7 +40,7 @@ public:
       : ViewFilter(msgView, next, enable) { }
 
 protected:
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 };
@@ -62,7 +62,7 @@ IMPLEMENT_VIEWER_FILTER(TrailerFilter,
                         "(c) 2002 Vadim Zeitlin <vadim@wxwindows.org>");
 
 void
-TrailerFilter::DoProcess(String& text,
+TrailerFilter::DoProcess(const ViewText& text,
                          MessageViewer *viewer,
                          MTextStyle& style)
 {
@@ -73,8 +73,8 @@ TrailerFilter::DoProcess(String& text,
    if ( text.empty() )
       return;
 
-   const wxChar *start = text.c_str();
-   const wxChar *pc = start + text.length() - 1;
+   const wxChar *start = text.begin();
+   const wxChar *pc = text.end() - 1;
 
    // while we're not too far from end
    for ( size_t numLinesFromEnd = 0; numLinesFromEnd < 10; numLinesFromEnd++ )
@@ -105,13 +105,13 @@ TrailerFilter::DoProcess(String& text,
             if ( *pc == '\n' )
                pc++;
 
-            // remember the tail and cut it off
-            String tail = pc;
-            text.resize(pc - start);
+            // split the text in the body and the tail
+            const ViewText body(start, pc),
+                           tail(pc, text.end());
 
             // trailers may be embedded, so call ourselves recursively to check
             // for them again
-            Process(text, viewer, style);
+            Process(body, viewer, style);
 
             // the main message text ends here
             m_next->EndText();
@@ -153,6 +153,10 @@ TrailerFilter::DoProcess(String& text,
          // skip '\r' as well
          --pc;
       }
+
+      // don't read before the start of the text if it starts with "\r\n"
+      if ( pc < start )
+         break;
    }
 
    // nothing found, process the rest normally
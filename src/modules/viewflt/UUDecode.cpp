@@ -49,7 +49,7 @@ public:
    UUDecodeFilter(MessageView *msgView, ViewFilter *next, bool enable);
 
 protected:
-   virtual void DoProcess(String& text,
+   virtual void DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style);
 };
@@ -199,23 +199,24 @@ UUdecodeFile(const wxChar *input,
 
 
 void
-UUDecodeFilter::DoProcess(String& text,
+UUDecodeFilter::DoProcess(const ViewText& text,
                           MessageViewer *viewer,
                           MTextStyle& style)
 {
    // do we have something looking like UUencoded data?
    static const size_t lenBegin = wxStrlen(UU_BEGIN_PREFIX);
 
-   const wxChar *start = text.c_str();
+   const wxChar *start = text.begin();
+   const wxChar * const textEnd = text.end();
    const wxChar *nextToOutput = start;
-   while ( *start )
+   while ( start < textEnd )
    {
       bool hasBegin = wxStrncmp(start, UU_BEGIN_PREFIX, lenBegin) == 0;
       if ( hasBegin )
       {
          // check that we're either at the start of the text or after a blank
          // line
-         switch ( start - text.c_str() )
+         switch ( start - text.begin() )
          {
             case 0:
                // leave hasBegin at true
@@ -232,7 +233,7 @@ UUDecodeFilter::DoProcess(String& text,
                // only blank line allowed before
                if ( start[-1] != '\n' || start[-2] != '\r' )
                   hasBegin = false;
-               if ( start - text.c_str() > 2 &&
+               if ( start - text.begin() > 2 &&
                         (start[-3] != '\n' || start[-4] != '\r') )
                   hasBegin = false;
          }
@@ -241,7 +242,7 @@ UUDecodeFilter::DoProcess(String& text,
       if ( !hasBegin )
       {
          // try the next line (but only if not already at the end)
-         start = wxStrchr(start, _T('\n'));
+         start = text.Find(_T('\n'), start);
          if ( start )
          {
             start++;  // skip '\n' itself
@@ -249,7 +250,7 @@ UUDecodeFilter::DoProcess(String& text,
          }
          else
          {
-            String prolog(nextToOutput);
+            const ViewText prolog(nextToOutput, textEnd);
             if ( !prolog.empty() )
             {
                m_next->Process(prolog, viewer, style);
@@ -278,18 +279,20 @@ UUDecodeFilter::DoProcess(String& text,
       const wxChar *startName = start+4;     // skip mode and space
       const wxChar *endName = startName;
       // Rest of the line is the name
-      while ( *endName != '\r' )
+      while ( endName < textEnd && *endName != '\r' )
       {
-         if ( !*endName++ )
+         endName++;
+      }
+
+      if ( endName == textEnd )
+      {
+         wxLogWarning(_("The BEGIN line is unterminated."));
+         const ViewText prolog(nextToOutput, textEnd);
+         if ( !prolog.empty() )
          {
-            wxLogWarning(_("The BEGIN line is unterminated."));
-            String prolog(nextToOutput);
-            if ( !prolog.empty() )
-            {
-               m_next->Process(prolog, viewer, style);
-            }
-            return;   // no more text
+            m_next->Process(prolog, viewer, style);
          }
+         return;   // no more text
       }
 
       ASSERT_MSG( endName[1] == '\n',
@@ -333,7 +336,8 @@ UUDecodeFilter::DoProcess(String& text,
       if ( ok )
       {
          static const size_t lenEnd = wxStrlen(UU_END_PREFIX);
-         if ( wxStrncmp(endOfEncodedStream, UU_END_PREFIX, lenEnd) == 0 )
+         if ( wxStrncmp(endOfEncodedStream, UU_END_PREFIX, lenEnd) == 0 &&
+                  endOfEncodedStream + lenEnd <= textEnd )
          {
             endOfEncodedStream += lenEnd;
          }
@@ -347,7 +351,7 @@ UUDecodeFilter::DoProcess(String& text,
       if ( ok )
       {
          // output the part before the BEGIN line, if any
-         String prolog(nextToOutput, startBeginLine);
+         const ViewText prolog(nextToOutput, startBeginLine);
          if ( !prolog.empty() )
          {
             m_next->Process(prolog, viewer, style);
@@ -374,7 +378,7 @@ UUDecodeFilter::DoProcess(String& text,
       }
    }
 
-   String prolog(nextToOutput);
+   const ViewText prolog(nextToOutput, textEnd);
    if ( !prolog.empty() )
    {
       m_next->Process(prolog, viewer, style);
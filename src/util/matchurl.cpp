@@ -1,7 +1,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Project:     M - cross platform e-mail GUI client
 // File name:   util/matchurl.cpp - matching URLs in text
-// Purpose:     implements Aho-Cora algorithm and uses it for URL matching
+// Purpose:     implements Aho-Corasick algorithm and uses it for URL matching
 // Author:      Xavier Nodet (core), Vadim Zeitlin (specialization to URLs)
 // Modified by:
 // Created:     25.04.02
@@ -24,95 +24,121 @@
    #include "Mcommon.h"
 #endif
 
+// are we building with AddressSanitizer?
+#if defined(__SANITIZE_ADDRESS__)
+   #define M_MATCHURL_ASAN
+#elif defined(__has_feature)
+   #if __has_feature(address_sanitizer)
+      #define M_MATCHURL_ASAN
+   #endif
+#endif
+
+// SSE2 is always available when targeting x86-64 and can be enabled for x86,
+// but we don't use it with ASan as findLastChar() reads past the end of the
+// string (harmlessly, as it never crosses the page boundary) which it reports
+// as an error, while the scalar version can be checked by it normally
+#if !defined(M_MATCHURL_ASAN) && \
+      (defined(__SSE2__) || defined(_M_X64) || \
+         (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+   #define M_MATCHURL_SSE2
+   #include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+   #include <intrin.h>
+#endif
+
 // ----------------------------------------------------------------------------
 // private classes
 // ----------------------------------------------------------------------------
 
-/// KeywordDetectorCell represents a single keyword letter with links from it
-class KeywordDetectorCell
-{
-public:
-   KeywordDetectorCell(char c) :
-      _c(c), _son(NULL), _brother(NULL), _isKey(0), _back(NULL) {}
-
-   ~KeywordDetectorCell()
-   {
-      if (_c != '\000')
-      {
-         delete _son;
-         delete _brother;
-      } // else: this is a back-node, and thus it points up in the
-      // tree, to a node that is already deleted, or will soon be.
-   }
-
-private:
-   char _c;
-   KeywordDetectorCell* _son;
-   KeywordDetectorCell* _brother;
-   int _isKey;
-   KeywordDetectorCell* _back;
-
-   KeywordDetectorCell* computeBackArc(KeywordDetectorCell* root,
-         KeywordDetectorCell* parentBack);
-   void computeBackArcs(KeywordDetectorCell* root,
-         KeywordDetectorCell* parentBack);
-
-   friend class KeywordDetector;
-};
+/**
+  Keywords scanner.
 
+  This class implements Aho-Corasick algorithm: all the keywords are compiled
+  into a single DFA stored in flat arrays, so that examining each character
+  of the text only takes a table lookup.
 
-/**
-  * Keywords scanner
+  Moreover, the text is not examined character by character at all except
+  just before the characters which can end a keyword: there are only a few of
+  them and they are found using SIMD instructions, if available.
   */
 class KeywordDetector
 {
 public:
-   KeywordDetector() : _root(NULL) { }
-   ~KeywordDetector() { delete _root; }
+   KeywordDetector();
 
-public:
    /// Adds a new keyword to the list of detected keywords
    void addNewKeyword(const char* key);
 
+   /** Does all the precomputations needed after all the
+     keywords have been added, and before the first call
+     to scan.
+    */
+   void compile();
+
    /** Returns the length of the longest keyword
      starting at the beginning of the string given as parameter.
      Returns 0 if no keyword found or not at the beginning of
      the string.
-     This method does not need that computeBackArcs has been called.
-     Keywords can be added between calls to this method.
+     This method does not need that compile() has been called.
     */
-   int scanAtStart(const wxChar* toBeScanned);
+   int scanAtStart(const wxChar* toBeScanned) const;
 
    /** Scans the given string to find a keyword.
      Returns the starting position of the first
      keyword in the string.
      lng is the length of the longest keyword that
-     starts in this position.
-     computeBackArcs must have been called before the
+     starts in this position, or 0 if no keyword was found.
+     compile() must have been called before the
      first call to this function.
     */
-   int scan(const wxChar* toBeScanned, int& lng) {
-      return scan(toBeScanned, lng, _root);
-   }
+   int scan(const wxChar* toBeScanned, int& lng) const;
 
-   /** Does all the precomputations needed after all the
-     keywords have been added, and before the first call
-     to scan.
-    */
-   void computeBackArcs() {
-      _root->computeBackArcs(_root, 0);
+private:
+   enum
+   {
+      /// the maximal number of the automaton states
+      MAX_STATES = 64,
+
+      /// the maximal number of different characters in the keywords
+      MAX_CLASSES = 32,
+
+      /// the maximal number of different characters ending the keywords
+      MAX_LAST_CHARS = 8
+   };
+
+   /// returns the class of the given character or 0 if it's not in keywords
+   unsigned getClass(wxChar c) const
+   {
+      return (unsigned)c < WXSIZEOF(m_classes) ? m_classes[(unsigned)c] : 0;
    }
 
-private:
-   void addNewKeyword(const char* key,
-         KeywordDetectorCell* current,
-         int toBeAdded = 1);
-   int scanAtStart(const wxChar* toBeScanned,
-         KeywordDetectorCell* current,
-         int longueurDejaVue, int lngDernierTrouve);
-   int scan(const wxChar* toBeScanned, int& lng, KeywordDetectorCell* current);
-
-   KeywordDetectorCell* _root;
+   /// returns the first character which can end a keyword or the final NUL
+   const wxChar *findLastChar(const wxChar* p) const;
+
+   /// the class of all 7 bit characters, 0 for those not used in keywords
+   unsigned char m_classes[128];
+
+   /// the trie of the keywords: the child of the state or 0 if none
+   unsigned char m_trie[MAX_STATES][MAX_CLASSES];
+
+   /// the DFA transitions function
+   unsigned char m_next[MAX_STATES][MAX_CLASSES];
+
+   /// the length of the longest keyword ending in this state or 0
+   unsigned char m_out[MAX_STATES];
+
+   /// the length of the keyword corresponding to this trie state or 0
+   unsigned char m_keyLen[MAX_STATES];
+
+   /// the different last characters of all keywords
+   wxChar m_lastChars[MAX_LAST_CHARS];
+
+   size_t m_countStates,
+          m_countClasses,
+          m_countLastChars,
+          m_lenMax;
 };
 
 /// URLDetector simply uses KeywordDetector to detect specifically the URLs
@@ -129,278 +155,291 @@ public:
      @return the position of the first match or -1 if nothing found
     */
    int FindURL(const wxChar *str, int& len);
+
+private:
+   /// the flags used in m_charFlags
+   enum
+   {
+      Char_URL = 1,
+      Char_LocalPart = 2,
+      Char_Domain = 4
+   };
+
+   /// checks a character to be a valid part of an URL
+   bool IsURLChar(wxChar c) const
+      { return (m_charFlags[(unsigned char)c] & Char_URL) != 0; }
+
+   /// check if the character is valid in the personal part of an address
+   bool IsLocalPartChar(wxChar c) const
+      { return (m_charFlags[(unsigned char)c] & Char_LocalPart) != 0; }
+
+   /// check if the character is valid in the domain part of an address
+   bool IsDomainChar(wxChar c) const
+      { return (m_charFlags[(unsigned char)c] & Char_Domain) != 0; }
+
+   /**
+     The flags for all characters.
+
+     Notice that only the low byte of wide characters is taken into account,
+     exactly as it always has been done.
+    */
+   unsigned char m_charFlags[256];
 };
 
 // ============================================================================
 // KeywordDetector implementation
 // ============================================================================
 
-void KeywordDetector::addNewKeyword(const char* key)
+#ifdef M_MATCHURL_SSE2
+
+// helpers for comparing wxChars using SSE2, whatever their size is
+template <size_t N> struct SSE2Chars;
+
+template <> struct SSE2Chars<2>
 {
-   //
-   // Ajout d'un mot-clef dans l'arbre
-   //
-   if (key && (strlen(key) > 0))
-      addNewKeyword(key, _root);
+   static __m128i Set(wxChar c) { return _mm_set1_epi16((short)c); }
+   static __m128i Eq(__m128i x, __m128i y) { return _mm_cmpeq_epi16(x, y); }
+};
+
+template <> struct SSE2Chars<4>
+{
+   static __m128i Set(wxChar c) { return _mm_set1_epi32((int)c); }
+   static __m128i Eq(__m128i x, __m128i y) { return _mm_cmpeq_epi32(x, y); }
+};
+
+// return the index of the lowest bit set in a non-zero mask
+static inline unsigned LowestBit(unsigned mask)
+{
+#ifdef _MSC_VER
+   unsigned long n;
+   _BitScanForward(&n, mask);
+   return n;
+#else
+   return __builtin_ctz(mask);
+#endif
 }
 
+#endif // M_MATCHURL_SSE2
 
-void KeywordDetector::addNewKeyword(const char* key,
-                                    KeywordDetectorCell* current,
-                                    int toBeAdded)
+KeywordDetector::KeywordDetector()
 {
-   if (! current)
-   {
-      // This is the first keyword inserted
-      // We must create adn save the root of the tree
-      KeywordDetectorCell* newCell = new KeywordDetectorCell(key[0]);
-      _root = newCell;
-      addNewKeyword(key, _root);
+   memset(m_classes, 0, sizeof(m_classes));
+   memset(m_trie, 0, sizeof(m_trie));
+   memset(m_next, 0, sizeof(m_next));
+   memset(m_out, 0, sizeof(m_out));
+   memset(m_keyLen, 0, sizeof(m_keyLen));
+
+   // state 0 is the root of the trie and class 0 is used for all the
+   // characters not appearing in the keywords
+   m_countStates = 1;
+   m_countClasses = 1;
+   m_countLastChars = 0;
+   m_lenMax = 0;
+}
+
+void KeywordDetector::addNewKeyword(const char* key)
+{
+   const size_t len = key ? strlen(key) : 0;
+   if ( !len )
       return;
-   }
 
-   if (current->_c == key[0])
+   CHECK_RET( len < 0x100, _T("keyword too long") );
+
+   unsigned state = 0;
+   for ( size_t n = 0; n < len; n++ )
    {
-      // The key is correct: this is the correct cell
-      if (key[1] == '\000')
-      {
-         // And we have reached the end of a keyword
-         // Donc la cellule courante marque la fin
-         // d'un mot-clef
-         current->_isKey = toBeAdded;
-      }
-      else
+      const unsigned char c = key[n];
+      CHECK_RET( c < WXSIZEOF(m_classes), _T("only 7 bit keywords supported") );
+
+      if ( !m_classes[c] )
       {
-         // The keyword to add (or remove) is not finished
-         if (! current->_son) {
-            // No son yet. We have to create one
-            KeywordDetectorCell* newCell = new KeywordDetectorCell(key[1]);
-            current->_son = newCell;
-         }
-         addNewKeyword(key+1, current->_son);
+         CHECK_RET( m_countClasses < MAX_CLASSES, _T("too many characters") );
+
+         m_classes[c] = m_countClasses++;
       }
-   }
-   else
-   {
-      // This is not the correct cell
-      if (! current->_brother)
+
+      unsigned char& child = m_trie[state][m_classes[c]];
+      if ( !child )
       {
-         // No brother. Let's create one
-         KeywordDetectorCell* newCell = new KeywordDetectorCell(key[0]);
-         current->_brother = newCell;
+         CHECK_RET( m_countStates < MAX_STATES, _T("too many keywords") );
+
+         child = m_countStates++;
       }
 
-      addNewKeyword(key, current->_brother);
+      state = child;
    }
-}
 
+   m_keyLen[state] = len;
 
-int
-KeywordDetector::scanAtStart(const wxChar* toBeScanned,
-                             KeywordDetectorCell* current,
-                             int longueurDejaVue,
-                             int lngDernierTrouve)
-{
-   if (! current)
-      return lngDernierTrouve;
+   if ( len > m_lenMax )
+      m_lenMax = len;
 
-   if (current->_c == toBeScanned[0])
+   const wxChar last = key[len - 1];
+   for ( size_t n = 0; ; n++ )
    {
-      // This is the correct cell
-      if (current->_isKey == 1)
-      {
-         // And this is the end of a keyword
-         // let's try to find a longer one, but do
-         // remember that we already saw one, the length
-         // of which is longueurDejaVue+1
-         return scanAtStart(toBeScanned+1,
-               current->_son,
-               longueurDejaVue+1,
-               longueurDejaVue+1);
-      }
-      else
+      if ( n == m_countLastChars )
       {
-         // This is not the end of a keyword
-         // Go on
-         CHECK( current->_son, -1, _T("current cell must have a son") );
-         return scanAtStart(toBeScanned+1, current->_son, longueurDejaVue+1, lngDernierTrouve);
+         CHECK_RET( n < MAX_LAST_CHARS, _T("too many different last chars") );
+
+         m_lastChars[m_countLastChars++] = last;
+         break;
       }
+
+      if ( m_lastChars[n] == last )
+         break;
    }
-   else
+}
+
+void KeywordDetector::compile()
+{
+   // the states in breadth first order and the failure function for them,
+   // i.e. the state corresponding to the longest proper suffix of the
+   // state string which is also a prefix of some keyword
+   unsigned char queue[MAX_STATES],
+                 fail[MAX_STATES];
+   size_t head = 0,
+          tail = 0;
+
+   // the children of the root fail to the root itself
+   for ( size_t cls = 0; cls < m_countClasses; cls++ )
    {
-      // Not a correct cell
-      if (! current->_brother)
-      {
-         // And no more cell. Let's return the length
-         // we may have already found
-         return lngDernierTrouve;
-      }
-      else
+      const unsigned char child = m_trie[0][cls];
+      m_next[0][cls] = child;
+      if ( child )
       {
-         // There is another cell to try
-         return scanAtStart(toBeScanned, current->_brother, longueurDejaVue, lngDernierTrouve);
+         fail[child] = 0;
+         queue[tail++] = child;
       }
    }
-}
 
+   m_out[0] = 0;
 
-int KeywordDetector::scanAtStart(const wxChar* toBeScanned)
-{
-   return scanAtStart(toBeScanned, _root, 0, 0);
-}
+   while ( head < tail )
+   {
+      const unsigned state = queue[head++];
 
+      // the longest keyword ending here is either the state itself or the
+      // longest one ending in the state we fall back to
+      m_out[state] = m_keyLen[state] ? m_keyLen[state] : m_out[fail[state]];
 
-int KeywordDetector::scan(const wxChar* toBeScanned,
-                          int& lng, KeywordDetectorCell* current)
-{
-   int currentPosition = 0;
-   lng = 0;
-   bool atRootLevel = true;
-   while (toBeScanned[0])
-   {
-      if (current->_c == toBeScanned[0])
+      for ( size_t cls = 0; cls < m_countClasses; cls++ )
       {
-         // This is the correct cell
-         if (current->_isKey == 1)
+         const unsigned char child = m_trie[state][cls];
+         if ( child )
          {
-            // And the end of a keyword.
-            // let's try to find a longer one, but do
-            // remember that we already saw one, the length
-            // of which is longueurDejaVue+1
-
-            lng =  scanAtStart(toBeScanned+1,
-                  current->_son,
-                  lng+1,
-                  lng+1);
-            return currentPosition;
+            fail[child] = m_next[fail[state]][cls];
+            queue[tail++] = child;
+
+            m_next[state][cls] = child;
          }
          else
          {
-            // This is not the end of a keyword
-            // Go on
-            CHECK( current->_son, -1, _T("current cell must have a son") );
-            current = current->_son;
-            atRootLevel = false;
-            lng++;
-            toBeScanned = toBeScanned + 1;
-         }
-      }
-      else
-      {
-         // Not a correct cell
-         current = current->_brother;
-         if (!current)
-         {
-            current = _root;
-            if (atRootLevel)
-            {
-               toBeScanned++;
-               if ( !lng )
-                  lng = 1;
-            }
-            atRootLevel = true;
-            currentPosition = currentPosition + lng;
-            lng = 0;
-         }
-         else if (current->_c == '\000')
-         {
-            // This is a 'back-link'
-            currentPosition = currentPosition + lng - current->_isKey;
-            lng = current->_isKey;
-            ASSERT_MSG( lng > 0, _T("length must be non 0") );
-            current = current->_son;
+            m_next[state][cls] = m_next[fail[state]][cls];
          }
       }
    }
-   lng = 0;
-   return 0;
 }
 
-KeywordDetectorCell *
-KeywordDetectorCell::computeBackArc(KeywordDetectorCell* root,
-                                    KeywordDetectorCell* parentBack)
+int KeywordDetector::scanAtStart(const wxChar* toBeScanned) const
 {
-   ASSERT_MSG(parentBack == 0 || parentBack->_c == '\000',
-              _T("logic error in KeywordDetectorCell?"));
+   int lng = 0;
 
-   KeywordDetectorCell* current = 0;
-   int backLevel = 0;
-   if (! parentBack)
-   {
-      // Parent node has no back arc. So we look for
-      // nextLetter in root and its siblings
-      current = root;
-      backLevel = 1;
-   }
-   else
+   unsigned state = 0;
+   for ( const wxChar *p = toBeScanned; ; p++ )
    {
-      // Parent has a back node. So we look for nextLetter
-      // in *the sons* of this back node
-      current = parentBack->_son;
-      backLevel = parentBack->_isKey + 1;
+      state = m_trie[state][getClass(*p)];
+      if ( !state )
+         break;
+
+      if ( m_keyLen[state] )
+         lng = m_keyLen[state];
    }
 
-   while (current)
+   return lng;
+}
+
+const wxChar *KeywordDetector::findLastChar(const wxChar* p) const
+{
+#ifdef M_MATCHURL_SSE2
+   typedef SSE2Chars<sizeof(wxChar)> Chars;
+
+   // examine the characters one by one until we get to the aligned position:
+   // aligned loads never cross the page boundary and so are safe even if
+   // they read beyond the end of the string
+   for ( ; (wxUIntPtr)p % sizeof(__m128i); p++ )
    {
-      if (current->_c == _c)
+      if ( !*p )
+         return p;
+
+      for ( size_t n = 0; n < m_countLastChars; n++ )
       {
-         break;
+         if ( *p == m_lastChars[n] )
+            return p;
       }
-
-      current = current->_brother;
    }
 
-   if (current)
+   __m128i lastChars[MAX_LAST_CHARS];
+   for ( size_t n = 0; n < m_countLastChars; n++ )
+      lastChars[n] = Chars::Set(m_lastChars[n]);
+
+   const __m128i zero = _mm_setzero_si128();
+   for ( ;; p += sizeof(__m128i) / sizeof(wxChar) )
    {
-      // We have found our back node
-      // Find our last son
-      KeywordDetectorCell* lastSon = _son;
+      const __m128i chars = _mm_load_si128((const __m128i *)p);
 
-      // There must be a son, otherwise the current node would be a keyword
-      // and there is no need for a back node
-      CHECK(lastSon, 0, _T("node with a back link must have a son"));
+      __m128i found = Chars::Eq(chars, zero);
+      for ( size_t n = 0; n < m_countLastChars; n++ )
+         found = _mm_or_si128(found, Chars::Eq(chars, lastChars[n]));
 
-      while (lastSon->_brother)
+      const unsigned mask = _mm_movemask_epi8(found);
+      if ( mask )
+         return p + LowestBit(mask) / sizeof(wxChar);
+   }
+#else // !M_MATCHURL_SSE2
+   for ( ; *p; p++ )
+   {
+      for ( size_t n = 0; n < m_countLastChars; n++ )
       {
-         lastSon = lastSon->_brother;
+         if ( *p == m_lastChars[n] )
+            return p;
       }
-
-      // A cell with key '\000' is points to the back node
-      KeywordDetectorCell* newCell = new KeywordDetectorCell('\000');
-      newCell->_son = current->_son;
-      newCell->_isKey = backLevel;
-      lastSon->_brother = newCell;
-      return newCell;
    }
 
-   return 0;
+   return p;
+#endif // M_MATCHURL_SSE2/!M_MATCHURL_SSE2
 }
 
-void
-KeywordDetectorCell::computeBackArcs(KeywordDetectorCell* root,
-                                     KeywordDetectorCell* parentBack)
+int KeywordDetector::scan(const wxChar* toBeScanned, int& lng) const
 {
-   KeywordDetectorCell* parent = this;
-   bool onRootLevel = (parent == root ? true : false);
-   while (parent)
+   // all keywords end with one of m_lastChars, so look for them and check
+   // if a keyword ends there by running the automaton over the preceding
+   // characters: as its state only depends on the last m_lenMax characters,
+   // we don't need to look further back
+   for ( const wxChar *p = toBeScanned; ; p++ )
    {
-      if (parent->_c == '\000')
+      p = findLastChar(p);
+      if ( !*p )
          break;
 
-      KeywordDetectorCell* back = 0;
-      if (! (onRootLevel || parent->_isKey))
-      {
-         back = parent->computeBackArc(root, parentBack);
-      }
+      const wxChar *q = p - toBeScanned < (int)m_lenMax ? toBeScanned
+                                                       : p - m_lenMax + 1;
+      unsigned state = 0;
+      for ( ; q <= p; q++ )
+         state = m_next[state][getClass(*q)];
 
-      KeywordDetectorCell* son = parent->_son;
-      if (son)
+      if ( m_out[state] )
       {
-         son->computeBackArcs(root, back);
-      }
+         // the keyword found may be a prefix of a longer one, so return the
+         // length of the longest one
+         const wxChar * const start = p - m_out[state] + 1;
+         lng = scanAtStart(start);
 
-      parent = parent->_brother;
+         return start - toBeScanned;
+      }
    }
+
+   lng = 0;
+   return 0;
 }
 
 // ============================================================================
@@ -423,22 +462,24 @@ static inline bool IsAlnum(unsigned char c)
           (c > 0x7f);
 }
 
+// the functions below are only used to initialize URLDetector::m_charFlags
+
 /// checks a character to be a 'mark' as from RFC2396
-inline bool IsURLMark(char c)
+static inline bool IsURLMark(char c)
 {
    return c == '-' || c == '_' || c == '.' || c == '!' || c == '~' ||
           c == '*' || c == '\'' || c == '(' || c == ')';
 }
 
 /// checks a character to be 'reserved' as from RFC2396
-inline bool IsURLReserved(char c)
+static inline bool IsURLReserved(char c)
 {
    return c == ';' || c == '/' || c == '?' || c == ':' || c == '@' ||
           c == '&' || c == '=' || c == '+' || c == '$' || c == ',';
 }
 
 /// checks a character to be a valid part of an URL
-inline bool IsURLChar(char c)
+static inline bool IsURLCharSlow(char c)
 {
    return IsAlnum(c) || IsURLMark(c) || IsURLReserved(c) || c == '%' || c == '#' ||
           c == '[' || c == ']';
@@ -455,18 +496,18 @@ static inline bool IsATextChar(char c)
 }
 
 /// check if the character is valid in the personal part of an address
-static inline bool IsLocalPartChar(char c)
+static inline bool IsLocalPartCharSlow(char c)
 {
    // we don't support quoted local parts here
    return IsATextChar(c) || (c == '.');
 }
 
 /// check if the character is valid in the domain part of an address
-static inline bool IsDomainChar(char c)
+static inline bool IsDomainCharSlow(char c)
 {
    // we don't really support the domain literals but we still include '[' and
    // ']' just in case
-   return IsLocalPartChar(c) || c == '[' || c == ']';
+   return IsLocalPartCharSlow(c) || c == '[' || c == ']';
 }
 
 URLDetector::URLDetector()
@@ -487,7 +528,16 @@ URLDetector::URLDetector()
    // finally detect the email addresses
    addNewKeyword("@");
 
-   computeBackArcs();
+   compile();
+
+   for ( size_t n = 0; n < WXSIZEOF(m_charFlags); n++ )
+   {
+      const char c = (char)n;
+
+      m_charFlags[n] = (IsURLCharSlow(c) ? Char_URL : 0) |
+                       (IsLocalPartCharSlow(c) ? Char_LocalPart : 0) |
+                       (IsDomainCharSlow(c) ? Char_Domain : 0);
+   }
 }
 
 /*
@@ -615,23 +665,22 @@ match:
 
    if ( isMail )
    {
-      // look for the start of the address
-      start--;
-      while ( start > text && IsLocalPartChar(*start) )
+      // look for the start of the address: if we're retrying after a false
+      // match and '@' immediately follows it (e.g. "www.@foo"), the last
+      // character of the previous match is taken into account too, but we
+      // never look before the start of the initial string
+      const wxChar * const
+         startMin = offset && start == text ? text - 1 : text;
+      while ( start > startMin && IsLocalPartChar(start[-1]) )
          start--;
 
       // have we stopped at '<'?
-      bool hasAngleBracket = *start == '<';
-      if ( !hasAngleBracket )
+      bool hasAngleBracket = start > startMin && start[-1] == '<';
+      if ( hasAngleBracket )
       {
-         if ( !IsLocalPartChar(*start) )
-         {
-            // we went too far backwards
-            start++;
-         }
-         //else: we stopped at the start of the text
+         // keep '<' as part of the URL
+         start--;
       }
-      //else: keep '<' as part of the URL
 
       // now look for the end of it
       while ( *p && IsDomainChar(*p) )
@@ -0,0 +1,221 @@
+// Benchmark for AdbLookupIndex: compares the lookups in an index of a big
+// (100K entries) address book with the linear scan of all entries done by
+// AdbEntry::Matches() previously, as happens when expanding an address in the
+// composer, and checks that both of them find the same entries.
+
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+#include <wx/string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+typedef wxString String;
+
+// these constants must be the same as in adb/AdbEntry.h
+enum
+{
+    AdbLookup_NickName      = 0x0001,
+    AdbLookup_FullName      = 0x0002,
+    AdbLookup_EMail         = 0x0008
+};
+
+enum
+{
+    AdbLookup_Match         = 0x0000,
+    AdbLookup_CaseSensitive = 0x0001,
+    AdbLookup_Substring     = 0x0002,
+    AdbLookup_StartsWith    = 0x0004
+};
+
+#include "adb/AdbIndex.h"
+
+static const size_t COUNT = 100000;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Entry: the fields of an ADB entry which are indexed
+// ----------------------------------------------------------------------------
+
+struct Entry
+{
+    String nick,
+           name,
+           email;
+
+    // the same algorithm as AdbEntryStoredInMemory::Matches() uses
+    int Matches(const String& what, int how) const
+    {
+        String pattern;
+        if ( how & AdbLookup_Substring )
+            pattern << '*' << what << '*';
+        else if ( how & AdbLookup_StartsWith )
+            pattern << what << '*';
+        else
+            pattern = what;
+
+        pattern.MakeLower();
+
+        if ( nick.Lower().Matches(pattern) )
+            return AdbLookup_NickName;
+        if ( name.Lower().Matches(pattern) )
+            return AdbLookup_FullName;
+        if ( email.Lower().Matches(pattern) )
+            return AdbLookup_EMail;
+
+        return 0;
+    }
+};
+
+static const char *FIRST_NAMES[] =
+{
+    "Alice", "Bob", "Carol", "Dave", "Eve", "Frank", "Grace", "Heidi",
+    "Ivan", "Judy", "Mallory", "Oscar", "Peggy", "Trent", "Victor", "Walter",
+};
+
+static const char *DOMAINS[] =
+{
+    "example.com", "example.org", "mail.example.net", "university.edu",
+};
+
+static String RandomWord(std::mt19937& rng, size_t len)
+{
+    String s;
+    for ( size_t n = 0; n < len; n++ )
+        s += (wxChar)('a' + rng() % 26);
+
+    return s;
+}
+
+static std::vector<Entry> CreateEntries()
+{
+    std::mt19937 rng(17);
+
+    std::vector<Entry> entries(COUNT);
+    for ( size_t n = 0; n < COUNT; n++ )
+    {
+        Entry& e = entries[n];
+
+        const String first = FIRST_NAMES[rng() % WXSIZEOF(FIRST_NAMES)];
+        String last = RandomWord(rng, 4 + rng() % 6);
+        last[0] = wxToupper(last[0]);
+
+        e.nick = first.Lower() + last.Lower().Left(2) + String::Format("%zu", n);
+        e.name = first + ' ' + last;
+        e.email = first.Lower() + '.' + last.Lower() + '@' +
+                    DOMAINS[rng() % WXSIZEOF(DOMAINS)];
+    }
+
+    return entries;
+}
+
+// ----------------------------------------------------------------------------
+// benchmark
+// ----------------------------------------------------------------------------
+
+static void Benchmark(const std::vector<Entry>& entries,
+                      const AdbLookupIndex& index,
+                      const String& what,
+                      int how)
+{
+    const int where = AdbLookup_NickName | AdbLookup_FullName | AdbLookup_EMail;
+
+    wxStopWatch sw;
+    std::vector<AdbLookupIndex::Match> matches;
+    index.Find(what, where, how, matches);
+    const long timeIndex = sw.Time();
+
+    sw.Start();
+    std::vector<AdbLookupIndex::Match> matchesLinear;
+    for ( size_t n = 0; n < entries.size(); n++ )
+    {
+        const int field = entries[n].Matches(what, how);
+        if ( field )
+        {
+            AdbLookupIndex::Match m;
+            m.id = n;
+            m.field = field;
+            matchesLinear.push_back(m);
+        }
+    }
+    const long timeLinear = sw.Time();
+
+    const char *howName = how & AdbLookup_Substring ? "substring"
+                            : how & AdbLookup_StartsWith ? "prefix"
+                                                         : "exact";
+    printf("%-15s %-10s %8zu %10ld %10ld\n",
+           (const char *)what.mb_str(), howName,
+           matches.size(), timeIndex, timeLinear);
+
+    Check(matches.size() == matchesLinear.size(), "different number of matches");
+    if ( matches.size() != matchesLinear.size() )
+        return;
+
+    // the index returns the matches sorted by relevance, the linear scan in
+    // the order of the entries
+    std::sort(matches.begin(), matches.end(),
+              [](const AdbLookupIndex::Match& m1,
+                 const AdbLookupIndex::Match& m2)
+              {
+                  return m1.id < m2.id;
+              });
+
+    for ( size_t n = 0; n < matches.size(); n++ )
+    {
+        if ( matches[n].id != matchesLinear[n].id ||
+                matches[n].field != matchesLinear[n].field )
+        {
+            Check(false, "different matches");
+            break;
+        }
+    }
+}
+
+int main()
+{
+    wxInitializer init;
+
+    const std::vector<Entry> entries = CreateEntries();
+
+    wxStopWatch sw;
+    AdbLookupIndex index;
+    for ( size_t n = 0; n < entries.size(); n++ )
+    {
+        const Entry& e = entries[n];
+        index.Add(n, AdbLookup_NickName, e.nick);
+        index.Add(n, AdbLookup_FullName, e.name);
+        index.Add(n, AdbLookup_EMail, e.email);
+    }
+
+    // the index is built by the first lookup
+    std::vector<AdbLookupIndex::Match> matches;
+    index.Find("x", AdbLookup_NickName, AdbLookup_StartsWith, matches);
+
+    printf("indexing %zu entries: %ld ms\n\n", entries.size(), sw.Time());
+
+    printf("%-15s %-10s %8s %10s %10s\n",
+           "lookup", "mode", "matches", "index (ms)", "linear (ms)");
+
+    Benchmark(entries, index, "a", AdbLookup_StartsWith);
+    Benchmark(entries, index, "ali", AdbLookup_StartsWith);
+    Benchmark(entries, index, "alice.q", AdbLookup_StartsWith);
+    Benchmark(entries, index, "Bob", AdbLookup_StartsWith);
+    Benchmark(entries, index, entries[COUNT/2].email, AdbLookup_Match);
+    Benchmark(entries, index, "qx", AdbLookup_Substring);
+    Benchmark(entries, index, "xyz", AdbLookup_Substring);
+    Benchmark(entries, index, "university", AdbLookup_Substring);
+    Benchmark(entries, index, "nonexistent", AdbLookup_Substring);
+
+    return gs_rc;
+}
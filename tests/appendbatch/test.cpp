@@ -0,0 +1,539 @@
+// Test for MessageAppender: appends messages in batches with an empty, and so
+// invalid, message in the middle of one of them to a local MBX file (atomic),
+// a local MH folder (non-atomic) and to a scripted IMAP server in a child
+// process, both with and without MULTIAPPEND support, and checks that all the
+// other messages are appended exactly once and in order. Also checks that
+// cancelling keeps the messages appended before it.
+
+#include <wx/init.h>
+#include <wx/string.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef wxString String;
+
+#include "Mcclient.h"
+#include "mail/MessageAppender.h"
+
+extern "C" DRIVER imapdriver, mbxdriver, mhdriver, dummydriver;
+
+static const size_t COUNT = 25;
+static const size_t BATCH = 10;
+
+// this message is empty, which is refused by both c-client and our server
+static const size_t BAD_MESSAGE = 13;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// messages
+// ----------------------------------------------------------------------------
+
+static const char SUBJECT_PREFIX[] = "Subject: Message ";
+
+static std::string MakeMessage(size_t n)
+{
+    if ( n == BAD_MESSAGE )
+        return std::string();
+
+    std::ostringstream s;
+    s << "From: sender@example.com\r\n"
+      << SUBJECT_PREFIX << n << "\r\n"
+      << "\r\n"
+      << "This is the message number " << n << ".\r\n";
+
+    return s.str();
+}
+
+// extract the message number from its text or return -1
+static int GetMessageNumber(const std::string& text)
+{
+    const size_t pos = text.find(SUBJECT_PREFIX);
+    if ( pos == std::string::npos )
+        return -1;
+
+    return atoi(text.c_str() + pos + sizeof(SUBJECT_PREFIX) - 1);
+}
+
+// check that all messages except the bad one were stored exactly once
+static void CheckStored(const std::vector<int>& stored, const char *what)
+{
+    std::vector<int> expected;
+    for ( size_t n = 0; n < COUNT; n++ )
+    {
+        if ( n != BAD_MESSAGE )
+            expected.push_back(n);
+    }
+
+    if ( stored != expected )
+    {
+        printf("ERROR: unexpected messages in %s:", what);
+        for ( size_t n = 0; n < stored.size(); n++ )
+            printf(" %d", stored[n]);
+        printf("\n");
+
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+class TestSource : public MessageAppender::Source
+{
+public:
+    TestSource(size_t cancelAt = COUNT) : m_cancelAt(cancelAt) { }
+
+    virtual bool GetMessage(size_t n, MessageAppender::Data& data)
+    {
+        data.text = MakeMessage(n);
+        data.flags = n % 2 ? "\\Seen" : "";
+        data.date = "18-Oct-2026 12:00:00 +0000";
+
+        return true;
+    }
+
+    virtual bool OnRetrieve(size_t n) { return n != m_cancelAt; }
+
+private:
+    const size_t m_cancelAt;
+};
+
+// append all test messages and check the results
+static void
+TestAppend(MAILSTREAM *stream, const char *mailbox, bool atomic,
+           const char *what)
+{
+    MessageAppender appender(stream, mailbox, atomic);
+    appender.SetBatchLimits(BATCH, 1024*1024);
+
+    TestSource source;
+    std::vector<size_t> failed;
+    Check(!appender.Append(source, COUNT, failed), "bad message appended");
+    Check(!appender.WasCancelled(), "appending unexpectedly cancelled");
+    Check(failed.size() == 1 && failed[0] == BAD_MESSAGE,
+          "failed message not returned");
+
+    Check(appender.GetBatchCount() == (COUNT + BATCH - 1) / BATCH,
+          "unexpected number of batches");
+
+    // if the target is atomic, the entire batch containing the bad message
+    // must have been retried, otherwise only the messages starting with it
+    const size_t retries = atomic ? BATCH : BATCH - BAD_MESSAGE % BATCH;
+    if ( appender.GetRetryCount() != retries )
+    {
+        printf("ERROR: %lu messages retried instead of %lu for %s\n",
+               (unsigned long)appender.GetRetryCount(),
+               (unsigned long)retries, what);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// read the numbers of all messages in the given local mailbox
+static std::vector<int> ReadLocalMailbox(const char *mailbox)
+{
+    std::vector<int> stored;
+
+    MAILSTREAM *stream = mail_open(NIL, const_cast<char *>(mailbox),
+                                   OP_READONLY);
+    Check(stream != NIL, "failed to open local mailbox");
+    if ( !stream )
+        return stored;
+
+    for ( unsigned long n = 1; n <= stream->nmsgs; n++ )
+    {
+        unsigned long len;
+        const char *header = mail_fetchheader_full(stream, n, NIL, &len, NIL);
+        stored.push_back(GetMessageNumber(std::string(header, len)));
+    }
+
+    mail_close(stream);
+
+    return stored;
+}
+
+// ----------------------------------------------------------------------------
+// scripted IMAP server
+// ----------------------------------------------------------------------------
+
+class Server
+{
+public:
+    Server(int fd, bool multiappend) : m_fd(fd), m_multiappend(multiappend)
+    {
+        m_countAppend = 0;
+    }
+
+    // serve the client until it logs out, return false on error
+    bool Run();
+
+    // get the numbers of the messages stored by the APPEND commands
+    const std::vector<int>& GetStored() const { return m_stored; }
+
+    // get the number of APPEND commands received
+    unsigned GetAppendCount() const { return m_countAppend; }
+
+private:
+    // read the next line or the given number of bytes, return false on EOF
+    bool ReadLine(std::string& line);
+    bool ReadBytes(size_t len, std::string& data);
+
+    // read all the literals of the command whose first line is given
+    bool ReadLiterals(std::string line, std::vector<std::string>& literals);
+
+    void Send(const std::string& s)
+    {
+        const std::string line = s + "\r\n";
+        if ( write(m_fd, line.data(), line.size()) != (ssize_t)line.size() )
+            _exit(EXIT_FAILURE);
+    }
+
+    const int m_fd;
+    const bool m_multiappend;
+
+    std::string m_buf;
+
+    std::vector<int> m_stored;
+    unsigned m_countAppend;
+};
+
+bool Server::ReadLine(std::string& line)
+{
+    size_t eol;
+    while ( (eol = m_buf.find("\r\n")) == std::string::npos )
+    {
+        char buf[4096];
+        const ssize_t n = read(m_fd, buf, sizeof(buf));
+        if ( n <= 0 )
+            return false;
+
+        m_buf.append(buf, n);
+    }
+
+    line = m_buf.substr(0, eol);
+    m_buf.erase(0, eol + 2);
+
+    return true;
+}
+
+bool Server::ReadBytes(size_t len, std::string& data)
+{
+    while ( m_buf.length() < len )
+    {
+        char buf[4096];
+        const ssize_t n = read(m_fd, buf, sizeof(buf));
+        if ( n <= 0 )
+            return false;
+
+        m_buf.append(buf, n);
+    }
+
+    data = m_buf.substr(0, len);
+    m_buf.erase(0, len);
+
+    return true;
+}
+
+bool
+Server::ReadLiterals(std::string line, std::vector<std::string>& literals)
+{
+    // the command continues after each literal and ends with a line without
+    // any literal at its end
+    while ( !line.empty() && line[line.length() - 1] == '}' )
+    {
+        const size_t pos = line.rfind('{');
+        if ( pos == std::string::npos )
+            return false;
+
+        Send("+ go ahead");
+
+        std::string data;
+        if ( !ReadBytes(atol(line.c_str() + pos + 1), data) )
+            return false;
+
+        literals.push_back(data);
+
+        if ( !ReadLine(line) )
+            return false;
+    }
+
+    return true;
+}
+
+bool Server::Run()
+{
+    const std::string caps = m_multiappend ? "IMAP4rev1 MULTIAPPEND"
+                                           : "IMAP4rev1";
+
+    Send("* OK [CAPABILITY " + caps + "] test server ready");
+
+    std::string line;
+    while ( ReadLine(line) )
+    {
+        const size_t posCmd = line.find(' ');
+        const std::string tag = line.substr(0, posCmd);
+        std::string cmd = posCmd == std::string::npos ? std::string()
+                                                      : line.substr(posCmd + 1);
+        cmd = cmd.substr(0, cmd.find(' '));
+
+        if ( cmd == "CAPABILITY" )
+        {
+            Send("* CAPABILITY " + caps);
+        }
+        else if ( cmd == "LOGOUT" )
+        {
+            Send("* BYE bye");
+            Send(tag + " OK LOGOUT completed");
+            break;
+        }
+        else if ( cmd == "APPEND" )
+        {
+            m_countAppend++;
+
+            std::vector<std::string> literals;
+            if ( !ReadLiterals(line, literals) )
+                return false;
+
+            if ( literals.size() > 1 && !m_multiappend )
+                return false;
+
+            // the messages appended by a single command are stored either all
+            // or none of them, as required by RFC 3502
+            bool ok = !literals.empty();
+            for ( size_t n = 0; n < literals.size(); n++ )
+            {
+                if ( literals[n].empty() )
+                    ok = false;
+            }
+
+            if ( !ok )
+            {
+                Send(tag + " NO empty message");
+                continue;
+            }
+
+            for ( size_t n = 0; n < literals.size(); n++ )
+                m_stored.push_back(GetMessageNumber(literals[n]));
+        }
+
+        Send(tag + " OK " + cmd + " completed");
+    }
+
+    close(m_fd);
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// c-client callbacks
+// ----------------------------------------------------------------------------
+
+void mm_login(NETMBX *, char *user, char *pwd, long)
+{
+    strcpy(user, "test");
+    strcpy(pwd, "test");
+}
+
+// the errors for the bad message are expected, so don't show them
+void mm_log(char *, long) { }
+void mm_notify(MAILSTREAM *, char *, long) { }
+
+void mm_status(MAILSTREAM *, char *, MAILSTATUS *) { }
+void mm_exists(MAILSTREAM *, unsigned long) { }
+void mm_expunged(MAILSTREAM *, unsigned long) { }
+void mm_flags(MAILSTREAM *, unsigned long) { }
+void mm_searched(MAILSTREAM *, unsigned long) { }
+void mm_list(MAILSTREAM *, int, char *, long) { }
+void mm_lsub(MAILSTREAM *, int, char *, long) { }
+void mm_dlog(char *) { }
+void mm_critical(MAILSTREAM *) { }
+void mm_nocritical(MAILSTREAM *) { }
+long mm_diskerror(MAILSTREAM *, long, long) { return 1; }
+void mm_fatal(char *string) { printf("c-client fatal error: %s\n", string); }
+
+// ----------------------------------------------------------------------------
+// test
+// ----------------------------------------------------------------------------
+
+static void TestLocal(const std::string& dir)
+{
+    // MBX driver truncates the file back if appending fails
+    const std::string mbx = dir + "/mbx";
+    const std::string mbxCreate = "#driver.mbx/" + mbx;
+    Check(mail_create(NIL, const_cast<char *>(mbxCreate.c_str())) != NIL,
+          "failed to create MBX file");
+
+    TestAppend(NIL, mbx.c_str(), true, "MBX");
+    CheckStored(ReadLocalMailbox(mbx.c_str()), "MBX");
+
+    // MH driver writes the messages one by one and stops at the first error
+    mail_parameters(NIL, SET_MHPROFILE,
+                    const_cast<char *>((dir + "/.mh_profile").c_str()));
+    mail_parameters(NIL, SET_MHPATH, const_cast<char *>(dir.c_str()));
+
+    const std::string mh = dir + "/mh";
+    Check(mkdir(mh.c_str(), 0700) == 0, "failed to create MH directory");
+
+    TestAppend(NIL, "#mh/mh", false, "MH");
+    CheckStored(ReadLocalMailbox("#mh/mh"), "MH");
+
+    // check that cancelling keeps the messages appended before it
+    const std::string mbxCancel = dir + "/cancel";
+    const std::string mbxCancelCreate = "#driver.mbx/" + mbxCancel;
+    Check(mail_create(NIL, const_cast<char *>(mbxCancelCreate.c_str())) != NIL,
+          "failed to create MBX file");
+
+    MessageAppender appender(NIL, mbxCancel.c_str(), true);
+    appender.SetBatchLimits(BATCH, 1024*1024);
+
+    TestSource source(BATCH + 5);
+    std::vector<size_t> failed;
+    Check(!appender.Append(source, COUNT, failed) && appender.WasCancelled(),
+          "appending not cancelled");
+    Check(failed.empty(), "unexpected failures when cancelling");
+    Check(ReadLocalMailbox(mbxCancel.c_str()).size() == BATCH,
+          "messages appended before cancelling lost");
+}
+
+static void TestIMAP(bool multiappend)
+{
+    const char * const what = multiappend ? "IMAP server with MULTIAPPEND"
+                                          : "IMAP server without MULTIAPPEND";
+
+    const int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t len = sizeof(addr);
+    int pipeResults[2];
+    if ( bind(sock, (sockaddr *)&addr, len) != 0 ||
+            listen(sock, 1) != 0 ||
+                getsockname(sock, (sockaddr *)&addr, &len) != 0 ||
+                    pipe(pipeResults) != 0 )
+    {
+        perror("failed to create the server socket");
+        gs_rc = EXIT_FAILURE;
+        return;
+    }
+
+    const pid_t pid = fork();
+    if ( !pid )
+    {
+        const int fd = accept(sock, NULL, NULL);
+        if ( fd == -1 )
+            _exit(EXIT_FAILURE);
+
+        Server server(fd, multiappend);
+        if ( !server.Run() )
+            _exit(EXIT_FAILURE);
+
+        // send the number of APPEND commands followed by the stored messages
+        std::vector<int> results(1, server.GetAppendCount());
+        results.insert(results.end(),
+                       server.GetStored().begin(), server.GetStored().end());
+
+        const size_t size = results.size()*sizeof(int);
+        if ( write(pipeResults[1], &results[0], size) != (ssize_t)size )
+            _exit(EXIT_FAILURE);
+
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(sock);
+    close(pipeResults[1]);
+
+    char server[256];
+    sprintf(server, "{127.0.0.1:%u/imap/notls/user=test}",
+            (unsigned)ntohs(addr.sin_port));
+
+    MAILSTREAM *stream = mail_open(NIL, server, OP_HALFOPEN);
+    Check(stream != NIL, "failed to connect to the server");
+    if ( !stream )
+        return;
+
+    const std::string mailbox = std::string(server) + "INBOX";
+
+    TestAppend(stream, mailbox.c_str(), multiappend, what);
+
+    mail_close(stream);
+
+    std::vector<int> results;
+    int n;
+    while ( read(pipeResults[0], &n, sizeof(n)) == sizeof(n) )
+        results.push_back(n);
+    close(pipeResults[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    Check(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS,
+          "server failed");
+
+    if ( results.empty() )
+    {
+        printf("ERROR: no results from %s\n", what);
+        gs_rc = EXIT_FAILURE;
+        return;
+    }
+
+    // with MULTIAPPEND each batch must have been sent in a single command
+    if ( multiappend )
+    {
+        Check((size_t)results[0] == (COUNT + BATCH - 1) / BATCH + BATCH,
+              "batch not sent using single MULTIAPPEND command");
+    }
+
+    CheckStored(std::vector<int>(results.begin() + 1, results.end()), what);
+}
+
+int main()
+{
+    wxInitializer init;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    mail_link(&imapdriver);
+    mail_link(&mhdriver);
+    mail_link(&mbxdriver);
+    mail_link(&dummydriver);
+
+    char dir[] = "/tmp/mappendXXXXXX";
+    if ( !mkdtemp(dir) )
+    {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    TestLocal(dir);
+
+    TestIMAP(true);
+    TestIMAP(false);
+
+    const std::string cleanup = std::string("rm -rf ") + dir;
+    if ( system(cleanup.c_str()) != 0 )
+        printf("WARNING: failed to remove %s\n", dir);
+
+    if ( gs_rc == EXIT_SUCCESS )
+        printf("all tests passed\n");
+
+    return gs_rc;
+}
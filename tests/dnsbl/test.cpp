@@ -0,0 +1,370 @@
+// Test for DnsblChecker: runs a stub DNS server in a child process and checks
+// that the queries for all addresses and blacklists are sent at once, that
+// the overall deadline is respected when the server doesn't answer, that the
+// answers coming from another address or for another question are ignored,
+// that both positive and negative answers are cached according to their TTL
+// and that the cache survives saving and loading it.
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/arrstr.h>
+#include <wx/stopwatch.h>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <string>
+
+typedef wxString String;
+
+#include "CacheFile.h"
+#include "mail/Dnsbl.h"
+
+// the server doesn't answer the queries for the names in this zone at all
+#define SLOW_ZONE "slow.test"
+
+// and answers the queries in this one with SERVFAIL
+#define FAIL_ZONE "fail.test"
+
+// the queries in this zone are answered from another socket
+#define SPOOF_ZONE "spoof.test"
+
+// and the queries in this one are answered for a different name
+#define OTHER_QUESTION_ZONE "other-question.test"
+
+// the server exits when it gets a query for this name
+#define QUIT_NAME "quit.test"
+
+// the address listed in all the other zones
+#define LISTED_ADDRESS "127.0.0.2"
+
+static const unsigned long LISTED_TTL = 300;
+static const unsigned long NEGATIVE_TTL = 60;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// DnsblChecker::Get() uses the cache directory but we don't use it here
+String CacheFile::GetCacheDirName() { return "."; }
+bool CacheFile::CreateDirFor(const String&) { return true; }
+
+// ----------------------------------------------------------------------------
+// stub DNS server
+// ----------------------------------------------------------------------------
+
+static void Put16(std::string& s, unsigned n)
+{
+    s += (char)(n >> 8);
+    s += (char)n;
+}
+
+static void Put32(std::string& s, unsigned long n)
+{
+    Put16(s, n >> 16);
+    Put16(s, n & 0xffff);
+}
+
+static bool EndsWith(const std::string& s, const std::string& suffix)
+{
+    return s.length() >= suffix.length() &&
+            s.compare(s.length() - suffix.length(), suffix.length(), suffix) == 0;
+}
+
+// serve the queries until QUIT_NAME is received, return the number of the
+// queries received before it
+static unsigned RunServer(int sock)
+{
+    // the socket used for sending the spoofed answers
+    const int sockSpoof = socket(AF_INET, SOCK_DGRAM, 0);
+
+    unsigned count = 0;
+    for ( ;; )
+    {
+        unsigned char buf[512];
+        sockaddr_in from;
+        socklen_t lenFrom = sizeof(from);
+        const ssize_t len = recvfrom(sock, buf, sizeof(buf), 0,
+                                     (sockaddr *)&from, &lenFrom);
+        if ( len < 12 )
+            continue;
+
+        // extract the name and the end of the question
+        std::string name;
+        ssize_t pos = 12;
+        while ( pos < len && buf[pos] )
+        {
+            if ( !name.empty() )
+                name += '.';
+            name.append((const char *)buf + pos + 1, buf[pos]);
+            pos += buf[pos] + 1;
+        }
+
+        pos += 5; // skip the terminating NUL and QTYPE and QCLASS
+        if ( pos > len )
+            continue;
+
+        if ( name == QUIT_NAME )
+            break;
+
+        count++;
+
+        if ( EndsWith(name, "." SLOW_ZONE) )
+            continue;
+
+        const bool spoof = EndsWith(name, "." SPOOF_ZONE);
+
+        // replace the last letter of the name, just before the terminating
+        // NUL, QTYPE and QCLASS, in the question of the answer
+        if ( EndsWith(name, "." OTHER_QUESTION_ZONE) )
+            buf[pos - 6]++;
+
+        std::string reply((const char *)buf, 2);
+
+        const bool listed = name.compare(0, strlen(LISTED_ADDRESS), "2.0.0.127") == 0;
+        if ( EndsWith(name, "." FAIL_ZONE) )
+        {
+            Put16(reply, 0x8182);           // QR, RD, RA, SERVFAIL
+            Put16(reply, 1);
+            Put16(reply, 0);
+            Put16(reply, 0);
+            Put16(reply, 0);
+            reply.append((const char *)buf + 12, pos - 12);
+        }
+        else if ( listed )
+        {
+            Put16(reply, 0x8180);           // QR, RD, RA, NOERROR
+            Put16(reply, 1);
+            Put16(reply, 1);
+            Put16(reply, 0);
+            Put16(reply, 0);
+            reply.append((const char *)buf + 12, pos - 12);
+
+            Put16(reply, 0xc00c);           // pointer to the question name
+            Put16(reply, 1);                // A
+            Put16(reply, 1);                // IN
+            Put32(reply, LISTED_TTL);
+            Put16(reply, 4);
+            Put32(reply, 0x7f000002);
+        }
+        else
+        {
+            Put16(reply, 0x8183);           // QR, RD, RA, NXDOMAIN
+            Put16(reply, 1);
+            Put16(reply, 0);
+            Put16(reply, 1);
+            Put16(reply, 0);
+            reply.append((const char *)buf + 12, pos - 12);
+
+            reply += '\0';                  // root zone
+            Put16(reply, 6);                // SOA
+            Put16(reply, 1);                // IN
+            Put32(reply, 3600);
+            Put16(reply, 22);
+            reply += '\0';                  // MNAME
+            reply += '\0';                  // RNAME
+            Put32(reply, 1);                // SERIAL
+            Put32(reply, 3600);             // REFRESH
+            Put32(reply, 600);              // RETRY
+            Put32(reply, 86400);            // EXPIRE
+            Put32(reply, NEGATIVE_TTL);     // MINIMUM
+        }
+
+        sendto(spoof ? sockSpoof : sock, reply.data(), reply.size(), 0,
+               (sockaddr *)&from, lenFrom);
+    }
+
+    close(sockSpoof);
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+// fake resolver counting the queries
+// ----------------------------------------------------------------------------
+
+class CountingResolver : public DnsblResolver
+{
+public:
+    CountingResolver(unsigned *count) : m_count(count) { }
+
+    virtual void Resolve(std::vector<Query>& queries, long)
+    {
+        for ( size_t n = 0; n < queries.size(); n++ )
+        {
+            (*m_count)++;
+
+            // the answer expires immediately
+            queries[n].done = true;
+            queries[n].listed = false;
+            queries[n].ttl = 0;
+        }
+    }
+
+private:
+    unsigned *m_count;
+};
+
+// ----------------------------------------------------------------------------
+// test
+// ----------------------------------------------------------------------------
+
+static wxArrayString MakeArray(const char *s1,
+                               const char *s2 = NULL,
+                               const char *s3 = NULL)
+{
+    wxArrayString a;
+    a.Add(s1);
+    if ( s2 )
+        a.Add(s2);
+    if ( s3 )
+        a.Add(s3);
+
+    return a;
+}
+
+int main()
+{
+    wxInitializer init;
+
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t len = sizeof(addr);
+    if ( bind(sock, (sockaddr *)&addr, len) != 0 ||
+            getsockname(sock, (sockaddr *)&addr, &len) != 0 )
+    {
+        perror("failed to create the server socket");
+        return EXIT_FAILURE;
+    }
+
+    int pipeStats[2];
+    if ( pipe(pipeStats) != 0 )
+    {
+        perror("failed to create pipe");
+        return EXIT_FAILURE;
+    }
+
+    const pid_t pid = fork();
+    if ( !pid )
+    {
+        const unsigned count = RunServer(sock);
+        if ( write(pipeStats[1], &count, sizeof(count)) != sizeof(count) )
+            _exit(EXIT_FAILURE);
+
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(sock);
+    close(pipeStats[1]);
+
+    wxArrayString servers;
+    servers.Add(String::Format("127.0.0.1:%u", (unsigned)ntohs(addr.sin_port)));
+
+    const wxArrayString zones = MakeArray("bl.test", "other.test");
+
+    DnsblChecker checker(new DnsblUdpResolver(servers));
+
+    // all 4 queries are sent at once
+    String match;
+    Check(checker.IsListed(MakeArray(LISTED_ADDRESS, "1.2.3.4"), zones,
+                           2000, &match),
+          "listed address not found");
+    Check(match == "2.0.0.127.bl.test", "unexpected match");
+    Check(checker.GetCacheSize() == 4, "not all answers were cached");
+
+    // the same checks are now done using the cache only
+    Check(checker.IsListed(MakeArray(LISTED_ADDRESS), zones, 2000),
+          "positive answer not cached");
+    Check(!checker.IsListed(MakeArray("1.2.3.4"), zones, 2000),
+          "negative answer not cached");
+
+    // invalid addresses are ignored
+    Check(!checker.IsListed(MakeArray("300.1.1.1", "foo", "1.2.3"), zones, 2000),
+          "invalid address found");
+
+    // the server doesn't answer at all: we must give up after the timeout
+    // without waiting for each query in turn
+    wxStopWatch sw;
+    Check(!checker.IsListed(MakeArray("1.1.1.1", "2.2.2.2", "3.3.3.3"),
+                            MakeArray(SLOW_ZONE, "bl.test"), 500),
+          "address found in slow zone");
+    const long msSlow = sw.Time();
+    Check(msSlow >= 500 && msSlow < 1000, "deadline not respected");
+    Check(checker.GetCacheSize() == 7, "unanswered queries were cached");
+
+    // the answers from another address or to another question are ignored
+    Check(!checker.IsListed(MakeArray(LISTED_ADDRESS),
+                            MakeArray(SPOOF_ZONE, OTHER_QUESTION_ZONE), 300),
+          "spoofed answer accepted");
+    Check(checker.GetCacheSize() == 7, "spoofed answer was cached");
+
+    // failed queries are not cached and don't make us wait
+    sw.Start();
+    Check(!checker.IsListed(MakeArray("6.6.6.6"), MakeArray(FAIL_ZONE), 2000),
+          "address found in failing zone");
+    Check(sw.Time() < 500, "waited for failed query");
+    Check(checker.GetCacheSize() == 7, "failed query was cached");
+
+    // stop the server and get the number of queries it received
+    {
+        DnsblUdpResolver resolver(servers);
+        std::vector<DnsblResolver::Query> queries(1);
+        queries[0].name = QUIT_NAME;
+        resolver.Resolve(queries, 100);
+    }
+
+    unsigned countQueries;
+    if ( read(pipeStats[0], &countQueries, sizeof(countQueries)) !=
+            sizeof(countQueries) )
+    {
+        printf("ERROR: failed to get server statistics\n");
+        return EXIT_FAILURE;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    Check(countQueries == 4 + 6 + 2 + 1, "unexpected number of queries");
+
+    // check that the cache is saved and loaded correctly
+    const String filename = "dnsbl.cache";
+    Check(checker.Save(filename), "failed to save the cache");
+
+    unsigned countResolved = 0;
+    DnsblChecker checker2(new CountingResolver(&countResolved));
+    Check(checker2.Load(filename), "failed to load the cache");
+    Check(checker2.GetCacheSize() == 7, "cache not loaded");
+    Check(checker2.IsListed(MakeArray(LISTED_ADDRESS), zones, 2000),
+          "loaded positive answer not used");
+    Check(!checker2.IsListed(MakeArray("1.2.3.4"), zones, 2000),
+          "loaded negative answer not used");
+    Check(countResolved == 0, "cached answers were resolved again");
+
+    // answers with zero TTL are not reused
+    Check(!checker2.IsListed(MakeArray("9.9.9.9"), zones, 2000),
+          "address found by fake resolver");
+    Check(!checker2.IsListed(MakeArray("9.9.9.9"), zones, 2000),
+          "address found by fake resolver");
+    Check(countResolved == 4, "expired answers were reused");
+
+    unlink(filename.mb_str());
+
+    printf("%u queries sent, timed out after %ld ms\n", countQueries, msSlow);
+
+    return gs_rc;
+}
@@ -0,0 +1,248 @@
+// Autosave benchmark for DraftJournal: simulates editing a message with big
+// attachments, saving it after each few modifications as the composer does,
+// and compares the time needed for saving it using the journal with the time
+// needed to write the entire message each time, as it used to be done.
+//
+// Also checks that the contents is restored correctly from the journal, even
+// if the last record in it was only partially written, and that the journal
+// doesn't grow indefinitely.
+//
+// Run "./bench [saves-count [attachment-size-in-MB]]".
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/stopwatch.h>
+
+#include <stdlib.h>
+
+typedef wxString String;
+
+#include "DraftJournal.h"
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+static const char *JOURNAL = "bench.journal";
+
+// ----------------------------------------------------------------------------
+// the simulated composer
+// ----------------------------------------------------------------------------
+
+class Composer
+{
+public:
+    Composer(size_t countAttachments, size_t sizeAttachment)
+    {
+        m_contents.headerNames.push_back("Subject");
+        m_contents.headerValues.push_back("Benchmark");
+        m_contents.headerNames.push_back("To");
+        m_contents.headerValues.push_back("somebody@example.com");
+
+        DraftContents::Part text;
+        text.type = DraftContents::Part::Text;
+        for ( int n = 0; n < 200; n++ )
+            text.text += "This is the text of the message being composed.\r\n";
+        m_contents.parts.push_back(text);
+
+        for ( size_t n = 0; n < countAttachments; n++ )
+        {
+            m_data.push_back(std::vector<char>(sizeAttachment));
+            std::vector<char>& data = m_data.back();
+            for ( size_t i = 0; i < sizeAttachment; i++ )
+                data[i] = (char)(rand() >> 4);
+
+            DraftContents::Part part;
+            part.type = DraftContents::Part::Data;
+            part.mimeType = "APPLICATION/OCTET-STREAM";
+            part.name = String::Format("attachment%d.bin", (int)n);
+            part.disposition = "ATTACHMENT";
+            m_contents.parts.push_back(part);
+        }
+    }
+
+    // make a small modification as the user typing would
+    void Edit(int n)
+    {
+        String& text = m_contents.parts[0].text;
+
+        const size_t pos = rand() % (text.length() + 1);
+        if ( n % 5 == 4 && pos < text.length() )
+            text.erase(pos, 1 + rand() % 10);
+        else
+            text.insert(pos, "typed ");
+
+        if ( n % 50 == 49 )
+        {
+            m_contents.headerValues[0] = String::Format("Benchmark %d", n);
+        }
+    }
+
+    // save everything in the journal, as wxComposeView::AutoSave() does
+    bool SaveJournal(DraftJournal& journal)
+    {
+        for ( size_t n = 0; n < m_data.size(); n++ )
+        {
+            // the data doesn't change, so only hash it the first time
+            String& hash = m_contents.parts[n + 1].hash;
+            if ( hash.empty() || !journal.ReuseData(hash) )
+            {
+                hash = journal.AddData(&m_data[n][0], m_data[n].size());
+                if ( hash.empty() )
+                    return false;
+            }
+        }
+
+        return journal.Update(m_contents);
+    }
+
+    // write the entire message, as it used to be done
+    bool SaveFull(const char *filename)
+    {
+        wxFile file;
+        if ( !file.Create(filename, true) )
+            return false;
+
+        const wxCharBuffer text(m_contents.parts[0].text.ToUTF8());
+        if ( file.Write(text.data(), text.length()) != text.length() )
+            return false;
+
+        for ( size_t n = 0; n < m_data.size(); n++ )
+        {
+            if ( file.Write(&m_data[n][0], m_data[n].size()) != m_data[n].size() )
+                return false;
+        }
+
+        return file.Close();
+    }
+
+    const DraftContents& GetContents() const { return m_contents; }
+
+private:
+    DraftContents m_contents;
+    std::vector< std::vector<char> > m_data;
+};
+
+// ----------------------------------------------------------------------------
+// the tests
+// ----------------------------------------------------------------------------
+
+static bool IsSame(const DraftContents& c1, const DraftContents& c2)
+{
+    return c1.headerNames == c2.headerNames &&
+           c1.headerValues == c2.headerValues &&
+           c1.encoding == c2.encoding &&
+           c1.parts == c2.parts;
+}
+
+static void TestRecovery(const DraftContents& contents)
+{
+    DraftContents loaded;
+    Check(DraftJournal::Load(JOURNAL, loaded), "failed to load the journal");
+    Check(IsSame(loaded, contents), "loaded contents differs");
+
+    for ( size_t n = 1; n < contents.parts.size(); n++ )
+    {
+        wxMemoryBuffer data;
+        Check(DraftJournal::ReadData(JOURNAL, contents.parts[n].hash, data),
+              "failed to read attachment");
+    }
+
+    // simulate a crash while appending a record: it must be ignored
+    {
+        wxFile file(JOURNAL, wxFile::write_append);
+        static const char garbage[] = "\x20\0\0\0\x03\0\0\0\0\0\0\0partial";
+        file.Write(garbage, sizeof(garbage) - 1);
+    }
+
+    Check(DraftJournal::Load(JOURNAL, loaded), "failed to load the journal");
+    Check(IsSame(loaded, contents), "partial record not ignored");
+}
+
+int main(int argc, char **argv)
+{
+    wxInitializer init;
+
+    const int countSaves = argc > 1 ? atoi(argv[1]) : 500;
+    const size_t sizeAttachment = (argc > 2 ? atol(argv[2]) : 20)*1024*1024;
+
+    Composer composer(2, sizeAttachment);
+
+    printf("%-10s %12s %12s %12s\n", "mode", "first (ms)", "avg (ms)", "max (ms)");
+
+    // the old way: everything is written every time
+    long timeFirst = 0,
+         timeTotal = 0,
+         timeMax = 0;
+    for ( int n = 0; n < countSaves / 10; n++ )
+    {
+        composer.Edit(n);
+
+        wxStopWatch sw;
+        Check(composer.SaveFull("bench.mbox"), "failed to save message");
+
+        const long time = sw.Time();
+        if ( !n )
+            timeFirst = time;
+        timeTotal += time;
+        if ( time > timeMax )
+            timeMax = time;
+    }
+
+    wxRemoveFile("bench.mbox");
+
+    printf("%-10s %12ld %12.2f %12ld\n", "full",
+           timeFirst, (double)timeTotal / (countSaves / 10), timeMax);
+
+    // and using the journal
+    {
+        DraftJournal journal(JOURNAL);
+
+        timeTotal =
+        timeMax = 0;
+        for ( int n = 0; n < countSaves; n++ )
+        {
+            composer.Edit(n);
+
+            wxStopWatch sw;
+            Check(composer.SaveJournal(journal), "failed to update journal");
+
+            const long time = sw.Time();
+            if ( !n )
+            {
+                timeFirst = time;
+                continue;
+            }
+
+            timeTotal += time;
+            if ( time > timeMax )
+                timeMax = time;
+        }
+
+        printf("%-10s %12ld %12.2f %12ld\n", "journal",
+               timeFirst, (double)timeTotal / (countSaves - 1), timeMax);
+    }
+
+    // the journal dtor waits for the compaction to finish, so it must be
+    // small now
+    const wxULongLong size = wxFileName::GetSize(JOURNAL);
+    printf("Journal size: %lu bytes\n", (unsigned long)size.GetValue());
+
+    Check(size.GetValue() < 2*1024*1024, "journal not compacted");
+
+    TestRecovery(composer.GetContents());
+
+    DraftJournal::Remove(JOURNAL);
+    Check(!wxFileExists(JOURNAL), "journal not removed");
+
+    return gs_rc;
+}
@@ -0,0 +1,250 @@
+// Test for reusing a DSPAM context for several messages, as DspamFilter does
+// when training or checking messages in a batch: trains two databases on the
+// same distinct messages, one using a new context for each message and the
+// other one using a single context reset with DspamResetCtx() between them,
+// then classifies the same messages against both databases in the same two
+// ways and checks that the results are identical.
+
+#include <wx/init.h>
+#include <wx/string.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "modules/Dspam.h"
+
+static const char *DSPAM_USER_NAME = "mahogany";
+
+static const size_t COUNT_TRAIN = 40;
+static const size_t COUNT_CHECK = 20;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// messages
+// ----------------------------------------------------------------------------
+
+static const char *spamWords[] =
+{
+    "lottery", "winner", "prize", "casino", "pills", "discount", "cheap",
+    "offer", "million", "inheritance", "unclaimed", "bonus",
+};
+
+static const char *hamWords[] =
+{
+    "meeting", "schedule", "project", "review", "patch", "release",
+    "compiler", "agenda", "minutes", "deadline", "branch", "tests",
+};
+
+// make a message using the words from the given list, each message uses a
+// different subset of them
+static std::string MakeMessage(size_t n, bool spam)
+{
+    const char **words = spam ? spamWords : hamWords;
+    const size_t count = WXSIZEOF(spamWords);
+
+    std::ostringstream s;
+    s << "From: " << (spam ? "promo" : "colleague") << n << "@example.com\n"
+      << "To: user@example.org\n"
+      << "Subject: " << words[n % count] << ' ' << words[(n * 7) % count]
+      << " number " << n << "\n"
+      << "\n";
+    for ( size_t line = 0; line < 5 + n % 7; line++ )
+    {
+        for ( size_t w = 0; w < 8; w++ )
+            s << words[(n + line * 3 + w * (n % 5 + 1)) % count] << ' ';
+        s << "\n";
+    }
+
+    return s.str();
+}
+
+// ----------------------------------------------------------------------------
+// DSPAM helpers
+// ----------------------------------------------------------------------------
+
+// create the context in the same way as DspamFilter does
+static DSPAM_CTX *CreateCtx(const std::string& home)
+{
+    DSPAM_CTX *ctx = dspam_create(DSPAM_USER_NAME, NULL, home.c_str(),
+                                  DSM_PROCESS, DSF_NOISE | DSF_WHITELIST);
+    if ( !ctx )
+        return NULL;
+
+    ctx->algorithms = DSA_GRAHAM | DSA_BURTON | DSP_GRAHAM;
+    ctx->tokenizer = DSZ_CHAIN;
+
+    dspam_addattribute(ctx, "HashAutoExtend", "on");
+
+    if ( dspam_attach(ctx, NULL) != 0 )
+    {
+        dspam_destroy(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+struct Result
+{
+    int result;
+    float probability;
+};
+
+// process the message using the given context, train on it if classification
+// is not DSR_NONE
+static bool Process(DSPAM_CTX *ctx,
+                    const std::string& msg,
+                    int classification,
+                    Result& res)
+{
+    DspamResetCtx(ctx);
+
+    if ( classification != DSR_NONE )
+    {
+        ctx->classification = classification;
+        ctx->source = DSS_CORPUS;
+    }
+
+    if ( dspam_process(ctx, msg.c_str()) != 0 )
+        return false;
+
+    res.result = ctx->result;
+    res.probability = ctx->probability;
+
+    return true;
+}
+
+// process all the messages using either a new context for each of them or a
+// single context for all of them
+static bool ProcessAll(const std::string& home,
+                       const std::vector<std::string>& msgs,
+                       const std::vector<int>& classifications,
+                       bool batch,
+                       std::vector<Result>& results)
+{
+    results.resize(msgs.size());
+
+    DSPAM_CTX *ctx = NULL;
+    for ( size_t n = 0; n < msgs.size(); n++ )
+    {
+        if ( !ctx )
+        {
+            ctx = CreateCtx(home);
+            if ( !ctx )
+                return false;
+        }
+
+        if ( !Process(ctx, msgs[n], classifications[n], results[n]) )
+        {
+            dspam_destroy(ctx);
+            return false;
+        }
+
+        if ( !batch )
+        {
+            dspam_destroy(ctx);
+            ctx = NULL;
+        }
+    }
+
+    if ( ctx )
+        dspam_destroy(ctx);
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// the test
+// ----------------------------------------------------------------------------
+
+int main()
+{
+    wxInitializer init;
+
+    char dir[] = "/tmp/mdspamXXXXXX";
+    if ( !mkdtemp(dir) )
+    {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    const std::string homeSingle = std::string(dir) + "/single",
+                      homeBatch = std::string(dir) + "/batch";
+
+    // train on interleaved spam and ham messages
+    std::vector<std::string> msgs;
+    std::vector<int> classifications;
+    for ( size_t n = 0; n < COUNT_TRAIN; n++ )
+    {
+        const bool spam = n % 2 == 0;
+        msgs.push_back(MakeMessage(n, spam));
+        classifications.push_back(spam ? DSR_ISSPAM : DSR_ISINNOCENT);
+    }
+
+    std::vector<Result> resSingle, resBatch;
+    Check(ProcessAll(homeSingle, msgs, classifications, false, resSingle),
+          "training with a context per message failed");
+    Check(ProcessAll(homeBatch, msgs, classifications, true, resBatch),
+          "training with a single context failed");
+
+    // now classify some new messages
+    msgs.clear();
+    classifications.clear();
+    for ( size_t n = 0; n < COUNT_CHECK; n++ )
+    {
+        msgs.push_back(MakeMessage(COUNT_TRAIN + n, n % 2 == 0));
+        classifications.push_back(DSR_NONE);
+    }
+
+    Check(ProcessAll(homeSingle, msgs, classifications, false, resSingle),
+          "classifying with a context per message failed");
+    Check(ProcessAll(homeBatch, msgs, classifications, true, resBatch),
+          "classifying with a single context failed");
+
+    if ( resSingle.size() == COUNT_CHECK && resBatch.size() == COUNT_CHECK )
+    {
+        for ( size_t n = 0; n < COUNT_CHECK; n++ )
+        {
+            if ( resBatch[n].result != resSingle[n].result ||
+                    resBatch[n].probability != resSingle[n].probability )
+            {
+                printf("ERROR: message %lu classified differently in batch "
+                       "(%d, %g instead of %d, %g)\n",
+                       (unsigned long)n,
+                       resBatch[n].result, resBatch[n].probability,
+                       resSingle[n].result, resSingle[n].probability);
+                gs_rc = EXIT_FAILURE;
+            }
+
+            const int expected = n % 2 == 0 ? DSR_ISSPAM : DSR_ISINNOCENT;
+            if ( resSingle[n].result != expected )
+            {
+                printf("ERROR: message %lu misclassified\n", (unsigned long)n);
+                gs_rc = EXIT_FAILURE;
+            }
+        }
+    }
+
+    const std::string cleanup = std::string("rm -rf ") + dir;
+    if ( system(cleanup.c_str()) != 0 )
+        printf("WARNING: failed to remove %s\n", dir);
+
+    if ( gs_rc == EXIT_SUCCESS )
+        printf("all tests passed\n");
+
+    return gs_rc;
+}
@@ -0,0 +1,224 @@
+// Scroll benchmark for FolderListCache: simulates scrolling through a big
+// folder at different speeds, in the same way as wxFolderListCtrl uses the
+// cache (every visible cell is requested when painting and the rows are
+// prefilled during idle time between the frames) and counts the number of
+// cells formatted during each frame.
+//
+// Also checks that the cached rows are invalidated correctly.
+//
+// Run "./bench [messages-count]".
+
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include <stdlib.h>
+
+typedef unsigned long UIdType;
+
+#include "gui/FolderListCache.h"
+
+// the number of columns, as in the real folder view
+static const size_t COLUMNS = 6;
+
+// the number of visible rows
+static const long PAGE = 40;
+
+// the number of frames to simulate for each speed
+static const long FRAMES = 1000;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// the messages are sorted in some order, so UIDs don't coincide with positions
+static UIdType UIdFromPos(long pos)
+{
+    return 3*pos + 17;
+}
+
+// the number of times FormatCell() was called
+static unsigned long gs_countFormats = 0;
+
+// the status of the messages, changing it must invalidate the row
+static int gs_status = 0;
+
+// the real control formats the dates and addresses here
+static wxString FormatCell(long pos, size_t col)
+{
+    gs_countFormats++;
+
+    wxString s;
+    s.Printf("%lu/%lu/%d", (unsigned long)UIdFromPos(pos),
+             (unsigned long)col, gs_status);
+    return s;
+}
+
+// the same logic as wxFolderListCtrl::GetRow()
+static const FolderListRow *GetRow(FolderListCache& cache, long pos)
+{
+    const FolderListRow *row = cache.Get(UIdFromPos(pos));
+    if ( !row )
+    {
+        FolderListRow& rowNew = cache.Add(UIdFromPos(pos));
+        for ( size_t col = 0; col < COLUMNS; col++ )
+            rowNew.cells.Add(FormatCell(pos, col));
+
+        row = &rowNew;
+    }
+
+    return row;
+}
+
+// paint all the visible cells
+static void Paint(FolderListCache *cache, long top)
+{
+    for ( long pos = top; pos < top + PAGE; pos++ )
+    {
+        for ( size_t col = 0; col < COLUMNS; col++ )
+        {
+            if ( cache )
+                (void)GetRow(*cache, pos)->cells[col];
+            else
+                (void)FormatCell(pos, col);
+        }
+    }
+}
+
+// the same logic as wxFolderListCtrl::PrefillRows()
+static void Idle(FolderListCache& cache, long top, long count)
+{
+    long from, to;
+    if ( cache.GetPrefillRange(top, PAGE, count, &from, &to) )
+    {
+        for ( long pos = from; pos < to; pos++ )
+            GetRow(cache, pos);
+    }
+}
+
+enum Mode
+{
+    Mode_NoCache,
+    Mode_Cache,
+    Mode_Prefill,
+    Mode_Max
+};
+
+static void Scroll(Mode mode, long count, long speed)
+{
+    FolderListCache cache;
+
+    unsigned long formatsPaint = 0,
+                  formatsIdle = 0,
+                  formatsMax = 0;
+
+    wxStopWatch sw;
+
+    // scroll down and then back up
+    long top = 0;
+    for ( long frame = 0; frame < FRAMES; frame++ )
+    {
+        if ( frame == FRAMES / 2 )
+            speed = -speed;
+
+        top += speed;
+        if ( top < 0 )
+            top = 0;
+        else if ( top > count - PAGE )
+            top = count - PAGE;
+
+        unsigned long before = gs_countFormats;
+        Paint(mode == Mode_NoCache ? NULL : &cache, top);
+
+        const unsigned long formats = gs_countFormats - before;
+        formatsPaint += formats;
+        if ( formats > formatsMax )
+            formatsMax = formats;
+
+        if ( mode == Mode_Prefill )
+        {
+            before = gs_countFormats;
+            Idle(cache, top, count);
+            formatsIdle += gs_countFormats - before;
+        }
+    }
+
+    static const char *names[] = { "no cache", "cache", "prefill" };
+
+    printf("%-10s %6ld %12.1f %12lu %12.1f %10ld\n",
+           names[mode], labs(speed),
+           (double)formatsPaint / FRAMES, formatsMax,
+           (double)formatsIdle / FRAMES, sw.Time());
+}
+
+static void TestInvalidation()
+{
+    FolderListCache cache;
+
+    const FolderListRow *row = GetRow(cache, 10);
+    Check(row->cells[0] == FormatCell(10, 0), "unexpected cell text");
+
+    gs_countFormats = 0;
+    GetRow(cache, 10);
+    Check(gs_countFormats == 0, "cached row formatted again");
+
+    // this is what OnMsgStatusEvent() does
+    gs_status = 1;
+    cache.Invalidate(UIdFromPos(10));
+    row = GetRow(cache, 10);
+    Check(row->cells[0].EndsWith("/1"), "status change not taken into account");
+
+    // and this happens when the listing or options change
+    GetRow(cache, 11);
+    cache.Clear();
+    Check(cache.GetCount() == 0, "cache not cleared");
+
+    // the cache must not grow indefinitely
+    FolderListCache cacheSmall(100);
+    for ( long pos = 0; pos < 1000; pos++ )
+        GetRow(cacheSmall, pos);
+    Check(cacheSmall.GetCount() <= 100, "cache too big");
+
+    // prefill must follow the scrolling direction and speed
+    long from, to;
+    Check(cache.GetPrefillRange(100, PAGE, 1000, &from, &to) &&
+            from == 100 + PAGE && to == 100 + 2*PAGE,
+          "unexpected initial prefill range");
+    Check(!cache.GetPrefillRange(100, PAGE, 1000, &from, &to),
+          "prefill without scrolling");
+    Check(cache.GetPrefillRange(90, PAGE, 1000, &from, &to) &&
+            from == 80 && to == 90,
+          "unexpected prefill range when scrolling up");
+    Check(!cache.GetPrefillRange(980, PAGE, 1000, &from, &to),
+          "prefill beyond the end");
+
+    gs_status = 0;
+}
+
+int main(int argc, char **argv)
+{
+    wxInitializer init;
+
+    const long count = argc > 1 ? atol(argv[1]) : 100000;
+
+    TestInvalidation();
+
+    printf("%-10s %6s %12s %12s %12s %10s\n",
+           "mode", "speed", "paint/frame", "paint max", "idle/frame",
+           "time (ms)");
+
+    static const long speeds[] = { 3, 20, 40, 100 };
+    for ( size_t n = 0; n < WXSIZEOF(speeds); n++ )
+    {
+        for ( int mode = 0; mode < Mode_Max; mode++ )
+            Scroll((Mode)mode, count, speeds[n]);
+    }
+
+    return gs_rc;
+}
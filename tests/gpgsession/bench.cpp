@@ -0,0 +1,212 @@
+// Test and benchmark for GnuPGSession: creates a temporary keyring with a new
+// key, signs a number of messages with it and checks that all of them are
+// verified correctly in a batch, including text signatures of the messages
+// with Unix line endings and a tampered message in the middle of the batch.
+// Then compares the time needed to verify all messages in a single batch with
+// the time needed to run gpg for each of them separately.
+//
+// Run "./bench [messages-count]", gpg must be in PATH.
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/arrstr.h>
+#include <wx/stopwatch.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+typedef wxString String;
+
+#include "GnuPGSession.h"
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+static bool HasStatus(const GnuPGSession::DetachedSignature& sig,
+                      const char *code)
+{
+    const size_t len = strlen(code);
+    for ( size_t n = 0; n < sig.status.size(); n++ )
+    {
+        if ( sig.status[n].compare(0, len, code) == 0 )
+            return true;
+    }
+
+    return false;
+}
+
+static std::string ReadFile(const std::string& filename)
+{
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    std::ostringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+static void WriteFile(const std::string& filename, const std::string& data)
+{
+    std::ofstream f(filename.c_str(), std::ios::binary);
+    f << data;
+}
+
+// create the message text, using CRLF or LF line endings
+static std::string MakeMessage(unsigned n, const char *eol)
+{
+    std::ostringstream s;
+    s << "Content-Type: text/plain; charset=us-ascii" << eol
+      << "Content-Transfer-Encoding: 7bit" << eol
+      << eol
+      << "This is the signed message number " << n << "." << eol;
+    for ( unsigned line = 0; line < 20 + n % 30; line++ )
+        s << "Some more text to make the message longer, line " << line << eol;
+
+    return s.str();
+}
+
+int main(int argc, char **argv)
+{
+    wxInitializer init;
+
+    const unsigned count = argc > 1 ? atoi(argv[1]) : 100;
+
+    char home[] = "/tmp/mgpgXXXXXX";
+    if ( !mkdtemp(home) )
+    {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    const std::string dir(home);
+    setenv("GNUPGHOME", home, 1);
+
+    if ( system("gpg --batch --quiet --passphrase '' "
+                "--quick-gen-key 'Mahogany Test <test@example.com>' "
+                "default sign never 2>/dev/null") != 0 )
+    {
+        printf("ERROR: failed to create the test key\n");
+        return EXIT_FAILURE;
+    }
+
+    // sign the messages: use text signatures for a half of them, as most
+    // mailers do, and also use Unix line endings for some of those as
+    // sometimes happens when the message is saved locally
+    GnuPGSession::DetachedSignatures sigs(count);
+    for ( unsigned n = 0; n < count; n++ )
+    {
+        const bool text = n % 2 == 1;
+        const std::string data = MakeMessage(n, text && n % 4 == 1 ? "\n"
+                                                                   : "\r\n");
+        const std::string file = dir + "/msg";
+        WriteFile(file, data);
+
+        const std::string cmd = "gpg --batch --quiet --armor --yes "
+                                "--detach-sign " +
+                                std::string(text ? "--textmode " : "") +
+                                "--output " + file + ".asc " + file;
+        if ( system(cmd.c_str()) != 0 )
+        {
+            printf("ERROR: failed to sign message %u\n", n);
+            return EXIT_FAILURE;
+        }
+
+        sigs[n].data = data;
+        sigs[n].signature = ReadFile(file + ".asc");
+
+        Check(!GnuPGSession::MakeSignedMessage(sigs[n]).empty(),
+              "failed to create signed message");
+    }
+
+    // check that binary signatures are accepted too but not if anything
+    // follows the signature packet, e.g. a literal data packet with other
+    // data which would be verified instead of the message
+    {
+        const std::string file = dir + "/msg";
+        WriteFile(file, sigs[0].data);
+        const std::string cmd = "gpg --batch --quiet --yes --detach-sign "
+                                "--output " + file + ".sig " + file;
+        if ( system(cmd.c_str()) != 0 )
+        {
+            printf("ERROR: failed to create binary signature\n");
+            return EXIT_FAILURE;
+        }
+
+        GnuPGSession::DetachedSignature sig;
+        sig.data = sigs[0].data;
+        sig.signature = ReadFile(file + ".sig");
+        Check(!GnuPGSession::MakeSignedMessage(sig).empty(),
+              "failed to create signed message from binary signature");
+
+        static const char literal[] = "\xcb\x07" "b\0\0\0\0\0" "x";
+        sig.signature.append(literal, sizeof(literal) - 1);
+        Check(GnuPGSession::MakeSignedMessage(sig).empty(),
+              "signature followed by another packet not rejected");
+    }
+
+    GnuPGSession session("gpg");
+
+    // check that all the signatures are verified by a single process
+    Check(session.VerifyDetached(sigs), "failed to run gpg");
+    for ( unsigned n = 0; n < count; n++ )
+    {
+        if ( !sigs[n].processed || !HasStatus(sigs[n], "GOODSIG") )
+        {
+            printf("ERROR: signature %u not verified\n", n);
+            gs_rc = EXIT_FAILURE;
+        }
+    }
+
+    const size_t batches = (count + GnuPGSession::GetMaxBatchSize() - 1) /
+                                GnuPGSession::GetMaxBatchSize();
+    Check(session.GetProcessCount() == batches, "unexpected number of gpg runs");
+
+    // gpg stops after the first bad signature, check that the remaining ones
+    // are still verified
+    GnuPGSession::DetachedSignatures bad(sigs.begin(), sigs.begin() + 5);
+    bad[2].data[bad[2].data.length() / 2] ^= 1;
+    bad[3].signature = "-----BEGIN PGP SIGNATURE-----\r\n\r\n!!!\r\n";
+    Check(session.VerifyDetached(bad), "failed to run gpg");
+
+    Check(HasStatus(bad[0], "GOODSIG") && HasStatus(bad[1], "GOODSIG"),
+          "good signatures before the bad one not verified");
+    Check(HasStatus(bad[2], "BADSIG"), "bad signature not detected");
+    Check(HasStatus(bad[3], "NODATA"), "corrupted signature not detected");
+    Check(HasStatus(bad[4], "GOODSIG"),
+          "good signature after the bad one not verified");
+
+    // finally compare the time taken by verifying the signatures in a batch
+    // and one by one, as PGPEngine used to do
+    wxStopWatch sw;
+    session.VerifyDetached(sigs);
+    const long timeBatch = sw.Time();
+
+    sw.Start();
+    for ( unsigned n = 0; n < count; n++ )
+    {
+        GnuPGSession::DetachedSignatures one(1, sigs[n]);
+        session.VerifyDetached(one);
+        Check(HasStatus(one[0], "GOODSIG"), "signature not verified alone");
+    }
+    const long timeSingle = sw.Time();
+
+    printf("%u signatures: %ldms in batch, %ldms one by one (%.1fx)\n",
+           count, timeBatch, timeSingle,
+           timeBatch ? (double)timeSingle / timeBatch : 0.);
+
+    const std::string cleanup = "rm -rf " + dir;
+    if ( system(cleanup.c_str()) != 0 )
+        printf("WARNING: failed to remove %s\n", home);
+
+    return gs_rc;
+}
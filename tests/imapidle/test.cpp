@@ -0,0 +1,345 @@
+// Test for the c-client functions used by MailFolder::CheckFolders() and
+// MailFolder::WatchFolder(): runs a scripted IMAP server in a child process
+// and checks that the STATUS commands for several mailboxes are sent to it
+// together, without waiting for the replies, and that IDLE can be started,
+// polled without blocking and terminated either explicitly or by sending the
+// next command.
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#   define private cc__private
+#   define namespace cc__namespace
+#   include <stdio.h>
+#   include <mail.h>
+#   include <osdep.h>
+#   include <misc.h>
+#   undef LOCAL
+#   include <imap4r1.h>
+#   undef namespace
+#   undef private
+#   undef write
+#   undef T
+}
+
+extern "C" DRIVER imapdriver;
+
+static const unsigned long COUNT_MAILBOXES = 3;
+static const unsigned long COUNT_NEW = 5;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// scripted server
+// ----------------------------------------------------------------------------
+
+class Server
+{
+public:
+    Server(int fd) : m_fd(fd) { }
+
+    void Run();
+
+private:
+    // read the next line into the buffer, return false on EOF
+    bool FillLine();
+
+    // read everything already sent by the client without blocking
+    void ReadAvailable();
+
+    void Send(const std::string& s)
+    {
+        const std::string line = s + "\r\n";
+        if ( write(m_fd, line.data(), line.size()) != (ssize_t)line.size() )
+            _exit(EXIT_FAILURE);
+    }
+
+    int m_fd;
+    std::string m_buf;
+};
+
+bool Server::FillLine()
+{
+    while ( m_buf.find("\r\n") == std::string::npos )
+    {
+        char buf[4096];
+        const ssize_t n = read(m_fd, buf, sizeof(buf));
+        if ( n <= 0 )
+            return false;
+
+        m_buf.append(buf, n);
+    }
+
+    return true;
+}
+
+void Server::ReadAvailable()
+{
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+    char buf[4096];
+    ssize_t n;
+    while ( (n = read(m_fd, buf, sizeof(buf))) > 0 )
+        m_buf.append(buf, n);
+
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_NONBLOCK);
+}
+
+void Server::Run()
+{
+    Send("* OK [CAPABILITY IMAP4rev1 IDLE] test server ready");
+
+    unsigned long countStatus = 0;
+    for ( ;; )
+    {
+        if ( !FillLine() )
+            break;
+
+        const size_t eol = m_buf.find("\r\n");
+        const std::string line = m_buf.substr(0, eol);
+        m_buf.erase(0, eol + 2);
+
+        const size_t posCmd = line.find(' ');
+        const std::string tag = line.substr(0, posCmd);
+        std::string cmd = posCmd == std::string::npos ? std::string()
+                                                      : line.substr(posCmd + 1);
+        cmd = cmd.substr(0, cmd.find(' '));
+
+        if ( cmd == "CAPABILITY" )
+        {
+            Send("* CAPABILITY IMAP4rev1 IDLE");
+        }
+        else if ( cmd == "LOGOUT" )
+        {
+            Send("* BYE bye");
+            Send(tag + " OK LOGOUT completed");
+            break;
+        }
+        else if ( cmd == "SELECT" || cmd == "EXAMINE" )
+        {
+            Send("* 1 EXISTS");
+            Send("* 0 RECENT");
+            Send("* OK [UIDVALIDITY 1] ok");
+            Send("* OK [UIDNEXT 2] ok");
+        }
+        else if ( cmd == "STATUS" )
+        {
+            // give the client the time to send all the other commands and
+            // then return the number of the STATUS commands received so far
+            // as the number of messages
+            usleep(100000);
+            ReadAvailable();
+
+            size_t pos = 0;
+            unsigned long countPending = 0;
+            while ( (pos = m_buf.find(" STATUS ", pos)) != std::string::npos )
+            {
+                countPending++;
+                pos++;
+            }
+
+            const size_t start = line.find('"'),
+                         end = line.find('"', start + 1);
+
+            char buf[1024];
+            sprintf(buf, "* STATUS %s (MESSAGES %lu UNSEEN 0)",
+                    line.substr(start, end - start + 1).c_str(),
+                    ++countStatus + countPending);
+            Send(buf);
+        }
+        else if ( cmd == "IDLE" )
+        {
+            Send("+ idling");
+
+            // notify the client about new mail a bit later
+            usleep(300000);
+
+            char buf[64];
+            sprintf(buf, "* %lu EXISTS", COUNT_NEW);
+            Send(buf);
+
+            if ( !FillLine() || m_buf.compare(0, 6, "DONE\r\n") != 0 )
+                break;
+            m_buf.erase(0, 6);
+        }
+
+        Send(tag + " OK " + cmd + " completed");
+    }
+
+    close(m_fd);
+}
+
+// ----------------------------------------------------------------------------
+// c-client callbacks
+// ----------------------------------------------------------------------------
+
+static std::vector<unsigned long> gs_statusMessages;
+
+void mm_status(MAILSTREAM *, char *, MAILSTATUS *status)
+{
+    gs_statusMessages.push_back(status->messages);
+}
+
+void mm_login(NETMBX *, char *user, char *pwd, long)
+{
+    strcpy(user, "test");
+    strcpy(pwd, "test");
+}
+
+void mm_log(char *string, long errflg)
+{
+    if ( errflg == ERROR )
+        printf("c-client error: %s\n", string);
+}
+
+void mm_notify(MAILSTREAM *stream, char *string, long errflg)
+{
+    mm_log(string, errflg);
+}
+
+void mm_exists(MAILSTREAM *, unsigned long) { }
+void mm_expunged(MAILSTREAM *, unsigned long) { }
+void mm_flags(MAILSTREAM *, unsigned long) { }
+void mm_searched(MAILSTREAM *, unsigned long) { }
+void mm_list(MAILSTREAM *, int, char *, long) { }
+void mm_lsub(MAILSTREAM *, int, char *, long) { }
+void mm_dlog(char *) { }
+void mm_critical(MAILSTREAM *) { }
+void mm_nocritical(MAILSTREAM *) { }
+long mm_diskerror(MAILSTREAM *, long, long) { return 1; }
+void mm_fatal(char *string) { printf("c-client fatal error: %s\n", string); }
+
+// ----------------------------------------------------------------------------
+// test
+// ----------------------------------------------------------------------------
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    const int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t len = sizeof(addr);
+    if ( bind(sock, (sockaddr *)&addr, len) != 0 ||
+            listen(sock, 1) != 0 ||
+                getsockname(sock, (sockaddr *)&addr, &len) != 0 )
+    {
+        perror("failed to create the server socket");
+        return EXIT_FAILURE;
+    }
+
+    const pid_t pid = fork();
+    if ( !pid )
+    {
+        const int fd = accept(sock, NULL, NULL);
+        if ( fd == -1 )
+            _exit(EXIT_FAILURE);
+
+        Server(fd).Run();
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(sock);
+
+    mail_link(&imapdriver);
+
+    char server[256];
+    sprintf(server, "{127.0.0.1:%u/imap/notls/user=test}",
+            (unsigned)ntohs(addr.sin_port));
+
+    MAILSTREAM *stream = mail_open(NIL, server, OP_HALFOPEN);
+    Check(stream != NIL, "failed to connect to the server");
+    if ( !stream )
+        return EXIT_FAILURE;
+
+    // check the status of several mailboxes at once
+    std::vector<std::string> names;
+    std::vector<char *> mailboxes;
+    for ( unsigned long n = 0; n < COUNT_MAILBOXES; n++ )
+    {
+        char buf[256];
+        sprintf(buf, "%sbox%lu", server, n);
+        names.push_back(buf);
+    }
+
+    for ( unsigned long n = 0; n < COUNT_MAILBOXES; n++ )
+        mailboxes.push_back(const_cast<char *>(names[n].c_str()));
+
+    Check(imap_status_send(stream, &mailboxes[0], COUNT_MAILBOXES,
+                           SA_MESSAGES | SA_UNSEEN) == COUNT_MAILBOXES,
+          "not all STATUS commands were sent");
+
+    long results[COUNT_MAILBOXES];
+    Check(imap_status_receive(stream, results) != NIL,
+          "failed to receive STATUS replies");
+
+    for ( unsigned long n = 0; n < COUNT_MAILBOXES; n++ )
+        Check(results[n] != NIL, "STATUS command failed");
+
+    Check(gs_statusMessages.size() == COUNT_MAILBOXES,
+          "unexpected number of STATUS replies");
+    Check(!gs_statusMessages.empty() &&
+            gs_statusMessages[0] == COUNT_MAILBOXES,
+          "STATUS commands were not pipelined");
+
+    // now watch a mailbox for new mail
+    std::string inbox = std::string(server) + "INBOX";
+    stream = mail_open(stream, const_cast<char *>(inbox.c_str()), OP_READONLY);
+    Check(stream != NIL && stream->nmsgs == 1, "failed to open INBOX");
+    if ( !stream )
+        return EXIT_FAILURE;
+
+    Check(imap_idle_start(stream) != NIL, "failed to start IDLE");
+    Check(imap_idle_poll(stream) == NIL, "unexpected data while idling");
+
+    bool gotNewMail = false;
+    for ( int n = 0; n < 100 && !gotNewMail; n++ )
+    {
+        usleep(50000);
+        gotNewMail = imap_idle_poll(stream) != NIL;
+    }
+
+    Check(gotNewMail, "no new mail notification while idling");
+    Check(stream->nmsgs == COUNT_NEW, "new mail notification not processed");
+    Check(imap_idle_done(stream) != NIL, "failed to stop IDLE");
+
+    // IDLE must be terminated automatically when sending another command
+    Check(imap_idle_start(stream) != NIL, "failed to restart IDLE");
+    Check(mail_ping(stream) != NIL, "failed to send command after IDLE");
+
+    mail_close(stream);
+
+    int status;
+    waitpid(pid, &status, 0);
+    Check(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS,
+          "server failed");
+
+    if ( gs_rc == EXIT_SUCCESS )
+        printf("all tests passed\n");
+
+    return gs_rc;
+}
@@ -0,0 +1,190 @@
+// Test for URL detection: checks that FindURL() gives the expected results
+// for the known inputs, which are the results of the original implementation
+// of it, at all possible alignments of the text and measures its throughput
+// on a big message body.
+//
+// Run "./test -b" to also run the benchmark.
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/stopwatch.h>
+
+#include <string.h>
+
+typedef wxString String;
+
+extern int FindURL(const wxChar *s, int& len);
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *what, const char *text)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s for \"%s\"\n", what, text);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// convert the test data to a string without using any conversions, so that
+// 8 bit characters are preserved independently of the current locale
+static String MakeString(const char *s)
+{
+    String str;
+    for ( ; *s; s++ )
+        str += (wxChar)(unsigned char)*s;
+
+    return str;
+}
+
+// ----------------------------------------------------------------------------
+// the known inputs
+// ----------------------------------------------------------------------------
+
+static const struct TestCase
+{
+    const char *text;
+    int pos,
+        len;
+} testCases[] =
+{
+    { "no URLs in this text at all", -1, 0 },
+    { "see http://www.example.com/ for details", 4, 23 },
+    { "secure https://example.org/path/to/page.html?x=1&y=2#frag.", 7, 50 },
+    { "(http://example.com/foo)", 1, 22 },
+    { "mailto://someone@example.com", 0, 28 },
+    { "ftp://ftp.example.com/pub/file.tar.gz", 0, 37 },
+    { "sftp://host.example.com/home/user", 0, 33 },
+    { "file:///usr/share/doc/index.html", 0, 32 },
+    { "visit www.example.com today", 6, 15 },
+    { "visit www.example, it's good", -1, 0 },
+    { "get it from ftp.example.com/pub", 12, 19 },
+    { "... using ftp.If you want", -1, 0 },
+    { "write to john.doe@example.com please", 9, 20 },
+    { "write to <john.doe@example.com> please", 9, 22 },
+    { "write to <john.doe@example.com please", 10, 20 },
+    { "user@host", -1, 0 },
+    { "a@b.c", -1, 0 },
+    { "an @ sign alone", -1, 0 },
+    // this used to read the character before the start of the text
+    { "@example.com at start", 0, 12 },
+    { "trailing punctuation http://example.com/page.", 21, 23 },
+    { "question http://example.com/?", 9, 19 },
+    { "list: http://a.example.com/, http://b.example.com/!", 6, 21 },
+    { "wrapped http://www.example.com/very/long/path/which/is/wrap\r\nped.html here", 8, 53 },
+    { "http://www.example.com/long/path/to/some/file.ht\r\nml", 0, 52 },
+    { "http://www.example.com/a/b/c/\r\nhttp://www.example.org/d/", 0, 29 },
+    { "http://www.example.com/a/b/c/\r\nwords after it", 0, 29 },
+    { "  http://www.example.com/dir/\r\n--\r\nsignature", 2, 27 },
+    { "> http://www.example.com/dir/\r\nfoo/bar.cgi", 2, 27 },
+    { "text http://www.example.com/dir/\r\nfoo/bar.cgi", 5, 27 },
+    { "www.@example.com", 0, 16 },
+    { "ftp.@x.y", 0, 8 },
+    { "https://[2001:db8::1]/index.html", 0, 32 },
+    { "http://example.com/%7Euser/", 0, 27 },
+    { "dup http://http://example.com", 4, 25 },
+    { "caf\xe9@example.fr", 0, 15 },
+    { "x|foo@bar.com|y", 2, 11 },
+    { "http://", 0, 7 },
+    { "www.", -1, 0 },
+    { "mailto:someone@example.com", 7, 19 },
+    { "http://example.com/a http://example.com/b", 0, 20 },
+};
+
+static void TestKnown()
+{
+    for ( size_t n = 0; n < WXSIZEOF(testCases); n++ )
+    {
+        const TestCase& tc = testCases[n];
+
+        // prepend some spaces to the text to check that the results don't
+        // depend on its alignment
+        for ( size_t shift = 0; shift < 16; shift++ )
+        {
+            const String text = String(' ', shift) + MakeString(tc.text);
+
+            int len = -1;
+            const int pos = FindURL(text.c_str(), len);
+            if ( tc.pos == -1 )
+            {
+                Check(pos == -1, "unexpected match", tc.text);
+            }
+            else
+            {
+                Check(pos == tc.pos + (int)shift, "wrong match position", tc.text);
+                Check(len == tc.len, "wrong match length", tc.text);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// the benchmark
+// ----------------------------------------------------------------------------
+
+static void Benchmark()
+{
+    static const char *lines[] =
+    {
+        "Plain text of the message without anything special in it at all.\r\n",
+        "> and it still crashes when opening a folder with many messages.\r\n",
+        ">> Did you try the workaround from the FAQ? It should help.\r\n",
+        "> I tried the new version from http://www.example.com/download/\r\n",
+        "Write to list-owner@example.com if you have any problems with it.\r\n",
+    };
+
+    // one line in 5 has an URL or an address in it
+    String text;
+    unsigned long countExpected = 0;
+    for ( size_t n = 0; text.length() < 8*1024*1024; n++ )
+    {
+        size_t line = n % 10;
+        if ( line == 4 || line == 9 )
+        {
+            line = line == 4 ? 3 : 4;
+            countExpected++;
+        }
+        else
+        {
+            line %= 3;
+        }
+
+        text += lines[line];
+    }
+
+    static const int ITERATIONS = 10;
+
+    unsigned long count = 0;
+    wxStopWatch sw;
+    for ( int i = 0; i < ITERATIONS; i++ )
+    {
+        const wxChar *p = text.c_str();
+        int pos, len;
+        while ( (pos = FindURL(p, len)) != -1 )
+        {
+            p += pos + len;
+            count++;
+        }
+    }
+
+    const long time = sw.Time();
+
+    Check(count == ITERATIONS*countExpected, "wrong number of URLs",
+          "benchmark");
+
+    const double mb = (double)ITERATIONS*text.length()*sizeof(wxChar)/1024/1024;
+    printf("Found %lu URLs in %.0f MB in %ld ms (%.0f MB/s)\n",
+           count, mb, time, time ? mb*1000/time : 0.);
+}
+
+int main(int argc, char **argv)
+{
+    wxInitializer init;
+
+    TestKnown();
+
+    if ( argc > 1 && strcmp(argv[1], "-b") == 0 )
+        Benchmark();
+
+    return gs_rc;
+}
@@ -0,0 +1,396 @@
+// Test for MIME Base64 and QP codecs: checks that all implementations
+// available on this machine give the expected results for the known inputs
+// and the same results as the scalar one for random data, which must also
+// survive the round trip, checks that decoding the data in chunks of random
+// size gives the same results as decoding it at once and measures their
+// throughput on big inputs.
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/stopwatch.h>
+
+typedef wxString String;
+
+#include "mail/MimeCodec.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *codec, const char *what, unsigned n)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s codec: %s #%u failed\n", codec, what, n);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// helpers returning the results as strings
+// ----------------------------------------------------------------------------
+
+static bool DecodeBase64(const std::string& s, std::string *out)
+{
+    std::vector<char> buf(MIME::GetBase64DecodedMaxLen(s.length()));
+    size_t len;
+    if ( !MIME::DecodeBase64(s.data(), s.length(), &buf[0], &len) )
+        return false;
+
+    out->assign(&buf[0], len);
+    return true;
+}
+
+static std::string EncodeBase64(const std::string& s, size_t lineLen = 0)
+{
+    std::vector<char> buf(MIME::GetBase64EncodedMaxLen(s.length(), lineLen) + 1);
+    const size_t len = MIME::EncodeBase64(s.data(), s.length(), &buf[0], lineLen);
+    return std::string(&buf[0], len);
+}
+
+static std::string DecodeQP(const std::string& s)
+{
+    std::vector<char> buf(MIME::GetQPDecodedMaxLen(s.length()) + 1);
+    const size_t len = MIME::DecodeQP(s.data(), s.length(), &buf[0]);
+    return std::string(&buf[0], len);
+}
+
+static std::string EncodeQP(const std::string& s)
+{
+    std::vector<char> buf(MIME::GetQPEncodedMaxLen(s.length()) + 1);
+    const size_t len = MIME::EncodeQP(s.data(), s.length(), &buf[0]);
+    return std::string(&buf[0], len);
+}
+
+// ----------------------------------------------------------------------------
+// test data
+// ----------------------------------------------------------------------------
+
+// return random binary data
+static std::string MakeBinary(size_t len)
+{
+    std::string s(len, '\0');
+    for ( size_t n = 0; n < len; n++ )
+        s[n] = (char)(rand() & 0xff);
+
+    return s;
+}
+
+// return random mostly ASCII text with some 8 bit characters, spaces at the
+// end of lines and other special cases for the QP encoder
+static std::string MakeText(size_t len)
+{
+    static const char *words[] =
+    {
+        "Mahogany", "mail", "=", "\xc3\xa9t\xc3\xa9", "\t", " ", "   ",
+        "\r\n", " \r\n", "\n", "\r", "=3D", "a_very_long_word_without_any_"
+        "spaces_in_it_which_must_be_wrapped_using_a_soft_line_break"
+    };
+
+    std::string s;
+    while ( s.length() < len )
+    {
+        s += words[rand() % WXSIZEOF(words)];
+        if ( rand() % 2 )
+            s += ' ';
+    }
+
+    s.resize(len);
+    return s;
+}
+
+static void TestKnown(const char *codec)
+{
+    static const struct Base64Data
+    {
+        const char *encoded;
+        const char *decoded;        // NULL if decoding must fail
+    } base64[] =
+    {
+        { "", "" },
+        { "Zg==", "f" },
+        { "Zm8=", "fo" },
+        { "Zm9v", "foo" },
+        { "Zm9vYg==", "foob" },
+        { "Zm9vYmE=", "fooba" },
+        { "Zm9vYmFy", "foobar" },
+        { "Zm9v\r\nYmFy\r\n", "foobar" },
+        { " Zm 9v\tYm\r\nFy ", "foobar" },
+        { "Zg==\r\n-- \r\nsignature", "f" },
+        { "Zg=", NULL },
+        { "Zg=a", NULL },
+        { "Zm9v!", NULL },
+        { "Zm9v\xe9", NULL },
+        { "VGhpcyBpcyBhIGxvbmcgbGluZSBvZiBCYXNlNjQgZW5jb2RlZCB0ZXh0IHdo"
+          "aWNoIHNob3VsZCBiZSBkZWNvZGVkIGJ5IGJsb2Nrcw==",
+          "This is a long line of Base64 encoded text which should be "
+          "decoded by blocks" },
+        { "VGhpcyBpcyBhIGxvbmcgbGluZSBvZiBCYXNlNjQgZW5jb2Rl!ZCB0ZXh0IHdo",
+          NULL },
+    };
+
+    for ( unsigned n = 0; n < WXSIZEOF(base64); n++ )
+    {
+        const Base64Data& d = base64[n];
+
+        std::string s;
+        const bool ok = DecodeBase64(d.encoded, &s);
+        Check(d.decoded ? ok && s == d.decoded : !ok, codec, "Base64 decoding", n);
+    }
+
+    static const struct QPData
+    {
+        const char *encoded;
+        const char *decoded;
+    } qpDecode[] =
+    {
+        { "", "" },
+        { "plain text", "plain text" },
+        { "=41=42=c3=A9", "AB\xc3\xa9" },
+        { "soft=\r\nbreak", "softbreak" },
+        { "soft=\nbreak", "softbreak" },
+        { "trailing  \r\nspaces \t \nremoved   ", "trailing\r\nspaces \t\nremoved   " },
+        { "kept  =\r\n", "kept  " },
+        { "=zz", "=zz" },
+        { "=4z!", "=4!" },
+        { "=4", "=4" },
+        { "end=", "end" },
+    };
+
+    for ( unsigned n = 0; n < WXSIZEOF(qpDecode); n++ )
+    {
+        const QPData& d = qpDecode[n];
+        Check(DecodeQP(d.encoded) == d.decoded, codec, "QP decoding", n);
+    }
+
+    static const QPData qpEncode[] =
+    {
+        { "", "" },
+        { "plain text", "plain text" },
+        { "a=3Db=09c=E9", "a=b\tc\xe9" },
+        { "line=20\r\nbreak\r\n", "line \r\nbreak\r\n" },
+        { "bare=0DCR=0ALF=20=0D", "bare\rCR\nLF \r" },
+    };
+
+    for ( unsigned n = 0; n < WXSIZEOF(qpEncode); n++ )
+    {
+        const QPData& d = qpEncode[n];
+        Check(EncodeQP(d.decoded) == d.encoded, codec, "QP encoding", n);
+    }
+
+    // long lines must be wrapped using soft line breaks
+    Check(EncodeQP(std::string(100, 'x')) ==
+            std::string(75, 'x') + "=\r\n" + std::string(25, 'x'),
+          codec, "QP encoding", WXSIZEOF(qpEncode));
+    Check(EncodeQP(std::string(74, 'x') + "\xe9") ==
+            std::string(74, 'x') + "=\r\n=E9",
+          codec, "QP encoding", WXSIZEOF(qpEncode) + 1);
+
+    Check(EncodeBase64("foobar") == "Zm9vYmFy", codec, "Base64 encoding", 0);
+    Check(EncodeBase64("fooba") == "Zm9vYmE=", codec, "Base64 encoding", 1);
+    Check(EncodeBase64("foob") == "Zm9vYg==", codec, "Base64 encoding", 2);
+    Check(EncodeBase64("foobar", 4) == "Zm9v\r\nYmFy\r\n",
+          codec, "Base64 encoding", 3);
+}
+
+static void TestRandom(MIME::Codec codecToTest)
+{
+    const char * const codec = MIME::GetCodecName(codecToTest);
+
+    for ( unsigned n = 0; n < 500; n++ )
+    {
+        MIME::SetCodec(MIME::Codec_Scalar);
+
+        const std::string bin = MakeBinary(n),
+                          text = MakeText(n);
+        const std::string b64 = EncodeBase64(bin, 76),
+                          b64NoEOL = EncodeBase64(bin),
+                          qpBin = EncodeQP(bin),
+                          qpText = EncodeQP(text),
+                          qpTextDecoded = DecodeQP(text);
+
+        MIME::SetCodec(codecToTest);
+
+        Check(EncodeBase64(bin, 76) == b64, codec, "Base64 random encoding", n);
+        Check(EncodeBase64(bin) == b64NoEOL, codec, "Base64 random encoding", n);
+
+        std::string s;
+        Check(DecodeBase64(b64, &s) && s == bin,
+              codec, "Base64 random round trip", n);
+        Check(DecodeBase64(b64NoEOL, &s) && s == bin,
+              codec, "Base64 random round trip", n);
+
+        Check(EncodeQP(bin) == qpBin, codec, "QP random encoding", n);
+        Check(EncodeQP(text) == qpText, codec, "QP random encoding", n);
+        Check(DecodeQP(qpBin) == bin, codec, "QP random round trip", n);
+        Check(DecodeQP(text) == qpTextDecoded, codec, "QP random decoding", n);
+    }
+}
+
+// decode the data split in chunks of random size using StreamDecoder
+static std::string
+DecodeStream(MIME::StreamDecoder::Encoding encoding,
+             const std::string& s,
+             bool keepTrailing = false,
+             bool *hasErrors = NULL)
+{
+    MIME::StreamDecoder decoder(encoding, keepTrailing);
+
+    std::string out;
+    size_t len;
+    const void *p;
+    for ( size_t pos = 0; pos < s.length(); )
+    {
+        const size_t lenChunk = rand() % 100 < 10 ? 1 + rand() % 3
+                                                  : 1 + rand() % 200;
+        p = decoder.Decode(s.data() + pos,
+                           std::min(lenChunk, s.length() - pos),
+                           &len);
+        out.append(static_cast<const char *>(p), len);
+        pos += lenChunk;
+    }
+
+    p = decoder.Flush(&len);
+    out.append(static_cast<const char *>(p), len);
+
+    if ( hasErrors )
+        *hasErrors = decoder.HasErrors();
+
+    return out;
+}
+
+static void TestStream(const char *codec)
+{
+    static const MIME::StreamDecoder::Encoding
+        BASE64 = MIME::StreamDecoder::Encoding_Base64,
+        QP = MIME::StreamDecoder::Encoding_QP;
+
+    static const struct StreamData
+    {
+        const char *encoded;
+        const char *decoded;
+        const char *decodedKeep;    // with keepTrailing == true
+        bool hasErrors;
+    } base64[] =
+    {
+        { "Zm9vYmFy\r\n", "foobar", "foobar", false },
+        { "Zg==\r\n-- \r\nsignature", "f", "f-- \r\nsignature", false },
+        { "Zm8=\r\n-- \r\n", "fo", "fo-- \r\n", false },
+        { "Zm8=", "fo", "fo", false },
+        { "Zm9v\r\n_______\r\nfooter", "foo_______\r\nfooter",
+          "foo_______\r\nfooter", true },
+        { "Zm9v!ab", "foo!ab", "foo!ab", true },
+        { "Zg=a", "Zg=a", "Zg=a", true },
+        { "Zm9vYmFy\xe9", "foobar\xe9", "foobar\xe9", true },
+    };
+
+    for ( unsigned n = 0; n < WXSIZEOF(base64); n++ )
+    {
+        const StreamData& d = base64[n];
+
+        bool hasErrors;
+        Check(DecodeStream(BASE64, d.encoded, false, &hasErrors) == d.decoded &&
+                hasErrors == d.hasErrors,
+              codec, "Base64 stream decoding", n);
+        Check(DecodeStream(BASE64, d.encoded, true, &hasErrors) == d.decodedKeep &&
+                hasErrors == d.hasErrors,
+              codec, "Base64 stream decoding with trailer", n);
+    }
+
+    for ( unsigned n = 0; n < 500; n++ )
+    {
+        const std::string bin = MakeBinary(n * 37),
+                          text = MakeText(n * 37);
+        const std::string b64 = EncodeBase64(bin, 76),
+                          b64NoEOL = EncodeBase64(bin),
+                          qpBin = EncodeQP(bin);
+
+        Check(DecodeStream(BASE64, b64) == bin,
+              codec, "Base64 random stream decoding", n);
+        Check(DecodeStream(BASE64, b64NoEOL) == bin,
+              codec, "Base64 random stream decoding", n);
+        Check(DecodeStream(QP, qpBin) == bin,
+              codec, "QP random stream decoding", n);
+        Check(DecodeStream(QP, text) == DecodeQP(text),
+              codec, "QP random stream decoding", n);
+    }
+}
+
+static double GetSpeed(size_t len, long ms)
+{
+    return (len / 1024. / 1024.) / ((ms ? ms : 1) / 1000.);
+}
+
+static void Benchmark(const char *codec)
+{
+    static const size_t LEN = 16*1024*1024;
+    static const int REPEAT = 4;
+
+    const std::string bin = MakeBinary(LEN),
+                      text = MakeText(LEN);
+
+    wxStopWatch sw;
+    std::string b64;
+    for ( int n = 0; n < REPEAT; n++ )
+        b64 = EncodeBase64(bin, 76);
+    const long msEncodeBase64 = sw.Time();
+
+    sw.Start();
+    std::string s;
+    for ( int n = 0; n < REPEAT; n++ )
+        DecodeBase64(b64, &s);
+    const long msDecodeBase64 = sw.Time();
+
+    sw.Start();
+    std::string qp;
+    for ( int n = 0; n < REPEAT; n++ )
+        qp = EncodeQP(text);
+    const long msEncodeQP = sw.Time();
+
+    sw.Start();
+    for ( int n = 0; n < REPEAT; n++ )
+        s = DecodeQP(qp);
+    const long msDecodeQP = sw.Time();
+
+    printf("%-8s Base64: encode %6.0f MB/s, decode %6.0f MB/s; "
+           "QP: encode %6.0f MB/s, decode %6.0f MB/s\n",
+           codec,
+           GetSpeed(REPEAT*LEN, msEncodeBase64),
+           GetSpeed(REPEAT*b64.length(), msDecodeBase64),
+           GetSpeed(REPEAT*LEN, msEncodeQP),
+           GetSpeed(REPEAT*qp.length(), msDecodeQP));
+}
+
+int main(int argc, char **argv)
+{
+    wxInitializer init;
+
+    const bool benchmark = argc > 1 && strcmp(argv[1], "-b") == 0;
+
+    const MIME::Codec codecDefault = MIME::GetCodec();
+    printf("Using %s codec by default.\n", MIME::GetCodecName(codecDefault));
+
+    for ( int n = 0; n < MIME::Codec_Max; n++ )
+    {
+        const MIME::Codec codec = static_cast<MIME::Codec>(n);
+        const char * const name = MIME::GetCodecName(codec);
+        if ( !MIME::SetCodec(codec) )
+        {
+            printf("%s codec not available.\n", name);
+            continue;
+        }
+
+        TestKnown(name);
+        TestRandom(codec);
+        TestStream(name);
+
+        if ( benchmark )
+            Benchmark(name);
+    }
+
+    MIME::SetCodec(codecDefault);
+
+    return gs_rc;
+}
@@ -0,0 +1,350 @@
+// Test for SendSession: runs a fake SMTP server supporting PIPELINING in a
+// child process and sends many messages through it, checking that they're
+// all sent using the same connection with the envelope commands pipelined,
+// that a message with a bad recipient fails without affecting the other ones
+// and that the messages are resent transparently when the server closes the
+// connection between them.
+
+#include <wx/init.h>
+#include <wx/string.h>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+
+typedef wxString String;
+
+#include "Mcclient.h"
+#include "FolderType.h"
+#include "mail/SendSession.h"
+
+static const unsigned COUNT = 50;
+
+// the message with this index has a recipient rejected by the server
+static const unsigned BAD_MESSAGE = 10;
+
+// the server closes the connection after this many messages
+static const unsigned MAX_PER_CONNECTION = 20;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// fake SMTP server
+// ----------------------------------------------------------------------------
+
+// the statistics collected by the server and sent back to the test
+struct ServerStats
+{
+    unsigned connections;
+    unsigned messages;
+    unsigned pipelined;
+};
+
+class Server
+{
+public:
+    Server(int fd, ServerStats& stats) : m_fd(fd), m_stats(stats) { }
+
+    void Run();
+
+private:
+    bool ReadLine(std::string& line);
+
+    bool HasBufferedLine() const
+        { return m_buf.find("\r\n") != std::string::npos; }
+
+    void Send(const char *s)
+    {
+        const std::string line = std::string(s) + "\r\n";
+        if ( write(m_fd, line.data(), line.size()) != (ssize_t)line.size() )
+            _exit(EXIT_FAILURE);
+    }
+
+    int m_fd;
+    std::string m_buf;
+    ServerStats& m_stats;
+};
+
+bool Server::ReadLine(std::string& line)
+{
+    while ( !HasBufferedLine() )
+    {
+        char buf[4096];
+        const ssize_t n = read(m_fd, buf, sizeof(buf));
+        if ( n <= 0 )
+            return false;
+
+        m_buf.append(buf, n);
+    }
+
+    const size_t eol = m_buf.find("\r\n");
+    line = m_buf.substr(0, eol);
+    m_buf.erase(0, eol + 2);
+
+    return true;
+}
+
+void Server::Run()
+{
+    Send("220 test ESMTP");
+
+    unsigned countMessages = 0;
+    std::string line;
+    while ( ReadLine(line) )
+    {
+        const std::string cmd = line.substr(0, 4);
+        if ( cmd == "EHLO" )
+        {
+            Send("250-test");
+            Send("250-PIPELINING");
+            Send("250 8BITMIME");
+        }
+        else if ( cmd == "RSET" )
+        {
+            if ( countMessages == MAX_PER_CONNECTION )
+            {
+                // pretend that the connection timed out
+                Send("421 timeout, closing connection");
+                break;
+            }
+
+            // the envelope commands must have been sent together with RSET
+            if ( HasBufferedLine() )
+                m_stats.pipelined++;
+
+            Send("250 reset");
+        }
+        else if ( cmd == "MAIL" )
+        {
+            Send("250 sender ok");
+        }
+        else if ( cmd == "RCPT" )
+        {
+            Send(line.find("<bad@") == std::string::npos ? "250 recipient ok"
+                                                         : "550 no such user");
+        }
+        else if ( cmd == "DATA" )
+        {
+            Send("354 go ahead");
+
+            while ( ReadLine(line) && line != "." )
+                ;
+
+            m_stats.messages++;
+            countMessages++;
+
+            Send("250 queued");
+        }
+        else if ( cmd == "QUIT" )
+        {
+            Send("221 bye");
+            break;
+        }
+        else
+        {
+            Send("500 unknown command");
+        }
+    }
+
+    close(m_fd);
+}
+
+// ----------------------------------------------------------------------------
+// c-client callbacks
+// ----------------------------------------------------------------------------
+
+void mm_log(char *string, long errflg)
+{
+    if ( errflg == ERROR )
+        printf("c-client error: %s\n", string);
+}
+
+void mm_notify(MAILSTREAM *, char *string, long errflg)
+{
+    mm_log(string, errflg);
+}
+
+void mm_login(NETMBX *, char *, char *, long) { }
+void mm_status(MAILSTREAM *, char *, MAILSTATUS *) { }
+void mm_exists(MAILSTREAM *, unsigned long) { }
+void mm_expunged(MAILSTREAM *, unsigned long) { }
+void mm_flags(MAILSTREAM *, unsigned long) { }
+void mm_searched(MAILSTREAM *, unsigned long) { }
+void mm_list(MAILSTREAM *, int, char *, long) { }
+void mm_lsub(MAILSTREAM *, int, char *, long) { }
+void mm_dlog(char *) { }
+void mm_critical(MAILSTREAM *) { }
+void mm_nocritical(MAILSTREAM *) { }
+long mm_diskerror(MAILSTREAM *, long, long) { return 1; }
+void mm_fatal(char *string) { printf("c-client fatal error: %s\n", string); }
+
+// ----------------------------------------------------------------------------
+// test
+// ----------------------------------------------------------------------------
+
+static void CreateMessage(unsigned n, ENVELOPE **penv, BODY **pbody)
+{
+    char buf[256];
+
+    ENVELOPE *env = mail_newenvelope();
+
+    char from[] = "sender@example.com";
+    rfc822_parse_adrlist(&env->from, from, CONST_CCAST("example.com"));
+    env->return_path = rfc822_cpy_adr(env->from);
+
+    sprintf(buf, "rcpt%u@example.com, %s@example.com",
+            n, n == BAD_MESSAGE ? "bad" : "other");
+    rfc822_parse_adrlist(&env->to, buf, CONST_CCAST("example.com"));
+
+    sprintf(buf, "Message %u", n);
+    env->subject = cpystr(buf);
+
+    rfc822_date(buf);
+    env->date = (unsigned char *)cpystr(buf);
+
+    BODY *body = mail_newbody();
+    body->type = TYPETEXT;
+
+    sprintf(buf, "This is the message number %u.\r\n", n);
+    body->contents.text.data = (unsigned char *)cpystr(buf);
+    body->contents.text.size = strlen(buf);
+
+    *penv = env;
+    *pbody = body;
+}
+
+int main()
+{
+    wxInitializer init;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    const int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t len = sizeof(addr);
+    if ( bind(sock, (sockaddr *)&addr, len) != 0 ||
+            listen(sock, 1) != 0 ||
+                getsockname(sock, (sockaddr *)&addr, &len) != 0 )
+    {
+        perror("failed to create the server socket");
+        return EXIT_FAILURE;
+    }
+
+    int pipeStats[2];
+    if ( pipe(pipeStats) != 0 )
+    {
+        perror("failed to create pipe");
+        return EXIT_FAILURE;
+    }
+
+    const pid_t pid = fork();
+    if ( !pid )
+    {
+        ServerStats stats = { 0, 0, 0 };
+
+        // serve the connections one by one until the client closes the
+        // listening socket on its side by exiting
+        for ( ;; )
+        {
+            const int fd = accept(sock, NULL, NULL);
+            if ( fd == -1 )
+                break;
+
+            stats.connections++;
+            Server(fd, stats).Run();
+
+            if ( stats.messages == COUNT - 1 )
+                break;
+        }
+
+        if ( write(pipeStats[1], &stats, sizeof(stats)) != sizeof(stats) )
+            _exit(EXIT_FAILURE);
+
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(sock);
+    close(pipeStats[1]);
+
+    const String server = String::Format("127.0.0.1:%u/notls",
+                                         (unsigned)ntohs(addr.sin_port));
+
+    unsigned countSent = 0,
+             countRetried = 0;
+    long msMax = 0;
+    {
+        SendSession session;
+        for ( unsigned n = 0; n < COUNT; n++ )
+        {
+            ENVELOPE *env;
+            BODY *body;
+            CreateMessage(n, &env, &body);
+
+            String reply;
+            if ( session.Send(Prot_SMTP, server, 0, env, body, &reply) )
+            {
+                countSent++;
+            }
+            else
+            {
+                Check(n == BAD_MESSAGE, "failed to send a message");
+                Check(reply.StartsWith("554"), "unexpected error reply");
+            }
+
+            const SendSession::Timing& timing = session.GetLastTiming();
+            if ( timing.retried )
+                countRetried++;
+            if ( timing.msConnect + timing.msSend > msMax )
+                msMax = timing.msConnect + timing.msSend;
+
+            mail_free_envelope(&env);
+            mail_free_body(&body);
+        }
+
+        Check(session.GetMessageCount() == COUNT - 1,
+              "wrong number of messages sent");
+        Check(session.GetConnectionCount() == 3,
+              "connection was not reused");
+    }
+
+    Check(countSent == COUNT - 1, "wrong number of messages sent");
+    Check(countRetried == 2, "messages were not resent after disconnection");
+
+    ServerStats stats;
+    if ( read(pipeStats[0], &stats, sizeof(stats)) != sizeof(stats) )
+    {
+        printf("ERROR: failed to get server statistics\n");
+        return EXIT_FAILURE;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    Check(stats.connections == 3, "unexpected number of connections");
+    Check(stats.messages == COUNT - 1, "server didn't receive all messages");
+    Check(stats.pipelined == COUNT, "envelope commands were not pipelined");
+
+    printf("sent %u messages, max time per message: %ld ms\n",
+           countSent, msMax);
+
+    return gs_rc;
+}
@@ -0,0 +1,324 @@
+// Benchmark for Sequence: compares the range-based Sequence with the previous
+// implementation storing the IMAP sequence string directly for big (1M
+// elements) contiguous and sparse sequences and checks that both of them
+// produce the same results.
+
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+#include <wx/string.h>
+
+#include <climits>
+
+typedef wxString String;
+typedef unsigned long UIdType;
+
+#define UID_ILLEGAL ULONG_MAX
+
+#include "Sequence.h"
+
+// ----------------------------------------------------------------------------
+// OldSequence: the previous string-based Sequence implementation
+// ----------------------------------------------------------------------------
+
+class OldSequence
+{
+public:
+    OldSequence()
+    {
+        m_count = 0;
+        m_first =
+        m_last = UID_ILLEGAL;
+    }
+
+    void Add(UIdType n)
+    {
+        m_count++;
+        if ( HasCurrentRange() && n == m_last + 1 )
+        {
+            m_last++;
+        }
+        else
+        {
+            if ( DoFlush() )
+                m_seq << ',';
+            m_seq << n;
+
+            m_first =
+            m_last = n;
+        }
+    }
+
+    String GetString() const
+    {
+        Flush();
+
+        return m_seq;
+    }
+
+    size_t GetCount() const { return m_count; }
+
+    UIdType GetFirst(size_t& cookie) const
+    {
+        Flush();
+
+        cookie = 0;
+
+        return GetNext(UID_ILLEGAL, cookie);
+    }
+
+    UIdType GetNext(UIdType n, size_t& cookie) const
+    {
+        switch ( GetCharAt(cookie) )
+        {
+            case ':':
+                {
+                    size_t pos = cookie + 1;
+                    UIdType last = GetNumberAt(pos);
+                    if ( n < last )
+                        return n + 1;
+
+                    cookie = pos;
+                }
+
+                if ( GetCharAt(cookie) != '\0' )
+                {
+                    cookie++;
+                    break;
+                }
+                // fall through
+
+            case '\0':
+                return UID_ILLEGAL;
+
+            case ',':
+                cookie++;
+                break;
+        }
+
+        return GetNumberAt(cookie);
+    }
+
+    void GetBounds(UIdType *nMin, UIdType *nMax) const
+    {
+        *nMin = UID_ILLEGAL;
+        *nMax = 0;
+
+        size_t n;
+        for ( UIdType i = GetFirst(n); i != UID_ILLEGAL; i = GetNext(i, n) )
+        {
+            if ( i < *nMin )
+                *nMin = i;
+
+            if ( i > *nMax )
+                *nMax = i;
+        }
+    }
+
+private:
+    bool HasCurrentRange() const { return m_first != UID_ILLEGAL; }
+
+    void Flush() const
+    {
+        if ( HasCurrentRange() )
+        {
+            OldSequence *self = (OldSequence *)this;
+
+            self->DoFlush();
+
+            self->m_first =
+            self->m_last = UID_ILLEGAL;
+        }
+    }
+
+    bool DoFlush()
+    {
+        if ( m_seq.empty() )
+            return false;
+
+        switch ( m_last - m_first )
+        {
+            case 0:
+                break;
+
+            case 1:
+                m_seq << ',' << m_last;
+                break;
+
+            default:
+                m_seq << ':' << m_last;
+        }
+
+        return true;
+    }
+
+    char GetCharAt(size_t pos) const
+    {
+        return pos == m_seq.length() ? '\0' : static_cast<char>(m_seq[pos]);
+    }
+
+    UIdType GetNumberAt(size_t& pos) const
+    {
+        UIdType n = 0;
+        while ( isdigit(GetCharAt(pos)) )
+        {
+            n *= 10;
+            n += m_seq[pos++] - '0';
+        }
+
+        return n;
+    }
+
+    size_t m_count;
+    UIdType m_first,
+            m_last;
+    String m_seq;
+};
+
+// ----------------------------------------------------------------------------
+// helpers
+// ----------------------------------------------------------------------------
+
+static const UIdType COUNT = 1000000;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *what)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", what);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// fill both sequences with COUNT elements every step apart and compare them
+static void Benchmark(const char *name, UIdType step)
+{
+    printf("%s sequence:\n", name);
+
+    wxStopWatch sw;
+    OldSequence seqOld;
+    for ( UIdType n = 0; n < COUNT; n++ )
+        seqOld.Add(1 + n*step);
+    const long timeAddOld = sw.Time();
+
+    sw.Start();
+    Sequence seq;
+    for ( UIdType n = 0; n < COUNT; n++ )
+        seq.Add(1 + n*step);
+    const long timeAdd = sw.Time();
+
+    Check(seq.GetCount() == COUNT && seqOld.GetCount() == COUNT,
+          "wrong number of elements");
+
+    sw.Start();
+    UIdType totalOld = 0;
+    size_t cookie;
+    for ( UIdType n = seqOld.GetFirst(cookie);
+          n != UID_ILLEGAL;
+          n = seqOld.GetNext(n, cookie) )
+    {
+        totalOld += n;
+    }
+    const long timeIterOld = sw.Time();
+
+    sw.Start();
+    UIdType total = 0;
+    for ( UIdType n = seq.GetFirst(cookie);
+          n != UID_ILLEGAL;
+          n = seq.GetNext(n, cookie) )
+    {
+        total += n;
+    }
+    const long timeIter = sw.Time();
+
+    Check(total == totalOld && total == COUNT + step*COUNT*(COUNT - 1)/2,
+          "iteration results differ");
+
+    sw.Start();
+    UIdType minOld, maxOld;
+    seqOld.GetBounds(&minOld, &maxOld);
+    const long timeBoundsOld = sw.Time();
+
+    sw.Start();
+    UIdType min, max;
+    seq.GetBounds(&min, &max);
+    const long timeBounds = sw.Time();
+
+    Check(min == 1 && max == 1 + (COUNT - 1)*step &&
+            minOld == min && maxOld == max,
+          "bounds differ");
+
+    sw.Start();
+    const String strOld = seqOld.GetString();
+    const long timeStrOld = sw.Time();
+
+    sw.Start();
+    const String str = seq.GetString();
+    const long timeStr = sw.Time();
+
+    Check(str == strOld, "sequence strings differ");
+
+    printf("%15s %10s %10s\n", "", "old (ms)", "new (ms)");
+    printf("%15s %10ld %10ld\n", "Add()", timeAddOld, timeAdd);
+    printf("%15s %10ld %10ld\n", "iteration", timeIterOld, timeIter);
+    printf("%15s %10ld %10ld\n", "GetBounds()", timeBoundsOld, timeBounds);
+    printf("%15s %10ld %10ld\n", "GetString()", timeStrOld, timeStr);
+}
+
+// test the set operations on the sequences of odd and multiple of 3 numbers
+static void TestSetOperations()
+{
+    Sequence odd,
+             triple;
+    for ( UIdType n = 1; n <= 2*COUNT; n += 2 )
+        odd.Add(n);
+
+    // add these ones in reverse order to test normalization too
+    for ( UIdType n = 3*COUNT; n > 0; n -= 3 )
+        triple.Add(n);
+
+    wxStopWatch sw;
+    const Sequence both = odd.Union(triple),
+                   common = odd.Intersection(triple),
+                   oddOnly = odd.Difference(triple);
+    const long timeSet = sw.Time();
+
+    // the odd multiples of 3 are in both sequences, there are COUNT/3 of them
+    Check(both.GetCount() == 2*COUNT - COUNT/3, "wrong union");
+    Check(common.GetCount() == COUNT/3, "wrong intersection");
+    Check(oddOnly.GetCount() == COUNT - COUNT/3, "wrong difference");
+    Check(oddOnly.Union(common).GetString() == odd.GetString(),
+          "difference and intersection don't add up");
+    Check(oddOnly.Intersection(common).GetCount() == 0,
+          "difference and intersection overlap");
+
+    UIdType min, max;
+    both.GetBounds(&min, &max);
+    Check(min == 1 && max == 3*COUNT, "wrong union bounds");
+
+    size_t cookie;
+    for ( UIdType n = common.GetFirst(cookie);
+          n != UID_ILLEGAL;
+          n = common.GetNext(n, cookie) )
+    {
+        if ( n % 2 == 0 || n % 3 != 0 )
+        {
+            Check(false, "wrong element in the intersection");
+            break;
+        }
+    }
+
+    printf("set operations: %ld ms\n", timeSet);
+}
+
+int main()
+{
+    wxInitializer init;
+
+    Benchmark("contiguous", 1);
+    Benchmark("sparse", 2);
+    TestSetOperations();
+
+    return gs_rc;
+}
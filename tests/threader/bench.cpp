@@ -0,0 +1,244 @@
+// Benchmark for MsgThreader: threads a big (500K messages) synthetic folder
+// from scratch, then measures how long it takes to rethread it after a few
+// new messages arrive, which only requires inserting the new ones, and checks
+// that the result is the same as when threading all messages at once. Finally
+// some messages are removed and the tree is checked for consistency again.
+
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+#include <wx/string.h>
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+typedef wxString String;
+typedef unsigned long MsgnoType;
+
+#include "Threading.h"
+#include "mail/Threader.h"
+
+// this is defined in mail/Threading.cpp which we don't link with
+ThreadParams::ThreadParams()
+{
+    useThreading = true;
+    useServer = false;
+    useServerByRefOnly = false;
+    gatherSubjects = true;
+    breakThread = true;
+    indentIfDummyNode = false;
+}
+
+static const MsgnoType COUNT = 500000;
+static const MsgnoType COUNT_NEW = 1000;
+static const MsgnoType COUNT_REMOVED = 5000;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// synthetic messages
+// ----------------------------------------------------------------------------
+
+class TestSource : public MsgThreader::Source
+{
+public:
+    virtual void GetHeaders(MsgnoType idx, MsgThreader::Headers& headers) const
+    {
+        headers = m_messages[idx];
+    }
+
+    std::vector<MsgThreader::Headers> m_messages;
+};
+
+static String MessageId(const char *prefix, MsgnoType n)
+{
+    return String::Format("<%s%lu@example.com>", prefix, n);
+}
+
+static void CreateMessages(std::vector<MsgThreader::Headers>& messages)
+{
+    std::mt19937 rng(42);
+
+    // only the direct parent and the grandparent are put in References: this
+    // is less than what most mailers do but is enough to create deep threads
+    std::vector<MsgnoType> parents(COUNT, COUNT);
+
+    messages.resize(COUNT);
+    for ( MsgnoType n = 0; n < COUNT; n++ )
+    {
+        MsgThreader::Headers& h = messages[n];
+        h.id = MessageId("", n);
+
+        if ( n == 0 || rng() % 4 == 0 )
+        {
+            // start a new thread, the subjects are repeated from time to time
+            // to test gathering the threads with the same subject
+            h.subject = String::Format("Subject %lu", n % (COUNT / 10));
+            h.isReply = false;
+
+            // and sometimes the first message of the thread is missing
+            if ( rng() % 8 == 0 )
+                h.references = MessageId("missing", n);
+        }
+        else // reply to one of the recent messages
+        {
+            const MsgnoType parent = n - 1 - rng() % std::min(n, 1000ul);
+            const MsgThreader::Headers& p = messages[parent];
+
+            parents[n] = parent;
+            if ( parents[parent] != COUNT && rng() % 2 )
+                h.references = messages[parents[parent]].id + ' ';
+            h.references += p.id;
+
+            // subject changes should break the thread
+            h.subject = rng() % 32 ? p.subject
+                                   : String::Format("Changed %lu", n);
+            h.isReply = true;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// checking the tree
+// ----------------------------------------------------------------------------
+
+// return all messages of the tree in depth first order with their depths
+static std::vector< std::pair<MsgnoType, size_t> >
+DumpTree(const MsgThreader& threader)
+{
+    std::vector< std::pair<MsgnoType, size_t> > dump;
+
+    std::vector< std::pair<MsgThreader::NodeId, size_t> > stack;
+    MsgThreader::NodeId node = threader.GetFirstRoot();
+    size_t depth = 0;
+    for ( ;; )
+    {
+        if ( node == MsgThreader::NO_NODE )
+        {
+            if ( stack.empty() )
+                break;
+
+            node = stack.back().first;
+            depth = stack.back().second;
+            stack.pop_back();
+            continue;
+        }
+
+        dump.push_back(std::make_pair(threader.GetIndex(node), depth));
+
+        stack.push_back(std::make_pair(threader.GetNext(node), depth));
+        node = threader.GetFirstChild(node);
+        depth++;
+    }
+
+    return dump;
+}
+
+// check that each message appears in the tree exactly once
+static void CheckTree(const MsgThreader& threader, MsgnoType count)
+{
+    const std::vector< std::pair<MsgnoType, size_t> > dump = DumpTree(threader);
+
+    std::vector<bool> seen(count, false);
+    MsgnoType countSeen = 0;
+    for ( size_t n = 0; n < dump.size(); n++ )
+    {
+        const MsgnoType idx = dump[n].first;
+        if ( idx == MsgThreader::NO_MESSAGE )
+            continue;
+
+        if ( idx >= count || seen[idx] )
+        {
+            Check(false, "invalid or duplicate message in the tree");
+            return;
+        }
+
+        seen[idx] = true;
+        countSeen++;
+    }
+
+    Check(countSeen == count, "some messages are missing from the tree");
+}
+
+// ----------------------------------------------------------------------------
+// benchmark
+// ----------------------------------------------------------------------------
+
+int main()
+{
+    wxInitializer init;
+
+    TestSource source;
+    CreateMessages(source.m_messages);
+
+    ThreadParams thrParams;
+
+    MsgThreader threader;
+    threader.OnAdd(COUNT - COUNT_NEW);
+
+    wxStopWatch sw;
+    threader.Thread(source, thrParams);
+    printf("threading %lu messages: %ld ms\n", COUNT - COUNT_NEW, sw.Time());
+
+    CheckTree(threader, COUNT - COUNT_NEW);
+
+    threader.OnAdd(COUNT);
+
+    sw.Start();
+    threader.Thread(source, thrParams);
+    printf("rethreading after adding %lu messages: %ld ms\n",
+           COUNT_NEW, sw.Time());
+
+    CheckTree(threader, COUNT);
+
+    sw.Start();
+    threader.Thread(source, thrParams);
+    printf("rethreading without changes: %ld ms\n", sw.Time());
+
+    MsgThreader threaderAll;
+    threaderAll.OnAdd(COUNT);
+    threaderAll.Thread(source, thrParams);
+    Check(DumpTree(threader) == DumpTree(threaderAll),
+          "incremental threading result is different");
+
+    // remove some random messages, starting from the end so that the indices
+    // of the remaining ones to remove don't change
+    std::vector<MsgnoType> removed(COUNT_REMOVED);
+    std::mt19937 rng(17);
+    for ( MsgnoType n = 0; n < COUNT_REMOVED; n++ )
+        removed[n] = rng() % COUNT;
+    std::sort(removed.begin(), removed.end());
+    removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+
+    // the source must reflect the removal too, in case Thread() rebuilds
+    std::vector<MsgThreader::Headers> messages;
+    for ( MsgnoType n = 0, r = 0; n < COUNT; n++ )
+    {
+        if ( r < removed.size() && removed[r] == n )
+            r++;
+        else
+            messages.push_back(source.m_messages[n]);
+    }
+    source.m_messages.swap(messages);
+
+    sw.Start();
+    for ( size_t n = removed.size(); n > 0; n-- )
+        threader.OnRemove(removed[n - 1]);
+    threader.Thread(source, thrParams);
+    printf("rethreading after removing %zu messages: %ld ms\n",
+           removed.size(), sw.Time());
+
+    CheckTree(threader, COUNT - removed.size());
+
+    return gs_rc;
+}
@@ -0,0 +1,712 @@
+// Test for MsgThreader: checks that the threads built for the known sets of
+// messages are the same as the ones built by the original JWZ threader which
+// MsgThreader replaced, both when threading all messages at once and when
+// adding them one by one.
+//
+// The expected results were produced by the implementation from ThreadJWZ.cpp
+// before MsgThreader was introduced. The first cases were written by hand, the
+// other ones were generated randomly and chosen among those for which the
+// first version of MsgThreader gave different results. The two threaders still
+// differ, by design, only for the inputs for which the old one depended on the
+// order in which it processed the messages (it did it from last to first):
+//
+//  - When several messages have the same Message-ID, the old threader used
+//    the last of them for threading the replies, MsgThreader uses the first
+//    one.
+//
+//  - When the references of different messages contradict each other, the
+//    links established by the last message took precedence in the old
+//    threader and by the first one in MsgThreader.
+//
+//  - When gathering the messages by subject, the old threader could choose
+//    any of the equally good messages with the same subject to gather the
+//    others around, MsgThreader chooses the first one in display order.
+//
+// None of these cases is included below.
+
+#include <wx/init.h>
+#include <wx/string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+typedef wxString String;
+typedef unsigned long MsgnoType;
+
+#include "Threading.h"
+#include "mail/Threader.h"
+
+// this is defined in mail/Threading.cpp which we don't link with
+ThreadParams::ThreadParams()
+{
+    useThreading = true;
+    useServer = false;
+    useServerByRefOnly = false;
+    gatherSubjects = true;
+    breakThread = true;
+    indentIfDummyNode = false;
+}
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg, size_t n)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s for test case %lu\n", msg, (unsigned long)n);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// the known inputs
+// ----------------------------------------------------------------------------
+
+static const size_t MAX_MESSAGES = 16;
+
+// the messages are given as "Message-ID|References|In-Reply-To|Subject" and
+// the threads as the message indices with their children in parentheses and
+// "*" for the dummy nodes, see FormatThreads()
+static const struct TestCase
+{
+    bool gatherSubjects,
+         breakThread;
+    const char *messages[MAX_MESSAGES + 1];
+    const char *threads;
+} testCases[] =
+{
+    {
+        false, false,
+        {
+            "<a@x>|||Hello",
+            "<b@x>|<a@x>||Re: Hello",
+            "<c@x>|<a@x> <b@x>|<b@x>|Re: Hello",
+            "<d@x>||<a@x>|Re: Hello",
+            NULL
+        },
+        "0(1(2) 3)"
+    },
+    {
+        true, false,
+        {
+            "<b@x>|<a@x>||Re: Meeting",
+            "<c@x>|<a@x>||Re: Meeting",
+            "<d@x>|||Meeting",
+            "<e@x>|||Re: Meeting",
+            NULL
+        },
+        "2(*(0 1) 3)"
+    },
+    {
+        true, true,
+        {
+            "<a@x>|||Plan",
+            "<b@x>|<a@x>||Re: Plan",
+            "<c@x>|<a@x> <b@x>||New topic",
+            "<d@x>|<a@x> <b@x> <c@x>||Re: New topic",
+            "<e@x>|||Re: Plan",
+            NULL
+        },
+        "0(1 4) 2(3)"
+    },
+    {
+        true, false,
+        {
+            "<b@x>|<a@x>||Re: Report",
+            "<a@x>|||Report",
+            "<c@x>|||Re: Report",
+            "<d@x>|||Report",
+            NULL
+        },
+        "*(1(0 2) 3)"
+    },
+    {
+        false, true,
+        {
+            "<a@x>|||Status",
+            "<b@x>|<a@x>||Re: Status",
+            "<c@x>|<a@x> <b@x>||Other",
+            "<d@x>|<a@x> <b@x> <c@x>||Re: Other",
+            "<e@x>|<a@x> <b@x>||Re: Status",
+            NULL
+        },
+        "0(1(4)) 2(3)"
+    },
+    {
+        true, true,
+        {
+            "<b@x>|<a@x>||Re: Both",
+            "<c@x>|<a@x>||Re: Both",
+            "<d@x>|<a@x> <c@x>||Re: Different",
+            "<e@x>|||Different",
+            "<f@x>|||",
+            "<g@x>|<f@x>||",
+            NULL
+        },
+        "*(0 1) 3(2) 4(5)"
+    },
+    {
+        false, true,
+        {
+            "<m0@x>|<missing2@x>||Re: B",
+            "<m1@x>|<m0@x>|<m0@x>|Re: B",
+            "<m2@x>|<missing2@x>||B",
+            "<m3@x>|||B",
+            "<m4@x>|<m0@x> <m1@x>||Re: B",
+            "<m5@x>|||B",
+            "<m6@x>|||B",
+            "<m7@x>|<m6@x>|<m6@x>|Re: B",
+            "<m8@x>|<missing2@x>||Re: A",
+            "<m9@x>|||C",
+            NULL
+        },
+        "*(0(1(4)) 2) 3 5 6(7) 8 9"
+    },
+    {
+        false, true,
+        {
+            "<m0@x>|||",
+            "<m1@x>|<missing1@x>||Re: B",
+            "<m2@x>|<m0@x>|<m0@x>|Re: ",
+            "<m3@x>|<missing1@x>||",
+            "<m4@x>||<m3@x>|Re: ",
+            "<m5@x>|<m0@x> <m2@x>||A",
+            "<m6@x>|||B",
+            "<m7@x>|<m6@x>||Re: B",
+            "<m8@x>|<missing1@x>||",
+            "<m9@x>|<missing1@x>||",
+            "<m10@x>|<m0@x> <m2@x> <m5@x>||A",
+            NULL
+        },
+        "0(2) 1 3(4) 5(10) 6(7) 8 9"
+    },
+    {
+        false, true,
+        {
+            "<m0@x>|||",
+            "<m1@x>|||C",
+            "<m2@x>|||B",
+            "<m3@x>||<m2@x>|Re: B",
+            "<m4@x>|<m2@x> <m3@x>||Re: B",
+            "<m5@x>|<m2@x> <m3@x> <m4@x>||Re: B",
+            "<m6@x>|<missing0@x>||A",
+            "<m7@x>|<m1@x>||Re: C",
+            "<m8@x>|<m2@x> <m3@x> <m4@x>||B",
+            "<m9@x>|<m0@x>|<m0@x>|Re: ",
+            "<m10@x>|<m0@x>||Re: D",
+            "<m11@x>|<missing0@x>||B",
+            "<m12@x>|<m0@x> <m9@x>|<m9@x>|Re: ",
+            "<m13@x>|<missing0@x>||B",
+            "<m14@x>|<m6@x>||Re: B",
+            "<m15@x>|<m2@x> <m3@x> <m4@x> <m5@x>||Re: B",
+            NULL
+        },
+        "0(9(12)) 1(7) 2(3(4(5(15) 8))) 6 10 11 13 14"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|<missing1@x>||C",
+            "<m1@x>|||C",
+            "<m2@x>|||C",
+            "<m3@x>|<missing1@x>||",
+            "<m4@x>|<m1@x>||Re: C",
+            "<m5@x>|<m1@x>||Re: C",
+            "<m6@x>|<m3@x>|<m3@x>|Re: ",
+            NULL
+        },
+        "*(*(0 1(4 5)) 2) 3(6)"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|||",
+            "<m1@x>||<m0@x>|Re: ",
+            "<m2@x>|||A",
+            "<m3@x>|||Re: C",
+            "<m4@x>|<m3@x>||Re: A",
+            "<m5@x>|<m0@x> <m1@x>||Re: A",
+            "<m6@x>|<missing2@x>||A",
+            "<m7@x>|||C",
+            NULL
+        },
+        "0(1) *(2(4 5) 6) 7(3)"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|<missing2@x>||Re: B",
+            "<m1@x>|<missing2@x>||B",
+            "<m2@x>||<m0@x>|Re: D",
+            "<m3@x>||<m0@x>|Re: B",
+            "<m4@x>|||A",
+            "<m5@x>|<m0@x> <m3@x>||Re: B",
+            "<m6@x>|<m3@x> <m5@x>|<m5@x>|Re: B",
+            "<m7@x>|<m1@x>|<m1@x>|Re: B",
+            "<m8@x>|||B",
+            NULL
+        },
+        "*(0(3(5(6))) 1(7) 8) 2 4"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|||",
+            "<m1@x>|<m0@x>||B",
+            "<m2@x>||<m0@x>|Re: ",
+            "<m3@x>|<m0@x> <m1@x>||Re: C",
+            "<m4@x>|<m0@x> <m1@x> <m3@x>||Re: C",
+            "<m5@x>|||B",
+            "<m6@x>|<m0@x> <m1@x> <m3@x> <m4@x>||Re: C",
+            "<m7@x>|<m0@x> <m1@x>||Re: B",
+            "<m8@x>|||B",
+            "<m9@x>|||",
+            "<m10@x>|||Re: B",
+            NULL
+        },
+        "0(2) *(*(1(7) 5) 8 10) 3(4(6)) 9"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|||",
+            "<m1@x>|||A",
+            "<m2@x>|<m1@x>||Re: A",
+            "<m3@x>|<m1@x> <m2@x>||Re: A",
+            "<m4@x>|<m0@x>||Re: ",
+            "<m5@x>|||Re: C",
+            "<m6@x>|<m5@x>|<m5@x>|A",
+            "<m7@x>|||B",
+            "<m8@x>|<m0@x>||Re: ",
+            "<m9@x>|||A",
+            "<m10@x>|<m0@x> <m8@x>|<m8@x>|Re: ",
+            NULL
+        },
+        "0(4 8(10)) *(*(1(2(3)) 6) 9) 5 7"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|||B",
+            "<m1@x>|||Re: ",
+            "<m2@x>|<missing0@x>||A",
+            "<m3@x>|<m1@x>||Re: ",
+            "<m4@x>|<missing2@x>||C",
+            "<m5@x>|<m4@x>||Re: A",
+            "<m6@x>|||C",
+            "<m7@x>|||Re: A",
+            "<m8@x>|<m4@x>||C",
+            "<m9@x>|<m6@x>||Re: C",
+            "<m10@x>||<m2@x>|Re: C",
+            "<m11@x>|||A",
+            NULL
+        },
+        "0 1(3) *(2(5 7) 11) *(4(8) 6(9) 10)"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|||Re: A",
+            "<m1@x>||<m0@x>|Re: A",
+            "<m2@x>|<m0@x> <m1@x>||Re: A",
+            "<m3@x>|<missing2@x>||A",
+            "<m4@x>|||B",
+            "<m5@x>|<missing2@x>||Re: A",
+            "<m6@x>|<m4@x>||Re: B",
+            "<m7@x>|<m0@x>||A",
+            "<m8@x>|<m0@x> <m1@x>|<m1@x>|Re: A",
+            "<m9@x>|<m0@x> <m1@x> <m8@x>||Re: A",
+            "<m10@x>|<m4@x>||Re: B",
+            "<m11@x>|<m0@x> <m1@x> <m8@x> <m9@x>||Re: A",
+            NULL
+        },
+        "0(1(2 8(9(11))) *(3 5) 7) 4(6 10)"
+    },
+    {
+        true, true,
+        {
+            "<m0@x>|<missing0@x>||A",
+            "<m1@x>|||C",
+            "<m2@x>||<m0@x>|Re: A",
+            "<m3@x>||<m0@x>|A",
+            "<m4@x>|<m0@x> <m2@x>||Re: A",
+            "<m5@x>|<m0@x> <m2@x>||Re: A",
+            "<m6@x>|<m1@x>||A",
+            "<m7@x>|<m1@x> <m6@x>||Re: A",
+            "<m8@x>|<m1@x>||Re: C",
+            "<m9@x>|||A",
+            "<m10@x>|||Re: B",
+            "<m11@x>|<m0@x> <m3@x>||Re: B",
+            "<m12@x>|<missing1@x>||A",
+            NULL
+        },
+        "*(*(*(0(2(4 5) 3) 6(7)) 9) 12) 1(8) *(10 11)"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|<missing2@x>||Re: C",
+            "<m1@x>|||Re: C",
+            "<m2@x>|<missing2@x>||A",
+            "<m3@x>|<m2@x>||A",
+            "<m4@x>|<m2@x>|<m2@x>|Re: A",
+            "<m5@x>||<m4@x>|Re: A",
+            NULL
+        },
+        "*(*(0 2(3 4(5))) 1)"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|||",
+            "<m1@x>|<m0@x>||Re: ",
+            "<m2@x>|<m0@x>||Re: ",
+            "<m3@x>|<m0@x> <m2@x>||Re: ",
+            "<m4@x>|<m0@x>|<m0@x>|B",
+            "<m5@x>|||B",
+            "<m6@x>||<m3@x>|Re: ",
+            NULL
+        },
+        "0(1 2(3(6)) 4) 5"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|<missing2@x>||C",
+            "<m1@x>|<missing2@x>||B",
+            "<m2@x>|<m0@x>||Re: C",
+            "<m3@x>||<m0@x>|Re: C",
+            "<m4@x>|||Re: ",
+            "<m5@x>|<m0@x> <m3@x>||Re: C",
+            "<m6@x>|||Re: B",
+            NULL
+        },
+        "*(0(2 3(5)) 1(6)) 4"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|||",
+            "<m1@x>|||B",
+            "<m2@x>|<m0@x>||Re: ",
+            "<m3@x>|<missing1@x>||C",
+            "<m4@x>|<m0@x>||Re: C",
+            "<m5@x>||<m3@x>|Re: A",
+            "<m6@x>|<m0@x> <m4@x>|<m4@x>|C",
+            "<m7@x>|<m0@x> <m2@x>||Re: ",
+            NULL
+        },
+        "0(2(7) 4(6)) 1 3(5)"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|||Re: B",
+            "<m1@x>|<missing0@x>||Re: A",
+            "<m2@x>||<m1@x>|Re: A",
+            "<m3@x>|<missing0@x>||C",
+            "<m4@x>|||C",
+            "<m5@x>|<m0@x>||Re: B",
+            "<m6@x>|||",
+            "<m7@x>|<m4@x>||Re: C",
+            "<m8@x>|<m1@x> <m2@x>||Re: D",
+            NULL
+        },
+        "0(5) *(1(2(8)) 3 4(7)) 6"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|||",
+            "<m1@x>|<m0@x>||Re: ",
+            "<m2@x>|||Re: C",
+            "<m3@x>|<m0@x> <m1@x>|<m1@x>|D",
+            "<m4@x>|<m1@x> <m3@x>|<m3@x>|Re: D",
+            "<m5@x>|<m0@x> <m1@x> <m3@x>||Re: C",
+            "<m6@x>|<m0@x>|<m0@x>|Re: ",
+            "<m7@x>|<m0@x> <m1@x> <m3@x> <m5@x>||Re: D",
+            "<m8@x>|<m0@x> <m1@x>|<m1@x>|",
+            NULL
+        },
+        "0(1(3(4 5(7)) 8) 6) 2"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|||",
+            "<m1@x>|<m0@x>||",
+            "<m2@x>|<m0@x>||C",
+            "<m3@x>|<m0@x> <m2@x>||Re: C",
+            "<m4@x>||<m3@x>|Re: C",
+            "<m5@x>|<m3@x> <m4@x>|<m4@x>|Re: C",
+            "<m6@x>|||B",
+            "<m7@x>|||C",
+            "<m8@x>|<m7@x>||Re: C",
+            NULL
+        },
+        "0(1 2(3(4(5)))) 6 7(8)"
+    },
+    {
+        true, false,
+        {
+            "<m0@x>|||Re: A",
+            "<m1@x>|<m0@x>||Re: A",
+            "<m2@x>|<m0@x> <m1@x>|<m1@x>|Re: A",
+            "<m3@x>|<m0@x> <m1@x> <m2@x>||A",
+            "<m4@x>||<m1@x>|Re: A",
+            "<m5@x>|<m2@x> <m3@x>|<m3@x>|Re: A",
+            "<m6@x>|||B",
+            "<m7@x>|<m0@x> <m1@x> <m4@x>||Re: A",
+            "<m8@x>||<m1@x>|A",
+            "<m9@x>|||A",
+            NULL
+        },
+        "0(1(2(3(5) 9) 4(7) 8)) 6"
+    },
+    {
+        false, false,
+        {
+            "<m0@x>|||B",
+            "<m1@x>||<m0@x>|Re: B",
+            "<m2@x>|<m0@x>||Re: B",
+            "<m3@x>|||",
+            "<m4@x>|||Re: ",
+            "<m5@x>|<missing2@x>||B",
+            "<m6@x>||<m5@x>|Re: B",
+            "<m7@x>|<m0@x> <m1@x>|<m1@x>|Re: B",
+            "<m8@x>|||Re: B",
+            "<m9@x>|<m5@x> <m6@x>||Re: B",
+            "<m10@x>||<m1@x>|Re: A",
+            "<m11@x>||<m2@x>|Re: B",
+            "<m12@x>|<m5@x> <m6@x>|<m6@x>|Re: B",
+            "<m13@x>|<m0@x> <m1@x>||Re: B",
+            "<m14@x>||<m1@x>|Re: B",
+            "<m15@x>|<m0@x> <m1@x> <m10@x>||Re: A",
+            NULL
+        },
+        "0(1(7 10(15) 13 14) 2(11)) 3 4 5(6(9 12)) 8"
+    },
+    {
+        false, false,
+        {
+            "<m0@x>|||Re: B",
+            "<m1@x>|<m0@x>||Re: B",
+            "<m2@x>|||C",
+            "<m3@x>|||Re: ",
+            "<m4@x>|<missing0@x>||C",
+            "<m5@x>|<m4@x>||Re: C",
+            "<m6@x>|<m4@x>||Re: C",
+            "<m7@x>|<m4@x> <m6@x>||Re: C",
+            "<m8@x>|<m4@x>||Re: C",
+            "<m9@x>|||B",
+            "<m10@x>|||Re: A",
+            "<m11@x>||<m3@x>|Re: ",
+            "<m12@x>||<m10@x>|Re: B",
+            "<m13@x>|<m3@x>|<m3@x>|",
+            "<m14@x>|<m4@x> <m6@x>|<m6@x>|Re: B",
+            "<m15@x>||<m6@x>|Re: C",
+            NULL
+        },
+        "0(1) 2 3(11 13) 4(5 6(7 14 15) 8) 9 10(12)"
+    },
+    {
+        false, false,
+        {
+            "<m0@x>|||",
+            "<m1@x>|||",
+            "<m2@x>|<missing2@x>||Re: A",
+            "<m3@x>|||C",
+            "<m4@x>|<m0@x>||",
+            "<m5@x>|||C",
+            "<m6@x>|<m5@x>||Re: C",
+            "<m7@x>|<m3@x>||Re: C",
+            "<m8@x>|<m5@x>||Re: C",
+            "<m9@x>|<m5@x> <m8@x>||Re: C",
+            "<m10@x>|<m3@x>||Re: C",
+            "<m11@x>|<m5@x> <m8@x> <m9@x>||C",
+            "<m12@x>|<m3@x>||Re: C",
+            "<m13@x>|<m3@x> <m10@x>|<m10@x>|Re: C",
+            "<m14@x>|<m1@x>||Re: ",
+            "<m15@x>|<m3@x> <m10@x> <m13@x>||Re: C",
+            NULL
+        },
+        "0(4) 1(14) 2 3(7 10(13(15)) 12) 5(6 8(9(11)))"
+    },
+};
+
+class TestSource : public MsgThreader::Source
+{
+public:
+    TestSource(const TestCase& tc)
+    {
+        for ( size_t n = 0; tc.messages[n]; n++ )
+        {
+            const std::string msg(tc.messages[n]);
+
+            std::vector<std::string> fields;
+            size_t start = 0;
+            for ( ;; )
+            {
+                const size_t end = msg.find('|', start);
+                fields.push_back(msg.substr(start, end - start));
+                if ( end == std::string::npos )
+                    break;
+
+                start = end + 1;
+            }
+
+            MsgThreader::Headers h;
+            h.id = fields[0];
+
+            // this is what ThreadJWZ.cpp does too
+            h.references = fields[1] + fields[2];
+
+            // simplified version of strutil_removeAllReplyPrefixes()
+            std::string subject = fields[3];
+            h.isReply = false;
+            while ( subject.compare(0, 4, "Re: ") == 0 )
+            {
+                subject.erase(0, 4);
+                h.isReply = true;
+            }
+            h.subject = subject;
+
+            m_messages.push_back(h);
+        }
+    }
+
+    virtual void GetHeaders(MsgnoType idx, MsgThreader::Headers& headers) const
+    {
+        headers = m_messages[idx];
+    }
+
+    MsgnoType GetCount() const { return m_messages.size(); }
+
+private:
+    std::vector<MsgThreader::Headers> m_messages;
+};
+
+// ----------------------------------------------------------------------------
+// comparing the trees
+// ----------------------------------------------------------------------------
+
+struct Thread
+{
+    // the message index or NO_MESSAGE for the dummy nodes
+    MsgnoType idx;
+
+    // the index of the message shown first in this thread
+    MsgnoType first;
+
+    std::vector<Thread> children;
+};
+
+static bool ThreadLess(const Thread& t1, const Thread& t2)
+{
+    return t1.first < t2.first;
+}
+
+// get the threads starting with the given node and its siblings: the order of
+// the siblings doesn't matter as they're sorted before being shown, so sort
+// them here in the same way too
+static std::vector<Thread>
+GetThreads(const MsgThreader& threader, MsgThreader::NodeId node)
+{
+    std::vector<Thread> threads;
+    for ( ; node != MsgThreader::NO_NODE; node = threader.GetNext(node) )
+    {
+        Thread thread;
+        thread.idx = threader.GetIndex(node);
+        thread.children = GetThreads(threader, threader.GetFirstChild(node));
+
+        // the dummy nodes are shown at the position of their first child
+        if ( thread.idx != MsgThreader::NO_MESSAGE )
+            thread.first = thread.idx;
+        else if ( !thread.children.empty() )
+            thread.first = thread.children[0].first;
+        else
+            thread.first = MsgThreader::NO_MESSAGE;
+
+        threads.push_back(thread);
+    }
+
+    std::stable_sort(threads.begin(), threads.end(), ThreadLess);
+
+    return threads;
+}
+
+// format the threads as "0(1(2) 3) *(4 5)"
+static std::string FormatThreads(const std::vector<Thread>& threads)
+{
+    std::string s;
+    for ( size_t n = 0; n < threads.size(); n++ )
+    {
+        if ( n )
+            s += ' ';
+
+        const Thread& thread = threads[n];
+        if ( thread.idx == MsgThreader::NO_MESSAGE )
+            s += '*';
+        else
+            s += String::Format("%lu", thread.idx).ToStdString();
+
+        if ( !thread.children.empty() )
+            s += '(' + FormatThreads(thread.children) + ')';
+    }
+
+    return s;
+}
+
+static std::string FormatThreads(const MsgThreader& threader)
+{
+    return FormatThreads(GetThreads(threader, threader.GetFirstRoot()));
+}
+
+// ----------------------------------------------------------------------------
+// the test
+// ----------------------------------------------------------------------------
+
+int main()
+{
+    wxInitializer init;
+
+    for ( size_t n = 0; n < WXSIZEOF(testCases); n++ )
+    {
+        const TestCase& tc = testCases[n];
+        const TestSource source(tc);
+
+        ThreadParams thrParams;
+        thrParams.gatherSubjects = tc.gatherSubjects;
+        thrParams.breakThread = tc.breakThread;
+
+        MsgThreader threader;
+        threader.OnAdd(source.GetCount());
+        threader.Thread(source, thrParams);
+
+        const std::string threads = FormatThreads(threader);
+        if ( threads != tc.threads )
+        {
+            printf("ERROR: test case %lu threaded as \"%s\" "
+                   "instead of \"%s\"\n",
+                   (unsigned long)n, threads.c_str(), tc.threads);
+            gs_rc = EXIT_FAILURE;
+        }
+
+        // the result must be the same when the messages arrive one by one
+        MsgThreader threaderIncr;
+        for ( MsgnoType count = 1; count <= source.GetCount(); count++ )
+        {
+            threaderIncr.OnAdd(count);
+            threaderIncr.Thread(source, thrParams);
+        }
+
+        Check(FormatThreads(threaderIncr) == threads,
+              "incremental threading result is different", n);
+    }
+
+    if ( gs_rc == EXIT_SUCCESS )
+        printf("all tests passed\n");
+
+    return gs_rc;
+}
@@ -0,0 +1,430 @@
+// Test for MailThreadPool using real folders: opens several local mbox and MH
+// folders with c-client and queues hundreds of tasks appending, flagging and
+// expunging messages in them to the pool, while the main thread also uses the
+// same folders after waiting for their tasks to finish, just as MailFolderCC
+// does. Checks that the results of each operation are as expected, i.e. that
+// the operations on the same folder are not interleaved, and that all folders
+// contain exactly the expected messages in the right order at the end.
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/thread.h>
+
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef wxString String;
+
+#include "Mcclient.h"
+#include "mail/MailThreadPool.h"
+
+extern "C" DRIVER unixdriver, mhdriver, dummydriver;
+
+static const size_t MAX_THREADS = 4;
+static const size_t MAX_THREADS_PER_SERVER = 2;
+
+static const size_t NUM_MBOX = 3;
+static const size_t NUM_MH = 3;
+static const size_t NUM_FOLDERS = NUM_MBOX + NUM_MH;
+
+static const size_t NUM_TASKS = 300;
+
+// the main thread uses one of the folders after every CHECK_EVERY tasks
+static const size_t CHECK_EVERY = 10;
+
+static int gs_rc = EXIT_SUCCESS;
+
+// only called with the mail lock held, so doesn't need any other locking
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// messages
+// ----------------------------------------------------------------------------
+
+static const char SUBJECT_PREFIX[] = "Message ";
+
+static std::string MakeMessage(size_t n)
+{
+    std::ostringstream s;
+    s << "From: sender@example.com\r\n"
+      << "Subject: " << SUBJECT_PREFIX << n << "\r\n"
+      << "\r\n"
+      << "This is the message number " << n << ".\r\n";
+
+    return s.str();
+}
+
+// get the number of the given message or -1
+static int GetMessageNumber(MAILSTREAM *stream, unsigned long msgno)
+{
+    ENVELOPE * const env = mail_fetchenvelope(stream, msgno);
+    if ( !env || !env->subject ||
+            strncmp(env->subject, SUBJECT_PREFIX, strlen(SUBJECT_PREFIX)) )
+        return -1;
+
+    return atoi(env->subject + strlen(SUBJECT_PREFIX));
+}
+
+// ----------------------------------------------------------------------------
+// folders
+// ----------------------------------------------------------------------------
+
+struct Folder
+{
+    Folder() { stream = NIL; isMH = false; }
+
+    // the c-client mailbox name
+    std::string mailbox;
+
+    // true for MH folders, false for mbox ones
+    bool isMH;
+
+    // the stream used by the tasks and the main thread
+    MAILSTREAM *stream;
+
+    // the numbers of the messages which must be in the folder after all the
+    // tasks queued so far complete
+    std::vector<int> expected;
+};
+
+static Folder gs_folders[NUM_FOLDERS];
+
+// update the folder stream to see the messages appended to it
+static bool Refresh(Folder& folder)
+{
+    // MH driver only notices the new messages if the directory change time
+    // changed, but it has 1 second resolution, so reopen the folder instead
+    if ( folder.isMH )
+    {
+        folder.stream = mail_open(folder.stream,
+                                  const_cast<char *>(folder.mailbox.c_str()),
+                                  NIL);
+        return folder.stream != NIL;
+    }
+
+    return mail_ping(folder.stream) != NIL;
+}
+
+// ----------------------------------------------------------------------------
+// FolderTask: an operation on a folder
+// ----------------------------------------------------------------------------
+
+class FolderTask : public MailThreadPool::Task
+{
+public:
+    enum Kind
+    {
+        Append,
+        Flag,
+        Expunge
+    };
+
+    FolderTask(Folder& folder, Kind kind, size_t n)
+        : m_folder(folder), m_kind(kind), m_n(n)
+    {
+    }
+
+    virtual void Execute()
+    {
+        if ( !Refresh(m_folder) )
+        {
+            Check(false, "failed to refresh the folder");
+            return;
+        }
+
+        MAILSTREAM * const stream = m_folder.stream;
+        const unsigned long nmsgs = stream->nmsgs;
+
+        switch ( m_kind )
+        {
+            case Append:
+                {
+                    const std::string text = MakeMessage(m_n);
+
+                    STRING str;
+                    INIT(&str, mail_string, (void *)text.c_str(), text.length());
+                    Check(mail_append(stream,
+                                      const_cast<char *>(m_folder.mailbox.c_str()),
+                                      &str) != NIL,
+                          "appending failed");
+
+                    if ( !Refresh(m_folder) ||
+                            m_folder.stream->nmsgs != nmsgs + 1 )
+                    {
+                        Check(false, "appended message not found");
+                        break;
+                    }
+
+                    // if another operation on this folder had run in parallel,
+                    // the last message could be different
+                    Check(GetMessageNumber(m_folder.stream, nmsgs + 1) == (int)m_n,
+                          "unexpected last message after appending");
+                }
+                break;
+
+            case Flag:
+                if ( nmsgs )
+                {
+                    mail_setflag(stream, const_cast<char *>("1:*"),
+                                 const_cast<char *>("\\Seen"));
+                    mail_fetch_flags(stream, const_cast<char *>("1:*"), NIL);
+
+                    for ( unsigned long msgno = 1; msgno <= nmsgs; msgno++ )
+                    {
+                        if ( !mail_elt(stream, msgno)->seen )
+                        {
+                            Check(false, "message flag not set");
+                            break;
+                        }
+                    }
+                }
+                break;
+
+            case Expunge:
+                mail_setflag(stream, const_cast<char *>("1"),
+                             const_cast<char *>("\\Deleted"));
+                mail_expunge(stream);
+
+                Check(stream->nmsgs == nmsgs - 1, "message not expunged");
+                break;
+        }
+    }
+
+private:
+    Folder& m_folder;
+    const Kind m_kind;
+    const size_t m_n;
+};
+
+// ----------------------------------------------------------------------------
+// c-client callbacks
+// ----------------------------------------------------------------------------
+
+static blocknotify_t gs_defaultBlockNotify = NULL;
+
+// let the other threads run while c-client is blocked, as MailFolderCC does
+static void *BlockNotify(int reason, void *data)
+{
+    switch ( reason )
+    {
+        case BLOCK_NONE:
+            MailLock::ResumeAfterIO();
+            break;
+
+        case BLOCK_DNSLOOKUP:
+        case BLOCK_TCPOPEN:
+        case BLOCK_TCPREAD:
+        case BLOCK_TCPWRITE:
+        case BLOCK_TCPCLOSE:
+        case BLOCK_FILELOCK:
+            MailLock::SuspendForIO();
+            break;
+    }
+
+    return (*gs_defaultBlockNotify)(reason, data);
+}
+
+void mm_login(NETMBX *, char *, char *, long) { }
+void mm_log(char *string, long errflg)
+{
+    if ( errflg == ERROR )
+        printf("c-client error: %s\n", string);
+}
+void mm_notify(MAILSTREAM *, char *, long) { }
+void mm_status(MAILSTREAM *, char *, MAILSTATUS *) { }
+void mm_exists(MAILSTREAM *, unsigned long) { }
+void mm_expunged(MAILSTREAM *, unsigned long) { }
+void mm_flags(MAILSTREAM *, unsigned long) { }
+void mm_searched(MAILSTREAM *, unsigned long) { }
+void mm_list(MAILSTREAM *, int, char *, long) { }
+void mm_lsub(MAILSTREAM *, int, char *, long) { }
+void mm_dlog(char *) { }
+void mm_critical(MAILSTREAM *) { }
+void mm_nocritical(MAILSTREAM *) { }
+long mm_diskerror(MAILSTREAM *, long, long) { return 1; }
+void mm_fatal(char *string) { printf("c-client fatal error: %s\n", string); }
+
+// ----------------------------------------------------------------------------
+// test
+// ----------------------------------------------------------------------------
+
+static bool OpenFolders(const std::string& dir)
+{
+    mail_parameters(NIL, SET_MHPROFILE,
+                    const_cast<char *>((dir + "/.mh_profile").c_str()));
+    mail_parameters(NIL, SET_MHPATH, const_cast<char *>(dir.c_str()));
+
+    for ( size_t n = 0; n < NUM_FOLDERS; n++ )
+    {
+        Folder& folder = gs_folders[n];
+
+        std::ostringstream s;
+        if ( n < NUM_MBOX )
+        {
+            s << dir << "/mbox" << n;
+            folder.mailbox = s.str();
+
+            const std::string create = "#driver.unix/" + folder.mailbox;
+            if ( !mail_create(NIL, const_cast<char *>(create.c_str())) )
+                return false;
+        }
+        else
+        {
+            s << "mh" << n;
+            if ( mkdir((dir + "/" + s.str()).c_str(), 0700) != 0 )
+                return false;
+
+            folder.mailbox = "#mh/" + s.str();
+            folder.isMH = true;
+        }
+
+        folder.stream = mail_open(NIL,
+                                  const_cast<char *>(folder.mailbox.c_str()),
+                                  NIL);
+        if ( !folder.stream )
+            return false;
+    }
+
+    return true;
+}
+
+// check that the folder contains exactly the expected messages
+static void CheckFolder(MAILSTREAM *stream,
+                        const Folder& folder,
+                        const char *when)
+{
+    std::vector<int> messages;
+    for ( unsigned long msgno = 1; msgno <= stream->nmsgs; msgno++ )
+        messages.push_back(GetMessageNumber(stream, msgno));
+
+    if ( messages != folder.expected )
+    {
+        printf("ERROR: unexpected messages in %s %s:",
+               folder.mailbox.c_str(), when);
+        for ( size_t n = 0; n < messages.size(); n++ )
+            printf(" %d", messages[n]);
+        printf("\n");
+
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+int main()
+{
+    wxInitializer init;
+
+    mail_link(&mhdriver);
+    mail_link(&unixdriver);
+    mail_link(&dummydriver);
+
+    gs_defaultBlockNotify =
+        (blocknotify_t)mail_parameters(NIL, GET_BLOCKNOTIFY, NIL);
+    mail_parameters(NIL, SET_BLOCKNOTIFY, (void *)BlockNotify);
+
+    char dir[] = "/tmp/mfoldersXXXXXX";
+    if ( !mkdtemp(dir) )
+    {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    MailThreadPool pool(MAX_THREADS, MAX_THREADS_PER_SERVER);
+
+    {
+        MailLocker lockMail;
+
+        Check(OpenFolders(dir), "failed to create the test folders");
+    }
+
+    for ( size_t n = 0; gs_rc == EXIT_SUCCESS && n < NUM_TASKS; n++ )
+    {
+        // the main thread holds the mail lock while handling the events in
+        // the program, do the same here
+        MailLocker lockMail;
+
+        Folder& folder = gs_folders[n % NUM_FOLDERS];
+
+        // mostly append messages, but also change their flags and expunge
+        // them from time to time
+        FolderTask::Kind kind;
+        switch ( (n / NUM_FOLDERS) % 5 )
+        {
+            default:
+                kind = FolderTask::Append;
+                folder.expected.push_back(n);
+                break;
+
+            case 3:
+                kind = FolderTask::Flag;
+                break;
+
+            case 4:
+                kind = folder.expected.empty() ? FolderTask::Flag
+                                               : FolderTask::Expunge;
+                if ( kind == FolderTask::Expunge )
+                    folder.expected.erase(folder.expected.begin());
+                break;
+        }
+
+        // all local folders are on the same "server", so at most
+        // MAX_THREADS_PER_SERVER of them are used at once
+        pool.Queue(new FolderTask(folder, kind, n), n, &folder, "");
+
+        if ( n % CHECK_EVERY == 0 )
+        {
+            Folder& folderCheck = gs_folders[(n / CHECK_EVERY) % NUM_FOLDERS];
+
+            // this is what MailFolderCC does before using the stream
+            pool.WaitForFolder(&folderCheck);
+
+            if ( Refresh(folderCheck) )
+                CheckFolder(folderCheck.stream, folderCheck, "while running");
+            else
+                Check(false, "failed to refresh the folder");
+        }
+    }
+
+    pool.WaitForAll();
+
+    MailLocker lockMail;
+
+    // check the folder contents using new streams
+    for ( size_t n = 0; n < NUM_FOLDERS; n++ )
+    {
+        Folder& folder = gs_folders[n];
+        if ( !folder.stream )
+            continue;
+
+        mail_close(folder.stream);
+
+        MAILSTREAM * const stream =
+            mail_open(NIL, const_cast<char *>(folder.mailbox.c_str()), OP_READONLY);
+        Check(stream != NIL, "failed to reopen the folder");
+        if ( stream )
+        {
+            CheckFolder(stream, folder, "at the end");
+            mail_close(stream);
+        }
+    }
+
+    const std::string cleanup = std::string("rm -rf ") + dir;
+    if ( system(cleanup.c_str()) != 0 )
+        printf("WARNING: failed to remove %s\n", dir);
+
+    if ( gs_rc == EXIT_SUCCESS )
+        printf("all tests passed\n");
+
+    return gs_rc;
+}
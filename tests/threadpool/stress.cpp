@@ -0,0 +1,283 @@
+// Stress test for MailThreadPool: queues hundreds of tasks for many folders
+// on several servers, cancelling some of them, and checks that the tasks for
+// the same folder are executed one at a time and in order, that the limits on
+// the number of threads are respected, that only one thread at a time holds
+// the mail lock and that all tasks are accounted for. Also checks that a new
+// worker is started for a runnable task even if the idle ones have already
+// been woken up for other tasks. See folders.cpp for the test using real
+// folders.
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/thread.h>
+#include <wx/utils.h>
+
+typedef wxString String;
+
+#include "mail/MailThreadPool.h"
+
+#include <vector>
+
+static const size_t MAX_THREADS = 4;
+static const size_t MAX_THREADS_PER_SERVER = 2;
+
+static const size_t NUM_FOLDERS = 12;
+static const size_t NUM_SERVERS = 3;
+static const size_t NUM_TASKS = 600;
+
+// cancel every CANCEL_EVERY-th task
+static const size_t CANCEL_EVERY = 7;
+
+// ----------------------------------------------------------------------------
+// the state shared by all tasks
+// ----------------------------------------------------------------------------
+
+static wxMutex gs_mutex;
+
+// the order in which the tasks were executed for each folder
+static std::vector<size_t> gs_order[NUM_FOLDERS];
+
+// the number of tasks currently running in total, per folder and per server
+static size_t gs_running,
+              gs_runningFolder[NUM_FOLDERS],
+              gs_runningServer[NUM_SERVERS];
+
+// the counts of executed and discarded tasks
+static size_t gs_executed,
+              gs_discarded;
+
+// the number of threads using the "mail code", i.e. holding the mail lock
+static size_t gs_usingMail;
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *what)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", what);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// TestTask: just records its execution
+// ----------------------------------------------------------------------------
+
+class TestTask : public MailThreadPool::Task
+{
+public:
+    TestTask(size_t n, size_t folder)
+        : m_n(n), m_folder(folder), m_server(folder % NUM_SERVERS)
+    {
+        m_executed = false;
+    }
+
+    virtual ~TestTask()
+    {
+        if ( !m_executed )
+        {
+            wxMutexLocker lock(gs_mutex);
+            gs_discarded++;
+        }
+    }
+
+    virtual void Execute()
+    {
+        {
+            wxMutexLocker lock(gs_mutex);
+
+            Check(++gs_running <= MAX_THREADS, "too many threads");
+            Check(++gs_runningFolder[m_folder] == 1,
+                  "concurrent tasks for the same folder");
+            Check(++gs_runningServer[m_server] <= MAX_THREADS_PER_SERVER,
+                  "too many threads for the same server");
+
+            gs_order[m_folder].push_back(m_n);
+        }
+
+        // simulate doing something and waiting for the server, as c-client
+        // does, which lets the other tasks run in the meanwhile
+        UseMail();
+
+        MailLock::SuspendForIO();
+        wxMilliSleep(m_n % 3);
+        MailLock::ResumeAfterIO();
+
+        UseMail();
+
+        {
+            wxMutexLocker lock(gs_mutex);
+
+            gs_running--;
+            gs_runningFolder[m_folder]--;
+            gs_runningServer[m_server]--;
+
+            gs_executed++;
+        }
+
+        m_executed = true;
+    }
+
+private:
+    // check that nobody else uses the mail code while we do
+    static void UseMail()
+    {
+        {
+            wxMutexLocker lock(gs_mutex);
+            Check(++gs_usingMail == 1, "mail lock held by several threads");
+        }
+
+        wxMilliSleep(1);
+
+        wxMutexLocker lock(gs_mutex);
+        gs_usingMail--;
+    }
+
+    const size_t m_n,
+                 m_folder,
+                 m_server;
+
+    bool m_executed;
+};
+
+// ----------------------------------------------------------------------------
+// BlockingTask: waits until the given flag is set
+// ----------------------------------------------------------------------------
+
+class BlockingTask : public MailThreadPool::Task
+{
+public:
+    BlockingTask(wxAtomicInt& started, const wxAtomicInt& proceed)
+        : m_started(started), m_proceed(proceed)
+    {
+    }
+
+    virtual void Execute()
+    {
+        wxAtomicInc(m_started);
+
+        // wait for the flag without holding the mail lock
+        MailUnlocker unlock;
+        for ( size_t n = 0; n < 5000 && !m_proceed; n++ )
+            wxMilliSleep(1);
+    }
+
+private:
+    wxAtomicInt& m_started;
+    const wxAtomicInt& m_proceed;
+};
+
+// queue several tasks which can only finish if they all run in parallel right
+// after making the only idle worker wait because of the per-server limit
+static void TestStartWorker()
+{
+    static const size_t NUM_PARALLEL = 6;
+
+    MailThreadPool pool(NUM_PARALLEL + 2, 1);
+
+    static char folders[NUM_PARALLEL + 2];
+
+    wxAtomicInt started(0),
+                proceed(0);
+
+    // occupy the only slot for the first server and make the second worker
+    // wait for it to become available
+    pool.Queue(new BlockingTask(started, proceed), 0, &folders[0], "first");
+    pool.Queue(new BlockingTask(started, proceed), 1, &folders[1], "first");
+
+    for ( size_t n = 0; n < 5000 && started != 1; n++ )
+        wxMilliSleep(1);
+
+    // the idle worker can execute one of these tasks but not all of them
+    for ( size_t n = 0; n < NUM_PARALLEL; n++ )
+    {
+        pool.Queue(new BlockingTask(started, proceed),
+                   n + 2,
+                   &folders[n + 2],
+                   wxString::Format("server%zu", n));
+    }
+
+    for ( size_t n = 0; n < 5000 && started != NUM_PARALLEL + 1; n++ )
+        wxMilliSleep(1);
+
+    Check(started == NUM_PARALLEL + 1, "runnable tasks not started in parallel");
+
+    wxAtomicInc(proceed);
+
+    pool.WaitForAll();
+
+    Check(started == NUM_PARALLEL + 2, "not all tasks executed");
+}
+
+int main()
+{
+    wxInitializer init;
+
+    // the folder keys are just the addresses of these elements
+    static char folders[NUM_FOLDERS];
+
+    const String servers[NUM_SERVERS] = { "", "imap.example.com", "news" };
+
+    MailThreadPool pool(MAX_THREADS, MAX_THREADS_PER_SERVER);
+
+    size_t countCancelled = 0;
+    for ( size_t n = 0; n < NUM_TASKS; n++ )
+    {
+        // the main thread holds the mail lock while handling the events in
+        // the program, do the same here
+        MailLocker lockMail;
+
+        const size_t folder = n % NUM_FOLDERS;
+        pool.Queue(new TestTask(n, folder),
+                   n,
+                   &folders[folder],
+                   servers[folder % NUM_SERVERS]);
+
+        if ( n % CANCEL_EVERY == 0 && pool.Cancel(n) )
+            countCancelled++;
+
+        // also check waiting for a single folder from time to time
+        if ( n == NUM_TASKS / 2 )
+        {
+            pool.WaitForFolder(&folders[folder]);
+
+            wxMutexLocker lock(gs_mutex);
+            Check(gs_runningFolder[folder] == 0 &&
+                    gs_order[folder].back() == n,
+                  "WaitForFolder() returned too early");
+        }
+    }
+
+    // these tasks are already done, so they can't be cancelled
+    Check(!pool.Cancel(NUM_TASKS / 2), "cancelled a finished task");
+
+    pool.WaitForAll();
+
+    wxMutexLocker lock(gs_mutex);
+
+    Check(gs_executed + gs_discarded == NUM_TASKS, "some tasks were lost");
+    Check(gs_discarded <= countCancelled, "non-cancelled tasks discarded");
+
+    for ( size_t f = 0; f < NUM_FOLDERS; f++ )
+    {
+        for ( size_t n = 1; n < gs_order[f].size(); n++ )
+        {
+            if ( gs_order[f][n] <= gs_order[f][n - 1] )
+            {
+                Check(false, "tasks for the same folder executed out of order");
+                break;
+            }
+        }
+    }
+
+    printf("%zu tasks executed, %zu cancelled (%zu of them discarded)\n",
+           gs_executed, countCancelled, gs_discarded);
+
+    TestStartWorker();
+
+    if ( gs_rc == EXIT_SUCCESS )
+        printf("all tests passed\n");
+
+    return gs_rc;
+}
@@ -0,0 +1,89 @@
+// Benchmark for UIdIndex: simulates the UID -> msgno lookups done once per
+// message when filtering or otherwise processing all messages in a folder and
+// shows that the total time grows linearly with the number of messages (while
+// the linear search previously used grows quadratically).
+
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+typedef unsigned long UIdType;
+typedef unsigned long MsgnoType;
+
+#define MSGNO_ILLEGAL 0
+
+#include "mail/UIdIndex.h"
+
+// the biggest folder size for which we also measure linear search, it becomes
+// too slow to be practical for bigger ones
+static const MsgnoType LINEAR_SEARCH_MAX = 50000;
+
+int main()
+{
+    wxInitializer init;
+
+    int rc = EXIT_SUCCESS;
+
+    printf("%10s %15s %15s\n", "messages", "index (ms)", "linear (ms)");
+
+    for ( MsgnoType count = 12500; count <= 100000; count *= 2 )
+    {
+        // the UIDs are ascending but not contiguous, as in a real folder from
+        // which some messages had been deleted
+        std::vector<UIdType> uids(count);
+        for ( MsgnoType n = 0; n < count; n++ )
+            uids[n] = 3*n + 1;
+
+        UIdIndex index;
+        index.OnAdd(count);
+        for ( MsgnoType n = 0; n < count; n++ )
+            index.Set(n + 1, uids[n]);
+
+        // process the messages in random order, as it would happen with a
+        // sorted folder
+        std::vector<UIdType> lookups(uids);
+        std::shuffle(lookups.begin(), lookups.end(), std::mt19937(count));
+
+        wxStopWatch sw;
+        for ( MsgnoType n = 0; n < count; n++ )
+        {
+            const MsgnoType msgno = index.Find(lookups[n]);
+            if ( msgno == MSGNO_ILLEGAL || uids[msgno - 1] != lookups[n] )
+            {
+                printf("ERROR: UID %lu not found correctly\n", lookups[n]);
+                rc = EXIT_FAILURE;
+            }
+        }
+        const long timeIndex = sw.Time();
+
+        long timeLinear = -1;
+        if ( count <= LINEAR_SEARCH_MAX )
+        {
+            sw.Start();
+            MsgnoType total = 0;
+            for ( MsgnoType n = 0; n < count; n++ )
+            {
+                total += std::find(uids.begin(), uids.end(), lookups[n]) -
+                            uids.begin();
+            }
+            timeLinear = sw.Time();
+
+            // just to prevent the loop above from being optimized away
+            if ( total != count*(count - 1)/2 )
+            {
+                printf("ERROR: linear search failed\n");
+                rc = EXIT_FAILURE;
+            }
+        }
+
+        if ( timeLinear == -1 )
+            printf("%10lu %15ld %15s\n", count, timeIndex, "skipped");
+        else
+            printf("%10lu %15ld %15ld\n", count, timeIndex, timeLinear);
+    }
+
+    return rc;
+}
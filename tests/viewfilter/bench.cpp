@@ -0,0 +1,367 @@
+// Benchmark for the viewer filters chain: passes a big plain text message,
+// looking like a mailing list digest, through a chain of filters splitting it
+// in the same way as the default ones do (the text is checked for uuencoded
+// data as in UUDecodeFilter, the signature is split off as in
+// SignatureFilter, each line and each URL in it are split as in
+// QuoteURLFilter and the words in *bold* as in TextMarkupFilter) and measures
+// the time and the number of memory allocations needed to render it when the
+// text runs are passed along the chain as strings, as it used to be done, and
+// as ViewText objects.
+//
+// The real filters can't be used outside of the program as they need
+// MessageView and the modules, but the real FindURL() is used to find URLs.
+//
+// Run "./bench [size-in-KB]".
+
+#include <wx/init.h>
+#include <wx/string.h>
+#include <wx/stopwatch.h>
+
+#include <stdlib.h>
+#include <new>
+
+typedef wxString String;
+
+#include "ViewText.h"
+
+extern int FindURL(const wxChar *s, int& len);
+
+static int gs_rc = EXIT_SUCCESS;
+
+static void Check(bool ok, const char *msg)
+{
+    if ( !ok )
+    {
+        printf("ERROR: %s\n", msg);
+        gs_rc = EXIT_FAILURE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// allocations counting
+// ----------------------------------------------------------------------------
+
+static unsigned long gs_countAllocs = 0;
+
+void *operator new(size_t size)
+{
+    gs_countAllocs++;
+
+    void *p = malloc(size ? size : 1);
+    if ( !p )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+// ----------------------------------------------------------------------------
+// helpers allowing to write the filters once for both kinds of text
+// ----------------------------------------------------------------------------
+
+static const wxChar *Begin(const String& s) { return s.c_str(); }
+static const wxChar *End(const String& s) { return Begin(s) + s.length(); }
+static String Make(const wxChar *start, const wxChar *end, const String *)
+{
+    // this is what the filters used to do for every part of the text
+    return String(start, end);
+}
+
+static const wxChar *Begin(const ViewText& t) { return t.begin(); }
+static const wxChar *End(const ViewText& t) { return t.end(); }
+static ViewText Make(const wxChar *start, const wxChar *end, const ViewText *)
+{
+    return ViewText(start, end);
+}
+
+// ----------------------------------------------------------------------------
+// the filters
+// ----------------------------------------------------------------------------
+
+template <typename Text>
+class Filter
+{
+public:
+    explicit Filter(Filter *next) : m_next(next) { }
+    virtual ~Filter() { }
+
+    virtual void Process(const Text& text) = 0;
+
+    // this is what ProcessURL() gets: it always takes a string
+    virtual void ProcessURL(const String& url) { m_next->ProcessURL(url); }
+
+protected:
+    void Next(const wxChar *start, const wxChar *end)
+    {
+        if ( start != end )
+            m_next->Process(Make(start, end, (Text *)NULL));
+    }
+
+    Filter *m_next;
+};
+
+// the last filter in the chain, similar to TransparentFilter
+template <typename Text>
+class Sink : public Filter<Text>
+{
+public:
+    Sink() : Filter<Text>(NULL) { m_countRuns = 0; }
+
+    virtual void Process(const Text& text)
+    {
+        // MessageViewer::InsertText() needs a string, but don't make a copy
+        // of it if we already have one
+        const String& str = ToString(text);
+
+        m_body += str;
+        m_countRuns++;
+    }
+
+    virtual void ProcessURL(const String& url)
+    {
+        m_body += url;
+        m_countRuns++;
+    }
+
+    const String& GetBody() const { return m_body; }
+    unsigned long GetRunsCount() const { return m_countRuns; }
+
+private:
+    static const String& ToString(const String& s) { return s; }
+    static String ToString(const ViewText& t) { return t.ToString(); }
+
+    String m_body;
+    unsigned long m_countRuns;
+};
+
+// splits the text into lines and URLs, as QuoteURLFilter does
+template <typename Text>
+class URLFilter : public Filter<Text>
+{
+public:
+    explicit URLFilter(Filter<Text> *next) : Filter<Text>(next) { }
+
+    virtual void Process(const Text& text)
+    {
+        const wxChar *lineCur = Begin(text);
+        const wxChar * const end = End(text);
+
+        // as in QuoteURLFilter, look for the next URL only after the previous
+        // one, not on every line
+        int len;
+        const wxChar *startURL = FindNext(lineCur, end, len);
+        while ( lineCur < end )
+        {
+            const wxChar *lineNext = lineCur;
+            while ( lineNext < end && *lineNext != '\n' )
+                lineNext++;
+
+            if ( lineNext < end )
+                lineNext++;
+
+            const wxChar *endURL = lineCur;
+            while ( startURL && startURL < lineNext )
+            {
+                this->Next(endURL, startURL);
+
+                endURL = startURL + len;
+                this->m_next->ProcessURL(String(startURL, endURL));
+
+                startURL = FindNext(endURL, end, len);
+            }
+
+            this->Next(endURL, lineNext);
+
+            lineCur = lineNext;
+        }
+    }
+
+private:
+    static const wxChar *FindNext(const wxChar *s, const wxChar *end, int& len)
+    {
+        if ( s >= end )
+            return NULL;
+
+        const int pos = FindURL(s, len);
+        if ( pos == -1 || s + pos + len > end )
+            return NULL;
+
+        return s + pos;
+    }
+};
+
+// splits off the *bold* words, as TextMarkupFilter does
+template <typename Text>
+class MarkupFilter : public Filter<Text>
+{
+public:
+    explicit MarkupFilter(Filter<Text> *next) : Filter<Text>(next) { }
+
+    virtual void Process(const Text& text)
+    {
+        const wxChar *start = Begin(text);
+        const wxChar * const end = End(text);
+
+        for ( const wxChar *pc = start; pc < end; pc++ )
+        {
+            if ( *pc != '*' || (pc != start && !wxIsspace(pc[-1])) )
+                continue;
+
+            const wxChar *endMarkup = pc + 1;
+            while ( endMarkup < end && wxIsalnum(*endMarkup) )
+                endMarkup++;
+
+            if ( endMarkup == end || *endMarkup != '*' || endMarkup == pc + 1 )
+                continue;
+
+            this->Next(start, pc);
+            this->Next(pc + 1, endMarkup);
+
+            start = endMarkup + 1;
+            pc = endMarkup;
+        }
+
+        this->Next(start, end);
+    }
+};
+
+// splits off the signature, as SignatureFilter does
+template <typename Text>
+class SigFilter : public Filter<Text>
+{
+public:
+    explicit SigFilter(Filter<Text> *next) : Filter<Text>(next) { }
+
+    virtual void Process(const Text& text)
+    {
+        const wxChar * const start = Begin(text);
+        const wxChar * const end = End(text);
+
+        const wxChar *pc = end;
+        while ( pc > start )
+        {
+            pc--;
+            if ( pc[0] == '\n' && end - pc > 4 &&
+                    pc[1] == '-' && pc[2] == '-' && pc[3] == ' ' )
+            {
+                pc++;
+                break;
+            }
+        }
+
+        if ( pc == start )
+        {
+            this->m_next->Process(text);
+            return;
+        }
+
+        this->Next(start, pc);
+        this->Next(pc, end);
+    }
+};
+
+// looks for uuencoded data and passes the rest of the text further, as
+// UUDecodeFilter does
+template <typename Text>
+class UUFilter : public Filter<Text>
+{
+public:
+    explicit UUFilter(Filter<Text> *next) : Filter<Text>(next) { }
+
+    virtual void Process(const Text& text)
+    {
+        const wxChar * const start = Begin(text);
+        const wxChar * const end = End(text);
+
+        for ( const wxChar *pc = start; pc < end; pc++ )
+        {
+            if ( (pc == start || pc[-1] == '\n') && end - pc > 6 &&
+                    wxStrncmp(pc, wxT("begin "), 6) == 0 )
+            {
+                Check(false, "unexpected uuencoded data");
+            }
+        }
+
+        this->Next(start, end);
+    }
+};
+
+// ----------------------------------------------------------------------------
+// the benchmark itself
+// ----------------------------------------------------------------------------
+
+// create a digest of the given size
+static String CreateDigest(size_t size)
+{
+    static const char *lines[] =
+    {
+        "On Monday somebody wrote:\r\n",
+        "> I tried the *new* version from http://www.example.com/download/\r\n",
+        "> and it still crashes when opening a folder with many messages.\r\n",
+        ">> Did you try the workaround from the FAQ?\r\n",
+        "This is a _known_ problem, please see the bug tracker at\r\n",
+        "https://bugs.example.org/show_bug.cgi?id=12345 for the details.\r\n",
+        "It will be fixed in the *next* release, hopefully soon.\r\n",
+        "\r\n",
+        "Plain text of the digest without anything special in it at all.\r\n",
+        "Write to list-owner@example.com if you have any problems with it.\r\n",
+        "\r\n",
+    };
+
+    String text;
+    text.reserve(size + 100);
+
+    for ( size_t n = 0; text.length() < size; n++ )
+        text += lines[n % WXSIZEOF(lines)];
+
+    text += "-- \r\nThe mailing list footer\r\n";
+
+    return text;
+}
+
+template <typename Text>
+static void Render(const char *name, const String& text, String *body)
+{
+    Sink<Text> sink;
+    MarkupFilter<Text> markup(&sink);
+    URLFilter<Text> urls(&markup);
+    SigFilter<Text> sig(&urls);
+    UUFilter<Text> uu(&sig);
+
+    const unsigned long allocsBefore = gs_countAllocs;
+    wxStopWatch sw;
+
+    uu.Process(text);
+
+    const long time = sw.Time();
+
+    printf("%-10s %12lu %12lu %10ld\n",
+           name, sink.GetRunsCount(), gs_countAllocs - allocsBefore, time);
+
+    *body = sink.GetBody();
+}
+
+int main(int argc, char **argv)
+{
+    wxInitializer init;
+
+    const size_t size = (argc > 1 ? atol(argv[1]) : 5*1024)*1024;
+
+    const String text = CreateDigest(size);
+
+    printf("%-10s %12s %12s %10s\n", "mode", "runs", "allocs", "time (ms)");
+
+    String bodyStrings,
+           bodySpans;
+    Render<String>("strings", text, &bodyStrings);
+    Render<ViewText>("spans", text, &bodySpans);
+
+    Check(bodySpans == bodyStrings, "different output for strings and spans");
+    Check(bodySpans.length() < text.length(), "markup not removed");
+
+    return gs_rc;
+}